@@ -18,7 +18,18 @@ object AudioEngineBridge {
 
     fun isLoaded(): Boolean = nativeLoaded
 
+    external fun nativeSetCacheDir(path: String)
     external fun nativeLoad(path: String): Boolean
+    external fun nativePreloadNext(path: String)
+    external fun nativeSetGapless(enabled: Boolean)
+    external fun nativeSetHeadphonesConnected(connected: Boolean)
+    external fun nativeSetPlaybackRate(rate: Double)
+    external fun nativeSetSpectrumEnabled(enabled: Boolean)
+    external fun nativeLatestSpectrum(): FloatArray?
+    external fun nativeSpectrumBandCenters(): DoubleArray
+    external fun nativeMeterLevels(): FloatArray?
+    external fun nativeQueueNext(path: String): Boolean
+    external fun nativeTakeTrackChange(): Boolean
     external fun nativePlay(): Boolean
     external fun nativePause(): Boolean
     external fun nativeStop(): Boolean
@@ -27,4 +38,12 @@ object AudioEngineBridge {
     external fun nativeGetVolume(): Double
     external fun nativeExtractMetadata(path: String): Map<String, Any?>
     external fun nativeSetOnPlaybackEnded(callback: Runnable)
+    external fun nativeScanLoudness(paths: Array<String>, albums: Array<String>)
+    external fun nativeCancelLoudnessScan()
+    external fun nativeTrackLoudness(path: String): DoubleArray?
+    external fun nativeLoudnessScanStats(): DoubleArray
+    external fun nativeScanFeatures(paths: Array<String>)
+    external fun nativeCancelFeatureScan()
+    external fun nativeTrackFeatures(path: String): DoubleArray?
+    external fun nativeFeatureScanStats(): DoubleArray
 }
@@ -1,5 +1,10 @@
 package net.djbird.toney
 
+import android.content.Context
+import android.media.AudioDeviceCallback
+import android.media.AudioDeviceInfo
+import android.media.AudioManager
+import android.os.Build
 import android.os.Handler
 import android.os.Looper
 import io.flutter.embedding.engine.FlutterEngine
@@ -17,7 +22,10 @@ import io.flutter.plugin.common.MethodChannel.Result
  * is being integrated. All operations are no-ops except volume/metadata,
  * which return simple placeholders.
  */
-class AudioEnginePlugin(messenger: BinaryMessenger) : MethodCallHandler {
+class AudioEnginePlugin(
+  appContext: Context,
+  messenger: BinaryMessenger,
+) : MethodCallHandler {
 
   private val channel = MethodChannel(messenger, "audio_engine")
   private var volume: Double = 1.0
@@ -25,15 +33,36 @@ class AudioEnginePlugin(messenger: BinaryMessenger) : MethodCallHandler {
   private val mainHandler = Handler(Looper.getMainLooper())
   private var currentPath: String? = null
   private var currentMetadata: Map<String, Any?>? = null
+  // Track handed to nativeQueueNext, until it becomes audible.
+  private var queuedPath: String? = null
+
+  // The engine hands over a queued track on its control side, so it is
+  // polled here while one is queued.
+  private val trackChangePoll = object : Runnable {
+    override fun run() {
+      val path = queuedPath ?: return
+      if (!AudioEngineBridge.nativeTakeTrackChange()) {
+        mainHandler.postDelayed(this, TRACK_CHANGE_POLL_MS)
+        return
+      }
+      queuedPath = null
+      currentPath = path
+      currentMetadata = AudioEngineBridge.nativeExtractMetadata(path)
+      channel.invokeMethod("onTrackChanged", null)
+    }
+  }
 
   init {
     channel.setMethodCallHandler(this)
     if (hasNative) {
+      // Seek indexes for long MP3/FLAC/AAC files are cached here.
+      AudioEngineBridge.nativeSetCacheDir(appContext.cacheDir.absolutePath)
       AudioEngineBridge.nativeSetOnPlaybackEnded(
         Runnable {
           mainHandler.post { channel.invokeMethod("onPlaybackEnded", null) }
         },
       )
+      watchHeadphones(appContext)
     }
   }
 
@@ -50,6 +79,7 @@ class AudioEnginePlugin(messenger: BinaryMessenger) : MethodCallHandler {
             "load" -> {
                 val path = call.argument<String>("path")
                 currentPath = path
+                clearQueued()
                 if (hasNative && path != null) {
                     AudioEngineBridge.nativeLoad(path)
                     currentMetadata = AudioEngineBridge.nativeExtractMetadata(path)
@@ -58,6 +88,36 @@ class AudioEnginePlugin(messenger: BinaryMessenger) : MethodCallHandler {
                 }
                 result.success(null)
             }
+            "preloadNext" -> {
+                val path = call.argument<String>("path")
+                if (hasNative && path != null) {
+                    AudioEngineBridge.nativePreloadNext(path)
+                }
+                result.success(null)
+            }
+            "setGapless" -> {
+                val enabled = call.argument<Boolean>("enabled") ?: false
+                if (hasNative) {
+                    AudioEngineBridge.nativeSetGapless(enabled)
+                }
+                if (!enabled) clearQueued()
+                result.success(null)
+            }
+            "queueNext" -> {
+                val path = call.argument<String>("path")
+                if (!hasNative || path == null) {
+                    result.error("queue_failed", "Cannot queue track", null)
+                } else if (!AudioEngineBridge.nativeQueueNext(path)) {
+                    // Gapless off or a different output format; Dart loads
+                    // the track when playback ends instead.
+                    result.error("queue_failed", "Cannot queue track", path)
+                } else {
+                    clearQueued()
+                    queuedPath = path
+                    mainHandler.postDelayed(trackChangePoll, TRACK_CHANGE_POLL_MS)
+                    result.success(null)
+                }
+            }
             "play", "pause", "stop" -> {
                 if (hasNative) {
                     when (call.method) {
@@ -66,6 +126,7 @@ class AudioEnginePlugin(messenger: BinaryMessenger) : MethodCallHandler {
                         "stop" -> AudioEngineBridge.nativeStop()
                     }
                 }
+                if (call.method == "stop") clearQueued()
                 result.success(null)
             }
             "seek" -> {
@@ -83,6 +144,18 @@ class AudioEnginePlugin(messenger: BinaryMessenger) : MethodCallHandler {
                 }
                 result.success(null)
             }
+            "setPlaybackRate" -> {
+                val rate = call.argument<Double>("rate")
+                if (rate == null || rate <= 0.0) {
+                    result.error("invalid_args", "Missing rate", null)
+                } else {
+                    if (hasNative) {
+                        // Clamped to 0.5x-3x by the engine.
+                        AudioEngineBridge.nativeSetPlaybackRate(rate)
+                    }
+                    result.success(null)
+                }
+            }
             "getVolume" -> {
                 val nativeValue = if (hasNative) AudioEngineBridge.nativeGetVolume() else volume
                 result.success(nativeValue)
@@ -125,17 +198,190 @@ class AudioEnginePlugin(messenger: BinaryMessenger) : MethodCallHandler {
                     "volumePermille" to ((volume * 1000).toInt()),
                     "isBitPerfect" to false,
                     "isAutoSampleRateEnabled" to false,
-                    "isPlaying" to false
+                    "isPlaying" to false,
+                    "levels" to (if (hasNative) AudioEngineBridge.nativeMeterLevels() else null)
+                        ?.let { meterLevelsToMap(it) },
                 )
                 result.success(status)
             }
+            "scanLoudness" -> {
+                // [{path, album}]; tracks sharing an album id get album gain.
+                val tracks = call.argument<List<Map<String, Any?>>>("tracks").orEmpty()
+                    .mapNotNull { track ->
+                        (track["path"] as? String)?.let { it to (track["album"] as? String ?: "") }
+                    }
+                if (hasNative) {
+                    AudioEngineBridge.nativeScanLoudness(
+                        tracks.map { it.first }.toTypedArray(),
+                        tracks.map { it.second }.toTypedArray(),
+                    )
+                }
+                result.success(null)
+            }
+            "cancelLoudnessScan" -> {
+                if (hasNative) {
+                    AudioEngineBridge.nativeCancelLoudnessScan()
+                }
+                result.success(null)
+            }
+            "trackLoudness" -> {
+                val path = call.argument<String>("path")
+                val values = if (hasNative && path != null) {
+                    AudioEngineBridge.nativeTrackLoudness(path)
+                } else {
+                    null
+                }
+                result.success(values?.let {
+                    mapOf(
+                        "integratedLufs" to it[0],
+                        "loudnessRangeLu" to it[1],
+                        "truePeak" to it[2],
+                    )
+                })
+            }
+            "setSpectrumEnabled" -> {
+                val enabled = call.argument<Boolean>("enabled") ?: false
+                if (hasNative) {
+                    AudioEngineBridge.nativeSetSpectrumEnabled(enabled)
+                }
+                result.success(null)
+            }
+            "spectrum" -> {
+                // Null when no frame was published since the last poll.
+                val levels = if (hasNative) AudioEngineBridge.nativeLatestSpectrum() else null
+                result.success(levels?.let { mapOf("levelsDb" to it) })
+            }
+            "spectrumBands" -> {
+                result.success(
+                    if (hasNative) AudioEngineBridge.nativeSpectrumBandCenters() else DoubleArray(0),
+                )
+            }
+            "loudnessScanStats" -> {
+                val values = if (hasNative) AudioEngineBridge.nativeLoudnessScanStats() else DoubleArray(6)
+                result.success(
+                    mapOf(
+                        "tracksScanned" to values[0].toInt(),
+                        "tracksCached" to values[1].toInt(),
+                        "tracksFailed" to values[2].toInt(),
+                        "tracksPending" to values[3].toInt(),
+                        "tracksPerSecondPerCore" to values[4],
+                        "realtimeFactor" to values[5],
+                    ),
+                )
+            }
+            "scanFeatures" -> {
+                val paths = call.argument<List<String>>("paths").orEmpty()
+                if (hasNative) {
+                    AudioEngineBridge.nativeScanFeatures(paths.toTypedArray())
+                }
+                result.success(null)
+            }
+            "cancelFeatureScan" -> {
+                if (hasNative) {
+                    AudioEngineBridge.nativeCancelFeatureScan()
+                }
+                result.success(null)
+            }
+            "trackFeatures" -> {
+                val path = call.argument<String>("path")
+                val values = if (hasNative && path != null) {
+                    AudioEngineBridge.nativeTrackFeatures(path)
+                } else {
+                    null
+                }
+                result.success(values?.let {
+                    mapOf(
+                        "bpm" to it[0],
+                        "tempoConfidence" to it[1],
+                        "key" to it[2].toInt(),
+                        "minor" to (it[3] != 0.0),
+                        "keyConfidence" to it[4],
+                        "energy" to it[5],
+                        "danceability" to it[6],
+                        "rmsDb" to it[7],
+                        "onsetRate" to it[8],
+                        "spectralCentroidHz" to it[9],
+                        "spectralSpreadHz" to it[10],
+                        "spectralRolloffHz" to it[11],
+                        "spectralFlatness" to it[12],
+                    )
+                })
+            }
+            "featureScanStats" -> {
+                val values = if (hasNative) AudioEngineBridge.nativeFeatureScanStats() else DoubleArray(6)
+                result.success(
+                    mapOf(
+                        "tracksAnalyzed" to values[0].toInt(),
+                        "tracksCached" to values[1].toInt(),
+                        "tracksFailed" to values[2].toInt(),
+                        "tracksPending" to values[3].toInt(),
+                        "tracksPerSecondPerCore" to values[4],
+                        "realtimeFactor" to values[5],
+                    ),
+                )
+            }
             else -> result.notImplemented()
         }
     }
 
+    // Feeds the engine's kHeadphones crossfeed; AAudio does not report the
+    // output device type itself.
+    private fun watchHeadphones(context: Context) {
+        val audioManager = context.getSystemService(Context.AUDIO_SERVICE) as? AudioManager ?: return
+        if (Build.VERSION.SDK_INT < Build.VERSION_CODES.M) {
+            @Suppress("DEPRECATION")
+            AudioEngineBridge.nativeSetHeadphonesConnected(audioManager.isWiredHeadsetOn)
+            return
+        }
+        // Also called once on registration with the devices already present.
+        val callback = object : AudioDeviceCallback() {
+            override fun onAudioDevicesAdded(added: Array<out AudioDeviceInfo>) = update()
+            override fun onAudioDevicesRemoved(removed: Array<out AudioDeviceInfo>) = update()
+
+            private fun update() {
+                val connected = audioManager.getDevices(AudioManager.GET_DEVICES_OUTPUTS)
+                    .any { it.type in HEADPHONE_TYPES }
+                AudioEngineBridge.nativeSetHeadphonesConnected(connected)
+            }
+        }
+        audioManager.registerAudioDeviceCallback(callback, mainHandler)
+    }
+
+    // Unpacks nativeMeterLevels: the channel count, then one block of values
+    // per reading.
+    private fun meterLevelsToMap(values: FloatArray): Map<String, Any> {
+        val channels = values[0].toInt()
+        fun block(index: Int): FloatArray =
+            values.copyOfRange(1 + index * channels, 1 + (index + 1) * channels)
+        return mapOf(
+            "peakDb" to block(0),
+            "peakHoldDb" to block(1),
+            "rmsDb" to block(2),
+            "truePeakDb" to block(3),
+            "maxTruePeakDb" to block(4),
+        )
+    }
+
+    private fun clearQueued() {
+        queuedPath = null
+        mainHandler.removeCallbacks(trackChangePoll)
+    }
+
     companion object {
-        fun registerWith(flutterEngine: FlutterEngine) {
-            AudioEnginePlugin(flutterEngine.dartExecutor.binaryMessenger)
+        private const val TRACK_CHANGE_POLL_MS = 250L
+        private val HEADPHONE_TYPES = setOf(
+            AudioDeviceInfo.TYPE_WIRED_HEADPHONES,
+            AudioDeviceInfo.TYPE_WIRED_HEADSET,
+            AudioDeviceInfo.TYPE_BLUETOOTH_A2DP,
+            AudioDeviceInfo.TYPE_BLUETOOTH_SCO,
+            AudioDeviceInfo.TYPE_USB_HEADSET,
+        )
+
+        fun registerWith(appContext: Context, flutterEngine: FlutterEngine) {
+            AudioEnginePlugin(
+                appContext.applicationContext,
+                flutterEngine.dartExecutor.binaryMessenger,
+            )
         }
     }
 }
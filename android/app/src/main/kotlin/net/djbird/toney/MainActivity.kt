@@ -7,7 +7,7 @@ class MainActivity : FlutterActivity() {
     override fun configureFlutterEngine(flutterEngine: FlutterEngine) {
         super.configureFlutterEngine(flutterEngine)
         // Register the Android AudioEngine stub (FFmpeg-based engine can be added later).
-        AudioEnginePlugin.registerWith(flutterEngine)
+        AudioEnginePlugin.registerWith(this, flutterEngine)
         MoodEnginePlugin.registerWith(this, flutterEngine)
     }
 }
@@ -14,6 +14,13 @@ public class AudioEnginePlugin: NSObject, FlutterPlugin {
         let instance = AudioEnginePlugin()
         registrar.addMethodCallDelegate(instance, channel: channel)
 
+        // A track queued with queueNext has become audible.
+        AudioEngineFacade.shared.onTrackChanged = {
+            DispatchQueue.main.async {
+                channel.invokeMethod("onTrackChanged", arguments: nil)
+            }
+        }
+
         do {
             try AVAudioSession.sharedInstance().setCategory(.playback)
             try AVAudioSession.sharedInstance().setActive(true)
@@ -54,6 +61,33 @@ public class AudioEnginePlugin: NSObject, FlutterPlugin {
                 try AudioEngineFacade.shared.loadFile(url: url)
             }
 
+        case "preloadNext":
+            guard let args = call.arguments as? [String: Any],
+                  let path = args["path"] as? String else {
+                return result(FlutterError(code: "INVALID", message: nil, details: nil))
+            }
+            performAsync {
+                AudioEngineFacade.shared.preloadNext(url: URL(fileURLWithPath: path))
+            }
+
+        case "setGapless":
+            guard let args = call.arguments as? [String: Any],
+                  let enabled = args["enabled"] as? Bool else {
+                return result(FlutterError(code: "INVALID", message: nil, details: nil))
+            }
+            performAsync {
+                AudioEngineFacade.shared.setGapless(enabled: enabled)
+            }
+
+        case "queueNext":
+            guard let args = call.arguments as? [String: Any],
+                  let path = args["path"] as? String else {
+                return result(FlutterError(code: "INVALID", message: nil, details: nil))
+            }
+            performAsync {
+                try AudioEngineFacade.shared.queueNext(url: URL(fileURLWithPath: path))
+            }
+
         case "play":
             performAsync {
                 AudioEngineFacade.shared.play()
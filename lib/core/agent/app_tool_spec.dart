@@ -340,11 +340,43 @@ class _AppToolSchemaBuilder {
           type: SchemaType.STRING,
           description: 'Source label (optional)',
         ),
+        'features': trackFeaturesSchema(),
       },
       required: const ['id', 'title'],
     );
   }
 
+  static Schema trackFeaturesSchema() {
+    return Schema(
+      type: SchemaType.OBJECT,
+      description:
+          'Audio analysis from the engine; absent until the track is scanned',
+      properties: {
+        'bpm': Schema(
+          type: SchemaType.INTEGER,
+          description: 'Tempo in beats per minute; absent without a pulse',
+        ),
+        'key': Schema(
+          type: SchemaType.STRING,
+          description: 'Musical key such as "A minor" (optional)',
+        ),
+        'energy': Schema(
+          type: SchemaType.NUMBER,
+          description: 'Loudness and activity between 0 and 1',
+        ),
+        'danceability': Schema(
+          type: SchemaType.NUMBER,
+          description: 'Strength and regularity of the beat between 0 and 1',
+        ),
+        'mood': Schema(
+          type: SchemaType.STRING,
+          description: 'energetic/upbeat/calm/melancholic/intense (optional)',
+        ),
+      },
+      required: const ['energy', 'danceability'],
+    );
+  }
+
   static Schema trackListSchema(Schema summarySchema) {
     return Schema(
       type: SchemaType.ARRAY,
@@ -432,6 +464,7 @@ class _AppToolSchemaBuilder {
           type: SchemaType.OBJECT,
           description: 'Additional metadata key/value pairs',
         ),
+        'features': trackFeaturesSchema(),
       },
       required: const ['path', 'title'],
     );
@@ -31,6 +31,8 @@ class AppUtil {
          metadataUtil:
              metadataUtil ??
              SongMetadataUtil(metadataFetcher: audioController.extractMetadata),
+         featureFetcher: audioController.trackFeatures,
+         featureScanner: audioController.scanFeatures,
        ),
        _moodEngine = moodEngine ?? MoodEngineClient();
 
@@ -1,5 +1,6 @@
 import 'package:json_annotation/json_annotation.dart';
 
+import '../model/engine_track_models.dart';
 import '../mood/mood_engine.dart';
 
 part 'dto.g.dart';
@@ -94,6 +95,7 @@ class SongSummaryDto {
   final int? durationSec;
   final String? format;
   final String? source;
+  final TrackFeaturesDto? features;
 
   const SongSummaryDto({
     required this.id,
@@ -103,12 +105,60 @@ class SongSummaryDto {
     this.durationSec,
     this.format,
     this.source,
+    this.features,
   });
 
   factory SongSummaryDto.fromJson(Map<String, dynamic> json) =>
       _$SongSummaryDtoFromJson(json);
 
   Map<String, dynamic> toJson() => _$SongSummaryDtoToJson(this);
+
+  SongSummaryDto withFeatures(TrackFeaturesDto? features) {
+    return SongSummaryDto(
+      id: id,
+      title: title,
+      artist: artist,
+      album: album,
+      durationSec: durationSec,
+      format: format,
+      source: source,
+      features: features,
+    );
+  }
+}
+
+/// Engine feature scan results, trimmed for the agent.
+@JsonSerializable(includeIfNull: false, explicitToJson: true)
+class TrackFeaturesDto {
+  final int? bpm; // null without a steady pulse
+  final String? key; // "A minor"
+  final double energy; // 0-1
+  final double danceability; // 0-1
+  final String? mood; // TrackMood name
+
+  const TrackFeaturesDto({
+    required this.energy,
+    required this.danceability,
+    this.bpm,
+    this.key,
+    this.mood,
+  });
+
+  factory TrackFeaturesDto.fromEngine(EngineTrackFeatures features) {
+    double round(double value) => (value * 100).roundToDouble() / 100;
+    return TrackFeaturesDto(
+      bpm: features.bpm > 0 ? features.bpm.round() : null,
+      key: features.keyName,
+      energy: round(features.energy),
+      danceability: round(features.danceability),
+      mood: trackMoodFor(features)?.name,
+    );
+  }
+
+  factory TrackFeaturesDto.fromJson(Map<String, dynamic> json) =>
+      _$TrackFeaturesDtoFromJson(json);
+
+  Map<String, dynamic> toJson() => _$TrackFeaturesDtoToJson(this);
 }
 
 @JsonSerializable(includeIfNull: false, explicitToJson: true)
@@ -204,6 +254,7 @@ class SongMetadataInfoDto {
   final String? album;
   final int? durationSec;
   final Map<String, String>? extras;
+  final TrackFeaturesDto? features;
 
   const SongMetadataInfoDto({
     required this.path,
@@ -212,6 +263,7 @@ class SongMetadataInfoDto {
     this.album,
     this.durationSec,
     this.extras,
+    this.features,
   });
 
   factory SongMetadataInfoDto.fromJson(Map<String, dynamic> json) =>
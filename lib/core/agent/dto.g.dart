@@ -111,6 +111,9 @@ SongSummaryDto _$SongSummaryDtoFromJson(Map<String, dynamic> json) =>
       durationSec: (json['durationSec'] as num?)?.toInt(),
       format: json['format'] as String?,
       source: json['source'] as String?,
+      features: json['features'] == null
+          ? null
+          : TrackFeaturesDto.fromJson(json['features'] as Map<String, dynamic>),
     );
 
 Map<String, dynamic> _$SongSummaryDtoToJson(SongSummaryDto instance) {
@@ -127,6 +130,33 @@ Map<String, dynamic> _$SongSummaryDtoToJson(SongSummaryDto instance) {
   writeNotNull('durationSec', instance.durationSec);
   writeNotNull('format', instance.format);
   writeNotNull('source', instance.source);
+  writeNotNull('features', instance.features?.toJson());
+  return val;
+}
+
+TrackFeaturesDto _$TrackFeaturesDtoFromJson(Map<String, dynamic> json) =>
+    TrackFeaturesDto(
+      energy: (json['energy'] as num).toDouble(),
+      danceability: (json['danceability'] as num).toDouble(),
+      bpm: (json['bpm'] as num?)?.toInt(),
+      key: json['key'] as String?,
+      mood: json['mood'] as String?,
+    );
+
+Map<String, dynamic> _$TrackFeaturesDtoToJson(TrackFeaturesDto instance) {
+  final val = <String, dynamic>{};
+
+  void writeNotNull(String key, dynamic value) {
+    if (value != null) {
+      val[key] = value;
+    }
+  }
+
+  writeNotNull('bpm', instance.bpm);
+  writeNotNull('key', instance.key);
+  val['energy'] = instance.energy;
+  val['danceability'] = instance.danceability;
+  writeNotNull('mood', instance.mood);
   return val;
 }
 
@@ -225,6 +255,9 @@ SongMetadataInfoDto _$SongMetadataInfoDtoFromJson(Map<String, dynamic> json) =>
       extras: (json['extras'] as Map<String, dynamic>?)?.map(
         (k, e) => MapEntry(k, e as String),
       ),
+      features: json['features'] == null
+          ? null
+          : TrackFeaturesDto.fromJson(json['features'] as Map<String, dynamic>),
     );
 
 Map<String, dynamic> _$SongMetadataInfoDtoToJson(SongMetadataInfoDto instance) {
@@ -240,6 +273,7 @@ Map<String, dynamic> _$SongMetadataInfoDtoToJson(SongMetadataInfoDto instance) {
   writeNotNull('album', instance.album);
   writeNotNull('durationSec', instance.durationSec);
   writeNotNull('extras', instance.extras);
+  writeNotNull('features', instance.features?.toJson());
   return val;
 }
 
@@ -1,5 +1,6 @@
 import '../library/library_source.dart';
 import '../media/song_metadata_util.dart';
+import '../model/engine_track_models.dart';
 import '../storage/library_storage.dart';
 import 'dto.dart';
 import 'song_mapper.dart';
@@ -8,12 +9,20 @@ class LibraryAgent {
   LibraryAgent({
     required LibraryStorage libraryStorage,
     required SongMetadataUtil metadataUtil,
+    this.featureFetcher,
+    this.featureScanner,
   }) : _libraryStorage = libraryStorage,
        _metadataUtil = metadataUtil;
 
   final LibraryStorage _libraryStorage;
   final SongMetadataUtil _metadataUtil;
 
+  /// Engine feature scan results; null until a track has been analysed.
+  final Future<EngineTrackFeatures?> Function(String path)? featureFetcher;
+
+  /// Queues tracks for the engine's feature scan.
+  final Future<void> Function(List<String> paths)? featureScanner;
+
   bool _libraryReady = false;
 
   Future<LibrarySummaryDto> getLibrary({
@@ -39,7 +48,13 @@ class LibraryAgent {
         .take(limit ?? filtered.length)
         .map(SongMapper.fromLibraryEntry)
         .toList();
-    return LibrarySummaryDto(total: filtered.length, tracks: sliced);
+    // Tracks the agent sees are analysed first; the engine skips any it
+    // already has.
+    await featureScanner?.call([for (final song in sliced) song.id]);
+    final tracks = await Future.wait(
+      sliced.map((song) async => song.withFeatures(await _features(song.id))),
+    );
+    return LibrarySummaryDto(total: filtered.length, tracks: tracks);
   }
 
   Future<SongMetadataInfoDto> getSongMetadata(String path) async {
@@ -67,9 +82,15 @@ class LibraryAgent {
       album: summary.album,
       durationSec: summary.durationSec,
       extras: _trimExtras(metadata.extras),
+      features: await _features(path),
     );
   }
 
+  Future<TrackFeaturesDto?> _features(String path) async {
+    final features = await featureFetcher?.call(path);
+    return features == null ? null : TrackFeaturesDto.fromEngine(features);
+  }
+
   Future<void> _ensureLibrary() async {
     if (_libraryReady) return;
     await _libraryStorage.init();
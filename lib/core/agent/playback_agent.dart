@@ -32,17 +32,21 @@ class PlaybackAgent {
     );
   }
 
-  PlaylistDetailDto getCurrentQueue({int? limit}) {
+  Future<PlaylistDetailDto> getCurrentQueue({int? limit}) async {
     final state = _controller.state.value;
-    final tracks = state.queue
-        .take(limit ?? state.queue.length)
-        .map(
-          (track) => SongMapper.fromMetadata(
-            path: track.path,
-            metadata: track.metadata,
-          ),
-        )
-        .toList();
+    final tracks = await Future.wait(
+      state.queue.take(limit ?? state.queue.length).map((track) async {
+        final summary = SongMapper.fromMetadata(
+          path: track.path,
+          metadata: track.metadata,
+        );
+        // setQueue() has already queued these for the feature scan.
+        final features = await _controller.trackFeatures(track.path);
+        return summary.withFeatures(
+          features == null ? null : TrackFeaturesDto.fromEngine(features),
+        );
+      }),
+    );
     return PlaylistDetailDto(name: 'Current Queue', tracks: tracks);
   }
 
@@ -5,6 +5,7 @@ import 'dart:math';
 import 'package:flutter/foundation.dart';
 import 'package:flutter/services.dart';
 
+import 'media_session/media_session.dart';
 import 'model/engine_track_models.dart';
 import 'model/playback_mode.dart';
 import 'model/playback_track.dart';
@@ -20,6 +21,9 @@ class AudioController {
   AudioController({MethodChannel? channel})
     : _channel = channel ?? const MethodChannel('audio_engine') {
     _channel.setMethodCallHandler(_handleMethodCall);
+    MediaSession.instance.onPlaybackRate = (rate) {
+      unawaited(setPlaybackRate(rate));
+    };
   }
 
   final MethodChannel _channel;
@@ -32,6 +36,11 @@ class AudioController {
   DateTime? _lastTick;
   PlayMode _playbackMode = PlayMode.sequence;
   final Random _random = Random();
+  bool _gapless = true;
+  // Engine playback speed; the position ticker advances by it.
+  double _playbackRate = 1.0;
+  // Queue index handed to the engine's queueNext, until it becomes audible.
+  int? _queuedIndex;
 
   final ValueNotifier<PlaybackViewModel> state = ValueNotifier(
     PlaybackViewModel.initial(),
@@ -43,6 +52,7 @@ class AudioController {
 
   Future<void> init() async {
     await _storage.init();
+    await setGapless(_gapless);
     final snapshot = _storage.load();
 
     if (snapshot.queue.isNotEmpty) {
@@ -102,6 +112,9 @@ class AudioController {
       case 'onPlaybackEnded':
         _onPlaybackEnded();
         break;
+      case 'onTrackChanged':
+        _onTrackChanged();
+        break;
     }
   }
 
@@ -113,6 +126,27 @@ class AudioController {
     );
   }
 
+  /// The engine moved on to the track queued by [_queueNext] without a gap.
+  void _onTrackChanged() {
+    final index = _queuedIndex;
+    _queuedIndex = null;
+    if (index == null || index >= _queue.length) return;
+    _currentIndex = index;
+    final track = _queue[index];
+    state.value = state.value.copyWith(
+      currentIndex: index,
+      duration: track.duration ?? Duration.zero,
+      position: Duration.zero,
+      isPlaying: true,
+    );
+    // The ticker may have stopped at the old track's duration just before
+    // the notification arrived.
+    _startPositionTicker();
+    _saveState();
+    unawaited(_refreshEngineMetadata());
+    unawaited(_prepareNext());
+  }
+
   void _onPlaybackEnded() {
     if (_queue.isEmpty || _currentIndex == null) {
       stop();
@@ -161,6 +195,23 @@ class AudioController {
   }
 
   Future<void> load(String path, {String? bookmark}) async {
+    _queuedIndex = null;
+    final resolvedPath = await _resolvePlayablePath(path, bookmark);
+    state.value = state.value.copyWith(
+      updateEngineMetadata: true,
+      engineMetadata: null,
+    );
+    await _run(
+      'load',
+      () => _channel.invokeMethod('load', {'path': resolvedPath}),
+    );
+    _markLoaded();
+    await _refreshEngineMetadata();
+  }
+
+  /// Starts security-scoped access for [path] where needed and returns the
+  /// path the engine should open.
+  Future<String> _resolvePlayablePath(String path, String? bookmark) async {
     var resolvedBookmark = await _resolveBookmark(path, bookmark);
     final access = await SecurityScopedBookmarks.startAccess(
       path: path,
@@ -181,16 +232,7 @@ class AudioController {
         await _persistBookmark(path, created);
       }
     }
-    state.value = state.value.copyWith(
-      updateEngineMetadata: true,
-      engineMetadata: null,
-    );
-    await _run(
-      'load',
-      () => _channel.invokeMethod('load', {'path': resolvedPath}),
-    );
-    _markLoaded();
-    await _refreshEngineMetadata();
+    return resolvedPath;
   }
 
   Future<void> play() async {
@@ -207,6 +249,7 @@ class AudioController {
   }
 
   Future<void> stop() async {
+    _queuedIndex = null;
     await _run('stop', () => _channel.invokeMethod('stop'));
     state.value = state.value.copyWith(
       hasFile: false,
@@ -251,6 +294,173 @@ class AudioController {
     await _channel.invokeMethod('setVolume', {'value': clamped});
   }
 
+  double get playbackRate => _playbackRate;
+
+  /// Playback speed from 0.5x to 3x with the pitch kept, for audiobooks and
+  /// lectures. Stays in effect across tracks. Engines without a time-stretch
+  /// stage keep playing at 1x.
+  Future<void> setPlaybackRate(double rate) async {
+    final clamped = rate.clamp(0.5, 3.0).toDouble();
+    try {
+      await _channel.invokeMethod('setPlaybackRate', {'rate': clamped});
+    } on MissingPluginException {
+      return;
+    } catch (error) {
+      debugPrint('Failed to set playback rate: $error');
+      return;
+    }
+    // Settle the position at the old rate before the ticker uses the new one.
+    _tickPosition();
+    _playbackRate = clamped;
+    unawaited(
+      MediaSession.instance
+          .updatePlaybackState(
+            MediaSessionPlaybackState(
+              status: state.value.isPlaying
+                  ? MediaSessionPlaybackStatus.playing
+                  : MediaSessionPlaybackStatus.paused,
+              durationMs: state.value.duration.inMilliseconds,
+              playbackRate: clamped,
+            ),
+          )
+          .catchError((Object error) {
+            debugPrint('Failed to report playback rate: $error');
+          }),
+    );
+  }
+
+  /// Gapless playback: encoder delay and padding are trimmed and the next
+  /// track is queued in the engine, so it follows without a gap. On by
+  /// default.
+  Future<void> setGapless(bool enabled) async {
+    _gapless = enabled;
+    if (!enabled) _queuedIndex = null;
+    try {
+      await _channel.invokeMethod('setGapless', {'enabled': enabled});
+    } on MissingPluginException {
+      // Engine without gapless support; tracks load one after another.
+    } catch (error) {
+      debugPrint('Failed to set gapless mode: $error');
+    }
+  }
+
+  /// Measures the loudness of [tracks] in the background so untagged files
+  /// normalize like tagged ones. Results are cached by the engine; tracks
+  /// already measured are skipped.
+  Future<void> scanLoudness(List<PlaybackTrack> tracks) async {
+    if (tracks.isEmpty) return;
+    try {
+      await _channel.invokeMethod('scanLoudness', {
+        'tracks': [
+          for (final track in tracks)
+            {'path': track.path, 'album': track.metadata.album},
+        ],
+      });
+    } on MissingPluginException {
+      // Engine without a loudness scan; tags alone drive normalization.
+    } catch (error) {
+      debugPrint('Failed to start loudness scan: $error');
+    }
+  }
+
+  Future<void> cancelLoudnessScan() async {
+    try {
+      await _channel.invokeMethod('cancelLoudnessScan');
+    } on MissingPluginException {
+      // Nothing to cancel.
+    }
+  }
+
+  /// Measured loudness of [path], or null until the scan has reached it.
+  Future<EngineTrackLoudness?> trackLoudness(String path) async {
+    try {
+      final raw = await _channel.invokeMapMethod<String, dynamic>(
+        'trackLoudness',
+        {'path': path},
+      );
+      return raw == null ? null : EngineTrackLoudness.fromJson(raw);
+    } on MissingPluginException {
+      return null;
+    }
+  }
+
+  /// Analyses tempo, key and energy of [paths] in the background for the
+  /// mood engine. Results are cached by the engine; tracks already analysed
+  /// are skipped.
+  Future<void> scanFeatures(List<String> paths) async {
+    if (paths.isEmpty) return;
+    try {
+      await _channel.invokeMethod('scanFeatures', {'paths': paths});
+    } on MissingPluginException {
+      // Engine without a feature scan; moods fall back to metadata alone.
+    } catch (error) {
+      debugPrint('Failed to start feature scan: $error');
+    }
+  }
+
+  Future<void> cancelFeatureScan() async {
+    try {
+      await _channel.invokeMethod('cancelFeatureScan');
+    } on MissingPluginException {
+      // Nothing to cancel.
+    }
+  }
+
+  /// Analysed features of [path], or null until the scan has reached it.
+  Future<EngineTrackFeatures?> trackFeatures(String path) async {
+    try {
+      final raw = await _channel.invokeMapMethod<String, dynamic>(
+        'trackFeatures',
+        {'path': path},
+      );
+      return raw == null ? null : EngineTrackFeatures.fromJson(raw);
+    } on MissingPluginException {
+      return null;
+    }
+  }
+
+  /// Output format, render counters and per-channel meters. Cheap enough to
+  /// poll at a meter's frame rate; null on engines without a status report.
+  Future<EnginePcmStatus?> pcmStatus() async {
+    try {
+      final raw = await _channel.invokeMapMethod<String, dynamic>('pcmStatus');
+      return raw == null ? null : EnginePcmStatus.fromJson(raw);
+    } on MissingPluginException {
+      return null;
+    }
+  }
+
+  /// Starts or stops the engine's spectrum analyzer. Off by default; turn it
+  /// off when no visualizer is on screen.
+  Future<void> setSpectrumEnabled(bool enabled) async {
+    try {
+      await _channel.invokeMethod('setSpectrumEnabled', {'enabled': enabled});
+    } on MissingPluginException {
+      // Engine without a spectrum analyzer.
+    }
+  }
+
+  /// Newest spectrum frame, or null if none was published since the last
+  /// call. Meant to be polled at the visualizer's frame rate.
+  Future<EngineSpectrumFrame?> spectrum() async {
+    try {
+      final raw = await _channel.invokeMapMethod<String, dynamic>('spectrum');
+      return raw == null ? null : EngineSpectrumFrame.fromJson(raw);
+    } on MissingPluginException {
+      return null;
+    }
+  }
+
+  /// Centre frequency in Hz of each band in [spectrum]'s frames.
+  Future<List<double>> spectrumBandCenters() async {
+    try {
+      final raw = await _channel.invokeListMethod<num>('spectrumBands');
+      return [for (final hz in raw ?? const <num>[]) hz.toDouble()];
+    } on MissingPluginException {
+      return const [];
+    }
+  }
+
   Future<Map<String, dynamic>> extractMetadata(String path) async {
     try {
       final result = await _channel.invokeMapMethod<String, dynamic>(
@@ -276,6 +486,8 @@ class AudioController {
       currentIndex: _currentIndex,
     );
     _saveState();
+    unawaited(scanLoudness(_queue));
+    unawaited(scanFeatures([for (final track in _queue) track.path]));
   }
 
   Future<void> playAt(int index, {String? overridePath}) async {
@@ -296,6 +508,69 @@ class AudioController {
     );
     await play();
     _saveState();
+    unawaited(_prepareNext());
+  }
+
+  /// Queue index that plays after the current one when it ends, or null when
+  /// it cannot be known in advance (shuffle, end of a sequence).
+  int? _predictedNextIndex() {
+    final current = _currentIndex;
+    if (_queue.isEmpty || current == null) return null;
+    switch (_playbackMode) {
+      case PlayMode.single:
+        return current;
+      case PlayMode.loop:
+        return (current + 1) % _queue.length;
+      case PlayMode.sequence:
+        final next = current + 1;
+        return next < _queue.length ? next : null;
+      case PlayMode.shuffle:
+        return null;
+    }
+  }
+
+  /// Queues the predicted next track in the engine when gapless playback is
+  /// on, and otherwise (or when the engine refuses it, e.g. for a different
+  /// sample rate) preloads it for the load at the end of this one.
+  Future<void> _prepareNext() async {
+    if (_gapless && await _queueNext()) return;
+    await _preloadNext();
+  }
+
+  Future<bool> _queueNext() async {
+    final index = _predictedNextIndex();
+    if (index == null) return false;
+    final track = _queue[index];
+    try {
+      final path = await _resolvePlayablePath(track.path, track.bookmark);
+      await _channel.invokeMethod('queueNext', {'path': path});
+      _queuedIndex = index;
+      return true;
+    } on MissingPluginException {
+      return false;
+    } on PlatformException catch (error) {
+      debugPrint('Not queueing ${track.path}: ${error.message}');
+      return false;
+    } catch (error) {
+      debugPrint('Failed to queue ${track.path}: $error');
+      return false;
+    }
+  }
+
+  /// Asks the engine to open the next track in the background so switching
+  /// to it skips the open and probe. Best effort; failures are only logged.
+  Future<void> _preloadNext() async {
+    final index = _predictedNextIndex();
+    if (index == null) return;
+    final track = _queue[index];
+    try {
+      final path = await _resolvePlayablePath(track.path, track.bookmark);
+      await _channel.invokeMethod('preloadNext', {'path': path});
+    } on MissingPluginException {
+      // Engine without preloading; the next load opens the track itself.
+    } catch (error) {
+      debugPrint('Failed to preload ${track.path}: $error');
+    }
   }
 
   Future<void> playNext() async {
@@ -430,7 +705,7 @@ class AudioController {
     final now = DateTime.now();
     final elapsed = now.difference(_lastTick ?? now);
     _lastTick = now;
-    var newPosition = current.position + elapsed;
+    var newPosition = current.position + elapsed * _playbackRate;
     final duration = current.duration;
     final hasDuration = duration > Duration.zero;
     final reachedEnd = hasDuration && newPosition >= duration;
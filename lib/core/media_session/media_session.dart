@@ -52,6 +52,7 @@ class MediaSessionPlaybackState {
 }
 
 typedef MediaSessionActionCallback = void Function();
+typedef MediaSessionRateCallback = void Function(double rate);
 
 class MediaSession {
   MediaSession._({
@@ -77,6 +78,10 @@ class MediaSession {
   MediaSessionActionCallback? onNext;
   MediaSessionActionCallback? onPrevious;
 
+  /// Speed picked in the system media flyout. The app applies it and reports
+  /// it back with [updatePlaybackState].
+  MediaSessionRateCallback? onPlaybackRate;
+
   Future<void> updateMetadata(MediaSessionMetadata metadata) async {
     final channel = _channel;
     if (channel == null) return;
@@ -106,6 +111,7 @@ class MediaSession {
     onPause = null;
     onNext = null;
     onPrevious = null;
+    onPlaybackRate = null;
   }
 
   Future<void> _handleMethodCall(MethodCall call) async {
@@ -122,6 +128,11 @@ class MediaSession {
       case 'onPrevious':
         onPrevious?.call();
         break;
+      case 'onPlaybackRate':
+        final args = call.arguments;
+        final rate = args is Map ? args['rate'] : null;
+        if (rate is num) onPlaybackRate?.call(rate.toDouble());
+        break;
       default:
         throw MissingPluginException();
     }
@@ -121,6 +121,198 @@ class EngineTrackReplayGain {
       trackGainDb != null || albumGainDb != null || r128TrackGain != null;
 }
 
+/// EBU R128 measurement from the engine's library loudness scan.
+class EngineTrackLoudness {
+  const EngineTrackLoudness({
+    required this.integratedLufs,
+    required this.loudnessRangeLu,
+    required this.truePeak,
+  });
+
+  final double integratedLufs;
+  final double loudnessRangeLu;
+
+  /// Linear, 4x oversampled.
+  final double truePeak;
+
+  factory EngineTrackLoudness.fromJson(Map<String, dynamic> json) {
+    return EngineTrackLoudness(
+      integratedLufs: (json['integratedLufs'] as num?)?.toDouble() ?? 0,
+      loudnessRangeLu: (json['loudnessRangeLu'] as num?)?.toDouble() ?? 0,
+      truePeak: (json['truePeak'] as num?)?.toDouble() ?? 0,
+    );
+  }
+}
+
+/// Tempo, key, energy and spectral shape from the engine's library feature
+/// scan, used by the mood engine.
+class EngineTrackFeatures {
+  const EngineTrackFeatures({
+    required this.bpm,
+    required this.tempoConfidence,
+    required this.key,
+    required this.minor,
+    required this.keyConfidence,
+    required this.energy,
+    required this.danceability,
+    required this.rmsDb,
+    required this.onsetRate,
+    required this.spectralCentroidHz,
+    required this.spectralSpreadHz,
+    required this.spectralRolloffHz,
+    required this.spectralFlatness,
+  });
+
+  /// 0 when there is no steady pulse.
+  final double bpm;
+
+  /// 0 no pulse, 1 perfectly periodic.
+  final double tempoConfidence;
+
+  /// Pitch class of the tonic, 0 = C to 11 = B; -1 when nothing tonal was
+  /// heard.
+  final int key;
+  final bool minor;
+
+  /// 0-1.
+  final double keyConfidence;
+
+  /// 0-1.
+  final double energy;
+
+  /// 0-1.
+  final double danceability;
+
+  /// Mean level of the mono downmix in dBFS.
+  final double rmsDb;
+
+  /// Onsets per second.
+  final double onsetRate;
+  final double spectralCentroidHz;
+  final double spectralSpreadHz;
+  final double spectralRolloffHz;
+
+  /// Near 0 for tones, towards 1 for noise.
+  final double spectralFlatness;
+
+  static const _pitchClasses = [
+    'C', 'C#', 'D', 'D#', 'E', 'F', 'F#', 'G', 'G#', 'A', 'A#', 'B',
+  ];
+
+  /// "A minor", "C major", or null when no key was found.
+  String? get keyName {
+    if (key < 0 || key >= _pitchClasses.length) return null;
+    return '${_pitchClasses[key]} ${minor ? 'minor' : 'major'}';
+  }
+
+  factory EngineTrackFeatures.fromJson(Map<String, dynamic> json) {
+    double value(String key, [double fallback = 0]) =>
+        (json[key] as num?)?.toDouble() ?? fallback;
+
+    return EngineTrackFeatures(
+      bpm: value('bpm'),
+      tempoConfidence: value('tempoConfidence'),
+      key: (json['key'] as num?)?.toInt() ?? -1,
+      minor: json['minor'] as bool? ?? false,
+      keyConfidence: value('keyConfidence'),
+      energy: value('energy'),
+      danceability: value('danceability'),
+      rmsDb: value('rmsDb', -120),
+      onsetRate: value('onsetRate'),
+      spectralCentroidHz: value('spectralCentroidHz'),
+      spectralSpreadHz: value('spectralSpreadHz'),
+      spectralRolloffHz: value('spectralRolloffHz'),
+      spectralFlatness: value('spectralFlatness'),
+    );
+  }
+}
+
+/// One frame of the engine's output spectrum.
+class EngineSpectrumFrame {
+  const EngineSpectrumFrame({required this.levelsDb});
+
+  /// Lowest band first, in dBFS; a full-scale sine reads 0 dB in its band.
+  final List<double> levelsDb;
+
+  factory EngineSpectrumFrame.fromJson(Map<String, dynamic> json) {
+    final levels = json['levelsDb'] as List<dynamic>? ?? const [];
+    return EngineSpectrumFrame(
+      levelsDb: List.unmodifiable(levels.map((v) => (v as num).toDouble())),
+    );
+  }
+}
+
+/// Per-channel output meters, in dBFS, one value per output channel.
+class EngineLevelReading {
+  const EngineLevelReading({
+    required this.peakDb,
+    required this.peakHoldDb,
+    required this.rmsDb,
+    required this.truePeakDb,
+    required this.maxTruePeakDb,
+  });
+
+  final List<double> peakDb;
+  final List<double> peakHoldDb;
+
+  /// A full-scale sine reads -3 dB.
+  final List<double> rmsDb;
+
+  /// 4x oversampled; at the floor while true peak metering is off.
+  final List<double> truePeakDb;
+
+  /// Highest true peak since playback last stopped.
+  final List<double> maxTruePeakDb;
+
+  factory EngineLevelReading.fromJson(Map<String, dynamic> json) {
+    List<double> channels(String key) {
+      final values = json[key] as List<dynamic>? ?? const [];
+      return List.unmodifiable(values.map((v) => (v as num).toDouble()));
+    }
+
+    return EngineLevelReading(
+      peakDb: channels('peakDb'),
+      peakHoldDb: channels('peakHoldDb'),
+      rmsDb: channels('rmsDb'),
+      truePeakDb: channels('truePeakDb'),
+      maxTruePeakDb: channels('maxTruePeakDb'),
+    );
+  }
+}
+
+/// Output format and render counters reported by `pcmStatus`.
+class EnginePcmStatus {
+  const EnginePcmStatus({
+    required this.sampleRate,
+    required this.channels,
+    required this.bitDepth,
+    required this.renderedFrames,
+    required this.underflows,
+    this.levels,
+  });
+
+  final double sampleRate;
+  final int channels;
+  final int bitDepth;
+  final int renderedFrames;
+  final int underflows;
+
+  /// Null on engines without output meters.
+  final EngineLevelReading? levels;
+
+  factory EnginePcmStatus.fromJson(Map<String, dynamic> json) {
+    final levelsRaw = (json['levels'] as Map?)?.cast<String, dynamic>();
+    return EnginePcmStatus(
+      sampleRate: (json['sampleRate'] as num?)?.toDouble() ?? 0,
+      channels: (json['channels'] as num?)?.toInt() ?? 0,
+      bitDepth: (json['bitDepth'] as num?)?.toInt() ?? 0,
+      renderedFrames: (json['renderedFrames'] as num?)?.toInt() ?? 0,
+      underflows: (json['underflows'] as num?)?.toInt() ?? 0,
+      levels: levelsRaw == null ? null : EngineLevelReading.fromJson(levelsRaw),
+    );
+  }
+}
+
 class EngineTrackMetadata {
   EngineTrackMetadata({
     required this.url,
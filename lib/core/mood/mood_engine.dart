@@ -1,5 +1,7 @@
 import 'package:flutter/services.dart';
 
+import '../model/engine_track_models.dart';
+
 const _kMoodEngineChannel = 'mood_engine';
 const _kCollectSignalsMethod = 'collectSignals';
 
@@ -120,3 +122,21 @@ enum MoodAppearanceMode { light, dark }
 enum MoodNetworkType { wifi, cellular, ethernet, offline, unknown }
 
 enum MoodNetworkQuality { good, average, poor, unknown }
+
+/// Coarse character of a track, matched against [MoodSignals] when picking
+/// music for the moment.
+enum TrackMood { energetic, upbeat, calm, melancholic, intense }
+
+/// Classifies a track from the engine's feature scan: energy sets the
+/// level, the mode leans it brighter or darker, and a steady danceable
+/// pulse lifts the middle ground. Null when the scan heard nothing.
+TrackMood? trackMoodFor(EngineTrackFeatures features) {
+  if (features.energy <= 0 && features.bpm <= 0) return null;
+  if (features.energy >= 0.6) {
+    return features.minor ? TrackMood.intense : TrackMood.energetic;
+  }
+  if (features.energy >= 0.35 && features.danceability >= 0.5) {
+    return TrackMood.upbeat;
+  }
+  return features.minor ? TrackMood.melancholic : TrackMood.calm;
+}
@@ -1,10 +1,15 @@
 #include "AudioEngine.h"
 
+#include "AudioEngineCore/PrebufferedSource.h"
+
 #include <android/log.h>
+#include <sys/stat.h>
 #include <algorithm>
+#include <cerrno>
 #include <chrono>
 #include <cstdlib>
 #include <cmath>
+#include <utility>
 
 #define LOG_TAG "AudioEngineAndroid"
 #define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
@@ -12,6 +17,14 @@
 
 namespace {
 
+// Pre-decoded by PreloadNext(); covers the start of the next track while its
+// decode thread gets going.
+constexpr double kPreloadSeconds = 2.0;
+// Upper bound on waiting for AAudio to acknowledge a stop.
+constexpr int64_t kStopTimeoutNanos = 200 * 1000 * 1000;
+// Output channels when the device cannot be probed; every route plays stereo.
+constexpr uint32_t kFallbackChannels = 2;
+
 int BitDepthFromSampleFormat(AVSampleFormat fmt) {
   switch (fmt) {
     case AV_SAMPLE_FMT_U8:
@@ -46,22 +59,6 @@ double PCMBitrateKbps(int sampleRate, int channels, int bitDepth) {
   return (sampleRate * channels * bitDepth) / 1000.0;
 }
 
-AVChannelLayout EnsureLayout(const AVStream* stream) {
-  if (stream->codecpar->ch_layout.nb_channels > 0) {
-    return stream->codecpar->ch_layout;
-  }
-  AVChannelLayout layout{};
-  av_channel_layout_default(&layout, stream->codecpar->channels);
-  return layout;
-}
-
-AVChannelLayout EnsureLayoutCtx(const AVCodecContext* ctx) {
-  if (ctx->ch_layout.nb_channels > 0) return ctx->ch_layout;
-  AVChannelLayout layout{};
-  av_channel_layout_default(&layout, ctx->channels);
-  return layout;
-}
-
 // JNI helpers
 jobject MakeHashMap(JNIEnv* env) {
   jclass cls = env->FindClass("java/util/HashMap");
@@ -160,17 +157,76 @@ AudioEngine::AudioEngine() {
 }
 
 AudioEngine::~AudioEngine() {
-  Stop();
+  {
+    std::lock_guard<std::mutex> lock(decoderMutex_);
+    StopLocked();
+  }
   avformat_network_deinit();
 }
 
 void AudioEngine::SetJavaVM(JavaVM* vm) { jvm_ = vm; }
 
+void AudioEngine::SetCacheDir(const std::string& dir) {
+  std::lock_guard<std::mutex> lock(decoderMutex_);
+  // Set once per process; a loaded source may already point at the indexer.
+  if (dir.empty() || seekIndexer_) return;
+  const std::string indexDir = dir + "/seekindex";
+  if (mkdir(indexDir.c_str(), 0700) != 0 && errno != EEXIST) {
+    LOGE("Cannot create %s: %d", indexDir.c_str(), errno);
+    seekIndexer_.reset();
+    return;
+  }
+  seekIndexer_ = std::make_unique<audioengine::SeekIndexer>(
+      indexDir, &FFmpegPcmSource::BuildSeekIndex);
+  loudnessScanner_ = std::make_unique<audioengine::LoudnessScanner>(
+      indexDir, [](const std::string& path) -> std::unique_ptr<audioengine::PcmSource> {
+        auto decoder = std::make_unique<FFmpegPcmSource>();
+        if (!decoder->Open(path, false)) return nullptr;
+        return decoder;
+      });
+  // Overviews only look at the front pair, so wider files are downmixed in
+  // the converter; the rate is the file's own.
+  waveformScanner_ = std::make_unique<audioengine::WaveformScanner>(
+      indexDir, [](const std::string& path) -> std::unique_ptr<audioengine::PcmSource> {
+        auto decoder = std::make_unique<FFmpegPcmSource>();
+        if (!decoder->Open(path, false, audioengine::WaveformBuilder::kMaxChannels)) {
+          return nullptr;
+        }
+        return decoder;
+      });
+  waveforms_.store(waveformScanner_.get());
+  // Features are taken from a mono downmix, so the same front pair is enough.
+  featureScanner_ = std::make_unique<audioengine::FeatureScanner>(
+      indexDir, [](const std::string& path) -> std::unique_ptr<audioengine::PcmSource> {
+        auto decoder = std::make_unique<FFmpegPcmSource>();
+        if (!decoder->Open(path, false, audioengine::WaveformBuilder::kMaxChannels)) {
+          return nullptr;
+        }
+        return decoder;
+      });
+}
+
 bool AudioEngine::Load(const std::string& path) {
   std::lock_guard<std::mutex> lock(decoderMutex_);
-  Stop();
-  if (!OpenDecoder(path)) return false;
-  if (!InitResampler()) return false;
+  PreparedTrack track;
+  if (!TakeOrPrepareTrack(path, &track)) {
+    StopLocked();
+    return false;
+  }
+  if (stream_ && track.sampleRate == outputSampleRate_ &&
+      track.channels == outputChannels_) {
+    // Same output format: keep the stream and only swap the source.
+    playing_.store(false);
+    if (StopOutputStream()) meter_.Reset();
+    CloseDecoder();
+    // Do not let the old track's tail out of the limiter's delay line, or
+    // out of the time stretcher.
+    limiterResetPending_.store(true);
+    stretcherResetPending_.store(true);
+  } else {
+    StopLocked();
+  }
+  if (!OpenDecoder(std::move(track))) return false;
   if (!InitOutputStream()) return false;
   currentPath_ = path;
   reachedEof_.store(false);
@@ -180,6 +236,10 @@ bool AudioEngine::Load(const std::string& path) {
 
 bool AudioEngine::Play() {
   std::lock_guard<std::mutex> lock(decoderMutex_);
+  return PlayLocked();
+}
+
+bool AudioEngine::PlayLocked() {
   if (!stream_) {
     if (!InitOutputStream()) return false;
   }
@@ -202,36 +262,50 @@ bool AudioEngine::Pause() {
     return false;
   }
   playing_.store(false);
+  // The meters hold their last reading while no callback runs; drop them
+  // once it has returned for good.
+  aaudio_stream_state_t state = AAUDIO_STREAM_STATE_PAUSING;
+  AAudioStream_waitForStateChange(stream_, AAUDIO_STREAM_STATE_PAUSING,
+                                  &state, kStopTimeoutNanos);
+  if (state != AAUDIO_STREAM_STATE_PAUSING) meter_.Reset();
   return true;
 }
 
 bool AudioEngine::Stop() {
-  {
-    std::lock_guard<std::mutex> lock(decoderMutex_);
-    playing_.store(false);
-    if (stream_) {
-      AAudioStream_requestStop(stream_);
-      CloseOutputStream();
-    }
-    CloseDecoder();
-  }
+  std::lock_guard<std::mutex> lock(decoderMutex_);
+  // The stream stays open: the app stops before loading the next track, and
+  // Load() reuses it when the format matches.
+  playing_.store(false);
+  if (StopOutputStream()) meter_.Reset();
+  CloseDecoder();
   return true;
 }
 
+void AudioEngine::StopLocked() {
+  playing_.store(false);
+  // Close the output first so the callback is no longer reading the ring.
+  if (stream_) {
+    AAudioStream_requestStop(stream_);
+    CloseOutputStream();
+    meter_.Reset();
+  }
+  CloseDecoder();
+}
+
 bool AudioEngine::SeekMs(int64_t positionMs) {
   std::lock_guard<std::mutex> lock(decoderMutex_);
-  if (!fmtCtx_ || audioStreamIndex_ < 0) return false;
-  AVStream* stream = fmtCtx_->streams[audioStreamIndex_];
-  int64_t ts = av_rescale_q(positionMs, AVRational{1, 1000}, stream->time_base);
-  int flags = AVSEEK_FLAG_BACKWARD;
-  int ret = av_seek_frame(fmtCtx_, audioStreamIndex_, ts, flags);
-  if (ret < 0) {
-    LOGE("av_seek_frame failed: %d", ret);
-    return false;
-  }
-  avcodec_flush_buffers(codecCtx_);
-  resampledOffset_ = 0;
-  resampledFrames_ = 0;
+  if (!streamer_.IsActive() || outputSampleRate_ <= 0) return false;
+  CollectTrackChangeLocked();
+  const uint64_t frame = static_cast<uint64_t>(
+      av_rescale(std::max<int64_t>(positionMs, 0), outputSampleRate_, 1000));
+  // Safe while the callback keeps reading; it sees silence until the ring
+  // refills from the new position.
+  if (!streamer_.Seek(frame)) return false;
+  stretcherResetPending_.store(true);
+  LOGI("Seek to %lld ms landed at frame %llu in %lld us",
+       static_cast<long long>(positionMs),
+       static_cast<unsigned long long>(streamer_.PositionFrames()),
+       static_cast<long long>(streamer_.LastSeekDuration().count()));
   reachedEof_.store(false);
   return true;
 }
@@ -240,16 +314,197 @@ bool AudioEngine::SetVolume(double volume) {
   if (volume < 0.0) volume = 0.0;
   if (volume > 1.0) volume = 1.0;
   volume_.store(volume);
+  streamer_.SetOutputGain(static_cast<float>(volume));
   return true;
 }
 
 double AudioEngine::GetVolume() const { return volume_.load(); }
 
-AudioEngine::PCMInfo AudioEngine::CurrentPCMInfo() const { return currentPCM_; }
+void AudioEngine::SetNormalization(audioengine::NormalizationMode mode,
+                                   double preampDb) {
+  std::lock_guard<std::mutex> lock(decoderMutex_);
+  CollectTrackChangeLocked();
+  normalization_ = mode;
+  preampDb_ = preampDb;
+  const bool enable = mode != audioengine::NormalizationMode::kOff;
+  if (enable && !limiterEnabled_.load()) limiterResetPending_.store(true);
+  limiterEnabled_.store(enable);
+  if (streamer_.IsActive()) {
+    streamer_.SetTrackGain(TrackGainLocked(currentReplayGain_));
+  }
+}
+
+audioengine::TruePeakLimiter::Stats AudioEngine::LimiterStats() const {
+  return limiter_.GetStats();
+}
+
+void AudioEngine::ScanLoudness(
+    const std::vector<std::pair<std::string, std::string>>& tracks) {
+  audioengine::LoudnessScanner* scanner = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(decoderMutex_);
+    scanner = loudnessScanner_.get();
+  }
+  if (!scanner) {
+    LOGE("Loudness scan needs a cache directory");
+    return;
+  }
+  std::vector<audioengine::LoudnessScanner::Item> items;
+  items.reserve(tracks.size());
+  for (const auto& [path, album] : tracks) {
+    struct stat st{};
+    if (stat(path.c_str(), &st) != 0) continue;
+    audioengine::LoudnessScanner::Item item;
+    item.key = {path, static_cast<uint64_t>(st.st_size),
+                static_cast<int64_t>(st.st_mtime)};
+    item.album = album;
+    items.push_back(std::move(item));
+  }
+  scanner->Enqueue(items);
+}
+
+void AudioEngine::CancelLoudnessScan() {
+  std::lock_guard<std::mutex> lock(decoderMutex_);
+  if (loudnessScanner_) loudnessScanner_->Cancel();
+}
+
+bool AudioEngine::TrackLoudnessFor(const std::string& path,
+                                   audioengine::TrackLoudness* result) {
+  std::lock_guard<std::mutex> lock(decoderMutex_);
+  if (!loudnessScanner_) return false;
+  if (loudnessScanner_->Track(path, result)) return true;
+  struct stat st{};
+  if (stat(path.c_str(), &st) != 0) return false;
+  return loudnessScanner_->LoadCached({path, static_cast<uint64_t>(st.st_size),
+                                       static_cast<int64_t>(st.st_mtime)},
+                                      result);
+}
+
+audioengine::LoudnessScanner::Stats AudioEngine::LoudnessScanStats() {
+  std::lock_guard<std::mutex> lock(decoderMutex_);
+  return loudnessScanner_ ? loudnessScanner_->GetStats()
+                          : audioengine::LoudnessScanner::Stats{};
+}
+
+void AudioEngine::GenerateWaveforms(const std::vector<std::string>& paths) {
+  audioengine::WaveformScanner* scanner = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(decoderMutex_);
+    scanner = waveformScanner_.get();
+  }
+  if (!scanner) {
+    LOGE("Waveforms need a cache directory");
+    return;
+  }
+  std::vector<audioengine::SeekIndex::Key> keys;
+  keys.reserve(paths.size());
+  for (const std::string& path : paths) {
+    struct stat st{};
+    if (stat(path.c_str(), &st) != 0) continue;
+    keys.push_back({path, static_cast<uint64_t>(st.st_size),
+                    static_cast<int64_t>(st.st_mtime)});
+  }
+  scanner->Enqueue(keys);
+}
+
+void AudioEngine::CancelWaveforms() {
+  std::lock_guard<std::mutex> lock(decoderMutex_);
+  if (waveformScanner_) waveformScanner_->Cancel();
+}
+
+std::shared_ptr<const audioengine::Waveform> AudioEngine::WaveformFor(
+    const std::string& path) const {
+  const audioengine::WaveformScanner* scanner = waveforms_.load();
+  struct stat st{};
+  if (!scanner || stat(path.c_str(), &st) != 0) return nullptr;
+  return scanner->Load({path, static_cast<uint64_t>(st.st_size),
+                        static_cast<int64_t>(st.st_mtime)});
+}
+
+audioengine::WaveformScanner::Stats AudioEngine::WaveformStats() {
+  std::lock_guard<std::mutex> lock(decoderMutex_);
+  return waveformScanner_ ? waveformScanner_->GetStats()
+                          : audioengine::WaveformScanner::Stats{};
+}
+
+void AudioEngine::ScanFeatures(const std::vector<std::string>& paths) {
+  audioengine::FeatureScanner* scanner = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(decoderMutex_);
+    scanner = featureScanner_.get();
+  }
+  if (!scanner) {
+    LOGE("Feature scan needs a cache directory");
+    return;
+  }
+  std::vector<audioengine::SeekIndex::Key> keys;
+  keys.reserve(paths.size());
+  for (const std::string& path : paths) {
+    struct stat st{};
+    if (stat(path.c_str(), &st) != 0) continue;
+    keys.push_back({path, static_cast<uint64_t>(st.st_size),
+                    static_cast<int64_t>(st.st_mtime)});
+  }
+  scanner->Enqueue(keys);
+}
+
+void AudioEngine::CancelFeatureScan() {
+  std::lock_guard<std::mutex> lock(decoderMutex_);
+  if (featureScanner_) featureScanner_->Cancel();
+}
+
+bool AudioEngine::TrackFeaturesFor(const std::string& path,
+                                   audioengine::TrackFeatures* result) {
+  std::lock_guard<std::mutex> lock(decoderMutex_);
+  if (!featureScanner_) return false;
+  if (featureScanner_->Track(path, result)) return true;
+  struct stat st{};
+  if (stat(path.c_str(), &st) != 0) return false;
+  return featureScanner_->LoadCached({path, static_cast<uint64_t>(st.st_size),
+                                      static_cast<int64_t>(st.st_mtime)},
+                                     result);
+}
+
+audioengine::FeatureScanner::Stats AudioEngine::FeatureScanStats() {
+  std::lock_guard<std::mutex> lock(decoderMutex_);
+  return featureScanner_ ? featureScanner_->GetStats()
+                         : audioengine::FeatureScanner::Stats{};
+}
+
+float AudioEngine::TrackGainLocked(const audioengine::ReplayGainTags& tags) const {
+  return audioengine::ResolveNormalization(normalization_, tags, preampDb_).gain;
+}
+
+AudioEngine::PCMInfo AudioEngine::CurrentPCMInfo() {
+  std::lock_guard<std::mutex> lock(decoderMutex_);
+  CollectTrackChangeLocked();
+  return currentPCM_;
+}
+
+std::string AudioEngine::CurrentPath() {
+  std::lock_guard<std::mutex> lock(decoderMutex_);
+  CollectTrackChangeLocked();
+  return currentPath_;
+}
 
-std::string AudioEngine::CurrentPath() const { return currentPath_; }
+int64_t AudioEngine::DurationMs() {
+  std::lock_guard<std::mutex> lock(decoderMutex_);
+  CollectTrackChangeLocked();
+  return durationMs_;
+}
 
-int64_t AudioEngine::DurationMs() const { return durationMs_; }
+int64_t AudioEngine::PositionMs() {
+  std::lock_guard<std::mutex> lock(decoderMutex_);
+  CollectTrackChangeLocked();
+  if (!streamer_.IsActive() || outputSampleRate_ <= 0) return 0;
+  uint64_t frames = streamer_.PositionFrames();
+  // Only the callback resets the stretcher; until it does, what it holds
+  // belongs to the old position.
+  if (!stretcherResetPending_.load()) {
+    frames -= std::min(frames, stretcher_.HeldFrames());
+  }
+  return av_rescale(static_cast<int64_t>(frames), 1000, outputSampleRate_);
+}
 
 jobject AudioEngine::ExtractMetadata(JNIEnv* env, const std::string& path) {
   AVFormatContext* ctx = nullptr;
@@ -386,140 +641,401 @@ void AudioEngine::SetOnPlaybackEnded(JNIEnv* env, jobject runnable) {
   }
 }
 
-bool AudioEngine::OpenDecoder(const std::string& path) {
-  CloseDecoder();
-  fmtCtx_ = avformat_alloc_context();
-  if (!fmtCtx_) return false;
-  if (avformat_open_input(&fmtCtx_, path.c_str(), nullptr, nullptr) < 0) {
-    LOGE("avformat_open_input failed");
-    CloseDecoder();
-    return false;
-  }
-  if (avformat_find_stream_info(fmtCtx_, nullptr) < 0) {
-    LOGE("avformat_find_stream_info failed");
-    CloseDecoder();
-    return false;
+bool AudioEngine::PrepareTrack(
+    const std::string& path, bool gapless, audioengine::SeekIndexer* indexer,
+    const audioengine::LoudnessScanner* loudness, const ChannelMixing& mixing,
+    uint32_t outputRate, audioengine::ResamplerQuality quality,
+    std::shared_ptr<const audioengine::ConvolutionFilter> convolution,
+    PreparedTrack* track) {
+  auto decoder = std::make_unique<FFmpegPcmSource>();
+  if (!decoder->Open(path, gapless)) return false;
+
+  struct stat st{};
+  const bool haveStat = stat(path.c_str(), &st) == 0;
+  const audioengine::SeekIndex::Key fileKey{
+      path, haveStat ? static_cast<uint64_t>(st.st_size) : 0,
+      haveStat ? static_cast<int64_t>(st.st_mtime) : 0};
+  if (indexer && decoder->WantsSeekIndex() && haveStat) {
+    indexer->Request(fileKey);
+    decoder->EnableSeekIndex(indexer, fileKey);
   }
-  audioStreamIndex_ = av_find_best_stream(fmtCtx_, AVMEDIA_TYPE_AUDIO, -1, -1,
-                                          nullptr, 0);
-  if (audioStreamIndex_ < 0) {
-    LOGE("No audio stream");
-    CloseDecoder();
-    return false;
+
+  // Owned by the source chain below; the pointers stay valid with it.
+  const FFmpegPcmSource& info = *decoder;
+  const AVFormatContext* fmtCtx = info.FormatContext();
+  const AVCodecContext* codecCtx = info.CodecContext();
+  const AVStream* stream = info.Stream();
+  const bool trimmed = !info.Gapless().Empty();
+  const uint32_t fileChannels = info.Format().channels;
+  track->replayGain = audioengine::ReadReplayGainTags([&](const char* key) -> const char* {
+    // Ogg keeps Vorbis comments on the stream, other containers on the file.
+    const AVDictionaryEntry* entry = av_dict_get(fmtCtx->metadata, key, nullptr, 0);
+    if (!entry) entry = av_dict_get(stream->metadata, key, nullptr, 0);
+    return entry ? entry->value : nullptr;
+  });
+  if (track->replayGain.Empty() && loudness) {
+    audioengine::TrackLoudness measured;
+    if (loudness->Track(path, &measured) ||
+        (haveStat && loudness->LoadCached(fileKey, &measured))) {
+      audioengine::AlbumLoudness album;
+      track->replayGain = audioengine::ReplayGainFromLoudness(
+          measured, loudness->AlbumOf(path, &album) ? &album : nullptr);
+    }
   }
-  AVStream* stream = fmtCtx_->streams[audioStreamIndex_];
-  const AVCodec* codec =
-      avcodec_find_decoder(stream->codecpar->codec_id);
-  if (!codec) {
-    LOGE("Decoder not found");
-    CloseDecoder();
-    return false;
+  track->source = std::move(decoder);
+  if (trimmed) {
+    track->source = std::make_unique<audioengine::TrimmingSource>(
+        std::move(track->source), info.Gapless());
   }
-  codecCtx_ = avcodec_alloc_context3(codec);
-  if (!codecCtx_) {
-    CloseDecoder();
-    return false;
+  // Before resampling and convolution, so they only run on the channels
+  // that are played.
+  audioengine::ChannelMatrix matrix;
+  if (mixing.matrix.Inputs() == fileChannels) {
+    matrix = mixing.matrix;
+  } else if (mixing.maxChannels != 0 && fileChannels > mixing.maxChannels) {
+    matrix = audioengine::ChannelMatrix::Downmix(
+        audioengine::ResolveLayout(info.ChannelLayout(), fileChannels),
+        audioengine::DefaultLayout(mixing.maxChannels), mixing.options);
   }
-  if (avcodec_parameters_to_context(codecCtx_, stream->codecpar) < 0) {
-    LOGE("parameters_to_context failed");
-    CloseDecoder();
-    return false;
+  if (!matrix.Empty() && !matrix.IsIdentity() &&
+      audioengine::ChannelMixingSource::CanMix(track->source->Format(), matrix)) {
+    track->source = std::make_unique<audioengine::ChannelMixingSource>(
+        std::move(track->source), matrix);
   }
-  if (avcodec_open2(codecCtx_, codec, nullptr) < 0) {
-    LOGE("avcodec_open2 failed");
-    CloseDecoder();
-    return false;
+  // After trimming, so the trim points stay in source frames. The PCM info
+  // below keeps describing the file.
+  if (outputRate != 0 &&
+      audioengine::ResamplingSource::CanResample(track->source->Format(), outputRate)) {
+    track->source = std::make_unique<audioengine::ResamplingSource>(
+        std::move(track->source), outputRate, quality);
   }
-  frame_ = av_frame_alloc();
-  packet_ = av_packet_alloc();
-  if (!frame_ || !packet_) {
-    LOGE("Frame/packet alloc failed");
-    CloseDecoder();
-    return false;
+  if (convolution) {
+    const audioengine::PcmFormat format = track->source->Format();
+    if (convolution->SampleRate() != format.sampleRate) {
+      convolution = audioengine::ConvolutionFilter::Create(convolution->Fir(),
+                                                           format.sampleRate);
+    }
+    if (convolution &&
+        audioengine::ConvolvingSource::CanConvolve(format, *convolution)) {
+      track->source = std::make_unique<audioengine::ConvolvingSource>(
+          std::move(track->source), std::move(convolution));
+    }
   }
 
-  durationMs_ = 0;
-  if (stream->duration > 0) {
-    durationMs_ =
+  const audioengine::PcmFormat out = track->source->Format();
+  track->path = path;
+  track->sampleRate = static_cast<int>(out.sampleRate);
+  track->channels = static_cast<int>(out.channels);
+
+  track->durationMs = 0;
+  const uint64_t totalFrames = track->source->TotalFrames();
+  if (trimmed && out.sampleRate > 0 && totalFrames > 0) {
+    // Container durations still count the trimmed delay and padding.
+    track->durationMs = static_cast<int64_t>(totalFrames * 1000 / out.sampleRate);
+  } else if (stream->duration > 0) {
+    track->durationMs =
         static_cast<int64_t>(stream->duration *
                              av_q2d(stream->time_base) * 1000.0 + 0.5);
-  } else if (fmtCtx_->duration > 0) {
-    durationMs_ = fmtCtx_->duration / 1000;
+  } else if (fmtCtx->duration > 0) {
+    track->durationMs = fmtCtx->duration / 1000;
   }
-  startTimeUs_ = (stream->start_time == AV_NOPTS_VALUE)
-                     ? 0
-                     : av_rescale_q(stream->start_time, stream->time_base,
-                                    AVRational{1, 1000000});
+  track->startTimeUs = (stream->start_time == AV_NOPTS_VALUE)
+                           ? 0
+                           : av_rescale_q(stream->start_time, stream->time_base,
+                                          AVRational{1, 1000000});
 
-  AVSampleFormat sampleFmt = codecCtx_->sample_fmt;
-  int channels = EnsureLayoutCtx(codecCtx_).nb_channels;
-  int sampleRate = codecCtx_->sample_rate;
+  AVSampleFormat sampleFmt = codecCtx->sample_fmt;
+  int channels = static_cast<int>(fileChannels);
+  int sampleRate = codecCtx->sample_rate;
   int bitDepth = BitDepthFromSampleFormat(sampleFmt);
-  currentPCM_.formatLabel =
-      codecCtx_->codec && codecCtx_->codec->long_name
-          ? codecCtx_->codec->long_name
+  PCMInfo& pcm = track->pcm;
+  pcm.formatLabel =
+      codecCtx->codec && codecCtx->codec->long_name
+          ? codecCtx->codec->long_name
           : "audio";
-  currentPCM_.bitrateKbps = PCMBitrateKbps(sampleRate, channels, bitDepth);
-  currentPCM_.sampleRate = sampleRate;
-  currentPCM_.channels = channels;
-  currentPCM_.bitDepth = bitDepth;
-  currentPCM_.channelDescription = ChannelDescription(channels);
+  pcm.bitrateKbps = PCMBitrateKbps(sampleRate, channels, bitDepth);
+  pcm.sampleRate = sampleRate;
+  pcm.channels = channels;
+  pcm.bitDepth = bitDepth;
+  pcm.channelDescription = ChannelDescription(channels);
   const char* fmtName = av_get_sample_fmt_name(sampleFmt);
-  currentPCM_.sampleFormatName = fmtName ? fmtName : "unknown";
+  pcm.sampleFormatName = fmtName ? fmtName : "unknown";
+  return true;
+}
+
+void AudioEngine::ApplyTrack(const PreparedTrack& track) {
+  currentPath_ = track.path;
+  durationMs_ = track.durationMs;
+  startTimeUs_ = track.startTimeUs;
+  outputSampleRate_ = track.sampleRate;
+  outputChannels_ = track.channels;
+  currentPCM_ = track.pcm;
+  currentReplayGain_ = track.replayGain;
+}
+
+bool AudioEngine::TakeOrPrepareTrack(const std::string& path,
+                                     PreparedTrack* track) {
+  if (preloader_.Take(path, track)) return true;
+  return PrepareTrack(path, gapless_, seekIndexer_.get(), loudnessScanner_.get(),
+                      ChannelMixingLocked(), ResampleRateLocked(), resampleQuality_,
+                      convolution_, track);
+}
+
+uint32_t AudioEngine::ResampleRateLocked() {
+  if (!resample_) return 0;
+  ProbeDeviceLocked();
+  return deviceSampleRate_ > 0 ? static_cast<uint32_t>(deviceSampleRate_) : 0;
+}
+
+AudioEngine::ChannelMixing AudioEngine::ChannelMixingLocked() {
+  ProbeDeviceLocked();
+  ChannelMixing mixing;
+  mixing.maxChannels =
+      deviceChannels_ > 0 ? static_cast<uint32_t>(deviceChannels_) : kFallbackChannels;
+  if (maxChannels_ > 0) {
+    mixing.maxChannels = std::min(mixing.maxChannels, static_cast<uint32_t>(maxChannels_));
+  }
+  mixing.options = downmix_;
+  mixing.matrix = channelMatrix_;
+  return mixing;
+}
+
+void AudioEngine::ProbeDeviceLocked() {
+  if (deviceSampleRate_ > 0) return;
+  int32_t rate = 0;
+  int32_t channels = 0;
+  if (ProbeDeviceFormat(&rate, &channels)) {
+    deviceSampleRate_ = rate;
+    deviceChannels_ = channels;
+  }
+}
+
+bool AudioEngine::ProbeDeviceFormat(int32_t* sampleRate, int32_t* channels) {
+  AAudioStreamBuilder* builder = nullptr;
+  if (AAudio_createStreamBuilder(&builder) != AAUDIO_OK || !builder) return false;
+  // Same sharing and performance mode as the real stream, which is what
+  // decides whether the mixer resamples.
+  AAudioStreamBuilder_setFormat(builder, AAUDIO_FORMAT_PCM_FLOAT);
+  AAudioStreamBuilder_setSharingMode(builder, AAUDIO_SHARING_MODE_SHARED);
+  AAudioStreamBuilder_setPerformanceMode(builder,
+                                         AAUDIO_PERFORMANCE_MODE_LOW_LATENCY);
+  AAudioStreamBuilder_setUsage(builder, AAUDIO_USAGE_MEDIA);
+  AAudioStreamBuilder_setContentType(builder, AAUDIO_CONTENT_TYPE_MUSIC);
+  AAudioStream* probe = nullptr;
+  const aaudio_result_t result = AAudioStreamBuilder_openStream(builder, &probe);
+  AAudioStreamBuilder_delete(builder);
+  if (result != AAUDIO_OK || !probe) {
+    LOGE("Device format probe failed: %d", result);
+    return false;
+  }
+  *sampleRate = AAudioStream_getSampleRate(probe);
+  *channels = AAudioStream_getChannelCount(probe);
+  AAudioStream_close(probe);
+  LOGI("Device format %d Hz, %d channels", *sampleRate, *channels);
+  return *sampleRate > 0;
+}
+
+void AudioEngine::PreloadNext(const std::string& path) {
+  std::lock_guard<std::mutex> lock(decoderMutex_);
+  const bool gapless = gapless_;
+  audioengine::SeekIndexer* indexer = seekIndexer_.get();
+  const audioengine::LoudnessScanner* loudness = loudnessScanner_.get();
+  const ChannelMixing mixing = ChannelMixingLocked();
+  const uint32_t outputRate = ResampleRateLocked();
+  const audioengine::ResamplerQuality quality = resampleQuality_;
+  std::shared_ptr<const audioengine::ConvolutionFilter> convolution = convolution_;
+  preloader_.Preload(path, [path, gapless, indexer, loudness, mixing, outputRate, quality,
+                            convolution](PreparedTrack* track) {
+    if (!PrepareTrack(path, gapless, indexer, loudness, mixing, outputRate, quality,
+                      convolution, track)) {
+      LOGE("Preload failed for %s", path.c_str());
+      return false;
+    }
+    auto prebuffered =
+        std::make_unique<audioengine::PrebufferedSource>(std::move(track->source));
+    prebuffered->Fill(static_cast<uint64_t>(kPreloadSeconds * track->sampleRate));
+    track->source = std::move(prebuffered);
+    return true;
+  });
+}
+
+bool AudioEngine::OpenDecoder(PreparedTrack track) {
+  CloseDecoder();
+  std::unique_ptr<audioengine::PcmSource> source = std::move(track.source);
+  ApplyTrack(track);
 
+  // Returns once the prefill is decoded; the producer thread does the rest.
+  if (!streamer_.Start(std::move(source), TrackGainLocked(track.replayGain))) {
+    LOGE("Failed to start decode thread");
+    return false;
+  }
   return true;
 }
 
-void AudioEngine::CloseDecoder() {
-  if (packet_) {
-    av_packet_free(&packet_);
-    packet_ = nullptr;
-  }
-  if (frame_) {
-    av_frame_free(&frame_);
-    frame_ = nullptr;
-  }
-  if (codecCtx_) {
-    avcodec_free_context(&codecCtx_);
-    codecCtx_ = nullptr;
-  }
-  if (fmtCtx_) {
-    avformat_close_input(&fmtCtx_);
-    fmtCtx_ = nullptr;
-  }
-  if (swrCtx_) {
-    swr_free(&swrCtx_);
-    swrCtx_ = nullptr;
-  }
-  resampled_.clear();
-  resampledOffset_ = 0;
-  resampledFrames_ = 0;
-  audioStreamIndex_ = -1;
-}
-
-bool AudioEngine::InitResampler() {
-  if (!codecCtx_) return false;
-  AVChannelLayout outLayout = EnsureLayoutCtx(codecCtx_);
-  outputChannels_ = outLayout.nb_channels;
-  outputSampleRate_ = codecCtx_->sample_rate;
-  AVSampleFormat outFmt = AV_SAMPLE_FMT_FLT;
-  SwrContext* ctx = nullptr;
-  int ret = swr_alloc_set_opts2(
-      &ctx, &outLayout, outFmt, outputSampleRate_, &codecCtx_->ch_layout,
-      codecCtx_->sample_fmt, codecCtx_->sample_rate, 0, nullptr);
-  if (ret < 0 || !ctx) {
-    LOGE("swr_alloc_set_opts2 failed: %d", ret);
+void AudioEngine::SetGapless(bool enabled) {
+  std::lock_guard<std::mutex> lock(decoderMutex_);
+  gapless_ = enabled;
+  preloader_.Clear();
+  if (!enabled && streamer_.OverlapMs() == 0 && hasQueuedTrack_) {
+    streamer_.QueueNext(nullptr);
+    queuedTrack_ = PreparedTrack();
+    hasQueuedTrack_ = false;
+  }
+}
+
+void AudioEngine::SetResampling(bool enabled,
+                                audioengine::ResamplerQuality quality) {
+  std::lock_guard<std::mutex> lock(decoderMutex_);
+  if (enabled == resample_ && quality == resampleQuality_) return;
+  resample_ = enabled;
+  resampleQuality_ = quality;
+  // Preloaded tracks were converted with the old settings.
+  preloader_.Clear();
+}
+
+void AudioEngine::SetDownmix(const audioengine::DownmixOptions& options,
+                             int32_t maxChannels) {
+  std::lock_guard<std::mutex> lock(decoderMutex_);
+  downmix_ = options;
+  maxChannels_ = std::max<int32_t>(maxChannels, 0);
+  // Preloaded tracks were mixed with the old settings.
+  preloader_.Clear();
+}
+
+void AudioEngine::SetChannelMatrix(const audioengine::ChannelMatrix& matrix) {
+  std::lock_guard<std::mutex> lock(decoderMutex_);
+  channelMatrix_ = matrix;
+  preloader_.Clear();
+}
+
+bool AudioEngine::SetConvolutionFilter(const std::string& path) {
+  std::shared_ptr<const audioengine::ConvolutionFilter> convolution;
+  if (!path.empty()) {
+    // Decoded outside the lock; a long response takes a moment.
+    FFmpegPcmSource decoder;
+    auto fir = std::make_shared<audioengine::FirFilter>();
+    if (!decoder.Open(path, false) || !audioengine::ReadFirFilter(decoder, fir.get())) {
+      LOGE("Cannot load convolution filter %s", path.c_str());
+      return false;
+    }
+    uint32_t rate = fir->sampleRate;
+    {
+      std::lock_guard<std::mutex> lock(decoderMutex_);
+      if (const uint32_t device = ResampleRateLocked()) rate = device;
+    }
+    convolution = audioengine::ConvolutionFilter::Create(std::move(fir), rate);
+    if (!convolution) return false;
+    LOGI("Convolution filter: %zu taps, %u tail partitions",
+         convolution->Taps(), convolution->TailPartitions());
+  }
+  std::lock_guard<std::mutex> lock(decoderMutex_);
+  convolution_ = std::move(convolution);
+  // Preloaded tracks were built with the old filter.
+  preloader_.Clear();
+  return true;
+}
+
+bool AudioEngine::SetEqualizer(const std::vector<audioengine::EqBand>& bands) {
+  // No engine lock: the equalizer hands the bands to the callback itself.
+  return equalizer_.SetBands(bands);
+}
+
+void AudioEngine::SetCrossfeed(audioengine::CrossfeedMode mode,
+                               const audioengine::CrossfeedLevel& level) {
+  std::lock_guard<std::mutex> lock(decoderMutex_);
+  crossfeedMode_ = mode;
+  crossfeed_.SetLevel(level);
+  UpdateCrossfeedLocked();
+}
+
+void AudioEngine::SetHeadphonesConnected(bool connected) {
+  std::lock_guard<std::mutex> lock(decoderMutex_);
+  headphones_ = connected;
+  UpdateCrossfeedLocked();
+}
+
+void AudioEngine::SetPlaybackRate(double rate) {
+  // No lock: the stretcher picks the rate up at its next hop.
+  stretcher_.SetRate(rate);
+}
+
+void AudioEngine::SetSpectrumEnabled(bool enabled) {
+  spectrum_.SetEnabled(enabled);
+}
+
+void AudioEngine::SetSpectrumOptions(const audioengine::SpectrumAnalyzer::Options& options) {
+  spectrum_.SetOptions(options);
+}
+
+bool AudioEngine::LatestSpectrum(audioengine::SpectrumFrame* frame) {
+  return spectrum_.Latest(frame);
+}
+
+std::vector<double> AudioEngine::SpectrumBandCentersHz() const {
+  return spectrum_.BandCentersHz();
+}
+
+audioengine::LevelMeterReading AudioEngine::MeterLevels() const {
+  return meter_.Read();
+}
+
+void AudioEngine::SetMeterOptions(const audioengine::LevelMeter::Options& options) {
+  meter_.SetOptions(options);
+}
+
+void AudioEngine::UpdateCrossfeedLocked() {
+  crossfeed_.SetEnabled(
+      crossfeedMode_ == audioengine::CrossfeedMode::kOn ||
+      (crossfeedMode_ == audioengine::CrossfeedMode::kHeadphones && headphones_));
+}
+
+void AudioEngine::SetCrossfadeMs(int32_t ms) {
+  std::lock_guard<std::mutex> lock(decoderMutex_);
+  streamer_.SetOverlapMs(static_cast<uint32_t>(std::max<int32_t>(ms, 0)));
+}
+
+bool AudioEngine::QueueNext(const std::string& path) {
+  std::lock_guard<std::mutex> lock(decoderMutex_);
+  if (!gapless_ && streamer_.OverlapMs() == 0) return false;
+  if (!streamer_.IsActive()) return false;
+  CollectTrackChangeLocked();
+  PreparedTrack track;
+  if (!TakeOrPrepareTrack(path, &track)) return false;
+  // The AAudio stream is fixed to the current rate and channel count.
+  if (track.sampleRate != outputSampleRate_ || track.channels != outputChannels_) {
+    LOGI("Not queueing %s: output format differs", path.c_str());
     return false;
   }
-  swrCtx_ = ctx;
-  if (swr_init(swrCtx_) < 0) {
-    LOGE("swr_init failed");
-    swr_free(&swrCtx_);
+  if (!streamer_.QueueNext(std::move(track.source),
+                           TrackGainLocked(track.replayGain))) {
     return false;
   }
+  queuedTrack_ = std::move(track);
+  hasQueuedTrack_ = true;
   return true;
 }
 
+void AudioEngine::CollectTrackChangeLocked() {
+  if (!hasQueuedTrack_ || !streamer_.TakeTrackChange()) return;
+  ApplyTrack(queuedTrack_);
+  queuedTrack_ = PreparedTrack();
+  hasQueuedTrack_ = false;
+  trackChanged_ = true;
+}
+
+bool AudioEngine::TakeTrackChange() {
+  std::lock_guard<std::mutex> lock(decoderMutex_);
+  CollectTrackChangeLocked();
+  return std::exchange(trackChanged_, false);
+}
+
+void AudioEngine::CloseDecoder() {
+  streamer_.Stop();
+  queuedTrack_ = PreparedTrack();
+  hasQueuedTrack_ = false;
+  trackChanged_ = false;
+}
+
 bool AudioEngine::InitOutputStream() {
   if (stream_) {
     return true;
@@ -548,9 +1064,39 @@ bool AudioEngine::InitOutputStream() {
     stream_ = nullptr;
     return false;
   }
+  // The callback is not running yet.
+  equalizer_.Configure(static_cast<uint32_t>(outputSampleRate_),
+                       static_cast<uint32_t>(outputChannels_));
+  // Unconfigured, and so bypassed, for anything but stereo.
+  crossfeed_.Configure(static_cast<uint32_t>(outputSampleRate_),
+                       static_cast<uint32_t>(outputChannels_));
+  limiter_.Configure(static_cast<uint32_t>(outputSampleRate_),
+                     static_cast<uint32_t>(outputChannels_));
+  limiterResetPending_.store(false);
+  stretcher_.Configure(static_cast<uint32_t>(outputSampleRate_),
+                       static_cast<uint32_t>(outputChannels_));
+  stretcherResetPending_.store(false);
+  spectrum_.Configure({static_cast<uint32_t>(outputSampleRate_),
+                       static_cast<uint32_t>(outputChannels_), 32, true});
+  meter_.Configure({static_cast<uint32_t>(outputSampleRate_),
+                    static_cast<uint32_t>(outputChannels_), 32, true});
   return true;
 }
 
+bool AudioEngine::StopOutputStream() {
+  if (!stream_) return true;
+  aaudio_result_t res = AAudioStream_requestStop(stream_);
+  if (res != AAUDIO_OK) {
+    LOGE("AAudioStream_requestStop failed: %d", res);
+    return false;
+  }
+  // Once it leaves STOPPING the callback has returned for good.
+  aaudio_stream_state_t state = AAUDIO_STREAM_STATE_STOPPING;
+  AAudioStream_waitForStateChange(stream_, AAUDIO_STREAM_STATE_STOPPING,
+                                  &state, kStopTimeoutNanos);
+  return state != AAUDIO_STREAM_STATE_STOPPING;
+}
+
 void AudioEngine::CloseOutputStream() {
   if (stream_) {
     AAudioStream_close(stream_);
@@ -558,91 +1104,35 @@ void AudioEngine::CloseOutputStream() {
   }
 }
 
-bool AudioEngine::DecodeNextFrameLocked() {
-  if (!fmtCtx_ || !codecCtx_) return false;
-  while (true) {
-    int ret = av_read_frame(fmtCtx_, packet_);
-    if (ret == AVERROR_EOF) {
-      avcodec_send_packet(codecCtx_, nullptr);
-    } else if (ret < 0) {
-      LOGE("av_read_frame error: %d", ret);
-      return false;
-    }
-    if (packet_->stream_index != audioStreamIndex_) {
-      av_packet_unref(packet_);
-      if (ret == AVERROR_EOF) return false;
-      continue;
-    }
-    ret = avcodec_send_packet(codecCtx_, packet_);
-    av_packet_unref(packet_);
-    if (ret < 0) {
-      LOGE("avcodec_send_packet error: %d", ret);
-      return false;
-    }
-    ret = avcodec_receive_frame(codecCtx_, frame_);
-    if (ret == AVERROR(EAGAIN)) {
-      continue;
-    } else if (ret == AVERROR_EOF) {
-      return false;
-    } else if (ret < 0) {
-      LOGE("avcodec_receive_frame error: %d", ret);
-      return false;
-    }
-
-    int outSamples =
-        swr_get_out_samples(swrCtx_, frame_->nb_samples);
-    if (outSamples <= 0) {
-      return false;
-    }
-    resampled_.assign(outSamples * outputChannels_, 0.0f);
-    uint8_t* outPlanes[] = {
-        reinterpret_cast<uint8_t*>(resampled_.data()),
-        nullptr, nullptr, nullptr};
-    int converted = swr_convert(swrCtx_, outPlanes, outSamples,
-                                (const uint8_t**)frame_->extended_data,
-                                frame_->nb_samples);
-    if (converted <= 0) {
-      return false;
-    }
-    resampledFrames_ = static_cast<size_t>(converted);
-    resampledOffset_ = 0;
-    return true;
-  }
-}
-
 int AudioEngine::FillOutput(float* output, int32_t numFrames) {
-  int framesFilled = 0;
-  const double vol = volume_.load();
-  while (framesFilled < numFrames) {
-    if (resampledOffset_ < resampledFrames_) {
-      size_t toCopy =
-          std::min<size_t>(resampledFrames_ - resampledOffset_,
-                           static_cast<size_t>(numFrames - framesFilled));
-      size_t samples = toCopy * outputChannels_;
-      const float* src =
-          resampled_.data() + resampledOffset_ * outputChannels_;
-      for (size_t i = 0; i < samples; ++i) {
-        output[framesFilled * outputChannels_ + i] =
-            static_cast<float>(src[i] * vol);
-      }
-      resampledOffset_ += toCopy;
-      framesFilled += static_cast<int>(toCopy);
-      continue;
-    }
-    // Need more data
-    if (!DecodeNextFrameLocked()) {
-      // Fill remainder with silence and mark EOF.
-      size_t remainingSamples =
-          static_cast<size_t>(numFrames - framesFilled) * outputChannels_;
-      std::fill(output + framesFilled * outputChannels_,
-                output + framesFilled * outputChannels_ + remainingSamples,
-                0.0f);
-      framesFilled = numFrames;
-      MarkEnded();
-      return framesFilled;
-    }
+  const size_t frames = static_cast<size_t>(numFrames);
+  if (stretcherResetPending_.exchange(false)) stretcher_.Reset();
+  // Track gain and volume are applied by the streamer as it copies. The
+  // ring only reports the end once it is drained, so what the stretcher
+  // holds then plays out.
+  const size_t copied = stretcher_.Read(
+      output, frames,
+      [this](float* dst, size_t n) {
+        return streamer_.Read(reinterpret_cast<uint8_t*>(dst), n);
+      },
+      streamer_.IsFinished());
+  if (copied < frames) {
+    // Decoder behind (or done): pad with silence rather than wait.
+    std::fill(output + copied * outputChannels_,
+              output + frames * outputChannels_, 0.0f);
+  }
+  equalizer_.Process(output, frames);
+  crossfeed_.Process(output, frames);
+  if (limiterEnabled_.load(std::memory_order_relaxed)) {
+    if (limiterResetPending_.exchange(false)) limiter_.Reset();
+    limiter_.Process(output, frames);
+  }
+  spectrum_.Tap(output, frames);
+  meter_.Process(output, frames);
+  if (copied < frames && streamer_.IsFinished() && stretcher_.HeldFrames() == 0) {
+    MarkEnded();
   }
-  return framesFilled;
+  return numFrames;
 }
 
 void AudioEngine::MarkEnded() {
@@ -674,7 +1164,6 @@ aaudio_data_callback_result_t AudioEngine::DataCallback(AAudioStream* stream,
                                                         void* audioData,
                                                         int32_t numFrames) {
   auto* engine = static_cast<AudioEngine*>(userData);
-  std::lock_guard<std::mutex> lock(engine->decoderMutex_);
   if (!engine->playing_.load()) {
     float* out = static_cast<float*>(audioData);
     size_t samples =
@@ -696,8 +1185,12 @@ void AudioEngine::ErrorCallback(AAudioStream* /*stream*/, void* userData,
   LOGE("AAudio error callback: %d", error);
   if (error == AAUDIO_ERROR_DISCONNECTED) {
     std::lock_guard<std::mutex> lock(engine->decoderMutex_);
+    // A new route may run at another rate or channel count; the next track
+    // probes again.
+    engine->deviceSampleRate_ = 0;
+    engine->deviceChannels_ = 0;
     engine->CloseOutputStream();
     engine->InitOutputStream();
-    engine->Play();
+    engine->PlayLocked();
   }
 }
@@ -6,8 +6,28 @@
 #include <memory>
 #include <mutex>
 #include <string>
+#include <utility>
 #include <vector>
 
+#include "AudioEngineCore/ChannelMixer.h"
+#include "AudioEngineCore/Convolver.h"
+#include "AudioEngineCore/Crossfader.h"
+#include "AudioEngineCore/Crossfeed.h"
+#include "AudioEngineCore/FeatureScanner.h"
+#include "AudioEngineCore/LevelMeter.h"
+#include "AudioEngineCore/LoudnessScanner.h"
+#include "AudioEngineCore/ParametricEq.h"
+#include "AudioEngineCore/ReplayGain.h"
+#include "AudioEngineCore/Resampler.h"
+#include "AudioEngineCore/SeekIndexer.h"
+#include "AudioEngineCore/Spectrum.h"
+#include "AudioEngineCore/TimeStretch.h"
+#include "AudioEngineCore/TrackPreloader.h"
+#include "AudioEngineCore/TruePeakLimiter.h"
+#include "AudioEngineCore/Waveform.h"
+#include "AudioEngineCore/WaveformScanner.h"
+#include "FFmpegPcmSource.h"
+
 extern "C" {
 #include <libavformat/avformat.h>
 #include <libavcodec/avcodec.h>
@@ -23,6 +43,9 @@ public:
   static AudioEngine& Instance();
 
   void SetJavaVM(JavaVM* vm);
+  // App cache directory; enables background seek indexing of long
+  // unindexed files and the loudness scan. Only the first call takes effect.
+  void SetCacheDir(const std::string& dir);
 
   bool Load(const std::string& path);
   bool Play();
@@ -30,9 +53,122 @@ public:
   bool Stop();
   bool SeekMs(int64_t positionMs);
 
+  // Gapless mode trims encoder delay/padding from newly loaded tracks and
+  // enables QueueNext(). Disabling it drops a queued track.
+  void SetGapless(bool enabled);
+  // Equal-power crossfade length between queued tracks; 0 turns it off.
+  // Applies from the next QueueNext().
+  void SetCrossfadeMs(int32_t ms);
+  // Opens `path` now and splices it onto the end of the current track with
+  // no gap, or fades it in over the end of the current track when a
+  // crossfade is set. False when neither is on or the output format
+  // differs; the caller then Load()s the track when playback ends.
+  bool QueueNext(const std::string& path);
+  // True once for each queued track that has become audible since the last
+  // call. The callback never takes decoderMutex_ to hand the change over,
+  // so the app polls this while a track is queued.
+  bool TakeTrackChange();
+  // Opens, probes and pre-decodes `path` on a background thread. A later
+  // Load() or QueueNext() of the same path takes it over, and Load() keeps
+  // the AAudio stream when rate and channel count match.
+  void PreloadNext(const std::string& path);
+
   bool SetVolume(double volume);
   double GetVolume() const;
 
+  // Loudness normalization from ReplayGain/R128 tags. The gain is resolved
+  // when a track is opened and applied in the same multiply as the volume;
+  // while normalization is on, a look-ahead true-peak limiter holds the
+  // output under -1 dBTP. Changes the current track's gain at once; a
+  // queued track keeps the gain it was queued with.
+  void SetNormalization(audioengine::NormalizationMode mode, double preampDb);
+  // Converts tracks to the device's native rate on the decode thread, so
+  // AAudio's mixer does not resample them and tracks of different rates
+  // queue gaplessly. On at medium quality by default; applies from the
+  // next Load() or QueueNext().
+  void SetResampling(bool enabled, audioengine::ResamplerQuality quality);
+  // Tracks with more channels than the output takes are folded down with
+  // `options` on the decode thread (see audioengine::ChannelMatrix::
+  // Downmix()), so the rings and the AAudio stream carry only the channels
+  // that are played. The output takes the device's channel count, or
+  // `maxChannels` when that is lower and not 0. Applies from the next Load()
+  // or QueueNext().
+  void SetDownmix(const audioengine::DownmixOptions& options, int32_t maxChannels);
+  // Mixes tracks with matrix.Inputs() channels through `matrix` instead of
+  // the automatic downmix; an empty matrix removes it. Applies from the next
+  // Load() or QueueNext().
+  void SetChannelMatrix(const audioengine::ChannelMatrix& matrix);
+  // Loads a room or headphone correction filter (a WAV/FLAC impulse
+  // response, one channel or one per output channel, any rate) and
+  // convolves every track with it on the decode thread. An empty path
+  // removes it. Applies from the next Load() or QueueNext().
+  bool SetConvolutionFilter(const std::string& path);
+  // Parametric or graphic EQ (see audioengine::GraphicEqBands()) on the
+  // output, ahead of the limiter. Safe to call from the UI thread while
+  // dragging a slider: the callback picks the new bands up without locking
+  // and glides to them. An empty list bypasses it. False for more than
+  // ParametricEq::kMaxBands bands.
+  bool SetEqualizer(const std::vector<audioengine::EqBand>& bands);
+  // Headphone crossfeed on stereo output, after the EQ and ahead of the
+  // limiter. kHeadphones, the default, turns it on while
+  // SetHeadphonesConnected() says the route is headphones or a headset;
+  // AAudio does not report the device type, so the app passes it on from
+  // AudioManager's device callback.
+  // Switches and level changes glide in without reopening the stream.
+  void SetCrossfeed(audioengine::CrossfeedMode mode,
+                    const audioengine::CrossfeedLevel& level = audioengine::kCrossfeedDefault);
+  void SetHeadphonesConnected(bool connected);
+  // Playback speed from 0.5x to 3x without a pitch change. Safe to call
+  // from any thread; the callback applies it within one hop (12 ms).
+  void SetPlaybackRate(double rate);
+  // Spectrum for visualizers, taken from the output after volume, EQ,
+  // crossfeed and limiter. Off by default; when off the callback does not
+  // touch it. No locks: the callback copies into the analyzer's ring, its
+  // worker does the FFT, and LatestSpectrum() (one UI thread at a time)
+  // reads the newest frame, false when nothing new was published.
+  void SetSpectrumEnabled(bool enabled);
+  void SetSpectrumOptions(const audioengine::SpectrumAnalyzer::Options& options);
+  bool LatestSpectrum(audioengine::SpectrumFrame* frame);
+  std::vector<double> SpectrumBandCentersHz() const;
+  // Per-channel peak, peak hold, RMS and true peak of the output after
+  // volume, EQ, crossfeed and limiter; at the floor while paused or
+  // stopped. Both are lock-free from any thread.
+  audioengine::LevelMeterReading MeterLevels() const;
+  void SetMeterOptions(const audioengine::LevelMeter::Options& options);
+  // Limiter activity and CPU cost since the output stream was opened.
+  audioengine::TruePeakLimiter::Stats LimiterStats() const;
+  // Measures EBU R128 loudness, range and true peak of (path, album) pairs
+  // on a low-priority worker pool, caching results in the cache directory
+  // so an interrupted scan resumes after a restart. Tracks without
+  // ReplayGain tags then normalize from their measurement. Needs
+  // SetCacheDir().
+  void ScanLoudness(const std::vector<std::pair<std::string, std::string>>& tracks);
+  void CancelLoudnessScan();
+  // Measured loudness of `path` from this session's scan or the cache;
+  // false if it has not been measured.
+  bool TrackLoudnessFor(const std::string& path, audioengine::TrackLoudness* result);
+  // Progress and throughput (tracks per second per core) of the scan.
+  audioengine::LoudnessScanner::Stats LoudnessScanStats();
+  // Builds seekbar waveforms (min/max/RMS at several zoom levels) on a
+  // low-priority worker pool, decoding at the source rate and at most two
+  // channels, and caches them in the cache directory; files already cached
+  // are skipped. Needs SetCacheDir().
+  void GenerateWaveforms(const std::vector<std::string>& paths);
+  void CancelWaveforms();
+  // Cached waveform of `path`, mapped from disk without decoding; null until
+  // it has been generated. Does not take decoderMutex_.
+  std::shared_ptr<const audioengine::Waveform> WaveformFor(const std::string& path) const;
+  audioengine::WaveformScanner::Stats WaveformStats();
+  // Analyses tempo, key, energy and spectral shape for the mood engine on a
+  // low-priority worker pool, caching results in the cache directory like
+  // the loudness scan. Needs SetCacheDir().
+  void ScanFeatures(const std::vector<std::string>& paths);
+  void CancelFeatureScan();
+  // Features of `path` from this session's scan or the cache; false if it
+  // has not been analysed.
+  bool TrackFeaturesFor(const std::string& path, audioengine::TrackFeatures* result);
+  audioengine::FeatureScanner::Stats FeatureScanStats();
+
   // Extracts metadata for an arbitrary file path without touching playback
   // state. Returns a Java Map<String, Any?> matching EngineTrackMetadata.
   jobject ExtractMetadata(JNIEnv* env, const std::string& path);
@@ -51,21 +187,80 @@ public:
     std::string sampleFormatName;
   };
 
-  PCMInfo CurrentPCMInfo() const;
-  std::string CurrentPath() const;
-  int64_t DurationMs() const;
+  // These follow a queued track once it has become audible.
+  PCMInfo CurrentPCMInfo();
+  std::string CurrentPath();
+  int64_t DurationMs();
+  // Audible position in the current track: the ring's position less what
+  // the time stretcher still holds.
+  int64_t PositionMs();
 
 private:
   AudioEngine();
   ~AudioEngine();
 
-  bool OpenDecoder(const std::string& path);
+  // An opened decoder (wrapped for trimming when needed) plus what the
+  // engine reports about it.
+  struct PreparedTrack {
+    std::string path;
+    std::unique_ptr<audioengine::PcmSource> source;
+    int64_t durationMs = 0;
+    int64_t startTimeUs = 0;
+    int sampleRate = 0;
+    int channels = 0;
+    PCMInfo pcm;
+    audioengine::ReplayGainTags replayGain;
+  };
+
+  // How PrepareTrack() maps a track's channels onto the output.
+  struct ChannelMixing {
+    // Most channels the output takes; 0 leaves tracks as they are.
+    uint32_t maxChannels = 0;
+    audioengine::DownmixOptions options;
+    audioengine::ChannelMatrix matrix;
+  };
+
+  // Touches no engine state, so the preloader thread can run it; `indexer`,
+  // `loudness` and `convolution` may be null. Float tracks are mixed to the
+  // output channels, resampled to `outputRate` unless it is 0, then
+  // convolved (with the filter redone for the track's rate if it differs).
+  static bool PrepareTrack(
+      const std::string& path, bool gapless, audioengine::SeekIndexer* indexer,
+      const audioengine::LoudnessScanner* loudness, const ChannelMixing& mixing,
+      uint32_t outputRate, audioengine::ResamplerQuality quality,
+      std::shared_ptr<const audioengine::ConvolutionFilter> convolution,
+      PreparedTrack* track);
+  // Rate PrepareTrack() should convert to: the device rate, or 0 when
+  // resampling is off or the rate is unknown.
+  uint32_t ResampleRateLocked();
+  // Channel settings PrepareTrack() should apply, with the device's channel
+  // count filled in.
+  ChannelMixing ChannelMixingLocked();
+  // Probes the device rate and channel count once per route.
+  void ProbeDeviceLocked();
+  // Native rate and channel count of the default output, from a probe
+  // stream opened without either. False if it cannot be opened.
+  static bool ProbeDeviceFormat(int32_t* sampleRate, int32_t* channels);
+  // Preloaded track for `path`, or a freshly opened one.
+  bool TakeOrPrepareTrack(const std::string& path, PreparedTrack* track);
+  void ApplyTrack(const PreparedTrack& track);
+  // Linear gain for a track under the current normalization settings.
+  float TrackGainLocked(const audioengine::ReplayGainTags& tags) const;
+  // Applies crossfeedMode_ and headphones_ to crossfeed_.
+  void UpdateCrossfeedLocked();
+  // Moves bookkeeping to the queued track once the callback has reached it.
+  // Runs on control threads only: it releases the finished decoder.
+  void CollectTrackChangeLocked();
+  bool OpenDecoder(PreparedTrack track);
   void CloseDecoder();
-  bool InitResampler();
   bool InitOutputStream();
+  // Stops the callback without closing the stream. Blocks until stopped;
+  // false if it may still be running.
+  bool StopOutputStream();
   void CloseOutputStream();
+  bool PlayLocked();
+  void StopLocked();
 
-  bool DecodeNextFrameLocked();
   int FillOutput(float* output, int32_t numFrames);
   void MarkEnded();
   void NotifyPlaybackEnded();
@@ -80,12 +275,6 @@ private:
   JavaVM* jvm_ = nullptr;
   jobject playbackEndedRunnable_ = nullptr; // global ref
 
-  AVFormatContext* fmtCtx_ = nullptr;
-  AVCodecContext* codecCtx_ = nullptr;
-  SwrContext* swrCtx_ = nullptr;
-  AVFrame* frame_ = nullptr;
-  AVPacket* packet_ = nullptr;
-  int audioStreamIndex_ = -1;
   int64_t durationMs_ = 0;
   int64_t startTimeUs_ = 0;
 
@@ -93,15 +282,78 @@ private:
   int outputSampleRate_ = 0;
   int outputChannels_ = 0;
 
-  std::vector<float> resampled_;
-  size_t resampledOffset_ = 0;
-  size_t resampledFrames_ = 0;
+  // Owned before streamer_ so the source's index pointer stays valid.
+  std::unique_ptr<audioengine::SeekIndexer> seekIndexer_;
+  // Set with seekIndexer_ and shares its directory.
+  std::unique_ptr<audioengine::LoudnessScanner> loudnessScanner_;
+  // Set with seekIndexer_ too, and published through waveforms_ so
+  // WaveformFor() needs no lock.
+  std::unique_ptr<audioengine::WaveformScanner> waveformScanner_;
+  std::atomic<const audioengine::WaveformScanner*> waveforms_{nullptr};
+  // Set with seekIndexer_ too.
+  std::unique_ptr<audioengine::FeatureScanner> featureScanner_;
+
+  // FFmpeg runs on the streamer's producer threads; the AAudio callback only
+  // copies out of (or, during a crossfade, mixes) their rings and never
+  // takes decoderMutex_.
+  audioengine::Crossfader streamer_;
 
   std::string currentPath_;
   PCMInfo currentPCM_;
+  audioengine::ReplayGainTags currentReplayGain_;
+  bool gapless_ = false;
+  bool resample_ = true;
+  audioengine::ResamplerQuality resampleQuality_ =
+      audioengine::ResamplerQuality::kMedium;
+  // Probed on first use and again after the device disconnects.
+  int32_t deviceSampleRate_ = 0;
+  int32_t deviceChannels_ = 0;
+  audioengine::DownmixOptions downmix_;
+  int32_t maxChannels_ = 0;
+  audioengine::ChannelMatrix channelMatrix_;
+  // Transformed for the device rate when resampling, otherwise for the
+  // filter's own; null when no filter is loaded.
+  std::shared_ptr<const audioengine::ConvolutionFilter> convolution_;
+  audioengine::NormalizationMode normalization_ =
+      audioengine::NormalizationMode::kOff;
+  double preampDb_ = 0.0;
+  // Track handed to streamer_.QueueNext(); streamer_ owns its source.
+  PreparedTrack queuedTrack_;
+  bool hasQueuedTrack_ = false;
+  // Set when CollectTrackChangeLocked() moves to the queued track; cleared
+  // by TakeTrackChange().
+  bool trackChanged_ = false;
+  // After seekIndexer_ and loudnessScanner_, which its jobs may use, so it
+  // is torn down first.
+  audioengine::TrackPreloader<PreparedTrack> preloader_;
 
   std::mutex decoderMutex_;
   std::atomic<bool> playing_{false};
   std::atomic<bool> reachedEof_{false};
   std::atomic<double> volume_{1.0};
+
+  // Configured with the output stream; only the callback runs Process().
+  // Bands are set from any thread.
+  audioengine::ParametricEq equalizer_;
+  // Configured with the output stream; only the callback runs Process().
+  // Switched from any thread through crossfeedMode_ and headphones_, under
+  // decoderMutex_.
+  audioengine::Crossfeed crossfeed_;
+  audioengine::CrossfeedMode crossfeedMode_ = audioengine::CrossfeedMode::kHeadphones;
+  bool headphones_ = false;
+  // Configured with the output stream; only the callback runs Process().
+  // A reset is requested from control threads and done by the callback.
+  audioengine::TruePeakLimiter limiter_;
+  std::atomic<bool> limiterEnabled_{false};
+  std::atomic<bool> limiterResetPending_{false};
+  // Configured with the output stream; only the callback runs Read(). The
+  // rate is set from any thread; a reset after a seek or load is requested
+  // like the limiter's.
+  audioengine::TimeStretcher stretcher_;
+  std::atomic<bool> stretcherResetPending_{false};
+  // Configured with the output stream; the callback only runs Tap().
+  audioengine::SpectrumAnalyzer spectrum_;
+  // Configured with the output stream; the callback runs Process(), and the
+  // control side resets it once the callback has stopped.
+  audioengine::LevelMeter meter_;
 };
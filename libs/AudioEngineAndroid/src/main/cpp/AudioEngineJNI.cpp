@@ -1,5 +1,7 @@
 #include <jni.h>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "AudioEngine.h"
 
@@ -18,6 +20,48 @@ Java_net_djbird_toney_AudioEngineBridge_nativeLoad(JNIEnv* env, jobject /*thiz*/
     return ok ? JNI_TRUE : JNI_FALSE;
 }
 
+JNIEXPORT void JNICALL
+Java_net_djbird_toney_AudioEngineBridge_nativePreloadNext(JNIEnv* env, jobject /*thiz*/, jstring path) {
+    const char* cPath = env->GetStringUTFChars(path, nullptr);
+    AudioEngine::Instance().PreloadNext(cPath ? cPath : "");
+    env->ReleaseStringUTFChars(path, cPath);
+}
+
+JNIEXPORT void JNICALL
+Java_net_djbird_toney_AudioEngineBridge_nativeSetGapless(JNIEnv* /*env*/, jobject /*thiz*/, jboolean enabled) {
+    AudioEngine::Instance().SetGapless(enabled == JNI_TRUE);
+}
+
+JNIEXPORT void JNICALL
+Java_net_djbird_toney_AudioEngineBridge_nativeSetHeadphonesConnected(JNIEnv* /*env*/, jobject /*thiz*/, jboolean connected) {
+    AudioEngine::Instance().SetHeadphonesConnected(connected == JNI_TRUE);
+}
+
+JNIEXPORT void JNICALL
+Java_net_djbird_toney_AudioEngineBridge_nativeSetPlaybackRate(JNIEnv* /*env*/, jobject /*thiz*/, jdouble rate) {
+    AudioEngine::Instance().SetPlaybackRate(rate);
+}
+
+JNIEXPORT jboolean JNICALL
+Java_net_djbird_toney_AudioEngineBridge_nativeQueueNext(JNIEnv* env, jobject /*thiz*/, jstring path) {
+    const char* cPath = env->GetStringUTFChars(path, nullptr);
+    bool ok = AudioEngine::Instance().QueueNext(cPath ? cPath : "");
+    env->ReleaseStringUTFChars(path, cPath);
+    return ok ? JNI_TRUE : JNI_FALSE;
+}
+
+JNIEXPORT jboolean JNICALL
+Java_net_djbird_toney_AudioEngineBridge_nativeTakeTrackChange(JNIEnv* /*env*/, jobject /*thiz*/) {
+    return AudioEngine::Instance().TakeTrackChange() ? JNI_TRUE : JNI_FALSE;
+}
+
+JNIEXPORT void JNICALL
+Java_net_djbird_toney_AudioEngineBridge_nativeSetCacheDir(JNIEnv* env, jobject /*thiz*/, jstring dir) {
+    const char* cDir = env->GetStringUTFChars(dir, nullptr);
+    AudioEngine::Instance().SetCacheDir(cDir ? cDir : "");
+    env->ReleaseStringUTFChars(dir, cDir);
+}
+
 JNIEXPORT jboolean JNICALL
 Java_net_djbird_toney_AudioEngineBridge_nativePlay(JNIEnv* /*env*/, jobject /*thiz*/) {
     return AudioEngine::Instance().Play() ? JNI_TRUE : JNI_FALSE;
@@ -58,6 +102,172 @@ Java_net_djbird_toney_AudioEngineBridge_nativeExtractMetadata(JNIEnv* env, jobje
     return map;
 }
 
+// `paths` and `albums` are parallel; an empty album id leaves the track out
+// of album aggregation.
+JNIEXPORT void JNICALL
+Java_net_djbird_toney_AudioEngineBridge_nativeScanLoudness(JNIEnv* env, jobject /*thiz*/,
+                                                           jobjectArray paths,
+                                                           jobjectArray albums) {
+    const jsize count = env->GetArrayLength(paths);
+    std::vector<std::pair<std::string, std::string>> tracks;
+    tracks.reserve(static_cast<size_t>(count));
+    for (jsize i = 0; i < count; ++i) {
+        auto path = static_cast<jstring>(env->GetObjectArrayElement(paths, i));
+        auto album = static_cast<jstring>(env->GetObjectArrayElement(albums, i));
+        const char* cPath = path ? env->GetStringUTFChars(path, nullptr) : nullptr;
+        const char* cAlbum = album ? env->GetStringUTFChars(album, nullptr) : nullptr;
+        if (cPath) tracks.emplace_back(cPath, cAlbum ? cAlbum : "");
+        if (cPath) env->ReleaseStringUTFChars(path, cPath);
+        if (cAlbum) env->ReleaseStringUTFChars(album, cAlbum);
+        if (path) env->DeleteLocalRef(path);
+        if (album) env->DeleteLocalRef(album);
+    }
+    AudioEngine::Instance().ScanLoudness(tracks);
+}
+
+JNIEXPORT void JNICALL
+Java_net_djbird_toney_AudioEngineBridge_nativeCancelLoudnessScan(JNIEnv* /*env*/, jobject /*thiz*/) {
+    AudioEngine::Instance().CancelLoudnessScan();
+}
+
+// [integrated LUFS, loudness range LU, true peak (linear)], or null when
+// the track has not been measured.
+JNIEXPORT jdoubleArray JNICALL
+Java_net_djbird_toney_AudioEngineBridge_nativeTrackLoudness(JNIEnv* env, jobject /*thiz*/, jstring path) {
+    const char* cPath = env->GetStringUTFChars(path, nullptr);
+    audioengine::TrackLoudness loudness;
+    const bool ok = AudioEngine::Instance().TrackLoudnessFor(cPath ? cPath : "", &loudness);
+    env->ReleaseStringUTFChars(path, cPath);
+    if (!ok) return nullptr;
+    const jdouble values[] = {loudness.integratedLufs, loudness.loudnessRangeLu,
+                              loudness.truePeak};
+    jdoubleArray out = env->NewDoubleArray(3);
+    if (out) env->SetDoubleArrayRegion(out, 0, 3, values);
+    return out;
+}
+
+// [scanned, cached, failed, pending, tracks/s per core, realtime factor].
+JNIEXPORT jdoubleArray JNICALL
+Java_net_djbird_toney_AudioEngineBridge_nativeLoudnessScanStats(JNIEnv* env, jobject /*thiz*/) {
+    const auto stats = AudioEngine::Instance().LoudnessScanStats();
+    const jdouble values[] = {static_cast<jdouble>(stats.tracksScanned),
+                              static_cast<jdouble>(stats.tracksCached),
+                              static_cast<jdouble>(stats.tracksFailed),
+                              static_cast<jdouble>(stats.tracksPending),
+                              stats.TracksPerSecondPerCore(),
+                              stats.RealtimeFactor()};
+    jdoubleArray out = env->NewDoubleArray(6);
+    if (out) env->SetDoubleArrayRegion(out, 0, 6, values);
+    return out;
+}
+
+JNIEXPORT void JNICALL
+Java_net_djbird_toney_AudioEngineBridge_nativeScanFeatures(JNIEnv* env, jobject /*thiz*/,
+                                                           jobjectArray paths) {
+    const jsize count = env->GetArrayLength(paths);
+    std::vector<std::string> list;
+    list.reserve(static_cast<size_t>(count));
+    for (jsize i = 0; i < count; ++i) {
+        auto path = static_cast<jstring>(env->GetObjectArrayElement(paths, i));
+        const char* cPath = path ? env->GetStringUTFChars(path, nullptr) : nullptr;
+        if (cPath) list.emplace_back(cPath);
+        if (cPath) env->ReleaseStringUTFChars(path, cPath);
+        if (path) env->DeleteLocalRef(path);
+    }
+    AudioEngine::Instance().ScanFeatures(list);
+}
+
+JNIEXPORT void JNICALL
+Java_net_djbird_toney_AudioEngineBridge_nativeCancelFeatureScan(JNIEnv* /*env*/, jobject /*thiz*/) {
+    AudioEngine::Instance().CancelFeatureScan();
+}
+
+// [bpm, tempo confidence, key (-1 none), minor (0/1), key confidence,
+// energy, danceability, RMS dB, onset rate, spectral centroid, spread,
+// rolloff, flatness], or null when the track has not been analysed.
+JNIEXPORT jdoubleArray JNICALL
+Java_net_djbird_toney_AudioEngineBridge_nativeTrackFeatures(JNIEnv* env, jobject /*thiz*/, jstring path) {
+    const char* cPath = env->GetStringUTFChars(path, nullptr);
+    audioengine::TrackFeatures features;
+    const bool ok = AudioEngine::Instance().TrackFeaturesFor(cPath ? cPath : "", &features);
+    env->ReleaseStringUTFChars(path, cPath);
+    if (!ok) return nullptr;
+    const jdouble values[] = {features.bpm,
+                              features.tempoConfidence,
+                              static_cast<jdouble>(features.key),
+                              features.minor ? 1.0 : 0.0,
+                              features.keyConfidence,
+                              features.energy,
+                              features.danceability,
+                              features.rmsDb,
+                              features.onsetRate,
+                              features.spectralCentroidHz,
+                              features.spectralSpreadHz,
+                              features.spectralRolloffHz,
+                              features.spectralFlatness};
+    jdoubleArray out = env->NewDoubleArray(13);
+    if (out) env->SetDoubleArrayRegion(out, 0, 13, values);
+    return out;
+}
+
+// [analysed, cached, failed, pending, tracks/s per core, realtime factor].
+JNIEXPORT jdoubleArray JNICALL
+Java_net_djbird_toney_AudioEngineBridge_nativeFeatureScanStats(JNIEnv* env, jobject /*thiz*/) {
+    const auto stats = AudioEngine::Instance().FeatureScanStats();
+    const jdouble values[] = {static_cast<jdouble>(stats.tracksAnalyzed),
+                              static_cast<jdouble>(stats.tracksCached),
+                              static_cast<jdouble>(stats.tracksFailed),
+                              static_cast<jdouble>(stats.tracksPending),
+                              stats.TracksPerSecondPerCore(),
+                              stats.RealtimeFactor()};
+    jdoubleArray out = env->NewDoubleArray(6);
+    if (out) env->SetDoubleArrayRegion(out, 0, 6, values);
+    return out;
+}
+
+JNIEXPORT void JNICALL
+Java_net_djbird_toney_AudioEngineBridge_nativeSetSpectrumEnabled(JNIEnv* /*env*/, jobject /*thiz*/, jboolean enabled) {
+    AudioEngine::Instance().SetSpectrumEnabled(enabled == JNI_TRUE);
+}
+
+// Band levels in dBFS, lowest band first; null when nothing new was published.
+JNIEXPORT jfloatArray JNICALL
+Java_net_djbird_toney_AudioEngineBridge_nativeLatestSpectrum(JNIEnv* env, jobject /*thiz*/) {
+    audioengine::SpectrumFrame frame;
+    if (!AudioEngine::Instance().LatestSpectrum(&frame)) return nullptr;
+    const auto bands = static_cast<jsize>(frame.bands);
+    jfloatArray out = env->NewFloatArray(bands);
+    if (out) env->SetFloatArrayRegion(out, 0, bands, frame.levelsDb);
+    return out;
+}
+
+JNIEXPORT jdoubleArray JNICALL
+Java_net_djbird_toney_AudioEngineBridge_nativeSpectrumBandCenters(JNIEnv* env, jobject /*thiz*/) {
+    const std::vector<double> centers = AudioEngine::Instance().SpectrumBandCentersHz();
+    const auto bands = static_cast<jsize>(centers.size());
+    jdoubleArray out = env->NewDoubleArray(bands);
+    if (out) env->SetDoubleArrayRegion(out, 0, bands, centers.data());
+    return out;
+}
+
+// Channel count, then peak, peak hold, RMS, true peak and maximum true peak
+// in dBFS, one block of `channels` values each.
+JNIEXPORT jfloatArray JNICALL
+Java_net_djbird_toney_AudioEngineBridge_nativeMeterLevels(JNIEnv* env, jobject /*thiz*/) {
+    const audioengine::LevelMeterReading reading = AudioEngine::Instance().MeterLevels();
+    const jsize channels = static_cast<jsize>(reading.channels);
+    jfloatArray out = env->NewFloatArray(1 + 5 * channels);
+    if (!out) return nullptr;
+    const jfloat count = static_cast<jfloat>(channels);
+    env->SetFloatArrayRegion(out, 0, 1, &count);
+    const float* blocks[] = {reading.peakDb, reading.peakHoldDb, reading.rmsDb,
+                             reading.truePeakDb, reading.maxTruePeakDb};
+    for (jsize i = 0; i < 5; ++i) {
+        env->SetFloatArrayRegion(out, 1 + i * channels, channels, blocks[i]);
+    }
+    return out;
+}
+
 JNIEXPORT void JNICALL
 Java_net_djbird_toney_AudioEngineBridge_nativeSetOnPlaybackEnded(JNIEnv* env, jobject /*thiz*/, jobject runnable) {
     AudioEngine::Instance().SetOnPlaybackEnded(env, runnable);
@@ -0,0 +1,440 @@
+#include "FFmpegPcmSource.h"
+
+#include <android/log.h>
+#include <algorithm>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#define LOG_TAG "AudioEngineAndroid"
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+
+namespace {
+
+AVChannelLayout EnsureLayoutCtx(const AVCodecContext* ctx) {
+  if (ctx->ch_layout.nb_channels > 0) return ctx->ch_layout;
+  AVChannelLayout layout{};
+  av_channel_layout_default(&layout, 2);
+  return layout;
+}
+
+// File head searched for a LAME tag; enough to get past an ID3v2 tag
+// without embedded artwork.
+constexpr int kLameProbeBytes = 64 * 1024;
+
+// Shorter files seek quickly enough by bisection.
+constexpr int64_t kSeekIndexMinDurationSeconds = 10 * 60;
+
+int64_t StreamOrigin(const AVStream* stream) {
+  return stream->start_time != AV_NOPTS_VALUE ? stream->start_time : 0;
+}
+
+}  // namespace
+
+FFmpegPcmSource::~FFmpegPcmSource() { Close(); }
+
+void FFmpegPcmSource::Close() {
+  if (packet_) av_packet_free(&packet_);
+  if (frame_) av_frame_free(&frame_);
+  if (codecCtx_) avcodec_free_context(&codecCtx_);
+  if (fmtCtx_) avformat_close_input(&fmtCtx_);
+  if (swrCtx_) swr_free(&swrCtx_);
+  resampled_.Release();
+  resampledOffset_ = 0;
+  resampledFrames_ = 0;
+  resampledStart_ = 0;
+  nextFrame_ = 0;
+  useTimestamps_ = true;
+  gapless_ = audioengine::GaplessInfo();
+  originFromFirstFrame_ = false;
+  firstFramePts_ = AV_NOPTS_VALUE;
+  seekIndexer_ = nullptr;
+  seekIndex_ = audioengine::SeekIndex();
+  audioStreamIndex_ = -1;
+  inputDrained_ = false;
+}
+
+bool FFmpegPcmSource::Open(const std::string& path, bool gapless,
+                           uint32_t maxChannels) {
+  Close();
+  maxChannels_ = maxChannels;
+  if (avformat_open_input(&fmtCtx_, path.c_str(), nullptr, nullptr) < 0) {
+    LOGE("avformat_open_input failed");
+    Close();
+    return false;
+  }
+  if (avformat_find_stream_info(fmtCtx_, nullptr) < 0) {
+    LOGE("avformat_find_stream_info failed");
+    Close();
+    return false;
+  }
+  audioStreamIndex_ = av_find_best_stream(fmtCtx_, AVMEDIA_TYPE_AUDIO, -1, -1,
+                                          nullptr, 0);
+  if (audioStreamIndex_ < 0) {
+    LOGE("No audio stream");
+    Close();
+    return false;
+  }
+  AVStream* stream = fmtCtx_->streams[audioStreamIndex_];
+  const AVCodec* codec = avcodec_find_decoder(stream->codecpar->codec_id);
+  if (!codec) {
+    LOGE("Decoder not found");
+    Close();
+    return false;
+  }
+  codecCtx_ = avcodec_alloc_context3(codec);
+  if (!codecCtx_) {
+    Close();
+    return false;
+  }
+  if (avcodec_parameters_to_context(codecCtx_, stream->codecpar) < 0) {
+    LOGE("parameters_to_context failed");
+    Close();
+    return false;
+  }
+  if (gapless) {
+    gapless_ = DetectGapless(path);
+    if (!gapless_.Empty()) {
+      codecCtx_->flags2 |= AV_CODEC_FLAG2_SKIP_MANUAL;
+      originFromFirstFrame_ = true;
+    }
+  }
+  if (avcodec_open2(codecCtx_, codec, nullptr) < 0) {
+    LOGE("avcodec_open2 failed");
+    Close();
+    return false;
+  }
+  frame_ = av_frame_alloc();
+  packet_ = av_packet_alloc();
+  if (!frame_ || !packet_) {
+    LOGE("Frame/packet alloc failed");
+    Close();
+    return false;
+  }
+  if (!InitResampler()) {
+    Close();
+    return false;
+  }
+
+  totalFrames_ = 0;
+  if (stream->duration > 0) {
+    totalFrames_ = static_cast<uint64_t>(av_rescale_q(
+        stream->duration, stream->time_base, AVRational{1, codecCtx_->sample_rate}));
+  } else if (fmtCtx_->duration > 0) {
+    totalFrames_ = static_cast<uint64_t>(
+        av_rescale(fmtCtx_->duration, codecCtx_->sample_rate, AV_TIME_BASE));
+  }
+
+  const int hintFrames = codecCtx_->frame_size > 0           ? codecCtx_->frame_size
+                         : stream->codecpar->frame_size > 0 ? stream->codecpar->frame_size
+                                                            : 4096;
+  resampled_.Reserve(static_cast<size_t>(swr_get_out_samples(swrCtx_, hintFrames)) *
+                     format_.BytesPerFrame());
+  return true;
+}
+
+bool FFmpegPcmSource::InitResampler() {
+  AVChannelLayout outLayout = EnsureLayoutCtx(codecCtx_);
+  if (maxChannels_ > 0 && outLayout.nb_channels > static_cast<int>(maxChannels_)) {
+    av_channel_layout_default(&outLayout, static_cast<int>(maxChannels_));
+  }
+  int ret = swr_alloc_set_opts2(
+      &swrCtx_, &outLayout, AV_SAMPLE_FMT_FLT, codecCtx_->sample_rate,
+      &codecCtx_->ch_layout, codecCtx_->sample_fmt, codecCtx_->sample_rate, 0,
+      nullptr);
+  if (ret < 0 || !swrCtx_) {
+    LOGE("swr_alloc_set_opts2 failed: %d", ret);
+    return false;
+  }
+  if (swr_init(swrCtx_) < 0) {
+    LOGE("swr_init failed");
+    return false;
+  }
+  format_.sampleRate = static_cast<uint32_t>(codecCtx_->sample_rate);
+  format_.channels = static_cast<uint32_t>(outLayout.nb_channels);
+  format_.bitsPerSample = 32;
+  format_.isFloat = true;
+  return true;
+}
+
+uint64_t FFmpegPcmSource::ChannelLayout() const {
+  if (!codecCtx_ || codecCtx_->ch_layout.order != AV_CHANNEL_ORDER_NATIVE ||
+      static_cast<uint32_t>(codecCtx_->ch_layout.nb_channels) != format_.channels) {
+    return 0;
+  }
+  return codecCtx_->ch_layout.u.mask;
+}
+
+size_t FFmpegPcmSource::ReadFrames(uint8_t* dst, size_t maxFrames) {
+  if (!codecCtx_) return 0;
+  const size_t bytesPerFrame = format_.BytesPerFrame();
+  size_t written = 0;
+  while (written < maxFrames) {
+    if (resampledOffset_ >= resampledFrames_ && !DecodeNextFrame()) break;
+    const size_t n =
+        std::min(maxFrames - written, resampledFrames_ - resampledOffset_);
+    memcpy(dst + written * bytesPerFrame,
+           resampled_.Data() + resampledOffset_ * bytesPerFrame,
+           n * bytesPerFrame);
+    resampledOffset_ += n;
+    written += n;
+  }
+  return written;
+}
+
+bool FFmpegPcmSource::DecodeNextFrame() {
+  resampledOffset_ = 0;
+  resampledFrames_ = 0;
+  while (true) {
+    int ret = avcodec_receive_frame(codecCtx_, frame_);
+    if (ret == AVERROR_EOF) return false;
+    if (ret == AVERROR(EAGAIN)) {
+      if (inputDrained_) return false;
+      ret = av_read_frame(fmtCtx_, packet_);
+      if (ret < 0) {
+        if (ret != AVERROR_EOF) LOGE("av_read_frame error: %d", ret);
+        // Flush so the decoder's delayed frames are still delivered.
+        inputDrained_ = true;
+        avcodec_send_packet(codecCtx_, nullptr);
+        continue;
+      }
+      if (packet_->stream_index == audioStreamIndex_) {
+        ret = avcodec_send_packet(codecCtx_, packet_);
+        if (ret < 0) LOGE("avcodec_send_packet error: %d", ret);
+      }
+      av_packet_unref(packet_);
+      continue;
+    }
+    if (ret < 0) {
+      LOGE("avcodec_receive_frame error: %d", ret);
+      return false;
+    }
+
+    const int outSamples = swr_get_out_samples(swrCtx_, frame_->nb_samples);
+    if (outSamples <= 0) {
+      av_frame_unref(frame_);
+      continue;
+    }
+    uint64_t blockStart = nextFrame_;
+    const int64_t pts = frame_->best_effort_timestamp;
+    if (originFromFirstFrame_ && firstFramePts_ == AV_NOPTS_VALUE) {
+      firstFramePts_ = pts;
+    }
+    if (useTimestamps_ && pts != AV_NOPTS_VALUE) {
+      const AVStream* stream = fmtCtx_->streams[audioStreamIndex_];
+      const int64_t start = av_rescale_q(
+          pts - Origin(stream), stream->time_base,
+          AVRational{1, static_cast<int>(format_.sampleRate)});
+      blockStart = start > 0 ? static_cast<uint64_t>(start) : 0;
+    }
+    uint8_t* outPlanes[] = {resampled_.Acquire(
+        static_cast<size_t>(outSamples) * format_.BytesPerFrame())};
+    const int converted =
+        swr_convert(swrCtx_, outPlanes, outSamples,
+                    (const uint8_t**)frame_->extended_data, frame_->nb_samples);
+    av_frame_unref(frame_);
+    if (converted > 0) {
+      resampledFrames_ = static_cast<size_t>(converted);
+      resampledStart_ = blockStart;
+      nextFrame_ = blockStart + resampledFrames_;
+      return true;
+    }
+  }
+}
+
+audioengine::GaplessInfo FFmpegPcmSource::DetectGapless(
+    const std::string& path) const {
+  audioengine::GaplessInfo info;
+  const AVStream* stream = fmtCtx_->streams[audioStreamIndex_];
+  const AVDictionaryEntry* smpb =
+      av_dict_get(stream->metadata, "iTunSMPB", nullptr, 0);
+  if (!smpb) smpb = av_dict_get(fmtCtx_->metadata, "iTunSMPB", nullptr, 0);
+  if (smpb && audioengine::ParseITunSMPB(smpb->value, &info)) return info;
+
+  const AVCodecParameters* params = stream->codecpar;
+  if (params->codec_id == AV_CODEC_ID_MP3) {
+    // A second context, so the demuxer keeps its read position.
+    AVIOContext* io = nullptr;
+    if (avio_open(&io, path.c_str(), AVIO_FLAG_READ) >= 0) {
+      std::vector<uint8_t> head(kLameProbeBytes);
+      const int got = avio_read(io, head.data(), kLameProbeBytes);
+      avio_closep(&io);
+      if (got > 0 &&
+          audioengine::ParseLameHeader(head.data(), static_cast<size_t>(got), &info)) {
+        return info;
+      }
+    }
+    info = audioengine::GaplessInfo();
+  }
+
+  if (params->initial_padding > 0) {
+    info.leadingFrames = static_cast<uint64_t>(params->initial_padding);
+  }
+  if (params->trailing_padding > 0) {
+    info.trailingFrames = static_cast<uint64_t>(params->trailing_padding);
+  }
+  return info;
+}
+
+int64_t FFmpegPcmSource::Origin(const AVStream* stream) const {
+  if (originFromFirstFrame_ && firstFramePts_ != AV_NOPTS_VALUE) {
+    return firstFramePts_;
+  }
+  return StreamOrigin(stream);
+}
+
+uint64_t FFmpegPcmSource::PrerollFrames() const {
+  const AVCodecParameters* params = fmtCtx_->streams[audioStreamIndex_]->codecpar;
+  if (params->seek_preroll > 0) return static_cast<uint64_t>(params->seek_preroll);
+  switch (params->codec_id) {
+    case AV_CODEC_ID_MP1:
+    case AV_CODEC_ID_MP2:
+    case AV_CODEC_ID_MP3:
+      // Main data may start up to 511 bytes back in the bit reservoir.
+      return 2 * 1152;
+    case AV_CODEC_ID_AAC:
+    case AV_CODEC_ID_VORBIS:
+      // The first block after a seek is missing its overlap half.
+      return 2048;
+    default:
+      return 0;
+  }
+}
+
+bool FFmpegPcmSource::WantsSeekIndex() const {
+  if (!fmtCtx_ || audioStreamIndex_ < 0) return false;
+  AVStream* stream = fmtCtx_->streams[audioStreamIndex_];
+  const AVCodecID codecId = stream->codecpar->codec_id;
+  const char* demuxer = fmtCtx_->iformat->name;
+  const bool unindexed =
+      (codecId == AV_CODEC_ID_MP3 && strcmp(demuxer, "mp3") == 0) ||
+      (codecId == AV_CODEC_ID_AAC && strcmp(demuxer, "aac") == 0) ||
+      (codecId == AV_CODEC_ID_FLAC && strcmp(demuxer, "flac") == 0 &&
+       avformat_index_get_entries_count(stream) == 0);
+  if (!unindexed) return false;
+  return fmtCtx_->duration <= 0 ||
+         fmtCtx_->duration >= kSeekIndexMinDurationSeconds * AV_TIME_BASE;
+}
+
+void FFmpegPcmSource::EnableSeekIndex(const audioengine::SeekIndexer* indexer,
+                                      audioengine::SeekIndex::Key key) {
+  seekIndexer_ = indexer;
+  seekKey_ = std::move(key);
+  seekIndex_ = audioengine::SeekIndex();
+}
+
+bool FFmpegPcmSource::BuildSeekIndex(const audioengine::SeekIndex::Key& key,
+                                     audioengine::SeekIndex* index) {
+  AVFormatContext* fmtCtx = nullptr;
+  if (avformat_open_input(&fmtCtx, key.path.c_str(), nullptr, nullptr) < 0) {
+    LOGE("Seek index: cannot open %s", key.path.c_str());
+    return false;
+  }
+  const int streamIndex =
+      av_find_best_stream(fmtCtx, AVMEDIA_TYPE_AUDIO, -1, -1, nullptr, 0);
+  if (streamIndex >= 0 &&
+      fmtCtx->streams[streamIndex]->codecpar->sample_rate <= 0) {
+    avformat_find_stream_info(fmtCtx, nullptr);
+  }
+  AVPacket* packet = av_packet_alloc();
+  const AVStream* stream =
+      streamIndex >= 0 ? fmtCtx->streams[streamIndex] : nullptr;
+  const int sampleRate = stream ? stream->codecpar->sample_rate : 0;
+  if (!packet || sampleRate <= 0) {
+    av_packet_free(&packet);
+    avformat_close_input(&fmtCtx);
+    return false;
+  }
+
+  *index = audioengine::SeekIndex(
+      static_cast<uint32_t>(sampleRate),
+      audioengine::SeekIndex::DefaultInterval(static_cast<uint32_t>(sampleRate)));
+  const AVRational frameBase{1, sampleRate};
+  const int64_t origin = StreamOrigin(stream);
+  // Parser-derived packet timestamps are exact for these demuxers; the
+  // running count covers packets without one.
+  uint64_t frame = 0;
+  while (av_read_frame(fmtCtx, packet) >= 0) {
+    if (packet->stream_index == streamIndex) {
+      if (packet->pts != AV_NOPTS_VALUE) {
+        const int64_t start =
+            av_rescale_q(packet->pts - origin, stream->time_base, frameBase);
+        frame = start > 0 ? static_cast<uint64_t>(start) : 0;
+      }
+      if (packet->pos >= 0) index->Add(frame, static_cast<uint64_t>(packet->pos));
+      frame += packet->duration > 0
+                   ? static_cast<uint64_t>(av_rescale_q(
+                         packet->duration, stream->time_base, frameBase))
+                   : static_cast<uint64_t>(std::max(stream->codecpar->frame_size, 0));
+    }
+    av_packet_unref(packet);
+  }
+  av_packet_free(&packet);
+  avformat_close_input(&fmtCtx);
+  return !index->Empty();
+}
+
+bool FFmpegPcmSource::SeekWithIndex(uint64_t frame) {
+  if (!seekIndexer_) return false;
+  if (seekIndex_.Empty() && !seekIndexer_->Load(seekKey_, &seekIndex_)) {
+    return false;  // still being built
+  }
+  if (seekIndex_.SampleRate() != format_.sampleRate) return false;
+  audioengine::SeekPoint point;
+  if (!seekIndex_.Lookup(frame, &point)) return false;
+  const int ret = av_seek_frame(fmtCtx_, audioStreamIndex_,
+                                static_cast<int64_t>(point.byteOffset),
+                                AVSEEK_FLAG_BYTE);
+  if (ret < 0) {
+    LOGE("Indexed byte seek failed: %d", ret);
+    return false;
+  }
+  nextFrame_ = point.frame;
+  useTimestamps_ = false;
+  return true;
+}
+
+bool FFmpegPcmSource::SeekToFrame(uint64_t frame, audioengine::SeekMode mode,
+                                  uint64_t* landedFrame) {
+  if (!fmtCtx_ || audioStreamIndex_ < 0 || format_.sampleRate == 0) {
+    return false;
+  }
+  const bool accurate = mode == audioengine::SeekMode::kAccurate;
+  const uint64_t preroll = accurate ? PrerollFrames() : 0;
+  const uint64_t seekFrame = frame > preroll ? frame - preroll : 0;
+  if (!SeekWithIndex(seekFrame)) {
+    AVStream* stream = fmtCtx_->streams[audioStreamIndex_];
+    int64_t ts = av_rescale_q(static_cast<int64_t>(seekFrame),
+                              AVRational{1, static_cast<int>(format_.sampleRate)},
+                              stream->time_base);
+    ts += Origin(stream);
+    const int ret =
+        av_seek_frame(fmtCtx_, audioStreamIndex_, ts, AVSEEK_FLAG_BACKWARD);
+    if (ret < 0) {
+      LOGE("av_seek_frame failed: %d", ret);
+      return false;
+    }
+    nextFrame_ = seekFrame;
+    useTimestamps_ = true;
+  }
+  avcodec_flush_buffers(codecCtx_);
+  swr_init(swrCtx_);
+  inputDrained_ = false;
+  resampledOffset_ = 0;
+  resampledFrames_ = 0;
+
+  // Decode until the landing point is known. Accurate seeks keep going,
+  // discarding pre-roll, until the block that holds `frame`.
+  while (DecodeNextFrame()) {
+    const uint64_t blockEnd = resampledStart_ + resampledFrames_;
+    if (!accurate || blockEnd > frame) {
+      if (accurate && frame > resampledStart_) {
+        resampledOffset_ = static_cast<size_t>(frame - resampledStart_);
+      }
+      if (landedFrame) *landedFrame = resampledStart_ + resampledOffset_;
+      return true;
+    }
+  }
+  if (landedFrame) *landedFrame = nextFrame_;
+  return true;
+}
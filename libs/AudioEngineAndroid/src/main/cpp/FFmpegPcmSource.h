@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "AudioEngineCore/Gapless.h"
+#include "AudioEngineCore/PcmSource.h"
+#include "AudioEngineCore/ScratchArena.h"
+#include "AudioEngineCore/SeekIndex.h"
+#include "AudioEngineCore/SeekIndexer.h"
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+#include <libswresample/swresample.h>
+#include <libavutil/channel_layout.h>
+#include <libavutil/samplefmt.h>
+}
+
+// Pull-based FFmpeg decoder producing packed float PCM at the source rate and
+// channel count. Runs on the StreamingDecoder producer thread, never on the
+// AAudio callback.
+class FFmpegPcmSource : public audioengine::PcmSource {
+public:
+  FFmpegPcmSource() = default;
+  ~FFmpegPcmSource() override;
+
+  FFmpegPcmSource(const FFmpegPcmSource&) = delete;
+  FFmpegPcmSource& operator=(const FFmpegPcmSource&) = delete;
+
+  // With `gapless`, encoder delay/padding is looked up (see Gapless()) and,
+  // when found, FFmpeg's own trimming is disabled so it happens only once.
+  // A non-zero `maxChannels` downmixes wider sources to that many channels
+  // in the converter, for overview work that does not need them all.
+  bool Open(const std::string& path, bool gapless = false, uint32_t maxChannels = 0);
+
+  audioengine::PcmFormat Format() const override { return format_; }
+  size_t ReadFrames(uint8_t* dst, size_t maxFrames) override;
+  bool SeekToFrame(uint64_t frame, audioengine::SeekMode mode,
+                   uint64_t* landedFrame) override;
+  uint64_t TotalFrames() const override { return totalFrames_; }
+
+  // Long MP3/ADTS files, and FLAC without a SEEKTABLE, have no exact seek
+  // table of their own; those benefit from a prebuilt index.
+  bool WantsSeekIndex() const;
+  // Seeks use the index `indexer` caches for `key` once it is built. The
+  // indexer must outlive this source.
+  void EnableSeekIndex(const audioengine::SeekIndexer* indexer,
+                       audioengine::SeekIndex::Key key);
+  // SeekIndexer::BuildFn: demuxes the file (no decoding) and records the
+  // byte position of the first packet in every interval.
+  static bool BuildSeekIndex(const audioengine::SeekIndex::Key& key,
+                             audioengine::SeekIndex* index);
+
+  // Delay/padding in decoded frames: iTunSMPB tag, else LAME header, else
+  // codec parameters. Empty unless opened with `gapless`; a non-empty result
+  // must be applied with an audioengine::TrimmingSource.
+  const audioengine::GaplessInfo& Gapless() const { return gapless_; }
+
+  // Speaker mask of the output channels (AV_CH_* bits, which match
+  // audioengine::speaker), or 0 when the stream does not name its speakers
+  // or was opened with fewer channels than it has.
+  uint64_t ChannelLayout() const;
+
+  const AVFormatContext* FormatContext() const { return fmtCtx_; }
+  const AVCodecContext* CodecContext() const { return codecCtx_; }
+  const AVStream* Stream() const {
+    return fmtCtx_ ? fmtCtx_->streams[audioStreamIndex_] : nullptr;
+  }
+
+private:
+  bool InitResampler();
+  bool DecodeNextFrame();
+  // Frames of history the codec needs before a seek target to decode it
+  // cleanly (bit reservoir, overlapped transforms, Opus pre-skip).
+  uint64_t PrerollFrames() const;
+  // Byte-seeks to the indexed packet at or before `frame`; false when the
+  // index is not built yet or starts later.
+  bool SeekWithIndex(uint64_t frame);
+  audioengine::GaplessInfo DetectGapless(const std::string& path) const;
+  int64_t Origin(const AVStream* stream) const;
+  void Close();
+
+  AVFormatContext* fmtCtx_ = nullptr;
+  AVCodecContext* codecCtx_ = nullptr;
+  SwrContext* swrCtx_ = nullptr;
+  AVFrame* frame_ = nullptr;
+  AVPacket* packet_ = nullptr;
+  int audioStreamIndex_ = -1;
+  bool inputDrained_ = false;
+  uint32_t maxChannels_ = 0;
+
+  audioengine::PcmFormat format_{};
+  uint64_t totalFrames_ = 0;
+
+  // Packed float output of the last decoded frame; reserved at Open() from
+  // the codec frame size so decoding does not allocate per frame.
+  audioengine::ScratchArena resampled_;
+  size_t resampledOffset_ = 0;
+  size_t resampledFrames_ = 0;
+  // Stream position of the first resampled frame, from the frame timestamp
+  // when there is one; nextFrame_ continues the count when there is not.
+  uint64_t resampledStart_ = 0;
+  uint64_t nextFrame_ = 0;
+  // False after a byte seek, where demuxer timestamps are bit-rate guesses;
+  // frames are then counted on from the index point.
+  bool useTimestamps_ = true;
+
+  audioengine::GaplessInfo gapless_;
+  // Under manual trimming frame 0 is the first decoded frame, priming
+  // included, so its timestamp is the origin instead of the start time.
+  bool originFromFirstFrame_ = false;
+  int64_t firstFramePts_ = AV_NOPTS_VALUE;
+
+  const audioengine::SeekIndexer* seekIndexer_ = nullptr;
+  audioengine::SeekIndex::Key seekKey_;
+  audioengine::SeekIndex seekIndex_;
+};
@@ -0,0 +1,69 @@
+// Decode-thread cost of folding multichannel tracks to the device layout,
+// per 4096-frame decode block. "cpuPerStreamSecond" is CPU seconds per second
+// of 48 kHz input, as in ResamplerBenchmarks.cpp; the scalar rows show what
+// the vector kernels save.
+#include <benchmark/benchmark.h>
+
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "AudioEngineCore/ChannelMixer.h"
+#include "AudioEngineCore/SampleKernels.h"
+
+namespace audioengine {
+namespace {
+
+constexpr uint32_t kRate = 48000;
+constexpr size_t kBlockFrames = 4096;
+
+struct LayoutCase {
+  uint64_t in;
+  uint64_t out;
+};
+
+const LayoutCase kLayouts[] = {
+    {kLayout5Point1, kLayoutStereo},
+    {kLayout7Point1, kLayoutStereo},
+    {kLayout7Point1, kLayout5Point1},
+    {kLayoutStereo, kLayoutMono},
+};
+
+void BM_ChannelMixer(benchmark::State& state) {
+  const LayoutCase& layouts = kLayouts[state.range(0)];
+  const bool vector = state.range(1) != 0;
+  const KernelIsa saved = ActiveKernelIsa();
+  if (vector) {
+    for (const KernelIsa isa : {KernelIsa::kAvx2, KernelIsa::kNeon, KernelIsa::kSse2}) {
+      if (SetKernelIsa(isa)) break;
+    }
+  } else {
+    SetKernelIsa(KernelIsa::kScalar);
+  }
+  state.SetLabel(LayoutName(layouts.in) + "->" + LayoutName(layouts.out) + "/" +
+                 KernelIsaName(ActiveKernelIsa()));
+
+  ChannelMixer mixer;
+  mixer.Configure(ChannelMatrix::Downmix(layouts.in, layouts.out));
+  std::vector<float> input(kBlockFrames * mixer.Inputs());
+  for (size_t i = 0; i < input.size(); ++i) {
+    input[i] = 0.5f * std::sin(0.01f * static_cast<float>(i));
+  }
+  std::vector<float> output(kBlockFrames * mixer.Outputs());
+  for (auto _ : state) {
+    mixer.Process(input.data(), output.data(), kBlockFrames);
+    benchmark::DoNotOptimize(output.data());
+    benchmark::ClobberMemory();
+  }
+  SetKernelIsa(saved);
+
+  const double seconds = static_cast<double>(state.iterations() * kBlockFrames) / kRate;
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * kBlockFrames));
+  state.counters["cpuPerStreamSecond"] = benchmark::Counter(
+      seconds, benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+}
+BENCHMARK(BM_ChannelMixer)->ArgsProduct({{0, 1, 2, 3}, {0, 1}});
+
+}  // namespace
+}  // namespace audioengine
@@ -0,0 +1,83 @@
+// Render-thread cost of a crossfade: equal-power gains plus the mix, per
+// render block, for the formats the engines hand to the device. The
+// "cpuPerMixedSecond" counter is CPU seconds spent per second of mixed audio
+// (divide by 1e-6 for microseconds); the scalar rows show what the vector
+// kernels save.
+#include <benchmark/benchmark.h>
+
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "AudioEngineCore/Crossfade.h"
+
+namespace audioengine {
+namespace {
+
+constexpr uint32_t kRate = 48000;
+// A 10 ms device period.
+constexpr size_t kBlockFrames = 480;
+// Two seconds of fade, so gains are recomputed across the whole curve.
+constexpr uint64_t kFadeFrames = kRate * 2;
+
+struct MixFormatCase {
+  const char* name;
+  PcmFormat format;
+};
+
+const MixFormatCase kFormats[] = {
+    {"f32/stereo", {kRate, 2, 32, true}},
+    {"f32/mono", {kRate, 1, 32, true}},
+    {"s16/stereo", {kRate, 2, 16, false}},
+    {"s32/stereo", {kRate, 2, 32, false}},
+    {"f32/5.1", {kRate, 6, 32, true}},
+};
+
+void BM_MixCrossfade(benchmark::State& state) {
+  const MixFormatCase& fc = kFormats[state.range(0)];
+  const bool vector = state.range(1) != 0;
+  state.SetLabel(std::string(fc.name) + (vector ? "/vector" : "/scalar"));
+
+  const size_t bytes = kBlockFrames * fc.format.BytesPerFrame();
+  std::vector<uint8_t> outgoing(bytes), incoming(bytes), dst(bytes);
+  for (size_t i = 0; i < bytes; ++i) {
+    outgoing[i] = static_cast<uint8_t>(i * 7);
+    incoming[i] = static_cast<uint8_t>(i * 13);
+  }
+  if (fc.format.isFloat) {
+    // Keep the float inputs finite and in range.
+    auto* a = reinterpret_cast<float*>(outgoing.data());
+    auto* b = reinterpret_cast<float*>(incoming.data());
+    for (size_t i = 0; i < bytes / sizeof(float); ++i) {
+      a[i] = std::sin(0.01f * static_cast<float>(i));
+      b[i] = std::cos(0.02f * static_cast<float>(i));
+    }
+  }
+  std::vector<float> outGain(kBlockFrames), inGain(kBlockFrames);
+
+  uint64_t position = 0;
+  for (auto _ : state) {
+    dst = outgoing;
+    EqualPowerGains(position, kFadeFrames, kBlockFrames, outGain.data(),
+                    inGain.data());
+    if (vector) {
+      MixCrossfade(fc.format, dst.data(), incoming.data(), outGain.data(),
+                   inGain.data(), kBlockFrames);
+    } else {
+      MixCrossfadeScalar(fc.format, dst.data(), incoming.data(), outGain.data(),
+                         inGain.data(), kBlockFrames);
+    }
+    benchmark::DoNotOptimize(dst.data());
+    benchmark::ClobberMemory();
+    position = (position + kBlockFrames) % kFadeFrames;
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * kBlockFrames));
+  state.counters["cpuPerMixedSecond"] = benchmark::Counter(
+      static_cast<double>(state.iterations() * kBlockFrames) / kRate,
+      benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+}
+BENCHMARK(BM_MixCrossfade)->ArgsProduct({{0, 1, 2, 3, 4}, {0, 1}});
+
+}  // namespace
+}  // namespace audioengine
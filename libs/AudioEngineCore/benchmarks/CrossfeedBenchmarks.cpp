@@ -0,0 +1,60 @@
+// Render-thread cost of the headphone crossfeed on synthetic stereo noise,
+// by sample rate and instruction set. "cpuPerSecond" is CPU seconds per
+// second of audio, as in CrossfadeBenchmarks.cpp; items are stereo frames,
+// whose cost does not depend on the rate.
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "AudioEngineCore/Crossfeed.h"
+#include "AudioEngineCore/SampleKernels.h"
+
+namespace audioengine {
+namespace {
+
+void BM_Crossfeed(benchmark::State& state) {
+  const uint32_t rate = static_cast<uint32_t>(state.range(0));
+  const bool vector = state.range(1) != 0;
+  // A 10 ms render block.
+  const size_t blockFrames = rate / 100;
+
+  const KernelIsa saved = ActiveKernelIsa();
+  if (vector) {
+    for (const KernelIsa isa : {KernelIsa::kAvx2, KernelIsa::kNeon, KernelIsa::kSse2}) {
+      if (SetKernelIsa(isa)) break;
+    }
+  } else {
+    SetKernelIsa(KernelIsa::kScalar);
+  }
+  state.SetLabel(std::to_string(rate / 1000) + "k/" + KernelIsaName(ActiveKernelIsa()));
+
+  Crossfeed crossfeed;
+  crossfeed.SetEnabled(true);
+  crossfeed.Configure(rate, 2);
+  std::vector<float> source(blockFrames * 2);
+  uint32_t seed = 1;
+  for (float& s : source) {
+    seed = seed * 1664525u + 1013904223u;
+    s = static_cast<float>(seed >> 8) / static_cast<float>(1u << 24) - 0.5f;
+  }
+  std::vector<float> block(source.size());
+
+  for (auto _ : state) {
+    block = source;
+    crossfeed.Process(block.data(), blockFrames);
+    benchmark::DoNotOptimize(block.data());
+    benchmark::ClobberMemory();
+  }
+  SetKernelIsa(saved);
+
+  const double frames = static_cast<double>(state.iterations() * blockFrames);
+  state.SetItemsProcessed(static_cast<int64_t>(frames));
+  state.counters["cpuPerSecond"] = benchmark::Counter(
+      frames / rate, benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+}
+BENCHMARK(BM_Crossfeed)->ArgsProduct({{44100, 96000, 384000}, {0, 1}});
+
+}  // namespace
+}  // namespace audioengine
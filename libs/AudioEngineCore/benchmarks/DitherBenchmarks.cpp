@@ -0,0 +1,71 @@
+// Render-thread cost of applying a gain to integer output with dither and
+// noise shaping, per render block. "cpuPerSecond" is CPU seconds per second
+// of audio, as in EqBenchmarks.cpp; the "off" rows are plain rounding
+// (ScaleSamples), the baseline the requantizer adds to. The 384 kHz rows are
+// the heaviest stream the engines open: 8 channels of 32-bit at 384 kHz,
+// where kFWeighted runs as kHighpass.
+#include <benchmark/benchmark.h>
+
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "AudioEngineCore/Dither.h"
+#include "AudioEngineCore/SampleKernels.h"
+
+namespace audioengine {
+namespace {
+
+constexpr DitherMode kModes[] = {DitherMode::kOff, DitherMode::kTpdf,
+                                 DitherMode::kHighpass, DitherMode::kFWeighted};
+
+void BM_Requantize(benchmark::State& state) {
+  const DitherMode mode = kModes[state.range(0)];
+  const uint32_t channels = static_cast<uint32_t>(state.range(1));
+  const uint32_t rate = static_cast<uint32_t>(state.range(2));
+  const bool vector = state.range(3) != 0;
+  const SampleType type = rate > 48000 ? SampleType::kS32 : SampleType::kS16;
+  // A 10 ms device period.
+  const size_t blockFrames = rate / 100;
+
+  const KernelIsa saved = ActiveKernelIsa();
+  if (vector) {
+    for (const KernelIsa isa : {KernelIsa::kAvx2, KernelIsa::kNeon, KernelIsa::kSse2}) {
+      if (SetKernelIsa(isa)) break;
+    }
+  } else {
+    SetKernelIsa(KernelIsa::kScalar);
+  }
+  state.SetLabel(std::string(DitherModeName(mode)) + "/" + std::to_string(channels) + "ch/" +
+                 std::to_string(rate / 1000) + "k/" + KernelIsaName(ActiveKernelIsa()));
+
+  Requantizer requantizer;
+  requantizer.SetMode(mode);
+  requantizer.Configure(type, rate, channels);
+  std::vector<float> tone(blockFrames * channels);
+  for (size_t i = 0; i < tone.size(); ++i) {
+    tone[i] = 0.5f * std::sin(0.03f * static_cast<float>(i));
+  }
+  std::vector<uint8_t> source(tone.size() * BytesPerSample(type));
+  ConvertSamples(SampleType::kF32, tone.data(), type, source.data(), tone.size());
+  std::vector<uint8_t> block(source.size());
+
+  for (auto _ : state) {
+    block = source;
+    requantizer.ApplyGain(block.data(), blockFrames, 0.7f);
+    benchmark::DoNotOptimize(block.data());
+    benchmark::ClobberMemory();
+  }
+  SetKernelIsa(saved);
+
+  const double seconds = static_cast<double>(state.iterations() * blockFrames) / rate;
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * blockFrames));
+  state.counters["cpuPerSecond"] = benchmark::Counter(
+      seconds, benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+}
+BENCHMARK(BM_Requantize)->ArgsProduct({{0, 1, 2, 3}, {2, 8}, {48000}, {0, 1}});
+BENCHMARK(BM_Requantize)->ArgsProduct({{0, 3}, {8}, {384000}, {0, 1}});
+
+}  // namespace
+}  // namespace audioengine
@@ -0,0 +1,75 @@
+// Render-thread cost of the parametric equalizer, per render block, by band
+// count, channel count and instruction set. "cpuPerSecond" is CPU seconds per
+// second of audio, as in CrossfadeBenchmarks.cpp; "cpuPerBandSecond" divides
+// that by the band count, the figure to budget a graphic EQ with. The
+// channels share SIMD lanes, so with a vector kernel 8 channels should cost
+// about what 2 do.
+#include <benchmark/benchmark.h>
+
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "AudioEngineCore/ParametricEq.h"
+#include "AudioEngineCore/SampleKernels.h"
+
+namespace audioengine {
+namespace {
+
+constexpr uint32_t kRate = 48000;
+constexpr size_t kBlockFrames = 480;
+
+void BM_ParametricEq(benchmark::State& state) {
+  const size_t bands = static_cast<size_t>(state.range(0));
+  const uint32_t channels = static_cast<uint32_t>(state.range(1));
+  const bool vector = state.range(2) != 0;
+
+  // The best instruction set the CPU has, or scalar.
+  const KernelIsa saved = ActiveKernelIsa();
+  if (vector) {
+    for (const KernelIsa isa : {KernelIsa::kAvx2, KernelIsa::kNeon, KernelIsa::kSse2}) {
+      if (SetKernelIsa(isa)) break;
+    }
+  } else {
+    SetKernelIsa(KernelIsa::kScalar);
+  }
+  state.SetLabel(std::to_string(bands) + " bands/" + std::to_string(channels) + "ch/" +
+                 KernelIsaName(ActiveKernelIsa()));
+
+  // Alternating boosts and cuts keep every band in the cascade.
+  std::vector<EqBand> eqBands(bands);
+  for (size_t b = 0; b < bands; ++b) {
+    eqBands[b].frequencyHz = 20.0 * std::pow(1000.0, (b + 0.5) / bands);
+    eqBands[b].gainDb = b % 2 ? 3.0 : -3.0;
+    eqBands[b].q = 1.4;
+  }
+  ParametricEq eq;
+  eq.SetBands(eqBands);
+  eq.Configure(kRate, channels);
+  std::vector<float> source(kBlockFrames * channels);
+  for (size_t i = 0; i < source.size(); ++i) {
+    source[i] = 0.5f * std::sin(0.03f * static_cast<float>(i));
+  }
+  std::vector<float> block(source.size());
+
+  for (auto _ : state) {
+    block = source;
+    eq.Process(block.data(), kBlockFrames);
+    benchmark::DoNotOptimize(block.data());
+    benchmark::ClobberMemory();
+  }
+  SetKernelIsa(saved);
+
+  const double seconds = static_cast<double>(state.iterations() * kBlockFrames) / kRate;
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * kBlockFrames));
+  state.counters["cpuPerSecond"] = benchmark::Counter(
+      seconds, benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+  state.counters["cpuPerBandSecond"] = benchmark::Counter(
+      seconds * static_cast<double>(bands),
+      benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+}
+BENCHMARK(BM_ParametricEq)->ArgsProduct({{1, 10, 31}, {2, 8}, {0, 1}});
+
+}  // namespace
+}  // namespace audioengine
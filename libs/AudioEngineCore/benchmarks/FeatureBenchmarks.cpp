@@ -0,0 +1,129 @@
+// Library feature analysis for the mood engine. BM_FeatureAnalyzer is the
+// cost of the analysis itself on one stereo track ("realtime" = seconds of
+// audio per CPU second); BM_FeatureScanner runs the worker pool over a
+// synthetic in-memory corpus, so it shows the pool's scaling without disk
+// or decoder cost. Its "tracksPerSecondPerCore" is the figure
+// FeatureScanner::Stats reports.
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "AudioEngineCore/AudioFeatures.h"
+#include "AudioEngineCore/FeatureScanner.h"
+
+namespace audioengine {
+namespace {
+
+constexpr uint32_t kRate = 44100;
+constexpr uint64_t kTrackFrames = uint64_t{kRate} * 30;
+constexpr size_t kBlockFrames = 4096;
+constexpr size_t kCorpusSize = 8;
+
+// Thirty seconds of stereo: a kick on every beat over a chord loop and
+// noise, tempo and key varying with `index`.
+std::vector<float> RenderTrack(size_t index) {
+  constexpr double kPi = 3.14159265358979323846;
+  const double bpm = 80.0 + 12.0 * index;
+  const double root = 220.0 * std::pow(2.0, static_cast<double>(index % 12) / 12.0);
+  const double beat = 60.0 * kRate / bpm;
+  std::vector<float> samples(kTrackFrames * 2);
+  uint32_t seed = static_cast<uint32_t>(index) + 1;
+  for (uint64_t f = 0; f < kTrackFrames; ++f) {
+    const double t = static_cast<double>(f) / kRate;
+    const double sinceBeat = std::fmod(static_cast<double>(f), beat) / kRate;
+    double value = 0.5 * std::exp(-sinceBeat * 30.0) * std::sin(2.0 * kPi * 60.0 * sinceBeat);
+    // Root, third and fifth of a chord that moves every two seconds.
+    const double chordRoot = root * (static_cast<int>(t / 2.0) % 2 ? 4.0 / 3.0 : 1.0);
+    for (const double ratio : {1.0, 1.25, 1.5}) {
+      value += 0.08 * std::sin(2.0 * kPi * chordRoot * ratio * t);
+    }
+    seed = seed * 1664525u + 1013904223u;
+    value += 0.02 * (static_cast<double>(seed >> 8) / 16777216.0 - 0.5);
+    samples[2 * f] = static_cast<float>(value);
+    samples[2 * f + 1] = static_cast<float>(value);
+  }
+  return samples;
+}
+
+// Rendered once; every scan reads them back without synthesis cost.
+const std::vector<std::vector<float>>& Corpus() {
+  static const std::vector<std::vector<float>> corpus = [] {
+    std::vector<std::vector<float>> tracks;
+    for (size_t i = 0; i < kCorpusSize; ++i) tracks.push_back(RenderTrack(i));
+    return tracks;
+  }();
+  return corpus;
+}
+
+class CorpusTrack : public PcmSource {
+ public:
+  explicit CorpusTrack(const std::vector<float>& samples) : samples_(samples) {}
+
+  PcmFormat Format() const override { return {kRate, 2, 32, true}; }
+
+  size_t ReadFrames(uint8_t* dst, size_t maxFrames) override {
+    const size_t frames = static_cast<size_t>(
+        std::min<uint64_t>(maxFrames, samples_.size() / 2 - position_));
+    std::copy_n(samples_.data() + position_ * 2, frames * 2, reinterpret_cast<float*>(dst));
+    position_ += frames;
+    return frames;
+  }
+
+  bool SeekToFrame(uint64_t, SeekMode, uint64_t*) override { return false; }
+
+ private:
+  const std::vector<float>& samples_;
+  size_t position_ = 0;
+};
+
+void BM_FeatureAnalyzer(benchmark::State& state) {
+  const std::vector<float>& track = Corpus()[3];
+  TrackFeatures features;
+  for (auto _ : state) {
+    FeatureAnalyzer analyzer;
+    analyzer.Configure(kRate, 2);
+    for (size_t at = 0; at < kTrackFrames; at += kBlockFrames) {
+      analyzer.Process(track.data() + at * 2,
+                       static_cast<size_t>(std::min<uint64_t>(kBlockFrames, kTrackFrames - at)));
+    }
+    analyzer.Finish(&features);
+    benchmark::DoNotOptimize(features);
+  }
+  state.SetLabel(std::to_string(static_cast<int>(std::lround(features.bpm))) + " BPM");
+  state.counters["realtime"] = benchmark::Counter(
+      static_cast<double>(state.iterations() * kTrackFrames) / kRate,
+      benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_FeatureAnalyzer)->Unit(benchmark::kMillisecond);
+
+void BM_FeatureScanner(benchmark::State& state) {
+  const unsigned workers = static_cast<unsigned>(state.range(0));
+  constexpr size_t kTracks = 16;
+  state.SetLabel(std::to_string(workers) + " workers");
+  Corpus();
+  double perCore = 0.0;
+  for (auto _ : state) {
+    // No cache directory: every track is analysed.
+    FeatureScanner scanner("", [](const std::string& path) {
+      return std::make_unique<CorpusTrack>(Corpus()[std::stoul(path.substr(5)) % kCorpusSize]);
+    }, workers);
+    std::vector<SeekIndex::Key> keys(kTracks);
+    for (size_t i = 0; i < kTracks; ++i) keys[i].path = "track" + std::to_string(i);
+    scanner.Enqueue(keys);
+    scanner.WaitIdle();
+    perCore += scanner.GetStats().TracksPerSecondPerCore();
+  }
+  state.counters["tracksPerSecondPerCore"] =
+      perCore / static_cast<double>(state.iterations());
+  state.counters["tracksPerSecond"] = benchmark::Counter(
+      static_cast<double>(state.iterations() * kTracks), benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_FeatureScanner)->Arg(1)->Arg(2)->Arg(4)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+}  // namespace
+}  // namespace audioengine
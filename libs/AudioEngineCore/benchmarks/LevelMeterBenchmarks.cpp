@@ -0,0 +1,77 @@
+// Render-thread cost of the level meters on synthetic noise, by channel
+// count, sample format, true peak on/off and instruction set.
+// "cpuPerSecond" is CPU seconds per second of audio at 48 kHz, as in
+// CrossfadeBenchmarks.cpp.
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "AudioEngineCore/LevelMeter.h"
+#include "AudioEngineCore/SampleKernels.h"
+
+namespace audioengine {
+namespace {
+
+constexpr uint32_t kRate = 48000;
+// A 10 ms render block.
+constexpr size_t kBlockFrames = kRate / 100;
+
+void BM_LevelMeter(benchmark::State& state) {
+  const uint32_t channels = static_cast<uint32_t>(state.range(0));
+  const bool isFloat = state.range(1) != 0;
+  const bool truePeak = state.range(2) != 0;
+  const bool vector = state.range(3) != 0;
+
+  const KernelIsa saved = ActiveKernelIsa();
+  if (vector) {
+    for (const KernelIsa isa : {KernelIsa::kAvx2, KernelIsa::kNeon, KernelIsa::kSse2}) {
+      if (SetKernelIsa(isa)) break;
+    }
+  } else {
+    SetKernelIsa(KernelIsa::kScalar);
+  }
+  state.SetLabel(std::to_string(channels) + "ch/" + (isFloat ? "f32" : "s16") +
+                 (truePeak ? "/tp/" : "/") + KernelIsaName(ActiveKernelIsa()));
+
+  LevelMeter meter;
+  meter.Configure({kRate, channels, isFloat ? 32u : 16u, isFloat});
+  LevelMeter::Options options;
+  options.truePeak = truePeak;
+  meter.SetOptions(options);
+  std::vector<float> floats(kBlockFrames * channels);
+  std::vector<int16_t> shorts(floats.size());
+  uint32_t seed = 1;
+  for (size_t i = 0; i < floats.size(); ++i) {
+    seed = seed * 1664525u + 1013904223u;
+    floats[i] = static_cast<float>(seed >> 8) / static_cast<float>(1u << 24) - 0.5f;
+    shorts[i] = static_cast<int16_t>(floats[i] * 32767.0f);
+  }
+  const void* block = isFloat ? static_cast<const void*>(floats.data()) : shorts.data();
+
+  for (auto _ : state) {
+    meter.Process(block, kBlockFrames);
+    benchmark::ClobberMemory();
+  }
+  SetKernelIsa(saved);
+
+  const double frames = static_cast<double>(state.iterations() * kBlockFrames);
+  state.SetItemsProcessed(static_cast<int64_t>(frames));
+  state.counters["cpuPerSecond"] = benchmark::Counter(
+      frames / kRate, benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+}
+BENCHMARK(BM_LevelMeter)->ArgsProduct({{2, 6, 8}, {1, 0}, {0, 1}, {0, 1}});
+
+// What a UI poll costs: one lock-free snapshot converted to dB.
+void BM_LevelMeterRead(benchmark::State& state) {
+  LevelMeter meter;
+  meter.Configure({kRate, 2, 32, true});
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(meter.Read());
+  }
+}
+BENCHMARK(BM_LevelMeterRead);
+
+}  // namespace
+}  // namespace audioengine
@@ -0,0 +1,48 @@
+// Render-thread cost of the normalization limiter, per render block. Rows
+// cover a signal that stays under the ceiling (detector and delay only) and
+// one pushed 6 dB over it (limiting all the time). "cpuPerSecond" is CPU
+// seconds per second of audio, as in CrossfadeBenchmarks.cpp.
+#include <benchmark/benchmark.h>
+
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "AudioEngineCore/TruePeakLimiter.h"
+
+namespace audioengine {
+namespace {
+
+constexpr uint32_t kRate = 48000;
+constexpr size_t kBlockFrames = 480;
+
+void BM_TruePeakLimiter(benchmark::State& state) {
+  const uint32_t channels = static_cast<uint32_t>(state.range(0));
+  const bool hot = state.range(1) != 0;
+  state.SetLabel(std::to_string(channels) + "ch/" + (hot ? "limiting" : "idle"));
+
+  TruePeakLimiter limiter;
+  limiter.Configure(kRate, channels);
+  const float level = hot ? 2.0f : 0.5f;
+  std::vector<float> source(kBlockFrames * channels);
+  for (size_t i = 0; i < source.size(); ++i) {
+    source[i] = level * std::sin(0.03f * static_cast<float>(i));
+  }
+  std::vector<float> block(source.size());
+
+  for (auto _ : state) {
+    block = source;
+    limiter.Process(block.data(), kBlockFrames);
+    benchmark::DoNotOptimize(block.data());
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * kBlockFrames));
+  state.counters["cpuPerSecond"] = benchmark::Counter(
+      static_cast<double>(state.iterations() * kBlockFrames) / kRate,
+      benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+}
+BENCHMARK(BM_TruePeakLimiter)->ArgsProduct({{1, 2, 6}, {0, 1}});
+
+}  // namespace
+}  // namespace audioengine
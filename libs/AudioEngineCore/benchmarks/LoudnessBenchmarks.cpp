@@ -0,0 +1,102 @@
+// Library loudness scanning. BM_LoudnessMeter is the per-channel cost of
+// the measurement itself ("realtime" = seconds of audio per CPU second);
+// BM_LoudnessScanner runs the worker pool over synthetic in-memory tracks,
+// so it shows the pool's scaling without disk or decoder cost. Its
+// "tracksPerSecondPerCore" is the figure LoudnessScanner::Stats reports.
+#include <benchmark/benchmark.h>
+
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "AudioEngineCore/LoudnessMeter.h"
+#include "AudioEngineCore/LoudnessScanner.h"
+
+namespace audioengine {
+namespace {
+
+constexpr uint32_t kRate = 44100;
+constexpr size_t kBlockFrames = 4096;
+
+// Thirty seconds of noise-modulated tone, regenerated per read.
+class SyntheticTrack : public PcmSource {
+ public:
+  explicit SyntheticTrack(uint64_t frames) : frames_(frames) {}
+
+  PcmFormat Format() const override { return {kRate, 2, 32, true}; }
+
+  size_t ReadFrames(uint8_t* dst, size_t maxFrames) override {
+    const size_t frames =
+        static_cast<size_t>(std::min<uint64_t>(maxFrames, frames_ - position_));
+    auto* out = reinterpret_cast<float*>(dst);
+    for (size_t i = 0; i < frames; ++i) {
+      seed_ = seed_ * 1664525u + 1013904223u;
+      const float noise = static_cast<float>(seed_ >> 8) / 16777216.0f - 0.5f;
+      const float value =
+          0.3f * std::sin(0.05f * static_cast<float>(position_ + i)) + 0.1f * noise;
+      out[2 * i] = value;
+      out[2 * i + 1] = -value;
+    }
+    position_ += frames;
+    return frames;
+  }
+
+  bool SeekToFrame(uint64_t, SeekMode, uint64_t*) override { return false; }
+
+ private:
+  uint64_t frames_;
+  uint64_t position_ = 0;
+  uint32_t seed_ = 1;
+};
+
+void BM_LoudnessMeter(benchmark::State& state) {
+  const uint32_t channels = static_cast<uint32_t>(state.range(0));
+  state.SetLabel(std::to_string(channels) + "ch");
+  LoudnessMeter meter;
+  meter.Configure(kRate, channels);
+  std::vector<float> block(kBlockFrames * channels);
+  for (size_t i = 0; i < block.size(); ++i) {
+    block[i] = 0.3f * std::sin(0.021f * static_cast<float>(i));
+  }
+
+  for (auto _ : state) {
+    meter.Process(block.data(), kBlockFrames);
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * kBlockFrames));
+  state.counters["realtime"] = benchmark::Counter(
+      static_cast<double>(state.iterations() * kBlockFrames) / kRate,
+      benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_LoudnessMeter)->Arg(1)->Arg(2)->Arg(6);
+
+void BM_LoudnessScanner(benchmark::State& state) {
+  const unsigned workers = static_cast<unsigned>(state.range(0));
+  constexpr size_t kTracks = 16;
+  state.SetLabel(std::to_string(workers) + " workers");
+  double perCore = 0.0;
+  for (auto _ : state) {
+    // No cache directory: every track is decoded.
+    LoudnessScanner scanner("", [](const std::string&) {
+      return std::make_unique<SyntheticTrack>(uint64_t{kRate} * 30);
+    }, workers);
+    std::vector<LoudnessScanner::Item> items(kTracks);
+    for (size_t i = 0; i < kTracks; ++i) {
+      items[i].key.path = "track" + std::to_string(i);
+      items[i].album = "album" + std::to_string(i / 8);
+    }
+    scanner.Enqueue(items);
+    scanner.WaitIdle();
+    perCore += scanner.GetStats().TracksPerSecondPerCore();
+  }
+  state.counters["tracksPerSecondPerCore"] =
+      perCore / static_cast<double>(state.iterations());
+  state.counters["tracksPerSecond"] = benchmark::Counter(
+      static_cast<double>(state.iterations() * kTracks), benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_LoudnessScanner)->Arg(1)->Arg(2)->Arg(4)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+}  // namespace
+}  // namespace audioengine
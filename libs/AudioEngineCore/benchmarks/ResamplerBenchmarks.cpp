@@ -0,0 +1,146 @@
+// Decode-thread cost of converting to the device rate, per quality preset and
+// rate pair, stereo float. The "cpuPerStreamSecond" counter is CPU seconds
+// spent per second of input audio (divide by 1e-6 for microseconds); the
+// scalar rows show what the vector dot products save.
+//
+// When libswresample is found at configure time, BM_Swresample runs the same
+// conversions through swr_convert with a matching filter length and cutoff,
+// as the baseline the engines' own FFmpeg path would cost.
+#include <benchmark/benchmark.h>
+
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "AudioEngineCore/Resampler.h"
+#include "AudioEngineCore/SampleKernels.h"
+
+#if defined(AUDIOENGINECORE_HAVE_SWRESAMPLE)
+extern "C" {
+#include <libavutil/channel_layout.h>
+#include <libavutil/opt.h>
+#include <libswresample/swresample.h>
+}
+#endif
+
+namespace audioengine {
+namespace {
+
+constexpr uint32_t kChannels = 2;
+// One decode block, about what a FLAC or AAC packet yields.
+constexpr size_t kBlockFrames = 4096;
+
+struct RateCase {
+  const char* name;
+  uint32_t in;
+  uint32_t out;
+};
+
+const RateCase kRates[] = {
+    {"44.1k->48k", 44100, 48000},
+    {"48k->44.1k", 48000, 44100},
+    {"96k->48k", 96000, 48000},
+};
+
+const ResamplerQuality kQualities[] = {
+    ResamplerQuality::kLow, ResamplerQuality::kMedium, ResamplerQuality::kHigh};
+const char* const kQualityNames[] = {"low", "medium", "high"};
+
+std::vector<float> Signal() {
+  std::vector<float> samples(kBlockFrames * kChannels);
+  for (size_t i = 0; i < samples.size(); ++i) {
+    samples[i] = 0.9f * std::sin(0.01f * static_cast<float>(i));
+  }
+  return samples;
+}
+
+void SetStreamCounter(benchmark::State& state, uint32_t inRate) {
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * kBlockFrames));
+  state.counters["cpuPerStreamSecond"] = benchmark::Counter(
+      static_cast<double>(state.iterations() * kBlockFrames) / inRate,
+      benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+}
+
+void BM_Resampler(benchmark::State& state) {
+  const RateCase& rc = kRates[state.range(0)];
+  const int quality = static_cast<int>(state.range(1));
+  const bool vector = state.range(2) != 0;
+  state.SetLabel(std::string(rc.name) + "/" + kQualityNames[quality] +
+                 (vector ? "/vector" : "/scalar"));
+
+  // The best instruction set the CPU has, or scalar.
+  const KernelIsa saved = ActiveKernelIsa();
+  if (vector) {
+    for (const KernelIsa isa : {KernelIsa::kAvx2, KernelIsa::kNeon, KernelIsa::kSse2}) {
+      if (SetKernelIsa(isa)) break;
+    }
+  } else {
+    SetKernelIsa(KernelIsa::kScalar);
+  }
+
+  PolyphaseResampler resampler;
+  resampler.Configure(rc.in, rc.out, kChannels, kQualities[quality]);
+  const std::vector<float> input = Signal();
+  std::vector<float> output((kBlockFrames * rc.out / rc.in + 2) * kChannels);
+
+  for (auto _ : state) {
+    const float* in = input.data();
+    size_t remaining = kBlockFrames;
+    while (remaining > 0) {
+      size_t consumed = 0;
+      resampler.Process(in, remaining, output.data(), output.size() / kChannels,
+                        &consumed);
+      in += consumed * kChannels;
+      remaining -= consumed;
+    }
+    benchmark::DoNotOptimize(output.data());
+    benchmark::ClobberMemory();
+  }
+  SetStreamCounter(state, rc.in);
+  SetKernelIsa(saved);
+}
+BENCHMARK(BM_Resampler)->ArgsProduct({{0, 1, 2}, {0, 1, 2}, {0, 1}});
+
+#if defined(AUDIOENGINECORE_HAVE_SWRESAMPLE)
+void BM_Swresample(benchmark::State& state) {
+  const RateCase& rc = kRates[state.range(0)];
+  const int quality = static_cast<int>(state.range(1));
+  state.SetLabel(std::string(rc.name) + "/" + kQualityNames[quality]);
+
+  // Same filter length and cutoff as the matching preset.
+  const int64_t taps[] = {16, 48, 96};
+  const double cutoff[] = {1.0, 0.97, 0.97};
+  AVChannelLayout layout = AV_CHANNEL_LAYOUT_STEREO;
+  SwrContext* swr = nullptr;
+  if (swr_alloc_set_opts2(&swr, &layout, AV_SAMPLE_FMT_FLT, rc.out, &layout,
+                          AV_SAMPLE_FMT_FLT, rc.in, 0, nullptr) < 0) {
+    state.SkipWithError("swr_alloc_set_opts2 failed");
+    return;
+  }
+  av_opt_set_int(swr, "filter_size", taps[quality], 0);
+  av_opt_set_double(swr, "cutoff", cutoff[quality], 0);
+  if (swr_init(swr) < 0) {
+    swr_free(&swr);
+    state.SkipWithError("swr_init failed");
+    return;
+  }
+
+  const std::vector<float> input = Signal();
+  const int maxOut = static_cast<int>(kBlockFrames * rc.out / rc.in + 64);
+  std::vector<float> output(static_cast<size_t>(maxOut) * kChannels);
+  for (auto _ : state) {
+    const uint8_t* in = reinterpret_cast<const uint8_t*>(input.data());
+    uint8_t* out = reinterpret_cast<uint8_t*>(output.data());
+    benchmark::DoNotOptimize(
+        swr_convert(swr, &out, maxOut, &in, static_cast<int>(kBlockFrames)));
+    benchmark::ClobberMemory();
+  }
+  SetStreamCounter(state, rc.in);
+  swr_free(&swr);
+}
+BENCHMARK(BM_Swresample)->ArgsProduct({{0, 1, 2}, {0, 1, 2}});
+#endif
+
+}  // namespace
+}  // namespace audioengine
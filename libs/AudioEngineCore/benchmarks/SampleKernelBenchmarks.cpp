@@ -0,0 +1,101 @@
+// Sample conversion and gain throughput per instruction set, over a 10 ms
+// stereo block at 48 kHz. Rows for instruction sets the CPU lacks are
+// skipped; compare each vector row with its "scalar" twin.
+#include <benchmark/benchmark.h>
+
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "AudioEngineCore/SampleKernels.h"
+
+namespace audioengine {
+namespace {
+
+constexpr size_t kBlockSamples = 480 * 2;
+
+struct PairCase {
+  const char* name;
+  SampleType from;
+  SampleType to;
+};
+
+const PairCase kPairs[] = {
+    {"f32->f32", SampleType::kF32, SampleType::kF32},
+    {"s16->f32", SampleType::kS16, SampleType::kF32},
+    {"f32->s16", SampleType::kF32, SampleType::kS16},
+    {"s32->f32", SampleType::kS32, SampleType::kF32},
+    {"f32->s32", SampleType::kF32, SampleType::kS32},
+    {"s24->f32", SampleType::kS24, SampleType::kF32},
+    {"f32->s24", SampleType::kF32, SampleType::kS24},
+};
+
+const SampleType kGainTypes[] = {SampleType::kS16, SampleType::kS24,
+                                 SampleType::kS32, SampleType::kF32,
+                                 SampleType::kF64};
+const char* const kGainNames[] = {"s16", "s24", "s32", "f32", "f64"};
+
+const KernelIsa kIsas[] = {KernelIsa::kScalar, KernelIsa::kSse2,
+                           KernelIsa::kAvx2, KernelIsa::kNeon};
+
+std::vector<uint8_t> Signal(SampleType type) {
+  std::vector<double> values(kBlockSamples);
+  for (size_t i = 0; i < values.size(); ++i) {
+    values[i] = 0.9 * std::sin(0.01 * static_cast<double>(i));
+  }
+  std::vector<uint8_t> bytes(kBlockSamples * BytesPerSample(type));
+  ConvertSamplesScalar(SampleType::kF64, values.data(), type, bytes.data(),
+                       kBlockSamples);
+  return bytes;
+}
+
+// Selects the ISA for the run; false (with the state skipped) if unsupported.
+bool UseIsa(benchmark::State& state, KernelIsa isa) {
+  if (SetKernelIsa(isa)) return true;
+  state.SkipWithError("instruction set not supported on this CPU");
+  return false;
+}
+
+void BM_ConvertSamples(benchmark::State& state) {
+  const PairCase& pair = kPairs[state.range(0)];
+  const KernelIsa isa = kIsas[state.range(1)];
+  state.SetLabel(std::string(pair.name) + "/" + KernelIsaName(isa));
+  const KernelIsa saved = ActiveKernelIsa();
+  if (!UseIsa(state, isa)) return;
+
+  const std::vector<uint8_t> src = Signal(pair.from);
+  std::vector<uint8_t> dst(kBlockSamples * BytesPerSample(pair.to));
+  for (auto _ : state) {
+    ConvertSamples(pair.from, src.data(), pair.to, dst.data(), kBlockSamples, 0.8f);
+    benchmark::DoNotOptimize(dst.data());
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * kBlockSamples));
+  SetKernelIsa(saved);
+}
+BENCHMARK(BM_ConvertSamples)->ArgsProduct({{0, 1, 2, 3, 4, 5, 6}, {0, 1, 2, 3}});
+
+void BM_ScaleSamples(benchmark::State& state) {
+  const SampleType type = kGainTypes[state.range(0)];
+  const KernelIsa isa = kIsas[state.range(1)];
+  state.SetLabel(std::string(kGainNames[state.range(0)]) + "/" + KernelIsaName(isa));
+  const KernelIsa saved = ActiveKernelIsa();
+  if (!UseIsa(state, isa)) return;
+
+  std::vector<uint8_t> samples = Signal(type);
+  // Alternate gains so the level neither decays to zero nor saturates.
+  float gain = 0.5f;
+  for (auto _ : state) {
+    ScaleSamples(type, samples.data(), kBlockSamples, gain);
+    gain = gain == 0.5f ? 2.0f : 0.5f;
+    benchmark::DoNotOptimize(samples.data());
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * kBlockSamples));
+  SetKernelIsa(saved);
+}
+BENCHMARK(BM_ScaleSamples)->ArgsProduct({{0, 1, 2, 3, 4}, {0, 1, 2, 3}});
+
+}  // namespace
+}  // namespace audioengine
@@ -0,0 +1,70 @@
+// Seek latency for fast vs. accurate seeks against codec-shaped synthetic
+// sources. Packet sizes, sync intervals and pre-roll follow the real codecs;
+// per-packet decode costs are rough relative figures, so compare modes and
+// profiles against each other rather than reading absolute numbers. Engines
+// report real per-codec figures via StreamingDecoder::LastSeekDuration().
+#include <benchmark/benchmark.h>
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+
+#include "AudioEngineCore/StreamingDecoder.h"
+#include "../tests/TestSources.h"
+
+namespace audioengine {
+namespace {
+
+using testing::PacketizedSource;
+using namespace std::chrono_literals;
+
+struct CodecProfile {
+  const char* name;
+  PacketizedSource::Profile profile;
+};
+
+const CodecProfile kProfiles[] = {
+    // Every frame is a sync point; no history needed.
+    {"flac", {4096, 4096, 0, 15us}},
+    // Bit reservoir reaches back up to two frames.
+    {"mp3", {1152, 1152, 2304, 8us}},
+    // One overlapped MDCT block of history.
+    {"aac", {1024, 1024, 2048, 10us}},
+    // Ogg pages hold ~1 s of packets; codecpar->seek_preroll is 80 ms.
+    {"opus", {960, 48000, 3840, 12us}},
+};
+
+void BM_Seek(benchmark::State& state) {
+  const CodecProfile& codec = kProfiles[state.range(0)];
+  const SeekMode mode = state.range(1) ? SeekMode::kAccurate : SeekMode::kFast;
+  state.SetLabel(std::string(codec.name) +
+                 (mode == SeekMode::kAccurate ? "/accurate" : "/fast"));
+
+  constexpr uint32_t kRate = 48000;
+  constexpr uint64_t kFrames = kRate * 600ull;
+  StreamingDecoder::Options options;
+  options.bufferSeconds = 0.5;
+  options.prefillSeconds = 0.05;
+  StreamingDecoder decoder(options);
+  decoder.Start(
+      std::make_unique<PacketizedSource>(kRate, 2, kFrames, codec.profile));
+
+  // Walk targets that never sit on a sync point.
+  uint64_t target = kRate * 7 + 333;
+  uint64_t error = 0;
+  for (auto _ : state) {
+    decoder.Seek(target, mode);
+    state.SetIterationTime(decoder.LastSeekDuration().count() / 1e6);
+    error += target - decoder.PositionFrames();
+    target = (target + kRate * 13 + 777) % (kFrames - kRate);
+  }
+  state.counters["landingErrorMs"] = benchmark::Counter(
+      error * 1000.0 / kRate / static_cast<double>(state.iterations()));
+}
+BENCHMARK(BM_Seek)
+    ->ArgsProduct({{0, 1, 2, 3}, {0, 1}})
+    ->UseManualTime()
+    ->Unit(benchmark::kMillisecond);
+
+}  // namespace
+}  // namespace audioengine
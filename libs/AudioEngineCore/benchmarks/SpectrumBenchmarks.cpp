@@ -0,0 +1,64 @@
+// Render-thread cost of the spectrum tap, with the analyzer's worker
+// draining and analysing at 60 frames a second alongside, by output format.
+// "cpuPerSecond" is render CPU seconds per second of audio, as in
+// CrossfadeBenchmarks.cpp; the worker's own cost is not in it. Taps run
+// far faster than real time, so the timer pauses every few blocks to let
+// the worker drain the ring; "droppedFrames" should stay 0, or the rows
+// time the drop path instead of the copy.
+#include <benchmark/benchmark.h>
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "AudioEngineCore/Spectrum.h"
+
+namespace audioengine {
+namespace {
+
+void BM_SpectrumTap(benchmark::State& state) {
+  const PcmFormat format{static_cast<uint32_t>(state.range(0)),
+                         static_cast<uint32_t>(state.range(1)),
+                         static_cast<uint32_t>(state.range(2)), state.range(2) == 32};
+  // A 10 ms render block.
+  const size_t blockFrames = format.sampleRate / 100;
+  state.SetLabel(std::to_string(format.sampleRate / 1000) + "k/" +
+                 std::to_string(format.channels) + "ch/" +
+                 (format.isFloat ? "f32" : "s" + std::to_string(format.bitsPerSample)));
+
+  SpectrumAnalyzer analyzer;
+  analyzer.Configure(format);
+  analyzer.SetEnabled(true);
+  std::vector<uint8_t> block(blockFrames * format.BytesPerFrame(), 0x11);
+
+  // 80 ms per burst, well inside the ring.
+  constexpr int kBurstBlocks = 8;
+  int burst = 0;
+  for (auto _ : state) {
+    if (++burst == kBurstBlocks) {
+      state.PauseTiming();
+      std::this_thread::sleep_for(std::chrono::milliseconds(25));
+      burst = 0;
+      state.ResumeTiming();
+    }
+    analyzer.Tap(block.data(), blockFrames);
+    benchmark::ClobberMemory();
+  }
+
+  const double frames = static_cast<double>(state.iterations() * blockFrames);
+  state.SetItemsProcessed(static_cast<int64_t>(frames));
+  state.counters["cpuPerSecond"] = benchmark::Counter(
+      frames / format.sampleRate, benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+  state.counters["droppedFrames"] = static_cast<double>(analyzer.DroppedFrames());
+}
+BENCHMARK(BM_SpectrumTap)
+    ->Iterations(240)
+    ->Args({48000, 2, 32})
+    ->Args({48000, 2, 16})
+    ->Args({192000, 2, 24})
+    ->Args({384000, 8, 32});
+
+}  // namespace
+}  // namespace audioengine
@@ -0,0 +1,82 @@
+// Render-thread cost of pitch-preserving playback rate on synthetic input
+// (a chord under noise, so the search has no easy answer), by rate, channel
+// count and instruction set. "cpuPerSecond" is CPU seconds per second of
+// output, as in CrossfadeBenchmarks.cpp.
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "AudioEngineCore/SampleKernels.h"
+#include "AudioEngineCore/TimeStretch.h"
+
+namespace audioengine {
+namespace {
+
+constexpr uint32_t kRate = 48000;
+constexpr size_t kBlockFrames = 480;
+
+void BM_TimeStretch(benchmark::State& state) {
+  const double rate = static_cast<double>(state.range(0)) / 100.0;
+  const uint32_t channels = static_cast<uint32_t>(state.range(1));
+  const bool vector = state.range(2) != 0;
+
+  const KernelIsa saved = ActiveKernelIsa();
+  if (vector) {
+    for (const KernelIsa isa : {KernelIsa::kAvx2, KernelIsa::kNeon, KernelIsa::kSse2}) {
+      if (SetKernelIsa(isa)) break;
+    }
+  } else {
+    SetKernelIsa(KernelIsa::kScalar);
+  }
+  state.SetLabel(std::to_string(state.range(0)) + "%/" + std::to_string(channels) + "ch/" +
+                 KernelIsaName(ActiveKernelIsa()));
+
+  // Ten seconds of input, looped.
+  std::vector<float> source(kRate * 10 * channels);
+  uint32_t seed = 1;
+  for (size_t f = 0; f < source.size() / channels; ++f) {
+    const double t = static_cast<double>(f) / kRate;
+    const float chord = static_cast<float>(0.2 * std::sin(2 * 3.14159265 * 196.0 * t) +
+                                           0.15 * std::sin(2 * 3.14159265 * 247.0 * t) +
+                                           0.1 * std::sin(2 * 3.14159265 * 294.0 * t));
+    for (uint32_t ch = 0; ch < channels; ++ch) {
+      seed = seed * 1664525u + 1013904223u;
+      source[f * channels + ch] =
+          chord + 0.05f * (static_cast<float>(seed >> 8) / static_cast<float>(1u << 24) - 0.5f);
+    }
+  }
+  size_t position = 0;
+  const auto read = [&](float* dst, size_t frames) {
+    const size_t total = source.size() / channels;
+    for (size_t f = 0; f < frames; ++f) {
+      std::copy_n(source.data() + position * channels, channels, dst + f * channels);
+      position = (position + 1) % total;
+    }
+    return frames;
+  };
+
+  TimeStretcher stretcher;
+  stretcher.Configure(kRate, channels);
+  stretcher.SetRate(rate);
+  std::vector<float> block(kBlockFrames * channels);
+
+  for (auto _ : state) {
+    stretcher.Read(block.data(), kBlockFrames, read);
+    benchmark::DoNotOptimize(block.data());
+    benchmark::ClobberMemory();
+  }
+  SetKernelIsa(saved);
+
+  const double seconds = static_cast<double>(state.iterations() * kBlockFrames) / kRate;
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * kBlockFrames));
+  state.counters["cpuPerSecond"] = benchmark::Counter(
+      seconds, benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+}
+BENCHMARK(BM_TimeStretch)->ArgsProduct({{100, 125, 150, 200}, {1, 2}, {0, 1}});
+
+}  // namespace
+}  // namespace audioengine
@@ -0,0 +1,79 @@
+// Waveform overviews. BM_WaveformBuild is the reduction cost alone
+// ("realtime" = seconds of audio per CPU second; decoding dominates in the
+// engines). BM_WaveformLoad is what the UI pays to get a cached waveform:
+// map, header check and level pick, by track length; it should stay far
+// under a millisecond and not grow with the track.
+#include <benchmark/benchmark.h>
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "AudioEngineCore/Waveform.h"
+
+namespace audioengine {
+namespace {
+
+constexpr uint32_t kRate = 44100;
+constexpr size_t kBlockFrames = 4096;
+
+std::vector<float> Block(uint32_t channels) {
+  std::vector<float> block(kBlockFrames * channels);
+  for (size_t i = 0; i < block.size(); ++i) {
+    block[i] = 0.3f * std::sin(0.021f * static_cast<float>(i));
+  }
+  return block;
+}
+
+void BM_WaveformBuild(benchmark::State& state) {
+  const uint32_t channels = static_cast<uint32_t>(state.range(0));
+  state.SetLabel(std::to_string(channels) + "ch");
+  const std::vector<float> block = Block(channels);
+  WaveformBuilder builder;
+  builder.Configure(kRate, channels);
+  for (auto _ : state) {
+    builder.Process(block.data(), kBlockFrames);
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * kBlockFrames));
+  state.counters["realtime"] = benchmark::Counter(
+      static_cast<double>(state.iterations() * kBlockFrames) / kRate,
+      benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_WaveformBuild)->Arg(1)->Arg(2)->Arg(6);
+
+void BM_WaveformLoad(benchmark::State& state) {
+  const uint64_t minutes = static_cast<uint64_t>(state.range(0));
+  state.SetLabel(std::to_string(minutes) + " min");
+  const std::string dir = (std::filesystem::temp_directory_path() / "").string();
+  const SeekIndex::Key key{dir + "bench-waveform.flac", minutes, 1700000000};
+  {
+    const std::vector<float> block = Block(2);
+    WaveformBuilder builder;
+    builder.Configure(kRate, 2);
+    for (uint64_t f = 0; f < minutes * 60 * kRate; f += kBlockFrames) {
+      builder.Process(block.data(), kBlockFrames);
+    }
+    if (!builder.Finish()->Save(dir, key)) {
+      state.SkipWithError("cannot write the cache file");
+      return;
+    }
+  }
+  size_t points = 0;
+  for (auto _ : state) {
+    const auto waveform = Waveform::Map(dir, key);
+    const WaveformLevel& level = waveform->LevelFor(1000);
+    points += level.count;
+    benchmark::DoNotOptimize(level.points[level.count / 2]);
+  }
+  benchmark::DoNotOptimize(points);
+  std::remove((dir + Waveform::CacheFileName(key)).c_str());
+}
+BENCHMARK(BM_WaveformLoad)->Arg(4)->Arg(60)->Unit(benchmark::kMicrosecond);
+
+}  // namespace
+}  // namespace audioengine
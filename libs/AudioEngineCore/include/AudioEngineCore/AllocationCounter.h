@@ -0,0 +1,19 @@
+// Debug-only heap allocation counter.
+//
+// When AudioEngineCore is built with AUDIOENGINECORE_COUNT_ALLOCATIONS, the
+// global operator new is replaced by a counting version so tests and debug
+// builds can assert that real-time and steady-state decode paths never touch
+// the heap. In regular builds the functions below are inert.
+#pragma once
+
+#include <cstdint>
+
+namespace audioengine::debug {
+
+// True when the counting operator new is compiled in.
+bool AllocationCountingEnabled();
+
+// Number of operator new calls made by the calling thread so far.
+uint64_t ThreadAllocationCount();
+
+}  // namespace audioengine::debug
@@ -0,0 +1,118 @@
+// Per-track musical features for the mood engine: tempo, key, energy,
+// danceability and spectral shape.
+//
+// FeatureAnalyzer takes a whole decoded track and looks at a mono downmix,
+// box-averaged down by a power of two while the result stays at or above
+// 20 kHz (44.1 and 88.2 kHz both become 22.05 kHz; nothing it measures is
+// near the new Nyquist). A 2048-point Hann FFT every 256 samples gives:
+// - spectral centroid, spread, 85% rolloff and flatness, averaged over the
+//   frames above -60 dBFS;
+// - a log-compressed spectral-flux onset envelope (~86 Hz). Tempo is the
+//   autocorrelation peak of the envelope between 60 and 200 BPM, weighted
+//   by a log-normal prior around 120 BPM and by the peak at twice the lag,
+//   which keeps half and double tempos apart;
+// - a 12-bin chroma from the 200 Hz - 5 kHz bins. The key is the best of the
+//   24 rotated Krumhansl-Kessler profiles by correlation.
+//
+// Energy and danceability are 0-1 blends of those measurements (see
+// FeatureAnalyzer::Finish()); they rank tracks, they are not calibrated to
+// any listening test.
+//
+// Configure() and Finish() allocate; Process() only grows the onset
+// envelope. Not for the render thread: FeatureScanner runs it on library
+// workers.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "AudioEngineCore/Fft.h"
+
+namespace audioengine {
+
+struct TrackFeatures {
+  // 0 when there is no steady pulse.
+  double bpm = 0.0;
+  // Autocorrelation of the onset envelope at the beat period, relative to
+  // its zero-lag value: 0 no pulse, 1 perfectly periodic.
+  double tempoConfidence = 0.0;
+  // Pitch class of the tonic, 0 = C to 11 = B; -1 when nothing tonal was
+  // heard.
+  int key = -1;
+  bool minor = false;
+  // Correlation of the chroma with the winning key profile, 0-1.
+  double keyConfidence = 0.0;
+  // 0-1.
+  double energy = 0.0;
+  double danceability = 0.0;
+  // Mean square of the mono downmix over the whole track, in dBFS.
+  double rmsDb = -120.0;
+  // Onsets per second.
+  double onsetRate = 0.0;
+  double spectralCentroidHz = 0.0;
+  double spectralSpreadHz = 0.0;
+  double spectralRolloffHz = 0.0;
+  // Geometric over arithmetic mean of the power spectrum: near 0 for tones,
+  // towards 1 for noise.
+  double spectralFlatness = 0.0;
+  uint64_t frames = 0;
+  uint32_t sampleRate = 0;
+};
+
+class FeatureAnalyzer {
+ public:
+  static constexpr size_t kFftSize = 2048;
+  static constexpr size_t kHop = 256;
+
+  void Configure(uint32_t sampleRate, uint32_t channels);
+  // Interleaved float frames of the configured layout.
+  void Process(const float* samples, size_t frames);
+  // Features of everything processed since Configure(); false if nothing
+  // was.
+  bool Finish(TrackFeatures* result);
+
+  // Rate the analysis runs at, after decimation.
+  uint32_t AnalysisRate() const { return sampleRate_ / decimation_; }
+
+ private:
+  void AnalyzeFrame();
+  double EstimateTempo(double* confidence, double* onsetRate) const;
+
+  uint32_t sampleRate_ = 0;
+  uint32_t channels_ = 0;
+  uint32_t decimation_ = 1;
+  uint64_t frames_ = 0;
+
+  // Decimator state.
+  float decimateSum_ = 0.0f;
+  uint32_t decimateCount_ = 0;
+
+  // Last kFftSize decimated samples, stored twice so a frame is contiguous.
+  std::vector<float> ring_;
+  size_t ringPos_ = 0;
+  size_t sinceFrame_ = 0;
+  double sumSquares_ = 0.0;
+
+  RealFft fft_;
+  std::vector<float> window_;
+  std::vector<float> windowed_;
+  std::vector<float> re_;
+  std::vector<float> im_;
+  std::vector<float> magnitude_;
+  std::vector<float> logMagnitude_;
+  std::vector<float> prevLogMagnitude_;
+  std::vector<float> binHz_;
+  // Pitch class per bin, -1 outside the chroma range.
+  std::vector<int8_t> binPitchClass_;
+
+  std::vector<float> onsets_;
+  double chroma_[12] = {};
+  double centroidSum_ = 0.0;
+  double spreadSum_ = 0.0;
+  double rolloffSum_ = 0.0;
+  double flatnessSum_ = 0.0;
+  size_t voicedFrames_ = 0;
+};
+
+}  // namespace audioengine
@@ -0,0 +1,176 @@
+// Channel-layout-aware down- and upmixing.
+//
+// Layouts are speaker masks with the bit assignment FFmpeg's AV_CH_* and
+// WAVEFORMATEXTENSIBLE's SPEAKER_* share; interleaved channels follow the
+// set bits from the lowest up. A ChannelMatrix gives every output channel a
+// gain for every input channel. ChannelMatrix::Downmix() builds one between
+// two layouts from the ITU-R BS.775 coefficients; any other matrix can be
+// passed in directly.
+//
+// ChannelMixingSource applies a matrix on the decode thread, so a 5.1 or
+// 7.1 track reaches the ring, the crossfader and the output stream with only
+// the channels the device plays. The mixer keeps the output channels of a
+// frame in SIMD lanes, picked the same way as SampleKernels.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "AudioEngineCore/PcmSource.h"
+
+namespace audioengine {
+
+namespace speaker {
+constexpr uint64_t kFrontLeft = 1ull << 0;
+constexpr uint64_t kFrontRight = 1ull << 1;
+constexpr uint64_t kFrontCenter = 1ull << 2;
+constexpr uint64_t kLowFrequency = 1ull << 3;
+constexpr uint64_t kBackLeft = 1ull << 4;
+constexpr uint64_t kBackRight = 1ull << 5;
+constexpr uint64_t kFrontLeftOfCenter = 1ull << 6;
+constexpr uint64_t kFrontRightOfCenter = 1ull << 7;
+constexpr uint64_t kBackCenter = 1ull << 8;
+constexpr uint64_t kSideLeft = 1ull << 9;
+constexpr uint64_t kSideRight = 1ull << 10;
+constexpr uint64_t kTopCenter = 1ull << 11;
+constexpr uint64_t kTopFrontLeft = 1ull << 12;
+constexpr uint64_t kTopFrontCenter = 1ull << 13;
+constexpr uint64_t kTopFrontRight = 1ull << 14;
+constexpr uint64_t kTopBackLeft = 1ull << 15;
+constexpr uint64_t kTopBackCenter = 1ull << 16;
+constexpr uint64_t kTopBackRight = 1ull << 17;
+}  // namespace speaker
+
+constexpr uint64_t kLayoutMono = speaker::kFrontCenter;
+constexpr uint64_t kLayoutStereo = speaker::kFrontLeft | speaker::kFrontRight;
+constexpr uint64_t kLayoutQuad = kLayoutStereo | speaker::kBackLeft | speaker::kBackRight;
+// FFmpeg's "5.1" has side surrounds; WAVE, FLAC and Android use the back pair.
+constexpr uint64_t kLayout5Point1 =
+    kLayoutQuad | speaker::kFrontCenter | speaker::kLowFrequency;
+constexpr uint64_t kLayout5Point1Side = kLayoutStereo | speaker::kFrontCenter |
+                                        speaker::kLowFrequency | speaker::kSideLeft |
+                                        speaker::kSideRight;
+constexpr uint64_t kLayout7Point1 =
+    kLayout5Point1 | speaker::kSideLeft | speaker::kSideRight;
+
+uint32_t LayoutChannels(uint64_t layout);
+// The order FLAC, Vorbis and WAVE assume when a file does not say: mono,
+// stereo, 3.0, quad, 5.0, 5.1, 6.1, 7.1. 0 for other counts.
+uint64_t DefaultLayout(uint32_t channels);
+// `layout` if it has `channels` speakers, else DefaultLayout(channels); for
+// decoders that report no mask, or one that disagrees with the stream.
+uint64_t ResolveLayout(uint64_t layout, uint32_t channels);
+// "mono", "stereo", "5.1", ... or "N-ch" for layouts without a common name.
+std::string LayoutName(uint64_t layout);
+
+enum class LfeMode : uint8_t {
+  // Left out unless the output has an LFE channel of its own (ITU-R BS.775).
+  kDrop,
+  // Mixed into the centre, or the front pair without one, at lfeDb.
+  kMix,
+};
+
+struct DownmixOptions {
+  // Levels of the centre and of each surround channel in the front pair
+  // when the output has no speaker for them; -3 dB per ITU-R BS.775.
+  double centerDb = -3.0103;
+  double surroundDb = -3.0103;
+  LfeMode lfe = LfeMode::kDrop;
+  double lfeDb = 0.0;
+  // Scales the whole matrix down so that no output can exceed full scale
+  // when every input it takes does (as swresample's clip protection). Off,
+  // a 5.1 downmix of loud material can reach +7.7 dB.
+  bool normalize = true;
+};
+
+class ChannelMatrix {
+ public:
+  static constexpr uint32_t kMaxChannels = 8;
+
+  ChannelMatrix() = default;
+  // `coefficients` holds `outputs` rows of `inputs` gains: output o is the
+  // sum of coefficients[o * inputs + i] * input i. Empty() for sizes that do
+  // not match or exceed kMaxChannels.
+  ChannelMatrix(uint32_t inputs, uint32_t outputs, std::vector<float> coefficients);
+
+  // From `inLayout` to `outLayout`. Speakers in both pass through at unity;
+  // the rest fold into the nearest output speakers (surrounds to sides or
+  // backs, then to the front pair; centre to the front pair; front pair to
+  // the centre for mono). Empty() when either layout has more than
+  // kMaxChannels speakers, or the output has neither a front pair nor a
+  // centre.
+  static ChannelMatrix Downmix(uint64_t inLayout, uint64_t outLayout,
+                               const DownmixOptions& options = DownmixOptions());
+
+  bool Empty() const { return inputs_ == 0; }
+  uint32_t Inputs() const { return inputs_; }
+  uint32_t Outputs() const { return outputs_; }
+  float At(uint32_t output, uint32_t input) const {
+    return coefficients_[output * inputs_ + input];
+  }
+  // Same channel count in and out, unity on the diagonal and nothing else.
+  bool IsIdentity() const;
+
+ private:
+  uint32_t inputs_ = 0;
+  uint32_t outputs_ = 0;
+  std::vector<float> coefficients_;
+};
+
+class ChannelMixer {
+ public:
+  static constexpr uint32_t kMaxChannels = ChannelMatrix::kMaxChannels;
+
+  // False (and unconfigured) for an empty matrix.
+  bool Configure(const ChannelMatrix& matrix);
+  bool IsConfigured() const { return inputs_ != 0; }
+  uint32_t Inputs() const { return inputs_; }
+  uint32_t Outputs() const { return outputs_; }
+
+  // Mixes `frames` interleaved frames of Inputs() channels into `out`, which
+  // takes Outputs() channels per frame and must not overlap `in`. Never
+  // allocates.
+  void Process(const float* in, float* out, size_t frames) const;
+
+ private:
+  uint32_t inputs_ = 0;
+  uint32_t outputs_ = 0;
+  // Per input channel, its gain to each output channel, zero-padded: one
+  // column of the matrix per SIMD vector. For one or two outputs, pairs_
+  // holds the column twice, for kernels that mix two frames per four lanes.
+  alignas(32) float columns_[kMaxChannels][kMaxChannels] = {};
+  alignas(16) float pairs_[kMaxChannels][4] = {};
+};
+
+// Mixes a float source through a matrix, on the thread that reads it.
+class ChannelMixingSource : public PcmSource {
+ public:
+  // `inner` must produce 32-bit float with matrix.Inputs() channels; check
+  // CanMix() first.
+  ChannelMixingSource(std::unique_ptr<PcmSource> inner, const ChannelMatrix& matrix);
+
+  static bool CanMix(const PcmFormat& format, const ChannelMatrix& matrix);
+
+  PcmFormat Format() const override { return format_; }
+  size_t ReadFrames(uint8_t* dst, size_t maxFrames) override;
+  bool SeekToFrame(uint64_t frame, SeekMode mode,
+                   uint64_t* landedFrame) override {
+    return inner_->SeekToFrame(frame, mode, landedFrame);
+  }
+  uint64_t TotalFrames() const override { return inner_->TotalFrames(); }
+
+  PcmSource* Inner() const { return inner_.get(); }
+
+ private:
+  static constexpr size_t kBlockFrames = 1024;
+
+  std::unique_ptr<PcmSource> inner_;
+  PcmFormat format_;
+  ChannelMixer mixer_;
+  std::vector<float> input_;
+};
+
+}  // namespace audioengine
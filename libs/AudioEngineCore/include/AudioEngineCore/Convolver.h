@@ -0,0 +1,232 @@
+// Partitioned FFT convolution for long FIR filters (room and headphone
+// correction).
+//
+// The filter is split in two uniformly partitioned overlap-save stages. The
+// head covers the first 2T taps in partitions of one block (B frames) and
+// runs on the calling thread, so each block costs one small FFT pair plus a
+// few spectral multiply-accumulates. The tail covers the rest in partitions
+// of T = B * 2^k frames on a worker thread. Tail output for a block is not
+// needed until 2T frames after its input arrived, which gives the worker a
+// full T-frame period to finish it. T is picked per filter to minimise the
+// combined cost; filters that fit in the head run without a worker.
+//
+// Output frame n uses input up to frame n, so a block in gives the same
+// block out: a ConvolvingSource adds no delay beyond the filter's own.
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "AudioEngineCore/Fft.h"
+#include "AudioEngineCore/PcmSource.h"
+
+namespace audioengine {
+
+// Impulse responses as loaded: one per channel, or a single one applied to
+// every channel.
+struct FirFilter {
+  uint32_t sampleRate = 0;
+  std::vector<std::vector<float>> channels;
+
+  size_t Taps() const;
+};
+
+// Longest response accepted from a file: about 22 s at 48 kHz.
+constexpr size_t kMaxFirTaps = size_t{1} << 20;
+
+// Reads `source` (an impulse response file decoded to 32-bit float) to the
+// end, one response per channel. False if it is not float, empty or longer
+// than kMaxFirTaps.
+bool ReadFirFilter(PcmSource& source, FirFilter* filter);
+
+// `filter` converted to `sampleRate`, scaled so its frequency response keeps
+// its level. Returns `filter` unchanged when the rates match.
+FirFilter ResampleFir(const FirFilter& filter, uint32_t sampleRate);
+
+// Partition spectra of a filter at one sample rate and block size. Immutable
+// once created, so every convolver running the filter shares one copy.
+class ConvolutionFilter {
+ public:
+  static constexpr uint32_t kDefaultBlockFrames = 256;
+
+  // Resamples `fir` to `sampleRate` if needed and transforms it. Null for an
+  // empty filter or a block size that is not a power of two.
+  static std::shared_ptr<const ConvolutionFilter> Create(
+      std::shared_ptr<const FirFilter> fir, uint32_t sampleRate,
+      uint32_t blockFrames = kDefaultBlockFrames);
+
+  const std::shared_ptr<const FirFilter>& Fir() const { return fir_; }
+  uint32_t SampleRate() const { return sampleRate_; }
+  uint32_t Channels() const { return static_cast<uint32_t>(head_.size()); }
+  size_t Taps() const { return taps_; }
+  // B and T above.
+  uint32_t BlockFrames() const { return blockFrames_; }
+  uint32_t TailPartitionFrames() const { return tailFrames_; }
+  uint32_t HeadPartitions() const { return headPartitions_; }
+  uint32_t TailPartitions() const { return tailPartitions_; }
+  // Whether a stream with `channels` channels can run this filter.
+  bool Supports(uint32_t channels) const;
+
+ private:
+  friend class PartitionedConvolver;
+
+  ConvolutionFilter() = default;
+
+  std::shared_ptr<const FirFilter> fir_;
+  uint32_t sampleRate_ = 0;
+  size_t taps_ = 0;
+  uint32_t blockFrames_ = 0;
+  uint32_t tailFrames_ = 0;
+  uint32_t headPartitions_ = 0;
+  uint32_t tailPartitions_ = 0;
+  // Per filter channel, partition after partition, split complex (all real
+  // parts of a partition, then its imaginary parts). Pre-scaled by 1/N.
+  std::vector<std::vector<float>> head_;
+  std::vector<std::vector<float>> tail_;
+};
+
+class PartitionedConvolver {
+ public:
+  struct Stats {
+    uint64_t framesProcessed = 0;
+    // Time spent in Process() on the calling thread (not counting waits for
+    // the worker), and on the worker.
+    uint64_t headNanos = 0;
+    uint64_t tailNanos = 0;
+    // Times Process() had to wait for the worker to finish a tail block.
+    uint64_t tailWaits = 0;
+
+    // Fractions of real time at `sampleRate`.
+    double HeadLoad(uint32_t sampleRate) const {
+      return framesProcessed == 0 || sampleRate == 0
+                 ? 0.0
+                 : headNanos * 1e-9 * sampleRate / framesProcessed;
+    }
+    double TailLoad(uint32_t sampleRate) const {
+      return framesProcessed == 0 || sampleRate == 0
+                 ? 0.0
+                 : tailNanos * 1e-9 * sampleRate / framesProcessed;
+    }
+  };
+
+  PartitionedConvolver() = default;
+  ~PartitionedConvolver();
+
+  PartitionedConvolver(const PartitionedConvolver&) = delete;
+  PartitionedConvolver& operator=(const PartitionedConvolver&) = delete;
+
+  // Allocates the state and starts the worker when the filter has a tail.
+  // False (and unconfigured) if `filter` cannot run on `channels` channels.
+  bool Configure(std::shared_ptr<const ConvolutionFilter> filter,
+                 uint32_t channels);
+  bool IsConfigured() const { return filter_ != nullptr; }
+  uint32_t BlockFrames() const { return filter_ ? filter_->BlockFrames() : 0; }
+
+  // Convolves one block of BlockFrames() interleaved frames; `in` and `out`
+  // may be the same buffer. Never allocates.
+  void Process(const float* in, float* out);
+  // Forgets all input (after a seek). Waits for the worker to go idle.
+  void Reset();
+
+  Stats GetStats() const;
+
+ private:
+  // One channel's overlap-save state for one stage.
+  struct Stage {
+    // Previous and current block, 2 * partition frames.
+    std::vector<float> window;
+    // Input spectra, newest at `newest`, one per filter partition.
+    std::vector<float> delayLine;
+    uint32_t newest = 0;
+  };
+
+  // Runs one stage on `block` (partition frames of mono input) and writes
+  // the partition frames of output to `out`.
+  void RunStage(Stage& stage, const float* spectra, uint32_t partitions,
+                uint32_t frames, RealFft& fft, const float* block, float* out,
+                std::vector<float>& accumulator, std::vector<float>& scratch);
+  void WorkerLoop();
+  void StopWorker();
+  void ClearState();
+
+  std::shared_ptr<const ConvolutionFilter> filter_;
+  uint32_t channels_ = 0;
+
+  // Calling thread.
+  RealFft headFft_;
+  std::vector<Stage> head_;
+  std::vector<float> headAccumulator_;
+  std::vector<float> headScratch_;
+  std::vector<float> planar_;
+  std::vector<float> planarOut_;
+  std::vector<float*> planes_;
+  // Frames seen since the last Reset(); decides tail submission and use.
+  uint64_t position_ = 0;
+
+  // Tail hand-off. Input block j is collected in tailIn_[j % 2] and handed
+  // over when complete; the worker writes its output to tailOut_[j % 2],
+  // which is added in from frame (j + 2) * T. Planar, T frames per channel.
+  std::vector<float> tailIn_[2];
+  std::vector<float> tailOut_[2];
+  uint64_t submitted_ = 0;
+  uint64_t completed_ = 0;
+  bool stopWorker_ = false;
+  std::mutex mutex_;
+  std::condition_variable workCv_;
+  std::condition_variable doneCv_;
+  std::thread worker_;
+
+  // Worker thread.
+  RealFft tailFft_;
+  std::vector<Stage> tail_;
+  std::vector<float> tailAccumulator_;
+  std::vector<float> tailScratch_;
+
+  std::atomic<uint64_t> framesProcessed_{0};
+  std::atomic<uint64_t> headNanos_{0};
+  std::atomic<uint64_t> tailNanos_{0};
+  std::atomic<uint64_t> tailWaits_{0};
+};
+
+// Convolves a float source with a filter, on the thread that reads it.
+// Seeks keep the position exact but start from silent history, so the first
+// filter length after a seek lacks the reverberation of what came before.
+class ConvolvingSource : public PcmSource {
+ public:
+  // `inner` must produce 32-bit float at the filter's rate; check
+  // CanConvolve() first.
+  ConvolvingSource(std::unique_ptr<PcmSource> inner,
+                   std::shared_ptr<const ConvolutionFilter> filter);
+
+  static bool CanConvolve(const PcmFormat& format,
+                          const ConvolutionFilter& filter);
+
+  PcmFormat Format() const override { return format_; }
+  size_t ReadFrames(uint8_t* dst, size_t maxFrames) override;
+  bool SeekToFrame(uint64_t frame, SeekMode mode,
+                   uint64_t* landedFrame) override;
+  uint64_t TotalFrames() const override { return inner_->TotalFrames(); }
+
+  PcmSource* Inner() const { return inner_.get(); }
+  PartitionedConvolver::Stats ConvolverStats() const { return convolver_.GetStats(); }
+
+ private:
+  // Reads and convolves the next block into block_. False at the end.
+  bool Refill();
+
+  std::unique_ptr<PcmSource> inner_;
+  PcmFormat format_;
+  PartitionedConvolver convolver_;
+  std::vector<float> block_;
+  size_t blockOffset_ = 0;
+  size_t blockFrames_ = 0;
+  bool innerEnded_ = false;
+};
+
+}  // namespace audioengine
@@ -0,0 +1,38 @@
+// Equal-power crossfade curves, mixing and gain kernels.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "AudioEngineCore/PcmFormat.h"
+
+namespace audioengine {
+
+// Formats MixCrossfade() handles: 32-bit float and 16/32-bit signed integer.
+bool CanCrossfade(const PcmFormat& format);
+
+// Gains for fade frames [position, position + frames) of a `length`-frame
+// fade, sampled at frame centres: out = cos(t * pi/2), in = sin(t * pi/2), so
+// out^2 + in^2 == 1 and uncorrelated material keeps its loudness. Positions
+// past the end clamp to out = 0, in = 1.
+void EqualPowerGains(uint64_t position, uint64_t length, size_t frames,
+                     float* outGain, float* inGain);
+
+// dst = dst * outGain + incoming * inGain for `frames` interleaved frames,
+// one gain pair per frame. Integer formats saturate. Returns false (and
+// leaves dst alone) for formats CanCrossfade() rejects.
+bool MixCrossfade(const PcmFormat& format, uint8_t* dst, const uint8_t* incoming,
+                  const float* outGain, const float* inGain, size_t frames);
+
+// samples *= gain for `frames` interleaved frames, saturating for integer
+// formats. A gain of exactly 1 is a no-op. Same formats as MixCrossfade().
+bool ApplyGain(const PcmFormat& format, uint8_t* samples, size_t frames,
+               float gain);
+
+// Per-sample reference for MixCrossfade(); the vector paths must stay within
+// float rounding of it.
+bool MixCrossfadeScalar(const PcmFormat& format, uint8_t* dst,
+                        const uint8_t* incoming, const float* outGain,
+                        const float* inGain, size_t frames);
+
+}  // namespace audioengine
@@ -0,0 +1,161 @@
+// Two StreamingDecoders with an equal-power crossfade between them.
+//
+// Drop-in for a single StreamingDecoder in the engines. The current track
+// plays from one deck; QueueNext() starts the next track on the other deck,
+// which prefills its ring on the calling thread and then idles. When the
+// current track reaches its last `overlap` frames the render thread switches
+// decks and mixes the tail of the old one under the head of the new one.
+//
+// Both rings are already full when the fade starts, so the render thread only
+// does two ring copies and one mix per block; it never waits on a decoder.
+// With no overlap configured QueueNext() falls back to gapless chaining on
+// the current deck.
+//
+// Each track carries a gain (loudness normalization), and SetOutputGain()
+// adds the volume on top. Read() applies their product in the same pass that
+// copies or mixes the frames, switching gains at the exact frame a chained
+// or faded-in track starts. For integer formats a Requantizer does that
+// pass, so gains other than 1 are dithered rather than truncated; at unity
+// gain the samples pass through untouched.
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "AudioEngineCore/Dither.h"
+#include "AudioEngineCore/PcmFormat.h"
+#include "AudioEngineCore/PcmSource.h"
+#include "AudioEngineCore/StreamingDecoder.h"
+
+namespace audioengine {
+
+class Crossfader {
+ public:
+  Crossfader();
+  explicit Crossfader(const StreamingDecoder::Options& options);
+  ~Crossfader();
+
+  Crossfader(const Crossfader&) = delete;
+  Crossfader& operator=(const Crossfader&) = delete;
+
+  // Fade length for later QueueNext() calls. 0 (the default) chains tracks
+  // gaplessly instead. A fade already queued keeps its length.
+  void SetOverlapMs(uint32_t overlapMs);
+  uint32_t OverlapMs() const { return overlapMs_; }
+
+  // As StreamingDecoder. Stop() also drops a queued or running fade.
+  // `gain` is the track's linear gain.
+  bool Start(std::unique_ptr<PcmSource> source, float gain = 1.0f);
+  void Stop();
+
+  // Seeks the current track. A fade-out in progress keeps playing; a queued
+  // fade is rescheduled against the new position.
+  bool Seek(uint64_t frame, SeekMode mode = SeekMode::kAccurate);
+
+  // Queues the track to play next; same format required. With an overlap it
+  // is opened on the idle deck and faded in over the end of the current
+  // track. Fails while the previous fade has not finished, and for formats
+  // MixCrossfade() cannot mix. nullptr drops a queued track if its fade has
+  // not started yet.
+  bool QueueNext(std::unique_ptr<PcmSource> next, float gain = 1.0f);
+  bool HasQueuedNext() const;
+
+  // Changes the current track's gain, e.g. when the normalization mode
+  // changes mid-track. Takes effect with the next Read().
+  void SetTrackGain(float gain);
+  // Linear gain applied to everything Read() returns (the volume). Safe
+  // from any thread.
+  void SetOutputGain(float gain);
+  // Dither and noise shaping for integer formats. Safe from any thread.
+  void SetDither(DitherMode mode);
+
+  // Control-thread side. Returns true once per transition: for a crossfade,
+  // once the fade has started; for a gapless chain, once the render thread
+  // has passed the boundary. Positions refer to the new track from then on.
+  bool TakeTrackChange();
+
+  // Render-thread side. Copies (and, during a fade, mixes) up to `frames`
+  // frames into `dst`. Never blocks, locks or allocates.
+  size_t Read(uint8_t* dst, size_t frames);
+
+  bool IsFinished() const;
+  bool IsActive() const;
+  // True from the start of a fade until its last frame has been rendered.
+  bool IsFading() const;
+
+  PcmFormat Format() const { return format_; }
+  uint64_t PositionFrames() const;
+  uint64_t TotalFrames() const;
+  size_t BufferedFrames() const;
+  std::chrono::microseconds LastSeekDuration() const;
+  uint64_t SteadyStateAllocations() const;
+
+ private:
+  // kIdle: one deck plays. kArmed: the idle deck is prefilled and waits for
+  // fadeStart_. kFading: the render thread mixes the old deck's tail into the
+  // current one. kRetired: the fade is over and the old deck can be stopped
+  // on a control thread.
+  enum Phase : int { kIdle, kArmed, kFading, kRetired };
+
+  // Phase and current deck share one atomic so the render thread can start a
+  // fade and swap decks in a single compare-exchange.
+  static int Pack(int phase, int deck) { return (phase << 1) | deck; }
+  static int PhaseOf(int state) { return state >> 1; }
+  static int DeckOf(int state) { return state & 1; }
+
+  StreamingDecoder& Current() {
+    return decks_[DeckOf(state_.load(std::memory_order_acquire))];
+  }
+  const StreamingDecoder& Current() const {
+    return decks_[DeckOf(state_.load(std::memory_order_acquire))];
+  }
+  // Control side: stops the old deck once the render thread is done with it.
+  void ReapTail();
+  // Control side: places the armed fade against the current deck's read
+  // count. Must run while the phase is not kArmed.
+  void ScheduleFade();
+  // Render side: kArmed -> kFading with the decks swapped. False if the
+  // control thread withdrew the fade first.
+  bool BeginFade();
+  size_t MixTail(uint8_t* dst, size_t frames);
+  // Render side: reads from `deck` and applies its track gain, switching to
+  // the chained track's gain at a pending gapless boundary.
+  size_t ReadDeck(int deck, uint8_t* dst, size_t frames);
+  // Render side: samples *= gain, through requantizer_ for integer formats.
+  void Gain(uint8_t* samples, size_t frames, float gain);
+
+  StreamingDecoder decks_[2];
+  std::atomic<int> state_{0};
+  std::atomic<bool> trackChanged_{false};
+  PcmFormat format_{};
+  uint32_t overlapMs_ = 0;
+
+  // Track gain per deck, and of the track chained gaplessly behind it. The
+  // control thread promotes chainedGain_ when it collects the transition.
+  std::atomic<float> deckGain_[2] = {1.0f, 1.0f};
+  std::atomic<float> chainedGain_[2] = {1.0f, 1.0f};
+  std::atomic<float> outputGain_{1.0f};
+
+  // Written by the control thread before it publishes kArmed; read by the
+  // render thread after observing it. fadeLength_ is the requested length,
+  // fadeFrames_ the one that fits the two tracks. fadeStart_ is atomic
+  // because a Seek() reschedules it while a Read() may still be looking.
+  uint64_t fadeLength_ = 0;
+  uint64_t fadeFrames_ = 0;
+  std::atomic<uint64_t> fadeStart_{0};
+  // Render-thread progress through the running fade.
+  uint64_t fadePosition_ = 0;
+
+  // Sized on Start() so Read() never allocates.
+  std::vector<uint8_t> mixScratch_;
+  std::vector<float> outGain_;
+  std::vector<float> inGain_;
+  // Configured on Start() for integer formats; unconfigured for float.
+  Requantizer requantizer_;
+};
+
+}  // namespace audioengine
@@ -0,0 +1,104 @@
+// TPDF dither and noise-shaped requantization for integer output.
+//
+// Scaling integer samples by a gain that is not 1 leaves fractional values
+// that plain rounding turns into distortion correlated with the signal
+// (audible as a gritty tail on fades and quiet passages). Requantizer does the
+// gain in float, adds triangular (TPDF) dither of +-1 LSB and rounds with
+// error feedback, so the quantization error becomes a constant noise floor
+// whose spectrum the noise shaping moves out of the ear's most sensitive
+// band.
+//
+// As in ParametricEq, the channels of a frame share the lanes of one SIMD
+// register, so the error-feedback filter costs the same for mono and for 7.1.
+// The float <-> integer conversions reuse the SampleKernels paths. A gain of
+// exactly 1 is a no-op, so a bit-perfect stream stays bit-perfect.
+//
+// 32-bit containers are dithered at 24 bits, the resolution of both float and
+// real converters; the low byte is zero.
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "AudioEngineCore/SampleKernels.h"
+
+namespace audioengine {
+
+enum class DitherMode : uint8_t {
+  // Round to nearest, as ScaleSamples() and MixCrossfade() do.
+  kOff,
+  // TPDF dither, flat noise.
+  kTpdf,
+  // TPDF with second-order high-pass shaping: (1 - z^-1)^2.
+  kHighpass,
+  // TPDF with Wannamaker's 9-tap F-weighted shaping, which puts the noise
+  // where hearing is least sensitive (about 15 dB less around 3 kHz, more
+  // above 15 kHz). Designed for 44.1 and 48 kHz; higher rates get kHighpass,
+  // which there already keeps the noise above the audio band.
+  kFWeighted,
+};
+
+const char* DitherModeName(DitherMode mode);
+
+class Requantizer {
+ public:
+  static constexpr uint32_t kMaxChannels = 8;
+  static constexpr uint32_t kMaxTaps = 9;
+  // Frames converted per pass; bounds the float scratch.
+  static constexpr size_t kBlockFrames = 512;
+
+  Requantizer();
+
+  Requantizer(const Requantizer&) = delete;
+  Requantizer& operator=(const Requantizer&) = delete;
+
+  // Control side, while no render call is running. Allocates the scratch and
+  // clears the error state. False (and unconfigured) for float types and for
+  // more than kMaxChannels channels.
+  bool Configure(SampleType type, uint32_t sampleRate, uint32_t channels);
+  bool IsConfigured() const { return channels_ != 0; }
+
+  // Any thread; the default is kFWeighted. Takes effect with the next render
+  // call.
+  void SetMode(DitherMode mode);
+  DitherMode Mode() const { return mode_.load(std::memory_order_relaxed); }
+
+  // Render side. samples *= gain for `frames` interleaved frames of the
+  // configured type, saturating. A gain of exactly 1 is a no-op.
+  void ApplyGain(void* samples, size_t frames, float gain);
+  // Render side. dst = dst * outGain + incoming * inGain, one gain pair per
+  // frame, as the integer MixCrossfade() but requantized.
+  void MixCrossfade(void* dst, const void* incoming, const float* outGain,
+                    const float* inGain, size_t frames);
+  // Render side. Requantizes float frames (full scale 1.0) into `dst` of the
+  // configured type. `samples` is overwritten.
+  void Quantize(float* samples, void* dst, size_t frames);
+  // Clears the error feedback, e.g. after a seek.
+  void Reset();
+
+ private:
+  // Render side: applies a mode change from SetMode().
+  void UpdateMode();
+
+  SampleType type_ = SampleType::kS16;
+  uint32_t sampleRate_ = 0;
+  uint32_t channels_ = 0;
+  std::atomic<DitherMode> mode_{DitherMode::kFWeighted};
+
+  // Render side. The mode the taps below were set up for.
+  DitherMode activeMode_ = DitherMode::kOff;
+  uint32_t tapCount_ = 0;
+  float taps_[kMaxTaps] = {};
+  // 2^(bits - 1) for the dithered word length.
+  float scale_ = 0.0f;
+  // Past quantization errors per channel in LSBs, newest first.
+  alignas(32) float error_[kMaxTaps][kMaxChannels] = {};
+  // One xorshift32 generator per channel.
+  alignas(32) uint32_t rng_[kMaxChannels] = {};
+  std::vector<float> scratch_;
+  std::vector<float> mixScratch_;
+};
+
+}  // namespace audioengine
@@ -0,0 +1,116 @@
+// Background feature analysis of a music library, for the mood engine.
+//
+// Tracks are decoded through the engines' own PcmSource, opened for overview
+// work like WaveformScanner's (source rate, no resampling), measured with
+// FeatureAnalyzer and cached next to the seek indexes, keyed by path, size
+// and mtime. A restarted scan picks the cached results up instead of
+// decoding again, so a library is covered incrementally across sessions,
+// and mood filters read the cache without decoding anything.
+//
+// Work is spread over a ScanPool; tracks are independent.
+//
+// On-disk format per track, little-endian:
+//   0   char[4]  "TNFT"
+//   4   u16      version (kFeatureCacheVersion)
+//   6   u16      reserved, 0
+//   8   u64      file size in bytes
+//   16  i64      file mtime, seconds since the Unix epoch
+//   24  u32      sample rate
+//   28  u32      FNV-1a 32 of the UTF-8 path
+//   32  u64      frames decoded
+//   40  i32      key, -1 for none
+//   44  u32      flags: bit 0 minor
+//   48  f64 x 11 bpm, tempo confidence, key confidence, energy,
+//                danceability, RMS dB, onset rate, spectral centroid,
+//                spread, rolloff, flatness
+//   136 u32      FNV-1a 32 of every preceding byte
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "AudioEngineCore/AudioFeatures.h"
+#include "AudioEngineCore/PcmSource.h"
+#include "AudioEngineCore/ScanPool.h"
+#include "AudioEngineCore/SeekIndex.h"
+
+namespace audioengine {
+
+constexpr uint16_t kFeatureCacheVersion = 1;
+
+class FeatureScanner {
+ public:
+  // Opens a file for overview decoding; null if it cannot be decoded.
+  // Called on the worker threads, concurrently.
+  using OpenFn = std::function<std::unique_ptr<PcmSource>(const std::string& path)>;
+
+  struct Stats {
+    size_t tracksAnalyzed = 0;  // decoded and measured
+    size_t tracksCached = 0;    // resumed from an earlier scan's cache
+    size_t tracksFailed = 0;
+    size_t tracksPending = 0;
+    double audioSeconds = 0.0;  // decoded
+    // Wall time with work outstanding.
+    double busySeconds = 0.0;
+    unsigned workers = 0;
+
+    double TracksPerSecondPerCore() const {
+      if (busySeconds <= 0.0 || workers == 0) return 0.0;
+      return static_cast<double>(tracksAnalyzed) / busySeconds / workers;
+    }
+    // Seconds of audio analysed per wall-clock second, all workers.
+    double RealtimeFactor() const {
+      return busySeconds > 0.0 ? audioSeconds / busySeconds : 0.0;
+    }
+  };
+
+  // `cacheDir` (UTF-8) must exist; empty disables the cache. `workers` 0
+  // uses every hardware thread but one (the playback core).
+  FeatureScanner(std::string cacheDir, OpenFn open, unsigned workers = 0);
+
+  FeatureScanner(const FeatureScanner&) = delete;
+  FeatureScanner& operator=(const FeatureScanner&) = delete;
+
+  // Queues tracks; returns immediately. Tracks already queued or done in
+  // this session are skipped.
+  void Enqueue(const std::vector<SeekIndex::Key>& keys);
+  // Drops queued tracks; running ones are abandoned unsaved.
+  void Cancel() { pool_.Cancel(); }
+  // Blocks until nothing is queued or running.
+  void WaitIdle() { pool_.WaitIdle(); }
+
+  // Measured features; false while the track is pending or if it failed.
+  bool Track(const std::string& path, TrackFeatures* result) const;
+  // Cached result without a scan. Any thread.
+  bool LoadCached(const SeekIndex::Key& key, TrackFeatures* result) const;
+
+  // Cache file name (no directory) for `key`: 16 hex digits + ".features".
+  static std::string CacheFileName(const SeekIndex::Key& key);
+
+  Stats GetStats() const;
+  unsigned WorkerCount() const { return pool_.WorkerCount(); }
+
+ private:
+  // Runs on the pool; stores a successful result in tracks_.
+  ScanPool::Result Scan(const SeekIndex::Key& key, uint64_t generation);
+  ScanPool::Outcome Analyze(const SeekIndex::Key& key, uint64_t generation,
+                            TrackFeatures* result);
+  bool WriteCache(const SeekIndex::Key& key, const TrackFeatures& result) const;
+
+  const std::string cacheDir_;
+  const OpenFn open_;
+
+  mutable std::mutex mutex_;
+  std::map<std::string, TrackFeatures> tracks_;
+
+  // Last, so its workers stop before the members they use go.
+  ScanPool pool_;
+};
+
+}  // namespace audioengine
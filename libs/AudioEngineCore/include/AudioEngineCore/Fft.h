@@ -0,0 +1,46 @@
+// Real-input FFT for the frequency-domain stages (convolution, analysis).
+//
+// Power-of-two sizes only. Spectra are split complex: Bins() = Size() / 2 + 1
+// real parts and as many imaginary parts, which keeps the spectral
+// multiply-accumulate loops contiguous for SIMD. Neither direction scales:
+// Inverse(Forward(x)) is Size() * x, so callers fold the 1 / Size() into
+// whatever they multiply with anyway.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace audioengine {
+
+class RealFft {
+ public:
+  RealFft() = default;
+  explicit RealFft(size_t size) { Configure(size); }
+
+  // Allocates the tables; `size` must be a power of two, at least 4.
+  void Configure(size_t size);
+  size_t Size() const { return size_; }
+  size_t Bins() const { return size_ / 2 + 1; }
+
+  // `in` holds Size() samples; `re` and `im` receive Bins() values each.
+  // Never allocates; uses per-instance scratch, so one instance per thread.
+  void Forward(const float* in, float* re, float* im);
+  // `re` and `im` hold Bins() values (the imaginary parts of bins 0 and
+  // Size() / 2 are ignored); `out` receives Size() samples.
+  void Inverse(const float* re, const float* im, float* out);
+
+ private:
+  // In-place complex FFT of Size() / 2 points on scratch_.
+  void Transform(bool inverse);
+
+  size_t size_ = 0;
+  // cos/sin of 2 pi k / Size(), k < Size() / 2.
+  std::vector<float> cos_;
+  std::vector<float> sin_;
+  std::vector<uint32_t> bitReverse_;
+  std::vector<float> scratchRe_;
+  std::vector<float> scratchIm_;
+};
+
+}  // namespace audioengine
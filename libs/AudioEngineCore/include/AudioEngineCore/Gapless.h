@@ -0,0 +1,81 @@
+// Encoder delay/padding handling for gapless playback.
+//
+// Lossy encoders prepend priming samples and pad the last packet; decoders
+// add their own delay on top (529 samples for MP3). The engines read that
+// information from the container, normalize it to a GaplessInfo in decoded
+// frames, and wrap their decoder in a TrimmingSource so only the original
+// samples reach the ring.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "AudioEngineCore/PcmSource.h"
+
+namespace audioengine {
+
+// Decoder delay of the reference MP3 decoder (and of FFmpeg's), added to the
+// encoder delay stored in LAME headers.
+constexpr uint32_t kMp3DecoderDelay = 529;
+
+struct GaplessInfo {
+  // Decoded frames to drop at the start of the stream.
+  uint64_t leadingFrames = 0;
+  // Decoded frames to drop at the end of the stream.
+  uint64_t trailingFrames = 0;
+  // Exact length after trimming, or 0 when the container does not say. With
+  // a length the end is cut by counting; without one the last
+  // `trailingFrames` are held back until end of stream.
+  uint64_t validFrames = 0;
+
+  bool Empty() const {
+    return leadingFrames == 0 && trailingFrames == 0 && validFrames == 0;
+  }
+};
+
+// Parses an iTunes "iTunSMPB" comment (AAC in MP4, some MP3s):
+// " 00000000 00000840 000001CA 00000000003F31F6 ..." -> delay, padding and
+// original length, all hexadecimal.
+bool ParseITunSMPB(const std::string& value, GaplessInfo* info);
+
+// Parses the Xing/Info + LAME tag in the first MPEG audio frame. `data` is
+// the start of the file; a leading ID3v2 tag is skipped. Files written by
+// LAME and by FFmpeg ("Lavc"/"Lavf") carry the tag.
+bool ParseLameHeader(const uint8_t* data, size_t size, GaplessInfo* info);
+
+// PcmSource decorator that removes encoder delay and padding. Frame numbers
+// seen through it (seeks, TotalFrames) are in trimmed time.
+class TrimmingSource : public PcmSource {
+ public:
+  // `inner` must be positioned at its first frame.
+  TrimmingSource(std::unique_ptr<PcmSource> inner, const GaplessInfo& info);
+
+  PcmFormat Format() const override { return inner_->Format(); }
+  size_t ReadFrames(uint8_t* dst, size_t maxFrames) override;
+  bool SeekToFrame(uint64_t frame, SeekMode mode,
+                   uint64_t* landedFrame) override;
+  uint64_t TotalFrames() const override;
+
+  const GaplessInfo& Info() const { return info_; }
+  PcmSource* Inner() const { return inner_.get(); }
+
+ private:
+  // Reads through the hold-back buffer so the final `trailingFrames` of the
+  // stream are never emitted.
+  size_t ReadHoldingBack(uint8_t* dst, size_t maxFrames);
+
+  std::unique_ptr<PcmSource> inner_;
+  GaplessInfo info_;
+  size_t bytesPerFrame_ = 0;
+  // Position of the inner source, in untrimmed frames.
+  uint64_t innerPosition_ = 0;
+  // Circular buffer of `trailingFrames` frames, only used without validFrames.
+  std::vector<uint8_t> held_;
+  size_t heldHead_ = 0;
+  size_t heldFrames_ = 0;
+};
+
+}  // namespace audioengine
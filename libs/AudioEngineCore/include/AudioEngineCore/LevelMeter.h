@@ -0,0 +1,127 @@
+// Per-channel level meters on the render path: sample peak with peak hold,
+// RMS and true peak.
+//
+// Process() takes the output in whatever sample format the device takes.
+// It converts a chunk at a time into float and reduces it to per-channel
+// peak and sum of squares, with the samples of a frame in SIMD lanes
+// (picked the same way as SampleKernels). With true peak on, each frame
+// also goes through a TruePeakDetector; that costs more than everything
+// else together.
+//
+// Ballistics follow a digital peak meter. A peak shows at once and falls
+// at Options::decayDbPerSecond. The hold marker stays on the highest peak
+// for Options::holdMs and then falls at the same rate. RMS is the mean
+// square over an exponential window of Options::rmsWindowMs, so a
+// full-scale sine reads -3 dB. True peak has the same decay as the peak
+// and also keeps its maximum since the last Reset().
+//
+// Readings are published through a SeqLock after every Process() call.
+// Read() is lock-free from any thread and never holds up the render
+// thread. Nothing decays while Process() is not called, so the engines
+// Reset() the meter when playback stops.
+//
+// Configure() allocates; Process() never allocates, locks or blocks.
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "AudioEngineCore/PcmFormat.h"
+#include "AudioEngineCore/SampleKernels.h"
+#include "AudioEngineCore/SeqLock.h"
+#include "AudioEngineCore/TruePeakDetector.h"
+
+namespace audioengine {
+
+struct LevelMeterReading {
+  static constexpr uint32_t kMaxChannels = 8;
+
+  // Counts Process() calls since Configure(); unchanged means no new audio.
+  uint64_t sequence = 0;
+  uint32_t channels = 0;
+  // dBFS per channel, never below LevelMeter::kFloorDb.
+  float peakDb[kMaxChannels] = {};
+  float peakHoldDb[kMaxChannels] = {};
+  float rmsDb[kMaxChannels] = {};
+  // At kFloorDb while true peak is off.
+  float truePeakDb[kMaxChannels] = {};
+  float maxTruePeakDb[kMaxChannels] = {};
+};
+
+class LevelMeter {
+ public:
+  static constexpr uint32_t kMaxChannels = LevelMeterReading::kMaxChannels;
+  static constexpr float kFloorDb = -120.0f;
+
+  struct Options {
+    double holdMs = 1500.0;
+    double decayDbPerSecond = 20.0;
+    double rmsWindowMs = 300.0;
+    bool truePeak = true;
+  };
+
+  LevelMeter();
+
+  LevelMeter(const LevelMeter&) = delete;
+  LevelMeter& operator=(const LevelMeter&) = delete;
+
+  // Control side, while no Process() call is running. Sizes the scratch
+  // for `format` and clears the readings. False (and unconfigured) for
+  // formats without a sample kernel or with more than kMaxChannels.
+  bool Configure(const PcmFormat& format);
+  bool IsConfigured() const { return channels_ != 0; }
+
+  // Any thread. Takes effect with the next Process() call.
+  void SetOptions(const Options& options);
+  Options GetOptions() const;
+
+  // Render side. Measures `frames` interleaved frames of the configured
+  // format.
+  void Process(const void* samples, size_t frames);
+  // Drops every level to the floor and publishes that. Render side, or
+  // control side while Process() is not running.
+  void Reset();
+
+  // Any thread, lock-free.
+  LevelMeterReading Read() const;
+
+ private:
+  // Linear levels as published; Read() converts to dB.
+  struct Levels {
+    uint64_t sequence;
+    uint32_t channels;
+    float peak[kMaxChannels];
+    float hold[kMaxChannels];
+    float meanSquare[kMaxChannels];
+    float truePeak[kMaxChannels];
+    float maxTruePeak[kMaxChannels];
+  };
+
+  // Render side: applies one chunk's measurements over `seconds`.
+  void Update(const float* chunkPeak, const float* chunkSumSquares,
+              const float* chunkTruePeak, size_t frames, double seconds,
+              const Options& options);
+  void Publish();
+
+  std::atomic<double> holdMs_;
+  std::atomic<double> decayDbPerSecond_;
+  std::atomic<double> rmsWindowMs_;
+  std::atomic<bool> truePeak_;
+
+  uint32_t sampleRate_ = 0;
+  uint32_t channels_ = 0;
+  SampleType type_ = SampleType::kF32;
+
+  // Render side.
+  std::vector<float> converted_;
+  TruePeakDetector detector_;
+  bool detectorPrimed_ = false;
+  Levels levels_{};
+  double holdAge_[kMaxChannels] = {};
+
+  SeqLock<Levels> published_;
+};
+
+}  // namespace audioengine
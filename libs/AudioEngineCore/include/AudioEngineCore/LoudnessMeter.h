@@ -0,0 +1,107 @@
+// EBU R128 loudness measurement (ITU-R BS.1770-4, EBU Tech 3341/3342).
+//
+// The meter K-weights the signal, sums 100 ms sub-blocks and records 400 ms
+// momentary blocks (75% overlap) and 3 s short-term blocks (one per second)
+// into histograms. Integrated loudness and loudness range are computed from
+// the histograms, which can be merged, so album values come from the track
+// histograms without decoding anything twice.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "AudioEngineCore/TruePeakDetector.h"
+
+namespace audioengine {
+
+// Loudness of a mean-square block energy, in LUFS; -inf for silence.
+double LoudnessOfEnergy(double energy);
+
+// 0.1 LU bins from the -70 LUFS absolute gate up to +10 LUFS. Each bin keeps
+// the block count and the blocks' summed energy, so gated means are exact
+// and only the gate decision is quantized.
+class LoudnessHistogram {
+ public:
+  static constexpr double kFloorLufs = -70.0;
+  static constexpr uint32_t kBinsPerLu = 10;
+  static constexpr uint32_t kBins = 80 * kBinsPerLu;
+
+  LoudnessHistogram();
+
+  void Clear();
+  // Adds one block; blocks under the absolute gate are dropped.
+  void Add(double energy);
+  void Merge(const LoudnessHistogram& other);
+  uint64_t Count() const;
+
+  // Integrated loudness of momentary blocks (relative gate -10 LU). -inf
+  // when every block is under the absolute gate.
+  double IntegratedLufs() const;
+  // Loudness range of short-term blocks: 95th minus 10th percentile after a
+  // -20 LU relative gate. 0 when there are no blocks.
+  double RangeLu() const;
+
+  uint32_t CountAt(uint32_t bin) const { return counts_[bin]; }
+  double EnergyAt(uint32_t bin) const { return energy_[bin]; }
+  // For deserialization; `count` blocks with total `energy` in `bin`.
+  void SetBin(uint32_t bin, uint32_t count, double energy);
+
+ private:
+  // Mean loudness of the blocks in `bin`; the gates test this.
+  double BinLoudness(uint32_t bin) const;
+
+  std::vector<uint32_t> counts_;
+  std::vector<double> energy_;
+};
+
+class LoudnessMeter {
+ public:
+  // Allocates and clears. Channels 5 and 6 are taken as the FFmpeg 5.0 and
+  // 5.1 layouts (surrounds weighted +1.5 dB, LFE ignored); any other count
+  // weights every channel equally.
+  void Configure(uint32_t sampleRate, uint32_t channels);
+  void Reset();
+
+  // Measures `frames` interleaved float frames. Does not allocate.
+  void Process(const float* samples, size_t frames);
+
+  double IntegratedLufs() const { return blocks_.IntegratedLufs(); }
+  double LoudnessRangeLu() const { return shortTerm_.RangeLu(); }
+  // Highest 4x oversampled peak seen, linear.
+  float TruePeak() const { return truePeak_; }
+  uint64_t FramesProcessed() const { return frames_; }
+
+  const LoudnessHistogram& MomentaryBlocks() const { return blocks_; }
+  const LoudnessHistogram& ShortTermBlocks() const { return shortTerm_; }
+
+ private:
+  struct Biquad {
+    double b0 = 0, b1 = 0, b2 = 0, a1 = 0, a2 = 0;
+  };
+  void FinishSubBlock();
+
+  uint32_t channels_ = 0;
+  uint32_t subBlockFrames_ = 0;
+  // K-weighting: high shelf then high pass, transposed direct form II.
+  Biquad shelf_;
+  Biquad highPass_;
+  // Per channel: shelf z1, z2, high-pass z1, z2.
+  std::vector<double> state_;
+  std::vector<double> weights_;
+
+  double subBlockEnergy_ = 0.0;
+  uint32_t subBlockFill_ = 0;
+  // Energies of the last 30 sub-blocks (3 s).
+  std::vector<double> subBlocks_;
+  uint64_t subBlockCount_ = 0;
+
+  TruePeakDetector detector_;
+  float truePeak_ = 0.0f;
+  uint64_t frames_ = 0;
+
+  LoudnessHistogram blocks_;
+  LoudnessHistogram shortTerm_;
+};
+
+}  // namespace audioengine
@@ -0,0 +1,174 @@
+// Background EBU R128 analysis of a music library.
+//
+// Tracks are decoded through the engines' own PcmSource (the FFmpeg path),
+// measured with LoudnessMeter and cached next to the seek indexes, keyed by
+// path, size and mtime. A restarted scan picks the cached results up instead
+// of decoding again, so a large library is scanned incrementally across
+// sessions. Album values come from the merged track histograms once every
+// track of the album is measured.
+//
+// Work is spread over a ScanPool with each album as one group, so a worker
+// measures an album's tracks in turn unless others run dry and steal them.
+//
+// On-disk format per track, little-endian:
+//   0  char[4]  "TNLD"
+//   4  u16      version (kLoudnessCacheVersion)
+//   6  u16      reserved, 0
+//   8  u64      file size in bytes
+//   16 i64      file mtime, seconds since the Unix epoch
+//   24 u32      sample rate
+//   28 u32      FNV-1a 32 of the UTF-8 path
+//   32 u64      frames decoded
+//   40 f64      integrated loudness, LUFS (-inf for silence)
+//   48 f64      loudness range, LU
+//   56 f64      true peak, linear
+//   64 hist     momentary then short-term histogram: LEB128 bin count, then
+//               per non-empty bin LEB128 bin delta, LEB128 count, f64 energy
+//   ..  u32     FNV-1a 32 of every preceding byte
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "AudioEngineCore/LoudnessMeter.h"
+#include "AudioEngineCore/PcmSource.h"
+#include "AudioEngineCore/ReplayGain.h"
+#include "AudioEngineCore/ScanPool.h"
+#include "AudioEngineCore/SeekIndex.h"
+
+namespace audioengine {
+
+constexpr uint16_t kLoudnessCacheVersion = 1;
+
+struct TrackLoudness {
+  double integratedLufs = 0.0;
+  double loudnessRangeLu = 0.0;
+  // Linear, 4x oversampled.
+  double truePeak = 0.0;
+  uint64_t frames = 0;
+  uint32_t sampleRate = 0;
+
+  bool Silent() const { return !(integratedLufs > LoudnessHistogram::kFloorLufs); }
+};
+
+struct AlbumLoudness {
+  double integratedLufs = 0.0;
+  double loudnessRangeLu = 0.0;
+  double truePeak = 0.0;
+  size_t tracks = 0;
+};
+
+// ReplayGain 2.0 tags for measured loudness (-18 LUFS reference), so scanned
+// tracks normalize exactly like tagged ones. `album` may be null. Silent
+// measurements produce no gain.
+ReplayGainTags ReplayGainFromLoudness(const TrackLoudness& track,
+                                      const AlbumLoudness* album);
+
+class LoudnessScanner {
+ public:
+  // Opens a file for decoding; null if it cannot be decoded. Called on the
+  // worker threads, concurrently.
+  using OpenFn = std::function<std::unique_ptr<PcmSource>(const std::string& path)>;
+
+  struct Item {
+    SeekIndex::Key key;
+    // Tracks sharing a non-empty album id are aggregated into one album.
+    std::string album;
+  };
+
+  struct Stats {
+    size_t tracksScanned = 0;  // decoded and measured
+    size_t tracksCached = 0;   // resumed from an earlier scan's cache
+    size_t tracksFailed = 0;
+    size_t tracksPending = 0;
+    double audioSeconds = 0.0;  // decoded
+    // Wall time with work outstanding.
+    double busySeconds = 0.0;
+    unsigned workers = 0;
+
+    double TracksPerSecondPerCore() const {
+      if (busySeconds <= 0.0 || workers == 0) return 0.0;
+      return static_cast<double>(tracksScanned) / busySeconds / workers;
+    }
+    // Seconds of audio analysed per wall-clock second, all workers.
+    double RealtimeFactor() const {
+      return busySeconds > 0.0 ? audioSeconds / busySeconds : 0.0;
+    }
+  };
+
+  // `cacheDir` (UTF-8) must exist; empty disables the cache. `workers` 0
+  // uses every hardware thread but one (the playback core).
+  LoudnessScanner(std::string cacheDir, OpenFn open, unsigned workers = 0);
+
+  LoudnessScanner(const LoudnessScanner&) = delete;
+  LoudnessScanner& operator=(const LoudnessScanner&) = delete;
+
+  // Queues tracks; returns immediately. Tracks already measured or queued in
+  // this session are skipped. An album's tracks should arrive in one call.
+  void Enqueue(const std::vector<Item>& items);
+  // Drops queued tracks; running measurements are abandoned unsaved.
+  void Cancel();
+  // Blocks until nothing is queued or running.
+  void WaitIdle() { pool_.WaitIdle(); }
+
+  // Measured values; false while the track is pending or if it failed.
+  bool Track(const std::string& path, TrackLoudness* result) const;
+  // False until every queued track of the album is done.
+  bool Album(const std::string& album, AlbumLoudness* result) const;
+  // Album of a queued track, by the track's path.
+  bool AlbumOf(const std::string& path, AlbumLoudness* result) const;
+  // Cached result without a scan, for the engines' open path. Any thread.
+  bool LoadCached(const SeekIndex::Key& key, TrackLoudness* result) const;
+
+  // Cache file name (no directory) for `key`: 16 hex digits + ".loudness".
+  static std::string CacheFileName(const SeekIndex::Key& key);
+
+  Stats GetStats() const;
+  unsigned WorkerCount() const { return pool_.WorkerCount(); }
+
+ private:
+  // Histograms of an album's measured tracks; created when the first track
+  // finishes and dropped when the last one does.
+  struct AlbumState {
+    LoudnessHistogram blocks;
+    LoudnessHistogram shortTerm;
+    double truePeak = 0.0;
+    size_t measured = 0;
+  };
+  using Outcome = ScanPool::Outcome;
+
+  // Runs on the pool: measures one track and records it.
+  ScanPool::Result Scan(const ScanPool::Job& job, uint64_t generation);
+  Outcome Measure(const SeekIndex::Key& key, uint64_t generation, TrackLoudness* result,
+                  LoudnessHistogram* blocks, LoudnessHistogram* shortTerm);
+  void Finish(const ScanPool::Job& job, Outcome outcome, const TrackLoudness& result,
+              const LoudnessHistogram& blocks, const LoudnessHistogram& shortTerm);
+  bool ReadCache(const SeekIndex::Key& key, TrackLoudness* result,
+                 LoudnessHistogram* blocks, LoudnessHistogram* shortTerm) const;
+  bool WriteCache(const SeekIndex::Key& key, const TrackLoudness& result,
+                  const LoudnessHistogram& blocks,
+                  const LoudnessHistogram& shortTerm) const;
+
+  const std::string cacheDir_;
+  const OpenFn open_;
+
+  // Taken before the pool's lock when both are held.
+  mutable std::mutex mutex_;
+  std::map<std::string, TrackLoudness> tracks_;
+  // Path -> album of every track queued this session.
+  std::map<std::string, std::string> albumOf_;
+  std::map<std::string, size_t> albumPending_;
+  std::map<std::string, std::unique_ptr<AlbumState>> albumStates_;
+  std::map<std::string, AlbumLoudness> albums_;
+
+  // Last, so its workers stop before the members they use go.
+  ScanPool pool_;
+};
+
+}  // namespace audioengine
@@ -0,0 +1,131 @@
+// Parametric and graphic equalizer for the float render path.
+//
+// Up to kMaxBands biquads in cascade, each a transposed direct form II
+// section. The channels of a frame sit in the lanes of one SIMD register
+// (picked the same way as SampleKernels), so a band costs the same for mono
+// and for 7.1 and there is no per-channel loop on the render path.
+//
+// Bands are edited from any thread. The new coefficients are designed on
+// the caller's thread and handed to the render side through a lock-free
+// triple buffer; Process() then glides each changed band to its new
+// coefficients over kRampFrames, a little every frame, so sweeping a gain or
+// a frequency does not click or zipper. Bands at 0 dB cost nothing once settled.
+//
+// Process() never allocates, locks or blocks.
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace audioengine {
+
+enum class EqBandType {
+  kPeaking,
+  kLowShelf,
+  kHighShelf,
+  kLowPass,
+  kHighPass,
+};
+
+struct EqBand {
+  EqBandType type = EqBandType::kPeaking;
+  double frequencyHz = 1000.0;
+  // Peaking and shelf bands only.
+  double gainDb = 0.0;
+  // Bandwidth for peaking bands, resonance for the others (0.7071 gives
+  // Butterworth pass bands and shelves without overshoot).
+  double q = 0.7071;
+  bool enabled = true;
+};
+
+// Peaking bands for a graphic equalizer with one band per gain (10 to 32),
+// log-spaced over 20 Hz - 20 kHz with neighbouring bands meeting at their
+// half-gain points. 10 bands are about an octave apart, 31 a third.
+std::vector<EqBand> GraphicEqBands(const std::vector<double>& gainsDb);
+
+class ParametricEq {
+ public:
+  static constexpr uint32_t kMaxBands = 32;
+  static constexpr uint32_t kMaxChannels = 8;
+  static constexpr uint32_t kMinGraphicBands = 10;
+  // A changed band reaches its new coefficients this many frames after the
+  // Process() call that picks up the change.
+  static constexpr uint32_t kRampFrames = 1024;
+
+  ParametricEq();
+
+  ParametricEq(const ParametricEq&) = delete;
+  ParametricEq& operator=(const ParametricEq&) = delete;
+
+  // Control side, while no Process() call is running. Designs the current
+  // bands for `sampleRate` and clears the filter state; the bands apply at
+  // once, without a ramp. False (and unconfigured) for more than
+  // kMaxChannels channels.
+  bool Configure(uint32_t sampleRate, uint32_t channels);
+  bool IsConfigured() const { return channels_ != 0; }
+
+  // Any thread. Replaces all bands, or one band of the current set. False
+  // for more than kMaxBands bands or an index past the end. Bands keep
+  // their values across Configure().
+  bool SetBands(const std::vector<EqBand>& bands);
+  bool SetBand(size_t index, const EqBand& band);
+  std::vector<EqBand> Bands() const;
+
+  // Render side. Filters `frames` interleaved float frames in place.
+  void Process(float* samples, size_t frames);
+  // Clears the filter state, e.g. after a seek. Render side (or control side
+  // while Process() is not running).
+  void Reset();
+
+ private:
+  // b0, b1, b2, a1, a2 of every band, normalised so a0 == 1.
+  struct CoefficientSet {
+    float c[kMaxBands][5];
+  };
+
+  // Designs bands_ at sampleRate_ into `set`. Caller holds controlMutex_.
+  void Design(CoefficientSet* set) const;
+  // Designs bands_ and hands them to the render side. Caller holds
+  // controlMutex_.
+  void Publish();
+  // Render side: starts a ramp towards `set`.
+  void Retarget(const CoefficientSet& set);
+  // Render side: rebuilds the active band list and the lane-broadcast
+  // coefficients from current_ and step_.
+  void UpdateActive();
+
+  mutable std::mutex controlMutex_;
+  std::vector<EqBand> bands_;
+  uint32_t sampleRate_ = 0;
+  uint32_t channels_ = 0;
+
+  // Triple buffer: the control side designs into slots_[writeSlot_] and
+  // swaps it into latest_; the render side swaps latest_ with readSlot_
+  // when kFresh is set.
+  static constexpr uint32_t kFresh = 4;
+  static constexpr uint32_t kSlotMask = 3;
+  CoefficientSet slots_[3];
+  uint32_t writeSlot_ = 0;
+  std::atomic<uint32_t> latest_{1};
+  uint32_t readSlot_ = 2;
+
+  // Render side.
+  CoefficientSet current_;
+  CoefficientSet target_;
+  CoefficientSet step_;
+  // Per-frame change while ramping, and frames left in the ramp.
+  uint32_t rampLeft_ = 0;
+  // Bands that are not a pass-through, in cascade order.
+  uint32_t active_[kMaxBands];
+  uint32_t activeCount_ = 0;
+  // current_ for active_[i], each coefficient repeated in every lane.
+  alignas(32) float lanes_[kMaxBands][5][kMaxChannels];
+  alignas(32) float stepLanes_[kMaxBands][5][kMaxChannels];
+  // z1 and z2 per band and channel.
+  alignas(32) float state_[kMaxBands][2][kMaxChannels];
+};
+
+}  // namespace audioengine
@@ -0,0 +1,25 @@
+// Interleaved PCM description shared by the native engines.
+#pragma once
+
+#include <cstdint>
+
+namespace audioengine {
+
+struct PcmFormat {
+  uint32_t sampleRate = 0;
+  uint32_t channels = 0;
+  uint32_t bitsPerSample = 0;
+  bool isFloat = false;
+
+  uint32_t BytesPerFrame() const {
+    return (bitsPerSample / 8) * channels;
+  }
+
+  bool operator==(const PcmFormat& other) const {
+    return sampleRate == other.sampleRate && channels == other.channels &&
+           bitsPerSample == other.bitsPerSample && isFloat == other.isFloat;
+  }
+  bool operator!=(const PcmFormat& other) const { return !(*this == other); }
+};
+
+}  // namespace audioengine
@@ -0,0 +1,176 @@
+// Bounded single-producer/single-consumer PCM ring counted in frames.
+//
+// One thread writes (the decoder), one thread reads (the render callback).
+// Neither side takes a lock or allocates; capacity is fixed at Configure().
+// A control thread may Discard() buffered frames while the writer is parked,
+// which is how seeks flush the ring without stopping the render callback.
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace audioengine {
+
+class PcmRingBuffer {
+ public:
+  // A contiguous slice of the ring. `frames` may be zero.
+  struct Region {
+    uint8_t* data = nullptr;
+    size_t frames = 0;
+  };
+
+  // At most two regions are needed to cover any span of a circular buffer.
+  struct Regions {
+    Region first;
+    Region second;
+    uint64_t head = 0;
+
+    size_t TotalFrames() const { return first.frames + second.frames; }
+  };
+
+  PcmRingBuffer() = default;
+  PcmRingBuffer(const PcmRingBuffer&) = delete;
+  PcmRingBuffer& operator=(const PcmRingBuffer&) = delete;
+
+  // (Re)allocates storage. Must not race with readers or writers.
+  void Configure(size_t bytesPerFrame, size_t capacityFrames) {
+    bytesPerFrame_ = bytesPerFrame > 0 ? bytesPerFrame : 1;
+    capacityFrames_ = NextPowerOfTwo(std::max<size_t>(capacityFrames, 16));
+    mask_ = capacityFrames_ - 1;
+    storage_.assign(capacityFrames_ * bytesPerFrame_, 0);
+    Reset();
+  }
+
+  // Drops all buffered frames. Must not race with readers or writers.
+  void Reset() {
+    writeHead_.store(0, std::memory_order_relaxed);
+    readHead_.store(0, std::memory_order_relaxed);
+  }
+
+  size_t BytesPerFrame() const { return bytesPerFrame_; }
+  size_t CapacityFrames() const { return capacityFrames_; }
+
+  size_t AvailableFrames() const {
+    // Read the tail first: it can only move towards the head.
+    const uint64_t r = readHead_.load(std::memory_order_acquire);
+    const uint64_t w = writeHead_.load(std::memory_order_acquire);
+    return static_cast<size_t>(w - r);
+  }
+
+  size_t FreeFrames() const { return capacityFrames_ - AvailableFrames(); }
+
+  // Monotonic count of frames handed to the reader since Reset().
+  uint64_t FramesRead() const {
+    return readHead_.load(std::memory_order_acquire);
+  }
+
+  // Monotonic count of frames published by the writer since Reset().
+  uint64_t FramesWritten() const {
+    return writeHead_.load(std::memory_order_acquire);
+  }
+
+  // Drops every readable frame. Safe while a reader is active as long as the
+  // writer is not running; a read that overlaps the discard is turned into
+  // silence by CommitRead().
+  void Discard() {
+    readHead_.store(writeHead_.load(std::memory_order_acquire),
+                    std::memory_order_release);
+  }
+
+  // Producer side: space that can be filled in place, then published with
+  // CommitWrite().
+  Regions WritableRegions() {
+    const uint64_t w = writeHead_.load(std::memory_order_relaxed);
+    const uint64_t r = readHead_.load(std::memory_order_acquire);
+    return Split(w, capacityFrames_ - static_cast<size_t>(w - r));
+  }
+
+  void CommitWrite(size_t frames) {
+    writeHead_.fetch_add(frames, std::memory_order_release);
+  }
+
+  // Consumer side: frames that can be read in place, then released with
+  // CommitRead().
+  Regions ReadableRegions() {
+    const uint64_t r = readHead_.load(std::memory_order_relaxed);
+    const uint64_t w = writeHead_.load(std::memory_order_acquire);
+    return Split(r, static_cast<size_t>(w - r));
+  }
+
+  // Returns false when a Discard() raced with this read; the frames that
+  // were copied out are stale and should be treated as silence.
+  bool CommitRead(const Regions& regions, size_t frames) {
+    uint64_t expected = regions.head;
+    return readHead_.compare_exchange_strong(expected, expected + frames,
+                                             std::memory_order_release,
+                                             std::memory_order_relaxed);
+  }
+
+  size_t Write(const uint8_t* src, size_t frames) {
+    Regions regions = WritableRegions();
+    size_t written = CopyIn(regions.first, src, frames);
+    written += CopyIn(regions.second, src + written * bytesPerFrame_,
+                      frames - written);
+    CommitWrite(written);
+    return written;
+  }
+
+  size_t Read(uint8_t* dst, size_t frames) {
+    Regions regions = ReadableRegions();
+    size_t read = CopyOut(regions.first, dst, frames);
+    read += CopyOut(regions.second, dst + read * bytesPerFrame_, frames - read);
+    if (read > 0 && !CommitRead(regions, read)) {
+      memset(dst, 0, read * bytesPerFrame_);
+      return 0;
+    }
+    return read;
+  }
+
+ private:
+  static size_t NextPowerOfTwo(size_t value) {
+    size_t v = 1;
+    while (v < value) v <<= 1;
+    return v;
+  }
+
+  Regions Split(uint64_t head, size_t frames) {
+    Regions regions;
+    regions.head = head;
+    if (frames == 0) return regions;
+    const size_t index = static_cast<size_t>(head) & mask_;
+    const size_t firstFrames = std::min(frames, capacityFrames_ - index);
+    regions.first = {storage_.data() + index * bytesPerFrame_, firstFrames};
+    if (firstFrames < frames) {
+      regions.second = {storage_.data(), frames - firstFrames};
+    }
+    return regions;
+  }
+
+  size_t CopyIn(const Region& region, const uint8_t* src, size_t frames) {
+    const size_t n = std::min(region.frames, frames);
+    if (n > 0) memcpy(region.data, src, n * bytesPerFrame_);
+    return n;
+  }
+
+  size_t CopyOut(const Region& region, uint8_t* dst, size_t frames) {
+    const size_t n = std::min(region.frames, frames);
+    if (n > 0) memcpy(dst, region.data, n * bytesPerFrame_);
+    return n;
+  }
+
+  std::vector<uint8_t> storage_;
+  size_t bytesPerFrame_ = 1;
+  size_t capacityFrames_ = 0;
+  size_t mask_ = 0;
+
+  // Keep the heads on separate cache lines so producer and consumer do not
+  // false-share.
+  alignas(64) std::atomic<uint64_t> writeHead_{0};
+  alignas(64) std::atomic<uint64_t> readHead_{0};
+};
+
+}  // namespace audioengine
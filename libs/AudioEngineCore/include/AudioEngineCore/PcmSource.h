@@ -0,0 +1,41 @@
+// Pull interface for anything that produces interleaved PCM frames.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "AudioEngineCore/PcmFormat.h"
+
+namespace audioengine {
+
+enum class SeekMode {
+  // Resume from the sync point at or before the target. Cheap, but lossy
+  // codecs may land tens of milliseconds early.
+  kFast,
+  // Decode from before the target (including any codec pre-roll) and discard
+  // up to the exact frame.
+  kAccurate,
+};
+
+class PcmSource {
+ public:
+  virtual ~PcmSource() = default;
+
+  // Output format; fixed for the lifetime of the source.
+  virtual PcmFormat Format() const = 0;
+
+  // Writes up to `maxFrames` interleaved frames into `dst`. Returns the number
+  // of frames written; 0 means end of stream (or an unrecoverable error).
+  virtual size_t ReadFrames(uint8_t* dst, size_t maxFrames) = 0;
+
+  // Repositions the source near `frame`. On success `*landedFrame` (if not
+  // null) receives the frame the next ReadFrames() starts at: `frame` itself
+  // for kAccurate, possibly an earlier sync point for kFast.
+  virtual bool SeekToFrame(uint64_t frame, SeekMode mode,
+                           uint64_t* landedFrame) = 0;
+
+  // Best-effort length in frames, or 0 when unknown.
+  virtual uint64_t TotalFrames() const { return 0; }
+};
+
+}  // namespace audioengine
@@ -0,0 +1,52 @@
+// PcmSource decorator that decodes the head of a track ahead of time.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "AudioEngineCore/PcmSource.h"
+
+namespace audioengine {
+
+// Holds the first frames of `inner` in memory so a StreamingDecoder started on
+// it prefills with a copy instead of a decode. Fill() runs on whichever thread
+// prepared the track (the preloader); after that the source is handed over
+// and only used by its consumer.
+class PrebufferedSource : public PcmSource {
+ public:
+  // `inner` must be positioned at its first frame.
+  explicit PrebufferedSource(std::unique_ptr<PcmSource> inner);
+
+  // Decodes until at least `frames` frames are buffered or the stream ends.
+  // Returns the number of frames buffered.
+  uint64_t Fill(uint64_t frames);
+  uint64_t BufferedFrames() const;
+
+  PcmFormat Format() const override { return format_; }
+  size_t ReadFrames(uint8_t* dst, size_t maxFrames) override;
+  // Seeks inside the buffered head are served from memory; anything else drops
+  // the buffer and seeks `inner`.
+  bool SeekToFrame(uint64_t frame, SeekMode mode,
+                   uint64_t* landedFrame) override;
+  uint64_t TotalFrames() const override { return inner_->TotalFrames(); }
+
+  PcmSource* Inner() const { return inner_.get(); }
+
+ private:
+  void Release();
+
+  std::unique_ptr<PcmSource> inner_;
+  PcmFormat format_{};
+  size_t bytesPerFrame_ = 0;
+  // Frames [0, buffered) of the track; `readFrame_` is the next one to serve.
+  std::vector<uint8_t> buffer_;
+  uint64_t readFrame_ = 0;
+  // False once reads or seeks have moved past the buffer; `inner_` is then
+  // the only source of frames.
+  bool buffering_ = true;
+  bool innerEnded_ = false;
+};
+
+}  // namespace audioengine
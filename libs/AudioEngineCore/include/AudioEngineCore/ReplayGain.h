@@ -0,0 +1,59 @@
+// Loudness normalization from ReplayGain and R128 tags.
+//
+// The engines read the tags when a track is opened and resolve them to one
+// linear gain, so the render thread only multiplies. ReplayGain values are
+// relative to its 89 dB SPL (about -18 LUFS) reference; Opus R128 tags are
+// Q7.8 dB relative to -23 LUFS and are shifted onto the same reference.
+#pragma once
+
+#include <functional>
+#include <optional>
+
+namespace audioengine {
+
+enum class NormalizationMode { kOff, kTrack, kAlbum };
+
+struct ReplayGainTags {
+  std::optional<double> trackGainDb;
+  std::optional<double> albumGainDb;
+  // Linear sample peaks (1.0 = full scale).
+  std::optional<double> trackPeak;
+  std::optional<double> albumPeak;
+
+  bool Empty() const {
+    return !trackGainDb && !albumGainDb && !trackPeak && !albumPeak;
+  }
+};
+
+// Looks a tag up by name ("REPLAYGAIN_TRACK_GAIN"); nullptr when absent.
+using TagLookup = std::function<const char*(const char* key)>;
+
+// Reads REPLAYGAIN_{TRACK,ALBUM}_{GAIN,PEAK} and R128_{TRACK,ALBUM}_GAIN.
+// ReplayGain tags win over R128 ones when a file carries both.
+ReplayGainTags ReadReplayGainTags(const TagLookup& lookup);
+
+// "-7.25 dB", "+1.5", "0.988 " -> value. False for anything else.
+bool ParseReplayGainValue(const char* text, double* value);
+// "-1792" (Q7.8, -23 LUFS reference) -> ReplayGain dB.
+bool ParseR128Gain(const char* text, double* gainDb);
+
+struct NormalizationGain {
+  // Linear gain to apply to the track's samples.
+  float gain = 1.0f;
+  // The gained track may exceed the ceiling. Untagged peaks count as full
+  // scale.
+  bool mayClip = false;
+  // `gain` lowered just enough to keep the peak under the ceiling, for
+  // outputs that have no limiter; equals `gain` when that is already safe.
+  float peakSafeGain = 1.0f;
+};
+
+// Resolves the gain for `mode`. Album mode falls back to track values and
+// vice versa; untagged tracks play at unity (the preamp is not applied to
+// them, it would make untagged tracks jump relative to tagged ones).
+NormalizationGain ResolveNormalization(NormalizationMode mode,
+                                       const ReplayGainTags& tags,
+                                       double preampDb = 0.0,
+                                       double ceilingDb = -1.0);
+
+}  // namespace audioengine
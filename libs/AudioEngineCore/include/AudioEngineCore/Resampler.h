@@ -0,0 +1,137 @@
+// Polyphase sample-rate conversion to the output device's native rate.
+//
+// Shared-mode outputs (AAudio's mixer, the WASAPI engine) resample anything
+// that is not at the device rate themselves, often on a slower path. The
+// engines convert in the decode thread instead, so the stream runs at the
+// native rate and there is exactly one, known resampling stage.
+//
+// The converter is a windowed-sinc polyphase FIR for the exact rational
+// ratio (44100 -> 48000 is 160/147), one coefficient set per output phase,
+// with SIMD dot products picked the same way as SampleKernels. Output frame
+// k sits at input time k * inRate / outRate: there is no delay to account
+// for, the converter just needs half its taps of look-ahead, which
+// ResamplingSource supplies with silence at the end of the stream.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "AudioEngineCore/PcmSource.h"
+
+namespace audioengine {
+
+enum class ResamplerQuality {
+  // 16 taps, 60 dB stopband, cutoff at Nyquist. Cheapest; some aliasing in
+  // the top octave.
+  kLow,
+  // 48 taps, 96 dB, passband to about 18.5 kHz at 44.1 kHz.
+  kMedium,
+  // 96 taps, 120 dB, passband to about 19.5 kHz at 44.1 kHz.
+  kHigh,
+};
+
+class PolyphaseResampler {
+ public:
+  // Ratios whose reduced numerator needs more phases than this are refused
+  // (the coefficient table would not stay in cache).
+  static constexpr uint32_t kMaxPhases = 2048;
+
+  // Control side. Designs the filter bank and clears the state. False (and
+  // unconfigured) for rates it cannot convert.
+  bool Configure(uint32_t inRate, uint32_t outRate, uint32_t channels,
+                 ResamplerQuality quality);
+  bool IsConfigured() const { return channels_ != 0; }
+
+  // Clears the history. The first output frame then sits `offset` /
+  // OutputStep() input frames after the first input frame; offset must be
+  // below InputStep(). Used to stay on the output grid after a seek.
+  void Reset(uint32_t offset = 0);
+
+  // Converts interleaved float frames. Consumes input until it runs out or
+  // `out` could overflow; `*consumed` receives the input frames used.
+  // Returns the output frames written. Never allocates.
+  size_t Process(const float* in, size_t inFrames, float* out, size_t maxOut,
+                 size_t* consumed);
+
+  // Input and output frames per conversion period: the ratio reduced to
+  // lowest terms (inRate / outRate == InputStep() / OutputStep()).
+  uint32_t InputStep() const { return inStep_; }
+  uint32_t OutputStep() const { return outStep_; }
+  // Taps per phase; the converter looks TapsPerPhase() / 2 frames ahead.
+  uint32_t TapsPerPhase() const { return taps_; }
+  uint32_t Channels() const { return channels_; }
+
+ private:
+  // Pushes one frame into the history.
+  void Push(const float* frame);
+
+  uint32_t channels_ = 0;
+  uint32_t inStep_ = 1;
+  uint32_t outStep_ = 1;
+  uint32_t taps_ = 0;
+  // taps_ coefficients per phase, oldest input first.
+  std::vector<float> coeffs_;
+  // Per-channel history, 2 * taps_ each, every sample stored twice so the
+  // window is always contiguous.
+  std::vector<float> history_;
+  uint32_t historyPos_ = 0;
+  // Phase of the next output, in 1/outStep_ input frames.
+  uint32_t phase_ = 0;
+  // Input frames still to push before the next output can be computed.
+  uint64_t wait_ = 0;
+};
+
+// Converts a float source to `outRate`. Seeks land on the output grid;
+// accurate seeks pre-roll the filter so the first frame is exact.
+class ResamplingSource : public PcmSource {
+ public:
+  // `inner` must produce 32-bit float and be positioned at its first frame;
+  // check CanResample() first.
+  ResamplingSource(std::unique_ptr<PcmSource> inner, uint32_t outRate,
+                   ResamplerQuality quality);
+
+  // Whether `format` can be converted to `outRate`.
+  static bool CanResample(const PcmFormat& format, uint32_t outRate);
+
+  PcmFormat Format() const override { return format_; }
+  size_t ReadFrames(uint8_t* dst, size_t maxFrames) override;
+  bool SeekToFrame(uint64_t frame, SeekMode mode,
+                   uint64_t* landedFrame) override;
+  uint64_t TotalFrames() const override;
+
+  PcmSource* Inner() const { return inner_.get(); }
+  ResamplerQuality Quality() const { return quality_; }
+
+ private:
+  // Restarts conversion at input frame `inputFrame`, returning the first
+  // output frame at or after it.
+  uint64_t Restart(uint64_t inputFrame);
+  // Converts the next block into pending_. False at the end of the stream.
+  bool Refill();
+  // Output frames one input frame count maps to, rounded up.
+  uint64_t OutputFramesFor(uint64_t inputFrames) const;
+
+  std::unique_ptr<PcmSource> inner_;
+  PcmFormat format_;
+  ResamplerQuality quality_;
+  PolyphaseResampler resampler_;
+  // Decoded input not yet consumed.
+  std::vector<float> input_;
+  size_t inputOffset_ = 0;
+  size_t inputFrames_ = 0;
+  // Converted output not yet read.
+  std::vector<float> pending_;
+  size_t pendingOffset_ = 0;
+  size_t pendingFrames_ = 0;
+  // Zeros fed after the inner source ends, to flush the look-ahead.
+  std::vector<float> silence_;
+  // Input frames read from inner_ and output frames converted, on the
+  // source's own timelines.
+  uint64_t inputPosition_ = 0;
+  uint64_t outputPosition_ = 0;
+  bool innerEnded_ = false;
+};
+
+}  // namespace audioengine
@@ -0,0 +1,69 @@
+// Sample-format conversion, gain, clamp and (de)interleave kernels.
+//
+// Formats are 16-, packed 24- and 32-bit signed integer and 32/64-bit float.
+// Every format pair has its own compile-time specialized loop; the hot pairs
+// (float <-> s16/s32, float and integer gain, float stereo interleave) also
+// have SSE2/AVX2/NEON kernels, picked once at runtime for the CPU. The C
+// bridge of the Swift engine carries a port of the gain kernels
+// (FFmpegSampleKernels.c); keep the rounding rules in sync.
+//
+// Integer <-> float maps full scale to 2^(bits-1): -32768 is -1.0 and +1.0
+// saturates to 32767. Float -> integer rounds to nearest (ties to even) and
+// saturates. Nothing here allocates, locks or blocks.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "AudioEngineCore/PcmFormat.h"
+
+namespace audioengine {
+
+enum class SampleType : uint8_t { kS16, kS24, kS32, kF32, kF64 };
+
+constexpr uint32_t BytesPerSample(SampleType type) {
+  switch (type) {
+    case SampleType::kS16: return 2;
+    case SampleType::kS24: return 3;
+    case SampleType::kS32:
+    case SampleType::kF32: return 4;
+    case SampleType::kF64: return 8;
+  }
+  return 0;
+}
+
+// False for layouts without a kernel (8-bit, 24-in-32 is reported as s32).
+bool SampleTypeOf(const PcmFormat& format, SampleType* type);
+
+enum class KernelIsa { kScalar, kSse2, kAvx2, kNeon };
+
+// Instruction set the kernels currently use.
+KernelIsa ActiveKernelIsa();
+// Overrides runtime detection (tests, benchmarks). False if the CPU or the
+// build does not support `isa`.
+bool SetKernelIsa(KernelIsa isa);
+bool KernelIsaSupported(KernelIsa isa);
+const char* KernelIsaName(KernelIsa isa);
+
+// dst[i] = src[i] * gain, converted from `from` to `to`. `src` and `dst` may
+// be the same buffer when both types have the same size.
+void ConvertSamples(SampleType from, const void* src, SampleType to, void* dst,
+                    size_t count, float gain = 1.0f);
+// samples *= gain in place. A gain of exactly 1 is a no-op.
+void ScaleSamples(SampleType type, void* samples, size_t count, float gain);
+// Clamps float samples to [-1, 1]; a no-op for integer types.
+void ClampSamples(SampleType type, void* samples, size_t count);
+
+// Planar <-> interleaved for `channels` planes of `frames` samples each.
+void InterleaveSamples(SampleType type, const void* const* planes,
+                       uint32_t channels, size_t frames, void* dst);
+void DeinterleaveSamples(SampleType type, const void* src, uint32_t channels,
+                         size_t frames, void* const* planes);
+
+// Specialized scalar loops only, whatever ActiveKernelIsa() says. Reference
+// for the tests: vector results must be within one integer step (or one
+// float rounding) of it.
+void ConvertSamplesScalar(SampleType from, const void* src, SampleType to,
+                          void* dst, size_t count, float gain = 1.0f);
+
+}  // namespace audioengine
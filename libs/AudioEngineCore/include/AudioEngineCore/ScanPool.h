@@ -0,0 +1,126 @@
+// Worker pool shared by the library scanners (waveforms, loudness,
+// features).
+//
+// Each worker has its own queue; idle workers steal from the back of the
+// others'. Jobs sharing a non-empty group go to one queue, whose owner
+// takes them front first, so an album's tracks stay together unless a
+// worker runs dry; loose jobs are dealt round-robin. Workers run below
+// normal priority so a scan never competes with the render or decode
+// threads, and they are started by the first Enqueue(): an engine that
+// never scans pays for no threads.
+//
+// Paths queued, running or done this session are skipped by Enqueue().
+// Cancel() drops queued jobs and moves to a new generation; a running
+// ScanFn polls Cancelled() and returns kCancelled, and its path may then be
+// queued again.
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "AudioEngineCore/SeekIndex.h"
+
+namespace audioengine {
+
+class ScanPool {
+ public:
+  struct Job {
+    SeekIndex::Key key;
+    // Jobs sharing a non-empty group are queued together.
+    std::string group;
+  };
+
+  enum class Outcome { kDone, kCached, kFailed, kCancelled };
+
+  struct Result {
+    Outcome outcome = Outcome::kFailed;
+    // Audio decoded for a kDone job.
+    double audioSeconds = 0.0;
+  };
+
+  // Runs one job on a worker thread, concurrently with other jobs. Whatever
+  // it stores is visible once WaitIdle() returns.
+  using ScanFn = std::function<Result(const Job& job, uint64_t generation)>;
+
+  struct Stats {
+    size_t tracksDone = 0;
+    size_t tracksCached = 0;
+    size_t tracksFailed = 0;
+    size_t tracksPending = 0;
+    double audioSeconds = 0.0;
+    // Wall time with work outstanding.
+    double busySeconds = 0.0;
+    unsigned workers = 0;
+  };
+
+  // `workers` 0 uses every hardware thread but one (the playback core).
+  explicit ScanPool(ScanFn scan, unsigned workers = 0);
+  // Abandons queued and running jobs and joins the workers. Owners declare
+  // the pool after everything `scan` touches, so it goes first.
+  ~ScanPool();
+
+  ScanPool(const ScanPool&) = delete;
+  ScanPool& operator=(const ScanPool&) = delete;
+
+  // Queues jobs; returns immediately with the number not skipped, which
+  // are also listed in `added` if given. A group's jobs should arrive in
+  // one call.
+  size_t Enqueue(const std::vector<Job>& jobs, std::vector<const Job*>* added = nullptr);
+  // Drops queued jobs; running ones see Cancelled() and are abandoned.
+  void Cancel();
+  // Blocks until nothing is queued or running.
+  void WaitIdle();
+
+  // For a running ScanFn: true once Cancel() or destruction has abandoned
+  // the generation it was handed.
+  bool Cancelled(uint64_t generation) const {
+    return generation_.load(std::memory_order_relaxed) != generation;
+  }
+
+  Stats GetStats() const;
+  // Configured workers; threads start with the first Enqueue().
+  unsigned WorkerCount() const { return static_cast<unsigned>(workers_.size()); }
+
+ private:
+  struct Worker {
+    std::mutex mutex;
+    // Owner pops the front, thieves take the back.
+    std::deque<Job> jobs;
+  };
+
+  void Run(unsigned index);
+  bool TakeJob(unsigned index, Job* job);
+  void Finish(const Job& job, const Result& result);
+
+  const ScanFn scan_;
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::atomic<size_t> queued_{0};
+  std::atomic<uint64_t> generation_{0};
+
+  mutable std::mutex mutex_;
+  std::condition_variable wake_;
+  std::condition_variable idle_;
+  bool stopping_ = false;
+  size_t outstanding_ = 0;
+  size_t nextWorker_ = 0;
+  std::set<std::string> seen_;
+  Stats stats_;
+  std::chrono::steady_clock::time_point busySince_;
+  std::chrono::steady_clock::duration busyTime_{};
+
+  std::vector<std::thread> threads_;
+};
+
+}  // namespace audioengine
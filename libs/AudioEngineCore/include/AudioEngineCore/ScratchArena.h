@@ -0,0 +1,73 @@
+// Preallocated, size-classed scratch memory for decode hot paths.
+//
+// Engines reserve an arena when a track is opened, sized from the codec's
+// frame-size hint, and then only Acquire() from it while decoding. Capacity is
+// rounded up to a power-of-two size class, so an unexpectedly large frame
+// causes at most a handful of growths over a track instead of one allocation
+// per frame.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace audioengine {
+
+class ScratchArena {
+ public:
+  static constexpr size_t kMinSizeClass = 4096;
+
+  ScratchArena() = default;
+  ScratchArena(const ScratchArena&) = delete;
+  ScratchArena& operator=(const ScratchArena&) = delete;
+
+  // Smallest size class that holds `bytes`.
+  static size_t SizeClass(size_t bytes) {
+    size_t size = kMinSizeClass;
+    while (size < bytes) size <<= 1;
+    return size;
+  }
+
+  // Allocates up front so later Acquire() calls up to `bytes` are free.
+  // Not counted as a growth.
+  void Reserve(size_t bytes) {
+    if (bytes <= capacity_) return;
+    Allocate(SizeClass(bytes));
+  }
+
+  // Returns storage for at least `bytes`. Contents are not preserved across
+  // a growth.
+  uint8_t* Acquire(size_t bytes) {
+    if (bytes > capacity_) {
+      Allocate(SizeClass(bytes));
+      ++growths_;
+    }
+    return data_.get();
+  }
+
+  uint8_t* Data() { return data_.get(); }
+  const uint8_t* Data() const { return data_.get(); }
+  size_t Capacity() const { return capacity_; }
+
+  // Number of times Acquire() had to allocate after Reserve(). Zero means the
+  // hint covered every request.
+  uint64_t Growths() const { return growths_; }
+
+  void Release() {
+    data_.reset();
+    capacity_ = 0;
+    growths_ = 0;
+  }
+
+ private:
+  void Allocate(size_t bytes) {
+    data_.reset(new uint8_t[bytes]);
+    capacity_ = bytes;
+  }
+
+  std::unique_ptr<uint8_t[]> data_;
+  size_t capacity_ = 0;
+  uint64_t growths_ = 0;
+};
+
+}  // namespace audioengine
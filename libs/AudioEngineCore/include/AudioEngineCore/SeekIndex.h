@@ -0,0 +1,89 @@
+// Compact frame -> byte-offset table for files whose containers have no
+// usable seek index (VBR MP3 without a TOC, FLAC without a SEEKTABLE, ADTS).
+//
+// One point is kept per `intervalFrames` bucket: the first packet that starts
+// in it. Lookup is a direct bucket index. Tables are cached on disk keyed by
+// path, size and mtime; the same format is read and written by
+// FFmpegSeekIndex.c in AudioEngineSwift, so keep the two in sync.
+//
+// On-disk format, little-endian:
+//   0  char[4]  "TNSX"
+//   4  u16      version (kSeekIndexVersion)
+//   6  u16      reserved, 0
+//   8  u64      file size in bytes
+//   16 i64      file mtime, seconds since the Unix epoch
+//   24 u32      sample rate
+//   28 u32      interval in frames
+//   32 u32      point count
+//   36 u32      FNV-1a 32 of the UTF-8 path
+//   40 points   per point: LEB128 frame delta, LEB128 byte-offset delta
+//   ..  u32     FNV-1a 32 of every preceding byte
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace audioengine {
+
+constexpr uint16_t kSeekIndexVersion = 1;
+
+struct SeekPoint {
+  uint64_t frame = 0;
+  // Byte position of the packet that starts at `frame`.
+  uint64_t byteOffset = 0;
+};
+
+class SeekIndex {
+ public:
+  // Identifies one version of one file. A changed size or mtime produces a
+  // different cache entry, so stale tables are never used.
+  struct Key {
+    std::string path;  // UTF-8
+    uint64_t fileSize = 0;
+    int64_t mtimeSeconds = 0;
+  };
+
+  SeekIndex() = default;
+  SeekIndex(uint32_t sampleRate, uint32_t intervalFrames);
+
+  // Interval used by the engines: half a second, which is longer than any
+  // packet of the codecs we index.
+  static uint32_t DefaultInterval(uint32_t sampleRate) {
+    return sampleRate > 1 ? sampleRate / 2 : 1;
+  }
+
+  // Records a packet. Packets must arrive in stream order; only the first one
+  // per interval is kept.
+  void Add(uint64_t frame, uint64_t byteOffset);
+
+  // Point with the greatest frame <= `frame`. False when the index is empty or
+  // starts after `frame`.
+  bool Lookup(uint64_t frame, SeekPoint* point) const;
+
+  bool Empty() const { return points_.empty(); }
+  size_t Size() const { return points_.size(); }
+  uint32_t SampleRate() const { return sampleRate_; }
+  uint32_t IntervalFrames() const { return intervalFrames_; }
+  const std::vector<SeekPoint>& Points() const { return points_; }
+
+  std::vector<uint8_t> Serialize(const Key& key) const;
+  // Fails on a bad magic/version/checksum or when the header does not match
+  // `key`; `*this` is left untouched then.
+  bool Deserialize(const uint8_t* data, size_t size, const Key& key);
+
+  // Cache file name (no directory) for `key`: 16 hex digits + ".seekidx".
+  static std::string CacheFileName(const Key& key);
+
+  // `cacheDir` (UTF-8) must already exist.
+  bool Save(const std::string& cacheDir, const Key& key) const;
+  bool Load(const std::string& cacheDir, const Key& key);
+
+ private:
+  uint32_t sampleRate_ = 0;
+  uint32_t intervalFrames_ = 1;
+  std::vector<SeekPoint> points_;
+};
+
+}  // namespace audioengine
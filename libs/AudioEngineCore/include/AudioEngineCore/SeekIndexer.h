@@ -0,0 +1,63 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "AudioEngineCore/SeekIndex.h"
+
+namespace audioengine {
+
+// Builds seek indexes off the playback path and caches them in `cacheDir`.
+// The engines Request() an index when they open a long file without a usable
+// container index, and Load() it on the first seek; until the build finishes
+// seeks fall back to the demuxer's own search.
+class SeekIndexer {
+ public:
+  // Scans the file named by the key and fills the index (packet headers only,
+  // no decoding). Returns false if the file could not be indexed. Runs on the
+  // indexer thread.
+  using BuildFn = std::function<bool(const SeekIndex::Key&, SeekIndex*)>;
+
+  SeekIndexer(std::string cacheDir, BuildFn build);
+  ~SeekIndexer();
+
+  SeekIndexer(const SeekIndexer&) = delete;
+  SeekIndexer& operator=(const SeekIndexer&) = delete;
+
+  const std::string& CacheDir() const { return cacheDir_; }
+
+  // Reads a cached index. False if there is none yet for this file version.
+  bool Load(const SeekIndex::Key& key, SeekIndex* index) const;
+
+  // Queues a background build unless the index is cached or already queued.
+  void Request(const SeekIndex::Key& key);
+
+  // Blocks until the queue is empty and no build is running.
+  void WaitIdle();
+
+  // Number of indexes built and saved since construction.
+  size_t BuiltCount() const;
+
+ private:
+  void Run();
+  bool Pending(const SeekIndex::Key& key) const;
+
+  const std::string cacheDir_;
+  const BuildFn build_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable wake_;
+  std::condition_variable idle_;
+  std::deque<SeekIndex::Key> queue_;
+  std::string building_;  // cache name of the running build, if any
+  size_t built_ = 0;
+  bool stopping_ = false;
+  std::thread thread_;
+};
+
+}  // namespace audioengine
@@ -0,0 +1,66 @@
+// Sequence lock: one writer publishes snapshots of a small trivially
+// copyable value, any number of readers copy the newest one.
+//
+// Store() never waits, so it is safe on the render thread. Load() spins
+// only while a Store() is in the middle of its copy, which is a few dozen
+// stores, and retries then. Neither side takes a lock. The value is kept
+// as atomic words, so a torn copy is detected and discarded rather than
+// being a data race.
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace audioengine {
+
+template <typename T>
+class SeqLock {
+  static_assert(std::is_trivially_copyable<T>::value, "SeqLock copies T bytewise");
+
+ public:
+  SeqLock() { Store(T{}); }
+
+  SeqLock(const SeqLock&) = delete;
+  SeqLock& operator=(const SeqLock&) = delete;
+
+  // One writer at a time (callers serialize writers themselves).
+  void Store(const T& value) {
+    uint64_t words[kWords] = {};
+    std::memcpy(words, &value, sizeof(T));
+    const uint32_t sequence = sequence_.load(std::memory_order_relaxed);
+    sequence_.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t i = 0; i < kWords; ++i) {
+      words_[i].store(words[i], std::memory_order_relaxed);
+    }
+    sequence_.store(sequence + 2, std::memory_order_release);
+  }
+
+  // Any thread.
+  T Load() const {
+    uint64_t words[kWords];
+    while (true) {
+      const uint32_t before = sequence_.load(std::memory_order_acquire);
+      if (before & 1) continue;
+      for (size_t i = 0; i < kWords; ++i) {
+        words[i] = words_[i].load(std::memory_order_relaxed);
+      }
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (sequence_.load(std::memory_order_relaxed) == before) break;
+    }
+    T value;
+    std::memcpy(&value, words, sizeof(T));
+    return value;
+  }
+
+ private:
+  static constexpr size_t kWords = (sizeof(T) + 7) / 8;
+
+  std::atomic<uint32_t> sequence_{0};
+  std::atomic<uint64_t> words_[kWords];
+};
+
+}  // namespace audioengine
@@ -0,0 +1,166 @@
+// Spectrum analyzer for visualizers, fed by a tap on the render path.
+//
+// Tap() is the only render-side call: it copies the output, in whatever
+// sample format the device takes, into a bounded lock-free ring and
+// returns. If the ring is full because the worker is behind, the rest is
+// dropped rather than waited for. A worker thread drains the ring,
+// converts and downmixes to mono, and up to Options::framesPerSecond
+// times a second runs a Hann-windowed real FFT over the newest FftSize() frames.
+// The FFT bins are grouped into log-spaced bands and converted to dBFS, so
+// a full-scale sine reads 0 dB in its band. Levels are then smoothed:
+// rises show at once, and falls decay over the release time.
+//
+// Frames are published through a triple buffer. A UI thread reads the
+// newest one with Latest() without locks, and nothing it does reaches the
+// render thread. When the tap stops (pause, end of track) the levels fall
+// to the floor and then nothing more is published.
+//
+// Configure() allocates and starts the worker; Tap() never allocates,
+// locks or blocks.
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "AudioEngineCore/Fft.h"
+#include "AudioEngineCore/PcmFormat.h"
+#include "AudioEngineCore/PcmRingBuffer.h"
+#include "AudioEngineCore/SampleKernels.h"
+
+namespace audioengine {
+
+struct SpectrumFrame {
+  static constexpr uint32_t kMaxBands = 128;
+
+  // Counts published frames.
+  uint64_t sequence = 0;
+  uint32_t bands = 0;
+  // Lowest band first, in dBFS; never below SpectrumAnalyzer::Options::floorDb.
+  float levelsDb[kMaxBands] = {};
+};
+
+class SpectrumAnalyzer {
+ public:
+  static constexpr uint32_t kMaxBands = SpectrumFrame::kMaxBands;
+  static constexpr uint32_t kMaxFramesPerSecond = 60;
+
+  struct Options {
+    uint32_t bands = 64;
+    // Band range; maxHz is capped at Nyquist.
+    double minHz = 20.0;
+    double maxHz = 20000.0;
+    // 1 to kMaxFramesPerSecond.
+    uint32_t framesPerSecond = 60;
+    // Time for a falling level to cover 63% of the way down.
+    double releaseMs = 300.0;
+    float floorDb = -90.0f;
+  };
+
+  SpectrumAnalyzer() = default;
+  ~SpectrumAnalyzer();
+
+  SpectrumAnalyzer(const SpectrumAnalyzer&) = delete;
+  SpectrumAnalyzer& operator=(const SpectrumAnalyzer&) = delete;
+
+  // Control side, while no Tap() is running. Sizes the ring and the FFT for
+  // `format` (about 85 ms of audio), clears the levels and (re)starts the
+  // worker. False, and unconfigured, for formats without a sample kernel.
+  bool Configure(const PcmFormat& format);
+  bool IsConfigured() const { return worker_.joinable(); }
+  size_t FftSize() const { return fft_.Size(); }
+
+  // Any thread. Takes effect with the next frame.
+  void SetOptions(const Options& options);
+  Options GetOptions() const;
+  // Any thread. Off by default: Tap() returns at once and the worker sleeps.
+  void SetEnabled(bool enabled);
+  bool Enabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+  // Render side. Copies `frames` interleaved frames of the configured
+  // format into the ring.
+  void Tap(const void* samples, size_t frames) {
+    if (!enabled_.load(std::memory_order_relaxed)) return;
+    const size_t written = ring_.Write(static_cast<const uint8_t*>(samples), frames);
+    if (written < frames) {
+      dropped_.fetch_add(frames - written, std::memory_order_relaxed);
+    }
+  }
+
+  // Copies the newest frame to `frame` if one was published since the last
+  // call. One reader thread at a time.
+  bool Latest(SpectrumFrame* frame);
+  // Centre frequency of each band under the current options.
+  std::vector<double> BandCentersHz() const;
+  // Frames Tap() had no room for since Configure().
+  uint64_t DroppedFrames() const { return dropped_.load(std::memory_order_relaxed); }
+
+ private:
+  // Band layout for one set of options: band b takes the largest magnitude
+  // of bins [first[b], last[b]), or interpolates at `centre[b]` (a
+  // fractional bin) when that range is empty.
+  struct Layout {
+    uint32_t bands = 0;
+    std::vector<uint32_t> first;
+    std::vector<uint32_t> last;
+    std::vector<float> centre;
+  };
+
+  void WorkerLoop();
+  void StopWorker();
+  // Worker: moves everything in the ring into history_. Returns the frames
+  // moved.
+  size_t Drain();
+  void BuildLayout(const Options& options);
+  // Worker: measures history_ (when `fresh`) or decays towards the floor,
+  // and publishes. False once every band rests on the floor.
+  bool Analyse(const Options& options, double seconds, bool fresh);
+
+  // Control state, shared with the worker under mutex_.
+  mutable std::mutex mutex_;
+  std::condition_variable wakeCv_;
+  Options options_;
+  uint64_t optionsVersion_ = 1;
+  bool stopWorker_ = false;
+  std::thread worker_;
+  PcmFormat format_{};
+  SampleType type_ = SampleType::kF32;
+
+  std::atomic<bool> enabled_{false};
+  std::atomic<uint64_t> dropped_{0};
+  PcmRingBuffer ring_;
+
+  // Worker.
+  RealFft fft_;
+  std::vector<uint8_t> raw_;
+  std::vector<float> converted_;
+  // Newest FftSize() mono frames, oldest at historyAt_.
+  std::vector<float> history_;
+  size_t historyAt_ = 0;
+  std::vector<float> window_;
+  // Scale from a bin's magnitude to a sine's amplitude.
+  float windowGain_ = 0.0f;
+  std::vector<float> windowed_;
+  std::vector<float> re_;
+  std::vector<float> im_;
+  std::vector<float> magnitude_;
+  Layout layout_;
+  uint64_t layoutVersion_ = 0;
+  float levels_[kMaxBands] = {};
+  uint64_t sequence_ = 0;
+
+  // Triple buffer: the worker fills slots_[writeSlot_] and swaps it into
+  // latest_; Latest() swaps latest_ with readSlot_ when kFresh is set.
+  static constexpr uint32_t kFresh = 4;
+  static constexpr uint32_t kSlotMask = 3;
+  SpectrumFrame slots_[3];
+  uint32_t writeSlot_ = 0;
+  std::atomic<uint32_t> latest_{1};
+  uint32_t readSlot_ = 2;
+};
+
+}  // namespace audioengine
@@ -0,0 +1,143 @@
+// Background decode thread that keeps a bounded PCM ring topped up.
+//
+// The engine hands over a PcmSource, the producer thread pulls frames from it
+// into a PcmRingBuffer, and the render thread drains the ring with Read().
+// Load time is bounded by the prefill target instead of the track length, and
+// memory is bounded by the ring capacity.
+//
+// For gapless playback a second source can be queued with QueueNext(); when
+// the current one ends the producer switches to it and keeps writing into the
+// same ring, so the two tracks meet sample-exactly with no refill gap.
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "AudioEngineCore/PcmFormat.h"
+#include "AudioEngineCore/PcmRingBuffer.h"
+#include "AudioEngineCore/PcmSource.h"
+
+namespace audioengine {
+
+class StreamingDecoder {
+ public:
+  struct Options {
+    // Ring capacity in seconds of audio at the source rate.
+    double bufferSeconds = 2.0;
+    // Start() returns once this much audio is buffered (or the source ends).
+    double prefillSeconds = 0.1;
+    // Upper bound for a single PcmSource::ReadFrames() call.
+    size_t chunkFrames = 4096;
+  };
+
+  StreamingDecoder();
+  explicit StreamingDecoder(const Options& options);
+  ~StreamingDecoder();
+
+  StreamingDecoder(const StreamingDecoder&) = delete;
+  StreamingDecoder& operator=(const StreamingDecoder&) = delete;
+
+  // Takes ownership of `source`, sizes the ring for its format and starts the
+  // producer thread. Blocks until the prefill target is reached.
+  bool Start(std::unique_ptr<PcmSource> source);
+
+  // Stops the producer thread and releases the source. The render thread
+  // must no longer be reading.
+  void Stop();
+
+  // Repositions the stream. The render thread may keep calling Read(); it
+  // receives silence until audio from the new position is available.
+  // PositionFrames() afterwards reports where the source actually landed.
+  bool Seek(uint64_t frame, SeekMode mode = SeekMode::kAccurate);
+
+  // Queues the source to play when the current one ends. It must have the
+  // same format. Replaces a source queued earlier; nullptr clears it. Fails
+  // while an earlier transition has not been collected by TakeTrackChange().
+  bool QueueNext(std::unique_ptr<PcmSource> next);
+  bool HasQueuedNext() const;
+
+  // Control-thread side. Returns true once per transition, after the render
+  // thread has read past the last frame of the previous track; positions and
+  // totals refer to the new track from then on.
+  bool TakeTrackChange();
+
+  // Render-thread side. Copies up to `frames` frames into `dst` and returns
+  // how many were copied. Never blocks, locks or allocates.
+  size_t Read(uint8_t* dst, size_t frames);
+
+  // Producer has reached the end of the source and the ring is drained.
+  bool IsFinished() const;
+  bool IsActive() const;
+
+  PcmFormat Format() const { return format_; }
+  uint64_t PositionFrames() const;
+  uint64_t TotalFrames() const;
+  size_t BufferedFrames() const { return ring_.AvailableFrames(); }
+  // Frames handed to Read() so far. Safe on the render thread.
+  uint64_t FramesRead() const { return ring_.FramesRead(); }
+  // Control-thread side: the FramesRead() count at which `frame` of the
+  // current track is read, so a render thread can act on a track position
+  // without touching the position bookkeeping.
+  uint64_t ReadCountAt(uint64_t frame) const;
+  // FramesRead() count at which a spliced next track starts, until the
+  // transition is collected; UINT64_MAX otherwise. Safe on the render thread.
+  uint64_t PendingBoundary() const;
+  size_t CapacityFrames() const { return ring_.CapacityFrames(); }
+
+  // Wall time of the last Seek(), from the call until the ring was refilled
+  // to the prefill target.
+  std::chrono::microseconds LastSeekDuration() const { return lastSeekDuration_; }
+
+  // Heap allocations made on the producer thread after the prefill target
+  // was reached. Only meaningful when allocation counting is compiled in
+  // (see AllocationCounter.h); otherwise always zero.
+  uint64_t SteadyStateAllocations() const {
+    return steadyStateAllocations_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  void StartThread();
+  void StopThread();
+  void WaitForPrefill();
+  void ProducerLoop();
+  // Producer side: switches to next_ when the current source ends. Returns
+  // false (and marks the stream ended) if nothing is queued.
+  bool SpliceNext();
+  void CollectTransition();
+
+  Options options_;
+  std::unique_ptr<PcmSource> source_;
+  PcmFormat format_{};
+  PcmRingBuffer ring_;
+  size_t prefillFrames_ = 0;
+
+  // Gapless chaining. source_, next_ and previous_ are swapped by the
+  // producer under chainMutex_; boundary_ is the ring write count at which
+  // the newer track starts.
+  mutable std::mutex chainMutex_;
+  std::unique_ptr<PcmSource> next_;
+  std::unique_ptr<PcmSource> previous_;
+  std::atomic<bool> transitionPending_{false};
+  std::atomic<uint64_t> boundary_{0};
+
+  // Position bookkeeping, only touched by the control thread.
+  uint64_t baseFrame_ = 0;
+  uint64_t baseReadHead_ = 0;
+  std::chrono::microseconds lastSeekDuration_{0};
+
+  std::thread thread_;
+  std::atomic<bool> stopRequested_{false};
+  std::atomic<bool> sourceEnded_{false};
+  std::atomic<uint64_t> steadyStateAllocations_{0};
+  std::mutex wakeMutex_;
+  std::condition_variable wakeCv_;
+  std::condition_variable prefillCv_;
+};
+
+}  // namespace audioengine
@@ -0,0 +1,152 @@
+// Pitch-preserving playback rate for the float render path.
+//
+// WSOLA (waveform-similarity overlap-add): output is built from Hann-windowed
+// input segments overlapped by half a window. Each new segment is taken
+// about rate x hop further into the input than the last, shifted within a
+// small search range to where it best continues the previous segment's
+// waveform (normalized cross-correlation), so periodic sounds such as
+// voices and notes splice in phase and keep their pitch. The search runs
+// coarse on a decimated mono guide signal, then at full rate around the
+// best match; the correlations use SIMD dot products picked the same way as
+// SampleKernels.
+//
+// The stretcher sits between the decode ring and the output: Read() pulls
+// rate x frames from the ring for every frame it writes, so the decoder,
+// the ring and the ring's position clock all run in input frames and only
+// HeldFrames() (a window or two) is in flight. At rate 1 with nothing held
+// Read() is a plain read from the ring. Leaving rate 1 and returning to it
+// splice exactly: the overlap-add of a segment with its own continuation is
+// the input itself.
+//
+// Configure() allocates; Read() never allocates, locks or blocks.
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace audioengine {
+
+class TimeStretcher {
+ public:
+  static constexpr double kMinRate = 0.5;
+  static constexpr double kMaxRate = 3.0;
+  static constexpr uint32_t kMaxChannels = 8;
+  // Segment hop (half a window) and the search range either side of the
+  // nominal position. Long enough for two periods of a low voice.
+  static constexpr double kHopMs = 12.0;
+  static constexpr double kSearchMs = 8.0;
+
+  // Control side, while no Read() is running. Sizes the buffers for
+  // `sampleRate` and drops anything held. False (and unconfigured) for more
+  // than kMaxChannels channels.
+  bool Configure(uint32_t sampleRate, uint32_t channels);
+  bool IsConfigured() const { return channels_ != 0; }
+  uint32_t HopFrames() const { return hop_; }
+
+  // Any thread; clamped to [kMinRate, kMaxRate]. Applies from the next hop.
+  void SetRate(double rate);
+  double Rate() const { return rate_.load(std::memory_order_relaxed); }
+
+  // Render side. Writes up to `frames` interleaved frames to `out`, pulling
+  // input with `read(float* dst, size_t frames) -> size_t`. Returns fewer
+  // frames only when `read` comes up short; with `inputEnded` what is held
+  // is then played out, at rate 1.
+  template <typename ReadFn>
+  size_t Read(float* out, size_t frames, ReadFn&& read, bool inputEnded = false);
+
+  // Input frames read but not yet heard; the reader's position less this
+  // is the audible one. Any thread.
+  uint64_t HeldFrames() const { return held_.load(std::memory_order_relaxed); }
+  // Nothing held and rate 1: Read() is a pass-through.
+  bool Idle() const;
+  // Drops everything held, e.g. after a seek. Render side (or control side
+  // while no Read() is running).
+  void Reset();
+
+ private:
+  // Copies pending output, and held input when passing through, to `out`.
+  size_t TakeOutput(float* out, size_t frames);
+  // At a hop boundary, with all output taken: reads the rate for the next
+  // hop and switches between stretching and passing through. True when
+  // stretching.
+  bool BeginHop();
+  // Stops stretching; held input from the end of the last segment's
+  // overlap plays as it is.
+  void PassThrough();
+  // Input frames the next hop still needs, 0 when it has them. Drops held
+  // input no later hop can use to make room for them at InputEnd().
+  size_t InputWanted();
+  float* InputEnd() { return input_.data() + (end_ - start_) * channels_; }
+  void CommitInput(size_t frames);
+  // Renders one hop into output_.
+  void Step();
+  // Best segment start in [lo, hi] to follow the segment at prev_.
+  int64_t Search(int64_t lo, int64_t hi) const;
+  void PublishHeld();
+
+  uint32_t sampleRate_ = 0;
+  uint32_t channels_ = 0;
+  // Hop, search range and decimation of the guide signal, in frames.
+  uint32_t hop_ = 0;
+  uint32_t search_ = 0;
+  uint32_t decimation_ = 1;
+  std::atomic<double> rate_{1.0};
+  std::atomic<uint64_t> held_{0};
+  // Render side: the rate for the hop in progress.
+  double hopRate_ = 1.0;
+
+  // Rising half of the Hann window; the falling half is 1 minus it.
+  std::vector<float> window_;
+  // Held input from frame start_ (a multiple of decimation_) to end_,
+  // interleaved, with its mono mix and the decimated mono guide. Positions
+  // are input frames since the last Reset() or pass-through.
+  std::vector<float> input_;
+  std::vector<float> mono_;
+  std::vector<float> guide_;
+  size_t capacity_ = 0;
+  int64_t start_ = 0;
+  int64_t end_ = 0;
+  // Stretching: the last segment starts at prev_, and was aimed at target_.
+  // Passing through: cursor_ is the next input frame to play.
+  bool stretching_ = false;
+  int64_t prev_ = 0;
+  double target_ = 0.0;
+  int64_t cursor_ = 0;
+  // One hop of rendered output and how much of it is still unread.
+  std::vector<float> output_;
+  size_t outputAt_ = 0;
+  size_t outputLeft_ = 0;
+};
+
+template <typename ReadFn>
+size_t TimeStretcher::Read(float* out, size_t frames, ReadFn&& read, bool inputEnded) {
+  if (channels_ == 0) return read(out, frames);
+  size_t done = TakeOutput(out, frames);
+  while (done < frames) {
+    if (!BeginHop()) {
+      // Held input first, then straight from the reader.
+      done += TakeOutput(out + done * channels_, frames - done);
+      if (done < frames) done += read(out + done * channels_, frames - done);
+      break;
+    }
+    if (const size_t wanted = InputWanted()) {
+      const size_t got = read(InputEnd(), wanted);
+      CommitInput(got);
+      if (got < wanted) {
+        if (!inputEnded) break;
+        // Too little left for another hop: play the rest as it is.
+        PassThrough();
+        done += TakeOutput(out + done * channels_, frames - done);
+        break;
+      }
+    }
+    Step();
+    done += TakeOutput(out + done * channels_, frames - done);
+  }
+  PublishHeld();
+  return done;
+}
+
+}  // namespace audioengine
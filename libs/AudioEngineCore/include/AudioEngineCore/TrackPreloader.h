@@ -0,0 +1,167 @@
+// Background open of the next queue item.
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+
+namespace audioengine {
+
+// Prepares one track ahead of time on its own thread so that loading it later
+// is a hand-over instead of an open, probe and prefill. `Track` is the
+// engine's prepared-track type (default-constructible and movable); `Key`
+// identifies it, normally the path.
+//
+// There is a single slot: Preload() replaces whatever was requested before,
+// and a job that finishes after being replaced is thrown away.
+template <typename Track, typename Key = std::string>
+class TrackPreloader {
+ public:
+  // Fills the track; false if it could not be prepared. Runs on the preloader
+  // thread, so it must only touch state that is safe to share.
+  using Job = std::function<bool(Track*)>;
+
+  TrackPreloader() : thread_(&TrackPreloader::Run, this) {}
+
+  ~TrackPreloader() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+      hasJob_ = false;
+    }
+    wake_.notify_all();
+    thread_.join();
+  }
+
+  TrackPreloader(const TrackPreloader&) = delete;
+  TrackPreloader& operator=(const TrackPreloader&) = delete;
+
+  // Starts preparing `key` in the background. A request for the key that is
+  // already ready or being prepared is a no-op.
+  void Preload(Key key, Job job) {
+    Track stale;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (stopping_) return;
+      if (Preparing(key) || (hasReady_ && readyKey_ == key)) return;
+      ++generation_;
+      stale = Discard();
+      jobKey_ = std::move(key);
+      job_ = std::move(job);
+      hasJob_ = true;
+    }
+    wake_.notify_one();
+  }
+
+  // Moves out the prepared track for `key`, waiting for it if it is still
+  // being prepared. False if `key` was not preloaded or its job failed; the
+  // caller then opens the track itself.
+  bool Take(const Key& key, Track* track) {
+    Track stale;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!done_.wait_for(lock, kWaitSlice, [this, &key] {
+      return stopping_ || !Preparing(key);
+    })) {
+    }
+    if (!hasReady_ || readyKey_ != key) return false;
+    *track = std::move(ready_);
+    stale = Discard();
+    return true;
+  }
+
+  // Drops the prepared track and any pending request, e.g. after a setting
+  // the prepared track depends on has changed.
+  void Clear() {
+    Track stale;
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++generation_;
+    stale = Discard();
+  }
+
+  bool IsReady(const Key& key) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return hasReady_ && readyKey_ == key;
+  }
+
+ private:
+  // Bounded like the other core workers; the predicate decides, the timeout
+  // only caps a missed notification.
+  static constexpr std::chrono::milliseconds kWaitSlice{500};
+
+  bool Preparing(const Key& key) const {
+    return (hasJob_ && jobKey_ == key) ||
+           (running_ && runningGeneration_ == generation_ && runningKey_ == key);
+  }
+
+  // Forgets the pending request and the ready track. The track is returned so
+  // the caller destroys it (closing its decoder) after unlocking.
+  Track Discard() {
+    hasJob_ = false;
+    job_ = nullptr;
+    hasReady_ = false;
+    Track track = std::move(ready_);
+    ready_ = Track();
+    return track;
+  }
+
+  void Run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      wake_.wait_for(lock, kWaitSlice, [this] { return stopping_ || hasJob_; });
+      if (stopping_) break;
+      if (!hasJob_) continue;
+      Job job = std::move(job_);
+      job_ = nullptr;
+      hasJob_ = false;
+      runningKey_ = std::move(jobKey_);
+      runningGeneration_ = generation_;
+      running_ = true;
+      lock.unlock();
+
+      Track track;
+      const bool ok = job && job(&track);
+
+      lock.lock();
+      running_ = false;
+      Track stale;
+      if (ok && runningGeneration_ == generation_ && !stopping_) {
+        stale = Discard();
+        ready_ = std::move(track);
+        readyKey_ = runningKey_;
+        hasReady_ = true;
+      }
+      done_.notify_all();
+      // Superseded results and replaced tracks are released unlocked.
+      lock.unlock();
+      stale = Track();
+      track = Track();
+      lock.lock();
+    }
+    done_.notify_all();
+  }
+
+  mutable std::mutex mutex_;
+  std::condition_variable wake_;
+  std::condition_variable done_;
+  Key jobKey_{};
+  Job job_;
+  bool hasJob_ = false;
+  Key runningKey_{};
+  uint64_t runningGeneration_ = 0;
+  bool running_ = false;
+  Key readyKey_{};
+  Track ready_{};
+  bool hasReady_ = false;
+  // Bumped by every Preload()/Clear(); a job whose generation is stale no
+  // longer has a taker.
+  uint64_t generation_ = 0;
+  bool stopping_ = false;
+  std::thread thread_;
+};
+
+}  // namespace audioengine
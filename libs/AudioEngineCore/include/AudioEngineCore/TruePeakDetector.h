@@ -0,0 +1,46 @@
+// 4x oversampled inter-sample peak estimate (ITU-R BS.1770-4 Annex 2).
+//
+// Shared by the limiter, which needs a per-frame estimate, the loudness
+// meter, which only keeps the maximum, and the level meter, which keeps
+// one per channel. Configure() allocates; Push() never
+// allocates.
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace audioengine {
+
+class TruePeakDetector {
+ public:
+  static constexpr uint32_t kTaps = 12;
+  static constexpr uint32_t kOversample = 4;
+  // The frame measured by Push() is this many frames older than the one
+  // pushed, so the interpolator can see both sides of it.
+  static constexpr uint32_t kLatencyFrames = 6;
+
+  void Configure(uint32_t channels);
+  void Reset();
+  uint32_t Channels() const { return channels_; }
+
+  // Pushes one interleaved frame and returns the largest absolute value, over
+  // all channels, of the frame kLatencyFrames back and the kOversample - 1
+  // points interpolated after it.
+  float Push(const float* frame);
+  // Pushes one interleaved frame and raises peaks[ch] to channel ch's
+  // estimate for the same points.
+  void Accumulate(const float* frame, float* peaks);
+
+ private:
+  // Stores `sample` in channel `ch`'s history and returns its estimate.
+  float PushChannel(uint32_t ch, float sample);
+
+  uint32_t channels_ = 0;
+  // Polyphase interpolator for the kOversample - 1 points between frames.
+  float coeffs_[kOversample - 1][kTaps] = {};
+  // Per-channel history, 2 * kTaps each.
+  std::vector<float> history_;
+  uint32_t historyPos_ = 0;
+};
+
+}  // namespace audioengine
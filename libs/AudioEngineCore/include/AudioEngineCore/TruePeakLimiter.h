@@ -0,0 +1,109 @@
+// Look-ahead true-peak limiter for the float render path.
+//
+// Normalization gain can push loud masters past full scale. The limiter
+// delays the signal by a short look-ahead, estimates inter-sample peaks with
+// 4x polyphase oversampling, and ramps the gain down over the look-ahead
+// window so the peak arrives already attenuated; the gain recovers with an
+// exponential release. Below the ceiling it is a pure delay.
+//
+// Configure() allocates; Process() never allocates, locks or blocks.
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "AudioEngineCore/TruePeakDetector.h"
+
+namespace audioengine {
+
+class TruePeakLimiter {
+ public:
+  static constexpr uint32_t kInterpolatorTaps = TruePeakDetector::kTaps;
+  static constexpr uint32_t kOversample = TruePeakDetector::kOversample;
+
+  struct Options {
+    // Output ceiling in dBTP.
+    double ceilingDb = -1.0;
+    double lookaheadMs = 1.5;
+    double releaseMs = 100.0;
+  };
+
+  struct Stats {
+    uint64_t framesProcessed = 0;
+    // Frames rendered with the gain pulled down.
+    uint64_t framesLimited = 0;
+    // Deepest gain reduction so far, in dB (positive).
+    float maxReductionDb = 0.0f;
+    // Wall time spent in Process().
+    uint64_t processNanos = 0;
+
+    // Processing cost as a fraction of real time at `sampleRate`.
+    double CpuLoad(uint32_t sampleRate) const {
+      if (framesProcessed == 0 || sampleRate == 0) return 0.0;
+      const double audioNanos =
+          static_cast<double>(framesProcessed) * 1e9 / sampleRate;
+      return static_cast<double>(processNanos) / audioNanos;
+    }
+  };
+
+  // Control side, while no Process() call is running. Sizes the delay lines,
+  // clears all state and resets the stats.
+  void Configure(uint32_t sampleRate, uint32_t channels, const Options& options);
+  void Configure(uint32_t sampleRate, uint32_t channels) {
+    Configure(sampleRate, channels, Options{});
+  }
+  bool IsConfigured() const { return channels_ != 0; }
+
+  // Render side. Limits `frames` interleaved float frames in place. Output
+  // lags input by LatencyFrames().
+  void Process(float* samples, size_t frames);
+
+  // Clears the delay line and envelope, e.g. after a seek. Render side (or
+  // control side while Process() is not running).
+  void Reset();
+
+  uint32_t LatencyFrames() const { return delay_; }
+  uint32_t SampleRate() const { return sampleRate_; }
+  // Safe from any thread.
+  Stats GetStats() const;
+
+ private:
+  // Largest gain that keeps the current frame's true peak under the ceiling,
+  // after pushing it into the detector.
+  float RequiredGain(const float* frame);
+  // Sliding minimum of RequiredGain() over the look-ahead window.
+  float HoldMinimum(float gain);
+
+  uint32_t sampleRate_ = 0;
+  uint32_t channels_ = 0;
+  float ceiling_ = 1.0f;
+  float releaseCoeff_ = 0.0f;
+  uint32_t lookahead_ = 1;
+  uint32_t delay_ = 0;
+  uint64_t frameIndex_ = 0;
+
+  TruePeakDetector detector_;
+  // Delayed audio, delay_ frames.
+  std::vector<float> delayLine_;
+  uint32_t delayPos_ = 0;
+  // Monotonic deque of (gain, frame) for the sliding minimum.
+  std::vector<float> minGain_;
+  std::vector<uint64_t> minFrame_;
+  uint32_t minHead_ = 0;
+  uint32_t minCount_ = 0;
+  // Box filter over the held minimum; smooths the attack into a ramp that
+  // completes within the look-ahead.
+  std::vector<float> boxRing_;
+  uint32_t boxPos_ = 0;
+  double boxSum_ = 0.0;
+  float envelope_ = 1.0f;
+
+  std::atomic<uint64_t> framesProcessed_{0};
+  std::atomic<uint64_t> framesLimited_{0};
+  std::atomic<float> minEnvelope_{1.0f};
+  std::atomic<uint64_t> processNanos_{0};
+};
+
+}  // namespace audioengine
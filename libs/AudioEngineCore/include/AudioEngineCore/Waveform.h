@@ -0,0 +1,151 @@
+// Waveform overviews for seekbars: min, max and RMS per point at several
+// zoom levels, finest first, each level 4x coarser than the one before.
+//
+// WaveformBuilder reduces decoded float PCM to the finest level (16 to
+// 32 ms per point, a power-of-two frame count) and derives the coarser
+// levels from it. Only the first kMaxChannels channels are looked at, so
+// the decoder can be asked to drop the rest.
+//
+// Waveforms are cached on disk keyed by path, size and mtime, in a layout
+// that is read in place: Map() maps the file, checks the header and points
+// the levels into the mapping, so serving one costs no decoding and no
+// copying whatever the track length. The same format is read and written
+// by FFmpegWaveform.c in AudioEngineSwift, so keep the two in sync.
+//
+// On-disk format, little-endian:
+//   0  char[4]  "TNWF"
+//   4  u16      version (kWaveformCacheVersion)
+//   6  u16      level count, 1 to Waveform::kMaxLevels
+//   8  u64      file size in bytes
+//   16 i64      file mtime, seconds since the Unix epoch
+//   24 u32      sample rate
+//   28 u32      FNV-1a 32 of the UTF-8 path
+//   32 u64      frames analysed
+//   40 u32      channels of the source
+//   44 u32      FNV-1a 32 of bytes 0-43 and the level table
+//   48 levels   per level, finest first: u32 frames per point, u32 points
+//   ..  points  per level in the same order: i16 min, i16 max, i16 RMS, in
+//               1/32767 of full scale
+// Only the header and level table are checksummed, so the cost of Map()
+// does not grow with the track; the file must be exactly as long as the
+// table says.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "AudioEngineCore/SeekIndex.h"
+
+namespace audioengine {
+
+namespace cachefile {
+class MappedFile;
+}  // namespace cachefile
+
+constexpr uint16_t kWaveformCacheVersion = 1;
+
+// Matches the on-disk point, so mapped levels are used in place (all the
+// engines' targets are little-endian).
+struct WaveformPoint {
+  int16_t min = 0;
+  int16_t max = 0;
+  int16_t rms = 0;
+};
+static_assert(sizeof(WaveformPoint) == 6, "WaveformPoint must match the file layout");
+
+struct WaveformLevel {
+  uint32_t framesPerPoint = 0;
+  const WaveformPoint* points = nullptr;
+  size_t count = 0;
+};
+
+class Waveform {
+ public:
+  static constexpr size_t kMaxLevels = 8;
+  // Scale of WaveformPoint values: full scale reads 32767.
+  static constexpr float kFullScale = 32767.0f;
+
+  ~Waveform();
+
+  Waveform(const Waveform&) = delete;
+  Waveform& operator=(const Waveform&) = delete;
+
+  uint32_t SampleRate() const { return sampleRate_; }
+  uint32_t Channels() const { return channels_; }
+  uint64_t Frames() const { return frames_; }
+  size_t LevelCount() const { return levels_.size(); }
+  // Finest first.
+  const WaveformLevel& Level(size_t index) const { return levels_[index]; }
+  // Coarsest level with at least `points` points, so a view `points` wide
+  // reduces at most 4 points into one; the finest when none has enough.
+  const WaveformLevel& LevelFor(size_t points) const;
+
+  std::vector<uint8_t> Serialize(const SeekIndex::Key& key) const;
+  // `cacheDir` (UTF-8) must already exist.
+  bool Save(const std::string& cacheDir, const SeekIndex::Key& key) const;
+  // Maps the waveform cached in `cacheDir` for `key`. Null when there is
+  // none, or it is corrupt or for another version of the file.
+  static std::shared_ptr<const Waveform> Map(const std::string& cacheDir,
+                                             const SeekIndex::Key& key);
+
+  // Cache file name (no directory) for `key`: 16 hex digits + ".waveform".
+  static std::string CacheFileName(const SeekIndex::Key& key);
+
+ private:
+  friend class WaveformBuilder;
+
+  Waveform() = default;
+
+  uint32_t sampleRate_ = 0;
+  uint32_t channels_ = 0;
+  uint64_t frames_ = 0;
+  std::vector<WaveformLevel> levels_;
+  // Levels point into one of these.
+  std::vector<WaveformPoint> owned_;
+  std::unique_ptr<cachefile::MappedFile> mapped_;
+};
+
+class WaveformBuilder {
+ public:
+  static constexpr uint32_t kMaxChannels = 2;
+  // Coarser levels are added while the coarsest has more points than this.
+  static constexpr size_t kMinTopPoints = 256;
+
+  // Frames per point of the finest level for `sampleRate`: 1/64 s rounded
+  // up to a power of two (1024 at 44.1 and 48 kHz).
+  static uint32_t BaseFramesPerPoint(uint32_t sampleRate);
+
+  // Starts a new waveform for interleaved float input with `channels`
+  // channels, of which the first kMaxChannels are measured.
+  void Configure(uint32_t sampleRate, uint32_t channels);
+  void Process(const float* samples, size_t frames);
+  uint64_t FramesProcessed() const { return frames_; }
+  // Closes the last (partial) point and builds the coarser levels. Null
+  // when nothing was processed.
+  std::shared_ptr<const Waveform> Finish();
+
+ private:
+  // One point before quantization; coarser levels merge these.
+  struct Accumulator {
+    float min = 0.0f;
+    float max = 0.0f;
+    double sumSquares = 0.0;
+    uint64_t samples = 0;
+  };
+
+  void ClosePoint();
+
+  uint32_t sampleRate_ = 0;
+  uint32_t channels_ = 0;
+  uint32_t measured_ = 0;
+  uint32_t framesPerPoint_ = 0;
+  uint64_t frames_ = 0;
+  Accumulator current_;
+  uint32_t currentFrames_ = 0;
+  std::vector<Accumulator> points_;
+};
+
+}  // namespace audioengine
@@ -0,0 +1,85 @@
+// Background waveform generation for a music library.
+//
+// Tracks are decoded through the engines' own PcmSource, opened for
+// overview work (source rate, no resampling, at most
+// WaveformBuilder::kMaxChannels channels), reduced with WaveformBuilder and
+// cached as mapped Waveform files keyed by path, size and mtime. Tracks
+// whose waveform is already cached are skipped, so a library is covered
+// incrementally across sessions.
+//
+// Work is spread over a ScanPool; tracks are independent, so there is
+// nothing to keep together. Load() never decodes: it maps the cached file,
+// which is what the UI should call.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "AudioEngineCore/PcmSource.h"
+#include "AudioEngineCore/ScanPool.h"
+#include "AudioEngineCore/SeekIndex.h"
+#include "AudioEngineCore/Waveform.h"
+
+namespace audioengine {
+
+class WaveformScanner {
+ public:
+  // Opens a file for overview decoding; null if it cannot be decoded.
+  // Called on the worker threads, concurrently.
+  using OpenFn = std::function<std::unique_ptr<PcmSource>(const std::string& path)>;
+
+  struct Stats {
+    size_t tracksGenerated = 0;
+    size_t tracksCached = 0;  // already on disk when their turn came
+    size_t tracksFailed = 0;
+    size_t tracksPending = 0;
+    double audioSeconds = 0.0;  // decoded
+    // Wall time with work outstanding.
+    double busySeconds = 0.0;
+    unsigned workers = 0;
+
+    // Seconds of audio reduced per wall-clock second, all workers.
+    double RealtimeFactor() const {
+      return busySeconds > 0.0 ? audioSeconds / busySeconds : 0.0;
+    }
+  };
+
+  // `cacheDir` (UTF-8) must exist; waveforms are only served from it, so an
+  // empty one makes Enqueue() a no-op. `workers` 0 uses every hardware
+  // thread but one (the playback core).
+  WaveformScanner(std::string cacheDir, OpenFn open, unsigned workers = 0);
+
+  WaveformScanner(const WaveformScanner&) = delete;
+  WaveformScanner& operator=(const WaveformScanner&) = delete;
+
+  // Queues tracks; returns immediately. Tracks already queued or done in
+  // this session are skipped.
+  void Enqueue(const std::vector<SeekIndex::Key>& keys);
+  // Drops queued tracks; running ones are abandoned unsaved.
+  void Cancel() { pool_.Cancel(); }
+  // Blocks until nothing is queued or running.
+  void WaitIdle() { pool_.WaitIdle(); }
+
+  // Cached waveform for `key`, mapped; null until it has been generated.
+  // Any thread, no locks taken.
+  std::shared_ptr<const Waveform> Load(const SeekIndex::Key& key) const {
+    return Waveform::Map(cacheDir_, key);
+  }
+
+  Stats GetStats() const;
+  unsigned WorkerCount() const { return pool_.WorkerCount(); }
+
+ private:
+  ScanPool::Result Generate(const SeekIndex::Key& key, uint64_t generation);
+
+  const std::string cacheDir_;
+  const OpenFn open_;
+  // Last, so its workers stop before the members they use go.
+  ScanPool pool_;
+};
+
+}  // namespace audioengine
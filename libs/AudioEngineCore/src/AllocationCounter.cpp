@@ -0,0 +1,71 @@
+#include "AudioEngineCore/AllocationCounter.h"
+
+#ifdef AUDIOENGINECORE_COUNT_ALLOCATIONS
+#include <cstdlib>
+#include <new>
+#endif
+
+namespace audioengine::debug {
+
+#ifdef AUDIOENGINECORE_COUNT_ALLOCATIONS
+
+namespace {
+thread_local uint64_t gThreadAllocations = 0;
+}  // namespace
+
+bool AllocationCountingEnabled() { return true; }
+
+uint64_t ThreadAllocationCount() { return gThreadAllocations; }
+
+namespace internal {
+
+void* CountedAllocate(std::size_t size) {
+  ++gThreadAllocations;
+  if (size == 0) size = 1;
+  return std::malloc(size);
+}
+
+}  // namespace internal
+
+#else
+
+bool AllocationCountingEnabled() { return false; }
+
+uint64_t ThreadAllocationCount() { return 0; }
+
+#endif
+
+}  // namespace audioengine::debug
+
+#ifdef AUDIOENGINECORE_COUNT_ALLOCATIONS
+
+// Only the unaligned forms are replaced; over-aligned allocations keep the
+// standard library's matching new/delete pair.
+void* operator new(std::size_t size) {
+  void* p = audioengine::debug::internal::CountedAllocate(size);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+void* operator new[](std::size_t size) {
+  void* p = audioengine::debug::internal::CountedAllocate(size);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+  return audioengine::debug::internal::CountedAllocate(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+  return audioengine::debug::internal::CountedAllocate(size);
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { std::free(p); }
+
+#endif
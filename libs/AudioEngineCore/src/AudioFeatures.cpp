@@ -0,0 +1,392 @@
+#include "AudioEngineCore/AudioFeatures.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace audioengine {
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+// The decimated rate stays at or above this.
+constexpr uint32_t kMinAnalysisRate = 20000;
+// Frames quieter than this (mean square of the mono frame) add nothing to
+// the spectral-shape and chroma averages: -60 dBFS.
+constexpr double kGateMeanSquare = 1e-6;
+// Magnitudes are compressed as log(1 + kCompression * |X|) for the onset
+// envelope, |X| scaled to sine amplitude.
+constexpr float kCompression = 100.0f;
+constexpr double kChromaMinHz = 200.0;
+constexpr double kChromaMaxHz = 5000.0;
+constexpr double kRolloffShare = 0.85;
+constexpr double kMinBpm = 60.0;
+constexpr double kMaxBpm = 200.0;
+// Centre and width (octaves) of the tempo prior, and of the band
+// danceability favours.
+constexpr double kPreferredBpm = 120.0;
+constexpr double kTempoPriorOctaves = 1.0;
+constexpr double kDanceOctaves = 0.5;
+// The onset envelope is compared with its mean over this window.
+constexpr double kDetrendSeconds = 1.0;
+// Autocorrelation lags go out to this, so the beat period can be refined on
+// a multiple of itself.
+constexpr double kMaxLagSeconds = 4.0;
+// Less audio than this, or a weaker pulse, has no tempo; noise scores
+// about 0.1.
+constexpr double kMinTempoSeconds = 4.0;
+constexpr double kMinTempoConfidence = 0.2;
+
+// Krumhansl-Kessler key profiles, tonic first.
+constexpr double kMajorProfile[12] = {6.35, 2.23, 3.48, 2.33, 4.38, 4.09,
+                                      2.52, 5.19, 2.39, 3.66, 2.29, 2.88};
+constexpr double kMinorProfile[12] = {6.33, 2.68, 3.52, 5.38, 2.60, 3.53,
+                                      2.54, 4.75, 3.98, 2.69, 3.34, 3.17};
+
+double Clamp01(double value) { return std::clamp(value, 0.0, 1.0); }
+
+// Pearson correlation of `chroma` with `profile` rotated to `tonic`.
+double KeyCorrelation(const double* chroma, const double* profile, int tonic) {
+  double chromaMean = 0.0;
+  double profileMean = 0.0;
+  for (int i = 0; i < 12; ++i) {
+    chromaMean += chroma[i];
+    profileMean += profile[i];
+  }
+  chromaMean /= 12.0;
+  profileMean /= 12.0;
+  double cross = 0.0;
+  double chromaSquares = 0.0;
+  double profileSquares = 0.0;
+  for (int i = 0; i < 12; ++i) {
+    const double c = chroma[(i + tonic) % 12] - chromaMean;
+    const double p = profile[i] - profileMean;
+    cross += c * p;
+    chromaSquares += c * c;
+    profileSquares += p * p;
+  }
+  const double norm = std::sqrt(chromaSquares * profileSquares);
+  return norm > 0.0 ? cross / norm : 0.0;
+}
+
+// ln(1 + x) for x >= 0, within 1e-3: the exponent of 1 + x plus a cubic in
+// its mantissa. The onset envelope needs one per bin per frame and only
+// differences of it matter; std::log1p was half the analysis time.
+float FastLog1p(float x) {
+  uint32_t bits = 0;
+  const float y = 1.0f + x;
+  std::memcpy(&bits, &y, sizeof(bits));
+  const int exponent = static_cast<int>(bits >> 23) - 127;
+  bits = (bits & 0x007fffffu) | 0x3f800000u;
+  float t = 0.0f;
+  std::memcpy(&t, &bits, sizeof(t));
+  t -= 1.0f;
+  const float log2 = t * (1.4208645f + t * (-0.5772507f + t * 0.1563861f));
+  return (static_cast<float>(exponent) + log2) * 0.69314718f;
+}
+
+// Vertex of the parabola through (-1, a), (0, b), (1, c), as an offset.
+double ParabolicOffset(double a, double b, double c) {
+  const double denominator = a - 2.0 * b + c;
+  if (denominator >= 0.0) return 0.0;
+  return std::clamp(0.5 * (a - c) / denominator, -0.5, 0.5);
+}
+
+}  // namespace
+
+void FeatureAnalyzer::Configure(uint32_t sampleRate, uint32_t channels) {
+  sampleRate_ = sampleRate;
+  channels_ = std::max<uint32_t>(channels, 1);
+  decimation_ = 1;
+  while (sampleRate / (2 * decimation_) >= kMinAnalysisRate) decimation_ *= 2;
+  frames_ = 0;
+  decimateSum_ = 0.0f;
+  decimateCount_ = 0;
+
+  ring_.assign(2 * kFftSize, 0.0f);
+  ringPos_ = 0;
+  sinceFrame_ = 0;
+  sumSquares_ = 0.0;
+
+  fft_.Configure(kFftSize);
+  const size_t bins = fft_.Bins();
+  window_.resize(kFftSize);
+  for (size_t i = 0; i < kFftSize; ++i) {
+    window_[i] = static_cast<float>(0.5 - 0.5 * std::cos(2.0 * kPi * i / kFftSize));
+  }
+  windowed_.assign(kFftSize, 0.0f);
+  re_.assign(bins, 0.0f);
+  im_.assign(bins, 0.0f);
+  magnitude_.assign(bins, 0.0f);
+  logMagnitude_.assign(bins, 0.0f);
+  prevLogMagnitude_.assign(bins, 0.0f);
+
+  const double rate = AnalysisRate();
+  binHz_.resize(bins);
+  binPitchClass_.assign(bins, -1);
+  for (size_t k = 0; k < bins; ++k) {
+    const double hz = k * rate / kFftSize;
+    binHz_[k] = static_cast<float>(hz);
+    if (hz >= kChromaMinHz && hz <= kChromaMaxHz) {
+      // A = 440 Hz is pitch class 9.
+      const long semitones = std::lround(12.0 * std::log2(hz / 440.0)) + 9;
+      binPitchClass_[k] = static_cast<int8_t>(((semitones % 12) + 12) % 12);
+    }
+  }
+
+  onsets_.clear();
+  std::fill(std::begin(chroma_), std::end(chroma_), 0.0);
+  centroidSum_ = 0.0;
+  spreadSum_ = 0.0;
+  rolloffSum_ = 0.0;
+  flatnessSum_ = 0.0;
+  voicedFrames_ = 0;
+}
+
+void FeatureAnalyzer::Process(const float* samples, size_t frames) {
+  if (sampleRate_ == 0) return;
+  const float scale = 1.0f / channels_;
+  for (size_t f = 0; f < frames; ++f) {
+    float mono = 0.0f;
+    for (uint32_t ch = 0; ch < channels_; ++ch) mono += samples[f * channels_ + ch];
+    mono *= scale;
+    sumSquares_ += static_cast<double>(mono) * mono;
+    decimateSum_ += mono;
+    if (++decimateCount_ < decimation_) continue;
+    const float sample = decimateSum_ / decimation_;
+    decimateSum_ = 0.0f;
+    decimateCount_ = 0;
+
+    ring_[ringPos_] = sample;
+    ring_[ringPos_ + kFftSize] = sample;
+    ringPos_ = (ringPos_ + 1) % kFftSize;
+    if (++sinceFrame_ == kHop) {
+      sinceFrame_ = 0;
+      AnalyzeFrame();
+    }
+  }
+  frames_ += frames;
+}
+
+void FeatureAnalyzer::AnalyzeFrame() {
+  // Oldest sample first.
+  const float* frame = ring_.data() + ringPos_;
+  double meanSquare = 0.0;
+  for (size_t i = 0; i < kFftSize; ++i) {
+    meanSquare += static_cast<double>(frame[i]) * frame[i];
+    windowed_[i] = frame[i] * window_[i];
+  }
+  meanSquare /= kFftSize;
+  fft_.Forward(windowed_.data(), re_.data(), im_.data());
+
+  // Hann's coherent gain is 1/2: a sine of amplitude A peaks at A * N / 4.
+  const float gain = 4.0f / kFftSize;
+  const size_t bins = fft_.Bins();
+  double flux = 0.0;
+  for (size_t k = 0; k < bins; ++k) {
+    const float magnitude = gain * std::sqrt(re_[k] * re_[k] + im_[k] * im_[k]);
+    magnitude_[k] = magnitude;
+    logMagnitude_[k] = FastLog1p(kCompression * magnitude);
+    flux += std::max(0.0f, logMagnitude_[k] - prevLogMagnitude_[k]);
+  }
+  logMagnitude_.swap(prevLogMagnitude_);
+  onsets_.push_back(static_cast<float>(flux));
+
+  if (meanSquare < kGateMeanSquare) return;
+  // DC carries no shape.
+  double sum = 0.0;
+  double weighted = 0.0;
+  double powerSum = 0.0;
+  // The geometric mean is kept as a product renormalized every few bins
+  // (mantissa and binary exponent), a log per frame instead of per bin.
+  double product = 1.0;
+  long exponent = 0;
+  double frameChroma[12] = {};
+  for (size_t k = 1; k < bins; ++k) {
+    const double magnitude = magnitude_[k];
+    const double power = magnitude * magnitude + 1e-12;
+    sum += magnitude;
+    weighted += magnitude * binHz_[k];
+    powerSum += power;
+    product *= power;
+    if ((k & 7) == 0) {
+      int e = 0;
+      product = std::frexp(product, &e);
+      exponent += e;
+    }
+    if (binPitchClass_[k] >= 0) frameChroma[binPitchClass_[k]] += power;
+  }
+  const double logPowerSum = std::log(product) + exponent * std::log(2.0);
+  if (sum <= 0.0) return;
+  const double centroid = weighted / sum;
+  double spread = 0.0;
+  double rolloff = binHz_[bins - 1];
+  double running = 0.0;
+  bool rolledOff = false;
+  for (size_t k = 1; k < bins; ++k) {
+    const double offset = binHz_[k] - centroid;
+    spread += magnitude_[k] * offset * offset;
+    running += magnitude_[k];
+    if (!rolledOff && running >= kRolloffShare * sum) {
+      rolloff = binHz_[k];
+      rolledOff = true;
+    }
+  }
+  const double bands = static_cast<double>(bins - 1);
+  centroidSum_ += centroid;
+  spreadSum_ += std::sqrt(spread / sum);
+  rolloffSum_ += rolloff;
+  flatnessSum_ += std::exp(logPowerSum / bands) / (powerSum / bands);
+  ++voicedFrames_;
+
+  // Each loud frame votes equally, whatever its level.
+  double chromaSum = 0.0;
+  for (double value : frameChroma) chromaSum += value;
+  if (chromaSum > 0.0) {
+    for (int i = 0; i < 12; ++i) chroma_[i] += frameChroma[i] / chromaSum;
+  }
+}
+
+double FeatureAnalyzer::EstimateTempo(double* confidence, double* onsetRate) const {
+  *confidence = 0.0;
+  *onsetRate = 0.0;
+  const double frameRate = static_cast<double>(AnalysisRate()) / kHop;
+  const size_t count = onsets_.size();
+  if (count < kMinTempoSeconds * frameRate) return 0.0;
+
+  // Onset strength above its local mean, so sustained changes in level do
+  // not read as a pulse.
+  const size_t half = static_cast<size_t>(kDetrendSeconds * frameRate / 2.0);
+  std::vector<double> envelope(count);
+  double windowSum = 0.0;
+  size_t windowLo = 0;
+  size_t windowHi = 0;  // exclusive
+  for (size_t i = 0; i < count; ++i) {
+    const size_t lo = i > half ? i - half : 0;
+    const size_t hi = std::min(count, i + half + 1);
+    while (windowHi < hi) windowSum += onsets_[windowHi++];
+    while (windowLo < lo) windowSum -= onsets_[windowLo++];
+    envelope[i] = std::max(0.0, onsets_[i] - windowSum / (hi - lo));
+  }
+
+  double mean = 0.0;
+  for (double value : envelope) mean += value;
+  mean /= count;
+  double variance = 0.0;
+  for (double value : envelope) variance += (value - mean) * (value - mean);
+  const double deviation = std::sqrt(variance / count);
+  const double threshold = mean + deviation;
+  size_t peaks = 0;
+  for (size_t i = 1; i + 1 < count; ++i) {
+    if (envelope[i] > threshold && envelope[i] > envelope[i - 1] &&
+        envelope[i] >= envelope[i + 1]) {
+      ++peaks;
+    }
+  }
+  *onsetRate = peaks * frameRate / count;
+
+  // Unbiased autocorrelation, so long lags are not penalized for having
+  // fewer products.
+  const size_t maxLag =
+      std::min(count / 2, static_cast<size_t>(kMaxLagSeconds * frameRate) + 1);
+  std::vector<double> correlation(maxLag + 1, 0.0);
+  for (size_t lag = 0; lag <= maxLag; ++lag) {
+    double acc = 0.0;
+    for (size_t i = lag; i < count; ++i) acc += envelope[i] * envelope[i - lag];
+    correlation[lag] = acc / (count - lag);
+  }
+  if (correlation[0] <= 0.0) return 0.0;
+
+  const size_t minLag = std::max<size_t>(1, static_cast<size_t>(60.0 * frameRate / kMaxBpm));
+  const size_t lastLag =
+      std::min(maxLag / 2, static_cast<size_t>(std::ceil(60.0 * frameRate / kMinBpm)));
+  size_t best = 0;
+  double bestScore = 0.0;
+  for (size_t lag = minLag; lag <= lastLag; ++lag) {
+    // Only local maxima are beat candidates.
+    if (correlation[lag] < correlation[lag - 1] || correlation[lag] < correlation[lag + 1]) {
+      continue;
+    }
+    const double octaves = std::log2(60.0 * frameRate / lag / kPreferredBpm) /
+                           kTempoPriorOctaves;
+    const double score = std::exp(-0.5 * octaves * octaves) *
+                         (correlation[lag] + 0.5 * correlation[2 * lag]);
+    if (score > bestScore) {
+      bestScore = score;
+      best = lag;
+    }
+  }
+  if (best == 0 || correlation[best] < kMinTempoConfidence * correlation[0]) return 0.0;
+  *confidence = Clamp01(correlation[best] / correlation[0]);
+
+  // Refine the period on the furthest multiple that still fits: the error of
+  // the peak position is divided by the multiple.
+  const size_t multiple = std::max<size_t>(1, (maxLag - 1) / best);
+  size_t peak = best * multiple;
+  const size_t from = peak - std::min(peak - 1, multiple);
+  const size_t to = std::min(maxLag - 1, peak + multiple);
+  for (size_t lag = from; lag <= to; ++lag) {
+    if (correlation[lag] > correlation[peak]) peak = lag;
+  }
+  const double period = (peak + ParabolicOffset(correlation[peak - 1], correlation[peak],
+                                                 correlation[peak + 1])) /
+                        multiple;
+  return 60.0 * frameRate / period;
+}
+
+bool FeatureAnalyzer::Finish(TrackFeatures* result) {
+  if (sampleRate_ == 0 || frames_ == 0) return false;
+  TrackFeatures features;
+  features.frames = frames_;
+  features.sampleRate = sampleRate_;
+  const double meanSquare = sumSquares_ / frames_;
+  features.rmsDb = meanSquare > 1e-12 ? 10.0 * std::log10(meanSquare) : -120.0;
+
+  features.bpm = EstimateTempo(&features.tempoConfidence, &features.onsetRate);
+
+  if (voicedFrames_ > 0) {
+    features.spectralCentroidHz = centroidSum_ / voicedFrames_;
+    features.spectralSpreadHz = spreadSum_ / voicedFrames_;
+    features.spectralRolloffHz = rolloffSum_ / voicedFrames_;
+    features.spectralFlatness = flatnessSum_ / voicedFrames_;
+
+    double bestCorrelation = 0.0;
+    for (int tonic = 0; tonic < 12; ++tonic) {
+      const double major = KeyCorrelation(chroma_, kMajorProfile, tonic);
+      const double minor = KeyCorrelation(chroma_, kMinorProfile, tonic);
+      if (major > bestCorrelation) {
+        bestCorrelation = major;
+        features.key = tonic;
+        features.minor = false;
+      }
+      if (minor > bestCorrelation) {
+        bestCorrelation = minor;
+        features.key = tonic;
+        features.minor = true;
+      }
+    }
+    features.keyConfidence = bestCorrelation;
+  }
+
+  // Loudness carries half of the energy, how busy and how bright the rest:
+  // -40 dBFS RMS reads as nothing, -8 dBFS (a loud master) as full; six
+  // onsets a second as busy; brightness goes from a 500 Hz to a 4 kHz
+  // centroid.
+  const double brightness =
+      features.spectralCentroidHz > 0.0
+          ? Clamp01(std::log2(features.spectralCentroidHz / 500.0) / 3.0)
+          : 0.0;
+  features.energy = 0.5 * Clamp01((features.rmsDb + 40.0) / 32.0) +
+                    0.25 * Clamp01(features.onsetRate / 6.0) + 0.25 * brightness;
+
+  // A steady pulse near dance tempos.
+  if (features.bpm > 0.0) {
+    const double octaves = std::log2(features.bpm / kPreferredBpm) / kDanceOctaves;
+    features.danceability =
+        Clamp01(features.tempoConfidence * std::exp(-0.5 * octaves * octaves));
+  }
+  *result = features;
+  return true;
+}
+
+}  // namespace audioengine
@@ -0,0 +1,224 @@
+#include "CacheFile.h"
+
+#include <cstdio>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace audioengine {
+namespace cachefile {
+
+namespace {
+
+#ifdef _WIN32
+std::wstring Widen(const std::string& utf8) {
+  const int length = MultiByteToWideChar(CP_UTF8, 0, utf8.c_str(), -1, nullptr, 0);
+  if (length <= 0) return std::wstring();
+  std::wstring wide(static_cast<size_t>(length), L'\0');
+  MultiByteToWideChar(CP_UTF8, 0, utf8.c_str(), -1, wide.data(), length);
+  wide.resize(static_cast<size_t>(length - 1));
+  return wide;
+}
+
+FILE* OpenFile(const std::string& path, bool write) {
+  return _wfopen(Widen(path).c_str(), write ? L"wb" : L"rb");
+}
+
+bool MoveOver(const std::string& from, const std::string& to) {
+  return MoveFileExW(Widen(from).c_str(), Widen(to).c_str(),
+                     MOVEFILE_REPLACE_EXISTING) != 0;
+}
+
+void RemoveFile(const std::string& path) { _wremove(Widen(path).c_str()); }
+#else
+FILE* OpenFile(const std::string& path, bool write) {
+  return std::fopen(path.c_str(), write ? "wb" : "rb");
+}
+
+bool MoveOver(const std::string& from, const std::string& to) {
+  return std::rename(from.c_str(), to.c_str()) == 0;
+}
+
+void RemoveFile(const std::string& path) { std::remove(path.c_str()); }
+#endif
+
+}  // namespace
+
+uint32_t Fnv1a32(const uint8_t* data, size_t size, uint32_t hash) {
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= data[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+uint64_t Fnv1a64(uint64_t hash, const uint8_t* data, size_t size) {
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= data[i];
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+void PutLe(std::vector<uint8_t>* out, uint64_t value, int bytes) {
+  for (int i = 0; i < bytes; ++i) {
+    out->push_back(static_cast<uint8_t>(value >> (8 * i)));
+  }
+}
+
+uint64_t GetLe(const uint8_t* in, int bytes) {
+  uint64_t value = 0;
+  for (int i = 0; i < bytes; ++i) {
+    value |= static_cast<uint64_t>(in[i]) << (8 * i);
+  }
+  return value;
+}
+
+void PutVarint(std::vector<uint8_t>* out, uint64_t value) {
+  while (value >= 0x80) {
+    out->push_back(static_cast<uint8_t>(value | 0x80));
+    value >>= 7;
+  }
+  out->push_back(static_cast<uint8_t>(value));
+}
+
+bool GetVarint(const uint8_t** in, const uint8_t* end, uint64_t* value) {
+  uint64_t result = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    if (*in == end) return false;
+    const uint8_t byte = *(*in)++;
+    result |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0) {
+      *value = result;
+      return true;
+    }
+  }
+  return false;
+}
+
+std::string CacheFileName(const std::string& path, uint64_t fileSize,
+                          int64_t mtimeSeconds, const char* extension) {
+  uint8_t sizeAndTime[16];
+  for (int i = 0; i < 8; ++i) {
+    sizeAndTime[i] = static_cast<uint8_t>(fileSize >> (8 * i));
+    sizeAndTime[8 + i] =
+        static_cast<uint8_t>(static_cast<uint64_t>(mtimeSeconds) >> (8 * i));
+  }
+  uint64_t hash = Fnv1a64(14695981039346656037ull,
+                          reinterpret_cast<const uint8_t*>(path.data()), path.size());
+  hash = Fnv1a64(hash, sizeAndTime, sizeof(sizeAndTime));
+
+  char name[24];
+  std::snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(hash));
+  return name + std::string(extension);
+}
+
+std::string JoinPath(const std::string& dir, const std::string& name) {
+  std::string path = dir;
+  if (!path.empty() && path.back() != '/' && path.back() != '\\') {
+    path += '/';
+  }
+  return path + name;
+}
+
+bool WriteAtomically(const std::string& path, const std::vector<uint8_t>& bytes) {
+  const std::string temp = path + ".tmp";
+  FILE* file = OpenFile(temp, true);
+  if (!file) return false;
+  const bool written =
+      std::fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+  if (std::fclose(file) != 0 || !written) {
+    RemoveFile(temp);
+    return false;
+  }
+  if (!MoveOver(temp, path)) {
+    RemoveFile(temp);
+    return false;
+  }
+  return true;
+}
+
+bool ReadAll(const std::string& path, std::vector<uint8_t>* bytes) {
+  FILE* file = OpenFile(path, false);
+  if (!file) return false;
+  bytes->clear();
+  uint8_t chunk[4096];
+  size_t got = 0;
+  while ((got = std::fread(chunk, 1, sizeof(chunk), file)) > 0) {
+    bytes->insert(bytes->end(), chunk, chunk + got);
+  }
+  std::fclose(file);
+  return true;
+}
+
+MappedFile::~MappedFile() { Close(); }
+
+#ifdef _WIN32
+bool MappedFile::Open(const std::string& path) {
+  Close();
+  HANDLE file = CreateFileW(Widen(path).c_str(), GENERIC_READ,
+                            FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr,
+                            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE) return false;
+  LARGE_INTEGER size;
+  HANDLE mapping = nullptr;
+  if (GetFileSizeEx(file, &size) && size.QuadPart > 0) {
+    mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  }
+  // The mapping keeps the file open.
+  CloseHandle(file);
+  if (!mapping) return false;
+  const void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  if (!view) {
+    CloseHandle(mapping);
+    return false;
+  }
+  mapping_ = mapping;
+  data_ = static_cast<const uint8_t*>(view);
+  size_ = static_cast<size_t>(size.QuadPart);
+  return true;
+}
+
+void MappedFile::Close() {
+  if (data_) UnmapViewOfFile(data_);
+  if (mapping_) CloseHandle(mapping_);
+  data_ = nullptr;
+  size_ = 0;
+  mapping_ = nullptr;
+}
+#else
+bool MappedFile::Open(const std::string& path) {
+  Close();
+  const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return false;
+  struct stat st{};
+  void* view = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && st.st_size > 0) {
+    view = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+  }
+  // The mapping keeps the file open.
+  ::close(fd);
+  if (view == MAP_FAILED) return false;
+  data_ = static_cast<const uint8_t*>(view);
+  size_ = static_cast<size_t>(st.st_size);
+  return true;
+}
+
+void MappedFile::Close() {
+  if (data_) munmap(const_cast<uint8_t*>(data_), size_);
+  data_ = nullptr;
+  size_ = 0;
+}
+#endif
+
+}  // namespace cachefile
+}  // namespace audioengine
@@ -0,0 +1,64 @@
+// Helpers shared by the on-disk caches (seek indexes, loudness results,
+// waveforms, audio features).
+// Internal to the library; not installed with the public headers.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace audioengine {
+namespace cachefile {
+
+// `hash` continues an earlier Fnv1a32() over data that preceded `data`.
+uint32_t Fnv1a32(const uint8_t* data, size_t size, uint32_t hash = 2166136261u);
+uint64_t Fnv1a64(uint64_t hash, const uint8_t* data, size_t size);
+
+void PutLe(std::vector<uint8_t>* out, uint64_t value, int bytes);
+uint64_t GetLe(const uint8_t* in, int bytes);
+void PutVarint(std::vector<uint8_t>* out, uint64_t value);
+bool GetVarint(const uint8_t** in, const uint8_t* end, uint64_t* value);
+
+// 16 hex digits of an FNV-1a 64 over path, size and mtime, + `extension`.
+std::string CacheFileName(const std::string& path, uint64_t fileSize,
+                          int64_t mtimeSeconds, const char* extension);
+
+// `dir` + separator + `name`; `dir` may or may not end in a separator.
+std::string JoinPath(const std::string& dir, const std::string& name);
+
+// Paths are UTF-8 everywhere; the Windows build widens them for the CRT.
+// Writes to `path` + ".tmp" and renames over `path`, so a concurrent reader
+// never sees a partial file.
+bool WriteAtomically(const std::string& path, const std::vector<uint8_t>& bytes);
+bool ReadAll(const std::string& path, std::vector<uint8_t>* bytes);
+
+// Read-only view of a whole file mapped into memory, for caches that are
+// read in place. Cache names change with the file's size and mtime, so a
+// mapped cache file is not normally rewritten; if it is, POSIX mappings keep
+// the old version and on Windows the replacing rename fails.
+class MappedFile {
+ public:
+  MappedFile() = default;
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  // False if the file is missing, empty or cannot be mapped.
+  bool Open(const std::string& path);
+  void Close();
+
+  const uint8_t* Data() const { return data_; }
+  size_t Size() const { return size_; }
+
+ private:
+  const uint8_t* data_ = nullptr;
+  size_t size_ = 0;
+#ifdef _WIN32
+  void* mapping_ = nullptr;
+#endif
+};
+
+}  // namespace cachefile
+}  // namespace audioengine
@@ -0,0 +1,513 @@
+#include "AudioEngineCore/ChannelMixer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+#include "AudioEngineCore/SampleKernels.h"
+#include "Simd.h"
+
+namespace audioengine {
+
+namespace {
+
+constexpr uint32_t kLanes = ChannelMixer::kMaxChannels;
+constexpr uint32_t kSpeakerBits = 64;
+constexpr float kMinus3Db = 0.70710678f;
+
+uint32_t BitIndex(uint64_t speaker) {
+  uint32_t index = 0;
+  while (!(speaker & 1)) {
+    speaker >>= 1;
+    ++index;
+  }
+  return index;
+}
+
+float GainFromDb(double db) { return static_cast<float>(std::pow(10.0, db / 20.0)); }
+
+// Where one input speaker ends up in an output layout. `gains` collects its
+// gain to each output speaker, by bit index. The output must have a front
+// pair or a centre (see Downmix()), which ends every chain of folds.
+struct Folding {
+  uint64_t out;
+  float center;
+  float surround;
+  float lfe;
+  bool mixLfe;
+  float gains[kSpeakerBits];
+
+  bool Has(uint64_t speaker) const { return (out & speaker) != 0; }
+
+  // Two surrounds folded into one keep the power of uncorrelated sources.
+  void Surround(uint64_t pairedWith, uint64_t front, float gain) {
+    if (Has(pairedWith)) {
+      Route(pairedWith, gain * kMinus3Db);
+    } else {
+      Route(front, gain * surround);
+    }
+  }
+
+  void Route(uint64_t speaker, float gain) {
+    using namespace speaker;
+    if (Has(speaker)) {
+      gains[BitIndex(speaker)] += gain;
+      return;
+    }
+    switch (speaker) {
+      case kFrontLeft:
+      case kFrontRight:
+        // Only a mono output lacks the front pair.
+        Route(kFrontCenter, gain * kMinus3Db);
+        break;
+      case kFrontCenter:
+        Route(kFrontLeft, gain * center);
+        Route(kFrontRight, gain * center);
+        break;
+      case kLowFrequency:
+        if (!mixLfe) break;
+        if (Has(kFrontCenter)) {
+          Route(kFrontCenter, gain * lfe);
+        } else {
+          Route(kFrontLeft, gain * lfe);
+          Route(kFrontRight, gain * lfe);
+        }
+        break;
+      case kBackLeft: Surround(kSideLeft, kFrontLeft, gain); break;
+      case kBackRight: Surround(kSideRight, kFrontRight, gain); break;
+      case kSideLeft: Surround(kBackLeft, kFrontLeft, gain); break;
+      case kSideRight: Surround(kBackRight, kFrontRight, gain); break;
+      case kBackCenter:
+        if (Has(kBackLeft) && Has(kBackRight)) {
+          Route(kBackLeft, gain * kMinus3Db);
+          Route(kBackRight, gain * kMinus3Db);
+        } else if (Has(kSideLeft) && Has(kSideRight)) {
+          Route(kSideLeft, gain * kMinus3Db);
+          Route(kSideRight, gain * kMinus3Db);
+        } else {
+          Route(kFrontLeft, gain * surround * kMinus3Db);
+          Route(kFrontRight, gain * surround * kMinus3Db);
+        }
+        break;
+      case kFrontLeftOfCenter: Route(kFrontLeft, gain); break;
+      case kFrontRightOfCenter: Route(kFrontRight, gain); break;
+      // Height channels fold onto the speaker below them.
+      case kTopCenter:
+      case kTopFrontCenter: Route(kFrontCenter, gain); break;
+      case kTopFrontLeft: Route(kFrontLeft, gain); break;
+      case kTopFrontRight: Route(kFrontRight, gain); break;
+      case kTopBackLeft: Route(kBackLeft, gain); break;
+      case kTopBackRight: Route(kBackRight, gain); break;
+      case kTopBackCenter: Route(kBackCenter, gain); break;
+      default:
+        break;
+    }
+  }
+};
+
+// Mixes `frames` frames; columns[i] holds input i's gain to each output
+// (see ChannelMixer::columns_, pairs_). Every kernel sums the inputs of an
+// output in order, one multiply and one add each, so they agree with the
+// scalar loop to the bit.
+using MixKernelFn = void (*)(const float* in, float* out, size_t frames,
+                             uint32_t inputs, uint32_t outputs,
+                             const float (*columns)[kLanes], const float (*pairs)[4]);
+
+void MixScalar(const float* in, float* out, size_t frames, uint32_t inputs,
+               uint32_t outputs, const float (*columns)[kLanes], const float (*)[4]) {
+  for (size_t f = 0; f < frames; ++f, in += inputs, out += outputs) {
+    for (uint32_t o = 0; o < outputs; ++o) {
+      float sum = 0.0f;
+      for (uint32_t i = 0; i < inputs; ++i) sum = sum + in[i] * columns[i][o];
+      out[o] = sum;
+    }
+  }
+}
+
+#if AUDIOENGINE_HAVE_SSE2
+// One or two outputs: frames f and f + 1 share a vector as [f0 f1 g0 g1],
+// each input spread over it with one shuffle of the two frames.
+void MixPairSse2(const float* in, float* out, size_t frames, uint32_t inputs,
+                 uint32_t outputs, const float (*columns)[kLanes],
+                 const float (*pairs)[4]) {
+  size_t f = 0;
+  for (; f + 2 <= frames; f += 2) {
+    const float* a = in + f * inputs;
+    const float* b = a + inputs;
+    __m128 sum = _mm_setzero_ps();
+    for (uint32_t c = 0; c < inputs; c += 4) {
+      const uint32_t n = std::min<uint32_t>(4, inputs - c);
+      const __m128 x = LoadLanes4(a + c, n);
+      const __m128 y = LoadLanes4(b + c, n);
+      sum = _mm_add_ps(sum, _mm_mul_ps(_mm_shuffle_ps(x, y, _MM_SHUFFLE(0, 0, 0, 0)),
+                                       _mm_load_ps(pairs[c])));
+      sum = _mm_add_ps(sum, _mm_mul_ps(_mm_shuffle_ps(x, y, _MM_SHUFFLE(1, 1, 1, 1)),
+                                       _mm_load_ps(pairs[c + 1])));
+      sum = _mm_add_ps(sum, _mm_mul_ps(_mm_shuffle_ps(x, y, _MM_SHUFFLE(2, 2, 2, 2)),
+                                       _mm_load_ps(pairs[c + 2])));
+      sum = _mm_add_ps(sum, _mm_mul_ps(_mm_shuffle_ps(x, y, _MM_SHUFFLE(3, 3, 3, 3)),
+                                       _mm_load_ps(pairs[c + 3])));
+    }
+    if (outputs == 2) {
+      _mm_storeu_ps(out + f * 2, sum);
+    } else {
+      _mm_store_ss(out + f, sum);
+      _mm_store_ss(out + f + 1, _mm_movehl_ps(sum, sum));
+    }
+  }
+  MixScalar(in + f * inputs, out + f * outputs, frames - f, inputs, outputs, columns,
+            pairs);
+}
+
+// Three to eight outputs, one frame per one or two vectors.
+void MixSse2(const float* in, float* out, size_t frames, uint32_t inputs,
+             uint32_t outputs, const float (*columns)[kLanes], const float (*)[4]) {
+  const bool wide = outputs > 4;
+  for (size_t f = 0; f < frames; ++f, in += inputs, out += outputs) {
+    __m128 lo = _mm_setzero_ps();
+    __m128 hi = _mm_setzero_ps();
+    for (uint32_t i = 0; i < inputs; ++i) {
+      const __m128 x = _mm_set1_ps(in[i]);
+      lo = _mm_add_ps(lo, _mm_mul_ps(x, _mm_load_ps(columns[i])));
+      if (wide) hi = _mm_add_ps(hi, _mm_mul_ps(x, _mm_load_ps(columns[i] + 4)));
+    }
+    if (wide) {
+      _mm_storeu_ps(out, lo);
+      StoreLanes4(out + 4, hi, outputs - 4);
+    } else {
+      StoreLanes4(out, lo, outputs);
+    }
+  }
+}
+#endif
+
+#if AUDIOENGINE_HAVE_AVX2
+// One or two outputs, four frames per vector: [f0 f1 g0 g1 | h0 h1 k0 k1].
+AUDIOENGINE_TARGET_AVX2
+void MixPairAvx2(const float* in, float* out, size_t frames, uint32_t inputs,
+                 uint32_t outputs, const float (*columns)[kLanes],
+                 const float (*pairs)[4]) {
+  size_t f = 0;
+  for (; f + 4 <= frames; f += 4) {
+    const float* p0 = in + f * inputs;
+    const float* p1 = p0 + inputs;
+    const float* p2 = p1 + inputs;
+    const float* p3 = p2 + inputs;
+    __m256 sum = _mm256_setzero_ps();
+    for (uint32_t c = 0; c < inputs; c += 4) {
+      const uint32_t n = std::min<uint32_t>(4, inputs - c);
+      const __m256 x = _mm256_insertf128_ps(
+          _mm256_castps128_ps256(LoadLanes4(p0 + c, n)), LoadLanes4(p2 + c, n), 1);
+      const __m256 y = _mm256_insertf128_ps(
+          _mm256_castps128_ps256(LoadLanes4(p1 + c, n)), LoadLanes4(p3 + c, n), 1);
+      sum = _mm256_add_ps(
+          sum, _mm256_mul_ps(_mm256_shuffle_ps(x, y, _MM_SHUFFLE(0, 0, 0, 0)),
+                             _mm256_broadcast_ps(reinterpret_cast<const __m128*>(pairs[c]))));
+      sum = _mm256_add_ps(
+          sum, _mm256_mul_ps(_mm256_shuffle_ps(x, y, _MM_SHUFFLE(1, 1, 1, 1)),
+                             _mm256_broadcast_ps(reinterpret_cast<const __m128*>(pairs[c + 1]))));
+      sum = _mm256_add_ps(
+          sum, _mm256_mul_ps(_mm256_shuffle_ps(x, y, _MM_SHUFFLE(2, 2, 2, 2)),
+                             _mm256_broadcast_ps(reinterpret_cast<const __m128*>(pairs[c + 2]))));
+      sum = _mm256_add_ps(
+          sum, _mm256_mul_ps(_mm256_shuffle_ps(x, y, _MM_SHUFFLE(3, 3, 3, 3)),
+                             _mm256_broadcast_ps(reinterpret_cast<const __m128*>(pairs[c + 3]))));
+    }
+    if (outputs == 2) {
+      _mm256_storeu_ps(out + f * 2, sum);
+    } else {
+      const __m128 lo = _mm256_castps256_ps128(sum);
+      const __m128 hi = _mm256_extractf128_ps(sum, 1);
+      _mm_store_ss(out + f, lo);
+      _mm_store_ss(out + f + 1, _mm_movehl_ps(lo, lo));
+      _mm_store_ss(out + f + 2, hi);
+      _mm_store_ss(out + f + 3, _mm_movehl_ps(hi, hi));
+    }
+  }
+  MixScalar(in + f * inputs, out + f * outputs, frames - f, inputs, outputs, columns,
+            pairs);
+}
+
+// Three or four outputs, two frames per vector, one in each half.
+AUDIOENGINE_TARGET_AVX2
+void MixQuadAvx2(const float* in, float* out, size_t frames, uint32_t inputs,
+                 uint32_t outputs, const float (*columns)[kLanes],
+                 const float (*pairs)[4]) {
+  size_t f = 0;
+  for (; f + 2 <= frames; f += 2) {
+    const float* a = in + f * inputs;
+    const float* b = a + inputs;
+    __m256 sum = _mm256_setzero_ps();
+    for (uint32_t c = 0; c < inputs; c += 4) {
+      const uint32_t n = std::min<uint32_t>(4, inputs - c);
+      const __m256 x = _mm256_insertf128_ps(
+          _mm256_castps128_ps256(LoadLanes4(a + c, n)), LoadLanes4(b + c, n), 1);
+      sum = _mm256_add_ps(
+          sum, _mm256_mul_ps(_mm256_shuffle_ps(x, x, _MM_SHUFFLE(0, 0, 0, 0)),
+                             _mm256_broadcast_ps(reinterpret_cast<const __m128*>(columns[c]))));
+      sum = _mm256_add_ps(
+          sum, _mm256_mul_ps(_mm256_shuffle_ps(x, x, _MM_SHUFFLE(1, 1, 1, 1)),
+                             _mm256_broadcast_ps(reinterpret_cast<const __m128*>(columns[c + 1]))));
+      sum = _mm256_add_ps(
+          sum, _mm256_mul_ps(_mm256_shuffle_ps(x, x, _MM_SHUFFLE(2, 2, 2, 2)),
+                             _mm256_broadcast_ps(reinterpret_cast<const __m128*>(columns[c + 2]))));
+      sum = _mm256_add_ps(
+          sum, _mm256_mul_ps(_mm256_shuffle_ps(x, x, _MM_SHUFFLE(3, 3, 3, 3)),
+                             _mm256_broadcast_ps(reinterpret_cast<const __m128*>(columns[c + 3]))));
+    }
+    StoreLanes4(out + f * outputs, _mm256_castps256_ps128(sum), outputs);
+    StoreLanes4(out + (f + 1) * outputs, _mm256_extractf128_ps(sum, 1), outputs);
+  }
+  MixScalar(in + f * inputs, out + f * outputs, frames - f, inputs, outputs, columns,
+            pairs);
+}
+
+// Five to eight outputs, one frame per vector.
+AUDIOENGINE_TARGET_AVX2
+void MixAvx2(const float* in, float* out, size_t frames, uint32_t inputs,
+             uint32_t outputs, const float (*columns)[kLanes], const float (*)[4]) {
+  const uint32_t upper = outputs - 4;
+  for (size_t f = 0; f < frames; ++f, in += inputs, out += outputs) {
+    __m256 sum = _mm256_setzero_ps();
+    for (uint32_t i = 0; i < inputs; ++i) {
+      sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_broadcast_ss(in + i),
+                                             _mm256_load_ps(columns[i])));
+    }
+    if (outputs == kLanes) {
+      _mm256_storeu_ps(out, sum);
+    } else {
+      _mm_storeu_ps(out, _mm256_castps256_ps128(sum));
+      StoreLanes4(out + 4, _mm256_extractf128_ps(sum, 1), upper);
+    }
+  }
+}
+#endif
+
+#if AUDIOENGINE_HAVE_NEON64
+void MixPairNeon(const float* in, float* out, size_t frames, uint32_t inputs,
+                 uint32_t outputs, const float (*columns)[kLanes],
+                 const float (*pairs)[4]) {
+  size_t f = 0;
+  for (; f + 2 <= frames; f += 2) {
+    const float* a = in + f * inputs;
+    const float* b = a + inputs;
+    float32x4_t sum = vdupq_n_f32(0.0f);
+    for (uint32_t c = 0; c < inputs; c += 4) {
+      const uint32_t n = std::min<uint32_t>(4, inputs - c);
+      const float32x4_t x = LoadLanes4(a + c, n);
+      const float32x4_t y = LoadLanes4(b + c, n);
+      sum = vaddq_f32(sum, vmulq_f32(vcombine_f32(vdup_laneq_f32(x, 0), vdup_laneq_f32(y, 0)),
+                                     vld1q_f32(pairs[c])));
+      sum = vaddq_f32(sum, vmulq_f32(vcombine_f32(vdup_laneq_f32(x, 1), vdup_laneq_f32(y, 1)),
+                                     vld1q_f32(pairs[c + 1])));
+      sum = vaddq_f32(sum, vmulq_f32(vcombine_f32(vdup_laneq_f32(x, 2), vdup_laneq_f32(y, 2)),
+                                     vld1q_f32(pairs[c + 2])));
+      sum = vaddq_f32(sum, vmulq_f32(vcombine_f32(vdup_laneq_f32(x, 3), vdup_laneq_f32(y, 3)),
+                                     vld1q_f32(pairs[c + 3])));
+    }
+    if (outputs == 2) {
+      vst1q_f32(out + f * 2, sum);
+    } else {
+      out[f] = vgetq_lane_f32(sum, 0);
+      out[f + 1] = vgetq_lane_f32(sum, 2);
+    }
+  }
+  MixScalar(in + f * inputs, out + f * outputs, frames - f, inputs, outputs, columns,
+            pairs);
+}
+
+void MixNeon(const float* in, float* out, size_t frames, uint32_t inputs,
+             uint32_t outputs, const float (*columns)[kLanes], const float (*)[4]) {
+  const bool wide = outputs > 4;
+  for (size_t f = 0; f < frames; ++f, in += inputs, out += outputs) {
+    float32x4_t lo = vdupq_n_f32(0.0f);
+    float32x4_t hi = vdupq_n_f32(0.0f);
+    for (uint32_t i = 0; i < inputs; ++i) {
+      lo = vaddq_f32(lo, vmulq_n_f32(vld1q_f32(columns[i]), in[i]));
+      if (wide) hi = vaddq_f32(hi, vmulq_n_f32(vld1q_f32(columns[i] + 4), in[i]));
+    }
+    if (wide) {
+      vst1q_f32(out, lo);
+      StoreLanes4(out + 4, hi, outputs - 4);
+    } else {
+      StoreLanes4(out, lo, outputs);
+    }
+  }
+}
+#endif
+
+MixKernelFn SelectKernel(KernelIsa isa, uint32_t outputs) {
+  switch (isa) {
+#if AUDIOENGINE_HAVE_AVX2
+    case KernelIsa::kAvx2:
+      return outputs <= 2 ? MixPairAvx2 : outputs <= 4 ? MixQuadAvx2 : MixAvx2;
+#endif
+#if AUDIOENGINE_HAVE_SSE2
+    case KernelIsa::kSse2: return outputs <= 2 ? MixPairSse2 : MixSse2;
+#endif
+#if AUDIOENGINE_HAVE_NEON64
+    case KernelIsa::kNeon: return outputs <= 2 ? MixPairNeon : MixNeon;
+#endif
+    default:
+      (void)outputs;
+      return MixScalar;
+  }
+}
+
+}  // namespace
+
+uint32_t LayoutChannels(uint64_t layout) {
+  uint32_t count = 0;
+  for (; layout != 0; layout &= layout - 1) ++count;
+  return count;
+}
+
+uint64_t DefaultLayout(uint32_t channels) {
+  using namespace speaker;
+  switch (channels) {
+    case 1: return kLayoutMono;
+    case 2: return kLayoutStereo;
+    case 3: return kLayoutStereo | kFrontCenter;
+    case 4: return kLayoutQuad;
+    case 5: return kLayoutQuad | kFrontCenter;
+    case 6: return kLayout5Point1;
+    case 7:
+      return kLayoutStereo | kFrontCenter | kLowFrequency | kBackCenter | kSideLeft |
+             kSideRight;
+    case 8: return kLayout7Point1;
+    default: return 0;
+  }
+}
+
+uint64_t ResolveLayout(uint64_t layout, uint32_t channels) {
+  return LayoutChannels(layout) == channels ? layout : DefaultLayout(channels);
+}
+
+std::string LayoutName(uint64_t layout) {
+  using namespace speaker;
+  switch (layout) {
+    case kLayoutMono: return "mono";
+    case kLayoutStereo: return "stereo";
+    case kLayoutStereo | kLowFrequency: return "2.1";
+    case kLayoutStereo | kFrontCenter: return "3.0";
+    case kLayoutQuad: return "quad";
+    case kLayoutQuad | kFrontCenter: return "5.0";
+    case kLayout5Point1: return "5.1";
+    case kLayout5Point1Side: return "5.1(side)";
+    case kLayoutStereo | kFrontCenter | kLowFrequency | kBackCenter | kSideLeft | kSideRight:
+      return "6.1";
+    case kLayout7Point1: return "7.1";
+    default: return std::to_string(LayoutChannels(layout)) + "-ch";
+  }
+}
+
+ChannelMatrix::ChannelMatrix(uint32_t inputs, uint32_t outputs,
+                             std::vector<float> coefficients) {
+  if (inputs == 0 || outputs == 0 || inputs > kMaxChannels || outputs > kMaxChannels ||
+      coefficients.size() != size_t{inputs} * outputs) {
+    return;
+  }
+  inputs_ = inputs;
+  outputs_ = outputs;
+  coefficients_ = std::move(coefficients);
+}
+
+ChannelMatrix ChannelMatrix::Downmix(uint64_t inLayout, uint64_t outLayout,
+                                     const DownmixOptions& options) {
+  using namespace speaker;
+  const uint32_t inputs = LayoutChannels(inLayout);
+  const uint32_t outputs = LayoutChannels(outLayout);
+  const bool hasFront = (outLayout & kLayoutStereo) == kLayoutStereo ||
+                        (outLayout & kFrontCenter) != 0;
+  if (inputs == 0 || outputs == 0 || inputs > kMaxChannels || outputs > kMaxChannels ||
+      !hasFront) {
+    return ChannelMatrix();
+  }
+
+  Folding folding{outLayout, GainFromDb(options.centerDb), GainFromDb(options.surroundDb),
+                  GainFromDb(options.lfeDb), options.lfe == LfeMode::kMix, {}};
+  std::vector<float> coefficients(size_t{inputs} * outputs, 0.0f);
+  uint32_t input = 0;
+  for (uint64_t rest = inLayout; rest != 0; rest &= rest - 1, ++input) {
+    std::fill(std::begin(folding.gains), std::end(folding.gains), 0.0f);
+    folding.Route(rest & (~rest + 1), 1.0f);
+    uint32_t output = 0;
+    for (uint64_t target = outLayout; target != 0; target &= target - 1, ++output) {
+      coefficients[output * inputs + input] = folding.gains[BitIndex(target & (~target + 1))];
+    }
+  }
+
+  if (options.normalize) {
+    float loudest = 0.0f;
+    for (uint32_t o = 0; o < outputs; ++o) {
+      float row = 0.0f;
+      for (uint32_t i = 0; i < inputs; ++i) row += std::fabs(coefficients[o * inputs + i]);
+      loudest = std::max(loudest, row);
+    }
+    if (loudest > 1.0f) {
+      for (float& c : coefficients) c /= loudest;
+    }
+  }
+  return ChannelMatrix(inputs, outputs, std::move(coefficients));
+}
+
+bool ChannelMatrix::IsIdentity() const {
+  if (Empty() || inputs_ != outputs_) return false;
+  for (uint32_t o = 0; o < outputs_; ++o) {
+    for (uint32_t i = 0; i < inputs_; ++i) {
+      if (At(o, i) != (o == i ? 1.0f : 0.0f)) return false;
+    }
+  }
+  return true;
+}
+
+bool ChannelMixer::Configure(const ChannelMatrix& matrix) {
+  inputs_ = 0;
+  outputs_ = 0;
+  for (auto& column : columns_) std::fill(std::begin(column), std::end(column), 0.0f);
+  for (auto& pair : pairs_) std::fill(std::begin(pair), std::end(pair), 0.0f);
+  if (matrix.Empty()) return false;
+  for (uint32_t i = 0; i < matrix.Inputs(); ++i) {
+    for (uint32_t o = 0; o < matrix.Outputs(); ++o) columns_[i][o] = matrix.At(o, i);
+    pairs_[i][0] = pairs_[i][2] = columns_[i][0];
+    pairs_[i][1] = pairs_[i][3] = columns_[i][1];
+  }
+  inputs_ = matrix.Inputs();
+  outputs_ = matrix.Outputs();
+  return true;
+}
+
+void ChannelMixer::Process(const float* in, float* out, size_t frames) const {
+  if (!IsConfigured() || frames == 0) return;
+  SelectKernel(ActiveKernelIsa(), outputs_)(in, out, frames, inputs_, outputs_, columns_,
+                                            pairs_);
+}
+
+ChannelMixingSource::ChannelMixingSource(std::unique_ptr<PcmSource> inner,
+                                         const ChannelMatrix& matrix)
+    : inner_(std::move(inner)), format_(inner_->Format()) {
+  if (!CanMix(format_, matrix) || !mixer_.Configure(matrix)) return;
+  format_.channels = matrix.Outputs();
+  input_.resize(kBlockFrames * matrix.Inputs());
+}
+
+bool ChannelMixingSource::CanMix(const PcmFormat& format, const ChannelMatrix& matrix) {
+  return format.isFloat && format.bitsPerSample == 32 && !matrix.Empty() &&
+         format.channels == matrix.Inputs();
+}
+
+size_t ChannelMixingSource::ReadFrames(uint8_t* dst, size_t maxFrames) {
+  if (!mixer_.IsConfigured()) return inner_->ReadFrames(dst, maxFrames);
+  auto* out = reinterpret_cast<float*>(dst);
+  size_t written = 0;
+  while (written < maxFrames) {
+    const size_t n = inner_->ReadFrames(reinterpret_cast<uint8_t*>(input_.data()),
+                                        std::min(kBlockFrames, maxFrames - written));
+    if (n == 0) break;
+    mixer_.Process(input_.data(), out + written * format_.channels, n);
+    written += n;
+  }
+  return written;
+}
+
+}  // namespace audioengine
@@ -0,0 +1,574 @@
+#include "AudioEngineCore/Convolver.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <utility>
+
+#include "AudioEngineCore/Resampler.h"
+#include "AudioEngineCore/SampleKernels.h"
+#include "Simd.h"
+
+namespace audioengine {
+
+namespace {
+
+// Largest tail partition considered.
+constexpr uint32_t kMaxTailFrames = 1u << 16;
+
+// Rough cost of a forward plus inverse real FFT of `size` points, in units
+// of one complex multiply-accumulate.
+double FftPairCost(double size) { return 0.5 * size * std::log2(size); }
+
+// Picks T for a filter of `taps` taps and blocks of `block` frames; 0 means
+// head only. Minimises the per-frame cost of both stages together.
+uint32_t PickTailFrames(size_t taps, uint32_t block) {
+  const auto headCost = [block](size_t headTaps) {
+    const double partitions = std::ceil(static_cast<double>(headTaps) / block);
+    return partitions * (block + 1) / block + FftPairCost(2.0 * block) / block;
+  };
+  uint32_t best = 0;
+  double bestCost = headCost(taps);
+  for (uint32_t tail = 2 * block; tail <= kMaxTailFrames && 2 * size_t{tail} < taps;
+       tail *= 2) {
+    const double partitions =
+        std::ceil(static_cast<double>(taps - 2 * size_t{tail}) / tail);
+    const double cost = headCost(2 * size_t{tail}) +
+                        partitions * (tail + 1) / tail +
+                        FftPairCost(2.0 * tail) / tail;
+    if (cost < bestCost) {
+      bestCost = cost;
+      best = tail;
+    }
+  }
+  return best;
+}
+
+// Transforms `count` taps of `taps` from `offset`, zero padded to 2 * frames,
+// into one split-complex partition at `dst`, scaled for the unscaled inverse.
+void TransformPartition(const std::vector<float>& taps, size_t offset,
+                        uint32_t frames, RealFft& fft, std::vector<float>& scratch,
+                        float* dst) {
+  std::fill(scratch.begin(), scratch.end(), 0.0f);
+  if (offset < taps.size()) {
+    const size_t count = std::min<size_t>(frames, taps.size() - offset);
+    std::copy(taps.begin() + offset, taps.begin() + offset + count, scratch.begin());
+  }
+  const size_t bins = fft.Bins();
+  fft.Forward(scratch.data(), dst, dst + bins);
+  const float scale = 1.0f / static_cast<float>(fft.Size());
+  for (size_t i = 0; i < 2 * bins; ++i) dst[i] *= scale;
+}
+
+// acc += x * h over `bins` split-complex values.
+using MacFn = void (*)(const float* x, const float* h, float* acc, size_t bins);
+
+void MacScalar(const float* x, const float* h, float* acc, size_t bins) {
+  const float* xi = x + bins;
+  const float* hi = h + bins;
+  float* ai = acc + bins;
+  for (size_t k = 0; k < bins; ++k) {
+    acc[k] += x[k] * h[k] - xi[k] * hi[k];
+    ai[k] += x[k] * hi[k] + xi[k] * h[k];
+  }
+}
+
+#if AUDIOENGINE_HAVE_SSE2
+void MacSse2(const float* x, const float* h, float* acc, size_t bins) {
+  const float* xi = x + bins;
+  const float* hi = h + bins;
+  float* ai = acc + bins;
+  size_t k = 0;
+  for (; k + 4 <= bins; k += 4) {
+    const __m128 xr4 = _mm_loadu_ps(x + k);
+    const __m128 xi4 = _mm_loadu_ps(xi + k);
+    const __m128 hr4 = _mm_loadu_ps(h + k);
+    const __m128 hi4 = _mm_loadu_ps(hi + k);
+    _mm_storeu_ps(acc + k, _mm_add_ps(_mm_loadu_ps(acc + k),
+                                      _mm_sub_ps(_mm_mul_ps(xr4, hr4),
+                                                 _mm_mul_ps(xi4, hi4))));
+    _mm_storeu_ps(ai + k, _mm_add_ps(_mm_loadu_ps(ai + k),
+                                     _mm_add_ps(_mm_mul_ps(xr4, hi4),
+                                                _mm_mul_ps(xi4, hr4))));
+  }
+  for (; k < bins; ++k) {
+    acc[k] += x[k] * h[k] - xi[k] * hi[k];
+    ai[k] += x[k] * hi[k] + xi[k] * h[k];
+  }
+}
+#endif
+
+#if AUDIOENGINE_HAVE_AVX2
+AUDIOENGINE_TARGET_AVX2
+void MacAvx2(const float* x, const float* h, float* acc, size_t bins) {
+  const float* xi = x + bins;
+  const float* hi = h + bins;
+  float* ai = acc + bins;
+  size_t k = 0;
+  for (; k + 8 <= bins; k += 8) {
+    const __m256 xr8 = _mm256_loadu_ps(x + k);
+    const __m256 xi8 = _mm256_loadu_ps(xi + k);
+    const __m256 hr8 = _mm256_loadu_ps(h + k);
+    const __m256 hi8 = _mm256_loadu_ps(hi + k);
+    _mm256_storeu_ps(acc + k, _mm256_add_ps(_mm256_loadu_ps(acc + k),
+                                            _mm256_sub_ps(_mm256_mul_ps(xr8, hr8),
+                                                          _mm256_mul_ps(xi8, hi8))));
+    _mm256_storeu_ps(ai + k, _mm256_add_ps(_mm256_loadu_ps(ai + k),
+                                           _mm256_add_ps(_mm256_mul_ps(xr8, hi8),
+                                                         _mm256_mul_ps(xi8, hr8))));
+  }
+  for (; k < bins; ++k) {
+    acc[k] += x[k] * h[k] - xi[k] * hi[k];
+    ai[k] += x[k] * hi[k] + xi[k] * h[k];
+  }
+}
+#endif
+
+#if AUDIOENGINE_HAVE_NEON64
+void MacNeon(const float* x, const float* h, float* acc, size_t bins) {
+  const float* xi = x + bins;
+  const float* hi = h + bins;
+  float* ai = acc + bins;
+  size_t k = 0;
+  for (; k + 4 <= bins; k += 4) {
+    const float32x4_t xr4 = vld1q_f32(x + k);
+    const float32x4_t xi4 = vld1q_f32(xi + k);
+    const float32x4_t hr4 = vld1q_f32(h + k);
+    const float32x4_t hi4 = vld1q_f32(hi + k);
+    vst1q_f32(acc + k, vfmsq_f32(vfmaq_f32(vld1q_f32(acc + k), xr4, hr4), xi4, hi4));
+    vst1q_f32(ai + k, vfmaq_f32(vfmaq_f32(vld1q_f32(ai + k), xr4, hi4), xi4, hr4));
+  }
+  for (; k < bins; ++k) {
+    acc[k] += x[k] * h[k] - xi[k] * hi[k];
+    ai[k] += x[k] * hi[k] + xi[k] * h[k];
+  }
+}
+#endif
+
+MacFn SelectMac(KernelIsa isa) {
+  switch (isa) {
+#if AUDIOENGINE_HAVE_AVX2
+    case KernelIsa::kAvx2: return MacAvx2;
+#endif
+#if AUDIOENGINE_HAVE_SSE2
+    case KernelIsa::kSse2: return MacSse2;
+#endif
+#if AUDIOENGINE_HAVE_NEON64
+    case KernelIsa::kNeon: return MacNeon;
+#endif
+    default: return MacScalar;
+  }
+}
+
+uint64_t NanosSince(std::chrono::steady_clock::time_point start) {
+  return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                   std::chrono::steady_clock::now() - start)
+                                   .count());
+}
+
+}  // namespace
+
+size_t FirFilter::Taps() const {
+  size_t taps = 0;
+  for (const auto& channel : channels) taps = std::max(taps, channel.size());
+  return taps;
+}
+
+bool ReadFirFilter(PcmSource& source, FirFilter* filter) {
+  const PcmFormat format = source.Format();
+  if (!format.isFloat || format.bitsPerSample != 32 || format.channels == 0) {
+    return false;
+  }
+  std::vector<float> interleaved;
+  std::vector<float> buffer(4096 * size_t{format.channels});
+  while (const size_t frames =
+             source.ReadFrames(reinterpret_cast<uint8_t*>(buffer.data()), 4096)) {
+    interleaved.insert(interleaved.end(), buffer.begin(),
+                       buffer.begin() + frames * format.channels);
+    if (interleaved.size() > kMaxFirTaps * format.channels) return false;
+  }
+  const size_t taps = interleaved.size() / format.channels;
+  if (taps == 0) return false;
+  filter->sampleRate = format.sampleRate;
+  filter->channels.assign(format.channels, std::vector<float>(taps));
+  for (uint32_t ch = 0; ch < format.channels; ++ch) {
+    for (size_t i = 0; i < taps; ++i) {
+      filter->channels[ch][i] = interleaved[i * format.channels + ch];
+    }
+  }
+  return true;
+}
+
+FirFilter ResampleFir(const FirFilter& filter, uint32_t sampleRate) {
+  if (filter.sampleRate == 0 || filter.sampleRate == sampleRate) return filter;
+  FirFilter result;
+  PolyphaseResampler resampler;
+  if (!resampler.Configure(filter.sampleRate, sampleRate, 1, ResamplerQuality::kHigh)) {
+    return result;
+  }
+  result.sampleRate = sampleRate;
+  const uint64_t in = resampler.InputStep();
+  const uint64_t out = resampler.OutputStep();
+  // Sample values scale with the sample period for the same response.
+  const float scale = static_cast<float>(filter.sampleRate) / sampleRate;
+  for (const auto& taps : filter.channels) {
+    const size_t frames = static_cast<size_t>((taps.size() * out + in - 1) / in);
+    // Zeros after the response flush the converter's look-ahead.
+    std::vector<float> padded(taps);
+    padded.resize(taps.size() + resampler.TapsPerPhase(), 0.0f);
+    std::vector<float> converted(frames + (out + in - 1) / in + 1);
+    resampler.Reset();
+    size_t used = 0;
+    size_t written = 0;
+    while (used < padded.size() && written < frames) {
+      size_t consumed = 0;
+      written += resampler.Process(padded.data() + used, padded.size() - used,
+                                   converted.data() + written,
+                                   converted.size() - written, &consumed);
+      used += consumed;
+    }
+    converted.resize(frames);
+    for (float& tap : converted) tap *= scale;
+    result.channels.push_back(std::move(converted));
+  }
+  return result;
+}
+
+std::shared_ptr<const ConvolutionFilter> ConvolutionFilter::Create(
+    std::shared_ptr<const FirFilter> fir, uint32_t sampleRate, uint32_t blockFrames) {
+  if (!fir || sampleRate == 0 || blockFrames < 4 ||
+      (blockFrames & (blockFrames - 1)) != 0) {
+    return nullptr;
+  }
+  const FirFilter taps = ResampleFir(*fir, sampleRate);
+  if (taps.channels.empty() || taps.Taps() == 0) return nullptr;
+
+  std::shared_ptr<ConvolutionFilter> filter(new ConvolutionFilter());
+  filter->fir_ = std::move(fir);
+  filter->sampleRate_ = sampleRate;
+  filter->taps_ = taps.Taps();
+  filter->blockFrames_ = blockFrames;
+  filter->tailFrames_ = PickTailFrames(filter->taps_, blockFrames);
+  const size_t headTaps =
+      filter->tailFrames_ == 0 ? filter->taps_ : 2 * size_t{filter->tailFrames_};
+  filter->headPartitions_ = static_cast<uint32_t>((headTaps + blockFrames - 1) / blockFrames);
+  if (filter->tailFrames_ != 0) {
+    const size_t tailTaps = filter->taps_ - headTaps;
+    filter->tailPartitions_ = static_cast<uint32_t>(
+        (tailTaps + filter->tailFrames_ - 1) / filter->tailFrames_);
+  }
+
+  RealFft headFft(2 * size_t{blockFrames});
+  std::vector<float> headScratch(headFft.Size());
+  const size_t headStride = 2 * headFft.Bins();
+  RealFft tailFft;
+  std::vector<float> tailScratch;
+  if (filter->tailFrames_ != 0) {
+    tailFft.Configure(2 * size_t{filter->tailFrames_});
+    tailScratch.resize(tailFft.Size());
+  }
+  const size_t tailStride = 2 * tailFft.Bins();
+  for (const auto& channel : taps.channels) {
+    std::vector<float> head(filter->headPartitions_ * headStride);
+    for (uint32_t p = 0; p < filter->headPartitions_; ++p) {
+      TransformPartition(channel, size_t{p} * blockFrames, blockFrames, headFft,
+                         headScratch, head.data() + p * headStride);
+    }
+    filter->head_.push_back(std::move(head));
+    std::vector<float> tail(filter->tailPartitions_ * tailStride);
+    for (uint32_t p = 0; p < filter->tailPartitions_; ++p) {
+      TransformPartition(channel, headTaps + size_t{p} * filter->tailFrames_,
+                         filter->tailFrames_, tailFft, tailScratch,
+                         tail.data() + p * tailStride);
+    }
+    filter->tail_.push_back(std::move(tail));
+  }
+  return filter;
+}
+
+bool ConvolutionFilter::Supports(uint32_t channels) const {
+  return channels != 0 && (Channels() == 1 || Channels() == channels);
+}
+
+PartitionedConvolver::~PartitionedConvolver() { StopWorker(); }
+
+bool PartitionedConvolver::Configure(std::shared_ptr<const ConvolutionFilter> filter,
+                                     uint32_t channels) {
+  StopWorker();
+  filter_.reset();
+  if (!filter || !filter->Supports(channels)) return false;
+  channels_ = channels;
+  const uint32_t block = filter->BlockFrames();
+  headFft_.Configure(2 * size_t{block});
+  const size_t headStride = 2 * headFft_.Bins();
+  head_.assign(channels, Stage());
+  for (Stage& stage : head_) {
+    stage.window.assign(2 * size_t{block}, 0.0f);
+    stage.delayLine.assign(filter->HeadPartitions() * headStride, 0.0f);
+  }
+  headAccumulator_.assign(headStride, 0.0f);
+  headScratch_.assign(headFft_.Size(), 0.0f);
+  planar_.assign(size_t{channels} * block, 0.0f);
+  planarOut_.assign(size_t{channels} * block, 0.0f);
+  planes_.assign(channels, nullptr);
+
+  const uint32_t tailFrames = filter->TailPartitionFrames();
+  tail_.clear();
+  if (tailFrames != 0) {
+    tailFft_.Configure(2 * size_t{tailFrames});
+    const size_t tailStride = 2 * tailFft_.Bins();
+    tail_.assign(channels, Stage());
+    for (Stage& stage : tail_) {
+      stage.window.assign(2 * size_t{tailFrames}, 0.0f);
+      stage.delayLine.assign(filter->TailPartitions() * tailStride, 0.0f);
+    }
+    tailAccumulator_.assign(tailStride, 0.0f);
+    tailScratch_.assign(tailFft_.Size(), 0.0f);
+    for (int slot = 0; slot < 2; ++slot) {
+      tailIn_[slot].assign(size_t{channels} * tailFrames, 0.0f);
+      tailOut_[slot].assign(size_t{channels} * tailFrames, 0.0f);
+    }
+  }
+  filter_ = std::move(filter);
+  position_ = 0;
+  submitted_ = 0;
+  completed_ = 0;
+  framesProcessed_.store(0);
+  headNanos_.store(0);
+  tailNanos_.store(0);
+  tailWaits_.store(0);
+  if (tailFrames != 0) {
+    stopWorker_ = false;
+    worker_ = std::thread([this] { WorkerLoop(); });
+  }
+  return true;
+}
+
+void PartitionedConvolver::StopWorker() {
+  if (!worker_.joinable()) return;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopWorker_ = true;
+  }
+  workCv_.notify_all();
+  worker_.join();
+}
+
+void PartitionedConvolver::RunStage(Stage& stage, const float* spectra,
+                                    uint32_t partitions, uint32_t frames,
+                                    RealFft& fft, const float* block, float* out,
+                                    std::vector<float>& accumulator,
+                                    std::vector<float>& scratch) {
+  // Overlap-save: the previous block followed by this one.
+  std::memmove(stage.window.data(), stage.window.data() + frames,
+               frames * sizeof(float));
+  std::memcpy(stage.window.data() + frames, block, frames * sizeof(float));
+
+  const size_t bins = fft.Bins();
+  const size_t stride = 2 * bins;
+  stage.newest = stage.newest == 0 ? partitions - 1 : stage.newest - 1;
+  float* newest = stage.delayLine.data() + stage.newest * stride;
+  fft.Forward(stage.window.data(), newest, newest + bins);
+
+  // Partition p of the filter meets the input from p blocks ago.
+  const MacFn mac = SelectMac(ActiveKernelIsa());
+  std::fill(accumulator.begin(), accumulator.end(), 0.0f);
+  uint32_t slot = stage.newest;
+  for (uint32_t p = 0; p < partitions; ++p) {
+    mac(stage.delayLine.data() + slot * stride, spectra + p * stride,
+        accumulator.data(), bins);
+    slot = slot + 1 == partitions ? 0 : slot + 1;
+  }
+  fft.Inverse(accumulator.data(), accumulator.data() + bins, scratch.data());
+  std::memcpy(out, scratch.data() + frames, frames * sizeof(float));
+}
+
+void PartitionedConvolver::WorkerLoop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    workCv_.wait(lock, [this] { return stopWorker_ || completed_ < submitted_; });
+    if (stopWorker_) return;
+    const uint64_t job = completed_;
+    lock.unlock();
+
+    const auto start = std::chrono::steady_clock::now();
+    const uint32_t frames = filter_->TailPartitionFrames();
+    const uint32_t partitions = filter_->TailPartitions();
+    const std::vector<float>& in = tailIn_[job % 2];
+    std::vector<float>& out = tailOut_[job % 2];
+    for (uint32_t ch = 0; ch < channels_; ++ch) {
+      const uint32_t fc = filter_->Channels() == 1 ? 0 : ch;
+      RunStage(tail_[ch], filter_->tail_[fc].data(), partitions, frames, tailFft_,
+               in.data() + size_t{ch} * frames, out.data() + size_t{ch} * frames,
+               tailAccumulator_, tailScratch_);
+    }
+    tailNanos_.fetch_add(NanosSince(start), std::memory_order_relaxed);
+
+    lock.lock();
+    ++completed_;
+    doneCv_.notify_all();
+  }
+}
+
+void PartitionedConvolver::Process(const float* in, float* out) {
+  if (!filter_) return;
+  const auto start = std::chrono::steady_clock::now();
+  const uint32_t block = filter_->BlockFrames();
+  const uint32_t tailFrames = filter_->TailPartitionFrames();
+
+  float** planes = planes_.data();
+  for (uint32_t ch = 0; ch < channels_; ++ch) planes[ch] = planar_.data() + size_t{ch} * block;
+  DeinterleaveSamples(SampleType::kF32, in, channels_, block,
+                      reinterpret_cast<void* const*>(planes));
+
+  uint64_t tailBlock = 0;
+  size_t tailOffset = 0;
+  uint64_t waited = 0;
+  if (tailFrames != 0) {
+    tailBlock = position_ / tailFrames;
+    tailOffset = static_cast<size_t>(position_ % tailFrames);
+    if (tailOffset == 0 && tailBlock > 0) {
+      std::unique_lock<std::mutex> lock(mutex_);
+      // The previous tail block is complete: hand it over.
+      submitted_ = tailBlock;
+      workCv_.notify_one();
+      // Its slot's previous occupant, and the output about to be added in,
+      // are the block before that.
+      if (tailBlock >= 2 && completed_ < tailBlock - 1) {
+        tailWaits_.fetch_add(1, std::memory_order_relaxed);
+        const auto waitStart = std::chrono::steady_clock::now();
+        doneCv_.wait(lock, [this, tailBlock] { return completed_ >= tailBlock - 1; });
+        waited = NanosSince(waitStart);
+      }
+    }
+    float* collect = tailIn_[tailBlock % 2].data();
+    for (uint32_t ch = 0; ch < channels_; ++ch) {
+      std::memcpy(collect + size_t{ch} * tailFrames + tailOffset, planes[ch],
+                  block * sizeof(float));
+    }
+  }
+
+  for (uint32_t ch = 0; ch < channels_; ++ch) {
+    const uint32_t fc = filter_->Channels() == 1 ? 0 : ch;
+    RunStage(head_[ch], filter_->head_[fc].data(), filter_->HeadPartitions(), block,
+             headFft_, planes[ch], planarOut_.data() + size_t{ch} * block,
+             headAccumulator_, headScratch_);
+  }
+
+  if (tailFrames != 0 && tailBlock >= 2) {
+    // Tail output of block j lines up with input block j + 2.
+    const float* tail = tailOut_[(tailBlock - 2) % 2].data();
+    for (uint32_t ch = 0; ch < channels_; ++ch) {
+      float* dst = planarOut_.data() + size_t{ch} * block;
+      const float* src = tail + size_t{ch} * tailFrames + tailOffset;
+      for (uint32_t i = 0; i < block; ++i) dst[i] += src[i];
+    }
+  }
+
+  for (uint32_t ch = 0; ch < channels_; ++ch) planes[ch] = planarOut_.data() + size_t{ch} * block;
+  InterleaveSamples(SampleType::kF32, reinterpret_cast<const void* const*>(planes),
+                    channels_, block, out);
+  position_ += block;
+  framesProcessed_.fetch_add(block, std::memory_order_relaxed);
+  headNanos_.fetch_add(NanosSince(start) - waited, std::memory_order_relaxed);
+}
+
+void PartitionedConvolver::ClearState() {
+  for (auto* stages : {&head_, &tail_}) {
+    for (Stage& stage : *stages) {
+      std::fill(stage.window.begin(), stage.window.end(), 0.0f);
+      std::fill(stage.delayLine.begin(), stage.delayLine.end(), 0.0f);
+      stage.newest = 0;
+    }
+  }
+  for (int slot = 0; slot < 2; ++slot) {
+    std::fill(tailIn_[slot].begin(), tailIn_[slot].end(), 0.0f);
+    std::fill(tailOut_[slot].begin(), tailOut_[slot].end(), 0.0f);
+  }
+  position_ = 0;
+}
+
+void PartitionedConvolver::Reset() {
+  if (!filter_) return;
+  std::unique_lock<std::mutex> lock(mutex_);
+  // The worker only touches tail state while a block is outstanding.
+  doneCv_.wait(lock, [this] { return completed_ == submitted_; });
+  ClearState();
+  submitted_ = 0;
+  completed_ = 0;
+}
+
+PartitionedConvolver::Stats PartitionedConvolver::GetStats() const {
+  Stats stats;
+  stats.framesProcessed = framesProcessed_.load(std::memory_order_relaxed);
+  stats.headNanos = headNanos_.load(std::memory_order_relaxed);
+  stats.tailNanos = tailNanos_.load(std::memory_order_relaxed);
+  stats.tailWaits = tailWaits_.load(std::memory_order_relaxed);
+  return stats;
+}
+
+ConvolvingSource::ConvolvingSource(std::unique_ptr<PcmSource> inner,
+                                   std::shared_ptr<const ConvolutionFilter> filter)
+    : inner_(std::move(inner)), format_(inner_->Format()) {
+  if (!convolver_.Configure(std::move(filter), format_.channels)) return;
+  block_.resize(size_t{convolver_.BlockFrames()} * format_.channels);
+}
+
+bool ConvolvingSource::CanConvolve(const PcmFormat& format,
+                                   const ConvolutionFilter& filter) {
+  return format.isFloat && format.bitsPerSample == 32 &&
+         format.sampleRate == filter.SampleRate() && filter.Supports(format.channels);
+}
+
+bool ConvolvingSource::Refill() {
+  blockOffset_ = 0;
+  blockFrames_ = 0;
+  if (innerEnded_) return false;
+  const size_t block = convolver_.BlockFrames();
+  const size_t channels = format_.channels;
+  size_t got = 0;
+  while (got < block) {
+    const size_t n = inner_->ReadFrames(
+        reinterpret_cast<uint8_t*>(block_.data() + got * channels), block - got);
+    if (n == 0) {
+      innerEnded_ = true;
+      break;
+    }
+    got += n;
+  }
+  if (got == 0) return false;
+  // The last block is padded; only the real frames go out.
+  std::fill(block_.begin() + got * channels, block_.end(), 0.0f);
+  convolver_.Process(block_.data(), block_.data());
+  blockFrames_ = got;
+  return true;
+}
+
+size_t ConvolvingSource::ReadFrames(uint8_t* dst, size_t maxFrames) {
+  if (!convolver_.IsConfigured()) return inner_->ReadFrames(dst, maxFrames);
+  const size_t channels = format_.channels;
+  auto* out = reinterpret_cast<float*>(dst);
+  size_t written = 0;
+  while (written < maxFrames) {
+    if (blockOffset_ == blockFrames_ && !Refill()) break;
+    const size_t n = std::min(maxFrames - written, blockFrames_ - blockOffset_);
+    std::memcpy(out + written * channels, block_.data() + blockOffset_ * channels,
+                n * channels * sizeof(float));
+    blockOffset_ += n;
+    written += n;
+  }
+  return written;
+}
+
+bool ConvolvingSource::SeekToFrame(uint64_t frame, SeekMode mode,
+                                   uint64_t* landedFrame) {
+  if (!inner_->SeekToFrame(frame, mode, landedFrame)) return false;
+  convolver_.Reset();
+  blockOffset_ = 0;
+  blockFrames_ = 0;
+  innerEnded_ = false;
+  return true;
+}
+
+}  // namespace audioengine
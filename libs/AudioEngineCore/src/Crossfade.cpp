@@ -0,0 +1,194 @@
+#include "AudioEngineCore/Crossfade.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "AudioEngineCore/SampleKernels.h"
+#include "Simd.h"
+
+namespace audioengine {
+
+namespace {
+
+constexpr double kHalfPi = 1.57079632679489661923;
+
+template <typename Sample>
+void MixIntegerScalar(Sample* dst, const Sample* in, const float* outGain,
+                      const float* inGain, size_t frames, uint32_t channels,
+                      size_t begin) {
+  constexpr double kMin = std::numeric_limits<Sample>::min();
+  constexpr double kMax = std::numeric_limits<Sample>::max();
+  for (size_t frame = begin; frame < frames; ++frame) {
+    const double g0 = outGain[frame];
+    const double g1 = inGain[frame];
+    for (uint32_t ch = 0; ch < channels; ++ch) {
+      const size_t i = frame * channels + ch;
+      const double mixed = std::nearbyint(dst[i] * g0 + in[i] * g1);
+      dst[i] = static_cast<Sample>(std::clamp(mixed, kMin, kMax));
+    }
+  }
+}
+
+void MixFloatScalar(float* dst, const float* in, const float* outGain,
+                    const float* inGain, size_t frames, uint32_t channels,
+                    size_t begin) {
+  for (size_t frame = begin; frame < frames; ++frame) {
+    const float g0 = outGain[frame];
+    const float g1 = inGain[frame];
+    for (uint32_t ch = 0; ch < channels; ++ch) {
+      const size_t i = frame * channels + ch;
+      dst[i] = dst[i] * g0 + in[i] * g1;
+    }
+  }
+}
+
+// Vector kernels cover mono and stereo float, the formats the engines render;
+// they return how many frames they mixed and leave the tail to the scalar
+// loop.
+#if AUDIOENGINE_HAVE_SSE2
+
+size_t MixFloatVector(float* dst, const float* in, const float* outGain,
+                      const float* inGain, size_t frames, uint32_t channels) {
+  size_t frame = 0;
+  if (channels == 2) {
+    for (; frame + 4 <= frames; frame += 4) {
+      // Duplicate each frame's gain across its two samples.
+      const __m128 go = _mm_loadu_ps(outGain + frame);
+      const __m128 gi = _mm_loadu_ps(inGain + frame);
+      const __m128 goLo = _mm_unpacklo_ps(go, go);
+      const __m128 goHi = _mm_unpackhi_ps(go, go);
+      const __m128 giLo = _mm_unpacklo_ps(gi, gi);
+      const __m128 giHi = _mm_unpackhi_ps(gi, gi);
+      float* d = dst + frame * 2;
+      const float* s = in + frame * 2;
+      _mm_storeu_ps(d, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(d), goLo),
+                                  _mm_mul_ps(_mm_loadu_ps(s), giLo)));
+      _mm_storeu_ps(d + 4, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(d + 4), goHi),
+                                      _mm_mul_ps(_mm_loadu_ps(s + 4), giHi)));
+    }
+  } else if (channels == 1) {
+    for (; frame + 4 <= frames; frame += 4) {
+      const __m128 go = _mm_loadu_ps(outGain + frame);
+      const __m128 gi = _mm_loadu_ps(inGain + frame);
+      _mm_storeu_ps(dst + frame,
+                    _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(dst + frame), go),
+                               _mm_mul_ps(_mm_loadu_ps(in + frame), gi)));
+    }
+  }
+  return frame;
+}
+
+#elif AUDIOENGINE_HAVE_NEON
+
+size_t MixFloatVector(float* dst, const float* in, const float* outGain,
+                      const float* inGain, size_t frames, uint32_t channels) {
+  size_t frame = 0;
+  if (channels == 2) {
+    for (; frame + 4 <= frames; frame += 4) {
+      const float32x4_t go = vld1q_f32(outGain + frame);
+      const float32x4_t gi = vld1q_f32(inGain + frame);
+      const float32x4x2_t goPair = vzipq_f32(go, go);
+      const float32x4x2_t giPair = vzipq_f32(gi, gi);
+      float* d = dst + frame * 2;
+      const float* s = in + frame * 2;
+      vst1q_f32(d, vmlaq_f32(vmulq_f32(vld1q_f32(d), goPair.val[0]),
+                             vld1q_f32(s), giPair.val[0]));
+      vst1q_f32(d + 4, vmlaq_f32(vmulq_f32(vld1q_f32(d + 4), goPair.val[1]),
+                                 vld1q_f32(s + 4), giPair.val[1]));
+    }
+  } else if (channels == 1) {
+    for (; frame + 4 <= frames; frame += 4) {
+      vst1q_f32(dst + frame,
+                vmlaq_f32(vmulq_f32(vld1q_f32(dst + frame), vld1q_f32(outGain + frame)),
+                          vld1q_f32(in + frame), vld1q_f32(inGain + frame)));
+    }
+  }
+  return frame;
+}
+
+#else
+
+size_t MixFloatVector(float*, const float*, const float*, const float*, size_t,
+                      uint32_t) {
+  return 0;
+}
+
+#endif
+
+bool MixFormat(const PcmFormat& format, uint8_t* dst, const uint8_t* incoming,
+               const float* outGain, const float* inGain, size_t frames,
+               bool vector) {
+  if (!CanCrossfade(format)) return false;
+  const uint32_t channels = format.channels;
+  if (format.isFloat) {
+    auto* d = reinterpret_cast<float*>(dst);
+    const auto* s = reinterpret_cast<const float*>(incoming);
+    const size_t done =
+        vector ? MixFloatVector(d, s, outGain, inGain, frames, channels) : 0;
+    MixFloatScalar(d, s, outGain, inGain, frames, channels, done);
+  } else if (format.bitsPerSample == 16) {
+    MixIntegerScalar(reinterpret_cast<int16_t*>(dst),
+                     reinterpret_cast<const int16_t*>(incoming), outGain,
+                     inGain, frames, channels, 0);
+  } else {
+    MixIntegerScalar(reinterpret_cast<int32_t*>(dst),
+                     reinterpret_cast<const int32_t*>(incoming), outGain,
+                     inGain, frames, channels, 0);
+  }
+  return true;
+}
+
+}  // namespace
+
+bool CanCrossfade(const PcmFormat& format) {
+  if (format.channels == 0) return false;
+  if (format.isFloat) return format.bitsPerSample == 32;
+  return format.bitsPerSample == 16 || format.bitsPerSample == 32;
+}
+
+void EqualPowerGains(uint64_t position, uint64_t length, size_t frames,
+                     float* outGain, float* inGain) {
+  const uint64_t left = position < length ? length - position : 0;
+  const size_t ramp = static_cast<size_t>(std::min<uint64_t>(frames, left));
+  if (ramp > 0) {
+    // Rotate (cos, sin) by one step per frame instead of calling the trig
+    // functions per sample; reseeding on every call keeps drift negligible.
+    const double step = kHalfPi / static_cast<double>(length);
+    const double angle = (static_cast<double>(position) + 0.5) * step;
+    const double stepCos = std::cos(step);
+    const double stepSin = std::sin(step);
+    double c = std::cos(angle);
+    double s = std::sin(angle);
+    for (size_t i = 0; i < ramp; ++i) {
+      outGain[i] = static_cast<float>(c);
+      inGain[i] = static_cast<float>(s);
+      const double nextC = c * stepCos - s * stepSin;
+      s = s * stepCos + c * stepSin;
+      c = nextC;
+    }
+  }
+  std::fill(outGain + ramp, outGain + frames, 0.0f);
+  std::fill(inGain + ramp, inGain + frames, 1.0f);
+}
+
+bool MixCrossfade(const PcmFormat& format, uint8_t* dst, const uint8_t* incoming,
+                  const float* outGain, const float* inGain, size_t frames) {
+  return MixFormat(format, dst, incoming, outGain, inGain, frames, true);
+}
+
+bool ApplyGain(const PcmFormat& format, uint8_t* samples, size_t frames,
+               float gain) {
+  SampleType type;
+  if (!CanCrossfade(format) || !SampleTypeOf(format, &type)) return false;
+  ScaleSamples(type, samples, frames * format.channels, gain);
+  return true;
+}
+
+bool MixCrossfadeScalar(const PcmFormat& format, uint8_t* dst,
+                        const uint8_t* incoming, const float* outGain,
+                        const float* inGain, size_t frames) {
+  return MixFormat(format, dst, incoming, outGain, inGain, frames, false);
+}
+
+}  // namespace audioengine
@@ -0,0 +1,307 @@
+#include "AudioEngineCore/Crossfader.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <utility>
+
+#include "AudioEngineCore/Crossfade.h"
+
+namespace audioengine {
+
+namespace {
+
+// Frames mixed per pass. Bounds the scratch buffers; render blocks larger
+// than this are mixed in several passes.
+constexpr size_t kMixBlockFrames = 1024;
+
+// fadeStart_ for a track whose length is unknown: splice at its end.
+constexpr uint64_t kAtEnd = std::numeric_limits<uint64_t>::max();
+
+}  // namespace
+
+Crossfader::Crossfader() : Crossfader(StreamingDecoder::Options{}) {}
+
+Crossfader::Crossfader(const StreamingDecoder::Options& options)
+    : decks_{StreamingDecoder(options), StreamingDecoder(options)} {}
+
+Crossfader::~Crossfader() { Stop(); }
+
+void Crossfader::SetOverlapMs(uint32_t overlapMs) { overlapMs_ = overlapMs; }
+
+bool Crossfader::Start(std::unique_ptr<PcmSource> source, float gain) {
+  Stop();
+  deckGain_[0].store(gain);
+  chainedGain_[0].store(gain);
+  if (!decks_[0].Start(std::move(source))) return false;
+  format_ = decks_[0].Format();
+  mixScratch_.assign(kMixBlockFrames * format_.BytesPerFrame(), 0);
+  outGain_.assign(kMixBlockFrames, 0.0f);
+  inGain_.assign(kMixBlockFrames, 0.0f);
+  SampleType type = SampleType::kF32;
+  SampleTypeOf(format_, &type);
+  requantizer_.Configure(type, format_.sampleRate, format_.channels);
+  return true;
+}
+
+void Crossfader::Stop() {
+  decks_[0].Stop();
+  decks_[1].Stop();
+  state_.store(Pack(kIdle, 0));
+  trackChanged_.store(false);
+  fadePosition_ = 0;
+}
+
+bool Crossfader::Seek(uint64_t frame, SeekMode mode) {
+  ReapTail();
+  // Withdraw a queued fade while the read position jumps, then place it
+  // again. If the render thread got there first the fade is already running
+  // and the seek lands in the incoming track.
+  int state = state_.load(std::memory_order_acquire);
+  const bool armed =
+      PhaseOf(state) == kArmed &&
+      state_.compare_exchange_strong(state, Pack(kIdle, DeckOf(state)),
+                                     std::memory_order_acq_rel);
+  const bool ok = Current().Seek(frame, mode);
+  if (armed) {
+    ScheduleFade();
+    state_.store(Pack(kArmed, DeckOf(state)), std::memory_order_release);
+  }
+  return ok;
+}
+
+bool Crossfader::QueueNext(std::unique_ptr<PcmSource> next, float gain) {
+  ReapTail();
+  int state = state_.load(std::memory_order_acquire);
+  if (!next) {
+    if (PhaseOf(state) == kArmed &&
+        state_.compare_exchange_strong(state, Pack(kIdle, DeckOf(state)),
+                                       std::memory_order_acq_rel)) {
+      decks_[1 - DeckOf(state)].Stop();
+    }
+    if (PhaseOf(state) == kFading) return false;
+    return Current().QueueNext(nullptr);
+  }
+  if (PhaseOf(state) != kIdle) return false;
+  if (overlapMs_ == 0) {
+    // If the queue is refused, a transition to the previously queued track
+    // is pending and must keep that track's gain.
+    std::atomic<float>& chained = chainedGain_[DeckOf(state)];
+    const float previous = chained.exchange(gain);
+    if (Current().QueueNext(std::move(next))) return true;
+    chained.store(previous);
+    return false;
+  }
+
+  StreamingDecoder& current = decks_[DeckOf(state)];
+  if (!current.IsActive() || current.HasQueuedNext()) return false;
+  if (!CanCrossfade(format_) || next->Format() != format_) return false;
+  // Blocks until the incoming ring holds its prefill; after that its
+  // producer parks on a full ring until the fade starts draining it.
+  StreamingDecoder& incoming = decks_[1 - DeckOf(state)];
+  deckGain_[1 - DeckOf(state)].store(gain);
+  chainedGain_[1 - DeckOf(state)].store(gain);
+  if (!incoming.Start(std::move(next))) return false;
+  fadeLength_ = static_cast<uint64_t>(overlapMs_) * format_.sampleRate / 1000;
+  ScheduleFade();
+  state_.store(Pack(kArmed, DeckOf(state)), std::memory_order_release);
+  return true;
+}
+
+void Crossfader::SetTrackGain(float gain) {
+  const int deck = DeckOf(state_.load(std::memory_order_acquire));
+  deckGain_[deck].store(gain, std::memory_order_relaxed);
+  if (decks_[deck].PendingBoundary() == std::numeric_limits<uint64_t>::max()) {
+    chainedGain_[deck].store(gain, std::memory_order_relaxed);
+  }
+}
+
+void Crossfader::SetOutputGain(float gain) {
+  outputGain_.store(gain, std::memory_order_relaxed);
+}
+
+void Crossfader::SetDither(DitherMode mode) { requantizer_.SetMode(mode); }
+
+void Crossfader::ScheduleFade() {
+  const int deck = DeckOf(state_.load(std::memory_order_acquire));
+  const StreamingDecoder& current = decks_[deck];
+  const uint64_t total = current.TotalFrames();
+  if (total == 0) {
+    // Without a length there is nothing to fade against; hand over at the
+    // end of the stream like a gapless chain.
+    fadeFrames_ = 0;
+    fadeStart_.store(kAtEnd, std::memory_order_relaxed);
+    return;
+  }
+  fadeFrames_ = std::min(fadeLength_, total);
+  const uint64_t incomingTotal = decks_[1 - deck].TotalFrames();
+  if (incomingTotal > 0) fadeFrames_ = std::min(fadeFrames_, incomingTotal);
+  fadeStart_.store(current.ReadCountAt(total - fadeFrames_),
+                   std::memory_order_relaxed);
+}
+
+void Crossfader::ReapTail() {
+  const int state = state_.load(std::memory_order_acquire);
+  if (PhaseOf(state) != kRetired) return;
+  // The render thread no longer touches the old deck; stopping it joins a
+  // producer that has usually already run out of source.
+  decks_[1 - DeckOf(state)].Stop();
+  state_.store(Pack(kIdle, DeckOf(state)), std::memory_order_release);
+}
+
+bool Crossfader::BeginFade() {
+  int state = state_.load(std::memory_order_acquire);
+  if (PhaseOf(state) != kArmed) return false;
+  if (!state_.compare_exchange_strong(state, Pack(kFading, 1 - DeckOf(state)),
+                                      std::memory_order_acq_rel)) {
+    return false;
+  }
+  fadePosition_ = 0;
+  trackChanged_.store(true, std::memory_order_release);
+  return true;
+}
+
+size_t Crossfader::Read(uint8_t* dst, size_t frames) {
+  const size_t bytesPerFrame = format_.BytesPerFrame();
+  size_t done = 0;
+  int phase = PhaseOf(state_.load(std::memory_order_acquire));
+  if (phase == kArmed) {
+    StreamingDecoder& current = Current();
+    const uint64_t read = current.FramesRead();
+    const uint64_t fadeStart = fadeStart_.load(std::memory_order_relaxed);
+    if (read < fadeStart && !current.IsFinished()) {
+      const size_t before =
+          static_cast<size_t>(std::min<uint64_t>(frames, fadeStart - read));
+      done = ReadDeck(DeckOf(state_.load(std::memory_order_acquire)), dst, before);
+      // A short read is either a decoder stall (try again next block) or an
+      // early end of the track (start the fade now).
+      if (done == frames || (done < before && !current.IsFinished())) {
+        return done;
+      }
+    }
+    if (BeginFade()) phase = kFading;
+  }
+  if (phase == kFading) {
+    return done + MixTail(dst + done * bytesPerFrame, frames - done);
+  }
+  return done + ReadDeck(DeckOf(state_.load(std::memory_order_acquire)),
+                         dst + done * bytesPerFrame, frames - done);
+}
+
+size_t Crossfader::ReadDeck(int deck, uint8_t* dst, size_t frames) {
+  StreamingDecoder& decoder = decks_[deck];
+  const uint64_t start = decoder.FramesRead();
+  const size_t got = decoder.Read(dst, frames);
+  const float output = outputGain_.load(std::memory_order_relaxed);
+  const uint64_t boundary = decoder.PendingBoundary();
+  size_t split = got;
+  if (boundary < start + got) {
+    split = boundary > start ? static_cast<size_t>(boundary - start) : 0;
+  }
+  Gain(dst, split, output * deckGain_[deck].load(std::memory_order_relaxed));
+  Gain(dst + split * format_.BytesPerFrame(), got - split,
+       output * chainedGain_[deck].load(std::memory_order_relaxed));
+  return got;
+}
+
+void Crossfader::Gain(uint8_t* samples, size_t frames, float gain) {
+  if (requantizer_.IsConfigured()) {
+    requantizer_.ApplyGain(samples, frames, gain);
+  } else {
+    ApplyGain(format_, samples, frames, gain);
+  }
+}
+
+size_t Crossfader::MixTail(uint8_t* dst, size_t frames) {
+  const size_t bytesPerFrame = format_.BytesPerFrame();
+  const int deck = DeckOf(state_.load(std::memory_order_acquire));
+  StreamingDecoder& incoming = decks_[deck];
+  StreamingDecoder& outgoing = decks_[1 - deck];
+  // Track and output gains ride on the fade curves, so the mix is still one
+  // multiply-add per sample.
+  const float output = outputGain_.load(std::memory_order_relaxed);
+  const float outScale =
+      output * deckGain_[1 - deck].load(std::memory_order_relaxed);
+  const float inScale = output * deckGain_[deck].load(std::memory_order_relaxed);
+  size_t done = 0;
+  while (done < frames && fadePosition_ < fadeFrames_) {
+    const size_t n = static_cast<size_t>(std::min<uint64_t>(
+        std::min(frames - done, kMixBlockFrames), fadeFrames_ - fadePosition_));
+    uint8_t* out = dst + done * bytesPerFrame;
+    // Either side running short (end of the old track, a stall on the new
+    // one) mixes in silence; the fade itself never stalls.
+    const size_t gotOut = outgoing.Read(out, n);
+    memset(out + gotOut * bytesPerFrame, 0, (n - gotOut) * bytesPerFrame);
+    const size_t gotIn = incoming.Read(mixScratch_.data(), n);
+    memset(mixScratch_.data() + gotIn * bytesPerFrame, 0,
+           (n - gotIn) * bytesPerFrame);
+    EqualPowerGains(fadePosition_, fadeFrames_, n, outGain_.data(),
+                    inGain_.data());
+    for (size_t i = 0; i < n; ++i) {
+      outGain_[i] *= outScale;
+      inGain_[i] *= inScale;
+    }
+    if (requantizer_.IsConfigured()) {
+      requantizer_.MixCrossfade(out, mixScratch_.data(), outGain_.data(),
+                                inGain_.data(), n);
+    } else {
+      MixCrossfade(format_, out, mixScratch_.data(), outGain_.data(),
+                   inGain_.data(), n);
+    }
+    fadePosition_ += n;
+    done += n;
+  }
+  if (fadePosition_ >= fadeFrames_) {
+    state_.store(Pack(kRetired, deck), std::memory_order_release);
+    if (done < frames) {
+      done += ReadDeck(deck, dst + done * bytesPerFrame, frames - done);
+    }
+  }
+  return done;
+}
+
+bool Crossfader::HasQueuedNext() const {
+  if (PhaseOf(state_.load(std::memory_order_acquire)) == kArmed) return true;
+  return Current().HasQueuedNext();
+}
+
+bool Crossfader::TakeTrackChange() {
+  if (trackChanged_.exchange(false, std::memory_order_acq_rel)) return true;
+  const int deck = DeckOf(state_.load(std::memory_order_acquire));
+  StreamingDecoder& current = decks_[deck];
+  // Promote the chained gain before the transition is collected: until then
+  // the render thread still splits at the boundary and already uses it.
+  if (current.PendingBoundary() <= current.FramesRead()) {
+    deckGain_[deck].store(chainedGain_[deck].load());
+  }
+  return current.TakeTrackChange();
+}
+
+bool Crossfader::IsFinished() const {
+  const int state = state_.load(std::memory_order_acquire);
+  const int phase = PhaseOf(state);
+  if (phase == kArmed || phase == kFading) return false;
+  return decks_[DeckOf(state)].IsFinished();
+}
+
+bool Crossfader::IsActive() const { return Current().IsActive(); }
+
+bool Crossfader::IsFading() const {
+  return PhaseOf(state_.load(std::memory_order_acquire)) == kFading;
+}
+
+uint64_t Crossfader::PositionFrames() const { return Current().PositionFrames(); }
+
+uint64_t Crossfader::TotalFrames() const { return Current().TotalFrames(); }
+
+size_t Crossfader::BufferedFrames() const { return Current().BufferedFrames(); }
+
+std::chrono::microseconds Crossfader::LastSeekDuration() const {
+  return Current().LastSeekDuration();
+}
+
+uint64_t Crossfader::SteadyStateAllocations() const {
+  return decks_[0].SteadyStateAllocations() + decks_[1].SteadyStateAllocations();
+}
+
+}  // namespace audioengine
@@ -0,0 +1,306 @@
+#include "AudioEngineCore/Crossfeed.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "AudioEngineCore/SampleKernels.h"
+#include "Simd.h"
+
+namespace audioengine {
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+// Filter state this small is flushed so silence does not run on denormals.
+constexpr float kDenormalFloor = 1e-20f;
+
+// Indexes into Crossfeed::Coefficients.
+enum { kLowA0, kLowB1, kShelfA0, kShelfA1, kShelfB1 };
+
+// Every lane computes y = a0 * x + a1 * xPrevious + b1 * y, the low pass in
+// lanes 0-1 and the shelf in lanes 2-3, then each ear takes its own shelf
+// and the other channel's low pass. `lanes` moves by `steps` after every
+// frame when ramping.
+using CrossfeedKernelFn = void (*)(float* samples, size_t frames, float (*lanes)[4],
+                                   const float (*steps)[4], float (*state)[4]);
+
+template <bool kRamp>
+void CrossfeedScalar(float* samples, size_t frames, float (*lanes)[4],
+                     const float (*steps)[4], float (*state)[4]) {
+  float* y = state[0];
+  float* previous = state[1];
+  for (size_t f = 0; f < frames; ++f) {
+    float* frame = samples + f * 2;
+    const float x[4] = {frame[0], frame[1], frame[0], frame[1]};
+    for (int lane = 0; lane < 4; ++lane) {
+      y[lane] = lanes[0][lane] * x[lane] + lanes[1][lane] * previous[lane] +
+                lanes[2][lane] * y[lane];
+      previous[lane] = x[lane];
+    }
+    frame[0] = y[2] + y[1];
+    frame[1] = y[3] + y[0];
+    if (kRamp) {
+      for (int k = 0; k < 3; ++k) {
+        for (int lane = 0; lane < 4; ++lane) lanes[k][lane] += steps[k][lane];
+      }
+    }
+  }
+}
+
+#if AUDIOENGINE_HAVE_SSE2
+template <bool kRamp>
+void CrossfeedSse2(float* samples, size_t frames, float (*lanes)[4],
+                   const float (*steps)[4], float (*state)[4]) {
+  __m128 a0 = _mm_load_ps(lanes[0]);
+  __m128 a1 = _mm_load_ps(lanes[1]);
+  __m128 b1 = _mm_load_ps(lanes[2]);
+  __m128 y = _mm_load_ps(state[0]);
+  __m128 previous = _mm_load_ps(state[1]);
+  float* frame = samples;
+  for (size_t f = 0; f < frames; ++f, frame += 2) {
+    const __m128 pair = _mm_loadl_pi(_mm_setzero_ps(), reinterpret_cast<const __m64*>(frame));
+    const __m128 x = _mm_movelh_ps(pair, pair);
+    y = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a0, x), _mm_mul_ps(a1, previous)),
+                   _mm_mul_ps(b1, y));
+    previous = x;
+    // [shelf L + low pass R, shelf R + low pass L].
+    const __m128 out =
+        _mm_add_ps(_mm_movehl_ps(y, y), _mm_shuffle_ps(y, y, _MM_SHUFFLE(3, 2, 0, 1)));
+    _mm_storel_pi(reinterpret_cast<__m64*>(frame), out);
+    if (kRamp) {
+      a0 = _mm_add_ps(a0, _mm_load_ps(steps[0]));
+      a1 = _mm_add_ps(a1, _mm_load_ps(steps[1]));
+      b1 = _mm_add_ps(b1, _mm_load_ps(steps[2]));
+    }
+  }
+  _mm_store_ps(state[0], y);
+  _mm_store_ps(state[1], previous);
+  if (kRamp) {
+    _mm_store_ps(lanes[0], a0);
+    _mm_store_ps(lanes[1], a1);
+    _mm_store_ps(lanes[2], b1);
+  }
+}
+#endif
+
+#if AUDIOENGINE_HAVE_NEON64
+template <bool kRamp>
+void CrossfeedNeon(float* samples, size_t frames, float (*lanes)[4],
+                   const float (*steps)[4], float (*state)[4]) {
+  float32x4_t a0 = vld1q_f32(lanes[0]);
+  float32x4_t a1 = vld1q_f32(lanes[1]);
+  float32x4_t b1 = vld1q_f32(lanes[2]);
+  float32x4_t y = vld1q_f32(state[0]);
+  float32x4_t previous = vld1q_f32(state[1]);
+  float* frame = samples;
+  for (size_t f = 0; f < frames; ++f, frame += 2) {
+    const float32x2_t pair = vld1_f32(frame);
+    const float32x4_t x = vcombine_f32(pair, pair);
+    y = vfmaq_f32(vfmaq_f32(vmulq_f32(a0, x), a1, previous), b1, y);
+    previous = x;
+    vst1_f32(frame, vadd_f32(vget_high_f32(y), vrev64_f32(vget_low_f32(y))));
+    if (kRamp) {
+      a0 = vaddq_f32(a0, vld1q_f32(steps[0]));
+      a1 = vaddq_f32(a1, vld1q_f32(steps[1]));
+      b1 = vaddq_f32(b1, vld1q_f32(steps[2]));
+    }
+  }
+  vst1q_f32(state[0], y);
+  vst1q_f32(state[1], previous);
+  if (kRamp) {
+    vst1q_f32(lanes[0], a0);
+    vst1q_f32(lanes[1], a1);
+    vst1q_f32(lanes[2], b1);
+  }
+}
+#endif
+
+CrossfeedKernelFn SelectKernel(KernelIsa isa, bool ramp) {
+  switch (isa) {
+#if AUDIOENGINE_HAVE_SSE2
+    // A stereo frame fills one SSE register; AVX2 has nothing to add to a
+    // recursion this short.
+    case KernelIsa::kAvx2:
+    case KernelIsa::kSse2: return ramp ? CrossfeedSse2<true> : CrossfeedSse2<false>;
+#endif
+#if AUDIOENGINE_HAVE_NEON64
+    case KernelIsa::kNeon: return ramp ? CrossfeedNeon<true> : CrossfeedNeon<false>;
+#endif
+    default: return ramp ? CrossfeedScalar<true> : CrossfeedScalar<false>;
+  }
+}
+
+uint32_t FloatBits(float value) {
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+float BitsFloat(uint32_t bits) {
+  float value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+}  // namespace
+
+Crossfeed::Crossfeed() : level_(Pack(kCrossfeedDefault)) {
+  seenLevel_ = level_.load();
+  current_ = target_ = Design(seenLevel_, false, 0);
+  std::memset(&step_, 0, sizeof(step_));
+  UpdateLanes();
+  std::memset(state_, 0, sizeof(state_));
+}
+
+uint64_t Crossfeed::Pack(const CrossfeedLevel& level) {
+  const float cutoff = static_cast<float>(
+      std::min(std::max(level.cutoffHz, kMinCutoffHz), kMaxCutoffHz));
+  const float feed =
+      static_cast<float>(std::min(std::max(level.feedDb, kMinFeedDb), kMaxFeedDb));
+  return uint64_t{FloatBits(cutoff)} << 32 | FloatBits(feed);
+}
+
+CrossfeedLevel Crossfeed::Unpack(uint64_t packed) {
+  CrossfeedLevel level;
+  level.cutoffHz = BitsFloat(static_cast<uint32_t>(packed >> 32));
+  level.feedDb = BitsFloat(static_cast<uint32_t>(packed));
+  return level;
+}
+
+// bs2b's design. The low pass passes G_lo of the other channel below the
+// cutoff; the shelf cuts the own channel by G_hi below its corner, which
+// sits above the cutoff so that the two sum flat for a centred source.
+Crossfeed::Coefficients Crossfeed::Design(uint64_t packed, bool enabled,
+                                          uint32_t sampleRate) {
+  Coefficients c;
+  if (!enabled || sampleRate == 0) {
+    // Own channel straight through, nothing from the other.
+    c.c[kLowA0] = c.c[kLowB1] = 0.0f;
+    c.c[kShelfA0] = 1.0f;
+    c.c[kShelfA1] = c.c[kShelfB1] = 0.0f;
+    return c;
+  }
+  const CrossfeedLevel level = Unpack(packed);
+  const double lowDb = level.feedDb * -5.0 / 6.0 - 3.0;
+  const double highDb = level.feedDb / 6.0 - 3.0;
+  const double lowGain = std::pow(10.0, lowDb / 20.0);
+  const double highCut = 1.0 - std::pow(10.0, highDb / 20.0);
+  const double highHz =
+      level.cutoffHz * std::pow(2.0, (lowDb - 20.0 * std::log10(highCut)) / 12.0);
+  const double gain = 1.0 / (1.0 - highCut + lowGain);
+
+  const double low = std::exp(-2.0 * kPi * level.cutoffHz / sampleRate);
+  const double high = std::exp(-2.0 * kPi * std::min(highHz, 0.45 * sampleRate) / sampleRate);
+  c.c[kLowA0] = static_cast<float>(gain * lowGain * (1.0 - low));
+  c.c[kLowB1] = static_cast<float>(low);
+  c.c[kShelfA0] = static_cast<float>(gain * (1.0 - highCut * (1.0 - high)));
+  c.c[kShelfA1] = static_cast<float>(gain * -high);
+  c.c[kShelfB1] = static_cast<float>(high);
+  return c;
+}
+
+bool Crossfeed::Configure(uint32_t sampleRate, uint32_t channels) {
+  if (channels != 2 || sampleRate == 0) {
+    sampleRate_ = 0;
+    return false;
+  }
+  sampleRate_ = sampleRate;
+  seenEnabled_ = enabled_.load();
+  seenLevel_ = level_.load();
+  current_ = target_ = Design(seenLevel_, seenEnabled_, sampleRate_);
+  rampLeft_ = 0;
+  bypassed_ = !seenEnabled_;
+  UpdateLanes();
+  std::memset(state_, 0, sizeof(state_));
+  return true;
+}
+
+void Crossfeed::SetEnabled(bool enabled) {
+  enabled_.store(enabled, std::memory_order_relaxed);
+}
+
+void Crossfeed::SetLevel(const CrossfeedLevel& level) {
+  level_.store(Pack(level), std::memory_order_relaxed);
+}
+
+CrossfeedLevel Crossfeed::Level() const {
+  return Unpack(level_.load(std::memory_order_relaxed));
+}
+
+void Crossfeed::Retarget(uint64_t level, bool enabled) {
+  const bool wasEnabled = seenEnabled_;
+  seenLevel_ = level;
+  seenEnabled_ = enabled;
+  // A new level while off changes nothing audible.
+  if (!enabled && !wasEnabled && bypassed_) return;
+  target_ = Design(level, enabled, sampleRate_);
+  // Every point between two stable one-pole filters is one too, so a
+  // straight-line glide is safe; it also fades the crossfeed in and out.
+  for (int k = 0; k < 5; ++k) {
+    step_.c[k] = (target_.c[k] - current_.c[k]) / kRampFrames;
+  }
+  rampLeft_ = kRampFrames;
+  bypassed_ = false;
+  UpdateLanes();
+}
+
+void Crossfeed::UpdateLanes() {
+  const float* c = current_.c;
+  const float* s = step_.c;
+  const float a0[4] = {c[kLowA0], c[kLowA0], c[kShelfA0], c[kShelfA0]};
+  const float a1[4] = {0.0f, 0.0f, c[kShelfA1], c[kShelfA1]};
+  const float b1[4] = {c[kLowB1], c[kLowB1], c[kShelfB1], c[kShelfB1]};
+  const float a0Step[4] = {s[kLowA0], s[kLowA0], s[kShelfA0], s[kShelfA0]};
+  const float a1Step[4] = {0.0f, 0.0f, s[kShelfA1], s[kShelfA1]};
+  const float b1Step[4] = {s[kLowB1], s[kLowB1], s[kShelfB1], s[kShelfB1]};
+  std::memcpy(lanes_[0], a0, sizeof(a0));
+  std::memcpy(lanes_[1], a1, sizeof(a1));
+  std::memcpy(lanes_[2], b1, sizeof(b1));
+  std::memcpy(stepLanes_[0], a0Step, sizeof(a0Step));
+  std::memcpy(stepLanes_[1], a1Step, sizeof(a1Step));
+  std::memcpy(stepLanes_[2], b1Step, sizeof(b1Step));
+}
+
+void Crossfeed::Process(float* samples, size_t frames) {
+  if (sampleRate_ == 0) return;
+  const bool enabled = enabled_.load(std::memory_order_relaxed);
+  const uint64_t level = level_.load(std::memory_order_relaxed);
+  if (enabled != seenEnabled_ || level != seenLevel_) Retarget(level, enabled);
+  if (bypassed_) return;
+
+  const KernelIsa isa = ActiveKernelIsa();
+  while (frames > 0) {
+    const bool ramping = rampLeft_ > 0;
+    const size_t chunk = ramping ? std::min<size_t>(frames, rampLeft_) : frames;
+    SelectKernel(isa, ramping)(samples, chunk, lanes_, stepLanes_, state_);
+    if (ramping) {
+      rampLeft_ -= static_cast<uint32_t>(chunk);
+      if (rampLeft_ == 0) {
+        current_ = target_;
+        std::memset(&step_, 0, sizeof(step_));
+        UpdateLanes();
+        if (!seenEnabled_) {
+          // Faded out: the rest of the block is already straight through.
+          bypassed_ = true;
+          std::memset(state_, 0, sizeof(state_));
+          return;
+        }
+      } else {
+        for (int k = 0; k < 5; ++k) current_.c[k] += step_.c[k] * chunk;
+      }
+    }
+    samples += chunk * 2;
+    frames -= chunk;
+  }
+
+  for (float& z : state_[0]) {
+    if (std::fabs(z) < kDenormalFloor) z = 0.0f;
+  }
+}
+
+void Crossfeed::Reset() {
+  std::memset(state_, 0, sizeof(state_));
+}
+
+}  // namespace audioengine
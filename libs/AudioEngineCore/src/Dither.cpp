@@ -0,0 +1,390 @@
+#include "AudioEngineCore/Dither.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "AudioEngineCore/Crossfade.h"
+#include "Simd.h"
+
+namespace audioengine {
+
+namespace {
+
+constexpr uint32_t kLanes = Requantizer::kMaxChannels;
+
+// Error-feedback filters H(z); the noise transfer function is 1 - H(z).
+constexpr float kHighpassTaps[] = {2.0f, -1.0f};
+// S. Wannamaker, "Psychoacoustically Optimal Noise Shaping" (JAES, 1992),
+// 9-tap F-weighted design for 44.1 kHz.
+constexpr float kFWeightedTaps[] = {2.412f, -3.370f, 3.937f, -4.174f, 3.353f,
+                                    -2.205f, 1.281f, -0.569f, 0.0847f};
+// Above this rate kFWeighted falls back to kHighpass.
+constexpr uint32_t kMaxFWeightedRate = 50000;
+
+// TPDF dither is the sum of the two 16-bit halves of one xorshift32 draw:
+// (lo + hi) * kDitherStep - kDitherOffset spans (-1, 1) LSB, mean 0. Every
+// step is exact in float, so all kernels produce the same dither.
+constexpr float kDitherStep = 1.0f / 65536.0f;
+constexpr float kDitherOffset = 65535.0f / 65536.0f;
+
+inline uint32_t Xorshift(uint32_t r) {
+  r ^= r << 13;
+  r ^= r >> 17;
+  r ^= r << 5;
+  return r;
+}
+
+uint32_t Seed(uint32_t channel) { return 0x9E3779B9u * (channel + 1); }
+
+// Dithers and rounds `frames` interleaved float frames in place, in units of
+// 1 / scale, with kTaps of error feedback. On return the samples are integer
+// multiples of 1 / scale within [-1, 1 - 1 / scale]. `error` and `rng` carry
+// the per-channel state between calls.
+//
+// The input is clamped to the output range before the feedback is
+// subtracted, and the error is taken before the output clamp, so it stays
+// within +-1.5 LSB and the loop cannot run away on clipped material. The
+// feedback sums the oldest error first: only the newest one depends on the
+// previous frame, so it joins last and keeps the serial chain short.
+using DitherKernelFn = void (*)(float* samples, size_t frames, uint32_t channels,
+                                const float* taps, float scale,
+                                float (*error)[kLanes], uint32_t* rng);
+
+template <uint32_t kTaps>
+void DitherScalar(float* samples, size_t frames, uint32_t channels,
+                  const float* taps, float scale, float (*error)[kLanes],
+                  uint32_t* rng) {
+  const float lo = -scale;
+  const float hi = scale - 1.0f;
+  const float inverse = 1.0f / scale;
+  for (uint32_t ch = 0; ch < channels; ++ch) {
+    float e[kTaps + 1];
+    for (uint32_t k = 0; k < kTaps; ++k) e[k] = error[k][ch];
+    uint32_t r = rng[ch];
+    float* p = samples + ch;
+    for (size_t f = 0; f < frames; ++f, p += channels) {
+      float feedback = 0.0f;
+      for (uint32_t k = kTaps; k-- > 0;) feedback = feedback + taps[k] * e[k];
+      const float shaped = std::min(std::max(*p * scale, lo), hi) - feedback;
+      r = Xorshift(r);
+      const float dither =
+          static_cast<float>((r & 0xFFFFu) + (r >> 16)) * kDitherStep - kDitherOffset;
+      const float q = std::nearbyint(shaped + dither);
+      for (uint32_t k = kTaps; k-- > 1;) e[k] = e[k - 1];
+      if (kTaps > 0) e[0] = q - shaped;
+      *p = std::min(std::max(q, lo), hi) * inverse;
+    }
+    for (uint32_t k = 0; k < kTaps; ++k) error[k][ch] = e[k];
+    rng[ch] = r;
+  }
+}
+
+#if AUDIOENGINE_HAVE_SSE2
+template <uint32_t kTaps>
+void DitherSse2(float* samples, size_t frames, uint32_t channels,
+                const float* taps, float scale, float (*error)[kLanes],
+                uint32_t* rng) {
+  const __m128 vScale = _mm_set1_ps(scale);
+  const __m128 lo = _mm_set1_ps(-scale);
+  const __m128 hi = _mm_set1_ps(scale - 1.0f);
+  const __m128 inverse = _mm_set1_ps(1.0f / scale);
+  const __m128 step = _mm_set1_ps(kDitherStep);
+  const __m128 offset = _mm_set1_ps(kDitherOffset);
+  const __m128i low16 = _mm_set1_epi32(0xFFFF);
+  __m128 h[kTaps + 1];
+  for (uint32_t k = 0; k < kTaps; ++k) h[k] = _mm_set1_ps(taps[k]);
+  // The feedback chain is serial per channel, so each group of four
+  // channels runs through the whole block with its history in registers.
+  for (uint32_t group = 0; group < channels; group += 4) {
+    const uint32_t n = std::min<uint32_t>(4, channels - group);
+    __m128 e[kTaps + 1];
+    for (uint32_t k = 0; k < kTaps; ++k) e[k] = _mm_load_ps(error[k] + group);
+    __m128i r = _mm_load_si128(reinterpret_cast<const __m128i*>(rng + group));
+    float* p = samples + group;
+    for (size_t f = 0; f < frames; ++f, p += channels) {
+      __m128 feedback = _mm_setzero_ps();
+      for (uint32_t k = kTaps; k-- > 0;) {
+        feedback = _mm_add_ps(feedback, _mm_mul_ps(h[k], e[k]));
+      }
+      const __m128 shaped = _mm_sub_ps(
+          _mm_min_ps(_mm_max_ps(_mm_mul_ps(LoadLanes4(p, n), vScale), lo), hi), feedback);
+      r = _mm_xor_si128(r, _mm_slli_epi32(r, 13));
+      r = _mm_xor_si128(r, _mm_srli_epi32(r, 17));
+      r = _mm_xor_si128(r, _mm_slli_epi32(r, 5));
+      const __m128 dither = _mm_sub_ps(
+          _mm_mul_ps(_mm_cvtepi32_ps(_mm_add_epi32(_mm_and_si128(r, low16),
+                                                   _mm_srli_epi32(r, 16))),
+                     step),
+          offset);
+      const __m128 q = _mm_cvtepi32_ps(_mm_cvtps_epi32(_mm_add_ps(shaped, dither)));
+      for (uint32_t k = kTaps; k-- > 1;) e[k] = e[k - 1];
+      if (kTaps > 0) e[0] = _mm_sub_ps(q, shaped);
+      StoreLanes4(p, _mm_mul_ps(_mm_min_ps(_mm_max_ps(q, lo), hi), inverse), n);
+    }
+    for (uint32_t k = 0; k < kTaps; ++k) _mm_store_ps(error[k] + group, e[k]);
+    _mm_store_si128(reinterpret_cast<__m128i*>(rng + group), r);
+  }
+}
+#endif
+
+#if AUDIOENGINE_HAVE_AVX2
+template <uint32_t kTaps>
+AUDIOENGINE_TARGET_AVX2
+void DitherAvx2(float* samples, size_t frames, uint32_t channels,
+                const float* taps, float scale, float (*error)[kLanes],
+                uint32_t* rng) {
+  // Only used above four channels (see SelectKernel()); the upper half is
+  // loaded like an SSE2 group.
+  const uint32_t upper = channels - 4;
+  const __m256 vScale = _mm256_set1_ps(scale);
+  const __m256 lo = _mm256_set1_ps(-scale);
+  const __m256 hi = _mm256_set1_ps(scale - 1.0f);
+  const __m256 inverse = _mm256_set1_ps(1.0f / scale);
+  const __m256 step = _mm256_set1_ps(kDitherStep);
+  const __m256 offset = _mm256_set1_ps(kDitherOffset);
+  const __m256i low16 = _mm256_set1_epi32(0xFFFF);
+  __m256 h[kTaps + 1];
+  __m256 e[kTaps + 1];
+  for (uint32_t k = 0; k < kTaps; ++k) {
+    h[k] = _mm256_set1_ps(taps[k]);
+    e[k] = _mm256_load_ps(error[k]);
+  }
+  __m256i r = _mm256_load_si256(reinterpret_cast<const __m256i*>(rng));
+  float* frame = samples;
+  for (size_t f = 0; f < frames; ++f, frame += channels) {
+    const __m256 x = channels == kLanes
+                         ? _mm256_loadu_ps(frame)
+                         : _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(frame)),
+                                                LoadLanes4(frame + 4, upper), 1);
+    __m256 feedback = _mm256_setzero_ps();
+    for (uint32_t k = kTaps; k-- > 0;) {
+      feedback = _mm256_add_ps(feedback, _mm256_mul_ps(h[k], e[k]));
+    }
+    const __m256 shaped = _mm256_sub_ps(
+        _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(x, vScale), lo), hi), feedback);
+    r = _mm256_xor_si256(r, _mm256_slli_epi32(r, 13));
+    r = _mm256_xor_si256(r, _mm256_srli_epi32(r, 17));
+    r = _mm256_xor_si256(r, _mm256_slli_epi32(r, 5));
+    const __m256 dither = _mm256_sub_ps(
+        _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_add_epi32(_mm256_and_si256(r, low16),
+                                                          _mm256_srli_epi32(r, 16))),
+                      step),
+        offset);
+    const __m256 q =
+        _mm256_cvtepi32_ps(_mm256_cvtps_epi32(_mm256_add_ps(shaped, dither)));
+    for (uint32_t k = kTaps; k-- > 1;) e[k] = e[k - 1];
+    if (kTaps > 0) e[0] = _mm256_sub_ps(q, shaped);
+    const __m256 out = _mm256_mul_ps(_mm256_min_ps(_mm256_max_ps(q, lo), hi), inverse);
+    if (channels == kLanes) {
+      _mm256_storeu_ps(frame, out);
+    } else {
+      _mm_storeu_ps(frame, _mm256_castps256_ps128(out));
+      StoreLanes4(frame + 4, _mm256_extractf128_ps(out, 1), upper);
+    }
+  }
+  for (uint32_t k = 0; k < kTaps; ++k) _mm256_store_ps(error[k], e[k]);
+  _mm256_store_si256(reinterpret_cast<__m256i*>(rng), r);
+}
+#endif
+
+#if AUDIOENGINE_HAVE_NEON64
+template <uint32_t kTaps>
+void DitherNeon(float* samples, size_t frames, uint32_t channels,
+                const float* taps, float scale, float (*error)[kLanes],
+                uint32_t* rng) {
+  const float32x4_t vScale = vdupq_n_f32(scale);
+  const float32x4_t lo = vdupq_n_f32(-scale);
+  const float32x4_t hi = vdupq_n_f32(scale - 1.0f);
+  const float32x4_t inverse = vdupq_n_f32(1.0f / scale);
+  const float32x4_t step = vdupq_n_f32(kDitherStep);
+  const float32x4_t offset = vdupq_n_f32(kDitherOffset);
+  const uint32x4_t low16 = vdupq_n_u32(0xFFFF);
+  float32x4_t h[kTaps + 1];
+  for (uint32_t k = 0; k < kTaps; ++k) h[k] = vdupq_n_f32(taps[k]);
+  for (uint32_t group = 0; group < channels; group += 4) {
+    const uint32_t n = std::min<uint32_t>(4, channels - group);
+    float32x4_t e[kTaps + 1];
+    for (uint32_t k = 0; k < kTaps; ++k) e[k] = vld1q_f32(error[k] + group);
+    uint32x4_t r = vld1q_u32(rng + group);
+    float* p = samples + group;
+    for (size_t f = 0; f < frames; ++f, p += channels) {
+      const float32x4_t x = LoadLanes4(p, n);
+      float32x4_t feedback = vdupq_n_f32(0.0f);
+      for (uint32_t k = kTaps; k-- > 0;) {
+        feedback = vaddq_f32(feedback, vmulq_f32(h[k], e[k]));
+      }
+      const float32x4_t shaped =
+          vsubq_f32(vminq_f32(vmaxq_f32(vmulq_f32(x, vScale), lo), hi), feedback);
+      r = veorq_u32(r, vshlq_n_u32(r, 13));
+      r = veorq_u32(r, vshrq_n_u32(r, 17));
+      r = veorq_u32(r, vshlq_n_u32(r, 5));
+      const float32x4_t dither = vsubq_f32(
+          vmulq_f32(vcvtq_f32_u32(vaddq_u32(vandq_u32(r, low16), vshrq_n_u32(r, 16))),
+                    step),
+          offset);
+      const float32x4_t q = vcvtq_f32_s32(vcvtnq_s32_f32(vaddq_f32(shaped, dither)));
+      for (uint32_t k = kTaps; k-- > 1;) e[k] = e[k - 1];
+      if (kTaps > 0) e[0] = vsubq_f32(q, shaped);
+      const float32x4_t out = vmulq_f32(vminq_f32(vmaxq_f32(q, lo), hi), inverse);
+      StoreLanes4(p, out, n);
+    }
+    for (uint32_t k = 0; k < kTaps; ++k) vst1q_f32(error[k] + group, e[k]);
+    vst1q_u32(rng + group, r);
+  }
+}
+#endif
+
+template <uint32_t kTaps>
+DitherKernelFn SelectForTaps(KernelIsa isa, uint32_t channels) {
+  switch (isa) {
+#if AUDIOENGINE_HAVE_AVX2
+    // Four channels or fewer fit one SSE register.
+    case KernelIsa::kAvx2:
+      return channels > 4 ? DitherAvx2<kTaps> : DitherSse2<kTaps>;
+#endif
+#if AUDIOENGINE_HAVE_SSE2
+    case KernelIsa::kSse2: return DitherSse2<kTaps>;
+#endif
+#if AUDIOENGINE_HAVE_NEON64
+    case KernelIsa::kNeon: return DitherNeon<kTaps>;
+#endif
+    default:
+      (void)channels;
+      return DitherScalar<kTaps>;
+  }
+}
+
+DitherKernelFn SelectKernel(KernelIsa isa, uint32_t channels, uint32_t taps) {
+  switch (taps) {
+    case 0: return SelectForTaps<0>(isa, channels);
+    case 2: return SelectForTaps<2>(isa, channels);
+    default: return SelectForTaps<Requantizer::kMaxTaps>(isa, channels);
+  }
+}
+
+}  // namespace
+
+const char* DitherModeName(DitherMode mode) {
+  switch (mode) {
+    case DitherMode::kOff: return "off";
+    case DitherMode::kTpdf: return "tpdf";
+    case DitherMode::kHighpass: return "highpass";
+    case DitherMode::kFWeighted: return "f-weighted";
+  }
+  return "?";
+}
+
+Requantizer::Requantizer() { Reset(); }
+
+bool Requantizer::Configure(SampleType type, uint32_t sampleRate, uint32_t channels) {
+  channels_ = 0;
+  if (type == SampleType::kF32 || type == SampleType::kF64 || channels == 0 ||
+      channels > kMaxChannels) {
+    return false;
+  }
+  type_ = type;
+  sampleRate_ = sampleRate;
+  const int bits = std::min<int>(BytesPerSample(type) * 8, 24);
+  scale_ = std::ldexp(1.0f, bits - 1);
+  scratch_.assign(kBlockFrames * channels, 0.0f);
+  mixScratch_.assign(kBlockFrames * channels, 0.0f);
+  channels_ = channels;
+  // Forces UpdateMode() to set up the taps on the next render call.
+  activeMode_ = static_cast<DitherMode>(0xFF);
+  UpdateMode();
+  return true;
+}
+
+void Requantizer::SetMode(DitherMode mode) {
+  mode_.store(mode, std::memory_order_relaxed);
+}
+
+void Requantizer::UpdateMode() {
+  const DitherMode mode = mode_.load(std::memory_order_relaxed);
+  if (mode == activeMode_) return;
+  activeMode_ = mode;
+  const float* taps = nullptr;
+  tapCount_ = 0;
+  if (mode == DitherMode::kFWeighted && sampleRate_ <= kMaxFWeightedRate) {
+    taps = kFWeightedTaps;
+    tapCount_ = kMaxTaps;
+  } else if (mode == DitherMode::kFWeighted || mode == DitherMode::kHighpass) {
+    taps = kHighpassTaps;
+    tapCount_ = 2;
+  }
+  std::fill(taps_, taps_ + kMaxTaps, 0.0f);
+  if (taps) std::copy(taps, taps + tapCount_, taps_);
+  Reset();
+}
+
+void Requantizer::ApplyGain(void* samples, size_t frames, float gain) {
+  if (channels_ == 0 || gain == 1.0f) return;
+  UpdateMode();
+  if (activeMode_ == DitherMode::kOff) {
+    ScaleSamples(type_, samples, frames * channels_, gain);
+    return;
+  }
+  uint8_t* bytes = static_cast<uint8_t*>(samples);
+  const size_t bytesPerFrame = BytesPerSample(type_) * channels_;
+  while (frames > 0) {
+    const size_t n = std::min(frames, kBlockFrames);
+    ConvertSamples(type_, bytes, SampleType::kF32, scratch_.data(), n * channels_, gain);
+    Quantize(scratch_.data(), bytes, n);
+    bytes += n * bytesPerFrame;
+    frames -= n;
+  }
+}
+
+void Requantizer::MixCrossfade(void* dst, const void* incoming, const float* outGain,
+                               const float* inGain, size_t frames) {
+  if (channels_ == 0) return;
+  UpdateMode();
+  PcmFormat format;
+  format.sampleRate = sampleRate_;
+  format.channels = channels_;
+  format.bitsPerSample = BytesPerSample(type_) * 8;
+  format.isFloat = false;
+  if (activeMode_ == DitherMode::kOff && CanCrossfade(format)) {
+    audioengine::MixCrossfade(format, static_cast<uint8_t*>(dst),
+                              static_cast<const uint8_t*>(incoming), outGain, inGain,
+                              frames);
+    return;
+  }
+  format.bitsPerSample = 32;
+  format.isFloat = true;
+  uint8_t* out = static_cast<uint8_t*>(dst);
+  const uint8_t* in = static_cast<const uint8_t*>(incoming);
+  const size_t bytesPerFrame = BytesPerSample(type_) * channels_;
+  while (frames > 0) {
+    const size_t n = std::min(frames, kBlockFrames);
+    ConvertSamples(type_, out, SampleType::kF32, scratch_.data(), n * channels_);
+    ConvertSamples(type_, in, SampleType::kF32, mixScratch_.data(), n * channels_);
+    audioengine::MixCrossfade(format, reinterpret_cast<uint8_t*>(scratch_.data()),
+                              reinterpret_cast<const uint8_t*>(mixScratch_.data()),
+                              outGain, inGain, n);
+    Quantize(scratch_.data(), out, n);
+    out += n * bytesPerFrame;
+    in += n * bytesPerFrame;
+    outGain += n;
+    inGain += n;
+    frames -= n;
+  }
+}
+
+void Requantizer::Quantize(float* samples, void* dst, size_t frames) {
+  if (channels_ == 0) return;
+  UpdateMode();
+  if (activeMode_ != DitherMode::kOff) {
+    SelectKernel(ActiveKernelIsa(), channels_, tapCount_)(samples, frames, channels_, taps_,
+                                                           scale_, error_, rng_);
+  }
+  ConvertSamples(SampleType::kF32, samples, type_, dst, frames * channels_);
+}
+
+void Requantizer::Reset() {
+  std::memset(error_, 0, sizeof(error_));
+  for (uint32_t ch = 0; ch < kMaxChannels; ++ch) rng_[ch] = Seed(ch);
+}
+
+}  // namespace audioengine
@@ -0,0 +1,205 @@
+#include "AudioEngineCore/FeatureScanner.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <iterator>
+#include <utility>
+
+#include "AudioEngineCore/SampleKernels.h"
+#include "CacheFile.h"
+
+namespace audioengine {
+
+using cachefile::Fnv1a32;
+using cachefile::GetLe;
+using cachefile::PutLe;
+
+namespace {
+
+constexpr uint8_t kMagic[4] = {'T', 'N', 'F', 'T'};
+constexpr size_t kHeaderBytes = 48;
+constexpr size_t kValueCount = 11;
+constexpr size_t kTrailerBytes = 4;
+constexpr size_t kFileBytes = kHeaderBytes + kValueCount * 8 + kTrailerBytes;
+constexpr size_t kChunkFrames = 4096;
+
+std::string CachePath(const std::string& cacheDir, const SeekIndex::Key& key) {
+  return cachefile::JoinPath(cacheDir, FeatureScanner::CacheFileName(key));
+}
+
+uint32_t PathHash(const std::string& path) {
+  return Fnv1a32(reinterpret_cast<const uint8_t*>(path.data()), path.size());
+}
+
+uint64_t DoubleBits(double value) {
+  uint64_t bits = 0;
+  std::memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+double BitsDouble(uint64_t bits) {
+  double value = 0.0;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+// The f64 fields of the cache file, in file order.
+std::array<double*, kValueCount> Values(TrackFeatures* features) {
+  return {&features->bpm,
+          &features->tempoConfidence,
+          &features->keyConfidence,
+          &features->energy,
+          &features->danceability,
+          &features->rmsDb,
+          &features->onsetRate,
+          &features->spectralCentroidHz,
+          &features->spectralSpreadHz,
+          &features->spectralRolloffHz,
+          &features->spectralFlatness};
+}
+
+}  // namespace
+
+FeatureScanner::FeatureScanner(std::string cacheDir, OpenFn open, unsigned workers)
+    : cacheDir_(std::move(cacheDir)),
+      open_(std::move(open)),
+      pool_([this](const ScanPool::Job& job,
+                   uint64_t generation) { return Scan(job.key, generation); },
+            workers) {}
+
+void FeatureScanner::Enqueue(const std::vector<SeekIndex::Key>& keys) {
+  std::vector<ScanPool::Job> jobs;
+  jobs.reserve(keys.size());
+  for (const SeekIndex::Key& key : keys) jobs.push_back({key, {}});
+  pool_.Enqueue(jobs);
+}
+
+bool FeatureScanner::Track(const std::string& path, TrackFeatures* result) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const auto it = tracks_.find(path);
+  if (it == tracks_.end()) return false;
+  *result = it->second;
+  return true;
+}
+
+std::string FeatureScanner::CacheFileName(const SeekIndex::Key& key) {
+  return cachefile::CacheFileName(key.path, key.fileSize, key.mtimeSeconds,
+                                  ".features");
+}
+
+FeatureScanner::Stats FeatureScanner::GetStats() const {
+  const ScanPool::Stats pool = pool_.GetStats();
+  Stats stats;
+  stats.tracksAnalyzed = pool.tracksDone;
+  stats.tracksCached = pool.tracksCached;
+  stats.tracksFailed = pool.tracksFailed;
+  stats.tracksPending = pool.tracksPending;
+  stats.audioSeconds = pool.audioSeconds;
+  stats.busySeconds = pool.busySeconds;
+  stats.workers = pool.workers;
+  return stats;
+}
+
+ScanPool::Result FeatureScanner::Scan(const SeekIndex::Key& key, uint64_t generation) {
+  TrackFeatures result;
+  const ScanPool::Outcome outcome = Analyze(key, generation, &result);
+  if (outcome != ScanPool::Outcome::kDone && outcome != ScanPool::Outcome::kCached) {
+    return {outcome};
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  tracks_[key.path] = result;
+  return {outcome, static_cast<double>(result.frames) / result.sampleRate};
+}
+
+ScanPool::Outcome FeatureScanner::Analyze(const SeekIndex::Key& key,
+                                          uint64_t generation,
+                                          TrackFeatures* result) {
+  using Outcome = ScanPool::Outcome;
+  if (LoadCached(key, result)) return Outcome::kCached;
+
+  std::unique_ptr<PcmSource> source = open_ ? open_(key.path) : nullptr;
+  if (!source) return Outcome::kFailed;
+  const PcmFormat format = source->Format();
+  SampleType type;
+  if (format.sampleRate == 0 || format.channels == 0 || !SampleTypeOf(format, &type)) {
+    return Outcome::kFailed;
+  }
+
+  FeatureAnalyzer analyzer;
+  analyzer.Configure(format.sampleRate, format.channels);
+  std::vector<uint8_t> raw(kChunkFrames * format.BytesPerFrame());
+  std::vector<float> samples(type == SampleType::kF32 ? 0 : kChunkFrames * format.channels);
+  size_t got = 0;
+  while ((got = source->ReadFrames(raw.data(), kChunkFrames)) > 0) {
+    if (pool_.Cancelled(generation)) return Outcome::kCancelled;
+    // Float decodes (the engines' usual) are measured in place.
+    const float* in = reinterpret_cast<const float*>(raw.data());
+    if (type != SampleType::kF32) {
+      ConvertSamples(type, raw.data(), SampleType::kF32, samples.data(),
+                     got * format.channels);
+      in = samples.data();
+    }
+    analyzer.Process(in, got);
+  }
+  if (!analyzer.Finish(result)) return Outcome::kFailed;
+  // A failed write only costs a rescan next session.
+  WriteCache(key, *result);
+  return Outcome::kDone;
+}
+
+bool FeatureScanner::WriteCache(const SeekIndex::Key& key,
+                                const TrackFeatures& result) const {
+  if (cacheDir_.empty()) return false;
+  std::vector<uint8_t> out;
+  out.reserve(kFileBytes);
+  out.resize(sizeof(kMagic));
+  std::memcpy(out.data(), kMagic, sizeof(kMagic));
+  PutLe(&out, kFeatureCacheVersion, 2);
+  PutLe(&out, 0, 2);
+  PutLe(&out, key.fileSize, 8);
+  PutLe(&out, static_cast<uint64_t>(key.mtimeSeconds), 8);
+  PutLe(&out, result.sampleRate, 4);
+  PutLe(&out, PathHash(key.path), 4);
+  PutLe(&out, result.frames, 8);
+  PutLe(&out, static_cast<uint32_t>(result.key), 4);
+  PutLe(&out, result.minor ? 1 : 0, 4);
+  TrackFeatures values = result;
+  for (const double* value : Values(&values)) PutLe(&out, DoubleBits(*value), 8);
+  PutLe(&out, Fnv1a32(out.data(), out.size()), 4);
+  return cachefile::WriteAtomically(CachePath(cacheDir_, key), out);
+}
+
+bool FeatureScanner::LoadCached(const SeekIndex::Key& key, TrackFeatures* result) const {
+  std::vector<uint8_t> bytes;
+  if (cacheDir_.empty() || !cachefile::ReadAll(CachePath(cacheDir_, key), &bytes)) {
+    return false;
+  }
+  const uint8_t* data = bytes.data();
+  if (bytes.size() != kFileBytes) return false;
+  const size_t bodyEnd = kFileBytes - kTrailerBytes;
+  if (GetLe(data + bodyEnd, 4) != Fnv1a32(data, bodyEnd)) return false;
+  if (!std::equal(std::begin(kMagic), std::end(kMagic), data)) return false;
+  if (GetLe(data + 4, 2) != kFeatureCacheVersion) return false;
+  if (GetLe(data + 8, 8) != key.fileSize ||
+      static_cast<int64_t>(GetLe(data + 16, 8)) != key.mtimeSeconds ||
+      GetLe(data + 28, 4) != PathHash(key.path)) {
+    return false;
+  }
+
+  TrackFeatures loaded;
+  loaded.sampleRate = static_cast<uint32_t>(GetLe(data + 24, 4));
+  loaded.frames = GetLe(data + 32, 8);
+  loaded.key = static_cast<int32_t>(GetLe(data + 40, 4));
+  loaded.minor = (GetLe(data + 44, 4) & 1) != 0;
+  if (loaded.sampleRate == 0 || loaded.key < -1 || loaded.key > 11) return false;
+  const uint8_t* in = data + kHeaderBytes;
+  for (double* value : Values(&loaded)) {
+    *value = BitsDouble(GetLe(in, 8));
+    in += 8;
+  }
+  *result = loaded;
+  return true;
+}
+
+}  // namespace audioengine
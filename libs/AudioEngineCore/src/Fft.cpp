@@ -0,0 +1,129 @@
+#include "AudioEngineCore/Fft.h"
+
+#include <cmath>
+#include <utility>
+
+namespace audioengine {
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+
+}  // namespace
+
+void RealFft::Configure(size_t size) {
+  size_ = size;
+  const size_t half = size / 2;
+  cos_.resize(half);
+  sin_.resize(half);
+  for (size_t k = 0; k < half; ++k) {
+    const double angle = 2.0 * kPi * static_cast<double>(k) / static_cast<double>(size);
+    cos_[k] = static_cast<float>(std::cos(angle));
+    sin_[k] = static_cast<float>(std::sin(angle));
+  }
+  uint32_t bits = 0;
+  while ((size_t{1} << bits) < half) ++bits;
+  bitReverse_.resize(half);
+  for (size_t i = 0; i < half; ++i) {
+    uint32_t reversed = 0;
+    for (uint32_t b = 0; b < bits; ++b) {
+      reversed |= ((i >> b) & 1u) << (bits - 1 - b);
+    }
+    bitReverse_[i] = reversed;
+  }
+  scratchRe_.assign(half, 0.0f);
+  scratchIm_.assign(half, 0.0f);
+}
+
+void RealFft::Transform(bool inverse) {
+  const size_t n = size_ / 2;
+  float* re = scratchRe_.data();
+  float* im = scratchIm_.data();
+  for (size_t i = 0; i < n; ++i) {
+    const size_t j = bitReverse_[i];
+    if (j > i) {
+      std::swap(re[i], re[j]);
+      std::swap(im[i], im[j]);
+    }
+  }
+  // Radix-2 decimation in time. The twiddle tables are for Size() points,
+  // twice the complex length, hence the doubled stride.
+  const float sign = inverse ? 1.0f : -1.0f;
+  for (size_t len = 2; len <= n; len <<= 1) {
+    const size_t half = len / 2;
+    const size_t stride = 2 * n / len;
+    for (size_t j = 0; j < half; ++j) {
+      const float wr = cos_[j * stride];
+      const float wi = sign * sin_[j * stride];
+      for (size_t i = j; i < n; i += len) {
+        const size_t k = i + half;
+        const float xr = re[k] * wr - im[k] * wi;
+        const float xi = re[k] * wi + im[k] * wr;
+        re[k] = re[i] - xr;
+        im[k] = im[i] - xi;
+        re[i] += xr;
+        im[i] += xi;
+      }
+    }
+  }
+}
+
+void RealFft::Forward(const float* in, float* re, float* im) {
+  const size_t n = size_ / 2;
+  // Even samples as the real part, odd ones as the imaginary part.
+  for (size_t i = 0; i < n; ++i) {
+    scratchRe_[i] = in[2 * i];
+    scratchIm_[i] = in[2 * i + 1];
+  }
+  Transform(false);
+  // Untangle the two half-length spectra: X[k] = E[k] + W^k O[k].
+  re[0] = scratchRe_[0] + scratchIm_[0];
+  im[0] = 0.0f;
+  re[n] = scratchRe_[0] - scratchIm_[0];
+  im[n] = 0.0f;
+  for (size_t k = 1; k < n; ++k) {
+    const float zr = scratchRe_[k];
+    const float zi = scratchIm_[k];
+    const float cr = scratchRe_[n - k];
+    const float ci = -scratchIm_[n - k];
+    const float er = 0.5f * (zr + cr);
+    const float ei = 0.5f * (zi + ci);
+    // O = (Z - conj(Z[n - k])) / 2i
+    const float or_ = 0.5f * (zi - ci);
+    const float oi = -0.5f * (zr - cr);
+    const float wr = cos_[k];
+    const float wi = -sin_[k];
+    re[k] = er + or_ * wr - oi * wi;
+    im[k] = ei + or_ * wi + oi * wr;
+  }
+}
+
+void RealFft::Inverse(const float* re, const float* im, float* out) {
+  const size_t n = size_ / 2;
+  // Rebuild the half-length spectrum Z = E + i O, doubled so the unscaled
+  // transform below comes out at Size() * x.
+  for (size_t k = 0; k < n; ++k) {
+    const float xr = re[k];
+    const float xi = k == 0 ? 0.0f : im[k];
+    const float cr = re[n - k];
+    const float ci = n - k == n ? 0.0f : -im[n - k];
+    const float er = xr + cr;
+    const float ei = xi + ci;
+    const float dr = xr - cr;
+    const float di = xi - ci;
+    // O = (X - conj(X[n - k])) * W^-k
+    const float wr = cos_[k];
+    const float wi = sin_[k];
+    const float or_ = dr * wr - di * wi;
+    const float oi = dr * wi + di * wr;
+    scratchRe_[k] = er - oi;
+    scratchIm_[k] = ei + or_;
+  }
+  Transform(true);
+  for (size_t i = 0; i < n; ++i) {
+    out[2 * i] = scratchRe_[i];
+    out[2 * i + 1] = scratchIm_[i];
+  }
+}
+
+}  // namespace audioengine
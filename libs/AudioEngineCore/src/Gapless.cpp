@@ -0,0 +1,219 @@
+#include "AudioEngineCore/Gapless.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <sstream>
+#include <utility>
+
+namespace audioengine {
+
+namespace {
+
+uint32_t ReadBe32(const uint8_t* p) {
+  return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+         (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]);
+}
+
+bool ParseHex(const std::string& token, uint64_t* value) {
+  if (token.empty() || token.size() > 16) return false;
+  uint64_t result = 0;
+  for (char c : token) {
+    if (!std::isxdigit(static_cast<unsigned char>(c))) return false;
+    const int digit = std::isdigit(static_cast<unsigned char>(c))
+                          ? c - '0'
+                          : std::tolower(static_cast<unsigned char>(c)) - 'a' + 10;
+    result = (result << 4) | static_cast<uint64_t>(digit);
+  }
+  *value = result;
+  return true;
+}
+
+// Size of a leading ID3v2 tag, including header and footer, or 0.
+size_t Id3v2Size(const uint8_t* data, size_t size) {
+  if (size < 10 || memcmp(data, "ID3", 3) != 0) return 0;
+  const size_t body = (static_cast<size_t>(data[6] & 0x7f) << 21) |
+                      (static_cast<size_t>(data[7] & 0x7f) << 14) |
+                      (static_cast<size_t>(data[8] & 0x7f) << 7) |
+                      static_cast<size_t>(data[9] & 0x7f);
+  const bool hasFooter = (data[5] & 0x10) != 0;
+  return 10 + body + (hasFooter ? 10 : 0);
+}
+
+}  // namespace
+
+bool ParseITunSMPB(const std::string& value, GaplessInfo* info) {
+  std::istringstream fields(value);
+  std::string reserved, delay, padding, length;
+  if (!(fields >> reserved >> delay >> padding >> length)) return false;
+  uint64_t delayFrames = 0;
+  uint64_t paddingFrames = 0;
+  uint64_t validFrames = 0;
+  if (!ParseHex(delay, &delayFrames) || !ParseHex(padding, &paddingFrames) ||
+      !ParseHex(length, &validFrames)) {
+    return false;
+  }
+  if (delayFrames == 0 && paddingFrames == 0 && validFrames == 0) return false;
+  info->leadingFrames = delayFrames;
+  info->trailingFrames = paddingFrames;
+  info->validFrames = validFrames;
+  return true;
+}
+
+bool ParseLameHeader(const uint8_t* data, size_t size, GaplessInfo* info) {
+  size_t pos = Id3v2Size(data, size);
+  if (pos + 4 > size) return false;
+  const uint8_t* frame = data + pos;
+  // Frame sync, layer III, valid bit rate and sample rate indices.
+  if (frame[0] != 0xff || (frame[1] & 0xe0) != 0xe0) return false;
+  const int version = (frame[1] >> 3) & 0x03;  // 3 = MPEG-1, 2 = MPEG-2, 0 = 2.5
+  const int layer = (frame[1] >> 1) & 0x03;    // 1 = layer III
+  if (version == 1 || layer != 1) return false;
+  if ((frame[2] >> 4) == 0x0f || ((frame[2] >> 2) & 0x03) == 0x03) return false;
+  const bool mpeg1 = version == 3;
+  const bool mono = (frame[3] >> 6) == 0x03;
+  const size_t sideInfo = mpeg1 ? (mono ? 17 : 32) : (mono ? 9 : 17);
+  const uint64_t samplesPerFrame = mpeg1 ? 1152 : 576;
+
+  // A cleared protection bit means a 16-bit CRC follows the header.
+  const size_t crc = (frame[1] & 0x01) == 0 ? 2 : 0;
+  size_t tag = pos + 4 + crc + sideInfo;
+  if (tag + 8 > size) return false;
+  if (memcmp(data + tag, "Xing", 4) != 0 && memcmp(data + tag, "Info", 4) != 0) {
+    return false;
+  }
+  const uint32_t flags = ReadBe32(data + tag + 4);
+  size_t cursor = tag + 8;
+  uint64_t frames = 0;
+  if (flags & 0x1) {
+    if (cursor + 4 > size) return false;
+    frames = ReadBe32(data + cursor);
+    cursor += 4;
+  }
+  if (flags & 0x2) cursor += 4;    // byte count
+  if (flags & 0x4) cursor += 100;  // seek TOC
+  if (flags & 0x8) cursor += 4;    // quality
+
+  // LAME extension: 9-byte encoder string, then delay/padding 21 bytes in.
+  if (cursor + 24 > size) return false;
+  const uint8_t* lame = data + cursor;
+  if (memcmp(lame, "LAME", 4) != 0 && memcmp(lame, "Lavc", 4) != 0 &&
+      memcmp(lame, "Lavf", 4) != 0) {
+    return false;
+  }
+  const uint64_t encoderDelay =
+      (static_cast<uint64_t>(lame[21]) << 4) | (lame[22] >> 4);
+  const uint64_t encoderPadding =
+      (static_cast<uint64_t>(lame[22] & 0x0f) << 8) | lame[23];
+
+  info->leadingFrames = encoderDelay + kMp3DecoderDelay;
+  info->trailingFrames =
+      encoderPadding > kMp3DecoderDelay ? encoderPadding - kMp3DecoderDelay : 0;
+  const uint64_t decoded = frames * samplesPerFrame;
+  info->validFrames = decoded > encoderDelay + encoderPadding
+                          ? decoded - encoderDelay - encoderPadding
+                          : 0;
+  return true;
+}
+
+TrimmingSource::TrimmingSource(std::unique_ptr<PcmSource> inner,
+                               const GaplessInfo& info)
+    : inner_(std::move(inner)),
+      info_(info),
+      bytesPerFrame_(inner_->Format().BytesPerFrame()) {
+  if (info_.validFrames == 0 && info_.trailingFrames > 0) {
+    held_.resize(static_cast<size_t>(info_.trailingFrames) * bytesPerFrame_);
+  }
+}
+
+uint64_t TrimmingSource::TotalFrames() const {
+  if (info_.validFrames > 0) return info_.validFrames;
+  const uint64_t total = inner_->TotalFrames();
+  const uint64_t trimmed = info_.leadingFrames + info_.trailingFrames;
+  return total > trimmed ? total - trimmed : 0;
+}
+
+size_t TrimmingSource::ReadFrames(uint8_t* dst, size_t maxFrames) {
+  if (maxFrames == 0) return 0;
+  // Priming samples, and anything a fast seek landed on before them.
+  while (innerPosition_ < info_.leadingFrames) {
+    const size_t skip = static_cast<size_t>(
+        std::min<uint64_t>(maxFrames, info_.leadingFrames - innerPosition_));
+    const size_t got = inner_->ReadFrames(dst, skip);
+    if (got == 0) return 0;
+    innerPosition_ += got;
+  }
+
+  if (info_.validFrames > 0) {
+    const uint64_t end = info_.leadingFrames + info_.validFrames;
+    if (innerPosition_ >= end) return 0;
+    const size_t want = static_cast<size_t>(
+        std::min<uint64_t>(maxFrames, end - innerPosition_));
+    const size_t got = inner_->ReadFrames(dst, want);
+    innerPosition_ += got;
+    return got;
+  }
+  if (!held_.empty()) return ReadHoldingBack(dst, maxFrames);
+
+  const size_t got = inner_->ReadFrames(dst, maxFrames);
+  innerPosition_ += got;
+  return got;
+}
+
+size_t TrimmingSource::ReadHoldingBack(uint8_t* dst, size_t maxFrames) {
+  // held_ is a full-or-filling FIFO of the newest `capacity` frames. Once it
+  // is full, every incoming frame pushes the oldest one out to the caller,
+  // so the last `capacity` frames of the stream are never emitted.
+  const size_t capacity = static_cast<size_t>(info_.trailingFrames);
+  const size_t bpf = bytesPerFrame_;
+  size_t out = 0;
+  while (out == 0) {
+    const size_t got = inner_->ReadFrames(dst, maxFrames);
+    if (got == 0) return 0;  // what is left in held_ is padding
+    innerPosition_ += got;
+
+    size_t in = 0;
+    while (in < got) {
+      const size_t head = heldHead_;
+      if (heldFrames_ < capacity) {
+        // Filling: append at the tail, no output yet.
+        const size_t tail = (head + heldFrames_) % capacity;
+        const size_t n = std::min({got - in, capacity - heldFrames_, capacity - tail});
+        memcpy(held_.data() + tail * bpf, dst + in * bpf, n * bpf);
+        heldFrames_ += n;
+        in += n;
+        continue;
+      }
+      // Full: swap the incoming block with the oldest held block, then move
+      // the old frames down to the output position.
+      const size_t n = std::min(got - in, capacity - head);
+      std::swap_ranges(held_.data() + head * bpf, held_.data() + (head + n) * bpf,
+                       dst + in * bpf);
+      memmove(dst + out * bpf, dst + in * bpf, n * bpf);
+      heldHead_ = (head + n) % capacity;
+      out += n;
+      in += n;
+    }
+  }
+  return out;
+}
+
+bool TrimmingSource::SeekToFrame(uint64_t frame, SeekMode mode,
+                                 uint64_t* landedFrame) {
+  if (info_.validFrames > 0) frame = std::min(frame, info_.validFrames);
+  uint64_t innerLanded = frame + info_.leadingFrames;
+  if (!inner_->SeekToFrame(frame + info_.leadingFrames, mode, &innerLanded)) {
+    return false;
+  }
+  innerPosition_ = innerLanded;
+  heldFrames_ = 0;
+  heldHead_ = 0;
+  if (landedFrame) {
+    *landedFrame = innerLanded > info_.leadingFrames
+                       ? innerLanded - info_.leadingFrames
+                       : 0;
+  }
+  return true;
+}
+
+}  // namespace audioengine
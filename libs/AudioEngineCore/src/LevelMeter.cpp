@@ -0,0 +1,297 @@
+#include "AudioEngineCore/LevelMeter.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "Simd.h"
+
+namespace audioengine {
+
+namespace {
+
+// Frames converted and reduced per pass; also the ballistics step.
+constexpr size_t kChunkFrames = 256;
+// lcm(channels, 4) for up to kMaxChannels: the samples after which the
+// channel in each SIMD lane repeats.
+constexpr uint32_t kMaxPeriod = 28;
+// Levels under -120 dB snap to silence, so the decay ends and does not run
+// on denormals.
+constexpr float kSilence = 1e-6f;
+constexpr double kLn10 = 2.302585092994046;
+
+uint32_t LanePeriod(uint32_t channels) {
+  uint32_t period = channels;
+  while (period % 4 != 0) period += channels;
+  return period;
+}
+
+// Reduces `count` samples, a whole number of `period`s, into lane
+// accumulators: lane i of each period takes samples i, i + period, ...
+// `peaks` and `sums` hold `period` values.
+using ReduceFn = void (*)(const float* samples, size_t count, uint32_t period,
+                          float* peaks, float* sums);
+
+void ReduceScalar(const float* samples, size_t count, uint32_t period, float* peaks,
+                  float* sums) {
+  for (size_t i = 0; i < count; i += period) {
+    for (uint32_t lane = 0; lane < period; ++lane) {
+      const float v = samples[i + lane];
+      const float a = std::fabs(v);
+      peaks[lane] = a > peaks[lane] ? a : peaks[lane];
+      sums[lane] += v * v;
+    }
+  }
+}
+
+#if AUDIOENGINE_HAVE_SSE2
+template <uint32_t kVectors>
+void ReduceSse2(const float* samples, size_t count, uint32_t, float* peaks, float* sums) {
+  const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+  __m128 peak[kVectors];
+  __m128 sum[kVectors];
+  for (uint32_t v = 0; v < kVectors; ++v) {
+    peak[v] = _mm_loadu_ps(peaks + 4 * v);
+    sum[v] = _mm_loadu_ps(sums + 4 * v);
+  }
+  for (size_t i = 0; i < count; i += 4 * kVectors) {
+    for (uint32_t v = 0; v < kVectors; ++v) {
+      const __m128 x = _mm_loadu_ps(samples + i + 4 * v);
+      peak[v] = _mm_max_ps(peak[v], _mm_and_ps(x, absMask));
+      sum[v] = _mm_add_ps(sum[v], _mm_mul_ps(x, x));
+    }
+  }
+  for (uint32_t v = 0; v < kVectors; ++v) {
+    _mm_storeu_ps(peaks + 4 * v, peak[v]);
+    _mm_storeu_ps(sums + 4 * v, sum[v]);
+  }
+}
+#endif
+
+#if AUDIOENGINE_HAVE_NEON64
+template <uint32_t kVectors>
+void ReduceNeon(const float* samples, size_t count, uint32_t, float* peaks, float* sums) {
+  float32x4_t peak[kVectors];
+  float32x4_t sum[kVectors];
+  for (uint32_t v = 0; v < kVectors; ++v) {
+    peak[v] = vld1q_f32(peaks + 4 * v);
+    sum[v] = vld1q_f32(sums + 4 * v);
+  }
+  for (size_t i = 0; i < count; i += 4 * kVectors) {
+    for (uint32_t v = 0; v < kVectors; ++v) {
+      const float32x4_t x = vld1q_f32(samples + i + 4 * v);
+      peak[v] = vmaxq_f32(peak[v], vabsq_f32(x));
+      sum[v] = vfmaq_f32(sum[v], x, x);
+    }
+  }
+  for (uint32_t v = 0; v < kVectors; ++v) {
+    vst1q_f32(peaks + 4 * v, peak[v]);
+    vst1q_f32(sums + 4 * v, sum[v]);
+  }
+}
+#endif
+
+// Periods are 4 (1, 2 and 4 channels), 8, 12, 20 or 28 samples; each
+// vector kernel keeps a whole period in registers.
+#if AUDIOENGINE_HAVE_SSE2
+ReduceFn Sse2Kernel(uint32_t period) {
+  switch (period / 4) {
+    case 1: return ReduceSse2<1>;
+    case 2: return ReduceSse2<2>;
+    case 3: return ReduceSse2<3>;
+    case 5: return ReduceSse2<5>;
+    case 7: return ReduceSse2<7>;
+    default: return ReduceScalar;
+  }
+}
+#endif
+
+#if AUDIOENGINE_HAVE_NEON64
+ReduceFn NeonKernel(uint32_t period) {
+  switch (period / 4) {
+    case 1: return ReduceNeon<1>;
+    case 2: return ReduceNeon<2>;
+    case 3: return ReduceNeon<3>;
+    case 5: return ReduceNeon<5>;
+    case 7: return ReduceNeon<7>;
+    default: return ReduceScalar;
+  }
+}
+#endif
+
+ReduceFn SelectKernel(KernelIsa isa, uint32_t period) {
+  switch (isa) {
+#if AUDIOENGINE_HAVE_SSE2
+    // Peak and sum take two registers per four lanes, and a 28-sample
+    // period already needs 14; wider vectors would not fit.
+    case KernelIsa::kAvx2:
+    case KernelIsa::kSse2: return Sse2Kernel(period);
+#endif
+#if AUDIOENGINE_HAVE_NEON64
+    case KernelIsa::kNeon: return NeonKernel(period);
+#endif
+    default: return ReduceScalar;
+  }
+}
+
+float PowerDb(float power) {
+  return power > kSilence * kSilence ? std::max(10.0f * std::log10(power), LevelMeter::kFloorDb)
+                                     : LevelMeter::kFloorDb;
+}
+
+float AmplitudeDb(float amplitude) { return PowerDb(amplitude * amplitude); }
+
+}  // namespace
+
+LevelMeter::LevelMeter()
+    : holdMs_(Options{}.holdMs),
+      decayDbPerSecond_(Options{}.decayDbPerSecond),
+      rmsWindowMs_(Options{}.rmsWindowMs),
+      truePeak_(Options{}.truePeak) {}
+
+bool LevelMeter::Configure(const PcmFormat& format) {
+  SampleType type;
+  if (format.sampleRate == 0 || format.channels == 0 || format.channels > kMaxChannels ||
+      !SampleTypeOf(format, &type)) {
+    sampleRate_ = 0;
+    channels_ = 0;
+    Reset();
+    return false;
+  }
+  sampleRate_ = format.sampleRate;
+  channels_ = format.channels;
+  type_ = type;
+  converted_.assign(type == SampleType::kF32 ? 0 : kChunkFrames * channels_, 0.0f);
+  detector_.Configure(channels_);
+  levels_.sequence = 0;
+  Reset();
+  return true;
+}
+
+void LevelMeter::SetOptions(const Options& options) {
+  holdMs_.store(std::max(options.holdMs, 0.0), std::memory_order_relaxed);
+  decayDbPerSecond_.store(std::max(options.decayDbPerSecond, 0.0), std::memory_order_relaxed);
+  rmsWindowMs_.store(std::max(options.rmsWindowMs, 1.0), std::memory_order_relaxed);
+  truePeak_.store(options.truePeak, std::memory_order_relaxed);
+}
+
+LevelMeter::Options LevelMeter::GetOptions() const {
+  Options options;
+  options.holdMs = holdMs_.load(std::memory_order_relaxed);
+  options.decayDbPerSecond = decayDbPerSecond_.load(std::memory_order_relaxed);
+  options.rmsWindowMs = rmsWindowMs_.load(std::memory_order_relaxed);
+  options.truePeak = truePeak_.load(std::memory_order_relaxed);
+  return options;
+}
+
+void LevelMeter::Reset() {
+  const uint64_t sequence = levels_.sequence;
+  levels_ = Levels{};
+  levels_.sequence = sequence;
+  levels_.channels = channels_;
+  std::fill(std::begin(holdAge_), std::end(holdAge_), 0.0);
+  detectorPrimed_ = false;
+  Publish();
+}
+
+void LevelMeter::Process(const void* samples, size_t frames) {
+  if (channels_ == 0 || frames == 0) return;
+  const Options options = GetOptions();
+  if (!options.truePeak) {
+    detectorPrimed_ = false;
+  } else if (!detectorPrimed_) {
+    // Stale history would smear the last block before true peak went off
+    // into the first one after.
+    detector_.Reset();
+    detectorPrimed_ = true;
+  }
+
+  const uint32_t period = LanePeriod(channels_);
+  const ReduceFn reduce = SelectKernel(ActiveKernelIsa(), period);
+  const size_t bytesPerFrame = static_cast<size_t>(BytesPerSample(type_)) * channels_;
+  const uint8_t* in = static_cast<const uint8_t*>(samples);
+  while (frames > 0) {
+    const size_t n = std::min(frames, kChunkFrames);
+    const size_t count = n * channels_;
+    const float* chunk = reinterpret_cast<const float*>(in);
+    if (type_ != SampleType::kF32) {
+      ConvertSamples(type_, in, SampleType::kF32, converted_.data(), count);
+      chunk = converted_.data();
+    }
+
+    float lanePeaks[kMaxPeriod] = {};
+    float laneSums[kMaxPeriod] = {};
+    const size_t whole = count - count % period;
+    reduce(chunk, whole, period, lanePeaks, laneSums);
+    ReduceScalar(chunk + whole, count - whole, count - whole, lanePeaks, laneSums);
+    float peaks[kMaxChannels] = {};
+    float sums[kMaxChannels] = {};
+    for (uint32_t lane = 0; lane < period; ++lane) {
+      const uint32_t ch = lane % channels_;
+      peaks[ch] = std::max(peaks[ch], lanePeaks[lane]);
+      sums[ch] += laneSums[lane];
+    }
+
+    float truePeaks[kMaxChannels] = {};
+    if (options.truePeak) {
+      for (size_t f = 0; f < n; ++f) detector_.Accumulate(chunk + f * channels_, truePeaks);
+    }
+    Update(peaks, sums, truePeaks, n, static_cast<double>(n) / sampleRate_, options);
+    in += n * bytesPerFrame;
+    frames -= n;
+  }
+  ++levels_.sequence;
+  Publish();
+}
+
+void LevelMeter::Update(const float* chunkPeak, const float* chunkSumSquares,
+                        const float* chunkTruePeak, size_t frames, double seconds,
+                        const Options& options) {
+  const float decay =
+      static_cast<float>(std::exp(-options.decayDbPerSecond * kLn10 / 20.0 * seconds));
+  const float keep = static_cast<float>(std::exp(-seconds * 1000.0 / options.rmsWindowMs));
+  const double holdSeconds = options.holdMs / 1000.0;
+  for (uint32_t ch = 0; ch < channels_; ++ch) {
+    float& peak = levels_.peak[ch];
+    float& hold = levels_.hold[ch];
+    peak = std::max(chunkPeak[ch], peak * decay);
+    if (chunkPeak[ch] >= hold) {
+      hold = chunkPeak[ch];
+      holdAge_[ch] = 0.0;
+    } else {
+      holdAge_[ch] += seconds;
+      if (holdAge_[ch] > holdSeconds) hold = std::max(hold * decay, peak);
+    }
+
+    const float meanSquare = chunkSumSquares[ch] / static_cast<float>(frames);
+    float& rms = levels_.meanSquare[ch];
+    rms = meanSquare + keep * (rms - meanSquare);
+
+    float& truePeak = levels_.truePeak[ch];
+    truePeak = std::max(chunkTruePeak[ch], truePeak * decay);
+    levels_.maxTruePeak[ch] = std::max(levels_.maxTruePeak[ch], chunkTruePeak[ch]);
+
+    if (peak < kSilence) peak = 0.0f;
+    if (hold < kSilence) hold = 0.0f;
+    if (rms < kSilence * kSilence) rms = 0.0f;
+    if (truePeak < kSilence) truePeak = 0.0f;
+  }
+}
+
+void LevelMeter::Publish() { published_.Store(levels_); }
+
+LevelMeterReading LevelMeter::Read() const {
+  const Levels levels = published_.Load();
+  LevelMeterReading reading;
+  reading.sequence = levels.sequence;
+  reading.channels = levels.channels;
+  for (uint32_t ch = 0; ch < kMaxChannels; ++ch) {
+    reading.peakDb[ch] = AmplitudeDb(levels.peak[ch]);
+    reading.peakHoldDb[ch] = AmplitudeDb(levels.hold[ch]);
+    reading.rmsDb[ch] = PowerDb(levels.meanSquare[ch]);
+    reading.truePeakDb[ch] = AmplitudeDb(levels.truePeak[ch]);
+    reading.maxTruePeakDb[ch] = AmplitudeDb(levels.maxTruePeak[ch]);
+  }
+  return reading;
+}
+
+}  // namespace audioengine
@@ -0,0 +1,225 @@
+#include "AudioEngineCore/LoudnessMeter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace audioengine {
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+constexpr double kIntegratedGateLu = -10.0;
+constexpr double kRangeGateLu = -20.0;
+// Momentary blocks are 4 sub-blocks, short-term blocks 30, the latter taken
+// every 10 sub-blocks.
+constexpr uint32_t kMomentarySubBlocks = 4;
+constexpr uint32_t kShortTermSubBlocks = 30;
+constexpr uint32_t kShortTermHop = 10;
+// Filter state this small is flushed so silence does not run on denormals.
+constexpr double kDenormalFloor = 1e-20;
+
+}  // namespace
+
+double LoudnessOfEnergy(double energy) {
+  if (energy <= 0.0) return -std::numeric_limits<double>::infinity();
+  return -0.691 + 10.0 * std::log10(energy);
+}
+
+LoudnessHistogram::LoudnessHistogram() : counts_(kBins, 0), energy_(kBins, 0.0) {}
+
+void LoudnessHistogram::Clear() {
+  std::fill(counts_.begin(), counts_.end(), 0u);
+  std::fill(energy_.begin(), energy_.end(), 0.0);
+}
+
+void LoudnessHistogram::Add(double energy) {
+  const double lufs = LoudnessOfEnergy(energy);
+  if (!(lufs >= kFloorLufs)) return;
+  const uint32_t bin = std::min<uint32_t>(
+      kBins - 1, static_cast<uint32_t>((lufs - kFloorLufs) * kBinsPerLu));
+  ++counts_[bin];
+  energy_[bin] += energy;
+}
+
+void LoudnessHistogram::Merge(const LoudnessHistogram& other) {
+  for (uint32_t i = 0; i < kBins; ++i) {
+    counts_[i] += other.counts_[i];
+    energy_[i] += other.energy_[i];
+  }
+}
+
+uint64_t LoudnessHistogram::Count() const {
+  uint64_t count = 0;
+  for (uint32_t c : counts_) count += c;
+  return count;
+}
+
+void LoudnessHistogram::SetBin(uint32_t bin, uint32_t count, double energy) {
+  if (bin >= kBins) return;
+  counts_[bin] = count;
+  energy_[bin] = energy;
+}
+
+double LoudnessHistogram::BinLoudness(uint32_t bin) const {
+  return LoudnessOfEnergy(energy_[bin] / counts_[bin]);
+}
+
+double LoudnessHistogram::IntegratedLufs() const {
+  uint64_t count = 0;
+  double energy = 0.0;
+  for (uint32_t i = 0; i < kBins; ++i) {
+    count += counts_[i];
+    energy += energy_[i];
+  }
+  if (count == 0) return -std::numeric_limits<double>::infinity();
+  const double gate = LoudnessOfEnergy(energy / count) + kIntegratedGateLu;
+
+  uint64_t gatedCount = 0;
+  double gatedEnergy = 0.0;
+  for (uint32_t i = 0; i < kBins; ++i) {
+    if (counts_[i] == 0 || BinLoudness(i) < gate) continue;
+    gatedCount += counts_[i];
+    gatedEnergy += energy_[i];
+  }
+  // The block that set the mean is always above a gate 10 LU under it.
+  return LoudnessOfEnergy(gatedEnergy / gatedCount);
+}
+
+double LoudnessHistogram::RangeLu() const {
+  uint64_t count = 0;
+  double energy = 0.0;
+  for (uint32_t i = 0; i < kBins; ++i) {
+    count += counts_[i];
+    energy += energy_[i];
+  }
+  if (count == 0) return 0.0;
+  const double gate = LoudnessOfEnergy(energy / count) + kRangeGateLu;
+
+  uint64_t gatedCount = 0;
+  for (uint32_t i = 0; i < kBins; ++i) {
+    if (counts_[i] != 0 && BinLoudness(i) >= gate) gatedCount += counts_[i];
+  }
+  // Nearest-rank percentiles over the gated blocks, lowest first.
+  const uint64_t lowRank = static_cast<uint64_t>((gatedCount - 1) * 0.10 + 0.5);
+  const uint64_t highRank = static_cast<uint64_t>((gatedCount - 1) * 0.95 + 0.5);
+  double low = 0.0;
+  double high = 0.0;
+  uint64_t seen = 0;
+  for (uint32_t i = 0; i < kBins; ++i) {
+    if (counts_[i] == 0 || BinLoudness(i) < gate) continue;
+    const uint64_t next = seen + counts_[i];
+    if (lowRank >= seen && lowRank < next) low = BinLoudness(i);
+    if (highRank >= seen && highRank < next) high = BinLoudness(i);
+    seen = next;
+  }
+  return high - low;
+}
+
+void LoudnessMeter::Configure(uint32_t sampleRate, uint32_t channels) {
+  channels_ = channels;
+  subBlockFrames_ = std::max<uint32_t>(1, (sampleRate + 5) / 10);
+
+  // Coefficients re-derived for the actual rate from the analog prototypes
+  // behind the 48 kHz tables in BS.1770.
+  const double rate = static_cast<double>(sampleRate);
+  {
+    const double f0 = 1681.974450955533;
+    const double gainDb = 3.999843853973347;
+    const double q = 0.7071752369554196;
+    const double k = std::tan(kPi * f0 / rate);
+    const double vh = std::pow(10.0, gainDb / 20.0);
+    const double vb = std::pow(vh, 0.4996667741545416);
+    const double a0 = 1.0 + k / q + k * k;
+    shelf_.b0 = (vh + vb * k / q + k * k) / a0;
+    shelf_.b1 = 2.0 * (k * k - vh) / a0;
+    shelf_.b2 = (vh - vb * k / q + k * k) / a0;
+    shelf_.a1 = 2.0 * (k * k - 1.0) / a0;
+    shelf_.a2 = (1.0 - k / q + k * k) / a0;
+  }
+  {
+    const double f0 = 38.13547087602444;
+    const double q = 0.5003270373238773;
+    const double k = std::tan(kPi * f0 / rate);
+    const double a0 = 1.0 + k / q + k * k;
+    highPass_.b0 = 1.0;
+    highPass_.b1 = -2.0;
+    highPass_.b2 = 1.0;
+    highPass_.a1 = 2.0 * (k * k - 1.0) / a0;
+    highPass_.a2 = (1.0 - k / q + k * k) / a0;
+  }
+
+  weights_.assign(channels, 1.0);
+  if (channels == 5) {
+    weights_[3] = weights_[4] = 1.41;
+  } else if (channels == 6) {
+    weights_[3] = 0.0;
+    weights_[4] = weights_[5] = 1.41;
+  }
+  state_.assign(static_cast<size_t>(channels) * 4, 0.0);
+  subBlocks_.assign(kShortTermSubBlocks, 0.0);
+  detector_.Configure(channels);
+  Reset();
+}
+
+void LoudnessMeter::Reset() {
+  std::fill(state_.begin(), state_.end(), 0.0);
+  std::fill(subBlocks_.begin(), subBlocks_.end(), 0.0);
+  subBlockEnergy_ = 0.0;
+  subBlockFill_ = 0;
+  subBlockCount_ = 0;
+  detector_.Reset();
+  truePeak_ = 0.0f;
+  frames_ = 0;
+  blocks_.Clear();
+  shortTerm_.Clear();
+}
+
+void LoudnessMeter::Process(const float* samples, size_t frames) {
+  if (channels_ == 0) return;
+  for (size_t f = 0; f < frames; ++f) {
+    const float* frame = samples + f * channels_;
+    double energy = 0.0;
+    for (uint32_t ch = 0; ch < channels_; ++ch) {
+      double* z = state_.data() + static_cast<size_t>(ch) * 4;
+      const double x = frame[ch];
+      const double y = shelf_.b0 * x + z[0];
+      z[0] = shelf_.b1 * x - shelf_.a1 * y + z[1];
+      z[1] = shelf_.b2 * x - shelf_.a2 * y;
+      const double w = highPass_.b0 * y + z[2];
+      z[2] = highPass_.b1 * y - highPass_.a1 * w + z[3];
+      z[3] = highPass_.b2 * y - highPass_.a2 * w;
+      energy += weights_[ch] * w * w;
+    }
+    subBlockEnergy_ += energy;
+    truePeak_ = std::max(truePeak_, detector_.Push(frame));
+    if (++subBlockFill_ == subBlockFrames_) FinishSubBlock();
+  }
+  frames_ += frames;
+}
+
+void LoudnessMeter::FinishSubBlock() {
+  subBlocks_[subBlockCount_ % kShortTermSubBlocks] = subBlockEnergy_;
+  ++subBlockCount_;
+  subBlockEnergy_ = 0.0;
+  subBlockFill_ = 0;
+  for (double& z : state_) {
+    if (std::fabs(z) < kDenormalFloor) z = 0.0;
+  }
+
+  if (subBlockCount_ >= kMomentarySubBlocks) {
+    double sum = 0.0;
+    for (uint32_t i = 1; i <= kMomentarySubBlocks; ++i) {
+      sum += subBlocks_[(subBlockCount_ - i) % kShortTermSubBlocks];
+    }
+    blocks_.Add(sum / (static_cast<double>(kMomentarySubBlocks) * subBlockFrames_));
+  }
+  if (subBlockCount_ >= kShortTermSubBlocks &&
+      (subBlockCount_ - kShortTermSubBlocks) % kShortTermHop == 0) {
+    double sum = 0.0;
+    for (double e : subBlocks_) sum += e;
+    shortTerm_.Add(sum / (static_cast<double>(kShortTermSubBlocks) * subBlockFrames_));
+  }
+}
+
+}  // namespace audioengine
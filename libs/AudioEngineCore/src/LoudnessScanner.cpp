@@ -0,0 +1,335 @@
+#include "AudioEngineCore/LoudnessScanner.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <utility>
+
+#include "AudioEngineCore/SampleKernels.h"
+#include "CacheFile.h"
+
+namespace audioengine {
+
+using cachefile::Fnv1a32;
+using cachefile::GetLe;
+using cachefile::GetVarint;
+using cachefile::PutLe;
+using cachefile::PutVarint;
+
+namespace {
+
+constexpr uint8_t kMagic[4] = {'T', 'N', 'L', 'D'};
+constexpr size_t kHeaderBytes = 64;
+constexpr size_t kTrailerBytes = 4;
+constexpr size_t kChunkFrames = 4096;
+// ReplayGain 2.0 reference loudness.
+constexpr double kReplayGainReferenceLufs = -18.0;
+
+std::string CachePath(const std::string& cacheDir, const SeekIndex::Key& key) {
+  return cachefile::JoinPath(cacheDir, LoudnessScanner::CacheFileName(key));
+}
+
+uint32_t PathHash(const std::string& path) {
+  return Fnv1a32(reinterpret_cast<const uint8_t*>(path.data()), path.size());
+}
+
+uint64_t DoubleBits(double value) {
+  uint64_t bits = 0;
+  std::memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+double BitsDouble(uint64_t bits) {
+  double value = 0.0;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+void PutHistogram(std::vector<uint8_t>* out, const LoudnessHistogram& histogram) {
+  uint32_t used = 0;
+  for (uint32_t i = 0; i < LoudnessHistogram::kBins; ++i) {
+    if (histogram.CountAt(i) != 0) ++used;
+  }
+  PutVarint(out, used);
+  uint32_t prev = 0;
+  for (uint32_t i = 0; i < LoudnessHistogram::kBins; ++i) {
+    if (histogram.CountAt(i) == 0) continue;
+    PutVarint(out, i - prev);
+    PutVarint(out, histogram.CountAt(i));
+    PutLe(out, DoubleBits(histogram.EnergyAt(i)), 8);
+    prev = i;
+  }
+}
+
+bool GetHistogram(const uint8_t** in, const uint8_t* end,
+                  LoudnessHistogram* histogram) {
+  uint64_t used = 0;
+  if (!GetVarint(in, end, &used) || used > LoudnessHistogram::kBins) return false;
+  uint64_t bin = 0;
+  for (uint64_t i = 0; i < used; ++i) {
+    uint64_t delta = 0;
+    uint64_t count = 0;
+    if (!GetVarint(in, end, &delta) || !GetVarint(in, end, &count)) return false;
+    if ((i > 0 && delta == 0) || count == 0 || count > UINT32_MAX) return false;
+    bin += delta;
+    if (bin >= LoudnessHistogram::kBins || end - *in < 8) return false;
+    const double energy = BitsDouble(GetLe(*in, 8));
+    *in += 8;
+    if (!(energy > 0.0)) return false;
+    if (histogram) histogram->SetBin(static_cast<uint32_t>(bin),
+                                     static_cast<uint32_t>(count), energy);
+  }
+  return true;
+}
+
+// Decoded samples to float for the meter. False for layouts the engines
+// never produce.
+bool ToFloat(const PcmFormat& format, const uint8_t* in, size_t samples, float* out) {
+  SampleType type;
+  if (!SampleTypeOf(format, &type)) return false;
+  ConvertSamples(type, in, SampleType::kF32, out, samples);
+  return true;
+}
+
+}  // namespace
+
+ReplayGainTags ReplayGainFromLoudness(const TrackLoudness& track,
+                                      const AlbumLoudness* album) {
+  ReplayGainTags tags;
+  if (!track.Silent()) {
+    tags.trackGainDb = kReplayGainReferenceLufs - track.integratedLufs;
+    if (track.truePeak > 0.0) tags.trackPeak = track.truePeak;
+  }
+  if (album && album->integratedLufs > LoudnessHistogram::kFloorLufs) {
+    tags.albumGainDb = kReplayGainReferenceLufs - album->integratedLufs;
+    if (album->truePeak > 0.0) tags.albumPeak = album->truePeak;
+  }
+  return tags;
+}
+
+LoudnessScanner::LoudnessScanner(std::string cacheDir, OpenFn open, unsigned workers)
+    : cacheDir_(std::move(cacheDir)),
+      open_(std::move(open)),
+      pool_([this](const ScanPool::Job& job, uint64_t generation) {
+        return Scan(job, generation);
+      }, workers) {}
+
+void LoudnessScanner::Enqueue(const std::vector<Item>& items) {
+  std::vector<ScanPool::Job> jobs;
+  jobs.reserve(items.size());
+  for (const Item& item : items) jobs.push_back({item.key, item.album});
+  // Held across the pool's Enqueue so no track finishes before its album
+  // is counted.
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<const ScanPool::Job*> added;
+  pool_.Enqueue(jobs, &added);
+  for (const ScanPool::Job* job : added) {
+    albumOf_[job->key.path] = job->group;
+    if (!job->group.empty()) ++albumPending_[job->group];
+  }
+}
+
+void LoudnessScanner::Cancel() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  pool_.Cancel();
+  // Albums that lost tracks can no longer complete.
+  albumPending_.clear();
+  albumStates_.clear();
+}
+
+bool LoudnessScanner::Track(const std::string& path, TrackLoudness* result) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const auto it = tracks_.find(path);
+  if (it == tracks_.end()) return false;
+  *result = it->second;
+  return true;
+}
+
+bool LoudnessScanner::Album(const std::string& album, AlbumLoudness* result) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const auto it = albums_.find(album);
+  if (it == albums_.end()) return false;
+  *result = it->second;
+  return true;
+}
+
+std::string LoudnessScanner::CacheFileName(const SeekIndex::Key& key) {
+  return cachefile::CacheFileName(key.path, key.fileSize, key.mtimeSeconds,
+                                  ".loudness");
+}
+
+bool LoudnessScanner::AlbumOf(const std::string& path, AlbumLoudness* result) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const auto track = albumOf_.find(path);
+  if (track == albumOf_.end() || track->second.empty()) return false;
+  const auto it = albums_.find(track->second);
+  if (it == albums_.end()) return false;
+  *result = it->second;
+  return true;
+}
+
+bool LoudnessScanner::LoadCached(const SeekIndex::Key& key,
+                                 TrackLoudness* result) const {
+  return ReadCache(key, result, nullptr, nullptr);
+}
+
+LoudnessScanner::Stats LoudnessScanner::GetStats() const {
+  const ScanPool::Stats pool = pool_.GetStats();
+  Stats stats;
+  stats.tracksScanned = pool.tracksDone;
+  stats.tracksCached = pool.tracksCached;
+  stats.tracksFailed = pool.tracksFailed;
+  stats.tracksPending = pool.tracksPending;
+  stats.audioSeconds = pool.audioSeconds;
+  stats.busySeconds = pool.busySeconds;
+  stats.workers = pool.workers;
+  return stats;
+}
+
+ScanPool::Result LoudnessScanner::Scan(const ScanPool::Job& job, uint64_t generation) {
+  TrackLoudness result;
+  LoudnessHistogram blocks;
+  LoudnessHistogram shortTerm;
+  const Outcome outcome = Measure(job.key, generation, &result, &blocks, &shortTerm);
+  Finish(job, outcome, result, blocks, shortTerm);
+  if (outcome != Outcome::kDone) return {outcome};
+  return {outcome, static_cast<double>(result.frames) / result.sampleRate};
+}
+
+LoudnessScanner::Outcome LoudnessScanner::Measure(const SeekIndex::Key& key,
+                                                  uint64_t generation,
+                                                  TrackLoudness* result,
+                                                  LoudnessHistogram* blocks,
+                                                  LoudnessHistogram* shortTerm) {
+  if (ReadCache(key, result, blocks, shortTerm)) return Outcome::kCached;
+
+  std::unique_ptr<PcmSource> source = open_ ? open_(key.path) : nullptr;
+  if (!source) return Outcome::kFailed;
+  const PcmFormat format = source->Format();
+  if (format.sampleRate == 0 || format.channels == 0 || format.BytesPerFrame() == 0) {
+    return Outcome::kFailed;
+  }
+
+  LoudnessMeter meter;
+  meter.Configure(format.sampleRate, format.channels);
+  std::vector<uint8_t> raw(kChunkFrames * format.BytesPerFrame());
+  std::vector<float> samples(kChunkFrames * format.channels);
+  size_t got = 0;
+  while ((got = source->ReadFrames(raw.data(), kChunkFrames)) > 0) {
+    if (pool_.Cancelled(generation)) return Outcome::kCancelled;
+    if (!ToFloat(format, raw.data(), got * format.channels, samples.data())) {
+      return Outcome::kFailed;
+    }
+    meter.Process(samples.data(), got);
+  }
+  if (meter.FramesProcessed() == 0) return Outcome::kFailed;
+
+  result->integratedLufs = meter.IntegratedLufs();
+  result->loudnessRangeLu = meter.LoudnessRangeLu();
+  result->truePeak = meter.TruePeak();
+  result->frames = meter.FramesProcessed();
+  result->sampleRate = format.sampleRate;
+  *blocks = meter.MomentaryBlocks();
+  *shortTerm = meter.ShortTermBlocks();
+  // A failed write only costs a rescan next session.
+  WriteCache(key, *result, *blocks, *shortTerm);
+  return Outcome::kDone;
+}
+
+void LoudnessScanner::Finish(const ScanPool::Job& job, Outcome outcome,
+                             const TrackLoudness& result,
+                             const LoudnessHistogram& blocks,
+                             const LoudnessHistogram& shortTerm) {
+  // A cancelled track's album was dropped with it.
+  if (outcome == Outcome::kCancelled) return;
+  std::lock_guard<std::mutex> lock(mutex_);
+  const bool ok = outcome == Outcome::kDone || outcome == Outcome::kCached;
+  if (ok) tracks_[job.key.path] = result;
+
+  const auto pending = albumPending_.find(job.group);
+  if (job.group.empty() || pending == albumPending_.end()) return;
+  std::unique_ptr<AlbumState>& state = albumStates_[job.group];
+  if (!state) state = std::make_unique<AlbumState>();
+  if (ok) {
+    state->blocks.Merge(blocks);
+    state->shortTerm.Merge(shortTerm);
+    state->truePeak = std::max(state->truePeak, result.truePeak);
+    ++state->measured;
+  }
+  if (--pending->second == 0) {
+    if (state->measured > 0) {
+      AlbumLoudness& album = albums_[job.group];
+      album.integratedLufs = state->blocks.IntegratedLufs();
+      album.loudnessRangeLu = state->shortTerm.RangeLu();
+      album.truePeak = state->truePeak;
+      album.tracks = state->measured;
+    }
+    albumStates_.erase(job.group);
+    albumPending_.erase(pending);
+  }
+}
+
+bool LoudnessScanner::WriteCache(const SeekIndex::Key& key,
+                                 const TrackLoudness& result,
+                                 const LoudnessHistogram& blocks,
+                                 const LoudnessHistogram& shortTerm) const {
+  if (cacheDir_.empty()) return false;
+  std::vector<uint8_t> out(sizeof(kMagic));
+  std::memcpy(out.data(), kMagic, sizeof(kMagic));
+  PutLe(&out, kLoudnessCacheVersion, 2);
+  PutLe(&out, 0, 2);
+  PutLe(&out, key.fileSize, 8);
+  PutLe(&out, static_cast<uint64_t>(key.mtimeSeconds), 8);
+  PutLe(&out, result.sampleRate, 4);
+  PutLe(&out, PathHash(key.path), 4);
+  PutLe(&out, result.frames, 8);
+  PutLe(&out, DoubleBits(result.integratedLufs), 8);
+  PutLe(&out, DoubleBits(result.loudnessRangeLu), 8);
+  PutLe(&out, DoubleBits(result.truePeak), 8);
+  PutHistogram(&out, blocks);
+  PutHistogram(&out, shortTerm);
+  PutLe(&out, Fnv1a32(out.data(), out.size()), 4);
+  return cachefile::WriteAtomically(CachePath(cacheDir_, key), out);
+}
+
+bool LoudnessScanner::ReadCache(const SeekIndex::Key& key, TrackLoudness* result,
+                                LoudnessHistogram* blocks,
+                                LoudnessHistogram* shortTerm) const {
+  std::vector<uint8_t> bytes;
+  if (cacheDir_.empty() || !cachefile::ReadAll(CachePath(cacheDir_, key), &bytes)) {
+    return false;
+  }
+  const uint8_t* data = bytes.data();
+  const size_t size = bytes.size();
+  if (size < kHeaderBytes + kTrailerBytes) return false;
+  const size_t bodyEnd = size - kTrailerBytes;
+  if (GetLe(data + bodyEnd, 4) != Fnv1a32(data, bodyEnd)) return false;
+  if (!std::equal(std::begin(kMagic), std::end(kMagic), data)) return false;
+  if (GetLe(data + 4, 2) != kLoudnessCacheVersion) return false;
+  if (GetLe(data + 8, 8) != key.fileSize ||
+      static_cast<int64_t>(GetLe(data + 16, 8)) != key.mtimeSeconds ||
+      GetLe(data + 28, 4) != PathHash(key.path)) {
+    return false;
+  }
+
+  TrackLoudness loaded;
+  loaded.sampleRate = static_cast<uint32_t>(GetLe(data + 24, 4));
+  loaded.frames = GetLe(data + 32, 8);
+  loaded.integratedLufs = BitsDouble(GetLe(data + 40, 8));
+  loaded.loudnessRangeLu = BitsDouble(GetLe(data + 48, 8));
+  loaded.truePeak = BitsDouble(GetLe(data + 56, 8));
+  if (loaded.sampleRate == 0) return false;
+
+  const uint8_t* in = data + kHeaderBytes;
+  const uint8_t* end = data + bodyEnd;
+  if (!GetHistogram(&in, end, blocks) || !GetHistogram(&in, end, shortTerm) ||
+      in != end) {
+    return false;
+  }
+  *result = loaded;
+  return true;
+}
+
+}  // namespace audioengine
@@ -0,0 +1,440 @@
+#include "AudioEngineCore/ParametricEq.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "AudioEngineCore/SampleKernels.h"
+#include "Simd.h"
+
+namespace audioengine {
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+constexpr uint32_t kLanes = ParametricEq::kMaxChannels;
+
+// Gains closer to 0 dB than this leave a band out of the cascade.
+constexpr double kFlatDb = 0.01;
+// Filter state this small is flushed so silence does not run on denormals.
+constexpr float kDenormalFloor = 1e-20f;
+
+using Coefficients = float[5];
+
+void SetPassThrough(Coefficients c) {
+  c[0] = 1.0f;
+  c[1] = c[2] = c[3] = c[4] = 0.0f;
+}
+
+bool IsPassThrough(const Coefficients c) {
+  return c[0] == 1.0f && c[1] == 0.0f && c[2] == 0.0f && c[3] == 0.0f &&
+         c[4] == 0.0f;
+}
+
+// Audio EQ Cookbook (R. Bristow-Johnson) designs.
+void DesignBand(const EqBand& band, uint32_t sampleRate, Coefficients c) {
+  const bool hasGain = band.type == EqBandType::kPeaking ||
+                       band.type == EqBandType::kLowShelf ||
+                       band.type == EqBandType::kHighShelf;
+  if (!band.enabled || (hasGain && std::fabs(band.gainDb) < kFlatDb)) {
+    SetPassThrough(c);
+    return;
+  }
+  const double frequency =
+      std::min(std::max(band.frequencyHz, 10.0), 0.49 * sampleRate);
+  const double q = std::min(std::max(band.q, 0.1), 40.0);
+  const double a = std::pow(10.0, std::min(std::max(band.gainDb, -30.0), 30.0) / 40.0);
+  const double w0 = 2.0 * kPi * frequency / sampleRate;
+  const double cs = std::cos(w0);
+  const double alpha = std::sin(w0) / (2.0 * q);
+  const double shelf = 2.0 * std::sqrt(a) * alpha;
+
+  double b0, b1, b2, a0, a1, a2;
+  switch (band.type) {
+    case EqBandType::kPeaking:
+      b0 = 1.0 + alpha * a;
+      b1 = -2.0 * cs;
+      b2 = 1.0 - alpha * a;
+      a0 = 1.0 + alpha / a;
+      a1 = -2.0 * cs;
+      a2 = 1.0 - alpha / a;
+      break;
+    case EqBandType::kLowShelf:
+      b0 = a * ((a + 1.0) - (a - 1.0) * cs + shelf);
+      b1 = 2.0 * a * ((a - 1.0) - (a + 1.0) * cs);
+      b2 = a * ((a + 1.0) - (a - 1.0) * cs - shelf);
+      a0 = (a + 1.0) + (a - 1.0) * cs + shelf;
+      a1 = -2.0 * ((a - 1.0) + (a + 1.0) * cs);
+      a2 = (a + 1.0) + (a - 1.0) * cs - shelf;
+      break;
+    case EqBandType::kHighShelf:
+      b0 = a * ((a + 1.0) + (a - 1.0) * cs + shelf);
+      b1 = -2.0 * a * ((a - 1.0) + (a + 1.0) * cs);
+      b2 = a * ((a + 1.0) + (a - 1.0) * cs - shelf);
+      a0 = (a + 1.0) - (a - 1.0) * cs + shelf;
+      a1 = 2.0 * ((a - 1.0) - (a + 1.0) * cs);
+      a2 = (a + 1.0) - (a - 1.0) * cs - shelf;
+      break;
+    case EqBandType::kLowPass:
+      b0 = 0.5 * (1.0 - cs);
+      b1 = 1.0 - cs;
+      b2 = 0.5 * (1.0 - cs);
+      a0 = 1.0 + alpha;
+      a1 = -2.0 * cs;
+      a2 = 1.0 - alpha;
+      break;
+    case EqBandType::kHighPass:
+    default:
+      b0 = 0.5 * (1.0 + cs);
+      b1 = -(1.0 + cs);
+      b2 = 0.5 * (1.0 + cs);
+      a0 = 1.0 + alpha;
+      a1 = -2.0 * cs;
+      a2 = 1.0 - alpha;
+      break;
+  }
+  c[0] = static_cast<float>(b0 / a0);
+  c[1] = static_cast<float>(b1 / a0);
+  c[2] = static_cast<float>(b2 / a0);
+  c[3] = static_cast<float>(a1 / a0);
+  c[4] = static_cast<float>(a2 / a0);
+}
+
+// Runs `frames` interleaved frames through the `count` bands listed in
+// `bands`. `lanes[i]` holds the coefficients of bands[i], broadcast; when
+// `steps` is given they move by steps[i] after every frame.
+using EqKernelFn = void (*)(float* samples, size_t frames, uint32_t channels,
+                            const uint32_t* bands, uint32_t count,
+                            float (*lanes)[5][kLanes], const float (*steps)[5][kLanes],
+                            float (*state)[2][kLanes]);
+
+template <bool kRamp>
+void EqScalar(float* samples, size_t frames, uint32_t channels,
+              const uint32_t* bands, uint32_t count, float (*lanes)[5][kLanes],
+              const float (*steps)[5][kLanes], float (*state)[2][kLanes]) {
+  for (size_t f = 0; f < frames; ++f) {
+    float* frame = samples + f * channels;
+    for (uint32_t ch = 0; ch < channels; ++ch) {
+      float x = frame[ch];
+      for (uint32_t i = 0; i < count; ++i) {
+        const float (*c)[kLanes] = lanes[i];
+        float* z1 = state[bands[i]][0];
+        float* z2 = state[bands[i]][1];
+        const float y = c[0][0] * x + z1[ch];
+        z1[ch] = c[1][0] * x - c[3][0] * y + z2[ch];
+        z2[ch] = c[2][0] * x - c[4][0] * y;
+        x = y;
+      }
+      frame[ch] = x;
+    }
+    if (kRamp) {
+      for (uint32_t i = 0; i < count; ++i) {
+        for (int k = 0; k < 5; ++k) lanes[i][k][0] += steps[i][k][0];
+      }
+    }
+  }
+}
+
+#if AUDIOENGINE_HAVE_SSE2
+template <bool kRamp>
+void EqSse2(float* samples, size_t frames, uint32_t channels,
+            const uint32_t* bands, uint32_t count, float (*lanes)[5][kLanes],
+            const float (*steps)[5][kLanes], float (*state)[2][kLanes]) {
+  float* frame = samples;
+  for (size_t f = 0; f < frames; ++f, frame += channels) {
+    // More than four channels take a second register's worth of lanes.
+    for (uint32_t group = 0; group < channels; group += 4) {
+      const uint32_t n = std::min<uint32_t>(4, channels - group);
+      __m128 x = LoadLanes4(frame + group, n);
+      for (uint32_t i = 0; i < count; ++i) {
+        const float (*c)[kLanes] = lanes[i];
+        float* z1 = state[bands[i]][0] + group;
+        float* z2 = state[bands[i]][1] + group;
+        const __m128 y = _mm_add_ps(_mm_mul_ps(_mm_load_ps(c[0]), x), _mm_load_ps(z1));
+        _mm_store_ps(z1, _mm_add_ps(_mm_sub_ps(_mm_mul_ps(_mm_load_ps(c[1]), x),
+                                               _mm_mul_ps(_mm_load_ps(c[3]), y)),
+                                    _mm_load_ps(z2)));
+        _mm_store_ps(z2, _mm_sub_ps(_mm_mul_ps(_mm_load_ps(c[2]), x),
+                                    _mm_mul_ps(_mm_load_ps(c[4]), y)));
+        x = y;
+      }
+      StoreLanes4(frame + group, x, n);
+    }
+    if (kRamp) {
+      for (uint32_t i = 0; i < count; ++i) {
+        for (int k = 0; k < 5; ++k) {
+          _mm_store_ps(lanes[i][k],
+                       _mm_add_ps(_mm_load_ps(lanes[i][k]), _mm_load_ps(steps[i][k])));
+        }
+      }
+    }
+  }
+}
+#endif
+
+#if AUDIOENGINE_HAVE_AVX2
+template <bool kRamp>
+AUDIOENGINE_TARGET_AVX2
+void EqAvx2(float* samples, size_t frames, uint32_t channels,
+            const uint32_t* bands, uint32_t count, float (*lanes)[5][kLanes],
+            const float (*steps)[5][kLanes], float (*state)[2][kLanes]) {
+  // Only used above four channels (see SelectKernel()); the upper half is
+  // loaded like an SSE2 group, which is far cheaper than a masked load.
+  const uint32_t upper = channels - 4;
+  float* frame = samples;
+  for (size_t f = 0; f < frames; ++f, frame += channels) {
+    __m256 x = channels == kLanes
+                   ? _mm256_loadu_ps(frame)
+                   : _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(frame)),
+                                          LoadLanes4(frame + 4, upper), 1);
+    for (uint32_t i = 0; i < count; ++i) {
+      const float (*c)[kLanes] = lanes[i];
+      float* z1 = state[bands[i]][0];
+      float* z2 = state[bands[i]][1];
+      const __m256 y =
+          _mm256_add_ps(_mm256_mul_ps(_mm256_load_ps(c[0]), x), _mm256_load_ps(z1));
+      _mm256_store_ps(z1, _mm256_add_ps(_mm256_sub_ps(_mm256_mul_ps(_mm256_load_ps(c[1]), x),
+                                                      _mm256_mul_ps(_mm256_load_ps(c[3]), y)),
+                                        _mm256_load_ps(z2)));
+      _mm256_store_ps(z2, _mm256_sub_ps(_mm256_mul_ps(_mm256_load_ps(c[2]), x),
+                                        _mm256_mul_ps(_mm256_load_ps(c[4]), y)));
+      x = y;
+    }
+    if (channels == kLanes) {
+      _mm256_storeu_ps(frame, x);
+    } else {
+      _mm_storeu_ps(frame, _mm256_castps256_ps128(x));
+      StoreLanes4(frame + 4, _mm256_extractf128_ps(x, 1), upper);
+    }
+    if (kRamp) {
+      for (uint32_t i = 0; i < count; ++i) {
+        for (int k = 0; k < 5; ++k) {
+          _mm256_store_ps(lanes[i][k], _mm256_add_ps(_mm256_load_ps(lanes[i][k]),
+                                                     _mm256_load_ps(steps[i][k])));
+        }
+      }
+    }
+  }
+}
+#endif
+
+#if AUDIOENGINE_HAVE_NEON64
+template <bool kRamp>
+void EqNeon(float* samples, size_t frames, uint32_t channels,
+            const uint32_t* bands, uint32_t count, float (*lanes)[5][kLanes],
+            const float (*steps)[5][kLanes], float (*state)[2][kLanes]) {
+  float* frame = samples;
+  for (size_t f = 0; f < frames; ++f, frame += channels) {
+    for (uint32_t group = 0; group < channels; group += 4) {
+      const uint32_t n = std::min<uint32_t>(4, channels - group);
+      float* p = frame + group;
+      float32x4_t x = LoadLanes4(p, n);
+      for (uint32_t i = 0; i < count; ++i) {
+        const float (*c)[kLanes] = lanes[i];
+        float* z1 = state[bands[i]][0] + group;
+        float* z2 = state[bands[i]][1] + group;
+        const float32x4_t y = vfmaq_f32(vld1q_f32(z1), vld1q_f32(c[0]), x);
+        vst1q_f32(z1, vfmsq_f32(vfmaq_f32(vld1q_f32(z2), vld1q_f32(c[1]), x),
+                                vld1q_f32(c[3]), y));
+        vst1q_f32(z2, vfmsq_f32(vmulq_f32(vld1q_f32(c[2]), x), vld1q_f32(c[4]), y));
+        x = y;
+      }
+      StoreLanes4(p, x, n);
+    }
+    if (kRamp) {
+      for (uint32_t i = 0; i < count; ++i) {
+        for (int k = 0; k < 5; ++k) {
+          vst1q_f32(lanes[i][k], vaddq_f32(vld1q_f32(lanes[i][k]), vld1q_f32(steps[i][k])));
+        }
+      }
+    }
+  }
+}
+#endif
+
+EqKernelFn SelectKernel(KernelIsa isa, uint32_t channels, bool ramp) {
+  switch (isa) {
+#if AUDIOENGINE_HAVE_AVX2
+    // Four channels or fewer fit one SSE register.
+    case KernelIsa::kAvx2:
+      if (channels > 4) return ramp ? EqAvx2<true> : EqAvx2<false>;
+      return ramp ? EqSse2<true> : EqSse2<false>;
+#endif
+#if AUDIOENGINE_HAVE_SSE2
+    case KernelIsa::kSse2: return ramp ? EqSse2<true> : EqSse2<false>;
+#endif
+#if AUDIOENGINE_HAVE_NEON64
+    case KernelIsa::kNeon: return ramp ? EqNeon<true> : EqNeon<false>;
+#endif
+    default: return ramp ? EqScalar<true> : EqScalar<false>;
+  }
+}
+
+}  // namespace
+
+std::vector<EqBand> GraphicEqBands(const std::vector<double>& gainsDb) {
+  std::vector<EqBand> bands;
+  const size_t count = gainsDb.size();
+  if (count < ParametricEq::kMinGraphicBands || count > ParametricEq::kMaxBands) {
+    return bands;
+  }
+  // Three decades split evenly; a peaking band's Q for a bandwidth of one
+  // spacing ratio r (measured at half gain) is sqrt(r) / (r - 1).
+  const double ratio = std::pow(1000.0, 1.0 / static_cast<double>(count));
+  const double q = std::sqrt(ratio) / (ratio - 1.0);
+  bands.resize(count);
+  for (size_t i = 0; i < count; ++i) {
+    bands[i].type = EqBandType::kPeaking;
+    bands[i].frequencyHz = 20.0 * std::pow(ratio, static_cast<double>(i) + 0.5);
+    bands[i].gainDb = gainsDb[i];
+    bands[i].q = q;
+  }
+  return bands;
+}
+
+ParametricEq::ParametricEq() {
+  for (CoefficientSet* set : {&slots_[0], &slots_[1], &slots_[2], &current_, &target_}) {
+    for (uint32_t b = 0; b < kMaxBands; ++b) SetPassThrough(set->c[b]);
+  }
+  std::memset(&step_, 0, sizeof(step_));
+  std::memset(lanes_, 0, sizeof(lanes_));
+  std::memset(stepLanes_, 0, sizeof(stepLanes_));
+  std::memset(state_, 0, sizeof(state_));
+}
+
+bool ParametricEq::Configure(uint32_t sampleRate, uint32_t channels) {
+  std::lock_guard<std::mutex> lock(controlMutex_);
+  if (channels == 0 || channels > kMaxChannels || sampleRate == 0) {
+    sampleRate_ = 0;
+    channels_ = 0;
+    return false;
+  }
+  sampleRate_ = sampleRate;
+  channels_ = channels;
+  // Nothing is rendering, so the render side is set directly and anything
+  // still waiting in the triple buffer is dropped.
+  latest_.store(latest_.load() & kSlotMask);
+  Design(&current_);
+  target_ = current_;
+  rampLeft_ = 0;
+  std::memset(state_, 0, sizeof(state_));
+  UpdateActive();
+  return true;
+}
+
+bool ParametricEq::SetBands(const std::vector<EqBand>& bands) {
+  if (bands.size() > kMaxBands) return false;
+  std::lock_guard<std::mutex> lock(controlMutex_);
+  bands_ = bands;
+  Publish();
+  return true;
+}
+
+bool ParametricEq::SetBand(size_t index, const EqBand& band) {
+  std::lock_guard<std::mutex> lock(controlMutex_);
+  if (index >= bands_.size()) return false;
+  bands_[index] = band;
+  Publish();
+  return true;
+}
+
+std::vector<EqBand> ParametricEq::Bands() const {
+  std::lock_guard<std::mutex> lock(controlMutex_);
+  return bands_;
+}
+
+void ParametricEq::Design(CoefficientSet* set) const {
+  for (uint32_t b = 0; b < kMaxBands; ++b) {
+    if (b < bands_.size()) {
+      DesignBand(bands_[b], sampleRate_, set->c[b]);
+    } else {
+      SetPassThrough(set->c[b]);
+    }
+  }
+}
+
+void ParametricEq::Publish() {
+  // Unconfigured: Configure() designs the bands when the rate is known.
+  if (channels_ == 0) return;
+  Design(&slots_[writeSlot_]);
+  writeSlot_ = latest_.exchange(writeSlot_ | kFresh, std::memory_order_acq_rel) & kSlotMask;
+}
+
+void ParametricEq::Retarget(const CoefficientSet& set) {
+  target_ = set;
+  // Both ends of every ramp are stable filters, and the stable (a1, a2)
+  // region is convex, so every point on the straight line between them is
+  // stable too. Moving every frame keeps the steps far below anything
+  // audible; coarser steps zipper on shelves, where b0 scales the input.
+  for (uint32_t b = 0; b < kMaxBands; ++b) {
+    for (int k = 0; k < 5; ++k) {
+      step_.c[b][k] = (target_.c[b][k] - current_.c[b][k]) / kRampFrames;
+    }
+  }
+  rampLeft_ = kRampFrames;
+  UpdateActive();
+}
+
+void ParametricEq::UpdateActive() {
+  activeCount_ = 0;
+  for (uint32_t b = 0; b < kMaxBands; ++b) {
+    if (IsPassThrough(current_.c[b]) && IsPassThrough(target_.c[b])) {
+      // A pass-through section's state is all zeros, so a band that comes
+      // back later starts exactly where it would have been.
+      std::memset(state_[b], 0, sizeof(state_[b]));
+      continue;
+    }
+    const uint32_t i = activeCount_++;
+    active_[i] = b;
+    for (int k = 0; k < 5; ++k) {
+      std::fill(lanes_[i][k], lanes_[i][k] + kLanes, current_.c[b][k]);
+      std::fill(stepLanes_[i][k], stepLanes_[i][k] + kLanes, step_.c[b][k]);
+    }
+  }
+}
+
+void ParametricEq::Process(float* samples, size_t frames) {
+  if (channels_ == 0) return;
+  if (latest_.load(std::memory_order_relaxed) & kFresh) {
+    readSlot_ = latest_.exchange(readSlot_, std::memory_order_acq_rel) & kSlotMask;
+    Retarget(slots_[readSlot_]);
+  }
+  if (activeCount_ == 0) return;
+
+  const KernelIsa isa = ActiveKernelIsa();
+  while (frames > 0) {
+    const bool ramping = rampLeft_ > 0;
+    const size_t chunk = ramping ? std::min<size_t>(frames, rampLeft_) : frames;
+    SelectKernel(isa, channels_, ramping)(samples, chunk, channels_, active_, activeCount_,
+                               lanes_, stepLanes_, state_);
+    if (ramping) {
+      rampLeft_ -= static_cast<uint32_t>(chunk);
+      if (rampLeft_ == 0) {
+        current_ = target_;
+      } else {
+        for (uint32_t b = 0; b < kMaxBands; ++b) {
+          for (int k = 0; k < 5; ++k) current_.c[b][k] += step_.c[b][k] * chunk;
+        }
+      }
+      UpdateActive();
+      if (activeCount_ == 0) break;
+    }
+    samples += chunk * channels_;
+    frames -= chunk;
+  }
+
+  for (uint32_t i = 0; i < activeCount_; ++i) {
+    for (float& z : state_[active_[i]][0]) {
+      if (std::fabs(z) < kDenormalFloor) z = 0.0f;
+    }
+    for (float& z : state_[active_[i]][1]) {
+      if (std::fabs(z) < kDenormalFloor) z = 0.0f;
+    }
+  }
+}
+
+void ParametricEq::Reset() {
+  std::memset(state_, 0, sizeof(state_));
+}
+
+}  // namespace audioengine
@@ -0,0 +1,82 @@
+#include "AudioEngineCore/PrebufferedSource.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+namespace audioengine {
+
+namespace {
+
+// Decode granularity of Fill(); matches StreamingDecoder's default chunk.
+constexpr size_t kFillChunkFrames = 4096;
+
+}  // namespace
+
+PrebufferedSource::PrebufferedSource(std::unique_ptr<PcmSource> inner)
+    : inner_(std::move(inner)),
+      format_(inner_->Format()),
+      bytesPerFrame_(format_.BytesPerFrame()) {}
+
+uint64_t PrebufferedSource::Fill(uint64_t frames) {
+  if (!buffering_ || bytesPerFrame_ == 0) return 0;
+  buffer_.reserve(static_cast<size_t>(frames) * bytesPerFrame_);
+  while (!innerEnded_ && BufferedFrames() < frames) {
+    const size_t chunk = static_cast<size_t>(
+        std::min<uint64_t>(kFillChunkFrames, frames - BufferedFrames()));
+    const size_t offset = buffer_.size();
+    buffer_.resize(offset + chunk * bytesPerFrame_);
+    const size_t got = inner_->ReadFrames(buffer_.data() + offset, chunk);
+    buffer_.resize(offset + got * bytesPerFrame_);
+    if (got == 0) innerEnded_ = true;
+  }
+  return BufferedFrames();
+}
+
+uint64_t PrebufferedSource::BufferedFrames() const {
+  return bytesPerFrame_ == 0 ? 0 : buffer_.size() / bytesPerFrame_;
+}
+
+size_t PrebufferedSource::ReadFrames(uint8_t* dst, size_t maxFrames) {
+  size_t written = 0;
+  if (buffering_) {
+    const uint64_t buffered = BufferedFrames();
+    written = static_cast<size_t>(
+        std::min<uint64_t>(maxFrames, buffered - readFrame_));
+    if (written > 0) {
+      memcpy(dst, buffer_.data() + readFrame_ * bytesPerFrame_,
+             written * bytesPerFrame_);
+      readFrame_ += written;
+    }
+    if (readFrame_ < buffered) return written;
+    // The inner source sits right after the buffered head, so reading simply
+    // carries on from it.
+    Release();
+    if (innerEnded_) return written;
+  }
+  if (written < maxFrames) {
+    written += inner_->ReadFrames(dst + written * bytesPerFrame_,
+                                  maxFrames - written);
+  }
+  return written;
+}
+
+bool PrebufferedSource::SeekToFrame(uint64_t frame, SeekMode mode,
+                                    uint64_t* landedFrame) {
+  if (buffering_ && frame < BufferedFrames()) {
+    readFrame_ = frame;
+    if (landedFrame) *landedFrame = frame;
+    return true;
+  }
+  Release();
+  innerEnded_ = false;
+  return inner_->SeekToFrame(frame, mode, landedFrame);
+}
+
+void PrebufferedSource::Release() {
+  buffering_ = false;
+  readFrame_ = 0;
+  std::vector<uint8_t>().swap(buffer_);
+}
+
+}  // namespace audioengine
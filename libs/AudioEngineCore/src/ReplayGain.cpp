@@ -0,0 +1,98 @@
+#include "AudioEngineCore/ReplayGain.h"
+
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+
+namespace audioengine {
+
+namespace {
+
+// ReplayGain's reference is 5 dB louder than EBU R128's -23 LUFS.
+constexpr double kR128ToReplayGainDb = 5.0;
+
+double DbToLinear(double db) { return std::pow(10.0, db / 20.0); }
+
+bool IsBlank(const char* text) {
+  while (*text && std::isspace(static_cast<unsigned char>(*text))) ++text;
+  return *text == '\0';
+}
+
+std::optional<double> ReadValue(const TagLookup& lookup, const char* key) {
+  double value = 0.0;
+  const char* text = lookup(key);
+  if (text && ParseReplayGainValue(text, &value)) return value;
+  return std::nullopt;
+}
+
+std::optional<double> ReadR128(const TagLookup& lookup, const char* key) {
+  double value = 0.0;
+  const char* text = lookup(key);
+  if (text && ParseR128Gain(text, &value)) return value;
+  return std::nullopt;
+}
+
+}  // namespace
+
+bool ParseReplayGainValue(const char* text, double* value) {
+  char* end = nullptr;
+  const double parsed = std::strtod(text, &end);
+  if (end == text || !std::isfinite(parsed)) return false;
+  while (*end && std::isspace(static_cast<unsigned char>(*end))) ++end;
+  if ((end[0] == 'd' || end[0] == 'D') && (end[1] == 'b' || end[1] == 'B')) {
+    end += 2;
+  }
+  if (!IsBlank(end)) return false;
+  *value = parsed;
+  return true;
+}
+
+bool ParseR128Gain(const char* text, double* gainDb) {
+  char* end = nullptr;
+  const long q78 = std::strtol(text, &end, 10);
+  if (end == text || !IsBlank(end) || q78 < -32768 || q78 > 32767) return false;
+  *gainDb = static_cast<double>(q78) / 256.0 + kR128ToReplayGainDb;
+  return true;
+}
+
+ReplayGainTags ReadReplayGainTags(const TagLookup& lookup) {
+  ReplayGainTags tags;
+  tags.trackGainDb = ReadValue(lookup, "REPLAYGAIN_TRACK_GAIN");
+  if (!tags.trackGainDb) tags.trackGainDb = ReadR128(lookup, "R128_TRACK_GAIN");
+  tags.albumGainDb = ReadValue(lookup, "REPLAYGAIN_ALBUM_GAIN");
+  if (!tags.albumGainDb) tags.albumGainDb = ReadR128(lookup, "R128_ALBUM_GAIN");
+  tags.trackPeak = ReadValue(lookup, "REPLAYGAIN_TRACK_PEAK");
+  tags.albumPeak = ReadValue(lookup, "REPLAYGAIN_ALBUM_PEAK");
+  // A zero or negative peak is a broken tagger, not silence.
+  if (tags.trackPeak && *tags.trackPeak <= 0.0) tags.trackPeak.reset();
+  if (tags.albumPeak && *tags.albumPeak <= 0.0) tags.albumPeak.reset();
+  return tags;
+}
+
+NormalizationGain ResolveNormalization(NormalizationMode mode,
+                                       const ReplayGainTags& tags,
+                                       double preampDb, double ceilingDb) {
+  NormalizationGain result;
+  if (mode == NormalizationMode::kOff) return result;
+
+  const bool album = mode == NormalizationMode::kAlbum;
+  const std::optional<double>& gainDb =
+      album ? (tags.albumGainDb ? tags.albumGainDb : tags.trackGainDb)
+            : (tags.trackGainDb ? tags.trackGainDb : tags.albumGainDb);
+  if (!gainDb) return result;
+  const std::optional<double>& peak =
+      album ? (tags.albumPeak ? tags.albumPeak : tags.trackPeak)
+            : (tags.trackPeak ? tags.trackPeak : tags.albumPeak);
+
+  const double gain = DbToLinear(*gainDb + preampDb);
+  const double ceiling = DbToLinear(ceilingDb);
+  result.gain = static_cast<float>(gain);
+  // Without a peak tag assume the track reaches full scale.
+  const double peakValue = peak ? *peak : 1.0;
+  result.mayClip = gain * peakValue > ceiling;
+  result.peakSafeGain =
+      result.mayClip ? static_cast<float>(ceiling / peakValue) : result.gain;
+  return result;
+}
+
+}  // namespace audioengine
@@ -0,0 +1,350 @@
+#include "AudioEngineCore/Resampler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+
+#include "AudioEngineCore/SampleKernels.h"
+#include "Simd.h"
+
+namespace audioengine {
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+// Taps are padded to a multiple of this so the vector loops need no tail.
+constexpr uint32_t kTapAlign = 8;
+// Frames decoded, or converted, per refill.
+constexpr size_t kBlockFrames = 1024;
+
+struct Preset {
+  // Filter length in samples of the lower of the two rates.
+  uint32_t taps;
+  double stopbandDb;
+  // Centre of the transition band as a fraction of the lower Nyquist.
+  double cutoff;
+};
+
+Preset PresetFor(ResamplerQuality quality) {
+  switch (quality) {
+    case ResamplerQuality::kLow: return {16, 60.0, 1.0};
+    case ResamplerQuality::kMedium: return {48, 96.0, 0.97};
+    case ResamplerQuality::kHigh: return {96, 120.0, 0.97};
+  }
+  return {48, 96.0, 0.97};
+}
+
+// Zeroth-order modified Bessel function of the first kind.
+double BesselI0(double x) {
+  double sum = 1.0;
+  double term = 1.0;
+  for (int k = 1; k < 50; ++k) {
+    term *= (x / (2.0 * k)) * (x / (2.0 * k));
+    sum += term;
+    if (term < sum * 1e-12) break;
+  }
+  return sum;
+}
+
+double KaiserBeta(double stopbandDb) {
+  if (stopbandDb > 50.0) return 0.1102 * (stopbandDb - 8.7);
+  if (stopbandDb >= 21.0) {
+    return 0.5842 * std::pow(stopbandDb - 21.0, 0.4) + 0.07886 * (stopbandDb - 21.0);
+  }
+  return 0.0;
+}
+
+// Dot products over `taps` floats, a multiple of kTapAlign.
+using DotFn = float (*)(const float* a, const float* b, uint32_t taps);
+
+float DotScalar(const float* a, const float* b, uint32_t taps) {
+  float acc = 0.0f;
+  for (uint32_t k = 0; k < taps; ++k) acc += a[k] * b[k];
+  return acc;
+}
+
+#if AUDIOENGINE_HAVE_SSE2
+float DotSse2(const float* a, const float* b, uint32_t taps) {
+  __m128 acc0 = _mm_setzero_ps();
+  __m128 acc1 = _mm_setzero_ps();
+  for (uint32_t k = 0; k < taps; k += 8) {
+    acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + k), _mm_loadu_ps(b + k)));
+    acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + k + 4), _mm_loadu_ps(b + k + 4)));
+  }
+  __m128 sum = _mm_add_ps(acc0, acc1);
+  sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+  sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+  return _mm_cvtss_f32(sum);
+}
+#endif
+
+#if AUDIOENGINE_HAVE_AVX2
+AUDIOENGINE_TARGET_AVX2
+float DotAvx2(const float* a, const float* b, uint32_t taps) {
+  __m256 acc = _mm256_setzero_ps();
+  for (uint32_t k = 0; k < taps; k += 8) {
+    acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_loadu_ps(a + k), _mm256_loadu_ps(b + k)));
+  }
+  __m128 sum = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+  sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+  sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+  return _mm_cvtss_f32(sum);
+}
+#endif
+
+#if AUDIOENGINE_HAVE_NEON64
+float DotNeon(const float* a, const float* b, uint32_t taps) {
+  float32x4_t acc0 = vdupq_n_f32(0.0f);
+  float32x4_t acc1 = vdupq_n_f32(0.0f);
+  for (uint32_t k = 0; k < taps; k += 8) {
+    acc0 = vfmaq_f32(acc0, vld1q_f32(a + k), vld1q_f32(b + k));
+    acc1 = vfmaq_f32(acc1, vld1q_f32(a + k + 4), vld1q_f32(b + k + 4));
+  }
+  return vaddvq_f32(vaddq_f32(acc0, acc1));
+}
+#endif
+
+DotFn SelectDot(KernelIsa isa) {
+  switch (isa) {
+#if AUDIOENGINE_HAVE_AVX2
+    case KernelIsa::kAvx2: return DotAvx2;
+#endif
+#if AUDIOENGINE_HAVE_SSE2
+    case KernelIsa::kSse2: return DotSse2;
+#endif
+#if AUDIOENGINE_HAVE_NEON64
+    case KernelIsa::kNeon: return DotNeon;
+#endif
+    default: return DotScalar;
+  }
+}
+
+}  // namespace
+
+bool PolyphaseResampler::Configure(uint32_t inRate, uint32_t outRate,
+                                   uint32_t channels, ResamplerQuality quality) {
+  channels_ = 0;
+  if (inRate == 0 || outRate == 0 || channels == 0) return false;
+  const uint32_t divisor = std::gcd(inRate, outRate);
+  if (outRate / divisor > kMaxPhases) return false;
+  inStep_ = inRate / divisor;
+  outStep_ = outRate / divisor;
+
+  // The filter is specified at the lower rate; downsampling stretches it
+  // over proportionally more input samples.
+  const Preset preset = PresetFor(quality);
+  const double scale = std::min(1.0, static_cast<double>(outRate) / inRate);
+  const uint32_t span =
+      static_cast<uint32_t>(std::ceil(preset.taps / scale));
+  taps_ = (span + kTapAlign - 1) / kTapAlign * kTapAlign;
+  const double half = taps_ / 2.0;
+  // Cutoff in cycles per input sample.
+  const double fc = 0.5 * preset.cutoff * scale;
+  const double beta = KaiserBeta(preset.stopbandDb);
+  const double i0Beta = BesselI0(beta);
+
+  coeffs_.assign(static_cast<size_t>(outStep_) * taps_, 0.0f);
+  std::vector<double> taps(taps_);
+  for (uint32_t phase = 0; phase < outStep_; ++phase) {
+    const double frac = static_cast<double>(phase) / outStep_;
+    double sum = 0.0;
+    for (uint32_t j = 0; j < taps_; ++j) {
+      // Distance from the output instant back to input tap j.
+      const double u = frac + half - 1.0 - j;
+      const double x = 2.0 * fc * u;
+      const double sinc = x == 0.0 ? 1.0 : std::sin(kPi * x) / (kPi * x);
+      const double r = u / half;
+      const double window = r * r < 1.0 ? BesselI0(beta * std::sqrt(1.0 - r * r)) / i0Beta
+                                         : 0.0;
+      taps[j] = 2.0 * fc * sinc * window;
+      sum += taps[j];
+    }
+    // Unity DC gain on every phase, so steady levels carry no ripple.
+    float* dst = coeffs_.data() + static_cast<size_t>(phase) * taps_;
+    for (uint32_t j = 0; j < taps_; ++j) dst[j] = static_cast<float>(taps[j] / sum);
+  }
+
+  channels_ = channels;
+  history_.assign(static_cast<size_t>(channels) * 2 * taps_, 0.0f);
+  Reset();
+  return true;
+}
+
+void PolyphaseResampler::Reset(uint32_t offset) {
+  std::fill(history_.begin(), history_.end(), 0.0f);
+  historyPos_ = 0;
+  phase_ = offset % outStep_;
+  // Output 0 needs input up to its base frame plus half the taps.
+  wait_ = static_cast<uint64_t>(offset / outStep_) + taps_ / 2 + 1;
+}
+
+void PolyphaseResampler::Push(const float* frame) {
+  for (uint32_t ch = 0; ch < channels_; ++ch) {
+    float* h = history_.data() + static_cast<size_t>(ch) * 2 * taps_;
+    h[historyPos_] = frame[ch];
+    h[historyPos_ + taps_] = frame[ch];
+  }
+  historyPos_ = historyPos_ + 1 == taps_ ? 0 : historyPos_ + 1;
+}
+
+size_t PolyphaseResampler::Process(const float* in, size_t inFrames, float* out,
+                                   size_t maxOut, size_t* consumed) {
+  size_t used = 0;
+  size_t written = 0;
+  if (channels_ != 0) {
+    const DotFn dot = SelectDot(ActiveKernelIsa());
+    const size_t perInput = (outStep_ + inStep_ - 1) / inStep_;
+    const size_t stride = 2 * static_cast<size_t>(taps_);
+    while (used < inFrames && maxOut - written >= perInput) {
+      Push(in + used * channels_);
+      ++used;
+      if (--wait_ != 0) continue;
+      do {
+        const float* c = coeffs_.data() + static_cast<size_t>(phase_) * taps_;
+        const float* window = history_.data() + historyPos_;
+        float* frame = out + written * channels_;
+        for (uint32_t ch = 0; ch < channels_; ++ch) {
+          frame[ch] = dot(c, window + ch * stride, taps_);
+        }
+        ++written;
+        phase_ += inStep_;
+        wait_ = phase_ / outStep_;
+        phase_ %= outStep_;
+      } while (wait_ == 0);
+    }
+  }
+  if (consumed) *consumed = used;
+  return written;
+}
+
+ResamplingSource::ResamplingSource(std::unique_ptr<PcmSource> inner,
+                                   uint32_t outRate, ResamplerQuality quality)
+    : inner_(std::move(inner)), format_(inner_->Format()), quality_(quality) {
+  const uint32_t inRate = format_.sampleRate;
+  format_.sampleRate = outRate;
+  if (!resampler_.Configure(inRate, outRate, format_.channels, quality)) return;
+  const size_t channels = format_.channels;
+  input_.resize(kBlockFrames * channels);
+  pending_.resize(kBlockFrames * channels);
+  silence_.assign(resampler_.TapsPerPhase() * channels, 0.0f);
+}
+
+bool ResamplingSource::CanResample(const PcmFormat& format, uint32_t outRate) {
+  if (!format.isFloat || format.bitsPerSample != 32 || format.channels == 0) {
+    return false;
+  }
+  if (format.sampleRate == 0 || outRate == 0 || format.sampleRate == outRate) {
+    return false;
+  }
+  return outRate / std::gcd(format.sampleRate, outRate) <=
+         PolyphaseResampler::kMaxPhases;
+}
+
+uint64_t ResamplingSource::OutputFramesFor(uint64_t inputFrames) const {
+  const uint64_t in = resampler_.InputStep();
+  const uint64_t out = resampler_.OutputStep();
+  return (inputFrames * out + in - 1) / in;
+}
+
+bool ResamplingSource::Refill() {
+  pendingOffset_ = 0;
+  pendingFrames_ = 0;
+  if (!resampler_.IsConfigured()) return false;
+  const size_t channels = format_.channels;
+  if (inputOffset_ == inputFrames_ && !innerEnded_) {
+    inputFrames_ = inner_->ReadFrames(reinterpret_cast<uint8_t*>(input_.data()),
+                                      kBlockFrames);
+    inputOffset_ = 0;
+    inputPosition_ += inputFrames_;
+    innerEnded_ = inputFrames_ == 0;
+  }
+  size_t consumed = 0;
+  if (inputOffset_ < inputFrames_) {
+    pendingFrames_ = resampler_.Process(input_.data() + inputOffset_ * channels,
+                                        inputFrames_ - inputOffset_,
+                                        pending_.data(), kBlockFrames, &consumed);
+    inputOffset_ += consumed;
+  } else {
+    // Flush the look-ahead with silence up to the converted length.
+    const uint64_t end = OutputFramesFor(inputPosition_);
+    if (outputPosition_ >= end) return false;
+    pendingFrames_ = resampler_.Process(silence_.data(), resampler_.TapsPerPhase(),
+                                        pending_.data(), kBlockFrames, &consumed);
+    pendingFrames_ = static_cast<size_t>(
+        std::min<uint64_t>(pendingFrames_, end - outputPosition_));
+  }
+  outputPosition_ += pendingFrames_;
+  return true;
+}
+
+size_t ResamplingSource::ReadFrames(uint8_t* dst, size_t maxFrames) {
+  const size_t channels = format_.channels;
+  auto* out = reinterpret_cast<float*>(dst);
+  size_t written = 0;
+  while (written < maxFrames) {
+    if (pendingOffset_ == pendingFrames_) {
+      if (!Refill()) break;
+      continue;
+    }
+    const size_t n = std::min(maxFrames - written, pendingFrames_ - pendingOffset_);
+    std::memcpy(out + written * channels, pending_.data() + pendingOffset_ * channels,
+                n * channels * sizeof(float));
+    pendingOffset_ += n;
+    written += n;
+  }
+  return written;
+}
+
+uint64_t ResamplingSource::Restart(uint64_t inputFrame) {
+  const uint64_t in = resampler_.InputStep();
+  const uint64_t out = resampler_.OutputStep();
+  const uint64_t first = OutputFramesFor(inputFrame);
+  // Sub-frame distance from the input frame to the output grid.
+  resampler_.Reset(static_cast<uint32_t>(first * in - inputFrame * out));
+  inputOffset_ = 0;
+  inputFrames_ = 0;
+  pendingOffset_ = 0;
+  pendingFrames_ = 0;
+  inputPosition_ = inputFrame;
+  outputPosition_ = first;
+  innerEnded_ = false;
+  return first;
+}
+
+bool ResamplingSource::SeekToFrame(uint64_t frame, SeekMode mode,
+                                   uint64_t* landedFrame) {
+  if (!resampler_.IsConfigured()) return false;
+  const uint64_t in = resampler_.InputStep();
+  const uint64_t out = resampler_.OutputStep();
+  const uint64_t target = frame * in / out;
+  // An accurate seek starts a filter length early so the history is real
+  // audio, not zeros, by the time the requested frame comes out.
+  const uint64_t preroll = mode == SeekMode::kAccurate ? resampler_.TapsPerPhase() : 0;
+  uint64_t landed = target > preroll ? target - preroll : 0;
+  if (!inner_->SeekToFrame(landed, mode, &landed)) return false;
+  const uint64_t first = Restart(landed);
+  if (mode == SeekMode::kFast) {
+    if (landedFrame) *landedFrame = first;
+    return true;
+  }
+  // Converted frames before `frame` only warm the filter up.
+  uint64_t position = first;
+  while (position < frame) {
+    if (pendingOffset_ == pendingFrames_ && !Refill()) break;
+    const size_t skip = static_cast<size_t>(std::min<uint64_t>(
+        frame - position, pendingFrames_ - pendingOffset_));
+    pendingOffset_ += skip;
+    position += skip;
+  }
+  if (landedFrame) *landedFrame = position;
+  return true;
+}
+
+uint64_t ResamplingSource::TotalFrames() const {
+  if (!resampler_.IsConfigured()) return 0;
+  const uint64_t inner = inner_->TotalFrames();
+  return inner == 0 ? 0 : OutputFramesFor(inner);
+}
+
+}  // namespace audioengine
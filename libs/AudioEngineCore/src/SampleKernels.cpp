@@ -0,0 +1,817 @@
+#include "AudioEngineCore/SampleKernels.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+
+#include "Simd.h"
+
+namespace audioengine {
+
+namespace {
+
+// ---- Scalar -----------------------------------------------------------------
+
+template <SampleType T>
+struct Sample;
+
+template <>
+struct Sample<SampleType::kS16> {
+  static double Load(const uint8_t* p) {
+    int16_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v * (1.0 / 32768.0);
+  }
+  static void Store(uint8_t* p, double x) {
+    const int16_t v = static_cast<int16_t>(
+        std::clamp(std::nearbyint(x * 32768.0), -32768.0, 32767.0));
+    std::memcpy(p, &v, sizeof(v));
+  }
+};
+
+template <>
+struct Sample<SampleType::kS24> {
+  static double Load(const uint8_t* p) {
+    const int32_t v = static_cast<int32_t>((static_cast<uint32_t>(p[0]) << 8) |
+                                           (static_cast<uint32_t>(p[1]) << 16) |
+                                           (static_cast<uint32_t>(p[2]) << 24)) >>
+                      8;
+    return v * (1.0 / 8388608.0);
+  }
+  static void Store(uint8_t* p, double x) {
+    const int32_t v = static_cast<int32_t>(
+        std::clamp(std::nearbyint(x * 8388608.0), -8388608.0, 8388607.0));
+    p[0] = static_cast<uint8_t>(v);
+    p[1] = static_cast<uint8_t>(v >> 8);
+    p[2] = static_cast<uint8_t>(v >> 16);
+  }
+};
+
+template <>
+struct Sample<SampleType::kS32> {
+  static double Load(const uint8_t* p) {
+    int32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v * (1.0 / 2147483648.0);
+  }
+  static void Store(uint8_t* p, double x) {
+    const int32_t v = static_cast<int32_t>(
+        std::clamp(std::nearbyint(x * 2147483648.0), -2147483648.0, 2147483647.0));
+    std::memcpy(p, &v, sizeof(v));
+  }
+};
+
+template <>
+struct Sample<SampleType::kF32> {
+  static double Load(const uint8_t* p) {
+    float v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+  }
+  static void Store(uint8_t* p, double x) {
+    const float v = static_cast<float>(x);
+    std::memcpy(p, &v, sizeof(v));
+  }
+};
+
+template <>
+struct Sample<SampleType::kF64> {
+  static double Load(const uint8_t* p) {
+    double v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+  }
+  static void Store(uint8_t* p, double x) { std::memcpy(p, &x, sizeof(x)); }
+};
+
+using ConvertFn = void (*)(const uint8_t* src, uint8_t* dst, size_t count,
+                           double gain);
+
+template <SampleType From, SampleType To>
+void ConvertLoop(const uint8_t* src, uint8_t* dst, size_t count, double gain) {
+  constexpr size_t kIn = BytesPerSample(From);
+  constexpr size_t kOut = BytesPerSample(To);
+  for (size_t i = 0; i < count; ++i) {
+    Sample<To>::Store(dst + i * kOut, Sample<From>::Load(src + i * kIn) * gain);
+  }
+}
+
+#define AUDIOENGINE_CONVERT_ROW(FROM)                                       \
+  {                                                                         \
+    ConvertLoop<FROM, SampleType::kS16>, ConvertLoop<FROM, SampleType::kS24>, \
+        ConvertLoop<FROM, SampleType::kS32>,                                \
+        ConvertLoop<FROM, SampleType::kF32>,                                \
+        ConvertLoop<FROM, SampleType::kF64>                                 \
+  }
+
+// Indexed by [from][to] in SampleType order.
+constexpr ConvertFn kScalarConvert[5][5] = {
+    AUDIOENGINE_CONVERT_ROW(SampleType::kS16),
+    AUDIOENGINE_CONVERT_ROW(SampleType::kS24),
+    AUDIOENGINE_CONVERT_ROW(SampleType::kS32),
+    AUDIOENGINE_CONVERT_ROW(SampleType::kF32),
+    AUDIOENGINE_CONVERT_ROW(SampleType::kF64),
+};
+
+#undef AUDIOENGINE_CONVERT_ROW
+
+// Planar <-> interleaved with the sample size and (for the common layouts)
+// the channel count known at compile time. `Channels` 0 means `channels`.
+template <size_t Bytes, uint32_t Channels>
+void InterleaveLoop(const uint8_t* const* planes, uint32_t channels, size_t begin,
+                    size_t frames, uint8_t* dst) {
+  const uint32_t count = Channels != 0 ? Channels : channels;
+  const size_t stride = static_cast<size_t>(count) * Bytes;
+  for (uint32_t ch = 0; ch < count; ++ch) {
+    const uint8_t* src = planes[ch] + begin * Bytes;
+    uint8_t* out = dst + begin * stride + ch * Bytes;
+    for (size_t frame = begin; frame < frames; ++frame) {
+      std::memcpy(out, src, Bytes);
+      src += Bytes;
+      out += stride;
+    }
+  }
+}
+
+template <size_t Bytes, uint32_t Channels>
+void DeinterleaveLoop(const uint8_t* src, uint32_t channels, size_t begin,
+                      size_t frames, uint8_t* const* planes) {
+  const uint32_t count = Channels != 0 ? Channels : channels;
+  const size_t stride = static_cast<size_t>(count) * Bytes;
+  for (uint32_t ch = 0; ch < count; ++ch) {
+    const uint8_t* in = src + begin * stride + ch * Bytes;
+    uint8_t* out = planes[ch] + begin * Bytes;
+    for (size_t frame = begin; frame < frames; ++frame) {
+      std::memcpy(out, in, Bytes);
+      in += stride;
+      out += Bytes;
+    }
+  }
+}
+
+template <size_t Bytes>
+void InterleaveBytes(const uint8_t* const* planes, uint32_t channels, size_t begin,
+                     size_t frames, uint8_t* dst) {
+  switch (channels) {
+    case 1: return InterleaveLoop<Bytes, 1>(planes, channels, begin, frames, dst);
+    case 2: return InterleaveLoop<Bytes, 2>(planes, channels, begin, frames, dst);
+    case 6: return InterleaveLoop<Bytes, 6>(planes, channels, begin, frames, dst);
+    case 8: return InterleaveLoop<Bytes, 8>(planes, channels, begin, frames, dst);
+    default: return InterleaveLoop<Bytes, 0>(planes, channels, begin, frames, dst);
+  }
+}
+
+template <size_t Bytes>
+void DeinterleaveBytes(const uint8_t* src, uint32_t channels, size_t begin,
+                       size_t frames, uint8_t* const* planes) {
+  switch (channels) {
+    case 1: return DeinterleaveLoop<Bytes, 1>(src, channels, begin, frames, planes);
+    case 2: return DeinterleaveLoop<Bytes, 2>(src, channels, begin, frames, planes);
+    case 6: return DeinterleaveLoop<Bytes, 6>(src, channels, begin, frames, planes);
+    case 8: return DeinterleaveLoop<Bytes, 8>(src, channels, begin, frames, planes);
+    default: return DeinterleaveLoop<Bytes, 0>(src, channels, begin, frames, planes);
+  }
+}
+
+// ---- Vector kernels -----------------------------------------------------------
+//
+// Each returns how many samples (or frames, for interleaving) it handled;
+// the scalar loops finish the tail.
+
+using VectorFn = size_t (*)(const uint8_t* src, uint8_t* dst, size_t count,
+                            float gain);
+
+#if AUDIOENGINE_HAVE_SSE2
+
+size_t Sse2GainF32(const uint8_t* src, uint8_t* dst, size_t count, float gain) {
+  const auto* s = reinterpret_cast<const float*>(src);
+  auto* d = reinterpret_cast<float*>(dst);
+  const __m128 g = _mm_set1_ps(gain);
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    _mm_storeu_ps(d + i, _mm_mul_ps(_mm_loadu_ps(s + i), g));
+    _mm_storeu_ps(d + i + 4, _mm_mul_ps(_mm_loadu_ps(s + i + 4), g));
+  }
+  return i;
+}
+
+size_t Sse2S16ToF32(const uint8_t* src, uint8_t* dst, size_t count, float gain) {
+  auto* d = reinterpret_cast<float*>(dst);
+  const __m128 g = _mm_set1_ps(gain / 32768.0f);
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 2));
+    // Sign-extend by shifting each sample down from the top half.
+    const __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+    const __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+    _mm_storeu_ps(d + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), g));
+    _mm_storeu_ps(d + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), g));
+  }
+  return i;
+}
+
+// Scaled floats to rounded int16 pairs. Clamping before the conversion keeps
+// huge values out of cvtps' overflow result.
+inline __m128i Sse2FloatToS16(__m128 a, __m128 b) {
+  const __m128 lo = _mm_set1_ps(-32768.0f);
+  const __m128 hi = _mm_set1_ps(32767.0f);
+  a = _mm_max_ps(_mm_min_ps(a, hi), lo);
+  b = _mm_max_ps(_mm_min_ps(b, hi), lo);
+  return _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b));
+}
+
+size_t Sse2F32ToS16(const uint8_t* src, uint8_t* dst, size_t count, float gain) {
+  const auto* s = reinterpret_cast<const float*>(src);
+  const __m128 g = _mm_set1_ps(gain * 32768.0f);
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    const __m128i packed = Sse2FloatToS16(_mm_mul_ps(_mm_loadu_ps(s + i), g),
+                                          _mm_mul_ps(_mm_loadu_ps(s + i + 4), g));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 2), packed);
+  }
+  return i;
+}
+
+size_t Sse2GainS16(const uint8_t* src, uint8_t* dst, size_t count, float gain) {
+  const __m128 g = _mm_set1_ps(gain);
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 2));
+    const __m128 lo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16));
+    const __m128 hi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 2),
+                     Sse2FloatToS16(_mm_mul_ps(lo, g), _mm_mul_ps(hi, g)));
+  }
+  return i;
+}
+
+size_t Sse2S32ToF32(const uint8_t* src, uint8_t* dst, size_t count, float gain) {
+  auto* d = reinterpret_cast<float*>(dst);
+  const __m128 g = _mm_set1_ps(gain / 2147483648.0f);
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4));
+    _mm_storeu_ps(d + i, _mm_mul_ps(_mm_cvtepi32_ps(x), g));
+  }
+  return i;
+}
+
+size_t Sse2F32ToS32(const uint8_t* src, uint8_t* dst, size_t count, float gain) {
+  const auto* s = reinterpret_cast<const float*>(src);
+  const __m128 g = _mm_set1_ps(gain * 2147483648.0f);
+  const __m128 limit = _mm_set1_ps(2147483648.0f);
+  const __m128i max = _mm_set1_epi32(0x7fffffff);
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    const __m128 x = _mm_mul_ps(_mm_loadu_ps(s + i), g);
+    // cvtps returns INT32_MIN on overflow, which is already right for
+    // negative values; positive overflow is patched to INT32_MAX.
+    const __m128i over = _mm_castps_si128(_mm_cmpge_ps(x, limit));
+    const __m128i r = _mm_cvtps_epi32(x);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 4),
+                     _mm_or_si128(_mm_andnot_si128(over, r), _mm_and_si128(over, max)));
+  }
+  return i;
+}
+
+// 32-bit integer gain runs in double so it stays exact like the scalar path.
+size_t Sse2GainS32(const uint8_t* src, uint8_t* dst, size_t count, float gain) {
+  const __m128d g = _mm_set1_pd(gain);
+  const __m128d lo = _mm_set1_pd(-2147483648.0);
+  const __m128d hi = _mm_set1_pd(2147483647.0);
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4));
+    __m128d a = _mm_mul_pd(_mm_cvtepi32_pd(x), g);
+    __m128d b = _mm_mul_pd(_mm_cvtepi32_pd(_mm_srli_si128(x, 8)), g);
+    a = _mm_max_pd(_mm_min_pd(a, hi), lo);
+    b = _mm_max_pd(_mm_min_pd(b, hi), lo);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 4),
+                     _mm_unpacklo_epi64(_mm_cvtpd_epi32(a), _mm_cvtpd_epi32(b)));
+  }
+  return i;
+}
+
+size_t Sse2InterleaveF32x2(const uint8_t* const* planes, size_t frames, uint8_t* dst) {
+  const auto* l = reinterpret_cast<const float*>(planes[0]);
+  const auto* r = reinterpret_cast<const float*>(planes[1]);
+  auto* d = reinterpret_cast<float*>(dst);
+  size_t frame = 0;
+  for (; frame + 4 <= frames; frame += 4) {
+    const __m128 a = _mm_loadu_ps(l + frame);
+    const __m128 b = _mm_loadu_ps(r + frame);
+    _mm_storeu_ps(d + frame * 2, _mm_unpacklo_ps(a, b));
+    _mm_storeu_ps(d + frame * 2 + 4, _mm_unpackhi_ps(a, b));
+  }
+  return frame;
+}
+
+size_t Sse2DeinterleaveF32x2(const uint8_t* src, size_t frames, uint8_t* const* planes) {
+  const auto* s = reinterpret_cast<const float*>(src);
+  auto* l = reinterpret_cast<float*>(planes[0]);
+  auto* r = reinterpret_cast<float*>(planes[1]);
+  size_t frame = 0;
+  for (; frame + 4 <= frames; frame += 4) {
+    const __m128 a = _mm_loadu_ps(s + frame * 2);
+    const __m128 b = _mm_loadu_ps(s + frame * 2 + 4);
+    _mm_storeu_ps(l + frame, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+    _mm_storeu_ps(r + frame, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+  }
+  return frame;
+}
+
+#endif  // AUDIOENGINE_HAVE_SSE2
+
+#if AUDIOENGINE_HAVE_AVX2
+
+AUDIOENGINE_TARGET_AVX2
+size_t Avx2GainF32(const uint8_t* src, uint8_t* dst, size_t count, float gain) {
+  const auto* s = reinterpret_cast<const float*>(src);
+  auto* d = reinterpret_cast<float*>(dst);
+  const __m256 g = _mm256_set1_ps(gain);
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    _mm256_storeu_ps(d + i, _mm256_mul_ps(_mm256_loadu_ps(s + i), g));
+    _mm256_storeu_ps(d + i + 8, _mm256_mul_ps(_mm256_loadu_ps(s + i + 8), g));
+  }
+  return i;
+}
+
+AUDIOENGINE_TARGET_AVX2
+size_t Avx2S16ToF32(const uint8_t* src, uint8_t* dst, size_t count, float gain) {
+  auto* d = reinterpret_cast<float*>(dst);
+  const __m256 g = _mm256_set1_ps(gain / 32768.0f);
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 2));
+    const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 2 + 16));
+    _mm256_storeu_ps(d + i, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(a)), g));
+    _mm256_storeu_ps(d + i + 8,
+                     _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(b)), g));
+  }
+  return i;
+}
+
+AUDIOENGINE_TARGET_AVX2
+inline __m256i Avx2FloatToS16(__m256 a, __m256 b) {
+  const __m256 lo = _mm256_set1_ps(-32768.0f);
+  const __m256 hi = _mm256_set1_ps(32767.0f);
+  a = _mm256_max_ps(_mm256_min_ps(a, hi), lo);
+  b = _mm256_max_ps(_mm256_min_ps(b, hi), lo);
+  // packs works per 128-bit lane; restore sample order across lanes.
+  const __m256i packed = _mm256_packs_epi32(_mm256_cvtps_epi32(a), _mm256_cvtps_epi32(b));
+  return _mm256_permute4x64_epi64(packed, 0xD8);
+}
+
+AUDIOENGINE_TARGET_AVX2
+size_t Avx2F32ToS16(const uint8_t* src, uint8_t* dst, size_t count, float gain) {
+  const auto* s = reinterpret_cast<const float*>(src);
+  const __m256 g = _mm256_set1_ps(gain * 32768.0f);
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    const __m256i packed = Avx2FloatToS16(_mm256_mul_ps(_mm256_loadu_ps(s + i), g),
+                                          _mm256_mul_ps(_mm256_loadu_ps(s + i + 8), g));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i * 2), packed);
+  }
+  return i;
+}
+
+AUDIOENGINE_TARGET_AVX2
+size_t Avx2GainS16(const uint8_t* src, uint8_t* dst, size_t count, float gain) {
+  const __m256 g = _mm256_set1_ps(gain);
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 2));
+    const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 2 + 16));
+    const __m256 fa = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(a));
+    const __m256 fb = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(b));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i * 2),
+                        Avx2FloatToS16(_mm256_mul_ps(fa, g), _mm256_mul_ps(fb, g)));
+  }
+  return i;
+}
+
+AUDIOENGINE_TARGET_AVX2
+size_t Avx2S32ToF32(const uint8_t* src, uint8_t* dst, size_t count, float gain) {
+  auto* d = reinterpret_cast<float*>(dst);
+  const __m256 g = _mm256_set1_ps(gain / 2147483648.0f);
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    const __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i * 4));
+    _mm256_storeu_ps(d + i, _mm256_mul_ps(_mm256_cvtepi32_ps(x), g));
+  }
+  return i;
+}
+
+AUDIOENGINE_TARGET_AVX2
+size_t Avx2F32ToS32(const uint8_t* src, uint8_t* dst, size_t count, float gain) {
+  const auto* s = reinterpret_cast<const float*>(src);
+  const __m256 g = _mm256_set1_ps(gain * 2147483648.0f);
+  const __m256 limit = _mm256_set1_ps(2147483648.0f);
+  const __m256i max = _mm256_set1_epi32(0x7fffffff);
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    const __m256 x = _mm256_mul_ps(_mm256_loadu_ps(s + i), g);
+    const __m256i over = _mm256_castps_si256(_mm256_cmp_ps(x, limit, _CMP_GE_OQ));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i * 4),
+                        _mm256_blendv_epi8(_mm256_cvtps_epi32(x), max, over));
+  }
+  return i;
+}
+
+AUDIOENGINE_TARGET_AVX2
+size_t Avx2GainS32(const uint8_t* src, uint8_t* dst, size_t count, float gain) {
+  const __m256d g = _mm256_set1_pd(gain);
+  const __m256d lo = _mm256_set1_pd(-2147483648.0);
+  const __m256d hi = _mm256_set1_pd(2147483647.0);
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4));
+    __m256d a = _mm256_mul_pd(_mm256_cvtepi32_pd(x), g);
+    a = _mm256_max_pd(_mm256_min_pd(a, hi), lo);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 4), _mm256_cvtpd_epi32(a));
+  }
+  return i;
+}
+
+AUDIOENGINE_TARGET_AVX2
+size_t Avx2InterleaveF32x2(const uint8_t* const* planes, size_t frames, uint8_t* dst) {
+  const auto* l = reinterpret_cast<const float*>(planes[0]);
+  const auto* r = reinterpret_cast<const float*>(planes[1]);
+  auto* d = reinterpret_cast<float*>(dst);
+  size_t frame = 0;
+  for (; frame + 8 <= frames; frame += 8) {
+    const __m256 a = _mm256_loadu_ps(l + frame);
+    const __m256 b = _mm256_loadu_ps(r + frame);
+    // Unpacks work per 128-bit lane; permute2f128 restores frame order.
+    const __m256 lo = _mm256_unpacklo_ps(a, b);
+    const __m256 hi = _mm256_unpackhi_ps(a, b);
+    _mm256_storeu_ps(d + frame * 2, _mm256_permute2f128_ps(lo, hi, 0x20));
+    _mm256_storeu_ps(d + frame * 2 + 8, _mm256_permute2f128_ps(lo, hi, 0x31));
+  }
+  return frame;
+}
+
+#endif  // AUDIOENGINE_HAVE_AVX2
+
+#if AUDIOENGINE_HAVE_NEON64
+
+size_t NeonGainF32(const uint8_t* src, uint8_t* dst, size_t count, float gain) {
+  const auto* s = reinterpret_cast<const float*>(src);
+  auto* d = reinterpret_cast<float*>(dst);
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    vst1q_f32(d + i, vmulq_n_f32(vld1q_f32(s + i), gain));
+    vst1q_f32(d + i + 4, vmulq_n_f32(vld1q_f32(s + i + 4), gain));
+  }
+  return i;
+}
+
+size_t NeonS16ToF32(const uint8_t* src, uint8_t* dst, size_t count, float gain) {
+  const auto* s = reinterpret_cast<const int16_t*>(src);
+  auto* d = reinterpret_cast<float*>(dst);
+  const float scale = gain / 32768.0f;
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    const int16x8_t x = vld1q_s16(s + i);
+    vst1q_f32(d + i, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(x))), scale));
+    vst1q_f32(d + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(x))), scale));
+  }
+  return i;
+}
+
+// vcvtn rounds to nearest even and saturates to int32; vqmovn saturates the
+// narrowing.
+inline int16x8_t NeonFloatToS16(float32x4_t a, float32x4_t b) {
+  return vcombine_s16(vqmovn_s32(vcvtnq_s32_f32(a)), vqmovn_s32(vcvtnq_s32_f32(b)));
+}
+
+size_t NeonF32ToS16(const uint8_t* src, uint8_t* dst, size_t count, float gain) {
+  const auto* s = reinterpret_cast<const float*>(src);
+  auto* d = reinterpret_cast<int16_t*>(dst);
+  const float scale = gain * 32768.0f;
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    vst1q_s16(d + i, NeonFloatToS16(vmulq_n_f32(vld1q_f32(s + i), scale),
+                                    vmulq_n_f32(vld1q_f32(s + i + 4), scale)));
+  }
+  return i;
+}
+
+size_t NeonGainS16(const uint8_t* src, uint8_t* dst, size_t count, float gain) {
+  const auto* s = reinterpret_cast<const int16_t*>(src);
+  auto* d = reinterpret_cast<int16_t*>(dst);
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    const int16x8_t x = vld1q_s16(s + i);
+    const float32x4_t lo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(x)));
+    const float32x4_t hi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(x)));
+    vst1q_s16(d + i, NeonFloatToS16(vmulq_n_f32(lo, gain), vmulq_n_f32(hi, gain)));
+  }
+  return i;
+}
+
+size_t NeonS32ToF32(const uint8_t* src, uint8_t* dst, size_t count, float gain) {
+  const auto* s = reinterpret_cast<const int32_t*>(src);
+  auto* d = reinterpret_cast<float*>(dst);
+  const float scale = gain / 2147483648.0f;
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    vst1q_f32(d + i, vmulq_n_f32(vcvtq_f32_s32(vld1q_s32(s + i)), scale));
+  }
+  return i;
+}
+
+size_t NeonF32ToS32(const uint8_t* src, uint8_t* dst, size_t count, float gain) {
+  const auto* s = reinterpret_cast<const float*>(src);
+  auto* d = reinterpret_cast<int32_t*>(dst);
+  const float scale = gain * 2147483648.0f;
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    vst1q_s32(d + i, vcvtnq_s32_f32(vmulq_n_f32(vld1q_f32(s + i), scale)));
+  }
+  return i;
+}
+
+size_t NeonGainS32(const uint8_t* src, uint8_t* dst, size_t count, float gain) {
+  const auto* s = reinterpret_cast<const int32_t*>(src);
+  auto* d = reinterpret_cast<int32_t*>(dst);
+  const double g = gain;
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    const int32x4_t x = vld1q_s32(s + i);
+    const float64x2_t lo = vmulq_n_f64(vcvtq_f64_s64(vmovl_s32(vget_low_s32(x))), g);
+    const float64x2_t hi = vmulq_n_f64(vcvtq_f64_s64(vmovl_s32(vget_high_s32(x))), g);
+    vst1q_s32(d + i, vcombine_s32(vqmovn_s64(vcvtnq_s64_f64(lo)),
+                                  vqmovn_s64(vcvtnq_s64_f64(hi))));
+  }
+  return i;
+}
+
+size_t NeonInterleaveF32x2(const uint8_t* const* planes, size_t frames, uint8_t* dst) {
+  const auto* l = reinterpret_cast<const float*>(planes[0]);
+  const auto* r = reinterpret_cast<const float*>(planes[1]);
+  auto* d = reinterpret_cast<float*>(dst);
+  size_t frame = 0;
+  for (; frame + 4 <= frames; frame += 4) {
+    const float32x4x2_t v = {{vld1q_f32(l + frame), vld1q_f32(r + frame)}};
+    vst2q_f32(d + frame * 2, v);
+  }
+  return frame;
+}
+
+size_t NeonDeinterleaveF32x2(const uint8_t* src, size_t frames, uint8_t* const* planes) {
+  const auto* s = reinterpret_cast<const float*>(src);
+  auto* l = reinterpret_cast<float*>(planes[0]);
+  auto* r = reinterpret_cast<float*>(planes[1]);
+  size_t frame = 0;
+  for (; frame + 4 <= frames; frame += 4) {
+    const float32x4x2_t v = vld2q_f32(s + frame * 2);
+    vst1q_f32(l + frame, v.val[0]);
+    vst1q_f32(r + frame, v.val[1]);
+  }
+  return frame;
+}
+
+#endif  // AUDIOENGINE_HAVE_NEON64
+
+// ---- Dispatch -----------------------------------------------------------------
+
+bool CpuHasAvx2() {
+#if AUDIOENGINE_HAVE_AVX2
+#if defined(__GNUC__) || defined(__clang__)
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2");
+#else
+  int info[4];
+  __cpuid(info, 0);
+  if (info[0] < 7) return false;
+  __cpuid(info, 1);
+  // The OS must save the YMM registers (OSXSAVE, then XCR0 bits 1-2).
+  if ((info[2] & (1 << 27)) == 0 || (_xgetbv(0) & 6) != 6) return false;
+  __cpuidex(info, 7, 0);
+  return (info[1] & (1 << 5)) != 0;
+#endif
+#else
+  return false;
+#endif
+}
+
+KernelIsa DetectIsa() {
+  if (KernelIsaSupported(KernelIsa::kAvx2)) return KernelIsa::kAvx2;
+  if (KernelIsaSupported(KernelIsa::kNeon)) return KernelIsa::kNeon;
+  if (KernelIsaSupported(KernelIsa::kSse2)) return KernelIsa::kSse2;
+  return KernelIsa::kScalar;
+}
+
+std::atomic<KernelIsa>& ActiveIsa() {
+  static std::atomic<KernelIsa> isa{DetectIsa()};
+  return isa;
+}
+
+// Vector kernel for a conversion, or null.
+VectorFn SelectConvert(KernelIsa isa, SampleType from, SampleType to) {
+  using T = SampleType;
+  switch (isa) {
+#if AUDIOENGINE_HAVE_AVX2
+    case KernelIsa::kAvx2:
+      if (from == T::kF32 && to == T::kF32) return Avx2GainF32;
+      if (from == T::kS16 && to == T::kF32) return Avx2S16ToF32;
+      if (from == T::kF32 && to == T::kS16) return Avx2F32ToS16;
+      if (from == T::kS16 && to == T::kS16) return Avx2GainS16;
+      if (from == T::kS32 && to == T::kF32) return Avx2S32ToF32;
+      if (from == T::kF32 && to == T::kS32) return Avx2F32ToS32;
+      if (from == T::kS32 && to == T::kS32) return Avx2GainS32;
+      return nullptr;
+#endif
+#if AUDIOENGINE_HAVE_SSE2
+    case KernelIsa::kSse2:
+      if (from == T::kF32 && to == T::kF32) return Sse2GainF32;
+      if (from == T::kS16 && to == T::kF32) return Sse2S16ToF32;
+      if (from == T::kF32 && to == T::kS16) return Sse2F32ToS16;
+      if (from == T::kS16 && to == T::kS16) return Sse2GainS16;
+      if (from == T::kS32 && to == T::kF32) return Sse2S32ToF32;
+      if (from == T::kF32 && to == T::kS32) return Sse2F32ToS32;
+      if (from == T::kS32 && to == T::kS32) return Sse2GainS32;
+      return nullptr;
+#endif
+#if AUDIOENGINE_HAVE_NEON64
+    case KernelIsa::kNeon:
+      if (from == T::kF32 && to == T::kF32) return NeonGainF32;
+      if (from == T::kS16 && to == T::kF32) return NeonS16ToF32;
+      if (from == T::kF32 && to == T::kS16) return NeonF32ToS16;
+      if (from == T::kS16 && to == T::kS16) return NeonGainS16;
+      if (from == T::kS32 && to == T::kF32) return NeonS32ToF32;
+      if (from == T::kF32 && to == T::kS32) return NeonF32ToS32;
+      if (from == T::kS32 && to == T::kS32) return NeonGainS32;
+      return nullptr;
+#endif
+    default:
+      return nullptr;
+  }
+}
+
+size_t VectorInterleave(KernelIsa isa, SampleType type, const uint8_t* const* planes,
+                        uint32_t channels, size_t frames, uint8_t* dst) {
+  if (type != SampleType::kF32 || channels != 2) return 0;
+  switch (isa) {
+#if AUDIOENGINE_HAVE_AVX2
+    case KernelIsa::kAvx2:
+      return Avx2InterleaveF32x2(planes, frames, dst);
+#endif
+#if AUDIOENGINE_HAVE_SSE2
+    case KernelIsa::kSse2:
+      return Sse2InterleaveF32x2(planes, frames, dst);
+#endif
+#if AUDIOENGINE_HAVE_NEON64
+    case KernelIsa::kNeon:
+      return NeonInterleaveF32x2(planes, frames, dst);
+#endif
+    default:
+      return 0;
+  }
+}
+
+size_t VectorDeinterleave(KernelIsa isa, SampleType type, const uint8_t* src,
+                          uint32_t channels, size_t frames, uint8_t* const* planes) {
+  if (type != SampleType::kF32 || channels != 2) return 0;
+  switch (isa) {
+#if AUDIOENGINE_HAVE_SSE2
+    // Shuffles are as fast as anything AVX2 adds here.
+    case KernelIsa::kAvx2:
+    case KernelIsa::kSse2:
+      return Sse2DeinterleaveF32x2(src, frames, planes);
+#endif
+#if AUDIOENGINE_HAVE_NEON64
+    case KernelIsa::kNeon:
+      return NeonDeinterleaveF32x2(src, frames, planes);
+#endif
+    default:
+      return 0;
+  }
+}
+
+}  // namespace
+
+bool SampleTypeOf(const PcmFormat& format, SampleType* type) {
+  if (format.isFloat) {
+    if (format.bitsPerSample == 32) *type = SampleType::kF32;
+    else if (format.bitsPerSample == 64) *type = SampleType::kF64;
+    else return false;
+    return true;
+  }
+  switch (format.bitsPerSample) {
+    case 16: *type = SampleType::kS16; return true;
+    case 24: *type = SampleType::kS24; return true;
+    case 32: *type = SampleType::kS32; return true;
+    default: return false;
+  }
+}
+
+bool KernelIsaSupported(KernelIsa isa) {
+  switch (isa) {
+    case KernelIsa::kScalar:
+      return true;
+    case KernelIsa::kSse2:
+#if AUDIOENGINE_HAVE_SSE2
+      return true;
+#else
+      return false;
+#endif
+    case KernelIsa::kAvx2:
+      return CpuHasAvx2();
+    case KernelIsa::kNeon:
+#if AUDIOENGINE_HAVE_NEON64
+      return true;
+#else
+      return false;
+#endif
+  }
+  return false;
+}
+
+KernelIsa ActiveKernelIsa() { return ActiveIsa().load(std::memory_order_relaxed); }
+
+bool SetKernelIsa(KernelIsa isa) {
+  if (!KernelIsaSupported(isa)) return false;
+  ActiveIsa().store(isa, std::memory_order_relaxed);
+  return true;
+}
+
+const char* KernelIsaName(KernelIsa isa) {
+  switch (isa) {
+    case KernelIsa::kScalar: return "scalar";
+    case KernelIsa::kSse2: return "sse2";
+    case KernelIsa::kAvx2: return "avx2";
+    case KernelIsa::kNeon: return "neon";
+  }
+  return "unknown";
+}
+
+void ConvertSamples(SampleType from, const void* src, SampleType to, void* dst,
+                    size_t count, float gain) {
+  const auto* in = static_cast<const uint8_t*>(src);
+  auto* out = static_cast<uint8_t*>(dst);
+  size_t done = 0;
+  if (const VectorFn kernel = SelectConvert(ActiveKernelIsa(), from, to)) {
+    done = kernel(in, out, count, gain);
+  }
+  if (done < count) {
+    kScalarConvert[static_cast<int>(from)][static_cast<int>(to)](
+        in + done * BytesPerSample(from), out + done * BytesPerSample(to),
+        count - done, gain);
+  }
+}
+
+void ConvertSamplesScalar(SampleType from, const void* src, SampleType to,
+                          void* dst, size_t count, float gain) {
+  kScalarConvert[static_cast<int>(from)][static_cast<int>(to)](
+      static_cast<const uint8_t*>(src), static_cast<uint8_t*>(dst), count, gain);
+}
+
+void ScaleSamples(SampleType type, void* samples, size_t count, float gain) {
+  if (gain == 1.0f) return;
+  ConvertSamples(type, samples, type, samples, count, gain);
+}
+
+void ClampSamples(SampleType type, void* samples, size_t count) {
+  if (type == SampleType::kF32) {
+    // Simple enough for the compiler to vectorize at any ISA.
+    auto* s = static_cast<float*>(samples);
+    for (size_t i = 0; i < count; ++i) s[i] = std::min(1.0f, std::max(-1.0f, s[i]));
+  } else if (type == SampleType::kF64) {
+    auto* s = static_cast<double*>(samples);
+    for (size_t i = 0; i < count; ++i) s[i] = std::min(1.0, std::max(-1.0, s[i]));
+  }
+}
+
+void InterleaveSamples(SampleType type, const void* const* planes,
+                       uint32_t channels, size_t frames, void* dst) {
+  const auto* const* in = reinterpret_cast<const uint8_t* const*>(planes);
+  auto* out = static_cast<uint8_t*>(dst);
+  const size_t done =
+      VectorInterleave(ActiveKernelIsa(), type, in, channels, frames, out);
+  switch (BytesPerSample(type)) {
+    case 2: return InterleaveBytes<2>(in, channels, done, frames, out);
+    case 3: return InterleaveBytes<3>(in, channels, done, frames, out);
+    case 4: return InterleaveBytes<4>(in, channels, done, frames, out);
+    case 8: return InterleaveBytes<8>(in, channels, done, frames, out);
+  }
+}
+
+void DeinterleaveSamples(SampleType type, const void* src, uint32_t channels,
+                         size_t frames, void* const* planes) {
+  const auto* in = static_cast<const uint8_t*>(src);
+  auto* const* out = reinterpret_cast<uint8_t* const*>(planes);
+  const size_t done =
+      VectorDeinterleave(ActiveKernelIsa(), type, in, channels, frames, out);
+  switch (BytesPerSample(type)) {
+    case 2: return DeinterleaveBytes<2>(in, channels, done, frames, out);
+    case 3: return DeinterleaveBytes<3>(in, channels, done, frames, out);
+    case 4: return DeinterleaveBytes<4>(in, channels, done, frames, out);
+    case 8: return DeinterleaveBytes<8>(in, channels, done, frames, out);
+  }
+}
+
+}  // namespace audioengine
@@ -0,0 +1,178 @@
+#include "AudioEngineCore/ScanPool.h"
+
+#include <map>
+#include <utility>
+
+#include "ThreadPriority.h"
+
+namespace audioengine {
+
+namespace {
+
+// Waits are bounded like the SeekIndexer ones; the predicate is what
+// matters, the timeout only caps a missed notification.
+constexpr auto kWaitSlice = std::chrono::milliseconds(500);
+
+}  // namespace
+
+ScanPool::ScanPool(ScanFn scan, unsigned workers) : scan_(std::move(scan)) {
+  if (workers == 0) {
+    const unsigned hardware = std::thread::hardware_concurrency();
+    workers = hardware > 1 ? hardware - 1 : 1;
+  }
+  stats_.workers = workers;
+  for (unsigned i = 0; i < workers; ++i) {
+    workers_.push_back(std::make_unique<Worker>());
+  }
+}
+
+ScanPool::~ScanPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+    generation_.fetch_add(1);
+  }
+  wake_.notify_all();
+  for (std::thread& thread : threads_) thread.join();
+}
+
+size_t ScanPool::Enqueue(const std::vector<Job>& jobs, std::vector<const Job*>* added) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (stopping_) return 0;
+  // One group per worker queue keeps its jobs together; thieves break
+  // groups up only when a worker runs dry.
+  std::map<std::string, std::vector<const Job*>> byGroup;
+  size_t count = 0;
+  for (const Job& job : jobs) {
+    if (!seen_.insert(job.key.path).second) continue;
+    byGroup[job.group].push_back(&job);
+    if (added) added->push_back(&job);
+    ++count;
+  }
+  if (count == 0) return 0;
+
+  for (const auto& [group, members] : byGroup) {
+    for (size_t i = 0; i < members.size(); ++i) {
+      // Loose jobs are dealt round-robin.
+      if (i == 0 || group.empty()) nextWorker_ = (nextWorker_ + 1) % workers_.size();
+      Worker& worker = *workers_[nextWorker_];
+      std::lock_guard<std::mutex> workerLock(worker.mutex);
+      worker.jobs.push_back(*members[i]);
+    }
+  }
+  if (outstanding_ == 0) busySince_ = std::chrono::steady_clock::now();
+  outstanding_ += count;
+  stats_.tracksPending += count;
+  queued_.fetch_add(count);
+  if (threads_.empty()) {
+    for (unsigned i = 0; i < workers_.size(); ++i) {
+      threads_.emplace_back(&ScanPool::Run, this, i);
+    }
+  }
+  wake_.notify_all();
+  return count;
+}
+
+void ScanPool::Cancel() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    generation_.fetch_add(1);
+    size_t dropped = 0;
+    for (const std::unique_ptr<Worker>& worker : workers_) {
+      std::lock_guard<std::mutex> workerLock(worker->mutex);
+      for (const Job& job : worker->jobs) seen_.erase(job.key.path);
+      dropped += worker->jobs.size();
+      worker->jobs.clear();
+    }
+    queued_.fetch_sub(dropped);
+    outstanding_ -= dropped;
+    stats_.tracksPending -= dropped;
+    if (dropped > 0 && outstanding_ == 0) {
+      busyTime_ += std::chrono::steady_clock::now() - busySince_;
+    }
+  }
+  idle_.notify_all();
+}
+
+void ScanPool::WaitIdle() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!idle_.wait_for(lock, kWaitSlice, [this] { return outstanding_ == 0; })) {
+  }
+}
+
+ScanPool::Stats ScanPool::GetStats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Stats stats = stats_;
+  auto busy = busyTime_;
+  if (outstanding_ > 0) busy += std::chrono::steady_clock::now() - busySince_;
+  stats.busySeconds = std::chrono::duration<double>(busy).count();
+  return stats;
+}
+
+bool ScanPool::TakeJob(unsigned index, Job* job) {
+  {
+    Worker& own = *workers_[index];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    if (!own.jobs.empty()) {
+      *job = std::move(own.jobs.front());
+      own.jobs.pop_front();
+      queued_.fetch_sub(1);
+      return true;
+    }
+  }
+  for (size_t step = 1; step < workers_.size(); ++step) {
+    Worker& victim = *workers_[(index + step) % workers_.size()];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if (!victim.jobs.empty()) {
+      *job = std::move(victim.jobs.back());
+      victim.jobs.pop_back();
+      queued_.fetch_sub(1);
+      return true;
+    }
+  }
+  return false;
+}
+
+void ScanPool::Run(unsigned index) {
+  LowerThreadPriority();
+  while (true) {
+    Job job;
+    if (!TakeJob(index, &job)) {
+      std::unique_lock<std::mutex> lock(mutex_);
+      wake_.wait_for(lock, kWaitSlice,
+                     [this] { return stopping_ || queued_.load() > 0; });
+      if (stopping_) return;
+      continue;
+    }
+    Finish(job, scan_(job, generation_.load()));
+  }
+}
+
+void ScanPool::Finish(const Job& job, const Result& result) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    --outstanding_;
+    --stats_.tracksPending;
+    switch (result.outcome) {
+      case Outcome::kDone:
+        ++stats_.tracksDone;
+        stats_.audioSeconds += result.audioSeconds;
+        break;
+      case Outcome::kCached:
+        ++stats_.tracksCached;
+        break;
+      case Outcome::kFailed:
+        ++stats_.tracksFailed;
+        break;
+      case Outcome::kCancelled:
+        seen_.erase(job.key.path);
+        break;
+    }
+    if (outstanding_ == 0) {
+      busyTime_ += std::chrono::steady_clock::now() - busySince_;
+    }
+  }
+  idle_.notify_all();
+}
+
+}  // namespace audioengine
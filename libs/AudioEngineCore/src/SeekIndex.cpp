@@ -0,0 +1,145 @@
+#include "AudioEngineCore/SeekIndex.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <utility>
+
+#include "CacheFile.h"
+
+namespace audioengine {
+
+using cachefile::Fnv1a32;
+using cachefile::GetLe;
+using cachefile::GetVarint;
+using cachefile::PutLe;
+using cachefile::PutVarint;
+
+namespace {
+
+constexpr uint8_t kMagic[4] = {'T', 'N', 'S', 'X'};
+constexpr size_t kHeaderBytes = 40;
+constexpr size_t kTrailerBytes = 4;
+
+uint32_t PathHash(const std::string& path) {
+  return Fnv1a32(reinterpret_cast<const uint8_t*>(path.data()), path.size());
+}
+
+std::string CachePath(const std::string& cacheDir, const SeekIndex::Key& key) {
+  return cachefile::JoinPath(cacheDir, SeekIndex::CacheFileName(key));
+}
+
+}  // namespace
+
+SeekIndex::SeekIndex(uint32_t sampleRate, uint32_t intervalFrames)
+    : sampleRate_(sampleRate),
+      intervalFrames_(std::max<uint32_t>(intervalFrames, 1)) {}
+
+void SeekIndex::Add(uint64_t frame, uint64_t byteOffset) {
+  if (!points_.empty()) {
+    const SeekPoint& last = points_.back();
+    if (frame <= last.frame || byteOffset <= last.byteOffset) return;
+    if (frame / intervalFrames_ == last.frame / intervalFrames_) return;
+  }
+  points_.push_back({frame, byteOffset});
+}
+
+bool SeekIndex::Lookup(uint64_t frame, SeekPoint* point) const {
+  if (points_.empty() || frame < points_.front().frame) return false;
+  // Point i lives in bucket >= i, and every bucket holds at most one point,
+  // so the bucket number is an upper bound on the answer's index. Buckets
+  // are only empty where no packet started (silence gaps in ADTS, the tail),
+  // so the walk back is one step in practice.
+  size_t i = static_cast<size_t>(
+      std::min<uint64_t>(frame / intervalFrames_, points_.size() - 1));
+  while (points_[i].frame > frame) --i;
+  *point = points_[i];
+  return true;
+}
+
+std::vector<uint8_t> SeekIndex::Serialize(const Key& key) const {
+  std::vector<uint8_t> out;
+  out.reserve(kHeaderBytes + points_.size() * 5 + kTrailerBytes);
+  // resize + memcpy rather than a range insert into the reserved buffer,
+  // which GCC 12 misreads as an overflow (-Wstringop-overflow) in Release.
+  out.resize(sizeof(kMagic));
+  std::memcpy(out.data(), kMagic, sizeof(kMagic));
+  PutLe(&out, kSeekIndexVersion, 2);
+  PutLe(&out, 0, 2);
+  PutLe(&out, key.fileSize, 8);
+  PutLe(&out, static_cast<uint64_t>(key.mtimeSeconds), 8);
+  PutLe(&out, sampleRate_, 4);
+  PutLe(&out, intervalFrames_, 4);
+  PutLe(&out, points_.size(), 4);
+  PutLe(&out, PathHash(key.path), 4);
+  SeekPoint prev;
+  for (const SeekPoint& point : points_) {
+    PutVarint(&out, point.frame - prev.frame);
+    PutVarint(&out, point.byteOffset - prev.byteOffset);
+    prev = point;
+  }
+  PutLe(&out, Fnv1a32(out.data(), out.size()), 4);
+  return out;
+}
+
+bool SeekIndex::Deserialize(const uint8_t* data, size_t size, const Key& key) {
+  if (size < kHeaderBytes + kTrailerBytes) return false;
+  const size_t bodyEnd = size - kTrailerBytes;
+  if (GetLe(data + bodyEnd, 4) != Fnv1a32(data, bodyEnd)) return false;
+  if (!std::equal(std::begin(kMagic), std::end(kMagic), data)) return false;
+  if (GetLe(data + 4, 2) != kSeekIndexVersion) return false;
+  if (GetLe(data + 8, 8) != key.fileSize ||
+      static_cast<int64_t>(GetLe(data + 16, 8)) != key.mtimeSeconds ||
+      GetLe(data + 36, 4) != PathHash(key.path)) {
+    return false;
+  }
+
+  const uint32_t sampleRate = static_cast<uint32_t>(GetLe(data + 24, 4));
+  const uint32_t interval = static_cast<uint32_t>(GetLe(data + 28, 4));
+  const uint32_t count = static_cast<uint32_t>(GetLe(data + 32, 4));
+  if (interval == 0) return false;
+  // Each point takes at least two bytes, which bounds the reserve below.
+  if (count > (bodyEnd - kHeaderBytes) / 2) return false;
+
+  std::vector<SeekPoint> points;
+  points.reserve(count);
+  const uint8_t* in = data + kHeaderBytes;
+  const uint8_t* end = data + bodyEnd;
+  SeekPoint prev;
+  for (uint32_t i = 0; i < count; ++i) {
+    uint64_t frameDelta = 0;
+    uint64_t offsetDelta = 0;
+    if (!GetVarint(&in, end, &frameDelta) ||
+        !GetVarint(&in, end, &offsetDelta)) {
+      return false;
+    }
+    if (i > 0 && (frameDelta == 0 || offsetDelta == 0)) return false;
+    prev.frame += frameDelta;
+    prev.byteOffset += offsetDelta;
+    points.push_back(prev);
+  }
+  if (in != end) return false;
+
+  sampleRate_ = sampleRate;
+  intervalFrames_ = interval;
+  points_ = std::move(points);
+  return true;
+}
+
+std::string SeekIndex::CacheFileName(const Key& key) {
+  return cachefile::CacheFileName(key.path, key.fileSize, key.mtimeSeconds,
+                                  ".seekidx");
+}
+
+bool SeekIndex::Save(const std::string& cacheDir, const Key& key) const {
+  // Write-then-rename so a concurrent Load() never sees a partial file.
+  return cachefile::WriteAtomically(CachePath(cacheDir, key), Serialize(key));
+}
+
+bool SeekIndex::Load(const std::string& cacheDir, const Key& key) {
+  std::vector<uint8_t> bytes;
+  if (!cachefile::ReadAll(CachePath(cacheDir, key), &bytes)) return false;
+  return Deserialize(bytes.data(), bytes.size(), key);
+}
+
+}  // namespace audioengine
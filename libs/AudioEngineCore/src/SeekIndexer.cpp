@@ -0,0 +1,101 @@
+#include "AudioEngineCore/SeekIndexer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <utility>
+
+namespace audioengine {
+
+namespace {
+
+// Waits are bounded like the StreamingDecoder ones; the predicate is what
+// matters, the timeout only caps a missed notification.
+constexpr auto kWaitSlice = std::chrono::milliseconds(500);
+
+}  // namespace
+
+SeekIndexer::SeekIndexer(std::string cacheDir, BuildFn build)
+    : cacheDir_(std::move(cacheDir)),
+      build_(std::move(build)),
+      thread_(&SeekIndexer::Run, this) {}
+
+SeekIndexer::~SeekIndexer() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+    queue_.clear();
+  }
+  wake_.notify_all();
+  thread_.join();
+}
+
+bool SeekIndexer::Load(const SeekIndex::Key& key, SeekIndex* index) const {
+  return index->Load(cacheDir_, key);
+}
+
+void SeekIndexer::Request(const SeekIndex::Key& key) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stopping_ || Pending(key)) return;
+  }
+  // Checked outside the lock: a cache hit is the common case and reading the
+  // file must not stall other callers.
+  SeekIndex cached;
+  if (cached.Load(cacheDir_, key)) return;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stopping_ || Pending(key)) return;
+    queue_.push_back(key);
+  }
+  wake_.notify_one();
+}
+
+void SeekIndexer::WaitIdle() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!idle_.wait_for(lock, kWaitSlice, [this] {
+    return queue_.empty() && building_.empty();
+  })) {
+  }
+}
+
+size_t SeekIndexer::BuiltCount() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return built_;
+}
+
+bool SeekIndexer::Pending(const SeekIndex::Key& key) const {
+  const std::string name = SeekIndex::CacheFileName(key);
+  if (name == building_) return true;
+  return std::any_of(queue_.begin(), queue_.end(),
+                     [&name](const SeekIndex::Key& queued) {
+                       return SeekIndex::CacheFileName(queued) == name;
+                     });
+}
+
+void SeekIndexer::Run() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    wake_.wait_for(lock, kWaitSlice,
+                   [this] { return stopping_ || !queue_.empty(); });
+    if (!stopping_ && queue_.empty()) continue;
+    if (stopping_) break;
+    const SeekIndex::Key key = std::move(queue_.front());
+    queue_.pop_front();
+    building_ = SeekIndex::CacheFileName(key);
+    lock.unlock();
+
+    SeekIndex index;
+    const bool saved =
+        build_ && build_(key, &index) && !index.Empty() &&
+        index.Save(cacheDir_, key);
+
+    lock.lock();
+    if (saved) ++built_;
+    building_.clear();
+    if (queue_.empty()) idle_.notify_all();
+  }
+  building_.clear();
+  idle_.notify_all();
+}
+
+}  // namespace audioengine
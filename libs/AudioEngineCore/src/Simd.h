@@ -0,0 +1,86 @@
+// Instruction-set detection for the SIMD kernels, with the matching
+// intrinsics headers. AUDIOENGINE_HAVE_AVX2 only means AVX2 code can be
+// compiled (in functions marked AUDIOENGINE_TARGET_AVX2); whether it may
+// run is decided at runtime by ActiveKernelIsa(). LoadLanes4/StoreLanes4
+// move frames narrower than a register in and out of one.
+// Internal to the library; not installed with the public headers.
+#pragma once
+
+#include <cstdint>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define AUDIOENGINE_HAVE_SSE2 1
+#include <emmintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+#define AUDIOENGINE_HAVE_AVX2 1
+#define AUDIOENGINE_TARGET_AVX2 __attribute__((target("avx2")))
+#include <immintrin.h>
+#elif defined(_MSC_VER)
+// MSVC accepts AVX2 intrinsics in any function; only the CPU check matters.
+#define AUDIOENGINE_HAVE_AVX2 1
+#define AUDIOENGINE_TARGET_AVX2
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#define AUDIOENGINE_HAVE_NEON 1
+#include <arm_neon.h>
+#endif
+
+// Most kernels need AArch64's round-to-nearest conversions, fused
+// multiply-adds and horizontal reductions.
+#if defined(__aarch64__) || defined(_M_ARM64)
+#define AUDIOENGINE_HAVE_NEON64 1
+#endif
+
+namespace audioengine {
+
+#if AUDIOENGINE_HAVE_SSE2
+// The first `n` (1-4) floats at `p`, zeros above.
+inline __m128 LoadLanes4(const float* p, uint32_t n) {
+  switch (n) {
+    case 4: return _mm_loadu_ps(p);
+    case 2: return _mm_loadl_pi(_mm_setzero_ps(), reinterpret_cast<const __m64*>(p));
+    case 1: return _mm_load_ss(p);
+    default: return _mm_setr_ps(p[0], p[1], p[2], 0.0f);
+  }
+}
+
+// Writes the low `n` (1-4) lanes of `v` to `p`.
+inline void StoreLanes4(float* p, __m128 v, uint32_t n) {
+  switch (n) {
+    case 4: _mm_storeu_ps(p, v); break;
+    case 2: _mm_storel_pi(reinterpret_cast<__m64*>(p), v); break;
+    case 1: _mm_store_ss(p, v); break;
+    default:
+      _mm_storel_pi(reinterpret_cast<__m64*>(p), v);
+      _mm_store_ss(p + 2, _mm_movehl_ps(v, v));
+      break;
+  }
+}
+#endif
+
+#if AUDIOENGINE_HAVE_NEON64
+inline float32x4_t LoadLanes4(const float* p, uint32_t n) {
+  if (n == 4) return vld1q_f32(p);
+  if (n == 2) return vcombine_f32(vld1_f32(p), vdup_n_f32(0.0f));
+  const float padded[4] = {p[0], n > 1 ? p[1] : 0.0f, n > 2 ? p[2] : 0.0f, 0.0f};
+  return vld1q_f32(padded);
+}
+
+inline void StoreLanes4(float* p, float32x4_t v, uint32_t n) {
+  if (n == 4) {
+    vst1q_f32(p, v);
+  } else if (n == 2) {
+    vst1_f32(p, vget_low_f32(v));
+  } else {
+    float padded[4];
+    vst1q_f32(padded, v);
+    for (uint32_t ch = 0; ch < n; ++ch) p[ch] = padded[ch];
+  }
+}
+#endif
+
+}  // namespace audioengine
@@ -0,0 +1,274 @@
+#include "AudioEngineCore/Spectrum.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace audioengine {
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+// Frames converted per pass while draining the ring.
+constexpr size_t kChunkFrames = 1024;
+constexpr size_t kMinFftSize = 1024;
+constexpr size_t kMaxFftSize = 32768;
+// The worker drains at least this often, whatever the frame rate, so a
+// slow display does not let the ring fill and drop the newest audio.
+constexpr auto kMaxDrainInterval = std::chrono::milliseconds(50);
+// Levels this close to the floor snap onto it, so the decay ends.
+constexpr float kSettleDb = 0.05f;
+
+size_t NextPowerOfTwo(size_t value) {
+  size_t v = 1;
+  while (v < value) v <<= 1;
+  return v;
+}
+
+// Log-spaced band edges for `options` at `sampleRate`: band b spans
+// [edges[b], edges[b + 1]).
+uint32_t BandEdges(const SpectrumAnalyzer::Options& options, uint32_t sampleRate,
+                   double* edges) {
+  const uint32_t bands = std::clamp<uint32_t>(options.bands, 1, SpectrumAnalyzer::kMaxBands);
+  const double nyquist = sampleRate / 2.0;
+  const double maxHz = std::clamp(options.maxHz, 2.0, nyquist);
+  const double minHz = std::clamp(options.minHz, 1.0, maxHz / 2.0);
+  const double ratio = maxHz / minHz;
+  for (uint32_t b = 0; b <= bands; ++b) {
+    edges[b] = minHz * std::pow(ratio, static_cast<double>(b) / bands);
+  }
+  return bands;
+}
+
+}  // namespace
+
+SpectrumAnalyzer::~SpectrumAnalyzer() { StopWorker(); }
+
+bool SpectrumAnalyzer::Configure(const PcmFormat& format) {
+  StopWorker();
+  SampleType type;
+  if (format.sampleRate == 0 || format.channels == 0 || !SampleTypeOf(format, &type)) {
+    return false;
+  }
+  {
+    // BandCentersHz() reads it from any thread.
+    std::lock_guard<std::mutex> lock(mutex_);
+    format_ = format;
+  }
+  type_ = type;
+
+  // About 85 ms: 4096 points at 44.1 and 48 kHz, bins under 12 Hz apart.
+  const size_t size =
+      std::clamp(NextPowerOfTwo(format.sampleRate / 12), kMinFftSize, kMaxFftSize);
+  fft_.Configure(size);
+  ring_.Configure(format.BytesPerFrame(), std::max<size_t>(2 * size, format.sampleRate / 8));
+  dropped_.store(0);
+  raw_.assign(kChunkFrames * format.BytesPerFrame(), 0);
+  converted_.assign(kChunkFrames * format.channels, 0.0f);
+  history_.assign(size, 0.0f);
+  historyAt_ = 0;
+
+  // Periodic Hann; its coherent gain is 1/2, so a sine of amplitude A peaks
+  // at A * size / 4 in its bin.
+  window_.resize(size);
+  for (size_t i = 0; i < size; ++i) {
+    window_[i] = static_cast<float>(0.5 - 0.5 * std::cos(2.0 * kPi * i / size));
+  }
+  windowGain_ = 4.0f / static_cast<float>(size);
+  windowed_.assign(size, 0.0f);
+  re_.assign(fft_.Bins(), 0.0f);
+  im_.assign(fft_.Bins(), 0.0f);
+  magnitude_.assign(fft_.Bins(), 0.0f);
+  layout_.first.assign(kMaxBands, 0);
+  layout_.last.assign(kMaxBands, 0);
+  layout_.centre.assign(kMaxBands, 0.0f);
+  layoutVersion_ = 0;
+  // The triple buffer is left alone: Latest() may be running.
+
+  stopWorker_ = false;
+  worker_ = std::thread([this] { WorkerLoop(); });
+  return true;
+}
+
+void SpectrumAnalyzer::StopWorker() {
+  if (!worker_.joinable()) return;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopWorker_ = true;
+  }
+  wakeCv_.notify_all();
+  worker_.join();
+}
+
+void SpectrumAnalyzer::SetOptions(const Options& options) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    options_ = options;
+    options_.framesPerSecond =
+        std::clamp<uint32_t>(options.framesPerSecond, 1, kMaxFramesPerSecond);
+    ++optionsVersion_;
+  }
+  wakeCv_.notify_all();
+}
+
+SpectrumAnalyzer::Options SpectrumAnalyzer::GetOptions() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return options_;
+}
+
+void SpectrumAnalyzer::SetEnabled(bool enabled) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    enabled_.store(enabled);
+  }
+  wakeCv_.notify_all();
+}
+
+bool SpectrumAnalyzer::Latest(SpectrumFrame* frame) {
+  if (!(latest_.load(std::memory_order_relaxed) & kFresh)) return false;
+  readSlot_ = latest_.exchange(readSlot_, std::memory_order_acq_rel) & kSlotMask;
+  *frame = slots_[readSlot_];
+  return true;
+}
+
+std::vector<double> SpectrumAnalyzer::BandCentersHz() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  double edges[kMaxBands + 1];
+  const uint32_t bands = BandEdges(options_, format_.sampleRate != 0 ? format_.sampleRate : 48000,
+                                   edges);
+  std::vector<double> centres(bands);
+  for (uint32_t b = 0; b < bands; ++b) centres[b] = std::sqrt(edges[b] * edges[b + 1]);
+  return centres;
+}
+
+void SpectrumAnalyzer::WorkerLoop() {
+  using Clock = std::chrono::steady_clock;
+  std::unique_lock<std::mutex> lock(mutex_);
+  Clock::time_point lastFrame = Clock::now();
+  bool fresh = false;
+  bool settled = true;
+  while (true) {
+    if (!enabled_.load()) {
+      wakeCv_.wait(lock, [this] { return stopWorker_ || enabled_.load(); });
+      if (stopWorker_) return;
+      // Start over from silence, without what was left in the ring.
+      Drain();
+      std::fill(history_.begin(), history_.end(), 0.0f);
+      fresh = false;
+      lastFrame = Clock::now();
+    }
+    const Options options = options_;
+    const auto period = std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(1.0 / options.framesPerSecond));
+    const Clock::duration wait =
+        std::min<Clock::duration>(period - (Clock::now() - lastFrame), kMaxDrainInterval);
+    if (wait > Clock::duration::zero() &&
+        wakeCv_.wait_for(lock, wait, [this] { return stopWorker_; })) {
+      return;
+    }
+    if (stopWorker_) return;
+    if (!enabled_.load()) continue;
+    if (layoutVersion_ != optionsVersion_) {
+      BuildLayout(options);
+      layoutVersion_ = optionsVersion_;
+      settled = false;
+    }
+    lock.unlock();
+
+    fresh |= Drain() > 0;
+    const Clock::time_point now = Clock::now();
+    if (now - lastFrame >= period) {
+      if (fresh || !settled) {
+        const double seconds = std::chrono::duration<double>(now - lastFrame).count();
+        settled = !Analyse(options, seconds, fresh);
+        fresh = false;
+      }
+      lastFrame = now;
+    }
+    lock.lock();
+  }
+}
+
+size_t SpectrumAnalyzer::Drain() {
+  const uint32_t channels = format_.channels;
+  const float scale = 1.0f / static_cast<float>(channels);
+  const size_t mask = history_.size() - 1;
+  size_t total = 0;
+  while (const size_t frames = ring_.Read(raw_.data(), kChunkFrames)) {
+    ConvertSamples(type_, raw_.data(), SampleType::kF32, converted_.data(), frames * channels);
+    const float* in = converted_.data();
+    for (size_t f = 0; f < frames; ++f, in += channels) {
+      float sum = 0.0f;
+      for (uint32_t ch = 0; ch < channels; ++ch) sum += in[ch];
+      history_[historyAt_] = sum * scale;
+      historyAt_ = (historyAt_ + 1) & mask;
+    }
+    total += frames;
+  }
+  return total;
+}
+
+void SpectrumAnalyzer::BuildLayout(const Options& options) {
+  double edges[kMaxBands + 1];
+  const uint32_t bands = BandEdges(options, format_.sampleRate, edges);
+  const double binHz = static_cast<double>(format_.sampleRate) / fft_.Size();
+  const uint32_t bins = static_cast<uint32_t>(fft_.Bins());
+  for (uint32_t b = 0; b < bands; ++b) {
+    layout_.first[b] = std::min(bins, static_cast<uint32_t>(std::ceil(edges[b] / binHz)));
+    layout_.last[b] = std::min(bins, static_cast<uint32_t>(std::ceil(edges[b + 1] / binHz)));
+    layout_.centre[b] = static_cast<float>(std::sqrt(edges[b] * edges[b + 1]) / binHz);
+  }
+  layout_.bands = bands;
+  std::fill(std::begin(levels_), std::end(levels_), options.floorDb);
+}
+
+bool SpectrumAnalyzer::Analyse(const Options& options, double seconds, bool fresh) {
+  const size_t size = fft_.Size();
+  const size_t bins = fft_.Bins();
+  if (fresh) {
+    const size_t mask = size - 1;
+    for (size_t i = 0; i < size; ++i) {
+      windowed_[i] = history_[(historyAt_ + i) & mask] * window_[i];
+    }
+    fft_.Forward(windowed_.data(), re_.data(), im_.data());
+    for (size_t k = 0; k < bins; ++k) {
+      magnitude_[k] = std::sqrt(re_[k] * re_[k] + im_[k] * im_[k]) * windowGain_;
+    }
+  }
+
+  const float floor = options.floorDb;
+  const float fall = options.releaseMs > 0.0
+                         ? static_cast<float>(1.0 - std::exp(-seconds * 1000.0 / options.releaseMs))
+                         : 1.0f;
+  bool above = false;
+  for (uint32_t b = 0; b < layout_.bands; ++b) {
+    float target = floor;
+    if (fresh) {
+      float m = 0.0f;
+      if (layout_.first[b] < layout_.last[b]) {
+        m = *std::max_element(magnitude_.begin() + layout_.first[b],
+                              magnitude_.begin() + layout_.last[b]);
+      } else {
+        // Narrower than a bin: interpolate at the band's centre.
+        const float c = std::min(layout_.centre[b], static_cast<float>(bins - 1));
+        const size_t k = static_cast<size_t>(c);
+        const float t = c - static_cast<float>(k);
+        m = magnitude_[k] * (1.0f - t) + magnitude_[std::min(k + 1, bins - 1)] * t;
+      }
+      target = std::max(floor, 20.0f * std::log10(std::max(m, 1e-30f)));
+    }
+    float& level = levels_[b];
+    level = target >= level ? target : level + (target - level) * fall;
+    if (level - floor < kSettleDb) level = floor;
+    above |= level > floor;
+  }
+
+  SpectrumFrame& frame = slots_[writeSlot_];
+  frame.sequence = ++sequence_;
+  frame.bands = layout_.bands;
+  std::copy(levels_, levels_ + layout_.bands, frame.levelsDb);
+  writeSlot_ = latest_.exchange(writeSlot_ | kFresh, std::memory_order_acq_rel) & kSlotMask;
+  return above;
+}
+
+}  // namespace audioengine
@@ -0,0 +1,280 @@
+#include "AudioEngineCore/StreamingDecoder.h"
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <utility>
+
+#include "AudioEngineCore/AllocationCounter.h"
+
+namespace audioengine {
+
+namespace {
+
+// How long the producer parks when the ring is full. Short enough that a
+// 10 ms device period never drains a ring that was full on the last check.
+constexpr auto kFullRingBackoff = std::chrono::milliseconds(2);
+
+// Upper bound on how long Start()/Seek() wait for the first buffer.
+constexpr auto kPrefillTimeout = std::chrono::seconds(5);
+
+}  // namespace
+
+StreamingDecoder::StreamingDecoder() : StreamingDecoder(Options{}) {}
+
+StreamingDecoder::StreamingDecoder(const Options& options)
+    : options_(options) {}
+
+StreamingDecoder::~StreamingDecoder() { Stop(); }
+
+bool StreamingDecoder::Start(std::unique_ptr<PcmSource> source) {
+  Stop();
+  if (!source) return false;
+  const PcmFormat format = source->Format();
+  if (format.sampleRate == 0 || format.BytesPerFrame() == 0) return false;
+
+  source_ = std::move(source);
+  format_ = format;
+  const size_t capacity = std::max<size_t>(
+      options_.chunkFrames * 2,
+      static_cast<size_t>(options_.bufferSeconds * format_.sampleRate));
+  ring_.Configure(format_.BytesPerFrame(), capacity);
+  prefillFrames_ = std::min(
+      ring_.CapacityFrames() / 2,
+      static_cast<size_t>(options_.prefillSeconds * format_.sampleRate));
+  baseFrame_ = 0;
+  baseReadHead_ = 0;
+  steadyStateAllocations_.store(0);
+
+  StartThread();
+  WaitForPrefill();
+  return true;
+}
+
+void StreamingDecoder::Stop() {
+  StopThread();
+  {
+    std::lock_guard<std::mutex> lock(chainMutex_);
+    source_.reset();
+    next_.reset();
+    previous_.reset();
+  }
+  ring_.Reset();
+  sourceEnded_.store(false);
+  transitionPending_.store(false);
+  boundary_.store(0);
+  baseFrame_ = 0;
+  baseReadHead_ = 0;
+}
+
+bool StreamingDecoder::Seek(uint64_t frame, SeekMode mode) {
+  if (!source_) return false;
+  const auto started = std::chrono::steady_clock::now();
+  StopThread();
+  if (transitionPending_.load()) {
+    if (ring_.FramesRead() >= boundary_.load()) {
+      CollectTransition();
+    } else {
+      // Still playing the previous track: rewind the spliced one and queue
+      // it again behind the previous track.
+      std::lock_guard<std::mutex> lock(chainMutex_);
+      source_->SeekToFrame(0, SeekMode::kAccurate, nullptr);
+      next_ = std::move(source_);
+      source_ = std::move(previous_);
+      transitionPending_.store(false);
+    }
+  }
+  // The producer is parked, so anything still in the ring predates the seek.
+  ring_.Discard();
+  uint64_t landed = frame;
+  const bool ok = source_->SeekToFrame(frame, mode, &landed);
+  baseFrame_ = ok ? landed : frame;
+  baseReadHead_ = ring_.FramesRead();
+  sourceEnded_.store(false);
+  StartThread();
+  WaitForPrefill();
+  lastSeekDuration_ = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - started);
+  return ok;
+}
+
+size_t StreamingDecoder::Read(uint8_t* dst, size_t frames) {
+  return ring_.Read(dst, frames);
+}
+
+bool StreamingDecoder::IsFinished() const {
+  return sourceEnded_.load(std::memory_order_acquire) &&
+         ring_.AvailableFrames() == 0;
+}
+
+bool StreamingDecoder::IsActive() const {
+  std::lock_guard<std::mutex> lock(chainMutex_);
+  return source_ != nullptr;
+}
+
+uint64_t StreamingDecoder::PositionFrames() const {
+  const uint64_t read = ring_.FramesRead();
+  if (transitionPending_.load(std::memory_order_acquire)) {
+    const uint64_t boundary = boundary_.load(std::memory_order_relaxed);
+    if (read >= boundary) return read - boundary;
+  }
+  return baseFrame_ + (read - baseReadHead_);
+}
+
+uint64_t StreamingDecoder::ReadCountAt(uint64_t frame) const {
+  if (frame <= baseFrame_) return baseReadHead_;
+  return baseReadHead_ + (frame - baseFrame_);
+}
+
+uint64_t StreamingDecoder::PendingBoundary() const {
+  if (!transitionPending_.load(std::memory_order_acquire)) {
+    return std::numeric_limits<uint64_t>::max();
+  }
+  return boundary_.load(std::memory_order_relaxed);
+}
+
+uint64_t StreamingDecoder::TotalFrames() const {
+  std::lock_guard<std::mutex> lock(chainMutex_);
+  if (transitionPending_.load() && previous_ &&
+      ring_.FramesRead() < boundary_.load()) {
+    return previous_->TotalFrames();
+  }
+  return source_ ? source_->TotalFrames() : 0;
+}
+
+bool StreamingDecoder::QueueNext(std::unique_ptr<PcmSource> next) {
+  bool ended = false;
+  {
+    std::lock_guard<std::mutex> lock(chainMutex_);
+    if (!source_ || transitionPending_.load()) return false;
+    if (next && next->Format() != format_) return false;
+    next_ = std::move(next);
+    ended = next_ && sourceEnded_.load();
+  }
+  if (ended) {
+    // The producer already gave up on the current source; splice here and
+    // start it again. Whatever is left in the ring still plays first.
+    StopThread();
+    {
+      std::lock_guard<std::mutex> lock(chainMutex_);
+      previous_ = std::move(source_);
+      source_ = std::move(next_);
+      boundary_.store(ring_.FramesWritten(), std::memory_order_relaxed);
+      transitionPending_.store(true, std::memory_order_release);
+      sourceEnded_.store(false);
+    }
+    StartThread();
+  }
+  return true;
+}
+
+bool StreamingDecoder::HasQueuedNext() const {
+  std::lock_guard<std::mutex> lock(chainMutex_);
+  return next_ != nullptr;
+}
+
+bool StreamingDecoder::TakeTrackChange() {
+  if (!transitionPending_.load(std::memory_order_acquire)) return false;
+  if (ring_.FramesRead() < boundary_.load(std::memory_order_relaxed)) return false;
+  CollectTransition();
+  return true;
+}
+
+void StreamingDecoder::CollectTransition() {
+  std::unique_ptr<PcmSource> finished;
+  {
+    std::lock_guard<std::mutex> lock(chainMutex_);
+    finished = std::move(previous_);
+    baseFrame_ = 0;
+    baseReadHead_ = boundary_.load();
+    transitionPending_.store(false);
+  }
+  // Closing a decoder can touch the file system; do it outside the lock.
+  finished.reset();
+}
+
+void StreamingDecoder::StartThread() {
+  stopRequested_.store(false);
+  thread_ = std::thread(&StreamingDecoder::ProducerLoop, this);
+}
+
+void StreamingDecoder::StopThread() {
+  if (!thread_.joinable()) return;
+  {
+    std::lock_guard<std::mutex> lock(wakeMutex_);
+    stopRequested_.store(true);
+  }
+  wakeCv_.notify_all();
+  thread_.join();
+}
+
+void StreamingDecoder::WaitForPrefill() {
+  std::unique_lock<std::mutex> lock(wakeMutex_);
+  prefillCv_.wait_for(lock, kPrefillTimeout, [this] {
+    return sourceEnded_.load() || ring_.AvailableFrames() >= prefillFrames_;
+  });
+}
+
+void StreamingDecoder::ProducerLoop() {
+  // Do not wake up for slivers of free space; refill in sizeable chunks.
+  const size_t refillThreshold =
+      std::min(options_.chunkFrames, ring_.CapacityFrames() / 4);
+  bool prefilled = false;
+  uint64_t allocationBaseline = 0;
+
+  while (!stopRequested_.load(std::memory_order_acquire)) {
+    PcmRingBuffer::Regions regions = ring_.WritableRegions();
+    if (regions.TotalFrames() < refillThreshold) {
+      std::unique_lock<std::mutex> lock(wakeMutex_);
+      wakeCv_.wait_for(lock, kFullRingBackoff,
+                       [this] { return stopRequested_.load(); });
+      continue;
+    }
+
+    // Decode straight into the ring; the wrapped second region is picked up
+    // on the next iteration.
+    const size_t want = std::min(regions.first.frames, options_.chunkFrames);
+    const size_t got = source_->ReadFrames(regions.first.data, want);
+    if (prefilled) {
+      const uint64_t allocations =
+          debug::ThreadAllocationCount() - allocationBaseline;
+      if (allocations > 0) {
+        steadyStateAllocations_.fetch_add(allocations,
+                                          std::memory_order_relaxed);
+        allocationBaseline += allocations;
+      }
+    }
+    if (got == 0) {
+      if (SpliceNext()) continue;
+      break;
+    }
+    ring_.CommitWrite(got);
+
+    if (!prefilled && ring_.AvailableFrames() >= prefillFrames_) {
+      prefilled = true;
+      {
+        std::lock_guard<std::mutex> lock(wakeMutex_);
+        prefillCv_.notify_all();
+      }
+      allocationBaseline = debug::ThreadAllocationCount();
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(wakeMutex_);
+  prefillCv_.notify_all();
+}
+
+bool StreamingDecoder::SpliceNext() {
+  std::lock_guard<std::mutex> lock(chainMutex_);
+  if (!next_ || transitionPending_.load()) {
+    sourceEnded_.store(true, std::memory_order_release);
+    return false;
+  }
+  previous_ = std::move(source_);
+  source_ = std::move(next_);
+  boundary_.store(ring_.FramesWritten(), std::memory_order_relaxed);
+  transitionPending_.store(true, std::memory_order_release);
+  return true;
+}
+
+}  // namespace audioengine
@@ -0,0 +1,11 @@
+// Priority helper for the library's background worker pools.
+// Internal to the library; not installed with the public headers.
+#pragma once
+
+namespace audioengine {
+
+// Drops the calling thread below normal priority so library scans never
+// compete with the render or decode threads.
+void LowerThreadPriority();
+
+}  // namespace audioengine
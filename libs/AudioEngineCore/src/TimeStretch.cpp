@@ -0,0 +1,348 @@
+#include "AudioEngineCore/TimeStretch.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "AudioEngineCore/SampleKernels.h"
+#include "Simd.h"
+
+namespace audioengine {
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+// The guide signal runs at about this rate: enough to place a segment to a
+// few samples before the full-rate refinement.
+constexpr uint32_t kGuideRate = 12000;
+
+// dot = sum(a[i] * b[i]) and energy = sum(b[i]^2) over n samples.
+using CorrelateFn = void (*)(const float* a, const float* b, size_t n, float* dot,
+                             float* energy);
+
+void CorrelateScalar(const float* a, const float* b, size_t n, float* dot, float* energy) {
+  float d = 0.0f;
+  float e = 0.0f;
+  for (size_t i = 0; i < n; ++i) {
+    d += a[i] * b[i];
+    e += b[i] * b[i];
+  }
+  *dot = d;
+  *energy = e;
+}
+
+#if AUDIOENGINE_HAVE_SSE2
+inline float HorizontalSum(__m128 v) {
+  v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+  v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 1));
+  return _mm_cvtss_f32(v);
+}
+
+void CorrelateSse2(const float* a, const float* b, size_t n, float* dot, float* energy) {
+  __m128 d = _mm_setzero_ps();
+  __m128 e = _mm_setzero_ps();
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    const __m128 y = _mm_loadu_ps(b + i);
+    d = _mm_add_ps(d, _mm_mul_ps(_mm_loadu_ps(a + i), y));
+    e = _mm_add_ps(e, _mm_mul_ps(y, y));
+  }
+  float dSum = HorizontalSum(d);
+  float eSum = HorizontalSum(e);
+  for (; i < n; ++i) {
+    dSum += a[i] * b[i];
+    eSum += b[i] * b[i];
+  }
+  *dot = dSum;
+  *energy = eSum;
+}
+#endif
+
+#if AUDIOENGINE_HAVE_AVX2
+AUDIOENGINE_TARGET_AVX2
+void CorrelateAvx2(const float* a, const float* b, size_t n, float* dot, float* energy) {
+  __m256 d = _mm256_setzero_ps();
+  __m256 e = _mm256_setzero_ps();
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    const __m256 y = _mm256_loadu_ps(b + i);
+    d = _mm256_add_ps(d, _mm256_mul_ps(_mm256_loadu_ps(a + i), y));
+    e = _mm256_add_ps(e, _mm256_mul_ps(y, y));
+  }
+  float dSum = HorizontalSum(
+      _mm_add_ps(_mm256_castps256_ps128(d), _mm256_extractf128_ps(d, 1)));
+  float eSum = HorizontalSum(
+      _mm_add_ps(_mm256_castps256_ps128(e), _mm256_extractf128_ps(e, 1)));
+  for (; i < n; ++i) {
+    dSum += a[i] * b[i];
+    eSum += b[i] * b[i];
+  }
+  *dot = dSum;
+  *energy = eSum;
+}
+#endif
+
+#if AUDIOENGINE_HAVE_NEON64
+void CorrelateNeon(const float* a, const float* b, size_t n, float* dot, float* energy) {
+  float32x4_t d = vdupq_n_f32(0.0f);
+  float32x4_t e = vdupq_n_f32(0.0f);
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    const float32x4_t y = vld1q_f32(b + i);
+    d = vfmaq_f32(d, vld1q_f32(a + i), y);
+    e = vfmaq_f32(e, y, y);
+  }
+  float dSum = vaddvq_f32(d);
+  float eSum = vaddvq_f32(e);
+  for (; i < n; ++i) {
+    dSum += a[i] * b[i];
+    eSum += b[i] * b[i];
+  }
+  *dot = dSum;
+  *energy = eSum;
+}
+#endif
+
+CorrelateFn SelectKernel(KernelIsa isa) {
+  switch (isa) {
+#if AUDIOENGINE_HAVE_AVX2
+    case KernelIsa::kAvx2: return CorrelateAvx2;
+#endif
+#if AUDIOENGINE_HAVE_SSE2
+    case KernelIsa::kSse2: return CorrelateSse2;
+#endif
+#if AUDIOENGINE_HAVE_NEON64
+    case KernelIsa::kNeon: return CorrelateNeon;
+#endif
+    default: return CorrelateScalar;
+  }
+}
+
+// Normalized cross-correlation, up to the reference's energy, which is the
+// same for every candidate.
+inline float Similarity(float dot, float energy) {
+  return dot / std::sqrt(energy + 1e-12f);
+}
+
+}  // namespace
+
+bool TimeStretcher::Configure(uint32_t sampleRate, uint32_t channels) {
+  if (channels == 0 || channels > kMaxChannels || sampleRate == 0) {
+    sampleRate_ = 0;
+    channels_ = 0;
+    return false;
+  }
+  sampleRate_ = sampleRate;
+  channels_ = channels;
+  decimation_ = std::max<uint32_t>(1, sampleRate / kGuideRate);
+  // Whole guide samples per hop and per search range.
+  const auto frames = [&](double ms) {
+    const uint32_t n = static_cast<uint32_t>(std::lround(ms * sampleRate / 1000.0));
+    return std::max<uint32_t>(decimation_, n / decimation_ * decimation_);
+  };
+  hop_ = frames(kHopMs);
+  search_ = frames(kSearchMs);
+
+  // Periodic Hann over two hops: its halves sum to 1.
+  window_.resize(hop_);
+  for (uint32_t i = 0; i < hop_; ++i) {
+    window_[i] = static_cast<float>(0.5 - 0.5 * std::cos(kPi * i / hop_));
+  }
+  // What a hop at kMaxRate needs from the oldest frame the one before it
+  // kept (see InputWanted()), with a margin for rounding.
+  capacity_ = 5 * hop_ + 2 * search_ + 2 * decimation_ + 16;
+  input_.assign(capacity_ * channels_, 0.0f);
+  mono_.assign(capacity_, 0.0f);
+  guide_.assign(capacity_ / decimation_ + 1, 0.0f);
+  output_.assign(static_cast<size_t>(hop_) * channels_, 0.0f);
+  Reset();
+  return true;
+}
+
+void TimeStretcher::SetRate(double rate) {
+  rate_.store(std::min(std::max(rate, kMinRate), kMaxRate), std::memory_order_relaxed);
+}
+
+bool TimeStretcher::Idle() const {
+  return !stretching_ && end_ == cursor_ && outputLeft_ == 0 && Rate() == 1.0;
+}
+
+void TimeStretcher::Reset() {
+  start_ = end_ = cursor_ = 0;
+  prev_ = 0;
+  target_ = 0.0;
+  stretching_ = false;
+  outputAt_ = outputLeft_ = 0;
+  held_.store(0, std::memory_order_relaxed);
+}
+
+size_t TimeStretcher::TakeOutput(float* out, size_t frames) {
+  size_t taken = std::min(frames, outputLeft_);
+  std::memcpy(out, output_.data() + outputAt_ * channels_,
+              taken * channels_ * sizeof(float));
+  outputAt_ += taken;
+  outputLeft_ -= taken;
+  if (!stretching_ && taken < frames && cursor_ < end_) {
+    const size_t held = std::min(frames - taken, static_cast<size_t>(end_ - cursor_));
+    std::memcpy(out + taken * channels_, input_.data() + (cursor_ - start_) * channels_,
+                held * channels_ * sizeof(float));
+    cursor_ += static_cast<int64_t>(held);
+    taken += held;
+  }
+  return taken;
+}
+
+bool TimeStretcher::BeginHop() {
+  hopRate_ = Rate();
+  const bool stretch = hopRate_ != 1.0;
+  if (stretch == stretching_) return stretching_;
+  if (stretch) {
+    // Nothing is held here: TakeOutput() has passed it all out. The first
+    // segment overlaps a virtual one ending where the input starts.
+    start_ = end_ = cursor_ = 0;
+    prev_ = -static_cast<int64_t>(hop_);
+    target_ = static_cast<double>(prev_);
+    stretching_ = true;
+  } else {
+    PassThrough();
+  }
+  return stretching_;
+}
+
+void TimeStretcher::PassThrough() {
+  // The fade-out half of the last segment overlapped with the input that
+  // follows it sums back to that input, so playing on from there is exact.
+  cursor_ = std::min(prev_ + static_cast<int64_t>(hop_), end_);
+  cursor_ = std::max(cursor_, start_);
+  stretching_ = false;
+}
+
+size_t TimeStretcher::InputWanted() {
+  const int64_t center = std::llround(target_ + hop_ * hopRate_);
+  const int64_t needed = center + search_ + 2 * static_cast<int64_t>(hop_);
+  if (needed <= end_) return 0;
+
+  // The next hop reads the previous segment's second half and searches
+  // from at least kMinRate x hop past its target; older input can go.
+  int64_t keep = std::min(prev_ + static_cast<int64_t>(hop_),
+                          static_cast<int64_t>(std::floor(target_ + hop_ * kMinRate)) -
+                              static_cast<int64_t>(search_));
+  keep = std::max(keep, start_);
+  keep = start_ + (keep - start_) / decimation_ * decimation_;
+  if (keep > start_) {
+    const size_t drop = static_cast<size_t>(keep - start_);
+    const size_t kept = static_cast<size_t>(end_ - keep);
+    std::memmove(input_.data(), input_.data() + drop * channels_,
+                 kept * channels_ * sizeof(float));
+    std::memmove(mono_.data(), mono_.data() + drop, kept * sizeof(float));
+    std::memmove(guide_.data(), guide_.data() + drop / decimation_,
+                 (kept / decimation_) * sizeof(float));
+    start_ = keep;
+  }
+  const size_t room = capacity_ - static_cast<size_t>(end_ - start_);
+  return std::min(static_cast<size_t>(needed - end_), room);
+}
+
+void TimeStretcher::CommitInput(size_t frames) {
+  const size_t from = static_cast<size_t>(end_ - start_);
+  const float* in = input_.data() + from * channels_;
+  const float scale = 1.0f / channels_;
+  for (size_t f = 0; f < frames; ++f) {
+    float sum = 0.0f;
+    for (uint32_t ch = 0; ch < channels_; ++ch) sum += in[f * channels_ + ch];
+    mono_[from + f] = sum * scale;
+  }
+  // Guide samples for every group of decimation_ frames just completed.
+  const size_t to = from + frames;
+  const float groupScale = 1.0f / decimation_;
+  for (size_t g = from / decimation_; g < to / decimation_; ++g) {
+    float sum = 0.0f;
+    for (uint32_t i = 0; i < decimation_; ++i) sum += mono_[g * decimation_ + i];
+    guide_[g] = sum * groupScale;
+  }
+  end_ += static_cast<int64_t>(frames);
+}
+
+int64_t TimeStretcher::Search(int64_t lo, int64_t hi) const {
+  const CorrelateFn correlate = SelectKernel(ActiveKernelIsa());
+  const int64_t reference = prev_ + hop_;
+  float dot, energy;
+
+  int64_t fineLo = lo;
+  int64_t fineHi = hi;
+  const int64_t d = decimation_;
+  const int64_t guideCount = (end_ - start_) / d;
+  const int64_t guideLength = hop_ / d;
+  // The reference in guide samples, and its offset from the grid, which
+  // every candidate keeps so they all line up with the guide the same way.
+  const int64_t guideReference = (reference - start_) / d;
+  const int64_t offset = reference - start_ - guideReference * d;
+  const int64_t first = std::max<int64_t>(0, (lo - start_ - offset + d - 1) / d);
+  const int64_t last = std::min((hi - start_ - offset) / d, guideCount - guideLength);
+  if (d > 1 && last - first > 2 && guideReference + guideLength <= guideCount) {
+    const float* ref = guide_.data() + guideReference;
+    float best = -INFINITY;
+    int64_t bestAt = first;
+    for (int64_t g = first; g <= last; ++g) {
+      correlate(ref, guide_.data() + g, static_cast<size_t>(guideLength), &dot, &energy);
+      const float score = Similarity(dot, energy);
+      if (score > best) {
+        best = score;
+        bestAt = g;
+      }
+    }
+    const int64_t coarse = start_ + bestAt * d + offset;
+    fineLo = std::max(lo, coarse - d);
+    fineHi = std::min(hi, coarse + d);
+  }
+
+  const float* ref = mono_.data() + (reference - start_);
+  float best = -INFINITY;
+  int64_t bestAt = fineLo;
+  for (int64_t c = fineLo; c <= fineHi; ++c) {
+    correlate(ref, mono_.data() + (c - start_), hop_, &dot, &energy);
+    const float score = Similarity(dot, energy);
+    if (score > best) {
+      best = score;
+      bestAt = c;
+    }
+  }
+  return bestAt;
+}
+
+void TimeStretcher::Step() {
+  const double target = target_ + hop_ * hopRate_;
+  const int64_t center = std::llround(target);
+  const int64_t lo = std::max(center - static_cast<int64_t>(search_), start_);
+  const int64_t hi = std::max(
+      lo, std::min(center + static_cast<int64_t>(search_), end_ - 2 * static_cast<int64_t>(hop_)));
+  const int64_t next = Search(lo, hi);
+
+  // The previous segment's falling half over the new one's rising half.
+  // Before the first real segment the falling half is the new input itself,
+  // faded in from where the virtual segment hands over.
+  const int64_t reference = prev_ + hop_;
+  const float* fading = input_.data() + (reference - start_) * channels_;
+  const float* rising = input_.data() + (next - start_) * channels_;
+  float* out = output_.data();
+  for (uint32_t f = 0; f < hop_; ++f) {
+    const float w = window_[f];
+    for (uint32_t ch = 0; ch < channels_; ++ch) {
+      const size_t i = static_cast<size_t>(f) * channels_ + ch;
+      out[i] = fading[i] + w * (rising[i] - fading[i]);
+    }
+  }
+  prev_ = next;
+  target_ = target;
+  outputAt_ = 0;
+  outputLeft_ = hop_;
+}
+
+void TimeStretcher::PublishHeld() {
+  const int64_t audible = (stretching_ ? prev_ + hop_ : cursor_) -
+                          static_cast<int64_t>(std::llround(outputLeft_ * hopRate_));
+  held_.store(end_ > audible ? static_cast<uint64_t>(end_ - audible) : 0,
+              std::memory_order_relaxed);
+}
+
+}  // namespace audioengine
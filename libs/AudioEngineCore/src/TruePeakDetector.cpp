@@ -0,0 +1,83 @@
+#include "AudioEngineCore/TruePeakDetector.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace audioengine {
+
+namespace {
+
+constexpr uint32_t kTaps = TruePeakDetector::kTaps;
+constexpr uint32_t kOversample = TruePeakDetector::kOversample;
+// Tap holding the frame being measured.
+constexpr uint32_t kCentre = kTaps - 1 - TruePeakDetector::kLatencyFrames;
+constexpr double kPi = 3.14159265358979323846;
+
+// Hann-windowed sinc for the sub-sample offset `phase / kOversample`, each
+// phase normalized to unity DC gain.
+void DesignInterpolator(float (*coeffs)[kTaps]) {
+  const double halfWidth = kTaps / 2.0 + 0.5;
+  for (uint32_t phase = 1; phase < kOversample; ++phase) {
+    double sum = 0.0;
+    double taps[kTaps];
+    for (uint32_t k = 0; k < kTaps; ++k) {
+      const double t = static_cast<double>(k) - kCentre -
+                       static_cast<double>(phase) / kOversample;
+      const double sinc = std::sin(kPi * t) / (kPi * t);
+      const double window = 0.5 + 0.5 * std::cos(kPi * t / halfWidth);
+      taps[k] = sinc * window;
+      sum += taps[k];
+    }
+    for (uint32_t k = 0; k < kTaps; ++k) {
+      coeffs[phase - 1][k] = static_cast<float>(taps[k] / sum);
+    }
+  }
+}
+
+}  // namespace
+
+void TruePeakDetector::Configure(uint32_t channels) {
+  channels_ = channels;
+  DesignInterpolator(coeffs_);
+  history_.assign(static_cast<size_t>(channels) * 2 * kTaps, 0.0f);
+  historyPos_ = 0;
+}
+
+void TruePeakDetector::Reset() {
+  std::fill(history_.begin(), history_.end(), 0.0f);
+  historyPos_ = 0;
+}
+
+float TruePeakDetector::PushChannel(uint32_t ch, float sample) {
+  // Each sample is stored twice, kTaps apart, so the last kTaps samples
+  // are always contiguous and the filter needs no index wrapping.
+  float* h = history_.data() + static_cast<size_t>(ch) * 2 * kTaps;
+  h[historyPos_] = sample;
+  h[historyPos_ + kTaps] = sample;
+  const float* window = h + historyPos_ + 1;
+  float peak = std::fabs(window[kCentre]);
+  for (uint32_t phase = 0; phase < kOversample - 1; ++phase) {
+    float acc = 0.0f;
+    for (uint32_t k = 0; k < kTaps; ++k) acc += coeffs_[phase][k] * window[k];
+    peak = std::max(peak, std::fabs(acc));
+  }
+  return peak;
+}
+
+float TruePeakDetector::Push(const float* frame) {
+  float peak = 0.0f;
+  for (uint32_t ch = 0; ch < channels_; ++ch) {
+    peak = std::max(peak, PushChannel(ch, frame[ch]));
+  }
+  historyPos_ = historyPos_ + 1 == kTaps ? 0 : historyPos_ + 1;
+  return peak;
+}
+
+void TruePeakDetector::Accumulate(const float* frame, float* peaks) {
+  for (uint32_t ch = 0; ch < channels_; ++ch) {
+    peaks[ch] = std::max(peaks[ch], PushChannel(ch, frame[ch]));
+  }
+  historyPos_ = historyPos_ + 1 == kTaps ? 0 : historyPos_ + 1;
+}
+
+}  // namespace audioengine
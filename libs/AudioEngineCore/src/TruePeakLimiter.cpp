@@ -0,0 +1,136 @@
+#include "AudioEngineCore/TruePeakLimiter.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace audioengine {
+
+namespace {
+
+// The detector measures the frame kLatencyFrames behind the input.
+constexpr uint32_t kDetectorLag = TruePeakDetector::kLatencyFrames;
+
+// Envelopes closer to unity than this count as "not limiting" in the stats.
+constexpr float kLimitingThreshold = 0.9999f;
+
+}  // namespace
+
+void TruePeakLimiter::Configure(uint32_t sampleRate, uint32_t channels,
+                                const Options& options) {
+  sampleRate_ = sampleRate;
+  channels_ = channels;
+  ceiling_ = static_cast<float>(std::pow(10.0, options.ceilingDb / 20.0));
+  const double releaseFrames = options.releaseMs * sampleRate / 1000.0;
+  releaseCoeff_ =
+      releaseFrames > 0.0 ? static_cast<float>(std::exp(-1.0 / releaseFrames)) : 0.0f;
+  lookahead_ = std::max<uint32_t>(
+      1, static_cast<uint32_t>(std::lround(options.lookaheadMs * sampleRate / 1000.0)));
+  // The box filter has fully applied a required gain `lookahead_ - 1` frames
+  // after the detector produced it. An inter-sample peak constrains the
+  // frames on both sides of it, so the hold spans one frame more than the
+  // box (see HoldMinimum()).
+  delay_ = lookahead_ - 1 + kDetectorLag;
+  detector_.Configure(channels);
+  delayLine_.assign(static_cast<size_t>(channels) * delay_, 0.0f);
+  minGain_.assign(lookahead_ + 2, 1.0f);
+  minFrame_.assign(lookahead_ + 2, 0);
+  boxRing_.assign(lookahead_, 1.0f);
+  Reset();
+  framesProcessed_.store(0);
+  framesLimited_.store(0);
+  minEnvelope_.store(1.0f);
+  processNanos_.store(0);
+}
+
+void TruePeakLimiter::Reset() {
+  detector_.Reset();
+  std::fill(delayLine_.begin(), delayLine_.end(), 0.0f);
+  std::fill(boxRing_.begin(), boxRing_.end(), 1.0f);
+  delayPos_ = 0;
+  minHead_ = 0;
+  minCount_ = 0;
+  frameIndex_ = 0;
+  boxPos_ = 0;
+  boxSum_ = static_cast<double>(lookahead_);
+  envelope_ = 1.0f;
+}
+
+float TruePeakLimiter::RequiredGain(const float* frame) {
+  const float peak = detector_.Push(frame);
+  return peak > ceiling_ ? ceiling_ / peak : 1.0f;
+}
+
+float TruePeakLimiter::HoldMinimum(float gain) {
+  const uint32_t capacity = static_cast<uint32_t>(minGain_.size());
+  const uint32_t hold = lookahead_ + 1;
+  while (minCount_ > 0) {
+    const uint32_t back = (minHead_ + minCount_ - 1) % capacity;
+    if (minGain_[back] < gain) break;
+    --minCount_;
+  }
+  const uint32_t slot = (minHead_ + minCount_) % capacity;
+  minGain_[slot] = gain;
+  minFrame_[slot] = frameIndex_;
+  ++minCount_;
+  while (minFrame_[minHead_] + hold <= frameIndex_) {
+    minHead_ = (minHead_ + 1) % capacity;
+    --minCount_;
+  }
+  ++frameIndex_;
+  return minGain_[minHead_];
+}
+
+void TruePeakLimiter::Process(float* samples, size_t frames) {
+  if (channels_ == 0) return;
+  const auto start = std::chrono::steady_clock::now();
+  uint64_t limited = 0;
+  float lowest = 1.0f;
+  for (size_t f = 0; f < frames; ++f) {
+    float* frame = samples + f * channels_;
+    const float held = HoldMinimum(RequiredGain(frame));
+
+    boxSum_ += static_cast<double>(held) - boxRing_[boxPos_];
+    boxRing_[boxPos_] = held;
+    boxPos_ = boxPos_ + 1 == lookahead_ ? 0 : boxPos_ + 1;
+    const float smooth =
+        std::min(1.0f, static_cast<float>(boxSum_ / lookahead_));
+    // Attack follows the ramp exactly; release eases back towards it.
+    envelope_ = smooth < envelope_
+                    ? smooth
+                    : smooth + (envelope_ - smooth) * releaseCoeff_;
+    if (envelope_ < kLimitingThreshold) ++limited;
+    lowest = std::min(lowest, envelope_);
+
+    float* delayed = delayLine_.data() + static_cast<size_t>(delayPos_) * channels_;
+    for (uint32_t ch = 0; ch < channels_; ++ch) {
+      const float input = frame[ch];
+      frame[ch] = delayed[ch] * envelope_;
+      delayed[ch] = input;
+    }
+    delayPos_ = delayPos_ + 1 == delay_ ? 0 : delayPos_ + 1;
+  }
+
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+  framesProcessed_.fetch_add(frames, std::memory_order_relaxed);
+  framesLimited_.fetch_add(limited, std::memory_order_relaxed);
+  if (lowest < minEnvelope_.load(std::memory_order_relaxed)) {
+    minEnvelope_.store(lowest, std::memory_order_relaxed);
+  }
+  processNanos_.fetch_add(
+      static_cast<uint64_t>(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()),
+      std::memory_order_relaxed);
+}
+
+TruePeakLimiter::Stats TruePeakLimiter::GetStats() const {
+  Stats stats;
+  stats.framesProcessed = framesProcessed_.load(std::memory_order_relaxed);
+  stats.framesLimited = framesLimited_.load(std::memory_order_relaxed);
+  stats.maxReductionDb =
+      -20.0f * std::log10(std::max(minEnvelope_.load(std::memory_order_relaxed), 1e-6f));
+  stats.processNanos = processNanos_.load(std::memory_order_relaxed);
+  return stats;
+}
+
+}  // namespace audioengine
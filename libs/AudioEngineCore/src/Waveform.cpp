@@ -0,0 +1,279 @@
+#include "AudioEngineCore/Waveform.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iterator>
+#include <limits>
+
+#include "CacheFile.h"
+
+namespace audioengine {
+
+using cachefile::Fnv1a32;
+using cachefile::GetLe;
+using cachefile::PutLe;
+
+namespace {
+
+constexpr uint8_t kMagic[4] = {'T', 'N', 'W', 'F'};
+constexpr size_t kHeaderBytes = 48;
+constexpr size_t kChecksumOffset = 44;
+constexpr size_t kLevelEntryBytes = 8;
+constexpr size_t kPointBytes = 6;
+// Each level merges this many points of the one below.
+constexpr size_t kLevelFactor = 4;
+
+uint32_t PathHash(const std::string& path) {
+  return Fnv1a32(reinterpret_cast<const uint8_t*>(path.data()), path.size());
+}
+
+// Header (minus its checksum) and level table, which is all Map() verifies.
+uint32_t HeaderChecksum(const uint8_t* data, size_t levels) {
+  return Fnv1a32(data + kHeaderBytes, levels * kLevelEntryBytes,
+                 Fnv1a32(data, kChecksumOffset));
+}
+
+int16_t Quantize(float value) {
+  const float scaled = std::round(value * Waveform::kFullScale);
+  return static_cast<int16_t>(std::clamp(scaled, -32768.0f, 32767.0f));
+}
+
+}  // namespace
+
+Waveform::~Waveform() = default;
+
+const WaveformLevel& Waveform::LevelFor(size_t points) const {
+  for (size_t i = levels_.size(); i-- > 1;) {
+    if (levels_[i].count >= points) return levels_[i];
+  }
+  return levels_.front();
+}
+
+std::vector<uint8_t> Waveform::Serialize(const SeekIndex::Key& key) const {
+  size_t points = 0;
+  for (const WaveformLevel& level : levels_) points += level.count;
+  std::vector<uint8_t> out;
+  out.reserve(kHeaderBytes + levels_.size() * kLevelEntryBytes + points * kPointBytes);
+  out.resize(sizeof(kMagic));
+  std::memcpy(out.data(), kMagic, sizeof(kMagic));
+  PutLe(&out, kWaveformCacheVersion, 2);
+  PutLe(&out, levels_.size(), 2);
+  PutLe(&out, key.fileSize, 8);
+  PutLe(&out, static_cast<uint64_t>(key.mtimeSeconds), 8);
+  PutLe(&out, sampleRate_, 4);
+  PutLe(&out, PathHash(key.path), 4);
+  PutLe(&out, frames_, 8);
+  PutLe(&out, channels_, 4);
+  PutLe(&out, 0, 4);  // checksum, below
+  for (const WaveformLevel& level : levels_) {
+    PutLe(&out, level.framesPerPoint, 4);
+    PutLe(&out, level.count, 4);
+  }
+  const uint32_t checksum = HeaderChecksum(out.data(), levels_.size());
+  for (int i = 0; i < 4; ++i) {
+    out[kChecksumOffset + i] = static_cast<uint8_t>(checksum >> (8 * i));
+  }
+  for (const WaveformLevel& level : levels_) {
+    for (size_t i = 0; i < level.count; ++i) {
+      PutLe(&out, static_cast<uint16_t>(level.points[i].min), 2);
+      PutLe(&out, static_cast<uint16_t>(level.points[i].max), 2);
+      PutLe(&out, static_cast<uint16_t>(level.points[i].rms), 2);
+    }
+  }
+  return out;
+}
+
+std::string Waveform::CacheFileName(const SeekIndex::Key& key) {
+  return cachefile::CacheFileName(key.path, key.fileSize, key.mtimeSeconds,
+                                  ".waveform");
+}
+
+bool Waveform::Save(const std::string& cacheDir, const SeekIndex::Key& key) const {
+  return cachefile::WriteAtomically(cachefile::JoinPath(cacheDir, CacheFileName(key)),
+                                    Serialize(key));
+}
+
+std::shared_ptr<const Waveform> Waveform::Map(const std::string& cacheDir,
+                                              const SeekIndex::Key& key) {
+  if (cacheDir.empty()) return nullptr;
+  auto file = std::make_unique<cachefile::MappedFile>();
+  if (!file->Open(cachefile::JoinPath(cacheDir, CacheFileName(key)))) return nullptr;
+  const uint8_t* data = file->Data();
+  const size_t size = file->Size();
+  if (size < kHeaderBytes) return nullptr;
+  if (!std::equal(std::begin(kMagic), std::end(kMagic), data)) return nullptr;
+  if (GetLe(data + 4, 2) != kWaveformCacheVersion) return nullptr;
+  const size_t levels = static_cast<size_t>(GetLe(data + 6, 2));
+  if (levels == 0 || levels > kMaxLevels) return nullptr;
+  const size_t tableEnd = kHeaderBytes + levels * kLevelEntryBytes;
+  if (size < tableEnd || GetLe(data + kChecksumOffset, 4) != HeaderChecksum(data, levels)) {
+    return nullptr;
+  }
+  if (GetLe(data + 8, 8) != key.fileSize ||
+      static_cast<int64_t>(GetLe(data + 16, 8)) != key.mtimeSeconds ||
+      GetLe(data + 28, 4) != PathHash(key.path)) {
+    return nullptr;
+  }
+
+  std::shared_ptr<Waveform> waveform(new Waveform());
+  waveform->sampleRate_ = static_cast<uint32_t>(GetLe(data + 24, 4));
+  waveform->frames_ = GetLe(data + 32, 8);
+  waveform->channels_ = static_cast<uint32_t>(GetLe(data + 40, 4));
+  if (waveform->sampleRate_ == 0) return nullptr;
+  size_t offset = tableEnd;
+  for (size_t i = 0; i < levels; ++i) {
+    const uint8_t* entry = data + kHeaderBytes + i * kLevelEntryBytes;
+    WaveformLevel level;
+    level.framesPerPoint = static_cast<uint32_t>(GetLe(entry, 4));
+    level.count = static_cast<size_t>(GetLe(entry + 4, 4));
+    if (level.framesPerPoint == 0 || level.count == 0 ||
+        level.count > (size - offset) / kPointBytes) {
+      return nullptr;
+    }
+    // Offsets stay even, and the mapping is page-aligned.
+    level.points = reinterpret_cast<const WaveformPoint*>(data + offset);
+    offset += level.count * kPointBytes;
+    waveform->levels_.push_back(level);
+  }
+  if (offset != size) return nullptr;
+  waveform->mapped_ = std::move(file);
+  return waveform;
+}
+
+uint32_t WaveformBuilder::BaseFramesPerPoint(uint32_t sampleRate) {
+  uint32_t frames = 1;
+  while (frames < sampleRate / 64) frames <<= 1;
+  return frames;
+}
+
+void WaveformBuilder::Configure(uint32_t sampleRate, uint32_t channels) {
+  sampleRate_ = sampleRate;
+  channels_ = channels;
+  measured_ = std::min(channels, kMaxChannels);
+  framesPerPoint_ = sampleRate > 0 && channels > 0 ? BaseFramesPerPoint(sampleRate) : 0;
+  frames_ = 0;
+  current_ = Accumulator{std::numeric_limits<float>::infinity(),
+                         -std::numeric_limits<float>::infinity(), 0.0, 0};
+  currentFrames_ = 0;
+  points_.clear();
+}
+
+void WaveformBuilder::Process(const float* samples, size_t frames) {
+  if (framesPerPoint_ == 0) return;
+  while (frames > 0) {
+    const size_t n = std::min<size_t>(frames, framesPerPoint_ - currentFrames_);
+    float lo = current_.min;
+    float hi = current_.max;
+    float sum = 0.0f;
+    if (measured_ == channels_) {
+      // Every channel is measured: one flat pass in four independent lanes,
+      // so the loop is not one long dependency chain.
+      const size_t count = n * channels_;
+      float lanesLo[4] = {lo, lo, lo, lo};
+      float lanesHi[4] = {hi, hi, hi, hi};
+      float lanesSum[4] = {};
+      size_t i = 0;
+      for (; i + 4 <= count; i += 4) {
+        for (size_t k = 0; k < 4; ++k) {
+          const float v = samples[i + k];
+          lanesLo[k] = v < lanesLo[k] ? v : lanesLo[k];
+          lanesHi[k] = v > lanesHi[k] ? v : lanesHi[k];
+          lanesSum[k] += v * v;
+        }
+      }
+      for (; i < count; ++i) {
+        const float v = samples[i];
+        lanesLo[0] = v < lanesLo[0] ? v : lanesLo[0];
+        lanesHi[0] = v > lanesHi[0] ? v : lanesHi[0];
+        lanesSum[0] += v * v;
+      }
+      for (size_t k = 0; k < 4; ++k) {
+        lo = std::min(lo, lanesLo[k]);
+        hi = std::max(hi, lanesHi[k]);
+        sum += lanesSum[k];
+      }
+    } else {
+      for (size_t f = 0; f < n; ++f) {
+        const float* frame = samples + f * channels_;
+        for (uint32_t ch = 0; ch < measured_; ++ch) {
+          const float v = frame[ch];
+          lo = v < lo ? v : lo;
+          hi = v > hi ? v : hi;
+          sum += v * v;
+        }
+      }
+    }
+    current_.min = lo;
+    current_.max = hi;
+    current_.sumSquares += sum;
+    current_.samples += n * measured_;
+    currentFrames_ += static_cast<uint32_t>(n);
+    frames_ += n;
+    samples += n * channels_;
+    frames -= n;
+    if (currentFrames_ == framesPerPoint_) ClosePoint();
+  }
+}
+
+void WaveformBuilder::ClosePoint() {
+  points_.push_back(current_);
+  current_ = Accumulator{std::numeric_limits<float>::infinity(),
+                         -std::numeric_limits<float>::infinity(), 0.0, 0};
+  currentFrames_ = 0;
+}
+
+std::shared_ptr<const Waveform> WaveformBuilder::Finish() {
+  if (currentFrames_ > 0) ClosePoint();
+  if (points_.empty()) return nullptr;
+
+  // Level i merges kLevelFactor points of level i - 1; a partial last
+  // point weighs by its sample count.
+  std::vector<std::vector<Accumulator>> levels;
+  levels.push_back(std::move(points_));
+  points_.clear();
+  while (levels.back().size() > kMinTopPoints && levels.size() < Waveform::kMaxLevels) {
+    const std::vector<Accumulator>& finer = levels.back();
+    std::vector<Accumulator> coarser((finer.size() + kLevelFactor - 1) / kLevelFactor);
+    for (size_t i = 0; i < coarser.size(); ++i) {
+      Accumulator merged = finer[i * kLevelFactor];
+      const size_t end = std::min(finer.size(), (i + 1) * kLevelFactor);
+      for (size_t j = i * kLevelFactor + 1; j < end; ++j) {
+        merged.min = std::min(merged.min, finer[j].min);
+        merged.max = std::max(merged.max, finer[j].max);
+        merged.sumSquares += finer[j].sumSquares;
+        merged.samples += finer[j].samples;
+      }
+      coarser[i] = merged;
+    }
+    levels.push_back(std::move(coarser));
+  }
+
+  std::shared_ptr<Waveform> waveform(new Waveform());
+  waveform->sampleRate_ = sampleRate_;
+  waveform->channels_ = channels_;
+  waveform->frames_ = frames_;
+  size_t total = 0;
+  for (const auto& level : levels) total += level.size();
+  waveform->owned_.reserve(total);
+  uint32_t framesPerPoint = framesPerPoint_;
+  for (const auto& level : levels) {
+    WaveformLevel out;
+    out.framesPerPoint = framesPerPoint;
+    out.points = waveform->owned_.data() + waveform->owned_.size();
+    out.count = level.size();
+    for (const Accumulator& point : level) {
+      WaveformPoint quantized;
+      quantized.min = Quantize(point.min);
+      quantized.max = Quantize(point.max);
+      quantized.rms = Quantize(static_cast<float>(
+          std::sqrt(point.sumSquares / static_cast<double>(point.samples))));
+      waveform->owned_.push_back(quantized);
+    }
+    waveform->levels_.push_back(out);
+    framesPerPoint *= kLevelFactor;
+  }
+  return waveform;
+}
+
+}  // namespace audioengine
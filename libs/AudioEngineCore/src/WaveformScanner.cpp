@@ -0,0 +1,77 @@
+#include "AudioEngineCore/WaveformScanner.h"
+
+#include <utility>
+
+#include "AudioEngineCore/SampleKernels.h"
+
+namespace audioengine {
+
+namespace {
+
+constexpr size_t kChunkFrames = 4096;
+
+}  // namespace
+
+WaveformScanner::WaveformScanner(std::string cacheDir, OpenFn open, unsigned workers)
+    : cacheDir_(std::move(cacheDir)),
+      open_(std::move(open)),
+      pool_([this](const ScanPool::Job& job,
+                   uint64_t generation) { return Generate(job.key, generation); },
+            workers) {}
+
+void WaveformScanner::Enqueue(const std::vector<SeekIndex::Key>& keys) {
+  if (cacheDir_.empty()) return;
+  std::vector<ScanPool::Job> jobs;
+  jobs.reserve(keys.size());
+  for (const SeekIndex::Key& key : keys) jobs.push_back({key, {}});
+  pool_.Enqueue(jobs);
+}
+
+WaveformScanner::Stats WaveformScanner::GetStats() const {
+  const ScanPool::Stats pool = pool_.GetStats();
+  Stats stats;
+  stats.tracksGenerated = pool.tracksDone;
+  stats.tracksCached = pool.tracksCached;
+  stats.tracksFailed = pool.tracksFailed;
+  stats.tracksPending = pool.tracksPending;
+  stats.audioSeconds = pool.audioSeconds;
+  stats.busySeconds = pool.busySeconds;
+  stats.workers = pool.workers;
+  return stats;
+}
+
+ScanPool::Result WaveformScanner::Generate(const SeekIndex::Key& key,
+                                           uint64_t generation) {
+  using Outcome = ScanPool::Outcome;
+  if (Waveform::Map(cacheDir_, key)) return {Outcome::kCached};
+
+  std::unique_ptr<PcmSource> source = open_ ? open_(key.path) : nullptr;
+  if (!source) return {Outcome::kFailed};
+  const PcmFormat format = source->Format();
+  SampleType type;
+  if (format.sampleRate == 0 || format.channels == 0 || !SampleTypeOf(format, &type)) {
+    return {Outcome::kFailed};
+  }
+
+  WaveformBuilder builder;
+  builder.Configure(format.sampleRate, format.channels);
+  std::vector<uint8_t> raw(kChunkFrames * format.BytesPerFrame());
+  std::vector<float> samples(type == SampleType::kF32 ? 0 : kChunkFrames * format.channels);
+  size_t got = 0;
+  while ((got = source->ReadFrames(raw.data(), kChunkFrames)) > 0) {
+    if (pool_.Cancelled(generation)) return {Outcome::kCancelled};
+    // Float decodes (the engines' usual) are measured in place.
+    const float* in = reinterpret_cast<const float*>(raw.data());
+    if (type != SampleType::kF32) {
+      ConvertSamples(type, raw.data(), SampleType::kF32, samples.data(),
+                     got * format.channels);
+      in = samples.data();
+    }
+    builder.Process(in, got);
+  }
+  const std::shared_ptr<const Waveform> waveform = builder.Finish();
+  if (!waveform || !waveform->Save(cacheDir_, key)) return {Outcome::kFailed};
+  return {Outcome::kDone, static_cast<double>(waveform->Frames()) / format.sampleRate};
+}
+
+}  // namespace audioengine
@@ -0,0 +1,137 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "AudioEngineCore/AllocationCounter.h"
+#include "AudioEngineCore/ScratchArena.h"
+#include "AudioEngineCore/StreamingDecoder.h"
+#include "TestSources.h"
+
+namespace audioengine {
+namespace {
+
+using testing::CountingSource;
+
+// Mimics the engine decoders: produces "codec frames" of a fixed size into a
+// scratch arena reserved from the frame-size hint, then copies them out.
+class ArenaSource : public CountingSource {
+ public:
+  ArenaSource(uint32_t sampleRate, uint32_t channels, uint64_t totalFrames,
+              size_t codecFrameSize)
+      : CountingSource(sampleRate, channels, totalFrames),
+        codecFrameSize_(codecFrameSize),
+        bytesPerFrame_(Format().BytesPerFrame()) {
+    staging_.Reserve(codecFrameSize_ * bytesPerFrame_);
+  }
+
+  size_t ReadFrames(uint8_t* dst, size_t maxFrames) override {
+    size_t written = 0;
+    while (written < maxFrames) {
+      if (offset_ == staged_) {
+        uint8_t* frame = staging_.Acquire(codecFrameSize_ * bytesPerFrame_);
+        staged_ = CountingSource::ReadFrames(frame, codecFrameSize_);
+        offset_ = 0;
+        if (staged_ == 0) break;
+      }
+      const size_t n = std::min(maxFrames - written, staged_ - offset_);
+      memcpy(dst + written * bytesPerFrame_,
+             staging_.Data() + offset_ * bytesPerFrame_, n * bytesPerFrame_);
+      offset_ += n;
+      written += n;
+    }
+    return written;
+  }
+
+  const ScratchArena& Staging() const { return staging_; }
+
+ private:
+  size_t codecFrameSize_;
+  size_t bytesPerFrame_;
+  ScratchArena staging_;
+  size_t staged_ = 0;
+  size_t offset_ = 0;
+};
+
+// The pattern the engines used before: a fresh buffer per decoded frame.
+class AllocatingSource : public CountingSource {
+ public:
+  using CountingSource::CountingSource;
+
+  size_t ReadFrames(uint8_t* dst, size_t maxFrames) override {
+    std::vector<uint8_t> frame(maxFrames * Format().BytesPerFrame());
+    const size_t got = CountingSource::ReadFrames(frame.data(), maxFrames);
+    memcpy(dst, frame.data(), got * Format().BytesPerFrame());
+    return got;
+  }
+};
+
+StreamingDecoder::Options SmallRing() {
+  StreamingDecoder::Options options;
+  options.bufferSeconds = 0.05;
+  options.prefillSeconds = 0.01;
+  options.chunkFrames = 512;
+  return options;
+}
+
+// Returns the number of allocations made by the read loop itself.
+uint64_t Drain(StreamingDecoder& decoder, uint32_t channels) {
+  std::vector<int32_t> block(256 * channels);
+  const uint64_t before = debug::ThreadAllocationCount();
+  while (!decoder.IsFinished()) {
+    decoder.Read(reinterpret_cast<uint8_t*>(block.data()), 256);
+  }
+  return debug::ThreadAllocationCount() - before;
+}
+
+TEST(AllocationCounterTest, CountsAllocationsOnCallingThread) {
+  if (!debug::AllocationCountingEnabled()) GTEST_SKIP();
+  const uint64_t before = debug::ThreadAllocationCount();
+  auto value = std::make_unique<int>(42);
+  EXPECT_EQ(debug::ThreadAllocationCount(), before + 1);
+}
+
+TEST(ScratchArenaTest, ReservedSizeClassServesRequestsWithoutGrowing) {
+  ScratchArena arena;
+  arena.Reserve(4608 * 8);  // e.g. 4608-sample frames, stereo s32
+  EXPECT_EQ(arena.Capacity(), ScratchArena::SizeClass(4608 * 8));
+  EXPECT_EQ(arena.Capacity(), 65536u);
+
+  const uint64_t before = debug::ThreadAllocationCount();
+  uint8_t* first = arena.Acquire(1024);
+  uint8_t* second = arena.Acquire(arena.Capacity());
+  EXPECT_EQ(first, second);
+  EXPECT_EQ(debug::ThreadAllocationCount(), before);
+  EXPECT_EQ(arena.Growths(), 0u);
+
+  arena.Acquire(arena.Capacity() + 1);
+  EXPECT_EQ(arena.Capacity(), 131072u);
+  EXPECT_EQ(arena.Growths(), 1u);
+}
+
+TEST(StreamingDecoderAllocationTest, SteadyStateDecodeDoesNotAllocate) {
+  if (!debug::AllocationCountingEnabled()) GTEST_SKIP();
+  StreamingDecoder decoder(SmallRing());
+  auto source = std::make_unique<ArenaSource>(48000, 2, 48000 * 2, 4608);
+  const ArenaSource* raw = source.get();
+  ASSERT_TRUE(decoder.Start(std::move(source)));
+
+  // The render side must not allocate either.
+  EXPECT_EQ(Drain(decoder, 2), 0u);
+
+  EXPECT_EQ(decoder.SteadyStateAllocations(), 0u);
+  EXPECT_EQ(raw->Staging().Growths(), 0u);
+}
+
+TEST(StreamingDecoderAllocationTest, ReportsPerFrameAllocations) {
+  if (!debug::AllocationCountingEnabled()) GTEST_SKIP();
+  StreamingDecoder decoder(SmallRing());
+  ASSERT_TRUE(decoder.Start(std::make_unique<AllocatingSource>(48000, 2, 48000)));
+  Drain(decoder, 2);
+  EXPECT_GT(decoder.SteadyStateAllocations(), 0u);
+}
+
+}  // namespace
+}  // namespace audioengine
@@ -0,0 +1,192 @@
+#include "AudioEngineCore/ChannelMixer.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "AudioEngineCore/AllocationCounter.h"
+#include "AudioEngineCore/SampleKernels.h"
+#include "TestSources.h"
+
+namespace audioengine {
+namespace {
+
+using testing::MemorySource;
+using testing::Noise;
+
+constexpr float kMinus3Db = 0.70710678f;
+
+std::vector<float> Mix(const ChannelMatrix& matrix, const std::vector<float>& input) {
+  ChannelMixer mixer;
+  EXPECT_TRUE(mixer.Configure(matrix));
+  const size_t frames = input.size() / matrix.Inputs();
+  std::vector<float> output(frames * matrix.Outputs());
+  mixer.Process(input.data(), output.data(), frames);
+  return output;
+}
+
+TEST(ChannelMixerTest, NamesAndResolvesLayouts) {
+  EXPECT_EQ(LayoutChannels(kLayout7Point1), 8u);
+  for (uint32_t channels = 1; channels <= 8; ++channels) {
+    EXPECT_EQ(LayoutChannels(DefaultLayout(channels)), channels);
+  }
+  EXPECT_EQ(DefaultLayout(9), 0u);
+  EXPECT_EQ(ResolveLayout(kLayout5Point1Side, 6), kLayout5Point1Side);
+  // No mask, or one for a different channel count.
+  EXPECT_EQ(ResolveLayout(0, 6), kLayout5Point1);
+  EXPECT_EQ(ResolveLayout(kLayoutStereo, 1), kLayoutMono);
+  EXPECT_EQ(LayoutName(kLayout5Point1), "5.1");
+  EXPECT_EQ(LayoutName(DefaultLayout(7)), "6.1");
+  EXPECT_EQ(LayoutName(kLayoutStereo | speaker::kTopCenter), "3-ch");
+}
+
+TEST(ChannelMixerTest, FoldsFiveOneToStereoWithItuCoefficients) {
+  DownmixOptions options;
+  options.normalize = false;
+  const ChannelMatrix matrix = ChannelMatrix::Downmix(kLayout5Point1, kLayoutStereo, options);
+  ASSERT_EQ(matrix.Inputs(), 6u);
+  ASSERT_EQ(matrix.Outputs(), 2u);
+  // FL FR FC LFE BL BR.
+  const float left[] = {1.0f, 0.0f, kMinus3Db, 0.0f, kMinus3Db, 0.0f};
+  const float right[] = {0.0f, 1.0f, kMinus3Db, 0.0f, 0.0f, kMinus3Db};
+  for (uint32_t i = 0; i < 6; ++i) {
+    EXPECT_NEAR(matrix.At(0, i), left[i], 1e-5f) << i;
+    EXPECT_NEAR(matrix.At(1, i), right[i], 1e-5f) << i;
+  }
+
+  // Normalized, no output can pass full scale.
+  const ChannelMatrix safe = ChannelMatrix::Downmix(kLayout5Point1, kLayoutStereo);
+  const float sum = 1.0f + 2.0f * kMinus3Db;
+  EXPECT_NEAR(safe.At(0, 0), 1.0f / sum, 1e-5f);
+  EXPECT_NEAR(safe.At(0, 2), kMinus3Db / sum, 1e-5f);
+  const std::vector<float> fullScale(6 * 16, 1.0f);
+  for (const float s : Mix(safe, fullScale)) EXPECT_LE(s, 1.0f + 1e-6f);
+
+  // Side surrounds fold the same way.
+  const ChannelMatrix side = ChannelMatrix::Downmix(kLayout5Point1Side, kLayoutStereo, options);
+  EXPECT_NEAR(side.At(0, 4), kMinus3Db, 1e-5f);
+  EXPECT_NEAR(side.At(1, 5), kMinus3Db, 1e-5f);
+}
+
+TEST(ChannelMixerTest, HandlesLfeAndCustomLevels) {
+  DownmixOptions options;
+  options.normalize = false;
+  options.lfe = LfeMode::kMix;
+  options.lfeDb = -6.0;
+  options.surroundDb = -6.0;
+  const ChannelMatrix matrix = ChannelMatrix::Downmix(kLayout5Point1, kLayoutStereo, options);
+  const float half = std::pow(10.0f, -6.0f / 20.0f);
+  EXPECT_NEAR(matrix.At(0, 3), half, 1e-5f);
+  EXPECT_NEAR(matrix.At(1, 3), half, 1e-5f);
+  EXPECT_NEAR(matrix.At(0, 4), half, 1e-5f);
+
+  // An output with its own LFE channel keeps it whatever the mode.
+  const ChannelMatrix toFiveOne = ChannelMatrix::Downmix(kLayout7Point1, kLayout5Point1);
+  ASSERT_EQ(toFiveOne.Outputs(), 6u);
+  EXPECT_GT(toFiveOne.At(3, 3), 0.0f);
+  // Sides join the backs; nothing reaches the front.
+  EXPECT_GT(toFiveOne.At(4, 6), 0.0f);
+  EXPECT_EQ(toFiveOne.At(0, 6), 0.0f);
+  EXPECT_NEAR(toFiveOne.At(4, 6) / toFiveOne.At(4, 4), kMinus3Db, 1e-5f);
+}
+
+TEST(ChannelMixerTest, MixesMonoAndUpmixes) {
+  DownmixOptions options;
+  options.normalize = false;
+  const ChannelMatrix toMono = ChannelMatrix::Downmix(kLayoutStereo, kLayoutMono, options);
+  ASSERT_EQ(toMono.Outputs(), 1u);
+  EXPECT_NEAR(toMono.At(0, 0), kMinus3Db, 1e-5f);
+  EXPECT_NEAR(toMono.At(0, 1), kMinus3Db, 1e-5f);
+
+  // Mono spreads over the front pair at equal power; stereo into 5.1 keeps
+  // to the front pair.
+  const ChannelMatrix fromMono = ChannelMatrix::Downmix(kLayoutMono, kLayoutStereo);
+  EXPECT_NEAR(fromMono.At(0, 0), kMinus3Db, 1e-5f);
+  EXPECT_NEAR(fromMono.At(1, 0), kMinus3Db, 1e-5f);
+  const ChannelMatrix up = ChannelMatrix::Downmix(kLayoutStereo, kLayout5Point1);
+  ASSERT_EQ(up.Outputs(), 6u);
+  for (uint32_t o = 0; o < 6; ++o) {
+    EXPECT_EQ(up.At(o, 0), o == 0 ? 1.0f : 0.0f);
+    EXPECT_EQ(up.At(o, 1), o == 1 ? 1.0f : 0.0f);
+  }
+
+  EXPECT_TRUE(ChannelMatrix::Downmix(kLayout5Point1, kLayout5Point1).IsIdentity());
+  EXPECT_FALSE(up.IsIdentity());
+  // Nowhere to put the front.
+  EXPECT_TRUE(ChannelMatrix::Downmix(kLayout5Point1, kLayoutQuad & ~kLayoutStereo).Empty());
+  EXPECT_TRUE(ChannelMatrix(2, 2, {1.0f, 0.0f, 0.0f}).Empty());
+  EXPECT_TRUE(ChannelMatrix(9, 2, std::vector<float>(18, 0.0f)).Empty());
+}
+
+TEST(ChannelMixerTest, EveryIsaMatchesScalar) {
+  const KernelIsa saved = ActiveKernelIsa();
+  for (uint32_t inputs = 1; inputs <= 8; ++inputs) {
+    for (uint32_t outputs = 1; outputs <= 8; ++outputs) {
+      const std::vector<float> coefficients =
+          Noise(inputs * outputs, inputs * 10 + outputs, 1.0f);
+      const ChannelMatrix matrix(inputs, outputs, coefficients);
+      // Odd, so the packed kernels finish on a scalar tail.
+      const std::vector<float> input = Noise(inputs * 1027, outputs, 1.0f);
+      ASSERT_TRUE(SetKernelIsa(KernelIsa::kScalar));
+      const std::vector<float> reference = Mix(matrix, input);
+      for (size_t f = 0; f < 1027; f += 211) {
+        for (uint32_t o = 0; o < outputs; ++o) {
+          double want = 0.0;
+          for (uint32_t i = 0; i < inputs; ++i) {
+            want += double{coefficients[o * inputs + i]} * input[f * inputs + i];
+          }
+          ASSERT_NEAR(reference[f * outputs + o], want, 1e-5);
+        }
+      }
+      for (const KernelIsa isa : {KernelIsa::kSse2, KernelIsa::kAvx2, KernelIsa::kNeon}) {
+        if (!SetKernelIsa(isa)) continue;
+        const std::vector<float> vector = Mix(matrix, input);
+        for (size_t i = 0; i < vector.size(); ++i) {
+          ASSERT_EQ(vector[i], reference[i])
+              << KernelIsaName(isa) << " " << inputs << "->" << outputs << " " << i;
+        }
+      }
+    }
+  }
+  SetKernelIsa(saved);
+}
+
+TEST(ChannelMixerTest, SourceMixesDownAndSeeks) {
+  const PcmFormat format{48000, 6, 32, true};
+  const ChannelMatrix matrix = ChannelMatrix::Downmix(kLayout5Point1, kLayoutStereo);
+  ASSERT_TRUE(ChannelMixingSource::CanMix(format, matrix));
+  EXPECT_FALSE(ChannelMixingSource::CanMix({48000, 8, 32, true}, matrix));
+  EXPECT_FALSE(ChannelMixingSource::CanMix({48000, 6, 16, false}, matrix));
+
+  const std::vector<float> input = Noise(5001 * 6, 3, 1.0f);
+  const std::vector<float> want = Mix(matrix, input);
+  ChannelMixingSource source(std::make_unique<MemorySource>(input, format), matrix);
+  EXPECT_EQ(source.Format().channels, 2u);
+  EXPECT_EQ(source.Format().sampleRate, 48000u);
+  EXPECT_EQ(source.TotalFrames(), 5001u);
+
+  std::vector<float> got(5001 * 2);
+  size_t frames = 0;
+  const uint64_t before = debug::ThreadAllocationCount();
+  while (const size_t n = source.ReadFrames(
+             reinterpret_cast<uint8_t*>(got.data() + frames * 2), 1500)) {
+    frames += n;
+  }
+  EXPECT_EQ(debug::ThreadAllocationCount(), before);
+  ASSERT_EQ(frames, 5001u);
+  EXPECT_EQ(got, want);
+
+  uint64_t landed = 0;
+  ASSERT_TRUE(source.SeekToFrame(4000, SeekMode::kAccurate, &landed));
+  EXPECT_EQ(landed, 4000u);
+  std::vector<float> rest(1001 * 2);
+  ASSERT_EQ(source.ReadFrames(reinterpret_cast<uint8_t*>(rest.data()), 1001), 1001u);
+  EXPECT_TRUE(std::equal(rest.begin(), rest.end(), want.begin() + 4000 * 2));
+}
+
+}  // namespace
+}  // namespace audioengine
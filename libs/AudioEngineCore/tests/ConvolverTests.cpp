@@ -0,0 +1,209 @@
+#include "AudioEngineCore/Convolver.h"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <memory>
+#include <vector>
+
+#include "AudioEngineCore/AllocationCounter.h"
+#include "AudioEngineCore/SampleKernels.h"
+#include "TestSources.h"
+
+namespace audioengine {
+namespace {
+
+using testing::MemorySource;
+using testing::Noise;
+
+// Time-domain reference: `input` interleaved, one response per channel (or
+// one for all).
+std::vector<float> DirectConvolve(const std::vector<float>& input, uint32_t channels,
+                                  const FirFilter& filter) {
+  const size_t frames = input.size() / channels;
+  std::vector<float> output(input.size(), 0.0f);
+  for (uint32_t ch = 0; ch < channels; ++ch) {
+    const std::vector<float>& h = filter.channels[filter.channels.size() == 1 ? 0 : ch];
+    for (size_t n = 0; n < frames; ++n) {
+      double acc = 0.0;
+      const size_t taps = std::min(h.size(), n + 1);
+      for (size_t k = 0; k < taps; ++k) acc += h[k] * input[(n - k) * channels + ch];
+      output[n * channels + ch] = static_cast<float>(acc);
+    }
+  }
+  return output;
+}
+
+std::vector<float> RunConvolver(PartitionedConvolver& convolver,
+                                const std::vector<float>& input, uint32_t channels) {
+  const size_t block = convolver.BlockFrames() * channels;
+  std::vector<float> output(input.size());
+  for (size_t at = 0; at + block <= input.size(); at += block) {
+    convolver.Process(input.data() + at, output.data() + at);
+  }
+  return output;
+}
+
+TEST(ConvolverTest, ShortFilterRunsHeadOnly) {
+  auto fir = std::make_shared<FirFilter>();
+  fir->sampleRate = 48000;
+  fir->channels = {Noise(300, 1, 0.1f), Noise(177, 2, 0.1f)};
+  const auto filter = ConvolutionFilter::Create(fir, 48000, 64);
+  ASSERT_TRUE(filter);
+  EXPECT_EQ(filter->TailPartitionFrames(), 0u);
+  EXPECT_EQ(filter->HeadPartitions(), 5u);
+
+  PartitionedConvolver convolver;
+  ASSERT_TRUE(convolver.Configure(filter, 2));
+  const std::vector<float> input = Noise(64 * 40 * 2, 3, 1.0f);
+  const std::vector<float> want = DirectConvolve(input, 2, *fir);
+  const std::vector<float> got = RunConvolver(convolver, input, 2);
+  for (size_t i = 0; i < got.size(); ++i) ASSERT_NEAR(got[i], want[i], 2e-5f) << i;
+}
+
+TEST(ConvolverTest, LongFilterSplitsTailToWorker) {
+  auto fir = std::make_shared<FirFilter>();
+  fir->sampleRate = 44100;
+  std::vector<float> taps = Noise(9000, 4, 0.02f);
+  // Decaying, like a room response.
+  for (size_t i = 0; i < taps.size(); ++i) taps[i] *= std::exp(-3.0f * i / taps.size());
+  fir->channels = {taps};
+  const auto filter = ConvolutionFilter::Create(fir, 44100, 64);
+  ASSERT_TRUE(filter);
+  ASSERT_GT(filter->TailPartitions(), 0u);
+  EXPECT_GE(filter->HeadPartitions() * 64u, 2 * filter->TailPartitionFrames());
+  EXPECT_GE(filter->HeadPartitions() * 64u +
+                filter->TailPartitions() * filter->TailPartitionFrames(),
+            9000u);
+
+  PartitionedConvolver convolver;
+  ASSERT_TRUE(convolver.Configure(filter, 2));
+  const std::vector<float> input = Noise(64 * 400 * 2, 5, 1.0f);
+  const std::vector<float> want = DirectConvolve(input, 2, *fir);
+
+  const uint64_t before = debug::ThreadAllocationCount();
+  const std::vector<float> got = RunConvolver(convolver, input, 2);
+  EXPECT_EQ(debug::ThreadAllocationCount(), before + 1);  // `got` itself
+  for (size_t i = 0; i < got.size(); ++i) ASSERT_NEAR(got[i], want[i], 1e-4f) << i;
+
+  const PartitionedConvolver::Stats stats = convolver.GetStats();
+  EXPECT_EQ(stats.framesProcessed, 64u * 400);
+  EXPECT_GT(stats.tailNanos, 0u);
+  EXPECT_GT(stats.HeadLoad(44100), 0.0);
+
+  // After a reset the history is silent again.
+  convolver.Reset();
+  const std::vector<float> again = RunConvolver(convolver, input, 2);
+  for (size_t i = 0; i < got.size(); ++i) ASSERT_EQ(again[i], got[i]) << i;
+}
+
+TEST(ConvolverTest, EveryIsaMatchesScalar) {
+  const KernelIsa saved = ActiveKernelIsa();
+  auto fir = std::make_shared<FirFilter>();
+  fir->sampleRate = 48000;
+  fir->channels = {Noise(3000, 6, 0.05f)};
+  const auto filter = ConvolutionFilter::Create(fir, 48000, 128);
+  const std::vector<float> input = Noise(128 * 60, 7, 1.0f);
+  const auto run = [&] {
+    PartitionedConvolver convolver;
+    convolver.Configure(filter, 1);
+    return RunConvolver(convolver, input, 1);
+  };
+  ASSERT_TRUE(SetKernelIsa(KernelIsa::kScalar));
+  const std::vector<float> reference = run();
+  for (const KernelIsa isa : {KernelIsa::kSse2, KernelIsa::kAvx2, KernelIsa::kNeon}) {
+    if (!SetKernelIsa(isa)) continue;
+    const std::vector<float> vector = run();
+    for (size_t i = 0; i < vector.size(); ++i) {
+      ASSERT_NEAR(vector[i], reference[i], 1e-5f) << KernelIsaName(isa) << " " << i;
+    }
+  }
+  SetKernelIsa(saved);
+}
+
+TEST(ConvolverTest, SourceKeepsLengthAndSeeksExactly) {
+  auto fir = std::make_shared<FirFilter>();
+  fir->sampleRate = 48000;
+  fir->channels = {Noise(1500, 8, 0.05f)};
+  const auto filter = ConvolutionFilter::Create(fir, 48000, 64);
+  const PcmFormat format{48000, 2, 32, true};
+  ASSERT_TRUE(ConvolvingSource::CanConvolve(format, *filter));
+  EXPECT_FALSE(ConvolvingSource::CanConvolve({44100, 2, 32, true}, *filter));
+  EXPECT_FALSE(ConvolvingSource::CanConvolve({48000, 2, 16, false}, *filter));
+
+  // Not a multiple of the block size.
+  const std::vector<float> input = Noise(10001 * 2, 9, 1.0f);
+  ConvolvingSource source(std::make_unique<MemorySource>(input, format), filter);
+  EXPECT_EQ(source.TotalFrames(), 10001u);
+  std::vector<float> got(input.size());
+  size_t frames = 0;
+  while (const size_t n = source.ReadFrames(
+             reinterpret_cast<uint8_t*>(got.data() + frames * 2), 333)) {
+    frames += n;
+  }
+  ASSERT_EQ(frames, 10001u);
+  const std::vector<float> want = DirectConvolve(input, 2, *fir);
+  for (size_t i = 0; i < got.size(); ++i) ASSERT_NEAR(got[i], want[i], 2e-5f) << i;
+
+  // A seek restarts from silent history at the exact frame.
+  uint64_t landed = 0;
+  ASSERT_TRUE(source.SeekToFrame(4000, SeekMode::kAccurate, &landed));
+  EXPECT_EQ(landed, 4000u);
+  const std::vector<float> rest(input.begin() + 4000 * 2, input.end());
+  const std::vector<float> restWant = DirectConvolve(rest, 2, *fir);
+  std::vector<float> restGot(rest.size());
+  ASSERT_EQ(source.ReadFrames(reinterpret_cast<uint8_t*>(restGot.data()), 6001), 6001u);
+  for (size_t i = 0; i < restGot.size(); ++i) {
+    ASSERT_NEAR(restGot[i], restWant[i], 2e-5f) << i;
+  }
+}
+
+TEST(ConvolverTest, ReadsFiltersFromSources) {
+  const std::vector<float> samples = {1.0f, 0.5f, 0.25f, -0.5f, 0.0f, 0.125f};
+  MemorySource source(samples, {96000, 2, 32, true});
+  FirFilter fir;
+  ASSERT_TRUE(ReadFirFilter(source, &fir));
+  EXPECT_EQ(fir.sampleRate, 96000u);
+  ASSERT_EQ(fir.channels.size(), 2u);
+  EXPECT_EQ(fir.channels[0], (std::vector<float>{1.0f, 0.25f, 0.0f}));
+  EXPECT_EQ(fir.channels[1], (std::vector<float>{0.5f, -0.5f, 0.125f}));
+
+  MemorySource empty({}, {48000, 1, 32, true});
+  EXPECT_FALSE(ReadFirFilter(empty, &fir));
+}
+
+TEST(ConvolverTest, ResamplesFiltersToTheStreamRate) {
+  auto fir = std::make_shared<FirFilter>();
+  fir->sampleRate = 44100;
+  std::vector<float> impulse(512, 0.0f);
+  impulse[100] = 1.0f;
+  fir->channels = {impulse, impulse};
+
+  const FirFilter resampled = ResampleFir(*fir, 96000);
+  EXPECT_EQ(resampled.sampleRate, 96000u);
+  ASSERT_EQ(resampled.channels.size(), 2u);
+  EXPECT_EQ(resampled.Taps(), (512u * 96000 + 44099) / 44100);
+  // Same DC gain, same delay in seconds.
+  double sum = 0.0;
+  size_t peak = 0;
+  for (size_t i = 0; i < resampled.channels[0].size(); ++i) {
+    sum += resampled.channels[0][i];
+    if (std::fabs(resampled.channels[0][i]) > std::fabs(resampled.channels[0][peak])) {
+      peak = i;
+    }
+  }
+  EXPECT_NEAR(sum, 1.0, 1e-3);
+  EXPECT_NEAR(static_cast<double>(peak), 100.0 * 96000 / 44100, 1.0);
+
+  const auto filter = ConvolutionFilter::Create(fir, 96000);
+  ASSERT_TRUE(filter);
+  EXPECT_EQ(filter->SampleRate(), 96000u);
+  EXPECT_EQ(filter->Fir(), fir);
+  EXPECT_TRUE(filter->Supports(2));
+  EXPECT_FALSE(filter->Supports(6));
+  EXPECT_FALSE(ConvolutionFilter::Create(std::make_shared<FirFilter>(), 48000));
+  EXPECT_FALSE(ConvolutionFilter::Create(fir, 48000, 100));
+}
+
+}  // namespace
+}  // namespace audioengine
@@ -0,0 +1,291 @@
+#include "AudioEngineCore/Crossfade.h"
+#include "AudioEngineCore/Crossfader.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "AudioEngineCore/AllocationCounter.h"
+#include "TestSources.h"
+
+namespace audioengine {
+namespace {
+
+using testing::ConstantSource;
+using testing::CountingSource;
+
+constexpr uint32_t kRate = 44100;
+constexpr uint32_t kChannels = 2;
+constexpr float kFirstLevel = 0.5f;
+constexpr float kSecondLevel = 0.25f;
+
+PcmFormat FloatStereo() {
+  PcmFormat format;
+  format.sampleRate = kRate;
+  format.channels = kChannels;
+  format.bitsPerSample = 32;
+  format.isFloat = true;
+  return format;
+}
+
+StreamingDecoder::Options DeckOptions() {
+  StreamingDecoder::Options options;
+  options.bufferSeconds = 0.5;
+  options.prefillSeconds = 0.05;
+  options.chunkFrames = 1024;
+  return options;
+}
+
+// Drains like a render callback, paced so the decks' producers keep up.
+// `renderAllocations` (if set) counts heap allocations made inside Read().
+std::vector<float> Drain(Crossfader& fader, uint64_t* renderAllocations = nullptr) {
+  std::vector<float> samples;
+  std::vector<float> block(480 * kChannels);
+  const auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::seconds(30);
+  while (!fader.IsFinished()) {
+    const uint64_t before = debug::ThreadAllocationCount();
+    const size_t got = fader.Read(reinterpret_cast<uint8_t*>(block.data()), 480);
+    if (renderAllocations) *renderAllocations += debug::ThreadAllocationCount() - before;
+    samples.insert(samples.end(), block.begin(), block.begin() + got * kChannels);
+    std::this_thread::sleep_for(std::chrono::microseconds(200));
+    if (std::chrono::steady_clock::now() > deadline) {
+      ADD_FAILURE() << "crossfader did not finish";
+      break;
+    }
+  }
+  return samples;
+}
+
+// Checks a drained fade of track one into track two: `plain` frames of the
+// first level, `fade` mixed frames, then the second level to the end.
+void ExpectFade(const std::vector<float>& samples, uint64_t plain, uint64_t fade,
+                uint64_t after, float firstLevel = kFirstLevel,
+                float secondLevel = kSecondLevel) {
+  ASSERT_EQ(samples.size(), (plain + fade + after) * kChannels);
+  std::vector<float> outGain(fade), inGain(fade);
+  EqualPowerGains(0, fade, fade, outGain.data(), inGain.data());
+  for (uint64_t frame = 0; frame < plain + fade + after; ++frame) {
+    float expected = secondLevel;
+    if (frame < plain) {
+      expected = firstLevel;
+    } else if (frame < plain + fade) {
+      const uint64_t i = frame - plain;
+      expected = firstLevel * outGain[i] + secondLevel * inGain[i];
+    }
+    for (uint32_t ch = 0; ch < kChannels; ++ch) {
+      const float got = samples[frame * kChannels + ch];
+      if (std::fabs(got - expected) > 1e-5f) {
+        FAIL() << "frame " << frame << ": got " << got << ", expected " << expected;
+      }
+    }
+  }
+}
+
+TEST(CrossfadeTest, EqualPowerGainsKeepConstantPower) {
+  constexpr uint64_t kLength = 4410;
+  std::vector<float> out(kLength + 10), in(kLength + 10);
+  EqualPowerGains(0, kLength, out.size(), out.data(), in.data());
+  for (uint64_t i = 0; i < kLength; ++i) {
+    EXPECT_NEAR(out[i] * out[i] + in[i] * in[i], 1.0f, 1e-5f) << i;
+    if (i > 0) {
+      EXPECT_LT(out[i], out[i - 1]);
+      EXPECT_GT(in[i], in[i - 1]);
+    }
+  }
+  EXPECT_NEAR(in[kLength / 2], std::sqrt(0.5f), 1e-3f);
+  // Past the end the fade holds at fully faded in.
+  for (size_t i = kLength; i < out.size(); ++i) {
+    EXPECT_EQ(out[i], 0.0f);
+    EXPECT_EQ(in[i], 1.0f);
+  }
+
+  // Computing the curve in render-sized pieces gives the same curve.
+  std::vector<float> pieceOut(kLength), pieceIn(kLength);
+  for (uint64_t at = 0; at < kLength; at += 441) {
+    EqualPowerGains(at, kLength, 441, pieceOut.data() + at, pieceIn.data() + at);
+  }
+  for (uint64_t i = 0; i < kLength; ++i) {
+    EXPECT_NEAR(pieceOut[i], out[i], 1e-6f);
+    EXPECT_NEAR(pieceIn[i], in[i], 1e-6f);
+  }
+}
+
+TEST(CrossfadeTest, VectorMixMatchesScalar) {
+  for (uint32_t channels : {1u, 2u, 6u}) {
+    PcmFormat format = FloatStereo();
+    format.channels = channels;
+    constexpr size_t kFrames = 1023;  // leaves a tail for the scalar loop
+    std::vector<float> a(kFrames * channels), b(kFrames * channels);
+    for (size_t i = 0; i < a.size(); ++i) {
+      a[i] = std::sin(0.01f * static_cast<float>(i));
+      b[i] = std::cos(0.013f * static_cast<float>(i));
+    }
+    std::vector<float> out(kFrames), in(kFrames);
+    EqualPowerGains(100, 2000, kFrames, out.data(), in.data());
+
+    std::vector<float> vector = a, scalar = a;
+    ASSERT_TRUE(MixCrossfade(format, reinterpret_cast<uint8_t*>(vector.data()),
+                             reinterpret_cast<const uint8_t*>(b.data()),
+                             out.data(), in.data(), kFrames));
+    ASSERT_TRUE(MixCrossfadeScalar(format, reinterpret_cast<uint8_t*>(scalar.data()),
+                                   reinterpret_cast<const uint8_t*>(b.data()),
+                                   out.data(), in.data(), kFrames));
+    for (size_t i = 0; i < vector.size(); ++i) {
+      ASSERT_NEAR(vector[i], scalar[i], 1e-6f) << "channels " << channels << " sample " << i;
+    }
+  }
+}
+
+TEST(CrossfadeTest, IntegerMixSaturates) {
+  PcmFormat format = FloatStereo();
+  format.isFloat = false;
+  format.bitsPerSample = 16;
+  std::vector<int16_t> dst = {30000, -30000, 100, -100};
+  const std::vector<int16_t> incoming = {30000, -30000, 100, -100};
+  const float gain = std::sqrt(0.5f);
+  const float out[] = {gain, gain};
+  const float in[] = {gain, gain};
+  ASSERT_TRUE(MixCrossfade(format, reinterpret_cast<uint8_t*>(dst.data()),
+                           reinterpret_cast<const uint8_t*>(incoming.data()), out,
+                           in, 2));
+  EXPECT_EQ(dst[0], 32767);
+  EXPECT_EQ(dst[1], -32768);
+  EXPECT_EQ(dst[2], 141);
+  EXPECT_EQ(dst[3], -141);
+
+  format.bitsPerSample = 24;
+  EXPECT_FALSE(CanCrossfade(format));
+  EXPECT_FALSE(MixCrossfade(format, reinterpret_cast<uint8_t*>(dst.data()),
+                            reinterpret_cast<const uint8_t*>(incoming.data()), out,
+                            in, 1));
+}
+
+TEST(CrossfaderTest, FadesIntoNextTrackOverTheTail) {
+  Crossfader fader(DeckOptions());
+  fader.SetOverlapMs(200);
+  constexpr uint64_t kFirst = kRate * 2 + 123;
+  constexpr uint64_t kSecond = kRate + 77;
+  constexpr uint64_t kFade = kRate / 5;
+  ASSERT_TRUE(fader.Start(
+      std::make_unique<ConstantSource>(kRate, kChannels, kFirst, kFirstLevel)));
+  ASSERT_TRUE(fader.QueueNext(
+      std::make_unique<ConstantSource>(kRate, kChannels, kSecond, kSecondLevel)));
+  EXPECT_TRUE(fader.HasQueuedNext());
+  EXPECT_FALSE(fader.TakeTrackChange());
+
+  uint64_t renderAllocations = 0;
+  const std::vector<float> samples = Drain(fader, &renderAllocations);
+  ExpectFade(samples, kFirst - kFade, kFade, kSecond - kFade);
+  EXPECT_EQ(renderAllocations, 0u);
+
+  // Reported once; position and length follow the incoming track.
+  EXPECT_TRUE(fader.TakeTrackChange());
+  EXPECT_FALSE(fader.TakeTrackChange());
+  EXPECT_EQ(fader.TotalFrames(), kSecond);
+  EXPECT_EQ(fader.PositionFrames(), kSecond);
+  EXPECT_FALSE(fader.IsFading());
+}
+
+TEST(CrossfaderTest, SeekReschedulesQueuedFade) {
+  Crossfader fader(DeckOptions());
+  fader.SetOverlapMs(100);
+  constexpr uint64_t kFirst = kRate * 10;
+  constexpr uint64_t kSecond = kRate;
+  constexpr uint64_t kFade = kRate / 10;
+  ASSERT_TRUE(fader.Start(
+      std::make_unique<ConstantSource>(kRate, kChannels, kFirst, kFirstLevel)));
+  ASSERT_TRUE(fader.QueueNext(
+      std::make_unique<ConstantSource>(kRate, kChannels, kSecond, kSecondLevel)));
+  constexpr uint64_t kTarget = kFirst - kRate / 2;
+  ASSERT_TRUE(fader.Seek(kTarget));
+  EXPECT_EQ(fader.PositionFrames(), kTarget);
+
+  const std::vector<float> samples = Drain(fader);
+  ExpectFade(samples, kFirst - kTarget - kFade, kFade, kSecond - kFade);
+}
+
+TEST(CrossfaderTest, ChainsGaplesslyWithoutOverlap) {
+  Crossfader fader(DeckOptions());
+  constexpr uint64_t kFirst = kRate / 2 + 3;
+  constexpr uint64_t kSecond = kRate / 3;
+  ASSERT_TRUE(fader.Start(
+      std::make_unique<ConstantSource>(kRate, kChannels, kFirst, kFirstLevel)));
+  ASSERT_TRUE(fader.QueueNext(
+      std::make_unique<ConstantSource>(kRate, kChannels, kSecond, kSecondLevel)));
+  const std::vector<float> samples = Drain(fader);
+  ExpectFade(samples, kFirst, 0, kSecond);
+  EXPECT_TRUE(fader.TakeTrackChange());
+}
+
+TEST(CrossfaderTest, AppliesTrackAndOutputGains) {
+  constexpr float kVolume = 0.5f;
+  constexpr float kFirstGain = 1.5f;
+  constexpr float kSecondGain = 0.75f;
+  constexpr uint64_t kFirst = kRate / 2 + 3;
+  constexpr uint64_t kSecond = kRate / 3;
+
+  // Gapless: the gain switches on the first frame of the chained track.
+  {
+    Crossfader fader(DeckOptions());
+    fader.SetOutputGain(kVolume);
+    ASSERT_TRUE(fader.Start(
+        std::make_unique<ConstantSource>(kRate, kChannels, kFirst, kFirstLevel),
+        kFirstGain));
+    ASSERT_TRUE(fader.QueueNext(
+        std::make_unique<ConstantSource>(kRate, kChannels, kSecond, kSecondLevel),
+        kSecondGain));
+    const std::vector<float> samples = Drain(fader);
+    ExpectFade(samples, kFirst, 0, kSecond, kFirstLevel * kFirstGain * kVolume,
+               kSecondLevel * kSecondGain * kVolume);
+    EXPECT_TRUE(fader.TakeTrackChange());
+  }
+
+  // Crossfade: each side keeps its own gain under the curves.
+  {
+    Crossfader fader(DeckOptions());
+    fader.SetOverlapMs(100);
+    fader.SetOutputGain(kVolume);
+    constexpr uint64_t kFade = kRate / 10;
+    ASSERT_TRUE(fader.Start(
+        std::make_unique<ConstantSource>(kRate, kChannels, kFirst, kFirstLevel),
+        kFirstGain));
+    ASSERT_TRUE(fader.QueueNext(
+        std::make_unique<ConstantSource>(kRate, kChannels, kSecond, kSecondLevel),
+        kSecondGain));
+    const std::vector<float> samples = Drain(fader);
+    ExpectFade(samples, kFirst - kFade, kFade, kSecond - kFade,
+               kFirstLevel * kFirstGain * kVolume,
+               kSecondLevel * kSecondGain * kVolume);
+  }
+}
+
+TEST(CrossfaderTest, RejectsMismatchedNextTrack) {
+  Crossfader fader(DeckOptions());
+  fader.SetOverlapMs(100);
+  ASSERT_TRUE(fader.Start(
+      std::make_unique<ConstantSource>(kRate, kChannels, kRate, kFirstLevel)));
+  EXPECT_FALSE(fader.QueueNext(std::make_unique<ConstantSource>(
+      48000, kChannels, kRate, kSecondLevel)));
+  EXPECT_FALSE(fader.QueueNext(
+      std::make_unique<CountingSource>(kRate, kChannels, kRate)));
+  EXPECT_FALSE(fader.HasQueuedNext());
+
+  // A queued fade can be withdrawn until it starts.
+  ASSERT_TRUE(fader.QueueNext(
+      std::make_unique<ConstantSource>(kRate, kChannels, kRate, kSecondLevel)));
+  EXPECT_TRUE(fader.QueueNext(nullptr));
+  EXPECT_FALSE(fader.HasQueuedNext());
+  const std::vector<float> samples = Drain(fader);
+  ExpectFade(samples, kRate, 0, 0);
+  EXPECT_FALSE(fader.TakeTrackChange());
+}
+
+}  // namespace
+}  // namespace audioengine
@@ -0,0 +1,151 @@
+#include "AudioEngineCore/Crossfeed.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "AudioEngineCore/AllocationCounter.h"
+#include "AudioEngineCore/SampleKernels.h"
+#include "TestSources.h"
+
+namespace audioengine {
+namespace {
+
+using testing::Noise;
+
+constexpr double kPi = 3.14159265358979323846;
+constexpr uint32_t kRate = 48000;
+
+void RunCrossfeed(Crossfeed& crossfeed, std::vector<float>& samples, size_t block = 480) {
+  const size_t frames = samples.size() / 2;
+  for (size_t at = 0; at < frames; at += block) {
+    crossfeed.Process(samples.data() + at * 2, std::min(block, frames - at));
+  }
+}
+
+// Steady-state level in dB of each output channel for a tone of `frequency`
+// in the left channel only.
+void MeasureDb(const CrossfeedLevel& level, double frequency, double* left, double* right) {
+  Crossfeed crossfeed;
+  crossfeed.SetLevel(level);
+  crossfeed.SetEnabled(true);
+  crossfeed.Configure(kRate, 2);
+  std::vector<float> samples(kRate * 2, 0.0f);
+  for (size_t f = 0; f < kRate; ++f) {
+    samples[f * 2] = 0.1f * static_cast<float>(std::sin(2.0 * kPi * frequency * f / kRate));
+  }
+  RunCrossfeed(crossfeed, samples);
+  float peaks[2] = {0.0f, 0.0f};
+  for (size_t f = kRate / 2; f < kRate; ++f) {
+    for (int ch = 0; ch < 2; ++ch) peaks[ch] = std::max(peaks[ch], std::fabs(samples[f * 2 + ch]));
+  }
+  *left = 20.0 * std::log10(peaks[0] / 0.1);
+  *right = 20.0 * std::log10(peaks[1] / 0.1);
+}
+
+TEST(CrossfeedTest, FeedsLowFrequenciesAcross) {
+  double direct, crossed;
+  MeasureDb(kCrossfeedDefault, 100.0, &direct, &crossed);
+  EXPECT_NEAR(direct - crossed, 4.5, 0.5);
+  // The head shadows the far ear above the cutoff.
+  MeasureDb(kCrossfeedDefault, 8000.0, &direct, &crossed);
+  EXPECT_GT(direct - crossed, 20.0);
+
+  MeasureDb(kCrossfeedJanMeier, 100.0, &direct, &crossed);
+  EXPECT_NEAR(direct - crossed, 9.5, 0.5);
+}
+
+TEST(CrossfeedTest, KeepsCentredLowFrequenciesAtLevel) {
+  for (const CrossfeedLevel& level : {kCrossfeedDefault, kCrossfeedChuMoy, kCrossfeedJanMeier}) {
+    Crossfeed crossfeed;
+    crossfeed.SetLevel(level);
+    crossfeed.SetEnabled(true);
+    ASSERT_TRUE(crossfeed.Configure(kRate, 2));
+    std::vector<float> samples(kRate * 2);
+    for (size_t f = 0; f < kRate; ++f) {
+      samples[f * 2] = samples[f * 2 + 1] =
+          0.1f * static_cast<float>(std::sin(2.0 * kPi * 50.0 * f / kRate));
+    }
+    RunCrossfeed(crossfeed, samples);
+    float peak = 0.0f;
+    for (size_t i = kRate; i < samples.size(); ++i) peak = std::max(peak, std::fabs(samples[i]));
+    EXPECT_NEAR(20.0 * std::log10(peak / 0.1), 0.0, 0.2) << level.feedDb;
+  }
+}
+
+TEST(CrossfeedTest, DisabledPassesThroughAndFadesBothWays) {
+  Crossfeed crossfeed;
+  EXPECT_FALSE(crossfeed.Configure(kRate, 1));
+  EXPECT_FALSE(crossfeed.Configure(kRate, 6));
+  ASSERT_TRUE(crossfeed.Configure(kRate, 2));
+  const std::vector<float> input = Noise(4800 * 2, 1, 0.5f);
+  std::vector<float> output = input;
+  RunCrossfeed(crossfeed, output);
+  EXPECT_EQ(output, input);
+
+  // On: the first frames still sound like the input, then it glides.
+  crossfeed.SetEnabled(true);
+  output = input;
+  RunCrossfeed(crossfeed, output);
+  EXPECT_NEAR(output[0], input[0], 1e-3f);
+  EXPECT_NE(output, input);
+  for (size_t i = 2; i < output.size(); ++i) {
+    ASSERT_LT(std::fabs(output[i] - input[i]), 1.0f) << i;
+  }
+
+  // Off: after the ramp every frame is the input again, exactly.
+  crossfeed.SetEnabled(false);
+  output = input;
+  RunCrossfeed(crossfeed, output);
+  const size_t settled = Crossfeed::kRampFrames * 2;
+  EXPECT_FALSE(std::equal(output.begin(), output.begin() + 8, input.begin()));
+  EXPECT_TRUE(std::equal(output.begin() + settled, output.end(), input.begin() + settled));
+}
+
+TEST(CrossfeedTest, EveryIsaMatchesScalar) {
+  const KernelIsa saved = ActiveKernelIsa();
+  const std::vector<float> input = Noise(3001 * 2, 7, 0.5f);
+  std::vector<float> reference;
+  for (const KernelIsa isa :
+       {KernelIsa::kScalar, KernelIsa::kSse2, KernelIsa::kAvx2, KernelIsa::kNeon}) {
+    if (!SetKernelIsa(isa)) continue;
+    Crossfeed crossfeed;
+    crossfeed.Configure(kRate, 2);
+    crossfeed.SetEnabled(true);
+    std::vector<float> output = input;
+    // Odd blocks, so the ramp ends inside one; a level change mid-way.
+    RunCrossfeed(crossfeed, output, 701);
+    crossfeed.SetLevel(kCrossfeedChuMoy);
+    std::vector<float> more = input;
+    RunCrossfeed(crossfeed, more, 333);
+    output.insert(output.end(), more.begin(), more.end());
+    if (reference.empty()) {
+      reference = output;
+      continue;
+    }
+    for (size_t i = 0; i < output.size(); ++i) {
+      ASSERT_NEAR(output[i], reference[i], 1e-5f) << KernelIsaName(isa) << " " << i;
+    }
+  }
+  SetKernelIsa(saved);
+}
+
+TEST(CrossfeedTest, ProcessDoesNotAllocate) {
+  Crossfeed crossfeed;
+  crossfeed.Configure(kRate, 2);
+  std::vector<float> samples = Noise(4800 * 2, 3, 0.5f);
+  const uint64_t before = debug::ThreadAllocationCount();
+  crossfeed.SetEnabled(true);
+  RunCrossfeed(crossfeed, samples);
+  crossfeed.SetLevel(kCrossfeedJanMeier);
+  RunCrossfeed(crossfeed, samples);
+  crossfeed.SetEnabled(false);
+  RunCrossfeed(crossfeed, samples);
+  EXPECT_EQ(debug::ThreadAllocationCount(), before);
+}
+
+}  // namespace
+}  // namespace audioengine
@@ -0,0 +1,265 @@
+#include "AudioEngineCore/Dither.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+#include "AudioEngineCore/AllocationCounter.h"
+#include "AudioEngineCore/Crossfade.h"
+#include "AudioEngineCore/Crossfader.h"
+#include "AudioEngineCore/Fft.h"
+#include "TestSources.h"
+
+namespace audioengine {
+namespace {
+
+using testing::Noise;
+
+constexpr double kPi = 3.14159265358979323846;
+constexpr float kLsb = 1.0f / 32768.0f;
+
+std::vector<int16_t> ToS16(const std::vector<float>& samples) {
+  std::vector<int16_t> out(samples.size());
+  ConvertSamplesScalar(SampleType::kF32, samples.data(), SampleType::kS16, out.data(),
+                       samples.size());
+  return out;
+}
+
+// Mono 16-bit requantization error of `input` in LSBs.
+std::vector<float> QuantizationError(DitherMode mode, uint32_t rate,
+                                     const std::vector<float>& input) {
+  Requantizer requantizer;
+  requantizer.SetMode(mode);
+  EXPECT_TRUE(requantizer.Configure(SampleType::kS16, rate, 1));
+  std::vector<float> scratch = input;
+  std::vector<int16_t> output(input.size());
+  for (size_t at = 0; at < input.size(); at += 480) {
+    const size_t n = std::min<size_t>(480, input.size() - at);
+    requantizer.Quantize(scratch.data() + at, output.data() + at, n);
+  }
+  std::vector<float> error(input.size());
+  for (size_t i = 0; i < input.size(); ++i) {
+    error[i] = static_cast<float>(output[i]) - input[i] * 32768.0f;
+  }
+  return error;
+}
+
+// Mean power of `error` between two frequencies, from Hann-windowed
+// 4096-point spectra.
+double BandPowerDb(const std::vector<float>& error, uint32_t rate, double fromHz,
+                   double toHz) {
+  constexpr size_t kSize = 4096;
+  RealFft fft(kSize);
+  std::vector<float> window(kSize), re(fft.Bins()), im(fft.Bins());
+  double power = 0.0;
+  size_t bins = 0;
+  for (size_t at = 0; at + kSize <= error.size(); at += kSize) {
+    for (size_t i = 0; i < kSize; ++i) {
+      window[i] = error[at + i] * static_cast<float>(0.5 - 0.5 * std::cos(2.0 * kPi * i / kSize));
+    }
+    fft.Forward(window.data(), re.data(), im.data());
+    for (size_t b = 0; b < fft.Bins(); ++b) {
+      const double frequency = static_cast<double>(b) * rate / kSize;
+      if (frequency < fromHz || frequency > toHz) continue;
+      power += static_cast<double>(re[b]) * re[b] + static_cast<double>(im[b]) * im[b];
+      ++bins;
+    }
+  }
+  return 10.0 * std::log10(power / bins);
+}
+
+TEST(DitherTest, UnityGainStaysBitPerfect) {
+  Requantizer requantizer;
+  EXPECT_FALSE(requantizer.Configure(SampleType::kF32, 48000, 2));
+  EXPECT_FALSE(requantizer.Configure(SampleType::kS16, 48000, Requantizer::kMaxChannels + 1));
+  EXPECT_FALSE(requantizer.IsConfigured());
+  ASSERT_TRUE(requantizer.Configure(SampleType::kS16, 48000, 2));
+
+  const std::vector<int16_t> input = ToS16(Noise(4800 * 2, 1, 0.5f));
+  std::vector<int16_t> samples = input;
+  requantizer.ApplyGain(samples.data(), 4800, 1.0f);
+  EXPECT_EQ(samples, input);
+
+  // Any other gain lands within the dither's reach of the exact product.
+  requantizer.SetMode(DitherMode::kTpdf);
+  requantizer.ApplyGain(samples.data(), 4800, 0.3f);
+  for (size_t i = 0; i < samples.size(); ++i) {
+    ASSERT_LE(std::abs(samples[i] - input[i] * 0.3f), 2.0f) << i;
+  }
+}
+
+TEST(DitherTest, TpdfDecorrelatesTheErrorFromTheSignal) {
+  // A 1 kHz tone of 1.3 LSB: plain rounding turns it into a staircase with
+  // strong odd harmonics; with TPDF the error is white noise of 1/4 LSB^2.
+  constexpr uint32_t kRate = 48000;
+  std::vector<float> tone(kRate);
+  for (size_t i = 0; i < tone.size(); ++i) {
+    tone[i] = 1.3f * kLsb * static_cast<float>(std::sin(2.0 * kPi * 1000.0 * i / kRate));
+  }
+  const auto harmonicToNoise = [&](const std::vector<float>& error) {
+    double re = 0.0, im = 0.0, power = 0.0;
+    for (size_t i = 0; i < error.size(); ++i) {
+      re += error[i] * std::cos(2.0 * kPi * 3000.0 * i / kRate);
+      im += error[i] * std::sin(2.0 * kPi * 3000.0 * i / kRate);
+      power += static_cast<double>(error[i]) * error[i];
+    }
+    // Third-harmonic bin over the average bin.
+    return (re * re + im * im) / power;
+  };
+
+  const std::vector<float> rounded = QuantizationError(DitherMode::kOff, kRate, tone);
+  const std::vector<float> dithered = QuantizationError(DitherMode::kTpdf, kRate, tone);
+  EXPECT_GT(harmonicToNoise(rounded), 1000.0);
+  EXPECT_LT(harmonicToNoise(dithered), 20.0);
+
+  double mean = 0.0, power = 0.0;
+  for (float e : dithered) {
+    mean += e;
+    power += static_cast<double>(e) * e;
+  }
+  EXPECT_NEAR(mean / dithered.size(), 0.0, 0.01);
+  EXPECT_NEAR(power / dithered.size(), 0.25, 0.01);
+}
+
+TEST(DitherTest, NoiseShapingMovesNoiseOutOfTheMidrange) {
+  constexpr uint32_t kRate = 44100;
+  const std::vector<float> input = Noise(4096 * 40, 2, 8.0f * kLsb);
+  const std::vector<float> flat = QuantizationError(DitherMode::kTpdf, kRate, input);
+  const std::vector<float> highpass = QuantizationError(DitherMode::kHighpass, kRate, input);
+  const std::vector<float> weighted = QuantizationError(DitherMode::kFWeighted, kRate, input);
+
+  const double flatMid = BandPowerDb(flat, kRate, 1000.0, 4000.0);
+  const double flatHigh = BandPowerDb(flat, kRate, 16000.0, 20000.0);
+  EXPECT_NEAR(flatMid, flatHigh, 1.0);
+  EXPECT_LT(BandPowerDb(highpass, kRate, 200.0, 1000.0),
+            BandPowerDb(flat, kRate, 200.0, 1000.0) - 25.0);
+  EXPECT_LT(BandPowerDb(weighted, kRate, 1000.0, 4000.0), flatMid - 12.0);
+  EXPECT_LT(BandPowerDb(weighted, kRate, 2500.0, 4500.0), flatMid - 20.0);
+  EXPECT_GT(BandPowerDb(weighted, kRate, 16000.0, 20000.0), flatHigh + 10.0);
+
+  // Above 50 kHz the F-weighted filter would shape the wrong band.
+  const std::vector<float> hiRes = Noise(9600, 3, 8.0f * kLsb);
+  EXPECT_EQ(QuantizationError(DitherMode::kFWeighted, 96000, hiRes),
+            QuantizationError(DitherMode::kHighpass, 96000, hiRes));
+}
+
+TEST(DitherTest, VectorKernelsMatchScalar) {
+  const KernelIsa saved = ActiveKernelIsa();
+  for (const DitherMode mode : {DitherMode::kTpdf, DitherMode::kHighpass, DitherMode::kFWeighted}) {
+    for (const uint32_t channels : {1u, 2u, 3u, 6u, 8u}) {
+      const std::vector<int16_t> input = ToS16(Noise(4800 * channels, channels, 0.9f));
+      const auto run = [&] {
+        Requantizer requantizer;
+        requantizer.SetMode(mode);
+        requantizer.Configure(SampleType::kS16, 44100, channels);
+        std::vector<int16_t> samples = input;
+        for (size_t at = 0; at < 4800; at += 333) {
+          requantizer.ApplyGain(samples.data() + at * channels,
+                                std::min<size_t>(333, 4800 - at), 0.7f);
+        }
+        return samples;
+      };
+      ASSERT_TRUE(SetKernelIsa(KernelIsa::kScalar));
+      const std::vector<int16_t> reference = run();
+      for (const KernelIsa isa : {KernelIsa::kSse2, KernelIsa::kAvx2, KernelIsa::kNeon}) {
+        if (!SetKernelIsa(isa)) continue;
+        EXPECT_EQ(run(), reference) << KernelIsaName(isa) << " " << DitherModeName(mode)
+                                    << " " << channels;
+      }
+    }
+  }
+  SetKernelIsa(saved);
+}
+
+TEST(DitherTest, MixesIntegerFades) {
+  constexpr size_t kFrames = 1500;
+  const std::vector<float> out = Noise(kFrames * 2, 4, 0.6f);
+  const std::vector<float> in = Noise(kFrames * 2, 5, 0.6f);
+  std::vector<float> outGain(kFrames), inGain(kFrames);
+  EqualPowerGains(0, kFrames, kFrames, outGain.data(), inGain.data());
+
+  for (const SampleType type : {SampleType::kS16, SampleType::kS24}) {
+    const float steps = type == SampleType::kS16 ? 32768.0f : 8388608.0f;
+    std::vector<uint8_t> dst(out.size() * BytesPerSample(type));
+    std::vector<uint8_t> incoming(dst.size());
+    ConvertSamplesScalar(SampleType::kF32, out.data(), type, dst.data(), out.size());
+    ConvertSamplesScalar(SampleType::kF32, in.data(), type, incoming.data(), in.size());
+    std::vector<float> outQ(out.size()), inQ(in.size()), mixed(out.size());
+    ConvertSamplesScalar(type, dst.data(), SampleType::kF32, outQ.data(), out.size());
+    ConvertSamplesScalar(type, incoming.data(), SampleType::kF32, inQ.data(), in.size());
+
+    Requantizer requantizer;
+    requantizer.SetMode(DitherMode::kTpdf);
+    ASSERT_TRUE(requantizer.Configure(type, 48000, 2));
+    requantizer.MixCrossfade(dst.data(), incoming.data(), outGain.data(), inGain.data(),
+                             kFrames);
+    ConvertSamplesScalar(type, dst.data(), SampleType::kF32, mixed.data(), out.size());
+    for (size_t i = 0; i < mixed.size(); ++i) {
+      const float exact = outQ[i] * outGain[i / 2] + inQ[i] * inGain[i / 2];
+      ASSERT_LE(std::fabs(mixed[i] - exact) * steps, 2.0f) << i;
+    }
+  }
+}
+
+TEST(DitherTest, RecoversFromClippingWithoutAllocating) {
+  constexpr uint32_t kRate = 48000;
+  Requantizer requantizer;
+  ASSERT_TRUE(requantizer.Configure(SampleType::kS16, kRate, 2));
+  std::vector<float> tone(kRate * 2);
+  for (size_t i = 0; i < tone.size(); ++i) {
+    tone[i] = static_cast<float>(std::sin(2.0 * kPi * 440.0 * (i / 2) / kRate));
+  }
+  std::vector<int16_t> samples = ToS16(tone);
+  const uint64_t before = debug::ThreadAllocationCount();
+  // Three times full scale for half a second, then 1/1000.
+  for (size_t at = 0; at < kRate; at += 480) {
+    const float gain = at < kRate / 2 ? 3.0f : 0.001f;
+    requantizer.ApplyGain(samples.data() + at * 2, 480, gain);
+    if (at == kRate / 4) requantizer.SetMode(DitherMode::kHighpass);
+    if (at == kRate / 2) requantizer.SetMode(DitherMode::kFWeighted);
+  }
+  EXPECT_EQ(debug::ThreadAllocationCount(), before);
+
+  EXPECT_EQ(*std::max_element(samples.begin(), samples.begin() + kRate), 32767);
+  EXPECT_EQ(*std::min_element(samples.begin(), samples.begin() + kRate), -32768);
+  // The shaped noise floor is back to normal (about 17 LSB^2 for the
+  // F-weighted filter) right after the clipped stretch.
+  double power = 0.0;
+  for (size_t i = kRate; i < 2 * kRate; ++i) {
+    const double exact = std::round(tone[i] * 32768.0) * 0.001;
+    power += (samples[i] - exact) * (samples[i] - exact);
+  }
+  EXPECT_LT(power / kRate, 30.0);
+}
+
+TEST(DitherTest, CrossfaderRequantizesIntegerGain) {
+  using testing::CountingSource;
+  StreamingDecoder::Options options;
+  options.bufferSeconds = 0.5;
+  options.prefillSeconds = 0.05;
+  Crossfader fader(options);
+  fader.SetDither(DitherMode::kTpdf);
+  fader.SetOutputGain(0.5f);
+  constexpr uint64_t kFrames = 4800;
+  ASSERT_TRUE(fader.Start(std::make_unique<CountingSource>(48000, 2, kFrames)));
+  std::vector<int32_t> block(kFrames * 2);
+  size_t got = 0;
+  while (got < kFrames && !fader.IsFinished()) {
+    got += fader.Read(reinterpret_cast<uint8_t*>(block.data() + got * 2), kFrames - got);
+  }
+  ASSERT_EQ(got, kFrames);
+  // 32-bit output is dithered at 24 bits: steps of 256, within 1.5 steps.
+  for (size_t i = 0; i < block.size(); ++i) {
+    ASSERT_EQ(block[i] % 256, 0) << i;
+    ASSERT_LE(std::fabs(block[i] - CountingSource::SampleAt(i / 2, i % 2, 2) * 0.5), 384.0)
+        << i;
+  }
+}
+
+}  // namespace
+}  // namespace audioengine
@@ -0,0 +1,258 @@
+#include "AudioEngineCore/AudioFeatures.h"
+#include "AudioEngineCore/FeatureScanner.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "TestCache.h"
+#include "TestSources.h"
+
+namespace audioengine {
+namespace {
+
+using CacheCleanup = testing::CacheCleanup<FeatureScanner>;
+using testing::MemorySource;
+
+constexpr double kPi = 3.14159265358979323846;
+
+// Deterministic white noise in [-1, 1).
+class Noise {
+ public:
+  float Next() {
+    state_ = state_ * 1664525u + 1013904223u;
+    return static_cast<float>(state_ >> 8) / 8388608.0f - 1.0f;
+  }
+
+ private:
+  uint32_t state_ = 12345;
+};
+
+// Stereo noise bursts (30 ms, decaying) on every beat.
+std::vector<float> ClickTrack(uint32_t rate, double bpm, double seconds) {
+  const size_t frames = static_cast<size_t>(seconds * rate);
+  const double period = 60.0 * rate / bpm;
+  std::vector<float> samples(frames * 2, 0.0f);
+  Noise noise;
+  for (double beat = 0.0; beat < frames; beat += period) {
+    const size_t start = static_cast<size_t>(beat);
+    const size_t length = std::min<size_t>(rate * 3 / 100, frames - start);
+    for (size_t i = 0; i < length; ++i) {
+      const float value = 0.5f * std::exp(-5.0f * i / length) * noise.Next();
+      samples[(start + i) * 2] = value;
+      samples[(start + i) * 2 + 1] = value;
+    }
+  }
+  return samples;
+}
+
+// Mono triads in octave 4, one second each, looped for `seconds`. Each chord
+// is three semitone offsets from middle C.
+std::vector<float> Chords(uint32_t rate, const std::vector<std::vector<int>>& chords,
+                          double seconds) {
+  const size_t frames = static_cast<size_t>(seconds * rate);
+  std::vector<float> samples(frames, 0.0f);
+  for (size_t f = 0; f < frames; ++f) {
+    const std::vector<int>& chord = chords[(f / rate) % chords.size()];
+    double value = 0.0;
+    for (int semitone : chord) {
+      const double hz = 261.6256 * std::pow(2.0, semitone / 12.0);
+      value += 0.15 * std::sin(2.0 * kPi * hz * f / rate);
+    }
+    samples[f] = static_cast<float>(value);
+  }
+  return samples;
+}
+
+TrackFeatures Analyze(const std::vector<float>& samples, uint32_t rate, uint32_t channels) {
+  FeatureAnalyzer analyzer;
+  analyzer.Configure(rate, channels);
+  // Decoder-sized blocks.
+  const size_t frames = samples.size() / channels;
+  for (size_t at = 0; at < frames; at += 4096) {
+    analyzer.Process(samples.data() + at * channels, std::min<size_t>(4096, frames - at));
+  }
+  TrackFeatures features;
+  EXPECT_TRUE(analyzer.Finish(&features));
+  return features;
+}
+
+TEST(FeatureAnalyzerTest, FindsTempoOfClickTracks) {
+  for (const double bpm : {120.0, 90.0, 174.0}) {
+    const TrackFeatures features = Analyze(ClickTrack(44100, bpm, 30.0), 44100, 2);
+    EXPECT_NEAR(features.bpm, bpm, 1.0) << bpm;
+    EXPECT_GT(features.tempoConfidence, 0.5) << bpm;
+    EXPECT_NEAR(features.onsetRate, bpm / 60.0, 0.2) << bpm;
+  }
+  // Steady clicks at 120 are as danceable as it gets; 90 less so.
+  EXPECT_GT(Analyze(ClickTrack(44100, 120.0, 30.0), 44100, 2).danceability,
+            Analyze(ClickTrack(44100, 90.0, 30.0), 44100, 2).danceability);
+}
+
+TEST(FeatureAnalyzerTest, TempoDoesNotDependOnRate) {
+  const TrackFeatures cd = Analyze(ClickTrack(44100, 128.0, 20.0), 44100, 2);
+  const TrackFeatures hiRes = Analyze(ClickTrack(88200, 128.0, 20.0), 88200, 2);
+  const TrackFeatures dat = Analyze(ClickTrack(48000, 128.0, 20.0), 48000, 2);
+  EXPECT_NEAR(cd.bpm, 128.0, 1.0);
+  EXPECT_NEAR(hiRes.bpm, cd.bpm, 0.5);
+  EXPECT_NEAR(dat.bpm, cd.bpm, 1.0);
+  EXPECT_EQ(hiRes.sampleRate, 88200u);
+  EXPECT_EQ(hiRes.frames, 88200u * 20);
+}
+
+TEST(FeatureAnalyzerTest, FindsMajorAndMinorKeys) {
+  // I IV V I in C major.
+  const TrackFeatures major =
+      Analyze(Chords(44100, {{0, 4, 7}, {5, 9, 12}, {7, 11, 14}, {0, 4, 7}}, 16.0), 44100, 1);
+  EXPECT_EQ(major.key, 0);
+  EXPECT_FALSE(major.minor);
+  EXPECT_GT(major.keyConfidence, 0.6);
+
+  // i iv V i in A minor.
+  const TrackFeatures minor =
+      Analyze(Chords(48000, {{9, 12, 16}, {2, 5, 9}, {4, 8, 11}, {9, 12, 16}}, 16.0), 48000, 1);
+  EXPECT_EQ(minor.key, 9);
+  EXPECT_TRUE(minor.minor);
+  EXPECT_GT(minor.keyConfidence, 0.6);
+}
+
+TEST(FeatureAnalyzerTest, SpectralShapeAndEnergy) {
+  constexpr uint32_t kRate = 44100;
+  std::vector<float> noise(kRate * 10);
+  Noise source;
+  for (float& sample : noise) sample = 0.5f * source.Next();
+  std::vector<float> sine(kRate * 10);
+  for (size_t i = 0; i < sine.size(); ++i) {
+    sine[i] = static_cast<float>(0.05 * std::sin(2.0 * kPi * 440.0 * i / kRate));
+  }
+
+  const TrackFeatures loud = Analyze(noise, kRate, 1);
+  const TrackFeatures quiet = Analyze(sine, kRate, 1);
+  // White noise spreads evenly to the analysis Nyquist (11 kHz).
+  EXPECT_NEAR(loud.spectralCentroidHz, 5512.0, 300.0);
+  EXPECT_NEAR(loud.spectralRolloffHz, 0.85 * 11025.0, 300.0);
+  EXPECT_GT(loud.spectralFlatness, 0.4);
+  EXPECT_NEAR(loud.rmsDb, 20.0 * std::log10(0.5 / std::sqrt(3.0)), 0.2);
+  EXPECT_NEAR(quiet.spectralCentroidHz, 440.0, 50.0);
+  EXPECT_LT(quiet.spectralFlatness, 0.01);
+  EXPECT_NEAR(quiet.rmsDb, 20.0 * std::log10(0.05 / std::sqrt(2.0)), 0.1);
+  EXPECT_GT(loud.energy, quiet.energy + 0.3);
+  // Nothing periodic in either.
+  EXPECT_EQ(loud.bpm, 0.0);
+  EXPECT_EQ(loud.danceability, 0.0);
+  EXPECT_EQ(quiet.bpm, 0.0);
+}
+
+TEST(FeatureAnalyzerTest, SilenceHasNoKeyOrTempo) {
+  const TrackFeatures features = Analyze(std::vector<float>(44100 * 10, 0.0f), 44100, 1);
+  EXPECT_EQ(features.key, -1);
+  EXPECT_EQ(features.bpm, 0.0);
+  EXPECT_EQ(features.energy, 0.0);
+  EXPECT_EQ(features.rmsDb, -120.0);
+  FeatureAnalyzer empty;
+  empty.Configure(44100, 2);
+  TrackFeatures unused;
+  EXPECT_FALSE(empty.Finish(&unused));
+}
+
+TEST(FeatureScannerTest, ScansAndResumesFromCache) {
+  const std::string dir = ::testing::TempDir();
+  const std::vector<double> tempos = {100.0, 120.0, 140.0, 160.0};
+  std::vector<SeekIndex::Key> keys;
+  for (size_t i = 0; i < tempos.size(); ++i) {
+    keys.push_back({dir + "features-" + std::to_string(i) + ".flac", 2000 + i, 1700000000});
+  }
+  keys.push_back({dir + "features-broken.flac", 10, 1700000000});
+  CacheCleanup cleanup(keys);
+
+  std::atomic<int> opens{0};
+  auto open = [&](const std::string& path) -> std::unique_ptr<PcmSource> {
+    ++opens;
+    if (path == keys.back().path) return nullptr;
+    const size_t index = path[path.find("features-") + 9] - '0';
+    PcmFormat format;
+    format.sampleRate = 44100;
+    format.channels = 2;
+    format.bitsPerSample = 32;
+    format.isFloat = true;
+    return std::make_unique<MemorySource>(ClickTrack(44100, tempos[index], 12.0), format);
+  };
+
+  {
+    FeatureScanner scanner(dir, open, 3);
+    EXPECT_EQ(scanner.WorkerCount(), 3u);
+    scanner.Enqueue(keys);
+    scanner.Enqueue(keys);  // duplicates are ignored
+    scanner.WaitIdle();
+    EXPECT_EQ(opens.load(), 5);
+    for (size_t i = 0; i < tempos.size(); ++i) {
+      TrackFeatures features;
+      ASSERT_TRUE(scanner.Track(keys[i].path, &features));
+      EXPECT_NEAR(features.bpm, tempos[i], 1.0);
+      EXPECT_EQ(features.frames, 44100u * 12);
+    }
+    TrackFeatures features;
+    EXPECT_FALSE(scanner.Track(keys.back().path, &features));
+
+    const FeatureScanner::Stats stats = scanner.GetStats();
+    EXPECT_EQ(stats.tracksAnalyzed, 4u);
+    EXPECT_EQ(stats.tracksFailed, 1u);
+    EXPECT_EQ(stats.tracksPending, 0u);
+    EXPECT_NEAR(stats.audioSeconds, 48.0, 1e-9);
+    EXPECT_GT(stats.TracksPerSecondPerCore(), 0.0);
+    EXPECT_GT(stats.RealtimeFactor(), 1.0);
+  }
+
+  // A new session reads every result back bit for bit without decoding.
+  FeatureScanner resumed(dir, open, 2);
+  TrackFeatures cached;
+  ASSERT_TRUE(resumed.LoadCached(keys[1], &cached));
+  EXPECT_NEAR(cached.bpm, 120.0, 1.0);
+  resumed.Enqueue({keys.begin(), keys.end() - 1});
+  resumed.WaitIdle();
+  EXPECT_EQ(opens.load(), 5);
+  EXPECT_EQ(resumed.GetStats().tracksCached, 4u);
+  TrackFeatures tracked;
+  ASSERT_TRUE(resumed.Track(keys[1].path, &tracked));
+  EXPECT_EQ(tracked.bpm, cached.bpm);
+  EXPECT_EQ(tracked.key, cached.key);
+  EXPECT_EQ(tracked.spectralFlatness, cached.spectralFlatness);
+
+  // A changed file is analysed again.
+  SeekIndex::Key changed = keys[0];
+  changed.mtimeSeconds += 1;
+  CacheCleanup changedCleanup({changed});
+  EXPECT_FALSE(resumed.LoadCached(changed, &cached));
+  FeatureScanner rescan(dir, open, 1);
+  rescan.Enqueue({changed});
+  rescan.WaitIdle();
+  EXPECT_EQ(opens.load(), 6);
+}
+
+TEST(FeatureScannerTest, CancelDropsQueuedTracks) {
+  std::atomic<int> opens{0};
+  FeatureScanner scanner("", [&](const std::string&) -> std::unique_ptr<PcmSource> {
+    ++opens;
+    PcmFormat format;
+    format.sampleRate = 44100;
+    format.channels = 1;
+    format.bitsPerSample = 32;
+    format.isFloat = true;
+    return std::make_unique<MemorySource>(std::vector<float>(44100 * 60, 0.1f), format);
+  }, 1);
+  std::vector<SeekIndex::Key> keys;
+  for (int i = 0; i < 50; ++i) keys.push_back({"cancel-" + std::to_string(i), 1, 1});
+  scanner.Enqueue(keys);
+  scanner.Cancel();
+  scanner.WaitIdle();
+  EXPECT_LT(opens.load(), 50);
+  EXPECT_EQ(scanner.GetStats().tracksPending, 0u);
+}
+
+}  // namespace
+}  // namespace audioengine
@@ -0,0 +1,52 @@
+#include "AudioEngineCore/Fft.h"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <vector>
+
+#include "TestSources.h"
+
+namespace audioengine {
+namespace {
+
+using testing::Noise;
+
+constexpr double kPi = 3.14159265358979323846;
+
+TEST(FftTest, MatchesDirectDft) {
+  for (const size_t size : {4u, 16u, 256u, 2048u}) {
+    RealFft fft(size);
+    ASSERT_EQ(fft.Bins(), size / 2 + 1);
+    const std::vector<float> input = Noise(size, static_cast<uint32_t>(size), 1.0f);
+    std::vector<float> re(fft.Bins()), im(fft.Bins());
+    fft.Forward(input.data(), re.data(), im.data());
+    for (size_t k = 0; k < fft.Bins(); ++k) {
+      double wantRe = 0.0, wantIm = 0.0;
+      for (size_t n = 0; n < size; ++n) {
+        const double angle = -2.0 * kPi * static_cast<double>(k * n % size) / size;
+        wantRe += input[n] * std::cos(angle);
+        wantIm += input[n] * std::sin(angle);
+      }
+      const double tolerance = 1e-5 * size;
+      ASSERT_NEAR(re[k], wantRe, tolerance) << size << " " << k;
+      ASSERT_NEAR(im[k], wantIm, tolerance) << size << " " << k;
+    }
+  }
+}
+
+TEST(FftTest, InverseRoundTripsScaledBySize) {
+  for (const size_t size : {8u, 512u, 8192u}) {
+    RealFft fft(size);
+    const std::vector<float> input = Noise(size, 7, 1.0f);
+    std::vector<float> re(fft.Bins()), im(fft.Bins()), output(size);
+    fft.Forward(input.data(), re.data(), im.data());
+    fft.Inverse(re.data(), im.data(), output.data());
+    for (size_t i = 0; i < size; ++i) {
+      ASSERT_NEAR(output[i] / size, input[i], 1e-5f) << size << " " << i;
+    }
+  }
+}
+
+}  // namespace
+}  // namespace audioengine
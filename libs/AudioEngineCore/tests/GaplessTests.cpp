@@ -0,0 +1,252 @@
+#include "AudioEngineCore/Gapless.h"
+#include "AudioEngineCore/StreamingDecoder.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "TestSources.h"
+
+namespace audioengine {
+namespace {
+
+using testing::PaddedSource;
+
+constexpr uint32_t kChannels = 2;
+
+// Reads a source to the end in `chunk`-frame calls.
+std::vector<int32_t> ReadAll(PcmSource& source, size_t chunk) {
+  std::vector<int32_t> samples;
+  std::vector<int32_t> block(chunk * kChannels);
+  while (size_t got = source.ReadFrames(reinterpret_cast<uint8_t*>(block.data()), chunk)) {
+    samples.insert(samples.end(), block.begin(), block.begin() + got * kChannels);
+  }
+  return samples;
+}
+
+// Drains the decoder like a render callback until it reports finished.
+std::vector<int32_t> Drain(StreamingDecoder& decoder) {
+  std::vector<int32_t> samples;
+  std::vector<int32_t> block(480 * kChannels);
+  const auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::seconds(30);
+  while (!decoder.IsFinished()) {
+    const size_t got = decoder.Read(reinterpret_cast<uint8_t*>(block.data()), 480);
+    samples.insert(samples.end(), block.begin(), block.begin() + got * kChannels);
+    if (got == 0) std::this_thread::sleep_for(std::chrono::microseconds(200));
+    if (std::chrono::steady_clock::now() > deadline) {
+      ADD_FAILURE() << "decoder did not finish";
+      break;
+    }
+  }
+  return samples;
+}
+
+// Checks `samples[offset...]` against `frames` frames of a PaddedSource's
+// real audio starting at value `firstValue`.
+void ExpectTrack(const std::vector<int32_t>& samples, size_t offsetFrames,
+                 uint64_t frames, int32_t firstValue) {
+  ASSERT_GE(samples.size(), (offsetFrames + frames) * kChannels);
+  for (uint64_t i = 0; i < frames * kChannels; ++i) {
+    const int32_t got = samples[offsetFrames * kChannels + i];
+    if (got != static_cast<int32_t>(firstValue + i)) {
+      FAIL() << "sample " << i << " of track at frame " << offsetFrames
+             << ": got " << got << ", expected " << firstValue + i;
+    }
+  }
+}
+
+std::unique_ptr<PcmSource> Trimmed(uint64_t leading, uint64_t valid,
+                                   uint64_t trailing, int32_t firstValue,
+                                   bool knownLength) {
+  GaplessInfo info;
+  info.leadingFrames = leading;
+  info.trailingFrames = trailing;
+  info.validFrames = knownLength ? valid : 0;
+  return std::make_unique<TrimmingSource>(
+      std::make_unique<PaddedSource>(44100, kChannels, leading, valid, trailing,
+                                     firstValue),
+      info);
+}
+
+// First frame of a 128 kbit/s joint-stereo MPEG-1 layer III stream with a
+// LAME "Info" tag, behind a 20-byte ID3v2 tag. `crc` sets the protected
+// variant, with a 16-bit CRC between the header and the side info.
+std::vector<uint8_t> LameFile(uint32_t frames, uint16_t delay, uint16_t padding,
+                              bool crc = false) {
+  std::vector<uint8_t> file = {'I', 'D', '3', 4, 0, 0, 0, 0, 0, 20};
+  file.resize(file.size() + 20, 0);
+  const uint8_t header[] = {0xff, static_cast<uint8_t>(crc ? 0xfa : 0xfb), 0x90,
+                            0x64};
+  file.insert(file.end(), header, header + 4);
+  if (crc) file.insert(file.end(), {0x5a, 0xa5});
+  file.resize(file.size() + 32, 0);  // side info
+  const uint8_t info[] = {'I', 'n', 'f', 'o', 0, 0, 0, 0x0f,
+                          static_cast<uint8_t>(frames >> 24),
+                          static_cast<uint8_t>(frames >> 16),
+                          static_cast<uint8_t>(frames >> 8),
+                          static_cast<uint8_t>(frames)};
+  file.insert(file.end(), info, info + sizeof(info));
+  file.resize(file.size() + 4 + 100 + 4, 0);  // bytes, TOC, quality
+  const char encoder[] = "LAME3.100";
+  file.insert(file.end(), encoder, encoder + 9);
+  file.resize(file.size() + 12, 0);
+  file.push_back(static_cast<uint8_t>(delay >> 4));
+  file.push_back(static_cast<uint8_t>(((delay & 0x0f) << 4) | (padding >> 8)));
+  file.push_back(static_cast<uint8_t>(padding));
+  file.resize(file.size() + 64, 0);
+  return file;
+}
+
+TEST(GaplessTest, ParsesITunSMPB) {
+  GaplessInfo info;
+  ASSERT_TRUE(ParseITunSMPB(
+      " 00000000 00000840 000001CA 00000000003F31F6 00000000 00000000",
+      &info));
+  EXPECT_EQ(info.leadingFrames, 2112u);
+  EXPECT_EQ(info.trailingFrames, 458u);
+  EXPECT_EQ(info.validFrames, 4141558u);
+
+  EXPECT_FALSE(ParseITunSMPB("not a gapless tag", &info));
+  EXPECT_FALSE(ParseITunSMPB(" 00000000 00000840", &info));
+}
+
+TEST(GaplessTest, ParsesLameHeaderBehindId3) {
+  const std::vector<uint8_t> file = LameFile(100, 576, 1260);
+  GaplessInfo info;
+  ASSERT_TRUE(ParseLameHeader(file.data(), file.size(), &info));
+  EXPECT_EQ(info.leadingFrames, 576u + kMp3DecoderDelay);
+  EXPECT_EQ(info.trailingFrames, 1260u - kMp3DecoderDelay);
+  EXPECT_EQ(info.validFrames, 100u * 1152 - 576 - 1260);
+
+  // Same frame with the tag overwritten: a plain CBR file.
+  std::vector<uint8_t> plain = file;
+  memcpy(plain.data() + 30 + 4 + 32, "\0\0\0\0", 4);
+  EXPECT_FALSE(ParseLameHeader(plain.data(), plain.size(), &info));
+  // Truncated before the LAME extension.
+  EXPECT_FALSE(ParseLameHeader(file.data(), 30 + 4 + 32 + 12 + 108, &info));
+}
+
+TEST(GaplessTest, ParsesLameHeaderAfterCrc) {
+  const std::vector<uint8_t> file = LameFile(100, 576, 1260, true);
+  GaplessInfo info;
+  ASSERT_TRUE(ParseLameHeader(file.data(), file.size(), &info));
+  EXPECT_EQ(info.leadingFrames, 576u + kMp3DecoderDelay);
+  EXPECT_EQ(info.trailingFrames, 1260u - kMp3DecoderDelay);
+  EXPECT_EQ(info.validFrames, 100u * 1152 - 576 - 1260);
+}
+
+TEST(GaplessTest, TrimsByLengthWhenKnown) {
+  auto source = Trimmed(2112, 10000, 458, 0, /*knownLength=*/true);
+  EXPECT_EQ(source->TotalFrames(), 10000u);
+  const std::vector<int32_t> samples = ReadAll(*source, 333);
+  ASSERT_EQ(samples.size(), 10000u * kChannels);
+  ExpectTrack(samples, 0, 10000, 0);
+}
+
+TEST(GaplessTest, HoldsBackPaddingWhenLengthUnknown) {
+  // Chunks smaller than the padding exercise the hold-back wrap-around.
+  for (size_t chunk : {100, 731, 4096}) {
+    auto source = Trimmed(1105, 10000, 731, 0, /*knownLength=*/false);
+    EXPECT_EQ(source->TotalFrames(), 10000u);
+    const std::vector<int32_t> samples = ReadAll(*source, chunk);
+    ASSERT_EQ(samples.size(), 10000u * kChannels) << "chunk " << chunk;
+    ExpectTrack(samples, 0, 10000, 0);
+  }
+}
+
+TEST(GaplessTest, SeeksInTrimmedTime) {
+  for (bool knownLength : {true, false}) {
+    auto source = Trimmed(1105, 10000, 731, 0, knownLength);
+    uint64_t landed = 0;
+    ASSERT_TRUE(source->SeekToFrame(5000, SeekMode::kAccurate, &landed));
+    EXPECT_EQ(landed, 5000u);
+    const std::vector<int32_t> samples = ReadAll(*source, 256);
+    ASSERT_EQ(samples.size(), 5000u * kChannels);
+    ExpectTrack(samples, 0, 5000, 5000 * kChannels);
+  }
+}
+
+TEST(GaplessTest, SplicesNextTrackSampleExact) {
+  StreamingDecoder::Options options;
+  options.bufferSeconds = 0.05;
+  options.prefillSeconds = 0.01;
+  options.chunkFrames = 256;
+  StreamingDecoder decoder(options);
+
+  constexpr uint64_t kFirst = 44100 * 2 + 17;
+  constexpr uint64_t kSecond = 44100 + 5;
+  constexpr int32_t kSecondBase = 1 << 24;
+  ASSERT_TRUE(decoder.Start(Trimmed(2112, kFirst, 458, 0, true)));
+  EXPECT_TRUE(decoder.QueueNext(Trimmed(1105, kSecond, 731, kSecondBase, false)));
+  EXPECT_TRUE(decoder.HasQueuedNext());
+  EXPECT_EQ(decoder.TotalFrames(), kFirst);
+
+  const std::vector<int32_t> samples = Drain(decoder);
+  ASSERT_EQ(samples.size(), (kFirst + kSecond) * kChannels);
+  ExpectTrack(samples, 0, kFirst, 0);
+  ExpectTrack(samples, kFirst, kSecond, kSecondBase);
+
+  // The transition is reported once and rebases position onto the new track.
+  EXPECT_TRUE(decoder.TakeTrackChange());
+  EXPECT_FALSE(decoder.TakeTrackChange());
+  EXPECT_EQ(decoder.PositionFrames(), kSecond);
+  EXPECT_EQ(decoder.TotalFrames(), kSecond);
+}
+
+TEST(GaplessTest, QueueAfterSourceEndedStillSplices) {
+  StreamingDecoder::Options options;
+  options.bufferSeconds = 1.0;
+  options.prefillSeconds = 0.5;
+  StreamingDecoder decoder(options);
+
+  // Shorter than the prefill target, so the producer has already hit the
+  // end of the first track when Start() returns.
+  constexpr uint64_t kFirst = 4000;
+  constexpr uint64_t kSecond = 3000;
+  ASSERT_TRUE(decoder.Start(Trimmed(2112, kFirst, 458, 0, true)));
+  ASSERT_EQ(decoder.BufferedFrames(), kFirst);
+  EXPECT_TRUE(decoder.QueueNext(Trimmed(2112, kSecond, 458, 1 << 24, true)));
+
+  const std::vector<int32_t> samples = Drain(decoder);
+  ASSERT_EQ(samples.size(), (kFirst + kSecond) * kChannels);
+  ExpectTrack(samples, 0, kFirst, 0);
+  ExpectTrack(samples, kFirst, kSecond, 1 << 24);
+}
+
+TEST(GaplessTest, SeekBeforeBoundaryKeepsNextTrackQueued) {
+  StreamingDecoder::Options options;
+  options.bufferSeconds = 1.0;
+  options.prefillSeconds = 0.5;
+  StreamingDecoder decoder(options);
+
+  constexpr uint64_t kFirst = 4000;
+  constexpr uint64_t kSecond = 3000;
+  ASSERT_TRUE(decoder.Start(Trimmed(2112, kFirst, 458, 0, true)));
+  EXPECT_TRUE(decoder.QueueNext(Trimmed(2112, kSecond, 458, 1 << 24, true)));
+  // Give the producer time to splice the second track into the ring.
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (decoder.HasQueuedNext() && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  ASSERT_FALSE(decoder.HasQueuedNext());
+
+  ASSERT_TRUE(decoder.Seek(1000));
+  EXPECT_EQ(decoder.PositionFrames(), 1000u);
+  EXPECT_EQ(decoder.TotalFrames(), kFirst);
+  EXPECT_FALSE(decoder.TakeTrackChange());
+
+  const std::vector<int32_t> samples = Drain(decoder);
+  ASSERT_EQ(samples.size(), (kFirst - 1000 + kSecond) * kChannels);
+  ExpectTrack(samples, 0, kFirst - 1000, 1000 * kChannels);
+  ExpectTrack(samples, kFirst - 1000, kSecond, 1 << 24);
+  EXPECT_TRUE(decoder.TakeTrackChange());
+}
+
+}  // namespace
+}  // namespace audioengine
@@ -0,0 +1,193 @@
+#include "AudioEngineCore/LevelMeter.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "AudioEngineCore/AllocationCounter.h"
+#include "AudioEngineCore/SeqLock.h"
+#include "TestSources.h"
+
+namespace audioengine {
+namespace {
+
+using testing::Sine;
+
+constexpr double kPi = 3.14159265358979323846;
+constexpr uint32_t kRate = 48000;
+
+// `seconds` of a sine, scaled by `amplitudes[ch]` in channel ch.
+std::vector<float> Tone(const std::vector<float>& amplitudes, double seconds,
+                        double frequency = 997.0, double phase = 0.0) {
+  const uint32_t channels = static_cast<uint32_t>(amplitudes.size());
+  const size_t frames = static_cast<size_t>(seconds * kRate);
+  std::vector<float> samples = Sine(channels, frames, kRate, frequency, 1.0, phase);
+  for (size_t i = 0; i < samples.size(); ++i) samples[i] *= amplitudes[i % channels];
+  return samples;
+}
+
+// Feeds `samples` in 10 ms render blocks.
+void Meter(LevelMeter& meter, const std::vector<float>& samples, uint32_t channels) {
+  const size_t frames = samples.size() / channels;
+  for (size_t at = 0; at < frames; at += 480) {
+    meter.Process(samples.data() + at * channels, std::min<size_t>(480, frames - at));
+  }
+}
+
+TEST(LevelMeterTest, SineReadsPeakRmsAndTruePeak) {
+  LevelMeter meter;
+  ASSERT_TRUE(meter.Configure({kRate, 2, 32, true}));
+  // -6 and -20 dBFS, long enough for the RMS window to settle.
+  Meter(meter, Tone({0.5f, 0.1f}, 2.0), 2);
+  const LevelMeterReading reading = meter.Read();
+  EXPECT_EQ(reading.channels, 2u);
+  EXPECT_EQ(reading.sequence, 200u);
+  EXPECT_NEAR(reading.peakDb[0], -6.02f, 0.05f);
+  EXPECT_NEAR(reading.peakDb[1], -20.0f, 0.05f);
+  EXPECT_NEAR(reading.peakHoldDb[0], -6.02f, 0.05f);
+  EXPECT_NEAR(reading.rmsDb[0], -9.03f, 0.05f);
+  EXPECT_NEAR(reading.rmsDb[1], -23.01f, 0.05f);
+  EXPECT_NEAR(reading.truePeakDb[0], -6.02f, 0.05f);
+  EXPECT_NEAR(reading.maxTruePeakDb[1], -20.0f, 0.05f);
+  EXPECT_EQ(reading.peakDb[2], LevelMeter::kFloorDb);
+}
+
+TEST(LevelMeterTest, MeasuresIntegerOutput) {
+  LevelMeter meter;
+  ASSERT_TRUE(meter.Configure({kRate, 2, 16, false}));
+  const std::vector<float> sine = Tone({0.5f, 0.5f}, 2.0);
+  std::vector<int16_t> samples(sine.size());
+  for (size_t i = 0; i < sine.size(); ++i) {
+    samples[i] = static_cast<int16_t>(std::lround(sine[i] * 32768.0f));
+  }
+  for (size_t at = 0; at < samples.size() / 2; at += 441) {
+    meter.Process(samples.data() + at * 2, std::min<size_t>(441, samples.size() / 2 - at));
+  }
+  EXPECT_NEAR(meter.Read().peakDb[1], -6.02f, 0.05f);
+  EXPECT_NEAR(meter.Read().rmsDb[1], -9.03f, 0.05f);
+}
+
+TEST(LevelMeterTest, TruePeakSeesBetweenSamples) {
+  // A quarter-rate sine sampled 45 degrees off its crests: every sample is
+  // at -3 dB of the real peak.
+  LevelMeter meter;
+  ASSERT_TRUE(meter.Configure({kRate, 1, 32, true}));
+  Meter(meter, Tone({0.9f}, 0.5, kRate / 4.0, kPi / 4.0), 1);
+  const LevelMeterReading reading = meter.Read();
+  EXPECT_NEAR(reading.peakDb[0], 20.0f * std::log10(0.9f) - 3.01f, 0.05f);
+  EXPECT_NEAR(reading.truePeakDb[0], 20.0f * std::log10(0.9f), 0.3f);
+}
+
+TEST(LevelMeterTest, PeakHoldsThenDecays) {
+  LevelMeter meter;
+  ASSERT_TRUE(meter.Configure({kRate, 1, 32, true}));
+  LevelMeter::Options options;
+  options.holdMs = 1500.0;
+  options.decayDbPerSecond = 20.0;
+  options.truePeak = false;
+  meter.SetOptions(options);
+  Meter(meter, Tone({1.0f}, 0.1), 1);
+  EXPECT_NEAR(meter.Read().peakDb[0], 0.0f, 0.05f);
+
+  // One second of silence: the peak falls 20 dB, the hold stays.
+  Meter(meter, std::vector<float>(kRate, 0.0f), 1);
+  LevelMeterReading reading = meter.Read();
+  EXPECT_NEAR(reading.peakDb[0], -20.0f, 0.2f);
+  EXPECT_NEAR(reading.peakHoldDb[0], 0.0f, 0.05f);
+  // The 300 ms RMS window has let go by 10 / ln 10 * 1000 / 300 = 14.5 dB.
+  EXPECT_LT(reading.rmsDb[0], -17.0f);
+  EXPECT_EQ(reading.truePeakDb[0], LevelMeter::kFloorDb);
+
+  // Another second: the hold ran out 1.5 s after the loudest chunk of the
+  // burst and has fallen about 10 dB since.
+  Meter(meter, std::vector<float>(kRate, 0.0f), 1);
+  reading = meter.Read();
+  EXPECT_NEAR(reading.peakDb[0], -40.0f, 0.3f);
+  EXPECT_NEAR(reading.peakHoldDb[0], -10.0f, 1.0f);
+
+  meter.Reset();
+  reading = meter.Read();
+  EXPECT_EQ(reading.peakDb[0], LevelMeter::kFloorDb);
+  EXPECT_EQ(reading.peakHoldDb[0], LevelMeter::kFloorDb);
+}
+
+TEST(LevelMeterTest, EveryIsaAndLayoutMatchesScalar) {
+  const KernelIsa saved = ActiveKernelIsa();
+  for (uint32_t channels = 1; channels <= LevelMeter::kMaxChannels; ++channels) {
+    std::vector<float> amplitudes;
+    for (uint32_t ch = 0; ch < channels; ++ch) amplitudes.push_back(0.9f / (ch + 1));
+    // An odd length, so the last block ends inside a lane period.
+    std::vector<float> samples = Tone(amplitudes, 0.2);
+    samples.resize(samples.size() - 3 * channels);
+    LevelMeterReading reference{};
+    bool haveReference = false;
+    for (const KernelIsa isa :
+         {KernelIsa::kScalar, KernelIsa::kSse2, KernelIsa::kAvx2, KernelIsa::kNeon}) {
+      if (!SetKernelIsa(isa)) continue;
+      LevelMeter meter;
+      ASSERT_TRUE(meter.Configure({kRate, channels, 32, true}));
+      Meter(meter, samples, channels);
+      const LevelMeterReading reading = meter.Read();
+      for (uint32_t ch = 0; ch < channels; ++ch) {
+        EXPECT_NEAR(reading.peakDb[ch], 20.0f * std::log10(amplitudes[ch]), 0.05f)
+            << channels << "ch " << KernelIsaName(isa);
+        if (haveReference) {
+          EXPECT_NEAR(reading.rmsDb[ch], reference.rmsDb[ch], 1e-3f)
+              << channels << "ch " << KernelIsaName(isa);
+        }
+      }
+      if (!haveReference) reference = reading;
+      haveReference = true;
+    }
+  }
+  SetKernelIsa(saved);
+  EXPECT_FALSE(LevelMeter().Configure({kRate, 9, 32, true}));
+}
+
+TEST(LevelMeterTest, ProcessDoesNotAllocate) {
+  LevelMeter meter;
+  ASSERT_TRUE(meter.Configure({kRate, 6, 16, false}));
+  std::vector<int16_t> block(480 * 6, 1000);
+  const uint64_t before = debug::ThreadAllocationCount();
+  for (int i = 0; i < 100; ++i) meter.Process(block.data(), 480);
+  meter.Read();
+  EXPECT_EQ(debug::ThreadAllocationCount(), before);
+}
+
+// Every word of each stored value is the same; a reader must never see a
+// mix of two stores.
+TEST(SeqLockTest, ReadersNeverSeeATornValue) {
+  struct Value {
+    uint64_t a;
+    uint64_t b[15];
+  };
+  SeqLock<Value> lock;
+  std::atomic<bool> done{false};
+  std::atomic<uint64_t> torn{0};
+  std::thread reader([&] {
+    while (!done.load()) {
+      const Value value = lock.Load();
+      for (uint64_t b : value.b) {
+        if (b != value.a) torn.fetch_add(1);
+      }
+    }
+  });
+  for (uint64_t i = 1; i <= 200000; ++i) {
+    Value value;
+    value.a = i;
+    std::fill(std::begin(value.b), std::end(value.b), i);
+    lock.Store(value);
+  }
+  done.store(true);
+  reader.join();
+  EXPECT_EQ(torn.load(), 0u);
+  EXPECT_EQ(lock.Load().a, 200000u);
+}
+
+}  // namespace
+}  // namespace audioengine
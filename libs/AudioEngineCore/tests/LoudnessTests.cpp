@@ -0,0 +1,206 @@
+#include "AudioEngineCore/LoudnessMeter.h"
+#include "AudioEngineCore/LoudnessScanner.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cmath>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "TestCache.h"
+#include "TestSources.h"
+
+namespace audioengine {
+namespace {
+
+using testing::ToneSource;
+
+float DbToAmplitude(double db) { return static_cast<float>(std::pow(10.0, db / 20.0)); }
+
+void Measure(PcmSource* source, LoudnessMeter* meter) {
+  const PcmFormat format = source->Format();
+  meter->Configure(format.sampleRate, format.channels);
+  std::vector<float> buffer(1024 * format.channels);
+  size_t got = 0;
+  while ((got = source->ReadFrames(reinterpret_cast<uint8_t*>(buffer.data()), 1024)) > 0) {
+    meter->Process(buffer.data(), got);
+  }
+}
+
+using CacheCleanup = testing::CacheCleanup<LoudnessScanner>;
+
+TEST(LoudnessMeterTest, MeasuresReferenceTone) {
+  // EBU Tech 3341 case 1: stereo 1 kHz at -23 dBFS reads -23 LUFS.
+  ToneSource tone(48000, 2, 997.0, {{48000 * 20, DbToAmplitude(-23.0)}});
+  LoudnessMeter meter;
+  Measure(&tone, &meter);
+  EXPECT_NEAR(meter.IntegratedLufs(), -23.0, 0.1);
+  EXPECT_NEAR(meter.TruePeak(), DbToAmplitude(-23.0), DbToAmplitude(-23.0) * 0.01);
+  EXPECT_NEAR(meter.LoudnessRangeLu(), 0.0, 0.1);
+  EXPECT_EQ(meter.FramesProcessed(), 48000u * 20);
+}
+
+TEST(LoudnessMeterTest, GatesSilenceAtAnyRate) {
+  // Silence is under the absolute gate and does not pull the value down.
+  ToneSource tone(44100, 2, 997.0,
+                  {{44100 * 10, DbToAmplitude(-23.0)}, {44100 * 10, 0.0f}});
+  LoudnessMeter meter;
+  Measure(&tone, &meter);
+  EXPECT_NEAR(meter.IntegratedLufs(), -23.0, 0.1);
+
+  ToneSource silence(48000, 1, 997.0, {{48000 * 5, 0.0f}});
+  Measure(&silence, &meter);
+  EXPECT_TRUE(std::isinf(meter.IntegratedLufs()));
+  EXPECT_EQ(meter.LoudnessRangeLu(), 0.0);
+}
+
+TEST(LoudnessMeterTest, MeasuresLoudnessRange) {
+  // EBU Tech 3342 case 1: 20 s at -20 dBFS then 20 s at -30 dBFS is 10 LU.
+  ToneSource tone(48000, 2, 1000.0,
+                  {{48000 * 20, DbToAmplitude(-20.0)}, {48000 * 20, DbToAmplitude(-30.0)}});
+  LoudnessMeter meter;
+  Measure(&tone, &meter);
+  EXPECT_NEAR(meter.LoudnessRangeLu(), 10.0, 1.0);
+  // The -30 part is inside the 10 LU relative gate, so it counts.
+  const double expected =
+      LoudnessOfEnergy((std::pow(10.0, (-20.0 + 0.691) / 10.0) +
+                        std::pow(10.0, (-30.0 + 0.691) / 10.0)) / 2.0);
+  EXPECT_NEAR(meter.IntegratedLufs(), expected, 0.1);
+}
+
+TEST(LoudnessMeterTest, HistogramsMergeIntoAlbumValues) {
+  ToneSource loud(48000, 2, 997.0, {{48000 * 10, DbToAmplitude(-20.0)}});
+  ToneSource quiet(48000, 2, 997.0, {{48000 * 10, DbToAmplitude(-26.0)}});
+  LoudnessMeter meter;
+  Measure(&loud, &meter);
+  LoudnessHistogram album = meter.MomentaryBlocks();
+  Measure(&quiet, &meter);
+  album.Merge(meter.MomentaryBlocks());
+
+  const double expected =
+      LoudnessOfEnergy((std::pow(10.0, (-20.0 + 0.691) / 10.0) +
+                        std::pow(10.0, (-26.0 + 0.691) / 10.0)) / 2.0);
+  EXPECT_NEAR(album.IntegratedLufs(), expected, 0.1);
+}
+
+TEST(LoudnessScannerTest, ScansAlbumsAndResumesFromCache) {
+  const std::string dir = ::testing::TempDir();
+  const std::map<std::string, float> levels = {
+      {"a1.flac", DbToAmplitude(-20.0)}, {"a2.flac", DbToAmplitude(-26.0)},
+      {"a3.flac", DbToAmplitude(-20.0)}, {"b1.flac", DbToAmplitude(-14.0)},
+      {"b2.flac", DbToAmplitude(-14.0)}, {"loose.flac", DbToAmplitude(-23.0)},
+  };
+  std::vector<LoudnessScanner::Item> items;
+  std::vector<SeekIndex::Key> keys;
+  for (const auto& [name, level] : levels) {
+    LoudnessScanner::Item item;
+    item.key = {dir + "loudness-" + name, 1000 + name.size(), 1700000000};
+    item.album = name[0] == 'a' ? "Album A" : name[0] == 'b' ? "Album B" : "";
+    items.push_back(item);
+    keys.push_back(item.key);
+  }
+  CacheCleanup cleanup(keys);
+
+  std::atomic<int> opens{0};
+  auto open = [&](const std::string& path) -> std::unique_ptr<PcmSource> {
+    ++opens;
+    const std::string name = path.substr(path.find("loudness-") + 9);
+    return std::make_unique<ToneSource>(
+        48000, 2, 997.0,
+        std::vector<std::pair<uint64_t, float>>{{48000 * 4, levels.at(name)}});
+  };
+
+  {
+    LoudnessScanner scanner(dir, open, 3);
+    EXPECT_EQ(scanner.WorkerCount(), 3u);
+    scanner.Enqueue(items);
+    scanner.Enqueue(items);  // duplicates are ignored
+    scanner.WaitIdle();
+    EXPECT_EQ(opens.load(), 6);
+
+    TrackLoudness track;
+    ASSERT_TRUE(scanner.Track(dir + "loudness-loose.flac", &track));
+    EXPECT_NEAR(track.integratedLufs, -23.0, 0.1);
+    EXPECT_EQ(track.frames, 48000u * 4);
+    EXPECT_NEAR(*ReplayGainFromLoudness(track, nullptr).trackGainDb, 5.0, 0.1);
+
+    AlbumLoudness album;
+    ASSERT_TRUE(scanner.Album("Album B", &album));
+    EXPECT_EQ(album.tracks, 2u);
+    EXPECT_NEAR(album.integratedLufs, -14.0, 0.1);
+    ASSERT_TRUE(scanner.AlbumOf(dir + "loudness-a2.flac", &album));
+    EXPECT_EQ(album.tracks, 3u);
+    const double expected =
+        LoudnessOfEnergy((2.0 * std::pow(10.0, (-20.0 + 0.691) / 10.0) +
+                          std::pow(10.0, (-26.0 + 0.691) / 10.0)) / 3.0);
+    EXPECT_NEAR(album.integratedLufs, expected, 0.1);
+    EXPECT_NEAR(album.truePeak, DbToAmplitude(-20.0), 0.01);
+
+    const LoudnessScanner::Stats stats = scanner.GetStats();
+    EXPECT_EQ(stats.tracksScanned, 6u);
+    EXPECT_EQ(stats.tracksCached, 0u);
+    EXPECT_EQ(stats.tracksPending, 0u);
+    EXPECT_NEAR(stats.audioSeconds, 24.0, 1e-9);
+    EXPECT_GT(stats.TracksPerSecondPerCore(), 0.0);
+    EXPECT_GT(stats.RealtimeFactor(), 1.0);
+  }
+
+  // A new session picks every result up from the cache without decoding.
+  LoudnessScanner resumed(dir, open, 2);
+  TrackLoudness cached;
+  EXPECT_TRUE(resumed.LoadCached(items[0].key, &cached));
+  resumed.Enqueue(items);
+  resumed.WaitIdle();
+  EXPECT_EQ(opens.load(), 6);
+  EXPECT_EQ(resumed.GetStats().tracksCached, 6u);
+  AlbumLoudness album;
+  ASSERT_TRUE(resumed.Album("Album A", &album));
+  EXPECT_EQ(album.tracks, 3u);
+
+  // A changed file is measured again.
+  std::vector<LoudnessScanner::Item> changed = {items[0]};
+  changed[0].key.mtimeSeconds += 1;
+  CacheCleanup changedCleanup({changed[0].key});
+  LoudnessScanner rescan(dir, open, 1);
+  rescan.Enqueue(changed);
+  rescan.WaitIdle();
+  EXPECT_EQ(opens.load(), 7);
+}
+
+TEST(LoudnessScannerTest, CompletesAlbumsPastFailedTracks) {
+  const std::string dir = ::testing::TempDir();
+  std::vector<LoudnessScanner::Item> items(3);
+  std::vector<SeekIndex::Key> keys;
+  for (size_t i = 0; i < items.size(); ++i) {
+    items[i].key = {dir + "loudness-fail-" + std::to_string(i), 10, 1700000001};
+    items[i].album = "Album";
+    keys.push_back(items[i].key);
+  }
+  CacheCleanup cleanup(keys);
+
+  LoudnessScanner scanner(dir, [&](const std::string& path) -> std::unique_ptr<PcmSource> {
+    if (path == items[1].key.path) return nullptr;
+    return std::make_unique<ToneSource>(
+        44100, 1, 440.0, std::vector<std::pair<uint64_t, float>>{{44100 * 3, 0.25f}});
+  }, 2);
+  scanner.Enqueue(items);
+  scanner.WaitIdle();
+
+  TrackLoudness track;
+  EXPECT_FALSE(scanner.Track(items[1].key.path, &track));
+  EXPECT_TRUE(scanner.Track(items[2].key.path, &track));
+  AlbumLoudness album;
+  ASSERT_TRUE(scanner.Album("Album", &album));
+  EXPECT_EQ(album.tracks, 2u);
+  EXPECT_NEAR(album.integratedLufs, track.integratedLufs, 0.05);
+  const LoudnessScanner::Stats stats = scanner.GetStats();
+  EXPECT_EQ(stats.tracksFailed, 1u);
+  EXPECT_EQ(stats.tracksScanned, 2u);
+}
+
+}  // namespace
+}  // namespace audioengine
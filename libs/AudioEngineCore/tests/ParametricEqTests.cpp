@@ -0,0 +1,206 @@
+#include "AudioEngineCore/ParametricEq.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+#include "AudioEngineCore/AllocationCounter.h"
+#include "AudioEngineCore/SampleKernels.h"
+#include "TestSources.h"
+
+namespace audioengine {
+namespace {
+
+using testing::Noise;
+using testing::Sine;
+
+constexpr uint32_t kRate = 48000;
+
+void RunEq(ParametricEq& eq, std::vector<float>& samples, uint32_t channels,
+           size_t block = 480) {
+  const size_t frames = samples.size() / channels;
+  for (size_t at = 0; at < frames; at += block) {
+    eq.Process(samples.data() + at * channels, std::min(block, frames - at));
+  }
+}
+
+// Steady-state gain in dB of `bands` at `frequency`, from a tone's peak
+// after the filters settle.
+double MeasureGainDb(const std::vector<EqBand>& bands, double frequency) {
+  ParametricEq eq;
+  eq.SetBands(bands);
+  eq.Configure(kRate, 1);
+  std::vector<float> samples = Sine(1, kRate, kRate, frequency, 0.01);
+  RunEq(eq, samples, 1);
+  float peak = 0.0f;
+  for (size_t i = kRate / 2; i < samples.size(); ++i) {
+    peak = std::max(peak, std::fabs(samples[i]));
+  }
+  return 20.0 * std::log10(peak / 0.01);
+}
+
+EqBand Band(EqBandType type, double frequency, double gainDb, double q = 0.7071) {
+  EqBand band;
+  band.type = type;
+  band.frequencyHz = frequency;
+  band.gainDb = gainDb;
+  band.q = q;
+  return band;
+}
+
+TEST(ParametricEqTest, FlatBandsLeaveSignalUntouched) {
+  ParametricEq eq;
+  EqBand disabled = Band(EqBandType::kLowPass, 500.0, 0.0);
+  disabled.enabled = false;
+  eq.SetBands({Band(EqBandType::kPeaking, 1000.0, 0.0), disabled,
+               Band(EqBandType::kHighShelf, 8000.0, 0.001)});
+  ASSERT_TRUE(eq.Configure(kRate, 2));
+  const std::vector<float> input = Noise(4800 * 2, 1, 0.25f);
+  std::vector<float> output = input;
+  RunEq(eq, output, 2);
+  EXPECT_EQ(output, input);
+
+  EXPECT_FALSE(eq.Configure(kRate, ParametricEq::kMaxChannels + 1));
+  EXPECT_FALSE(eq.IsConfigured());
+  EXPECT_FALSE(eq.SetBands(std::vector<EqBand>(ParametricEq::kMaxBands + 1)));
+  EXPECT_FALSE(eq.SetBand(3, EqBand{}));
+  EXPECT_EQ(eq.Bands().size(), 3u);
+}
+
+TEST(ParametricEqTest, MatchesDesignedResponse) {
+  const std::vector<EqBand> peak = {Band(EqBandType::kPeaking, 1000.0, 6.0, 1.0)};
+  EXPECT_NEAR(MeasureGainDb(peak, 1000.0), 6.0, 0.05);
+  EXPECT_NEAR(MeasureGainDb(peak, 100.0), 0.0, 0.2);
+  EXPECT_NEAR(MeasureGainDb(peak, 10000.0), 0.0, 0.2);
+
+  const std::vector<EqBand> shelves = {Band(EqBandType::kLowShelf, 100.0, -9.0),
+                                       Band(EqBandType::kHighShelf, 8000.0, 4.0)};
+  EXPECT_NEAR(MeasureGainDb(shelves, 25.0), -9.0, 0.3);
+  EXPECT_NEAR(MeasureGainDb(shelves, 1000.0), 0.0, 0.3);
+  EXPECT_NEAR(MeasureGainDb(shelves, 20000.0), 4.0, 0.3);
+
+  // Second order: 12 dB per octave, -3 dB at the corner.
+  const std::vector<EqBand> highPass = {Band(EqBandType::kHighPass, 1000.0, 0.0)};
+  EXPECT_NEAR(MeasureGainDb(highPass, 1000.0), -3.0, 0.1);
+  EXPECT_LT(MeasureGainDb(highPass, 125.0), -35.0);
+  const std::vector<EqBand> lowPass = {Band(EqBandType::kLowPass, 1000.0, 0.0)};
+  EXPECT_NEAR(MeasureGainDb(lowPass, 1000.0), -3.0, 0.1);
+  EXPECT_NEAR(MeasureGainDb(lowPass, 100.0), 0.0, 0.1);
+}
+
+TEST(ParametricEqTest, GraphicBandsSpanTheAudioBand) {
+  EXPECT_TRUE(GraphicEqBands(std::vector<double>(9, 0.0)).empty());
+  EXPECT_TRUE(GraphicEqBands(std::vector<double>(33, 0.0)).empty());
+
+  const std::vector<EqBand> octaves = GraphicEqBands(std::vector<double>(10, 3.0));
+  ASSERT_EQ(octaves.size(), 10u);
+  EXPECT_GT(octaves.front().frequencyHz, 20.0);
+  EXPECT_LT(octaves.back().frequencyHz, 20000.0);
+  EXPECT_NEAR(octaves[5].frequencyHz / octaves[4].frequencyHz, 2.0, 0.01);
+
+  const std::vector<EqBand> thirds = GraphicEqBands(std::vector<double>(31, 3.0));
+  ASSERT_EQ(thirds.size(), 31u);
+  EXPECT_NEAR(thirds[1].frequencyHz / thirds[0].frequencyHz, std::pow(2.0, 1.0 / 3.0),
+              0.02);
+  // Neighbours overlap enough that equal gains give a nearly flat lift.
+  EXPECT_NEAR(MeasureGainDb(octaves, 1000.0), MeasureGainDb(octaves, 1500.0), 1.0);
+  EXPECT_NEAR(MeasureGainDb(thirds, 1000.0), MeasureGainDb(thirds, 1150.0), 1.0);
+}
+
+TEST(ParametricEqTest, VectorKernelsMatchScalar) {
+  const KernelIsa saved = ActiveKernelIsa();
+  std::vector<double> gains(ParametricEq::kMaxBands);
+  for (size_t i = 0; i < gains.size(); ++i) gains[i] = (i % 2 ? 4.0 : -3.0);
+  const std::vector<EqBand> bands = GraphicEqBands(gains);
+  for (const uint32_t channels : {1u, 2u, 3u, 6u, 8u}) {
+    const std::vector<float> input = Noise(4800 * channels, channels, 0.25f);
+    const auto run = [&] {
+      ParametricEq eq;
+      eq.Configure(kRate, channels);
+      std::vector<float> samples = input;
+      RunEq(eq, samples, channels, 256);
+      // A change mid-stream exercises the ramp as well.
+      eq.SetBand(7, Band(EqBandType::kHighPass, 60.0, 0.0));
+      RunEq(eq, samples, channels, 333);
+      return samples;
+    };
+    ASSERT_TRUE(SetKernelIsa(KernelIsa::kScalar));
+    const std::vector<float> reference = run();
+    for (const KernelIsa isa : {KernelIsa::kSse2, KernelIsa::kAvx2, KernelIsa::kNeon}) {
+      if (!SetKernelIsa(isa)) continue;
+      const std::vector<float> vector = run();
+      for (size_t i = 0; i < vector.size(); ++i) {
+        ASSERT_NEAR(vector[i], reference[i], 1e-5f)
+            << KernelIsaName(isa) << " " << channels << " " << i;
+      }
+    }
+  }
+  SetKernelIsa(saved);
+}
+
+TEST(ParametricEqTest, ChangesGlideWithoutClicks) {
+  // A low tone under a high shelf: the shelf barely changes its level, so
+  // anything sharp in the output is the switch itself. Swapping the
+  // coefficients in one go puts a curvature of about 0.4 into it.
+  constexpr double kFrequency = 100.0;
+  constexpr float kAmplitude = 0.5f;
+  const EqBand flat = Band(EqBandType::kHighShelf, 2000.0, 0.0);
+  const EqBand boost = Band(EqBandType::kHighShelf, 2000.0, 12.0);
+  ParametricEq eq;
+  eq.SetBands({flat});
+  eq.Configure(kRate, 1);
+  std::vector<float> samples = Sine(1, kRate, kRate, kFrequency, kAmplitude);
+  const size_t change = kRate / 2 + 17;
+  eq.Process(samples.data(), change);
+  eq.SetBand(0, boost);
+  const uint64_t before = debug::ThreadAllocationCount();
+  for (size_t at = change; at < samples.size(); at += 128) {
+    eq.Process(samples.data() + at, std::min<size_t>(128, samples.size() - at));
+  }
+  EXPECT_EQ(debug::ThreadAllocationCount(), before);
+
+  float curvature = 0.0f;
+  for (size_t i = change; i < samples.size(); ++i) {
+    curvature = std::max(curvature, std::fabs(samples[i] - 2.0f * samples[i - 1] +
+                                              samples[i - 2]));
+  }
+  EXPECT_LT(curvature, 0.005f);
+
+  const double expectedDb = MeasureGainDb({boost}, kFrequency);
+  float settled = 0.0f;
+  for (size_t i = samples.size() - 4800; i < samples.size(); ++i) {
+    settled = std::max(settled, std::fabs(samples[i]));
+  }
+  EXPECT_NEAR(20.0 * std::log10(settled / kAmplitude), expectedDb, 0.01);
+}
+
+TEST(ParametricEqTest, RenderSideNeverWaitsForUpdates) {
+  ParametricEq eq;
+  eq.SetBands(GraphicEqBands(std::vector<double>(16, 0.0)));
+  eq.Configure(kRate, 2);
+  std::atomic<bool> done{false};
+  std::thread ui([&] {
+    for (int i = 0; !done.load(); ++i) {
+      eq.SetBand(i % 16, Band(EqBandType::kPeaking, 100.0 + 50.0 * (i % 16),
+                              (i % 25) - 12.0, 1.4));
+    }
+  });
+  const std::vector<float> input = Noise(480 * 2, 3, 0.25f);
+  std::vector<float> samples(input.size());
+  const uint64_t before = debug::ThreadAllocationCount();
+  for (int block = 0; block < 2000; ++block) {
+    std::copy(input.begin(), input.end(), samples.begin());
+    eq.Process(samples.data(), 480);
+    for (float s : samples) ASSERT_TRUE(std::isfinite(s)) << block;
+  }
+  EXPECT_EQ(debug::ThreadAllocationCount(), before);
+  done.store(true);
+  ui.join();
+}
+
+}  // namespace
+}  // namespace audioengine
@@ -0,0 +1,90 @@
+#include "AudioEngineCore/PcmRingBuffer.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace audioengine {
+namespace {
+
+TEST(PcmRingBufferTest, MaintainsFifoAcrossWraps) {
+  PcmRingBuffer ring;
+  ring.Configure(sizeof(int32_t) * 2, 64);
+  ASSERT_EQ(ring.CapacityFrames(), 64u);
+
+  std::vector<int32_t> in(2 * 48);
+  for (size_t i = 0; i < in.size(); ++i) in[i] = static_cast<int32_t>(i);
+  EXPECT_EQ(ring.Write(reinterpret_cast<uint8_t*>(in.data()), 48), 48u);
+
+  std::vector<int32_t> out(2 * 40);
+  EXPECT_EQ(ring.Read(reinterpret_cast<uint8_t*>(out.data()), 40), 40u);
+  EXPECT_EQ(out, std::vector<int32_t>(in.begin(), in.begin() + 80));
+
+  // Second write wraps around the end of the storage.
+  std::vector<int32_t> more(2 * 48);
+  for (size_t i = 0; i < more.size(); ++i) more[i] = 1000 + static_cast<int32_t>(i);
+  EXPECT_EQ(ring.Write(reinterpret_cast<uint8_t*>(more.data()), 48), 48u);
+  EXPECT_EQ(ring.AvailableFrames(), 56u);
+
+  std::vector<int32_t> rest(2 * 56);
+  EXPECT_EQ(ring.Read(reinterpret_cast<uint8_t*>(rest.data()), 56), 56u);
+  std::vector<int32_t> expected(in.begin() + 80, in.end());
+  expected.insert(expected.end(), more.begin(), more.end());
+  EXPECT_EQ(rest, expected);
+}
+
+TEST(PcmRingBufferTest, WriteStopsWhenFull) {
+  PcmRingBuffer ring;
+  ring.Configure(4, 16);
+  std::vector<uint8_t> in(4 * 32, 0x5A);
+  EXPECT_EQ(ring.Write(in.data(), 32), 16u);
+  EXPECT_EQ(ring.FreeFrames(), 0u);
+  EXPECT_EQ(ring.WritableRegions().TotalFrames(), 0u);
+}
+
+TEST(PcmRingBufferTest, DiscardTurnsOverlappingReadIntoSilence) {
+  PcmRingBuffer ring;
+  ring.Configure(4, 16);
+  std::vector<uint8_t> in(4 * 8, 0x7F);
+  ring.Write(in.data(), 8);
+
+  PcmRingBuffer::Regions regions = ring.ReadableRegions();
+  ring.Discard();
+  EXPECT_FALSE(ring.CommitRead(regions, regions.TotalFrames()));
+  EXPECT_EQ(ring.AvailableFrames(), 0u);
+  EXPECT_EQ(ring.FramesRead(), 8u);
+}
+
+TEST(PcmRingBufferTest, ConcurrentProducerConsumerPreservesOrder) {
+  PcmRingBuffer ring;
+  ring.Configure(sizeof(uint32_t), 256);
+  constexpr uint32_t kTotal = 200000;
+
+  std::thread producer([&] {
+    uint32_t next = 0;
+    while (next < kTotal) {
+      PcmRingBuffer::Regions regions = ring.WritableRegions();
+      auto* dst = reinterpret_cast<uint32_t*>(regions.first.data);
+      size_t n = 0;
+      while (n < regions.first.frames && next < kTotal) dst[n++] = next++;
+      ring.CommitWrite(n);
+      if (n == 0) std::this_thread::yield();
+    }
+  });
+
+  uint32_t expected = 0;
+  uint32_t chunk[37];
+  while (expected < kTotal) {
+    const size_t got = ring.Read(reinterpret_cast<uint8_t*>(chunk), 37);
+    for (size_t i = 0; i < got; ++i) {
+      ASSERT_EQ(chunk[i], expected++);
+    }
+    if (got == 0) std::this_thread::yield();
+  }
+  producer.join();
+}
+
+}  // namespace
+}  // namespace audioengine
@@ -0,0 +1,192 @@
+#include "AudioEngineCore/PrebufferedSource.h"
+#include "AudioEngineCore/StreamingDecoder.h"
+#include "AudioEngineCore/TrackPreloader.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "TestSources.h"
+
+namespace audioengine {
+namespace {
+
+using testing::CountingSource;
+
+constexpr uint32_t kChannels = 2;
+
+struct Track {
+  std::string path;
+  std::unique_ptr<PcmSource> source;
+};
+
+// Checks `got` frames read into `block` against CountingSource output from
+// `firstFrame` on.
+void ExpectFrames(const std::vector<int32_t>& block, size_t got,
+                  uint64_t firstFrame) {
+  for (size_t i = 0; i < got; ++i) {
+    for (uint32_t ch = 0; ch < kChannels; ++ch) {
+      if (block[i * kChannels + ch] !=
+          CountingSource::SampleAt(firstFrame + i, ch, kChannels)) {
+        FAIL() << "frame " << firstFrame + i << " channel " << ch;
+      }
+    }
+  }
+}
+
+TEST(PrebufferedSourceTest, ReadsThroughBufferIntoInnerSource) {
+  PrebufferedSource source(std::make_unique<CountingSource>(44100, kChannels, 20000));
+  EXPECT_EQ(source.Fill(5000), 5000u);
+  EXPECT_EQ(source.TotalFrames(), 20000u);
+
+  // Reads straddling the end of the buffer continue seamlessly.
+  std::vector<int32_t> block(3000 * kChannels);
+  uint64_t frame = 0;
+  while (size_t got = source.ReadFrames(reinterpret_cast<uint8_t*>(block.data()), 3000)) {
+    ExpectFrames(block, got, frame);
+    frame += got;
+  }
+  EXPECT_EQ(frame, 20000u);
+}
+
+TEST(PrebufferedSourceTest, FillStopsAtEndOfShortTrack) {
+  PrebufferedSource source(std::make_unique<CountingSource>(44100, kChannels, 1234));
+  EXPECT_EQ(source.Fill(44100), 1234u);
+  std::vector<int32_t> block(4096 * kChannels);
+  EXPECT_EQ(source.ReadFrames(reinterpret_cast<uint8_t*>(block.data()), 4096), 1234u);
+  ExpectFrames(block, 1234, 0);
+  EXPECT_EQ(source.ReadFrames(reinterpret_cast<uint8_t*>(block.data()), 4096), 0u);
+}
+
+TEST(PrebufferedSourceTest, SeeksInsideAndOutsideBuffer) {
+  PrebufferedSource source(std::make_unique<CountingSource>(44100, kChannels, 20000));
+  source.Fill(5000);
+  std::vector<int32_t> block(100 * kChannels);
+
+  uint64_t landed = 0;
+  ASSERT_TRUE(source.SeekToFrame(4000, SeekMode::kFast, &landed));
+  EXPECT_EQ(landed, 4000u);
+  EXPECT_EQ(source.BufferedFrames(), 5000u);
+  ASSERT_EQ(source.ReadFrames(reinterpret_cast<uint8_t*>(block.data()), 100), 100u);
+  ExpectFrames(block, 100, 4000);
+
+  ASSERT_TRUE(source.SeekToFrame(12000, SeekMode::kAccurate, &landed));
+  EXPECT_EQ(landed, 12000u);
+  EXPECT_EQ(source.BufferedFrames(), 0u);
+  ASSERT_EQ(source.ReadFrames(reinterpret_cast<uint8_t*>(block.data()), 100), 100u);
+  ExpectFrames(block, 100, 12000);
+
+  // Once dropped, the head is read from the inner source again.
+  ASSERT_TRUE(source.SeekToFrame(10, SeekMode::kAccurate, &landed));
+  ASSERT_EQ(source.ReadFrames(reinterpret_cast<uint8_t*>(block.data()), 100), 100u);
+  ExpectFrames(block, 100, 10);
+}
+
+TEST(PrebufferedSourceTest, StreamingDecoderPrefillsFromBuffer) {
+  StreamingDecoder::Options options;
+  options.bufferSeconds = 0.5;
+  options.prefillSeconds = 0.25;
+  StreamingDecoder decoder(options);
+
+  // Every decode after the prebuffer stalls, so a prefill that had to decode
+  // would take far longer than the check below allows.
+  auto inner = std::make_unique<testing::StallingSource>(
+      44100, kChannels, 44100 * 4, 1, std::chrono::milliseconds(200));
+  auto source = std::make_unique<PrebufferedSource>(std::move(inner));
+  ASSERT_EQ(source->Fill(44100 / 2), 44100u / 2);
+
+  const auto start = std::chrono::steady_clock::now();
+  ASSERT_TRUE(decoder.Start(std::move(source)));
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(150));
+  EXPECT_GE(decoder.BufferedFrames(), 44100u / 4);
+
+  std::vector<int32_t> block(1024 * kChannels);
+  const size_t got = decoder.Read(reinterpret_cast<uint8_t*>(block.data()), 1024);
+  EXPECT_EQ(got, 1024u);
+  ExpectFrames(block, got, 0);
+  decoder.Stop();
+}
+
+bool OpenCounting(const std::string& path, uint64_t frames, Track* track) {
+  track->path = path;
+  track->source = std::make_unique<CountingSource>(44100, kChannels, frames);
+  return true;
+}
+
+TEST(TrackPreloaderTest, TakesPreloadedTrackByKey) {
+  TrackPreloader<Track> preloader;
+  preloader.Preload("b.flac", [](Track* track) {
+    return OpenCounting("b.flac", 100, track);
+  });
+
+  Track track;
+  EXPECT_FALSE(preloader.Take("c.flac", &track));
+  ASSERT_TRUE(preloader.Take("b.flac", &track));
+  EXPECT_EQ(track.path, "b.flac");
+  ASSERT_TRUE(track.source);
+  EXPECT_EQ(track.source->TotalFrames(), 100u);
+
+  // Taking hands the track over; a second take misses.
+  Track again;
+  EXPECT_FALSE(preloader.Take("b.flac", &again));
+}
+
+TEST(TrackPreloaderTest, TakeWaitsForJobInFlight) {
+  TrackPreloader<Track> preloader;
+  std::atomic<bool> started{false};
+  preloader.Preload("slow.flac", [&started](Track* track) {
+    started = true;
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    return OpenCounting("slow.flac", 10, track);
+  });
+  while (!started) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+  Track track;
+  ASSERT_TRUE(preloader.Take("slow.flac", &track));
+  EXPECT_EQ(track.path, "slow.flac");
+}
+
+TEST(TrackPreloaderTest, NewerRequestReplacesOlder) {
+  TrackPreloader<Track> preloader;
+  std::atomic<bool> release{false};
+  std::atomic<int> finished{0};
+  preloader.Preload("old.flac", [&](Track* track) {
+    while (!release) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    ++finished;
+    return OpenCounting("old.flac", 10, track);
+  });
+  preloader.Preload("new.flac", [&](Track* track) {
+    ++finished;
+    return OpenCounting("new.flac", 20, track);
+  });
+  release = true;
+
+  Track track;
+  ASSERT_TRUE(preloader.Take("new.flac", &track));
+  EXPECT_EQ(track.path, "new.flac");
+  EXPECT_FALSE(preloader.Take("old.flac", &track));
+}
+
+TEST(TrackPreloaderTest, FailedAndClearedJobsYieldNothing) {
+  TrackPreloader<Track> preloader;
+  preloader.Preload("broken.flac", [](Track*) { return false; });
+  Track track;
+  EXPECT_FALSE(preloader.Take("broken.flac", &track));
+
+  preloader.Preload("a.flac", [](Track* track) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    return OpenCounting("a.flac", 10, track);
+  });
+  preloader.Clear();
+  EXPECT_FALSE(preloader.Take("a.flac", &track));
+  EXPECT_FALSE(preloader.IsReady("a.flac"));
+}
+
+}  // namespace
+}  // namespace audioengine
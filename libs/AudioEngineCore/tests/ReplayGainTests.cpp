@@ -0,0 +1,203 @@
+#include "AudioEngineCore/ReplayGain.h"
+#include "AudioEngineCore/TruePeakLimiter.h"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "AudioEngineCore/AllocationCounter.h"
+
+namespace audioengine {
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+
+TagLookup Lookup(const std::map<std::string, std::string>& tags) {
+  return [&tags](const char* key) -> const char* {
+    const auto it = tags.find(key);
+    return it == tags.end() ? nullptr : it->second.c_str();
+  };
+}
+
+// Peak of the signal reconstructed at 16x, a stricter estimate than the
+// limiter's own 4x detector.
+float TruePeak(const std::vector<float>& samples, uint32_t channels) {
+  const size_t frames = samples.size() / channels;
+  float peak = 0.0f;
+  for (uint32_t ch = 0; ch < channels; ++ch) {
+    for (size_t f = 16; f + 16 < frames; ++f) {
+      for (int phase = 0; phase < 16; ++phase) {
+        const double t = phase / 16.0;
+        double acc = 0.0;
+        for (int k = -15; k <= 16; ++k) {
+          const double x = k - t;
+          const double sinc = x == 0.0 ? 1.0 : std::sin(kPi * x) / (kPi * x);
+          const double window = 0.5 + 0.5 * std::cos(kPi * x / 16.5);
+          acc += samples[(f + k) * channels + ch] * sinc * window;
+        }
+        peak = std::max(peak, static_cast<float>(std::fabs(acc)));
+      }
+    }
+  }
+  return peak;
+}
+
+TEST(ReplayGainTest, ParsesTagValues) {
+  double value = 0.0;
+  ASSERT_TRUE(ParseReplayGainValue("-7.25 dB", &value));
+  EXPECT_DOUBLE_EQ(value, -7.25);
+  ASSERT_TRUE(ParseReplayGainValue("+1.5", &value));
+  EXPECT_DOUBLE_EQ(value, 1.5);
+  ASSERT_TRUE(ParseReplayGainValue(" 0.988547 ", &value));
+  EXPECT_DOUBLE_EQ(value, 0.988547);
+  EXPECT_FALSE(ParseReplayGainValue("", &value));
+  EXPECT_FALSE(ParseReplayGainValue("loud", &value));
+  EXPECT_FALSE(ParseReplayGainValue("-3 dB extra", &value));
+
+  // R128 gains are Q7.8 relative to -23 LUFS; ReplayGain sits 5 dB higher.
+  ASSERT_TRUE(ParseR128Gain("-1792", &value));
+  EXPECT_DOUBLE_EQ(value, -2.0);
+  ASSERT_TRUE(ParseR128Gain("0", &value));
+  EXPECT_DOUBLE_EQ(value, 5.0);
+  EXPECT_FALSE(ParseR128Gain("1.5", &value));
+  EXPECT_FALSE(ParseR128Gain("40000", &value));
+}
+
+TEST(ReplayGainTest, ReadsTagsWithR128Fallback) {
+  const std::map<std::string, std::string> vorbis = {
+      {"REPLAYGAIN_TRACK_GAIN", "-6.00 dB"},
+      {"REPLAYGAIN_TRACK_PEAK", "0.5"},
+      {"R128_TRACK_GAIN", "-1792"},
+      {"R128_ALBUM_GAIN", "-2048"},
+  };
+  const ReplayGainTags tags = ReadReplayGainTags(Lookup(vorbis));
+  EXPECT_DOUBLE_EQ(*tags.trackGainDb, -6.0);
+  EXPECT_DOUBLE_EQ(*tags.albumGainDb, -3.0);
+  EXPECT_DOUBLE_EQ(*tags.trackPeak, 0.5);
+  EXPECT_FALSE(tags.albumPeak);
+
+  const std::map<std::string, std::string> none = {{"REPLAYGAIN_TRACK_PEAK", "0"}};
+  EXPECT_TRUE(ReadReplayGainTags(Lookup(none)).Empty());
+}
+
+TEST(ReplayGainTest, ResolvesModesAndPeakSafety) {
+  ReplayGainTags tags;
+  tags.trackGainDb = -6.0;
+  tags.albumGainDb = 6.0;
+  tags.trackPeak = 0.5;
+  tags.albumPeak = 0.9;
+
+  NormalizationGain off = ResolveNormalization(NormalizationMode::kOff, tags);
+  EXPECT_EQ(off.gain, 1.0f);
+  EXPECT_FALSE(off.mayClip);
+
+  NormalizationGain track = ResolveNormalization(NormalizationMode::kTrack, tags);
+  EXPECT_NEAR(track.gain, 0.501187f, 1e-5f);
+  EXPECT_FALSE(track.mayClip);
+  EXPECT_EQ(track.peakSafeGain, track.gain);
+
+  // +6 dB on a 0.9 peak overshoots a -1 dBTP ceiling.
+  NormalizationGain album = ResolveNormalization(NormalizationMode::kAlbum, tags);
+  EXPECT_NEAR(album.gain, 1.995262f, 1e-5f);
+  EXPECT_TRUE(album.mayClip);
+  EXPECT_NEAR(album.peakSafeGain * 0.9f, 0.891251f, 1e-5f);
+
+  // Preamp moves tagged tracks; album mode falls back to track values.
+  tags.albumGainDb.reset();
+  tags.albumPeak.reset();
+  album = ResolveNormalization(NormalizationMode::kAlbum, tags, 3.0);
+  EXPECT_NEAR(album.gain, 0.707946f, 1e-5f);
+
+  // Untagged tracks play at unity whatever the preamp.
+  EXPECT_EQ(ResolveNormalization(NormalizationMode::kTrack, ReplayGainTags{}, 6.0).gain,
+            1.0f);
+  // A positive gain without a peak tag may clip.
+  ReplayGainTags noPeak;
+  noPeak.trackGainDb = 2.0;
+  NormalizationGain hot = ResolveNormalization(NormalizationMode::kTrack, noPeak);
+  EXPECT_TRUE(hot.mayClip);
+  EXPECT_NEAR(hot.peakSafeGain, 0.891251f, 1e-5f);
+}
+
+TEST(TruePeakLimiterTest, QuietSignalIsDelayedUnchanged) {
+  TruePeakLimiter limiter;
+  limiter.Configure(48000, 2);
+  const uint32_t latency = limiter.LatencyFrames();
+  EXPECT_EQ(latency, 77u);  // 1.5 ms look-ahead plus the detector lag
+
+  std::vector<float> input(4800 * 2);
+  for (size_t i = 0; i < input.size(); ++i) {
+    input[i] = 0.5f * static_cast<float>(std::sin(0.01 * static_cast<double>(i)));
+  }
+  std::vector<float> output = input;
+  for (size_t at = 0; at < output.size(); at += 480 * 2) {
+    limiter.Process(output.data() + at, 480);
+  }
+  for (size_t i = 0; i < latency * 2; ++i) EXPECT_EQ(output[i], 0.0f);
+  for (size_t i = latency * 2; i < output.size(); ++i) {
+    ASSERT_EQ(output[i], input[i - latency * 2]) << i;
+  }
+  const TruePeakLimiter::Stats stats = limiter.GetStats();
+  EXPECT_EQ(stats.framesProcessed, 4800u);
+  EXPECT_EQ(stats.framesLimited, 0u);
+  EXPECT_EQ(stats.maxReductionDb, 0.0f);
+}
+
+TEST(TruePeakLimiterTest, HoldsInterSamplePeaksUnderCeiling) {
+  constexpr uint32_t kRate = 44100;
+  TruePeakLimiter limiter;
+  TruePeakLimiter::Options options;
+  options.ceilingDb = -1.0;
+  limiter.Configure(kRate, 2, options);
+
+  // A quarter-rate tone sampled off its peaks hides 3 dB between samples;
+  // with +6 dB of normalization on top the sample peak alone looks tame.
+  std::vector<float> samples(kRate * 2);
+  for (size_t f = 0; f < kRate; ++f) {
+    const double phase = 2.0 * kPi * (static_cast<double>(f) / 4.0) + kPi / 4.0;
+    const float x = 2.0f * 0.7f * static_cast<float>(std::sin(phase));
+    samples[f * 2] = x;
+    samples[f * 2 + 1] = 0.1f * x;
+  }
+  const uint64_t before = debug::ThreadAllocationCount();
+  for (size_t at = 0; at < samples.size(); at += 441 * 2) {
+    limiter.Process(samples.data() + at, 441);
+  }
+  EXPECT_EQ(debug::ThreadAllocationCount(), before);
+
+  const float ceiling = static_cast<float>(std::pow(10.0, -1.0 / 20.0));
+  EXPECT_LE(TruePeak(samples, 2), ceiling * 1.01f);
+  const TruePeakLimiter::Stats stats = limiter.GetStats();
+  EXPECT_GT(stats.framesLimited, kRate / 2);
+  EXPECT_NEAR(stats.maxReductionDb, 20.0 * std::log10(1.4 / ceiling), 0.5);
+  EXPECT_GT(stats.processNanos, 0u);
+  EXPECT_GT(stats.CpuLoad(kRate), 0.0);
+}
+
+TEST(TruePeakLimiterTest, CatchesTransientsWithinLookahead) {
+  constexpr uint32_t kRate = 48000;
+  TruePeakLimiter limiter;
+  limiter.Configure(kRate, 1);
+  const uint32_t latency = limiter.LatencyFrames();
+
+  // A click far over full scale after silence must be attenuated on the very
+  // frame it comes out, not after it.
+  std::vector<float> samples(2048, 0.0f);
+  samples[1000] = 3.0f;
+  samples[1001] = -3.0f;
+  limiter.Process(samples.data(), samples.size());
+  const float ceiling = static_cast<float>(std::pow(10.0, -1.0 / 20.0));
+  for (size_t i = 0; i < samples.size(); ++i) {
+    ASSERT_LE(std::fabs(samples[i]), ceiling) << i;
+  }
+  EXPECT_NE(samples[1000 + latency], 0.0f);
+  // A 4x detector can under-read wideband peaks that fall between its
+  // points; the ceiling's headroom absorbs that.
+  EXPECT_LE(TruePeak(samples, 1), ceiling * 1.035f);
+}
+
+}  // namespace
+}  // namespace audioengine
@@ -0,0 +1,184 @@
+#include "AudioEngineCore/Resampler.h"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <memory>
+#include <vector>
+
+#include "AudioEngineCore/AllocationCounter.h"
+#include "AudioEngineCore/SampleKernels.h"
+#include "TestSources.h"
+
+namespace audioengine {
+namespace {
+
+using testing::ConstantSource;
+using testing::ToneSource;
+
+constexpr double kPi = 3.14159265358979323846;
+constexpr ResamplerQuality kQualities[] = {
+    ResamplerQuality::kLow, ResamplerQuality::kMedium, ResamplerQuality::kHigh};
+
+std::vector<float> ReadAll(PcmSource& source, size_t block = 500) {
+  const uint32_t channels = source.Format().channels;
+  std::vector<float> out;
+  std::vector<float> buffer(block * channels);
+  while (const size_t got =
+             source.ReadFrames(reinterpret_cast<uint8_t*>(buffer.data()), block)) {
+    out.insert(out.end(), buffer.begin(), buffer.begin() + got * channels);
+  }
+  return out;
+}
+
+// RMS difference between channel 0 of `samples` and a sine at `rate`, away
+// from the edges the zero padding disturbs.
+double ToneError(const std::vector<float>& samples, uint32_t channels,
+                 uint32_t rate, double frequency, float amplitude) {
+  const size_t frames = samples.size() / channels;
+  double sum = 0.0;
+  size_t count = 0;
+  for (size_t f = 500; f + 500 < frames; ++f) {
+    const double want = amplitude * std::sin(2.0 * kPi * frequency * f / rate);
+    const double diff = samples[f * channels] - want;
+    sum += diff * diff;
+    ++count;
+  }
+  return std::sqrt(sum / count);
+}
+
+double Rms(const std::vector<float>& samples, size_t skip) {
+  double sum = 0.0;
+  for (size_t i = skip; i + skip < samples.size(); ++i) sum += samples[i] * samples[i];
+  return std::sqrt(sum / (samples.size() - 2 * skip));
+}
+
+TEST(ResamplerTest, ConvertsLengthAndLevel) {
+  ResamplingSource source(std::make_unique<ConstantSource>(44100, 2, 44100, 0.5f),
+                          48000, ResamplerQuality::kMedium);
+  EXPECT_EQ(source.Format().sampleRate, 48000u);
+  EXPECT_EQ(source.Format().channels, 2u);
+  EXPECT_EQ(source.TotalFrames(), 48000u);
+
+  std::vector<float> buffer(480 * 2);
+  std::vector<float> out;
+  out.reserve(48000 * 2);
+  const uint64_t before = debug::ThreadAllocationCount();
+  size_t total = 0;
+  while (const size_t got =
+             source.ReadFrames(reinterpret_cast<uint8_t*>(buffer.data()), 480)) {
+    EXPECT_EQ(debug::ThreadAllocationCount(), before);
+    out.insert(out.end(), buffer.begin(), buffer.begin() + got * 2);
+    total += got;
+  }
+  // One second in, one second out, flushed to the last frame.
+  EXPECT_EQ(total, 48000u);
+  for (size_t i = 200; i < out.size() - 200; ++i) ASSERT_NEAR(out[i], 0.5f, 1e-4f) << i;
+}
+
+TEST(ResamplerTest, TonesStayAlignedAndClean) {
+  // Output frame k sits at input time k * 44100 / 48000, so the converted
+  // tone must match an ideal one at the output rate, phase included.
+  const double limits[] = {3e-3, 3e-5, 3e-6};
+  for (int q = 0; q < 3; ++q) {
+    ResamplingSource up(std::make_unique<ToneSource>(
+                            44100, 1, 1000.0,
+                            std::vector<std::pair<uint64_t, float>>{{44100, 0.5f}}),
+                        48000, kQualities[q]);
+    EXPECT_LT(ToneError(ReadAll(up), 1, 48000, 1000.0, 0.5f), limits[q]) << q;
+
+    ResamplingSource down(std::make_unique<ToneSource>(
+                              48000, 2, 5000.0,
+                              std::vector<std::pair<uint64_t, float>>{{48000, 0.5f}}),
+                          44100, kQualities[q]);
+    EXPECT_LT(ToneError(ReadAll(down), 2, 44100, 5000.0, 0.5f), limits[q]) << q;
+  }
+}
+
+TEST(ResamplerTest, RejectsContentAboveTheOutputNyquist) {
+  // 30 kHz cannot exist at 44.1 kHz; it must not alias down.
+  const double limits[] = {1e-3, 2e-5, 2e-6};
+  for (int q = 0; q < 3; ++q) {
+    ResamplingSource source(std::make_unique<ToneSource>(
+                                96000, 1, 30000.0,
+                                std::vector<std::pair<uint64_t, float>>{{96000, 0.5f}}),
+                            44100, kQualities[q]);
+    EXPECT_LT(Rms(ReadAll(source), 500), limits[q]) << q;
+  }
+}
+
+TEST(ResamplerTest, EveryIsaMatchesScalar) {
+  const KernelIsa saved = ActiveKernelIsa();
+  const auto convert = [] {
+    ResamplingSource source(std::make_unique<ToneSource>(
+                                44100, 2, 3000.0,
+                                std::vector<std::pair<uint64_t, float>>{{20000, 0.9f}}),
+                            48000, ResamplerQuality::kHigh);
+    return ReadAll(source);
+  };
+  ASSERT_TRUE(SetKernelIsa(KernelIsa::kScalar));
+  const std::vector<float> reference = convert();
+  for (const KernelIsa isa : {KernelIsa::kSse2, KernelIsa::kAvx2, KernelIsa::kNeon}) {
+    if (!SetKernelIsa(isa)) continue;
+    const std::vector<float> vector = convert();
+    ASSERT_EQ(vector.size(), reference.size());
+    for (size_t i = 0; i < vector.size(); ++i) {
+      ASSERT_NEAR(vector[i], reference[i], 1e-5f) << KernelIsaName(isa) << " " << i;
+    }
+  }
+  SetKernelIsa(saved);
+}
+
+TEST(ResamplerTest, AccurateSeekMatchesLinearRead) {
+  const auto open = [] {
+    return std::make_unique<ResamplingSource>(
+        std::make_unique<ToneSource>(
+            44100, 2, 440.0, std::vector<std::pair<uint64_t, float>>{{44100, 0.7f}}),
+        48000, ResamplerQuality::kHigh);
+  };
+  auto linear = open();
+  const std::vector<float> reference = ReadAll(*linear);
+
+  auto seeking = open();
+  for (const uint64_t frame : {12345u, 777u, 30001u}) {
+    uint64_t landed = 0;
+    ASSERT_TRUE(seeking->SeekToFrame(frame, SeekMode::kAccurate, &landed));
+    EXPECT_EQ(landed, frame);
+    std::vector<float> buffer(256 * 2);
+    ASSERT_EQ(seeking->ReadFrames(reinterpret_cast<uint8_t*>(buffer.data()), 256), 256u);
+    for (size_t i = 0; i < buffer.size(); ++i) {
+      ASSERT_NEAR(buffer[i], reference[frame * 2 + i], 1e-6f) << frame << " " << i;
+    }
+  }
+
+  // Fast seeks land on the output grid at or before the target.
+  uint64_t landed = 0;
+  ASSERT_TRUE(seeking->SeekToFrame(24000, SeekMode::kFast, &landed));
+  EXPECT_LE(landed, 24000u);
+  EXPECT_GE(landed, 23998u);
+  EXPECT_EQ(landed + ReadAll(*seeking).size() / 2, reference.size() / 2);
+}
+
+TEST(ResamplerTest, RefusesFormatsItCannotConvert) {
+  PcmFormat format{44100, 2, 32, true};
+  EXPECT_TRUE(ResamplingSource::CanResample(format, 48000));
+  EXPECT_TRUE(ResamplingSource::CanResample(format, 96000));
+  EXPECT_FALSE(ResamplingSource::CanResample(format, 44100));
+  // 44101 is prime: 44101 phases.
+  EXPECT_FALSE(ResamplingSource::CanResample(format, 44101));
+  format.isFloat = false;
+  format.bitsPerSample = 16;
+  EXPECT_FALSE(ResamplingSource::CanResample(format, 48000));
+
+  PolyphaseResampler resampler;
+  ASSERT_TRUE(resampler.Configure(44100, 48000, 2, ResamplerQuality::kMedium));
+  EXPECT_EQ(resampler.InputStep(), 147u);
+  EXPECT_EQ(resampler.OutputStep(), 160u);
+  EXPECT_EQ(resampler.TapsPerPhase(), 48u);
+  ASSERT_TRUE(resampler.Configure(96000, 48000, 2, ResamplerQuality::kMedium));
+  // Downsampling stretches the filter over the input.
+  EXPECT_EQ(resampler.TapsPerPhase(), 96u);
+}
+
+}  // namespace
+}  // namespace audioengine
@@ -0,0 +1,205 @@
+#include "AudioEngineCore/SampleKernels.h"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace audioengine {
+namespace {
+
+constexpr SampleType kTypes[] = {SampleType::kS16, SampleType::kS24,
+                                 SampleType::kS32, SampleType::kF32,
+                                 SampleType::kF64};
+constexpr KernelIsa kIsas[] = {KernelIsa::kScalar, KernelIsa::kSse2,
+                               KernelIsa::kAvx2, KernelIsa::kNeon};
+
+bool IsFloat(SampleType type) {
+  return type == SampleType::kF32 || type == SampleType::kF64;
+}
+
+// One integer step of `type` in float units; zero for floats.
+double Step(SampleType type) {
+  switch (type) {
+    case SampleType::kS16: return 1.0 / 32768.0;
+    case SampleType::kS24: return 1.0 / 8388608.0;
+    case SampleType::kS32: return 1.0 / 2147483648.0;
+    default: return 0.0;
+  }
+}
+
+std::vector<uint8_t> Encode(SampleType type, const std::vector<double>& values) {
+  std::vector<uint8_t> bytes(values.size() * BytesPerSample(type));
+  ConvertSamplesScalar(SampleType::kF64, values.data(), type, bytes.data(),
+                       values.size());
+  return bytes;
+}
+
+std::vector<double> Decode(SampleType type, const std::vector<uint8_t>& bytes) {
+  std::vector<double> values(bytes.size() / BytesPerSample(type));
+  ConvertSamplesScalar(type, bytes.data(), SampleType::kF64, values.data(),
+                       values.size());
+  return values;
+}
+
+// Odd length so every kernel leaves a scalar tail; full scale, both
+// overflow directions and rounding ties at the start.
+std::vector<double> TestSignal() {
+  std::vector<double> values = {0.0,  1.0,  -1.0, 1.5,  -1.5, 0.999999,
+                                -0.999999, 0.5 / 32768.0, 1.5 / 32768.0,
+                                -2.5 / 32768.0};
+  for (int i = 0; values.size() < 1027; ++i) {
+    values.push_back(1.2 * std::sin(0.37 * i) * std::cos(0.011 * i));
+  }
+  return values;
+}
+
+class SampleKernelTest : public ::testing::Test {
+ protected:
+  void SetUp() override { saved_ = ActiveKernelIsa(); }
+  void TearDown() override { SetKernelIsa(saved_); }
+
+ private:
+  KernelIsa saved_ = KernelIsa::kScalar;
+};
+
+TEST_F(SampleKernelTest, ConvertsKnownValues) {
+  SetKernelIsa(KernelIsa::kScalar);
+  const int16_t s16[] = {-32768, 32767, 0, 16384};
+  float f32[4];
+  ConvertSamples(SampleType::kS16, s16, SampleType::kF32, f32, 4);
+  EXPECT_EQ(f32[0], -1.0f);
+  EXPECT_EQ(f32[1], 32767.0f / 32768.0f);
+  EXPECT_EQ(f32[3], 0.5f);
+
+  // +1.0 saturates; ties round to even.
+  const float in[] = {1.0f, -1.0f, 0.5f / 32768.0f, 1.5f / 32768.0f};
+  int16_t out[4];
+  ConvertSamples(SampleType::kF32, in, SampleType::kS16, out, 4);
+  EXPECT_EQ(out[0], 32767);
+  EXPECT_EQ(out[1], -32768);
+  EXPECT_EQ(out[2], 0);
+  EXPECT_EQ(out[3], 2);
+
+  // Packed 24-bit is little-endian and sign-extends.
+  const uint8_t s24[] = {0x00, 0x00, 0x80, 0xff, 0xff, 0x7f};
+  double f64[2];
+  ConvertSamples(SampleType::kS24, s24, SampleType::kF64, f64, 2);
+  EXPECT_EQ(f64[0], -1.0);
+  EXPECT_EQ(f64[1], 8388607.0 / 8388608.0);
+}
+
+TEST_F(SampleKernelTest, EveryIsaMatchesScalarForEveryPair) {
+  const std::vector<double> signal = TestSignal();
+  for (const KernelIsa isa : kIsas) {
+    if (!SetKernelIsa(isa)) continue;
+    for (const SampleType from : kTypes) {
+      const std::vector<uint8_t> src = Encode(from, signal);
+      for (const SampleType to : kTypes) {
+        for (const float gain : {1.0f, 0.5f, 1.7f}) {
+          std::vector<uint8_t> expected(signal.size() * BytesPerSample(to));
+          std::vector<uint8_t> actual(expected.size());
+          ConvertSamplesScalar(from, src.data(), to, expected.data(),
+                               signal.size(), gain);
+          ConvertSamples(from, src.data(), to, actual.data(), signal.size(), gain);
+          const std::vector<double> want = Decode(to, expected);
+          const std::vector<double> got = Decode(to, actual);
+          // Vector kernels compute in float where the reference uses double.
+          const bool viaFloat = IsFloat(from) || IsFloat(to);
+          for (size_t i = 0; i < want.size(); ++i) {
+            const double tolerance =
+                Step(to) + (viaFloat ? 4e-7 * std::fabs(want[i]) : 0.0);
+            ASSERT_NEAR(got[i], want[i], tolerance)
+                << KernelIsaName(isa) << " " << static_cast<int>(from) << "->"
+                << static_cast<int>(to) << " gain " << gain << " at " << i;
+          }
+        }
+      }
+    }
+  }
+}
+
+TEST_F(SampleKernelTest, ScalesInPlace) {
+  const std::vector<double> signal = TestSignal();
+  for (const KernelIsa isa : kIsas) {
+    if (!SetKernelIsa(isa)) continue;
+    for (const SampleType type : kTypes) {
+      const std::vector<uint8_t> src = Encode(type, signal);
+      std::vector<uint8_t> expected(src.size());
+      ConvertSamples(type, src.data(), type, expected.data(), signal.size(), 0.8f);
+      std::vector<uint8_t> inPlace = src;
+      ScaleSamples(type, inPlace.data(), signal.size(), 0.8f);
+      EXPECT_EQ(inPlace, expected) << KernelIsaName(isa);
+      // Unity gain leaves the bytes alone.
+      inPlace = src;
+      ScaleSamples(type, inPlace.data(), signal.size(), 1.0f);
+      EXPECT_EQ(inPlace, src);
+    }
+  }
+}
+
+TEST_F(SampleKernelTest, ClampsFloatsOnly) {
+  float f32[] = {1.5f, -2.0f, 0.25f};
+  ClampSamples(SampleType::kF32, f32, 3);
+  EXPECT_EQ(f32[0], 1.0f);
+  EXPECT_EQ(f32[1], -1.0f);
+  EXPECT_EQ(f32[2], 0.25f);
+  int16_t s16[] = {32767, -32768};
+  ClampSamples(SampleType::kS16, s16, 2);
+  EXPECT_EQ(s16[0], 32767);
+  EXPECT_EQ(s16[1], -32768);
+}
+
+TEST_F(SampleKernelTest, InterleaveRoundTripsEveryLayout) {
+  constexpr size_t kFrames = 37;
+  for (const KernelIsa isa : kIsas) {
+    if (!SetKernelIsa(isa)) continue;
+    for (const SampleType type : kTypes) {
+      const size_t bytes = BytesPerSample(type);
+      for (uint32_t channels = 1; channels <= 8; ++channels) {
+        std::vector<std::vector<uint8_t>> planes(channels,
+                                                 std::vector<uint8_t>(kFrames * bytes));
+        std::vector<const void*> in;
+        for (uint32_t ch = 0; ch < channels; ++ch) {
+          for (size_t i = 0; i < planes[ch].size(); ++i) {
+            planes[ch][i] = static_cast<uint8_t>(ch * 31 + i);
+          }
+          in.push_back(planes[ch].data());
+        }
+        std::vector<uint8_t> interleaved(kFrames * channels * bytes);
+        InterleaveSamples(type, in.data(), channels, kFrames, interleaved.data());
+        for (size_t frame = 0; frame < kFrames; ++frame) {
+          for (uint32_t ch = 0; ch < channels; ++ch) {
+            ASSERT_EQ(std::memcmp(interleaved.data() + (frame * channels + ch) * bytes,
+                                  planes[ch].data() + frame * bytes, bytes),
+                      0)
+                << KernelIsaName(isa) << " " << channels << "ch frame " << frame;
+          }
+        }
+
+        std::vector<std::vector<uint8_t>> back(channels,
+                                               std::vector<uint8_t>(kFrames * bytes));
+        std::vector<void*> out;
+        for (auto& plane : back) out.push_back(plane.data());
+        DeinterleaveSamples(type, interleaved.data(), channels, kFrames, out.data());
+        EXPECT_EQ(back, planes) << KernelIsaName(isa) << " " << channels << "ch";
+      }
+    }
+  }
+}
+
+TEST_F(SampleKernelTest, RejectsUnsupportedIsa) {
+  EXPECT_TRUE(SetKernelIsa(KernelIsa::kScalar));
+  EXPECT_EQ(ActiveKernelIsa(), KernelIsa::kScalar);
+  for (const KernelIsa isa : kIsas) {
+    EXPECT_EQ(SetKernelIsa(isa), KernelIsaSupported(isa)) << KernelIsaName(isa);
+  }
+  // x86 and ARM builds never support each other's instruction sets.
+  EXPECT_FALSE(KernelIsaSupported(KernelIsa::kSse2) &&
+               KernelIsaSupported(KernelIsa::kNeon));
+}
+
+}  // namespace
+}  // namespace audioengine
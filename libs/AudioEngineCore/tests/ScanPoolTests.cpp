@@ -0,0 +1,97 @@
+#include "AudioEngineCore/ScanPool.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace audioengine {
+namespace {
+
+using Job = ScanPool::Job;
+using Outcome = ScanPool::Outcome;
+
+std::vector<Job> Jobs(const std::vector<std::string>& paths, const std::string& group = "") {
+  std::vector<Job> jobs;
+  for (const std::string& path : paths) {
+    Job job;
+    job.key.path = path;
+    job.group = group;
+    jobs.push_back(job);
+  }
+  return jobs;
+}
+
+TEST(ScanPoolTest, SkipsPathsSeenThisSession) {
+  std::atomic<int> scans{0};
+  ScanPool pool([&](const Job& job, uint64_t) -> ScanPool::Result {
+    ++scans;
+    if (job.key.path == "bad") return {Outcome::kFailed};
+    return {Outcome::kDone, 2.0};
+  }, 2);
+  EXPECT_EQ(pool.WorkerCount(), 2u);
+  EXPECT_EQ(pool.Enqueue(Jobs({"a", "b", "bad"})), 3u);
+  pool.WaitIdle();
+  // Failed paths are not retried either.
+  EXPECT_EQ(pool.Enqueue(Jobs({"a", "bad", "c"})), 1u);
+  pool.WaitIdle();
+
+  EXPECT_EQ(scans.load(), 4);
+  const ScanPool::Stats stats = pool.GetStats();
+  EXPECT_EQ(stats.tracksDone, 3u);
+  EXPECT_EQ(stats.tracksFailed, 1u);
+  EXPECT_EQ(stats.tracksPending, 0u);
+  EXPECT_DOUBLE_EQ(stats.audioSeconds, 6.0);
+}
+
+TEST(ScanPoolTest, RunsAGroupInOrder) {
+  std::mutex mutex;
+  std::vector<std::string> order;
+  ScanPool pool([&](const Job& job, uint64_t) -> ScanPool::Result {
+    std::lock_guard<std::mutex> lock(mutex);
+    order.push_back(job.key.path);
+    return {Outcome::kDone};
+  }, 1);
+  pool.Enqueue(Jobs({"1", "2", "3", "4"}, "album"));
+  pool.WaitIdle();
+  EXPECT_EQ(order, (std::vector<std::string>{"1", "2", "3", "4"}));
+}
+
+TEST(ScanPoolTest, CancelledPathsCanBeQueuedAgain) {
+  std::atomic<bool> started{false};
+  std::atomic<bool> holdNext{true};
+  ScanPool* self = nullptr;
+  ScanPool pool([&](const Job&, uint64_t generation) -> ScanPool::Result {
+    if (!holdNext.exchange(false)) return {Outcome::kDone};
+    started = true;
+    while (!self->Cancelled(generation)) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return {Outcome::kCancelled};
+  }, 1);
+  self = &pool;
+
+  pool.Enqueue(Jobs({"running", "queued"}));
+  while (!started) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  pool.Cancel();
+  pool.WaitIdle();
+  EXPECT_EQ(pool.GetStats().tracksDone, 0u);
+
+  EXPECT_EQ(pool.Enqueue(Jobs({"running", "queued"})), 2u);
+  pool.WaitIdle();
+  EXPECT_EQ(pool.GetStats().tracksDone, 2u);
+}
+
+TEST(ScanPoolTest, DestroysWithoutEverStarting) {
+  ScanPool pool([](const Job&, uint64_t) -> ScanPool::Result { return {Outcome::kDone}; });
+  EXPECT_GT(pool.WorkerCount(), 0u);
+  pool.WaitIdle();
+  pool.Cancel();
+}
+
+}  // namespace
+}  // namespace audioengine
@@ -0,0 +1,202 @@
+#include "AudioEngineCore/SeekIndex.h"
+#include "AudioEngineCore/SeekIndexer.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "TestCache.h"
+
+namespace audioengine {
+namespace {
+
+uint32_t Fnv1a32(const uint8_t* data, size_t size) {
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= data[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+void AppendLe32(std::vector<uint8_t>* out, uint32_t value) {
+  for (int i = 0; i < 4; ++i) out->push_back(static_cast<uint8_t>(value >> (8 * i)));
+}
+
+using CacheCleanup = testing::CacheCleanup<SeekIndex>;
+
+// Packet layout of a ten-minute 44.1 kHz VBR MP3: 1152-frame packets with
+// sizes varying between 200 and 700 bytes.
+SeekIndex BuildMp3LikeIndex(uint64_t* packets = nullptr) {
+  SeekIndex index(44100, SeekIndex::DefaultInterval(44100));
+  uint64_t offset = 4096;  // ID3 tag
+  uint64_t frame = 0;
+  uint64_t count = 0;
+  while (frame < 44100ull * 600) {
+    index.Add(frame, offset);
+    frame += 1152;
+    offset += 200 + (count * 7919) % 500;
+    ++count;
+  }
+  if (packets) *packets = count;
+  return index;
+}
+
+TEST(SeekIndexTest, KeepsFirstPacketPerInterval) {
+  SeekIndex index(48000, 24000);
+  index.Add(0, 10);
+  index.Add(1024, 300);     // same bucket as 0
+  index.Add(24576, 7000);   // bucket 1
+  index.Add(25600, 7300);   // bucket 1
+  index.Add(24576, 7000);   // out of order, ignored
+  index.Add(49152, 14000);  // bucket 2
+  ASSERT_EQ(index.Size(), 3u);
+  EXPECT_EQ(index.Points()[1].frame, 24576u);
+  EXPECT_EQ(index.Points()[1].byteOffset, 7000u);
+}
+
+TEST(SeekIndexTest, LookupReturnsPointAtOrBeforeTarget) {
+  uint64_t packets = 0;
+  const SeekIndex index = BuildMp3LikeIndex(&packets);
+  // Roughly one point per half second instead of one per packet.
+  EXPECT_LE(index.Size(), 1201u);
+  EXPECT_GT(packets, 15u * index.Size());
+
+  for (uint64_t target = 0; target < 44100ull * 600; target += 4321) {
+    SeekPoint point;
+    ASSERT_TRUE(index.Lookup(target, &point)) << target;
+    EXPECT_LE(point.frame, target);
+    EXPECT_LT(target - point.frame, index.IntervalFrames() + 1152u) << target;
+  }
+
+  SeekIndex late(44100, 22050);
+  late.Add(5000, 100);
+  SeekPoint point;
+  EXPECT_FALSE(late.Lookup(4999, &point));
+  EXPECT_FALSE(SeekIndex().Lookup(0, &point));
+}
+
+TEST(SeekIndexTest, SerializedFormatIsStable) {
+  // Pins the on-disk layout shared with FFmpegSeekIndex.c.
+  const SeekIndex::Key key{"a.mp3", 1000, 1700000000};
+  SeekIndex index(44100, 22050);
+  index.Add(0, 100);
+  index.Add(23040, 5000);
+  index.Add(46080, 9000);
+
+  std::vector<uint8_t> expected = {
+      'T', 'N', 'S', 'X', 0x01, 0x00, 0x00, 0x00,
+      0xE8, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,  // size 1000
+      0x00, 0xF1, 0x53, 0x65, 0x00, 0x00, 0x00, 0x00,  // mtime 1700000000
+      0x44, 0xAC, 0x00, 0x00,                          // 44100 Hz
+      0x22, 0x56, 0x00, 0x00,                          // interval 22050
+      0x03, 0x00, 0x00, 0x00,                          // 3 points
+  };
+  AppendLe32(&expected, Fnv1a32(reinterpret_cast<const uint8_t*>("a.mp3"), 5));
+  const std::vector<uint8_t> body = {
+      0x00, 0x64,              // +0 frames, +100 bytes
+      0x80, 0xB4, 0x01, 0xA4, 0x26,  // +23040, +4900
+      0x80, 0xB4, 0x01, 0xA0, 0x1F,  // +23040, +4000
+  };
+  expected.insert(expected.end(), body.begin(), body.end());
+  AppendLe32(&expected, Fnv1a32(expected.data(), expected.size()));
+
+  EXPECT_EQ(index.Serialize(key), expected);
+}
+
+TEST(SeekIndexTest, RoundTripsAndRejectsMismatches) {
+  const SeekIndex::Key key{"/music/long.flac", 123456789, 1712345678};
+  const SeekIndex index = BuildMp3LikeIndex();
+  const std::vector<uint8_t> bytes = index.Serialize(key);
+
+  SeekIndex copy;
+  ASSERT_TRUE(copy.Deserialize(bytes.data(), bytes.size(), key));
+  EXPECT_EQ(copy.SampleRate(), index.SampleRate());
+  EXPECT_EQ(copy.IntervalFrames(), index.IntervalFrames());
+  ASSERT_EQ(copy.Size(), index.Size());
+  for (size_t i = 0; i < index.Size(); ++i) {
+    EXPECT_EQ(copy.Points()[i].frame, index.Points()[i].frame);
+    EXPECT_EQ(copy.Points()[i].byteOffset, index.Points()[i].byteOffset);
+  }
+
+  SeekIndex rejected;
+  SeekIndex::Key touched = key;
+  touched.mtimeSeconds += 1;
+  EXPECT_FALSE(rejected.Deserialize(bytes.data(), bytes.size(), touched));
+  SeekIndex::Key resized = key;
+  resized.fileSize += 1;
+  EXPECT_FALSE(rejected.Deserialize(bytes.data(), bytes.size(), resized));
+  SeekIndex::Key moved = key;
+  moved.path = "/music/other.flac";
+  EXPECT_FALSE(rejected.Deserialize(bytes.data(), bytes.size(), moved));
+
+  std::vector<uint8_t> corrupt = bytes;
+  corrupt[corrupt.size() / 2] ^= 0x01;
+  EXPECT_FALSE(rejected.Deserialize(corrupt.data(), corrupt.size(), key));
+  EXPECT_FALSE(rejected.Deserialize(bytes.data(), bytes.size() - 1, key));
+  EXPECT_TRUE(rejected.Empty());
+}
+
+TEST(SeekIndexTest, CacheNameDependsOnEveryKeyField) {
+  const SeekIndex::Key key{"/music/a.mp3", 100, 200};
+  const std::string name = SeekIndex::CacheFileName(key);
+  EXPECT_EQ(name.size(), 16u + 8u);
+  EXPECT_EQ(name.substr(16), ".seekidx");
+  EXPECT_NE(SeekIndex::CacheFileName({"/music/b.mp3", 100, 200}), name);
+  EXPECT_NE(SeekIndex::CacheFileName({"/music/a.mp3", 101, 200}), name);
+  EXPECT_NE(SeekIndex::CacheFileName({"/music/a.mp3", 100, 201}), name);
+}
+
+TEST(SeekIndexerTest, BuildsInBackgroundAndServesFromCache) {
+  const SeekIndex::Key key{"/music/long.mp3", 5000000, 1700000000};
+  SeekIndex::Key modified = key;
+  modified.mtimeSeconds += 60;
+  CacheCleanup cleanup({key, modified});
+
+  std::atomic<int> builds{0};
+  SeekIndexer indexer(::testing::TempDir(), [&builds](const SeekIndex::Key&, SeekIndex* index) {
+    ++builds;
+    *index = BuildMp3LikeIndex();
+    return true;
+  });
+
+  SeekIndex index;
+  EXPECT_FALSE(indexer.Load(key, &index));
+
+  indexer.Request(key);
+  indexer.Request(key);  // already queued or building
+  indexer.WaitIdle();
+  EXPECT_EQ(builds.load(), 1);
+  EXPECT_EQ(indexer.BuiltCount(), 1u);
+  ASSERT_TRUE(indexer.Load(key, &index));
+  EXPECT_EQ(index.Size(), BuildMp3LikeIndex().Size());
+
+  indexer.Request(key);  // cached, no rebuild
+  indexer.WaitIdle();
+  EXPECT_EQ(builds.load(), 1);
+
+  // A modified file gets its own entry.
+  EXPECT_FALSE(indexer.Load(modified, &index));
+  indexer.Request(modified);
+  indexer.WaitIdle();
+  EXPECT_EQ(builds.load(), 2);
+}
+
+TEST(SeekIndexerTest, FailedBuildLeavesNoCacheEntry) {
+  const SeekIndex::Key key{"/music/broken.mp3", 10, 20};
+  CacheCleanup cleanup({key});
+  SeekIndexer indexer(::testing::TempDir(),
+                      [](const SeekIndex::Key&, SeekIndex*) { return false; });
+  indexer.Request(key);
+  indexer.WaitIdle();
+  EXPECT_EQ(indexer.BuiltCount(), 0u);
+  SeekIndex index;
+  EXPECT_FALSE(indexer.Load(key, &index));
+}
+
+}  // namespace
+}  // namespace audioengine
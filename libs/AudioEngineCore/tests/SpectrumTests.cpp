@@ -0,0 +1,137 @@
+#include "AudioEngineCore/Spectrum.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "AudioEngineCore/AllocationCounter.h"
+#include "TestSources.h"
+
+namespace audioengine {
+namespace {
+
+using testing::Sine;
+
+constexpr uint32_t kRate = 48000;
+
+// Waits for a published frame that satisfies `done`; the last one seen
+// either way.
+template <typename Done>
+SpectrumFrame WaitFor(SpectrumAnalyzer& analyzer, Done done) {
+  SpectrumFrame frame;
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (std::chrono::steady_clock::now() < deadline) {
+    if (analyzer.Latest(&frame) && done(frame)) break;
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  }
+  return frame;
+}
+
+size_t BandOf(const SpectrumAnalyzer& analyzer, double frequency) {
+  const std::vector<double> centres = analyzer.BandCentersHz();
+  size_t best = 0;
+  for (size_t b = 1; b < centres.size(); ++b) {
+    if (std::fabs(std::log(centres[b] / frequency)) <
+        std::fabs(std::log(centres[best] / frequency))) {
+      best = b;
+    }
+  }
+  return best;
+}
+
+TEST(SpectrumTest, SineReadsItsLevelInItsBand) {
+  SpectrumAnalyzer analyzer;
+  ASSERT_TRUE(analyzer.Configure({kRate, 2, 32, true}));
+  EXPECT_EQ(analyzer.FftSize(), 4096u);
+  analyzer.SetEnabled(true);
+  // -6 dBFS at 1 kHz.
+  const std::vector<float> sine = Sine(2, 8192, kRate, 1000.0, 0.5);
+  analyzer.Tap(sine.data(), 8192);
+
+  const size_t band = BandOf(analyzer, 1000.0);
+  const SpectrumFrame frame =
+      WaitFor(analyzer, [&](const SpectrumFrame& f) { return f.levelsDb[band] > -20.0f; });
+  ASSERT_EQ(frame.bands, 64u);
+  // Within Hann scalloping (1.42 dB at worst, between two bins).
+  EXPECT_LE(frame.levelsDb[band], -6.0f);
+  EXPECT_GT(frame.levelsDb[band], -6.02f - 1.45f);
+  // Hann sidelobes are far down two octaves away.
+  EXPECT_LT(frame.levelsDb[BandOf(analyzer, 250.0)], -60.0f);
+  EXPECT_LT(frame.levelsDb[BandOf(analyzer, 4000.0)], -60.0f);
+}
+
+TEST(SpectrumTest, ReadsIntegerOutput) {
+  SpectrumAnalyzer analyzer;
+  ASSERT_TRUE(analyzer.Configure({kRate, 2, 16, false}));
+  EXPECT_FALSE(SpectrumAnalyzer().Configure({kRate, 2, 8, false}));
+  SpectrumAnalyzer::Options options;
+  options.bands = 32;
+  analyzer.SetOptions(options);
+  analyzer.SetEnabled(true);
+  const std::vector<float> sine = Sine(2, 8192, kRate, 3000.0, 0.25);
+  std::vector<int16_t> pcm(sine.size());
+  for (size_t i = 0; i < sine.size(); ++i) {
+    pcm[i] = static_cast<int16_t>(std::lround(sine[i] * 32768.0f));
+  }
+  analyzer.Tap(pcm.data(), 8192);
+
+  const size_t band = BandOf(analyzer, 3000.0);
+  const SpectrumFrame frame =
+      WaitFor(analyzer, [&](const SpectrumFrame& f) { return f.levelsDb[band] > -20.0f; });
+  ASSERT_EQ(frame.bands, 32u);
+  EXPECT_LE(frame.levelsDb[band], -12.0f);
+  EXPECT_GT(frame.levelsDb[band], -12.04f - 1.45f);
+}
+
+TEST(SpectrumTest, FallsToTheFloorAndGoesQuiet) {
+  SpectrumAnalyzer analyzer;
+  ASSERT_TRUE(analyzer.Configure({kRate, 1, 32, true}));
+  SpectrumAnalyzer::Options options;
+  options.releaseMs = 20.0;
+  analyzer.SetOptions(options);
+  analyzer.SetEnabled(true);
+  const std::vector<float> sine = Sine(1, 8192, kRate, 500.0, 1.0);
+  analyzer.Tap(sine.data(), 8192);
+  const size_t band = BandOf(analyzer, 500.0);
+  WaitFor(analyzer, [&](const SpectrumFrame& f) { return f.levelsDb[band] > -3.0f; });
+
+  // With the tap quiet the levels decay, then publishing stops.
+  const SpectrumFrame floor = WaitFor(analyzer, [&](const SpectrumFrame& f) {
+    return std::all_of(f.levelsDb, f.levelsDb + f.bands,
+                       [&](float level) { return level == options.floorDb; });
+  });
+  ASSERT_EQ(floor.levelsDb[band], options.floorDb);
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  SpectrumFrame next;
+  while (analyzer.Latest(&next)) {
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  EXPECT_FALSE(analyzer.Latest(&next));
+}
+
+TEST(SpectrumTest, TapIsABoundedCopy) {
+  SpectrumAnalyzer analyzer;
+  ASSERT_TRUE(analyzer.Configure({kRate, 2, 32, true}));
+  std::vector<float> block(480 * 2, 0.25f);
+  // Off: nothing is taken.
+  analyzer.Tap(block.data(), 480);
+  EXPECT_EQ(analyzer.DroppedFrames(), 0u);
+
+  analyzer.SetEnabled(true);
+  const uint64_t before = debug::ThreadAllocationCount();
+  for (int i = 0; i < 100; ++i) analyzer.Tap(block.data(), 480);
+  EXPECT_EQ(debug::ThreadAllocationCount(), before);
+
+  // Far more than the ring holds in one go: the excess is dropped.
+  std::vector<float> flood(kRate * 2 * 2, 0.0f);
+  analyzer.Tap(flood.data(), kRate * 2);
+  EXPECT_GT(analyzer.DroppedFrames(), static_cast<uint64_t>(kRate));
+}
+
+}  // namespace
+}  // namespace audioengine
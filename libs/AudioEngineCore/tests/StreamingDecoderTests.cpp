@@ -0,0 +1,173 @@
+#include "AudioEngineCore/StreamingDecoder.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "TestSources.h"
+
+namespace audioengine {
+namespace {
+
+using testing::CountingSource;
+using testing::PacketizedSource;
+using testing::StallingSource;
+
+// Drains the decoder the way a render callback would, checking every sample
+// and discarding it (a null sink).
+uint64_t DrainAndVerify(StreamingDecoder& decoder, uint64_t firstFrame,
+                        uint32_t channels) {
+  std::vector<int32_t> block(512 * channels);
+  uint64_t frame = firstFrame;
+  const auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::seconds(30);
+  while (!decoder.IsFinished()) {
+    const size_t got =
+        decoder.Read(reinterpret_cast<uint8_t*>(block.data()), 512);
+    for (size_t i = 0; i < got; ++i) {
+      for (uint32_t ch = 0; ch < channels; ++ch) {
+        EXPECT_EQ(block[i * channels + ch],
+                  CountingSource::SampleAt(frame, ch, channels));
+      }
+      ++frame;
+    }
+    if (got == 0) std::this_thread::sleep_for(std::chrono::microseconds(200));
+    if (std::chrono::steady_clock::now() > deadline) {
+      ADD_FAILURE() << "decoder did not finish";
+      break;
+    }
+  }
+  return frame;
+}
+
+TEST(StreamingDecoderTest, StreamsWholeSourceThroughBoundedRing) {
+  StreamingDecoder::Options options;
+  options.bufferSeconds = 0.05;
+  options.prefillSeconds = 0.01;
+  options.chunkFrames = 256;
+  StreamingDecoder decoder(options);
+
+  constexpr uint64_t kFrames = 48000 * 5;
+  ASSERT_TRUE(decoder.Start(std::make_unique<CountingSource>(48000, 2, kFrames)));
+
+  // The ring never grows with the track: 5 s of audio through ~50 ms.
+  EXPECT_LE(decoder.CapacityFrames(), 4096u);
+  EXPECT_GE(decoder.BufferedFrames(), 480u);
+  EXPECT_EQ(decoder.TotalFrames(), kFrames);
+
+  EXPECT_EQ(DrainAndVerify(decoder, 0, 2), kFrames);
+  EXPECT_EQ(decoder.PositionFrames(), kFrames);
+}
+
+TEST(StreamingDecoderTest, StartReturnsAfterPrefillNotWholeTrack) {
+  StreamingDecoder::Options options;
+  options.bufferSeconds = 0.5;
+  options.prefillSeconds = 0.05;
+  StreamingDecoder decoder(options);
+
+  // An "hour-long" source: Start() must not wait for it to decode.
+  constexpr uint64_t kHour = 48000ull * 3600;
+  ASSERT_TRUE(decoder.Start(std::make_unique<CountingSource>(48000, 2, kHour)));
+  EXPECT_LE(decoder.BufferedFrames(), decoder.CapacityFrames());
+  EXPECT_FALSE(decoder.IsFinished());
+  decoder.Stop();
+  EXPECT_FALSE(decoder.IsActive());
+}
+
+TEST(StreamingDecoderTest, SeekRestartsFromRequestedFrame) {
+  StreamingDecoder::Options options;
+  options.bufferSeconds = 0.05;
+  options.prefillSeconds = 0.01;
+  options.chunkFrames = 128;
+  StreamingDecoder decoder(options);
+
+  constexpr uint64_t kFrames = 44100 * 2;
+  ASSERT_TRUE(decoder.Start(std::make_unique<CountingSource>(44100, 1, kFrames)));
+
+  std::vector<int32_t> block(100);
+  decoder.Read(reinterpret_cast<uint8_t*>(block.data()), 100);
+
+  ASSERT_TRUE(decoder.Seek(60000));
+  EXPECT_EQ(decoder.PositionFrames(), 60000u);
+  EXPECT_EQ(DrainAndVerify(decoder, 60000, 1), kFrames);
+  EXPECT_EQ(decoder.PositionFrames(), kFrames);
+}
+
+TEST(StreamingDecoderTest, SeekReportsWhereTheSourceLanded) {
+  StreamingDecoder::Options options;
+  options.bufferSeconds = 0.05;
+  options.prefillSeconds = 0.01;
+  options.chunkFrames = 128;
+  StreamingDecoder decoder(options);
+
+  constexpr uint64_t kFrames = 44100 * 2;
+  PacketizedSource::Profile mp3Like;
+  mp3Like.packetFrames = 1152;
+  mp3Like.syncFrames = 1152 * 8;
+  mp3Like.prerollFrames = 1152 * 2;
+  ASSERT_TRUE(decoder.Start(
+      std::make_unique<PacketizedSource>(44100, 2, kFrames, mp3Like)));
+
+  ASSERT_TRUE(decoder.Seek(60000, SeekMode::kFast));
+  constexpr uint64_t kSyncPoint = 60000 - 60000 % (1152 * 8);
+  EXPECT_EQ(decoder.PositionFrames(), kSyncPoint);
+  EXPECT_EQ(DrainAndVerify(decoder, kSyncPoint, 2), kFrames);
+
+  ASSERT_TRUE(decoder.Seek(60000, SeekMode::kAccurate));
+  EXPECT_EQ(decoder.PositionFrames(), 60000u);
+  EXPECT_EQ(DrainAndVerify(decoder, 60000, 2), kFrames);
+  EXPECT_GT(decoder.LastSeekDuration().count(), 0);
+}
+
+// A fake device sink: pulls one period every period-length of wall time, like
+// an AAudio/WASAPI callback, and records how long each pull took.
+TEST(StreamingDecoderTest, FakeSinkIsNotBlockedByDecoderStalls) {
+  StreamingDecoder::Options options;
+  options.bufferSeconds = 0.5;
+  options.prefillSeconds = 0.25;
+  options.chunkFrames = 1024;
+  StreamingDecoder decoder(options);
+
+  constexpr uint32_t kRate = 48000;
+  constexpr uint64_t kFrames = kRate;  // 1 s
+  // 100 ms stall for every 200 ms of audio: still faster than real time,
+  // but each stall is ten device periods long.
+  ASSERT_TRUE(decoder.Start(std::make_unique<StallingSource>(
+      kRate, 2, kFrames, kRate / 5, std::chrono::milliseconds(100))));
+
+  constexpr size_t kPeriod = 480;  // 10 ms
+  std::vector<int32_t> block(kPeriod * 2);
+  uint64_t frame = 0;
+  int underruns = 0;
+  auto worst = std::chrono::steady_clock::duration::zero();
+  auto next = std::chrono::steady_clock::now();
+  while (!decoder.IsFinished()) {
+    const auto begin = std::chrono::steady_clock::now();
+    const size_t got =
+        decoder.Read(reinterpret_cast<uint8_t*>(block.data()), kPeriod);
+    worst = std::max(worst, std::chrono::steady_clock::now() - begin);
+    for (size_t i = 0; i < got; ++i, ++frame) {
+      ASSERT_EQ(block[i * 2], CountingSource::SampleAt(frame, 0, 2));
+    }
+    if (got < kPeriod && !decoder.IsFinished()) ++underruns;
+    next += std::chrono::milliseconds(10);
+    std::this_thread::sleep_until(next);
+  }
+
+  EXPECT_EQ(frame, kFrames);
+  EXPECT_EQ(underruns, 0);
+  EXPECT_LT(worst, std::chrono::milliseconds(20));
+}
+
+TEST(StreamingDecoderTest, RejectsSourceWithoutFormat) {
+  StreamingDecoder decoder;
+  EXPECT_FALSE(decoder.Start(std::make_unique<CountingSource>(0, 2, 10)));
+  EXPECT_FALSE(decoder.Start(nullptr));
+}
+
+}  // namespace
+}  // namespace audioengine
@@ -0,0 +1,34 @@
+// Cache-file helpers shared by the scanner unit tests.
+#pragma once
+
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "AudioEngineCore/SeekIndex.h"
+
+namespace audioengine::testing {
+
+// Removes the cache entries a test created in ::testing::TempDir(). `Owner`
+// names them through its static CacheFileName(key).
+template <typename Owner>
+class CacheCleanup {
+ public:
+  explicit CacheCleanup(std::vector<SeekIndex::Key> keys) : keys_(std::move(keys)) {}
+  ~CacheCleanup() {
+    for (const SeekIndex::Key& key : keys_) {
+      std::remove((::testing::TempDir() + Owner::CacheFileName(key)).c_str());
+    }
+  }
+
+  CacheCleanup(const CacheCleanup&) = delete;
+  CacheCleanup& operator=(const CacheCleanup&) = delete;
+
+ private:
+  std::vector<SeekIndex::Key> keys_;
+};
+
+}  // namespace audioengine::testing
@@ -0,0 +1,348 @@
+// Synthetic PcmSource implementations and test signals shared by the unit
+// tests.
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "AudioEngineCore/PcmSource.h"
+
+namespace audioengine::testing {
+
+// Emits int32 samples whose value encodes their position in the stream, so a
+// consumer can check ordering without keeping a reference copy.
+class CountingSource : public PcmSource {
+ public:
+  CountingSource(uint32_t sampleRate, uint32_t channels, uint64_t totalFrames)
+      : totalFrames_(totalFrames) {
+    format_.sampleRate = sampleRate;
+    format_.channels = channels;
+    format_.bitsPerSample = 32;
+    format_.isFloat = false;
+  }
+
+  static int32_t SampleAt(uint64_t frame, uint32_t channel, uint32_t channels) {
+    return static_cast<int32_t>(frame * channels + channel);
+  }
+
+  PcmFormat Format() const override { return format_; }
+
+  size_t ReadFrames(uint8_t* dst, size_t maxFrames) override {
+    const size_t frames = static_cast<size_t>(
+        std::min<uint64_t>(maxFrames, totalFrames_ - position_));
+    auto* out = reinterpret_cast<int32_t*>(dst);
+    for (size_t i = 0; i < frames; ++i) {
+      for (uint32_t ch = 0; ch < format_.channels; ++ch) {
+        *out++ = SampleAt(position_ + i, ch, format_.channels);
+      }
+    }
+    position_ += frames;
+    return frames;
+  }
+
+  bool SeekToFrame(uint64_t frame, SeekMode, uint64_t* landedFrame) override {
+    position_ = std::min(frame, totalFrames_);
+    if (landedFrame) *landedFrame = position_;
+    return true;
+  }
+
+  uint64_t TotalFrames() const override { return totalFrames_; }
+
+ private:
+  PcmFormat format_{};
+  uint64_t totalFrames_ = 0;
+  uint64_t position_ = 0;
+};
+
+// CountingSource that blocks for `stall` every `stallEveryFrames` frames,
+// mimicking slow I/O or a decoder spike.
+class StallingSource : public CountingSource {
+ public:
+  StallingSource(uint32_t sampleRate, uint32_t channels, uint64_t totalFrames,
+                 uint64_t stallEveryFrames, std::chrono::milliseconds stall)
+      : CountingSource(sampleRate, channels, totalFrames),
+        stallEveryFrames_(stallEveryFrames),
+        stall_(stall) {}
+
+  size_t ReadFrames(uint8_t* dst, size_t maxFrames) override {
+    const size_t frames = CountingSource::ReadFrames(dst, maxFrames);
+    sinceStall_ += frames;
+    if (sinceStall_ >= stallEveryFrames_) {
+      sinceStall_ = 0;
+      std::this_thread::sleep_for(stall_);
+    }
+    return frames;
+  }
+
+ private:
+  uint64_t stallEveryFrames_;
+  std::chrono::milliseconds stall_;
+  uint64_t sinceStall_ = 0;
+};
+
+// CountingSource shaped like a compressed stream: decoding costs
+// `packetCost` per `packetFrames`, seeks can only resume at multiples of
+// `syncFrames`, and an accurate seek must first decode `prerollFrames` of
+// history before the target.
+class PacketizedSource : public CountingSource {
+ public:
+  struct Profile {
+    size_t packetFrames = 1024;
+    uint64_t syncFrames = 1024;
+    uint64_t prerollFrames = 0;
+    std::chrono::nanoseconds packetCost{0};
+  };
+
+  PacketizedSource(uint32_t sampleRate, uint32_t channels, uint64_t totalFrames,
+                   const Profile& profile)
+      : CountingSource(sampleRate, channels, totalFrames), profile_(profile) {}
+
+  size_t ReadFrames(uint8_t* dst, size_t maxFrames) override {
+    const size_t frames = CountingSource::ReadFrames(dst, maxFrames);
+    DecodePackets(frames);
+    return frames;
+  }
+
+  bool SeekToFrame(uint64_t frame, SeekMode mode, uint64_t* landedFrame) override {
+    uint64_t decodeFrom = frame;
+    if (mode == SeekMode::kAccurate) {
+      decodeFrom = frame > profile_.prerollFrames ? frame - profile_.prerollFrames : 0;
+    }
+    const uint64_t sync = decodeFrom - decodeFrom % profile_.syncFrames;
+    uint64_t landed = sync;
+    if (mode == SeekMode::kAccurate) {
+      // Decode and throw away everything between the sync point and target.
+      DecodePackets(static_cast<size_t>(frame - sync));
+      landed = frame;
+    }
+    return CountingSource::SeekToFrame(landed, mode, landedFrame);
+  }
+
+ private:
+  void DecodePackets(size_t frames) {
+    if (profile_.packetCost.count() == 0) return;
+    pendingFrames_ += frames;
+    while (pendingFrames_ >= profile_.packetFrames) {
+      pendingFrames_ -= profile_.packetFrames;
+      const auto until = std::chrono::steady_clock::now() + profile_.packetCost;
+      while (std::chrono::steady_clock::now() < until) {
+      }
+    }
+  }
+
+  Profile profile_;
+  size_t pendingFrames_ = 0;
+};
+
+// Decoder output of a lossy track: `leadingFrames` of priming and
+// `trailingFrames` of padding around `validFrames` of real audio. Padding
+// samples are kPaddingSample; real sample n of channel c is
+// `firstValue + n * channels + c`, so two tracks can be told apart.
+class PaddedSource : public PcmSource {
+ public:
+  static constexpr int32_t kPaddingSample = INT32_MIN;
+
+  PaddedSource(uint32_t sampleRate, uint32_t channels, uint64_t leadingFrames,
+               uint64_t validFrames, uint64_t trailingFrames, int32_t firstValue)
+      : leadingFrames_(leadingFrames),
+        validFrames_(validFrames),
+        totalFrames_(leadingFrames + validFrames + trailingFrames),
+        firstValue_(firstValue) {
+    format_.sampleRate = sampleRate;
+    format_.channels = channels;
+    format_.bitsPerSample = 32;
+    format_.isFloat = false;
+  }
+
+  PcmFormat Format() const override { return format_; }
+
+  size_t ReadFrames(uint8_t* dst, size_t maxFrames) override {
+    const size_t frames = static_cast<size_t>(
+        std::min<uint64_t>(maxFrames, totalFrames_ - position_));
+    auto* out = reinterpret_cast<int32_t*>(dst);
+    for (size_t i = 0; i < frames; ++i) {
+      const uint64_t frame = position_ + i;
+      const bool valid =
+          frame >= leadingFrames_ && frame < leadingFrames_ + validFrames_;
+      for (uint32_t ch = 0; ch < format_.channels; ++ch) {
+        *out++ = valid ? static_cast<int32_t>(
+                             firstValue_ + (frame - leadingFrames_) * format_.channels + ch)
+                       : kPaddingSample;
+      }
+    }
+    position_ += frames;
+    return frames;
+  }
+
+  bool SeekToFrame(uint64_t frame, SeekMode, uint64_t* landedFrame) override {
+    position_ = std::min(frame, totalFrames_);
+    if (landedFrame) *landedFrame = position_;
+    return true;
+  }
+
+  uint64_t TotalFrames() const override { return totalFrames_; }
+
+ private:
+  PcmFormat format_{};
+  uint64_t leadingFrames_;
+  uint64_t validFrames_;
+  uint64_t totalFrames_;
+  int32_t firstValue_;
+  uint64_t position_ = 0;
+};
+
+// Float32 source holding one constant value, for checking mix levels.
+class ConstantSource : public PcmSource {
+ public:
+  ConstantSource(uint32_t sampleRate, uint32_t channels, uint64_t totalFrames,
+                 float value)
+      : totalFrames_(totalFrames), value_(value) {
+    format_.sampleRate = sampleRate;
+    format_.channels = channels;
+    format_.bitsPerSample = 32;
+    format_.isFloat = true;
+  }
+
+  PcmFormat Format() const override { return format_; }
+
+  size_t ReadFrames(uint8_t* dst, size_t maxFrames) override {
+    const size_t frames = static_cast<size_t>(
+        std::min<uint64_t>(maxFrames, totalFrames_ - position_));
+    std::fill_n(reinterpret_cast<float*>(dst), frames * format_.channels, value_);
+    position_ += frames;
+    return frames;
+  }
+
+  bool SeekToFrame(uint64_t frame, SeekMode, uint64_t* landedFrame) override {
+    position_ = std::min(frame, totalFrames_);
+    if (landedFrame) *landedFrame = position_;
+    return true;
+  }
+
+  uint64_t TotalFrames() const override { return totalFrames_; }
+
+ private:
+  PcmFormat format_{};
+  uint64_t totalFrames_;
+  float value_;
+  uint64_t position_ = 0;
+};
+
+// Float32 source reading back a copy of `samples`.
+class MemorySource : public PcmSource {
+ public:
+  MemorySource(std::vector<float> samples, PcmFormat format)
+      : samples_(std::move(samples)), format_(format) {}
+  PcmFormat Format() const override { return format_; }
+  size_t ReadFrames(uint8_t* dst, size_t maxFrames) override {
+    const size_t frames = samples_.size() / format_.channels;
+    const size_t n = std::min<size_t>(maxFrames, frames - position_);
+    std::copy(samples_.begin() + position_ * format_.channels,
+              samples_.begin() + (position_ + n) * format_.channels,
+              reinterpret_cast<float*>(dst));
+    position_ += n;
+    return n;
+  }
+  bool SeekToFrame(uint64_t frame, SeekMode, uint64_t* landed) override {
+    position_ = static_cast<size_t>(frame);
+    if (landed) *landed = frame;
+    return true;
+  }
+  uint64_t TotalFrames() const override { return samples_.size() / format_.channels; }
+
+ private:
+  std::vector<float> samples_;
+  PcmFormat format_;
+  size_t position_ = 0;
+};
+
+// Float32 sine in every channel, in segments of (frames, amplitude), for
+// loudness measurements.
+class ToneSource : public PcmSource {
+ public:
+  ToneSource(uint32_t sampleRate, uint32_t channels, double frequency,
+             std::vector<std::pair<uint64_t, float>> segments)
+      : frequency_(frequency), segments_(std::move(segments)) {
+    format_.sampleRate = sampleRate;
+    format_.channels = channels;
+    format_.bitsPerSample = 32;
+    format_.isFloat = true;
+    for (const auto& segment : segments_) totalFrames_ += segment.first;
+  }
+
+  PcmFormat Format() const override { return format_; }
+
+  size_t ReadFrames(uint8_t* dst, size_t maxFrames) override {
+    const size_t frames = static_cast<size_t>(
+        std::min<uint64_t>(maxFrames, totalFrames_ - position_));
+    auto* out = reinterpret_cast<float*>(dst);
+    for (size_t i = 0; i < frames; ++i) {
+      const uint64_t frame = position_ + i;
+      const float value =
+          AmplitudeAt(frame) *
+          static_cast<float>(std::sin(2.0 * 3.14159265358979323846 * frequency_ *
+                                      static_cast<double>(frame) / format_.sampleRate));
+      for (uint32_t ch = 0; ch < format_.channels; ++ch) *out++ = value;
+    }
+    position_ += frames;
+    return frames;
+  }
+
+  bool SeekToFrame(uint64_t frame, SeekMode, uint64_t* landedFrame) override {
+    position_ = std::min(frame, totalFrames_);
+    if (landedFrame) *landedFrame = position_;
+    return true;
+  }
+
+  uint64_t TotalFrames() const override { return totalFrames_; }
+
+ private:
+  float AmplitudeAt(uint64_t frame) const {
+    for (const auto& segment : segments_) {
+      if (frame < segment.first) return segment.second;
+      frame -= segment.first;
+    }
+    return 0.0f;
+  }
+
+  PcmFormat format_{};
+  double frequency_;
+  std::vector<std::pair<uint64_t, float>> segments_;
+  uint64_t totalFrames_ = 0;
+  uint64_t position_ = 0;
+};
+
+// `count` samples of uniform noise in [-amplitude, amplitude) from a fixed
+// LCG, so a seed gives the same signal on every platform.
+inline std::vector<float> Noise(size_t count, uint32_t seed, float amplitude) {
+  std::vector<float> samples(count);
+  for (float& s : samples) {
+    seed = seed * 1664525u + 1013904223u;
+    s = amplitude *
+        (static_cast<float>(seed >> 8) / static_cast<float>(1u << 24) * 2.0f - 1.0f);
+  }
+  return samples;
+}
+
+// `frames` frames of a sine at `frequency` Hz, the same in every channel.
+inline std::vector<float> Sine(uint32_t channels, size_t frames, uint32_t sampleRate,
+                               double frequency, double amplitude, double phase = 0.0) {
+  std::vector<float> samples(frames * channels);
+  for (size_t f = 0; f < frames; ++f) {
+    const float x = static_cast<float>(
+        amplitude * std::sin(2.0 * 3.14159265358979323846 * frequency *
+                                 static_cast<double>(f) / sampleRate +
+                             phase));
+    for (uint32_t ch = 0; ch < channels; ++ch) samples[f * channels + ch] = x;
+  }
+  return samples;
+}
+
+}  // namespace audioengine::testing
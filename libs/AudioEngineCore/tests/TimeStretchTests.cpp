@@ -0,0 +1,179 @@
+#include "AudioEngineCore/TimeStretch.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "AudioEngineCore/AllocationCounter.h"
+#include "AudioEngineCore/SampleKernels.h"
+#include "TestSources.h"
+
+namespace audioengine {
+namespace {
+
+using testing::Noise;
+using testing::Sine;
+
+constexpr uint32_t kRate = 48000;
+
+// Stands in for the decode ring: hands out `samples` in order, and can be
+// held short to simulate an underrun.
+struct Input {
+  const std::vector<float>& samples;
+  uint32_t channels;
+  size_t position = 0;
+  size_t limit = SIZE_MAX;
+
+  size_t Frames() const { return samples.size() / channels; }
+  size_t operator()(float* dst, size_t frames) {
+    const size_t n = std::min({frames, Frames() - position, limit - std::min(limit, position)});
+    std::memcpy(dst, samples.data() + position * channels, n * channels * sizeof(float));
+    position += n;
+    return n;
+  }
+};
+
+// Reads `frames` frames in render-sized blocks.
+std::vector<float> Render(TimeStretcher& stretcher, Input& input, size_t frames,
+                          size_t block = 480) {
+  std::vector<float> out(frames * input.channels);
+  size_t done = 0;
+  while (done < frames) {
+    const size_t n = stretcher.Read(out.data() + done * input.channels,
+                                    std::min(block, frames - done), input);
+    if (n == 0) break;
+    done += n;
+  }
+  out.resize(done * input.channels);
+  return out;
+}
+
+// Frequency from upward zero crossings of channel 0, skipping the first
+// `skip` frames.
+double Frequency(const std::vector<float>& samples, uint32_t channels, size_t skip) {
+  const size_t frames = samples.size() / channels;
+  size_t first = 0, last = 0, crossings = 0;
+  for (size_t f = skip + 1; f < frames; ++f) {
+    if (samples[(f - 1) * channels] < 0.0f && samples[f * channels] >= 0.0f) {
+      if (crossings == 0) first = f;
+      last = f;
+      ++crossings;
+    }
+  }
+  if (crossings < 2) return 0.0;
+  return static_cast<double>(crossings - 1) * kRate / static_cast<double>(last - first);
+}
+
+TEST(TimeStretchTest, UnitRateIsAPlainRead) {
+  TimeStretcher stretcher;
+  ASSERT_TRUE(stretcher.Configure(kRate, 2));
+  EXPECT_FALSE(stretcher.Configure(kRate, 9));
+  ASSERT_TRUE(stretcher.Configure(kRate, 2));
+  const std::vector<float> samples = Noise(9600 * 2, 1, 0.5f);
+  Input input{samples, 2};
+  EXPECT_EQ(Render(stretcher, input, 9600), samples);
+  EXPECT_TRUE(stretcher.Idle());
+  EXPECT_EQ(stretcher.HeldFrames(), 0u);
+}
+
+TEST(TimeStretchTest, KeepsPitchAtEveryRateAndIsa) {
+  const KernelIsa saved = ActiveKernelIsa();
+  const std::vector<float> samples = Sine(2, kRate * 8, kRate, 220.0, 0.5);
+  for (const KernelIsa isa :
+       {KernelIsa::kScalar, KernelIsa::kSse2, KernelIsa::kAvx2, KernelIsa::kNeon}) {
+    if (!SetKernelIsa(isa)) continue;
+    for (const double rate : {0.75, 1.25, 2.0, 3.0}) {
+      TimeStretcher stretcher;
+      stretcher.Configure(kRate, 2);
+      stretcher.SetRate(rate);
+      Input input{samples, 2};
+      const size_t frames = kRate * 2;
+      const std::vector<float> out = Render(stretcher, input, frames);
+      ASSERT_EQ(out.size(), frames * 2);
+      EXPECT_NEAR(Frequency(out, 2, 4800), 220.0, 2.0) << KernelIsaName(isa) << " " << rate;
+      // Segments splice in phase: no dips where they overlap.
+      float low = 1.0f;
+      for (size_t at = 4800; at + 480 <= frames; at += 480) {
+        float peak = 0.0f;
+        for (size_t f = at; f < at + 480; ++f) peak = std::max(peak, std::fabs(out[f * 2]));
+        low = std::min(low, peak);
+      }
+      EXPECT_GT(low, 0.45f) << KernelIsaName(isa) << " " << rate;
+      // Input is used at the rate, give or take what is held.
+      const double consumed = static_cast<double>(input.position - stretcher.HeldFrames());
+      EXPECT_NEAR(consumed / frames, rate, 0.01) << KernelIsaName(isa) << " " << rate;
+    }
+  }
+  SetKernelIsa(saved);
+}
+
+TEST(TimeStretchTest, ReturnsToUnitRateWithoutASeam) {
+  const std::vector<float> samples = Noise(kRate * 4 * 2, 5, 0.5f);
+  TimeStretcher stretcher;
+  stretcher.Configure(kRate, 2);
+  stretcher.SetRate(1.5);
+  Input input{samples, 2};
+  Render(stretcher, input, kRate / 2, 441);
+  stretcher.SetRate(1.0);
+  // The hop in progress finishes; everything after it is the input, in
+  // order, from where the last segment left off.
+  const std::vector<float> out = Render(stretcher, input, kRate, 441);
+  const size_t skip = stretcher.HopFrames();
+  const float* at = std::search(samples.data(), samples.data() + samples.size(),
+                                out.data() + skip * 2, out.data() + skip * 2 + 8);
+  ASSERT_NE(at, samples.data() + samples.size());
+  const size_t from = static_cast<size_t>(at - samples.data());
+  EXPECT_TRUE(std::equal(out.begin() + skip * 2, out.end(), samples.begin() + from));
+  EXPECT_EQ(stretcher.HeldFrames(), 0u);
+  EXPECT_TRUE(stretcher.Idle());
+
+  // And back, starting from exactly where the input is.
+  stretcher.SetRate(2.0);
+  const size_t next = input.position;
+  const std::vector<float> again = Render(stretcher, input, 64);
+  EXPECT_NEAR(again[0], samples[next * 2], 1e-6f);
+}
+
+TEST(TimeStretchTest, WaitsOutUnderrunsAndPlaysOutTheEnd) {
+  const std::vector<float> samples = Sine(1, kRate, kRate, 330.0, 0.5);
+  TimeStretcher stretcher;
+  stretcher.Configure(kRate, 1);
+  stretcher.SetRate(2.0);
+  Input input{samples, 1};
+  input.limit = 1000;
+  std::vector<float> out(480);
+  // Not enough for the first hop: nothing yet, and nothing lost.
+  EXPECT_EQ(stretcher.Read(out.data(), 480, input), 0u);
+  EXPECT_EQ(input.position, 1000u);
+  input.limit = SIZE_MAX;
+  EXPECT_EQ(stretcher.Read(out.data(), 480, input), 480u);
+
+  size_t total = 480;
+  while (const size_t n = stretcher.Read(out.data(), 480, input, true)) total += n;
+  EXPECT_EQ(input.position, samples.size());
+  EXPECT_EQ(stretcher.HeldFrames(), 0u);
+  // Half the length, plus the tail that played out at rate 1.
+  EXPECT_GT(total, kRate / 2);
+  EXPECT_LT(total, kRate / 2 + 4 * stretcher.HopFrames());
+}
+
+TEST(TimeStretchTest, ReadDoesNotAllocate) {
+  const std::vector<float> samples = Noise(kRate * 2 * 2, 9, 0.5f);
+  TimeStretcher stretcher;
+  stretcher.Configure(kRate, 2);
+  Input input{samples, 2};
+  std::vector<float> out(480 * 2);
+  const uint64_t before = debug::ThreadAllocationCount();
+  for (const double rate : {1.0, 1.75, 0.5, 1.0, 3.0}) {
+    stretcher.SetRate(rate);
+    for (int i = 0; i < 20; ++i) stretcher.Read(out.data(), 480, input);
+  }
+  EXPECT_EQ(debug::ThreadAllocationCount(), before);
+}
+
+}  // namespace
+}  // namespace audioengine
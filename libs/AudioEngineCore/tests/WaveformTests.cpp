@@ -0,0 +1,244 @@
+#include "AudioEngineCore/Waveform.h"
+#include "AudioEngineCore/WaveformScanner.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "TestCache.h"
+#include "TestSources.h"
+
+namespace audioengine {
+namespace {
+
+using CacheCleanup = testing::CacheCleanup<Waveform>;
+using testing::ToneSource;
+
+// 16-bit source holding one constant value, like a bit-perfect decode.
+class ConstantS16Source : public PcmSource {
+ public:
+  ConstantS16Source(uint64_t frames, int16_t value) : frames_(frames), value_(value) {}
+  PcmFormat Format() const override { return {48000, 2, 16, false}; }
+  size_t ReadFrames(uint8_t* dst, size_t maxFrames) override {
+    const size_t n = static_cast<size_t>(std::min<uint64_t>(maxFrames, frames_ - position_));
+    std::fill_n(reinterpret_cast<int16_t*>(dst), n * 2, value_);
+    position_ += n;
+    return n;
+  }
+  bool SeekToFrame(uint64_t, SeekMode, uint64_t*) override { return false; }
+
+ private:
+  uint64_t frames_;
+  int16_t value_;
+  uint64_t position_ = 0;
+};
+
+std::shared_ptr<const Waveform> Build(uint32_t rate, uint32_t channels,
+                                      const std::vector<float>& samples) {
+  WaveformBuilder builder;
+  builder.Configure(rate, channels);
+  // Odd block size, so points straddle Process() calls.
+  const size_t frames = samples.size() / channels;
+  for (size_t at = 0; at < frames; at += 1000) {
+    builder.Process(samples.data() + at * channels, std::min<size_t>(1000, frames - at));
+  }
+  return builder.Finish();
+}
+
+TEST(WaveformTest, MeasuresMinMaxAndRmsPerPoint) {
+  // Three points of a constant stereo pair, then a quiet partial point.
+  const uint32_t perPoint = WaveformBuilder::BaseFramesPerPoint(48000);
+  ASSERT_EQ(perPoint, 1024u);
+  std::vector<float> samples;
+  for (uint32_t i = 0; i < 3 * perPoint; ++i) {
+    samples.push_back(0.5f);
+    samples.push_back(-0.25f);
+  }
+  for (uint32_t i = 0; i < 100; ++i) {
+    samples.push_back(0.0f);
+    samples.push_back(0.0f);
+  }
+  const auto waveform = Build(48000, 2, samples);
+  ASSERT_TRUE(waveform);
+  EXPECT_EQ(waveform->Frames(), 3u * perPoint + 100);
+  ASSERT_EQ(waveform->LevelCount(), 1u);
+  const WaveformLevel& level = waveform->Level(0);
+  EXPECT_EQ(level.framesPerPoint, perPoint);
+  ASSERT_EQ(level.count, 4u);
+  const float rms = std::sqrt((0.5f * 0.5f + 0.25f * 0.25f) / 2.0f);
+  for (size_t i = 0; i < 3; ++i) {
+    EXPECT_EQ(level.points[i].min, std::lround(-0.25f * Waveform::kFullScale));
+    EXPECT_EQ(level.points[i].max, std::lround(0.5f * Waveform::kFullScale));
+    EXPECT_NEAR(level.points[i].rms, rms * Waveform::kFullScale, 1.0);
+  }
+  EXPECT_EQ(level.points[3].max, 0);
+  EXPECT_EQ(level.points[3].rms, 0);
+}
+
+TEST(WaveformTest, CoarserLevelsMergeFourPoints) {
+  // A minute at 44.1 kHz with one loud click: 2584 points at the finest
+  // level, then 646 and 162.
+  const uint32_t rate = 44100;
+  std::vector<float> samples(static_cast<size_t>(rate) * 60, 0.1f);
+  samples[1000000] = -0.9f;
+  const auto waveform = Build(rate, 1, samples);
+  ASSERT_TRUE(waveform);
+  ASSERT_EQ(waveform->LevelCount(), 3u);
+  const size_t counts[] = {2584, 646, 162};
+  for (size_t l = 0; l < 3; ++l) {
+    const WaveformLevel& level = waveform->Level(l);
+    EXPECT_EQ(level.framesPerPoint, 1024u << (2 * l));
+    EXPECT_EQ(level.count, counts[l]);
+    const size_t click = 1000000 / level.framesPerPoint;
+    EXPECT_EQ(level.points[click].min, std::lround(-0.9f * Waveform::kFullScale));
+    EXPECT_EQ(level.points[click + 1].min, std::lround(0.1f * Waveform::kFullScale));
+    EXPECT_NEAR(level.points[click + 1].rms, 0.1f * Waveform::kFullScale, 1.0);
+  }
+
+  EXPECT_EQ(&waveform->LevelFor(1000), &waveform->Level(0));
+  EXPECT_EQ(&waveform->LevelFor(600), &waveform->Level(1));
+  EXPECT_EQ(&waveform->LevelFor(100), &waveform->Level(2));
+  EXPECT_EQ(&waveform->LevelFor(5000), &waveform->Level(0));
+}
+
+TEST(WaveformTest, MeasuresOnlyTheFirstTwoChannels) {
+  // 5.1 with a full-scale centre channel; the overview follows the front
+  // pair, which is all the engines decode for it.
+  std::vector<float> samples;
+  for (int i = 0; i < 4096; ++i) {
+    const float frame[6] = {0.2f, -0.2f, 1.0f, 0.0f, 0.0f, 0.0f};
+    samples.insert(samples.end(), frame, frame + 6);
+  }
+  const auto waveform = Build(48000, 6, samples);
+  ASSERT_TRUE(waveform);
+  EXPECT_EQ(waveform->Channels(), 6u);
+  const WaveformLevel& level = waveform->Level(0);
+  EXPECT_EQ(level.points[0].max, std::lround(0.2f * Waveform::kFullScale));
+  EXPECT_EQ(level.points[0].min, std::lround(-0.2f * Waveform::kFullScale));
+}
+
+TEST(WaveformTest, MapsWhatWasSavedAndRejectsOtherVersions) {
+  const std::string dir = ::testing::TempDir();
+  SeekIndex::Key key{dir + "waveform-track.flac", 123456, 1700000000};
+  CacheCleanup cleanup({key});
+  std::vector<float> samples(48000 * 30);
+  for (size_t i = 0; i < samples.size(); ++i) {
+    samples[i] = 0.8f * std::sin(0.01f * static_cast<float>(i)) *
+                 static_cast<float>(i) / static_cast<float>(samples.size());
+  }
+  const auto built = Build(48000, 1, samples);
+  ASSERT_TRUE(built);
+  ASSERT_TRUE(built->Save(dir, key));
+
+  const auto mapped = Waveform::Map(dir, key);
+  ASSERT_TRUE(mapped);
+  EXPECT_EQ(mapped->SampleRate(), 48000u);
+  EXPECT_EQ(mapped->Channels(), 1u);
+  EXPECT_EQ(mapped->Frames(), samples.size());
+  ASSERT_EQ(mapped->LevelCount(), built->LevelCount());
+  for (size_t l = 0; l < built->LevelCount(); ++l) {
+    const WaveformLevel& a = built->Level(l);
+    const WaveformLevel& b = mapped->Level(l);
+    EXPECT_EQ(a.framesPerPoint, b.framesPerPoint);
+    ASSERT_EQ(a.count, b.count);
+    for (size_t i = 0; i < a.count; ++i) {
+      EXPECT_EQ(a.points[i].min, b.points[i].min);
+      EXPECT_EQ(a.points[i].max, b.points[i].max);
+      EXPECT_EQ(a.points[i].rms, b.points[i].rms);
+    }
+  }
+
+  SeekIndex::Key touched = key;
+  touched.mtimeSeconds += 1;
+  EXPECT_FALSE(Waveform::Map(dir, touched));
+
+  // A damaged table or a truncated file is a miss, not a crash.
+  std::vector<uint8_t> bytes = built->Serialize(key);
+  const std::string path = dir + Waveform::CacheFileName(key);
+  std::vector<uint8_t> damaged = bytes;
+  damaged[52] ^= 1;
+  FILE* file = std::fopen(path.c_str(), "wb");
+  ASSERT_TRUE(file);
+  std::fwrite(damaged.data(), 1, damaged.size(), file);
+  std::fclose(file);
+  EXPECT_FALSE(Waveform::Map(dir, key));
+  file = std::fopen(path.c_str(), "wb");
+  ASSERT_TRUE(file);
+  std::fwrite(bytes.data(), 1, bytes.size() - 6, file);
+  std::fclose(file);
+  EXPECT_FALSE(Waveform::Map(dir, key));
+}
+
+TEST(WaveformScannerTest, GeneratesOnceAndServesFromCache) {
+  const std::string dir = ::testing::TempDir();
+  std::vector<SeekIndex::Key> keys;
+  for (int i = 0; i < 6; ++i) {
+    keys.push_back({dir + "waveform-scan-" + std::to_string(i) + ".mp3",
+                    static_cast<uint64_t>(1000 + i), 1700000000});
+  }
+  keys.push_back({dir + "waveform-scan-broken.mp3", 1, 1700000000});
+  CacheCleanup cleanup(keys);
+
+  std::atomic<int> opened{0};
+  auto open = [&](const std::string& path) -> std::unique_ptr<PcmSource> {
+    if (path.find("broken") != std::string::npos) return nullptr;
+    ++opened;
+    return std::make_unique<ToneSource>(44100, 2, 440.0,
+                                        std::vector<std::pair<uint64_t, float>>{
+                                            {44100 * 5, 0.5f}});
+  };
+
+  {
+    WaveformScanner scanner(dir, open, 3);
+    EXPECT_FALSE(scanner.Load(keys[0]));
+    scanner.Enqueue(keys);
+    scanner.Enqueue(keys);  // duplicates are dropped
+    scanner.WaitIdle();
+    const WaveformScanner::Stats stats = scanner.GetStats();
+    EXPECT_EQ(stats.tracksGenerated, 6u);
+    EXPECT_EQ(stats.tracksFailed, 1u);
+    EXPECT_EQ(stats.tracksPending, 0u);
+    EXPECT_NEAR(stats.audioSeconds, 30.0, 1e-9);
+    EXPECT_EQ(opened.load(), 6);
+
+    const auto waveform = scanner.Load(keys[3]);
+    ASSERT_TRUE(waveform);
+    EXPECT_EQ(waveform->Frames(), 44100u * 5);
+    EXPECT_NEAR(waveform->Level(0).points[10].max, 0.5f * Waveform::kFullScale, 40.0);
+    EXPECT_FALSE(scanner.Load(keys.back()));
+  }
+
+  // A new session finds everything cached and decodes nothing.
+  WaveformScanner resumed(dir, open, 2);
+  resumed.Enqueue(keys);
+  resumed.WaitIdle();
+  EXPECT_EQ(resumed.GetStats().tracksCached, 6u);
+  EXPECT_EQ(resumed.GetStats().tracksGenerated, 0u);
+  EXPECT_EQ(opened.load(), 6);
+}
+
+TEST(WaveformScannerTest, ConvertsIntegerDecodes) {
+  const std::string dir = ::testing::TempDir();
+  SeekIndex::Key key{dir + "waveform-int.wav", 77, 1700000000};
+  CacheCleanup cleanup({key});
+  WaveformScanner scanner(dir, [](const std::string&) -> std::unique_ptr<PcmSource> {
+    return std::make_unique<ConstantS16Source>(48000, -16384);
+  }, 1);
+  scanner.Enqueue({key});
+  scanner.WaitIdle();
+  const auto waveform = scanner.Load(key);
+  ASSERT_TRUE(waveform);
+  EXPECT_EQ(waveform->Frames(), 48000u);
+  const WaveformPoint& point = waveform->Level(0).points[0];
+  EXPECT_NEAR(point.min, -0.5f * Waveform::kFullScale, 1.0);
+  EXPECT_NEAR(point.max, -0.5f * Waveform::kFullScale, 1.0);
+  EXPECT_NEAR(point.rms, 0.5f * Waveform::kFullScale, 1.0);
+}
+
+}  // namespace
+}  // namespace audioengine
@@ -53,7 +53,7 @@ let package = Package(
 
         .testTarget(
             name: "AudioEngineSwiftTests",
-            dependencies: ["AudioEngineSwift"],
+            dependencies: ["AudioEngineSwift", "FFmpegBridge"],
             path: "Tests/AudioEngineSwiftTests"
         )
     ]
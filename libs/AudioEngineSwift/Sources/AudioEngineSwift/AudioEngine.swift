@@ -4,6 +4,7 @@ import CoreAudio
 import os
 import Darwin
 import Atomics
+import FFmpegBridge
 
 public enum AudioEngineError: Error {
     case audioUnit(OSStatus, String)
@@ -28,9 +29,19 @@ extension AudioEngineError: LocalizedError {
 }
 
 final class LockFreeRingBuffer {
+    /// Free space handed to a producer that writes in place. `second` is empty
+    /// unless the region wraps past the end of storage.
+    struct WritableRegions {
+        let first: UnsafeMutableBufferPointer<UInt8>
+        let second: UnsafeMutableBufferPointer<UInt8>
+
+        var count: Int { first.count + second.count }
+    }
+
     private let capacity: Int
     private let mask: Int
-    private var storage: ContiguousArray<UInt8>
+    // Raw allocation so producers can be handed stable pointers into it.
+    private let storage: UnsafeMutablePointer<UInt8>
 
     private let writeHead = ManagedAtomic<Int>(0)
     private let readHead = ManagedAtomic<Int>(0)
@@ -39,7 +50,12 @@ final class LockFreeRingBuffer {
         let rounded = LockFreeRingBuffer.nextPowerOfTwo(max(1024, capacity))
         self.capacity = rounded
         self.mask = rounded - 1
-        self.storage = ContiguousArray<UInt8>(repeating: 0, count: rounded)
+        self.storage = UnsafeMutablePointer<UInt8>.allocate(capacity: rounded)
+        self.storage.initialize(repeating: 0, count: rounded)
+    }
+
+    deinit {
+        storage.deallocate()
     }
 
     @inline(__always)
@@ -62,19 +78,16 @@ final class LockFreeRingBuffer {
 
         let samplesToWrite = min(count, available)
 
-        storage.withUnsafeMutableBufferPointer { buffer in
-            guard let baseAddress = buffer.baseAddress else { return }
-            var headIndex = localWrite & mask
-            var remaining = samplesToWrite
-            var source = samples
-
-            while remaining > 0 {
-                let chunk = min(remaining, capacity &- headIndex)
-                baseAddress.advanced(by: headIndex).update(from: source, count: chunk)
-                source = source.advanced(by: chunk)
-                headIndex = (headIndex &+ chunk) & mask
-                remaining &-= chunk
-            }
+        var headIndex = localWrite & mask
+        var remaining = samplesToWrite
+        var source = samples
+
+        while remaining > 0 {
+            let chunk = min(remaining, capacity &- headIndex)
+            storage.advanced(by: headIndex).update(from: source, count: chunk)
+            source = source.advanced(by: chunk)
+            headIndex = (headIndex &+ chunk) & mask
+            remaining &-= chunk
         }
 
         writeHead.wrappingIncrement(by: samplesToWrite, ordering: .releasing)
@@ -93,25 +106,44 @@ final class LockFreeRingBuffer {
 
         let samplesToRead = min(count, available)
 
-        storage.withUnsafeMutableBufferPointer { buffer in
-            guard let baseAddress = buffer.baseAddress else { return }
-            var tailIndex = localRead & mask
-            var remaining = samplesToRead
-            var target = destination
-
-            while remaining > 0 {
-                let chunk = min(remaining, capacity &- tailIndex)
-                target.update(from: baseAddress.advanced(by: tailIndex), count: chunk)
-                target = target.advanced(by: chunk)
-                tailIndex = (tailIndex &+ chunk) & mask
-                remaining &-= chunk
-            }
+        var tailIndex = localRead & mask
+        var remaining = samplesToRead
+        var target = destination
+
+        while remaining > 0 {
+            let chunk = min(remaining, capacity &- tailIndex)
+            target.update(from: storage.advanced(by: tailIndex), count: chunk)
+            target = target.advanced(by: chunk)
+            tailIndex = (tailIndex &+ chunk) & mask
+            remaining &-= chunk
         }
 
         readHead.wrappingIncrement(by: samplesToRead, ordering: .releasing)
         return samplesToRead
     }
 
+    /// Producer side of the in-place write path: up to `maxBytes` of free space,
+    /// split at the wrap point. Nothing is visible to the reader until
+    /// `commitWrite` is called.
+    func writableRegions(maxBytes: Int = .max) -> WritableRegions {
+        let localWrite = writeHead.load(ordering: .relaxed)
+        let localRead = readHead.load(ordering: .acquiring)
+        let free = min(max(0, capacity &- (localWrite &- localRead)), max(0, maxBytes))
+
+        let headIndex = localWrite & mask
+        let firstCount = min(free, capacity &- headIndex)
+        return WritableRegions(
+            first: UnsafeMutableBufferPointer(start: storage.advanced(by: headIndex), count: firstCount),
+            second: UnsafeMutableBufferPointer(start: storage, count: free &- firstCount)
+        )
+    }
+
+    /// Publishes `count` bytes written into the regions from `writableRegions`.
+    func commitWrite(_ count: Int) {
+        guard count > 0 else { return }
+        writeHead.wrappingIncrement(by: count, ordering: .releasing)
+    }
+
     func reset() {
         writeHead.store(0, ordering: .relaxed)
         readHead.store(0, ordering: .relaxed)
@@ -125,7 +157,7 @@ final class LockFreeRingBuffer {
     }
 }
 
-struct PCMFormat {
+struct PCMFormat: Equatable {
     var sampleRate: Double
     var channels: UInt32
     var bitDepth: UInt32
@@ -143,6 +175,8 @@ public struct PCMStatus: Sendable {
     public let bytesPerFrame: UInt32
     public let renderedFrames: Int
     public let underflows: Int
+    /// Per-channel output levels after the volume and normalization gain.
+    public let levels: LevelMeterReading
 }
 
 final class AudioEngine {
@@ -160,6 +194,12 @@ final class AudioEngine {
     private let controlQueue = DispatchQueue(label: "com.audioengine.control")
     // Use high priority for decoder to ensure it can keep up with playback
     private let decoderQueue = DispatchQueue(label: "com.audioengine.decoder", qos: .userInteractive)
+    // Builds seek indexes for long unindexed files; serial, so a file queued
+    // twice is built once and the second pass finds it cached.
+    private let seekIndexQueue = DispatchQueue(label: "com.audioengine.seekindex", qos: .utility)
+    // Generates library waveforms one batch at a time, each batch across
+    // all cores but one.
+    private let waveformQueue = DispatchQueue(label: "com.audioengine.waveform", qos: .utility)
     private let logger = Logger(subsystem: "com.audioengine.hires", category: "engine")
     private let pcmPlayer = PCMPlayer(bufferSize: 1 << 22)  // 4MB buffer for high-res audio
     private let dac = DacManager.shared
@@ -173,6 +213,51 @@ final class AudioEngine {
     private var decoderWorkItem: DispatchWorkItem?
     private var decoderShouldStop = false
 
+    /// A track opened ahead of time for gapless playback.
+    private struct ChainedTrack {
+        let url: URL
+        let decoder: FFmpegDecoder
+        /// Rendered-frame count at which the track becomes audible.
+        var boundaryFrames: Int = 0
+    }
+
+    private enum SpliceResult {
+        case spliced(FFmpegDecoder)
+        /// A track is queued but the previous splice has not been heard yet.
+        case waiting
+        case nothingQueued
+    }
+
+    /// A track opened, with its first PCM decoded, by preloadNext(url:).
+    private final class PreloadedTrack {
+        let url: URL
+        let gapless: Bool
+        var decoder: FFmpegDecoder?
+        var head: [UInt8] = []
+
+        init(url: URL, gapless: Bool) {
+            self.url = url
+            self.gapless = gapless
+        }
+    }
+
+    private let preloadQueue = DispatchQueue(label: "com.audioengine.preload", qos: .utility)
+    /// Guards preloadedTrack and preloadWorkItem; preloadQueue fills the
+    /// track in while control calls may take or replace it.
+    private let preloadLock = NSLock()
+    private var preloadedTrack: PreloadedTrack?
+    private var preloadWorkItem: DispatchWorkItem?
+
+    private var gaplessEnabled = false
+    /// Guards queuedTrack and splicedTrack, which the decoder loop touches
+    /// without going through controlQueue.
+    private let chainLock = NSLock()
+    /// Set by queueNext(url:); the decoder loop continues into it when the
+    /// current decoder runs dry.
+    private var queuedTrack: ChainedTrack?
+    /// Already in the ring after the current track, until playback reaches it.
+    private var splicedTrack: ChainedTrack?
+
     private var currentFormat = PCMFormat(sampleRate: 48_000,
                                           channels: 2,
                                           bitDepth: 32,
@@ -194,14 +279,30 @@ final class AudioEngine {
                                                     r128AlbumGain: nil)
     private var currentMetadata: TrackMetadata?
     private var fileDurationEstimateMs: Int = 0
+    /// Stream frame that rendered frame 0 corresponds to; moves on every seek.
+    private var positionBaseFrames: Int = 0
     private var currentFileURL: URL?
     private var bitPerfectModeEnabled = false
     private var autoSampleRateSwitchingEnabled = true
     private let bitPerfectAtomic = ManagedAtomic<Int>(0)
     private let volumePermille = ManagedAtomic<Int>(1000)
+    private var normalizationMode: NormalizationMode = .off
+    private var normalizationPreampDb: Double = 0
+    /// Current track's normalization gain as a Double bit pattern, read by
+    /// the render callback and multiplied in with the volume.
+    private let normalizationGainBits = ManagedAtomic<UInt64>(1.0.bitPattern)
+    /// Dithers the volume multiply on integer output (FFmpegDither.c).
+    /// Configured while the output is stopped; takes its mode from any thread.
+    private let requantizer = ffdecoder_requantizer_create()
+    /// Meters what the render callback hands the device (FFmpegLevelMeter.c).
+    /// Configured and reset while the output is stopped; read from any
+    /// thread without controlQueue.
+    private let levelMeter = fflevelmeter_create()
     private var defaultDeviceListener: AudioObjectPropertyListenerBlock?
 
     var onPlaybackEnded: (() -> Void)?
+    /// Called on the decoder thread when a queued track becomes audible.
+    var onTrackChanged: (() -> Void)?
 
     private init() {
         startMonitoringDefaultDeviceChanges()
@@ -214,6 +315,8 @@ final class AudioEngine {
             tearDownAudioUnitLocked()
         }
         stopMonitoringDefaultDeviceChanges()
+        ffdecoder_requantizer_free(requantizer)
+        fflevelmeter_free(levelMeter)
     }
 
     func initialize() {}
@@ -222,77 +325,206 @@ final class AudioEngine {
         try controlQueue.sync {
             logger.info("Loading file: \(url.lastPathComponent, privacy: .public)")
 
+            // Stopping the output unit also waits out any render callback.
             internalStop()
-            // Tear down AudioUnit to prevent render callbacks from using stale format during update
-            tearDownAudioUnitLocked()
             // Reset buffer first to unblock decoder if it's stuck in pushBytes due to full buffer
             pcmPlayer.reset()
+            positionBaseFrames = 0
             stopDecoderLocked()
+            clearChainedTracksLocked()
             currentMetadata = nil
 
-            guard let decoder = FFmpegDecoder(url: url) else {
+            let previousFormat = currentFormat
+            if let preloaded = takePreloadedTrackLocked(url: url) {
+                logger.info("Using preloaded \(url.lastPathComponent, privacy: .public) with \(preloaded.head.count) bytes decoded")
+                applyDecoderLocked(preloaded.decoder, url: url)
+                requestSeekIndexLocked(for: url, decoder: preloaded.decoder)
+                try configureOutputLocked(previousFormat: previousFormat)
+                startDecoderLoopLocked(head: preloaded.head)
+                return
+            }
+
+            guard let decoder = FFmpegDecoder(url: url, gapless: gaplessEnabled) else {
                 let message = FFmpegDecoder.lastErrorMessage
                 logger.error("Failed to create decoder for \(url.lastPathComponent, privacy: .public)")
+                tearDownAudioUnitLocked()
                 throw AudioEngineError.decoderUnavailable(message)
             }
 
-            currentFileURL = url
-            self.decoder = decoder
-
-            currentFormat = PCMFormat(sampleRate: Double(decoder.sampleRate),
-                                      channels: UInt32(decoder.channels),
-                                      bitDepth: UInt32(decoder.bitDepth),
-                                      isFloat: decoder.sampleFormat.isFloat)
-            currentSampleFormat = decoder.sampleFormat
-            currentCodecName = decoder.codecName
-            currentContainerName = decoder.containerName
-            currentSourceBitRateKbps = decoder.sourceBitrateKbps
-            currentChannelLayout = decoder.channelLayout
-            currentSampleFormatName = decoder.sampleFormatName
-            currentFileSizeBytes = decoder.fileSizeBytes
-            currentStartTimeSeconds = decoder.startTimeSeconds
-            currentTags = TrackTags(title: decoder.title,
-                                    artist: decoder.artist,
-                                    album: decoder.album,
-                                    albumArtist: decoder.albumArtist,
-                                    genre: decoder.genre,
-                                    comment: decoder.comment,
-                                    date: decoder.date,
-                                    trackNumber: decoder.trackNumber,
-                                    discNumber: decoder.discNumber)
-            currentReplayGain = TrackReplayGain(trackGainDb: decoder.replayGainTrackDb,
-                                                albumGainDb: decoder.replayGainAlbumDb,
-                                                trackPeak: decoder.replayPeakTrack,
-                                                albumPeak: decoder.replayPeakAlbum,
-                                                r128TrackGain: decoder.r128TrackGain,
-                                                r128AlbumGain: decoder.r128AlbumGain)
-            pcmPlayer.setFormat(currentFormat)
-
-            fileDurationEstimateMs = decoder.durationMs
-
-            let pcmInfo = currentFormat.toTrackFormatInfo(formatLabel: decoder.sampleFormat.displayLabel)
-            currentMetadata = TrackMetadata(url: url,
-                                            containerName: decoder.containerName,
-                                            codecName: decoder.codecName,
-                                            sourceBitrateKbps: decoder.sourceBitrateKbps,
-                                            channelLayout: decoder.channelLayout,
-                                            durationMs: fileDurationEstimateMs,
-                                            pcm: pcmInfo,
-                                            sampleFormatName: decoder.sampleFormatName,
-                                            fileSizeBytes: decoder.fileSizeBytes,
-                                            startTimeSeconds: decoder.startTimeSeconds,
-                                            tags: currentTags,
-                                            replayGain: currentReplayGain)
+            let timings = decoder.openTimings
+            logger.debug("Opened \(url.lastPathComponent, privacy: .public) in \(timings.totalMs, format: .fixed(precision: 1))ms (fast: \(timings.usedFastOpen), input \(timings.openInputMs, format: .fixed(precision: 1)), stream info \(timings.findStreamInfoMs, format: .fixed(precision: 1)), codec \(timings.codecOpenMs, format: .fixed(precision: 1)), probe \(timings.probeDecodeMs, format: .fixed(precision: 1)), metadata \(timings.metadataMs, format: .fixed(precision: 1)))")
 
-            do {
-                try syncDeviceConfigurationLocked()
-            } catch {
-                logger.error("Failed to sync device with decoder: \(error.localizedDescription, privacy: .public)")
-                throw error
+            applyDecoderLocked(decoder, url: url)
+            requestSeekIndexLocked(for: url, decoder: decoder)
+            try configureOutputLocked(previousFormat: previousFormat)
+            startDecoderLoopLocked()
+        }
+    }
+
+    /// Keeps the stopped output unit when the stream format is unchanged;
+    /// otherwise re-syncs the device rate and rebuilds the unit.
+    private func configureOutputLocked(previousFormat: PCMFormat) throws {
+        // The output is stopped, so the render callback is not in the
+        // requantizer. Float and 8-bit formats leave it unconfigured.
+        let type: FFSampleType
+        switch (currentFormat.isFloat, currentFormat.bitDepth) {
+        case (true, _), (false, ..<9): type = FFDEC_SAMPLE_F32
+        case (false, ..<17): type = FFDEC_SAMPLE_S16
+        case (false, ..<25): type = FFDEC_SAMPLE_S24
+        default: type = FFDEC_SAMPLE_S32
+        }
+        ffdecoder_requantizer_configure(requantizer, type, UInt32(currentFormat.sampleRate),
+                                        currentFormat.channels)
+        // The meter takes every format but 8-bit, which it leaves unconfigured.
+        let meterType = currentFormat.isFloat && currentFormat.bitDepth > 32 ? FFDEC_SAMPLE_F64 : type
+        let meterChannels = currentFormat.isFloat || currentFormat.bitDepth > 8 ? currentFormat.channels : 0
+        fflevelmeter_configure(levelMeter, meterType, UInt32(currentFormat.sampleRate), meterChannels)
+        if audioUnit != nil && currentFormat == previousFormat {
+            logger.debug("Stream format unchanged; reusing output unit")
+            return
+        }
+        tearDownAudioUnitLocked()
+        do {
+            try syncDeviceConfigurationLocked()
+        } catch {
+            logger.error("Failed to sync device with decoder: \(error.localizedDescription, privacy: .public)")
+            throw error
+        }
+    }
+
+    /// Opens `url` and decodes its first `prebufferThreshold` bytes in the
+    /// background, so a following loadFile(url:) neither opens nor probes
+    /// and play() starts without waiting for the prebuffer. Replaces any
+    /// earlier preload.
+    func preloadNext(url: URL) {
+        controlQueue.sync {
+            let gapless = gaplessEnabled
+            preloadLock.lock()
+            if let current = preloadedTrack, current.url == url, current.gapless == gapless {
+                preloadLock.unlock()
+                return
             }
+            let replaced = preloadedTrack
+            preloadWorkItem?.cancel()
+            let track = PreloadedTrack(url: url, gapless: gapless)
+            let logger = self.logger
+            let workItem = DispatchWorkItem { [weak self] in
+                guard let decoder = FFmpegDecoder(url: url, gapless: gapless) else {
+                    logger.debug("Preload failed for \(url.lastPathComponent, privacy: .public): \(FFmpegDecoder.lastErrorMessage, privacy: .public)")
+                    return
+                }
+                let head = AudioEngine.decodeHead(of: decoder, maxBytes: AudioEngine.prebufferThreshold)
+                guard let self else {
+                    decoder.close()
+                    return
+                }
+                self.preloadLock.lock()
+                let current = self.preloadedTrack === track
+                if current {
+                    track.decoder = decoder
+                    track.head = head
+                }
+                self.preloadLock.unlock()
+                if !current {
+                    decoder.close()
+                }
+            }
+            preloadedTrack = track
+            preloadWorkItem = workItem
+            preloadLock.unlock()
+            replaced?.decoder?.close()
+            preloadQueue.async(execute: workItem)
+        }
+    }
 
-            startDecoderLoopLocked()
+    /// Hands over the preloaded track for `url`, waiting for it if it is
+    /// still being opened. Nil if something else was preloaded or the open
+    /// failed.
+    private func takePreloadedTrackLocked(url: URL) -> (decoder: FFmpegDecoder, head: [UInt8])? {
+        preloadLock.lock()
+        guard let track = preloadedTrack, track.url == url, track.gapless == gaplessEnabled else {
+            preloadLock.unlock()
+            return nil
+        }
+        let workItem = preloadWorkItem
+        preloadLock.unlock()
+        // Finishing an open already under way beats starting a second one.
+        workItem?.wait()
+
+        preloadLock.lock()
+        preloadedTrack = nil
+        preloadWorkItem = nil
+        preloadLock.unlock()
+        guard let decoder = track.decoder else { return nil }
+        return (decoder, track.head)
+    }
+
+    private static func decodeHead(of decoder: FFmpegDecoder, maxBytes: Int) -> [UInt8] {
+        let frameBytes = max(1, decoder.bytesPerFrame)
+        var head = [UInt8](repeating: 0, count: maxBytes - maxBytes % frameBytes)
+        var filled = 0
+        head.withUnsafeMutableBufferPointer { buffer in
+            guard let base = buffer.baseAddress else { return }
+            while filled < buffer.count {
+                let read = decoder.read(into: base + filled, maxBytes: buffer.count - filled)
+                if read <= 0 { break }
+                filled += read
+            }
         }
+        head.removeSubrange(filled...)
+        return head
+    }
+
+    /// Makes `decoder` the current track: format, metadata and duration.
+    private func applyDecoderLocked(_ decoder: FFmpegDecoder, url: URL) {
+        currentFileURL = url
+        self.decoder = decoder
+
+        currentFormat = PCMFormat(sampleRate: Double(decoder.sampleRate),
+                                  channels: UInt32(decoder.channels),
+                                  bitDepth: UInt32(decoder.bitDepth),
+                                  isFloat: decoder.sampleFormat.isFloat)
+        currentSampleFormat = decoder.sampleFormat
+        currentCodecName = decoder.codecName
+        currentContainerName = decoder.containerName
+        currentSourceBitRateKbps = decoder.sourceBitrateKbps
+        currentChannelLayout = decoder.channelLayout
+        currentSampleFormatName = decoder.sampleFormatName
+        currentFileSizeBytes = decoder.fileSizeBytes
+        currentStartTimeSeconds = decoder.startTimeSeconds
+        currentTags = TrackTags(title: decoder.title,
+                                artist: decoder.artist,
+                                album: decoder.album,
+                                albumArtist: decoder.albumArtist,
+                                genre: decoder.genre,
+                                comment: decoder.comment,
+                                date: decoder.date,
+                                trackNumber: decoder.trackNumber,
+                                discNumber: decoder.discNumber)
+        currentReplayGain = TrackReplayGain(trackGainDb: decoder.replayGainTrackDb,
+                                            albumGainDb: decoder.replayGainAlbumDb,
+                                            trackPeak: decoder.replayPeakTrack,
+                                            albumPeak: decoder.replayPeakAlbum,
+                                            r128TrackGain: decoder.r128TrackGain,
+                                            r128AlbumGain: decoder.r128AlbumGain)
+        updateNormalizationGainLocked()
+        pcmPlayer.setFormat(currentFormat)
+
+        fileDurationEstimateMs = decoder.durationMs
+
+        let pcmInfo = currentFormat.toTrackFormatInfo(formatLabel: decoder.sampleFormat.displayLabel)
+        currentMetadata = TrackMetadata(url: url,
+                                        containerName: decoder.containerName,
+                                        codecName: decoder.codecName,
+                                        sourceBitrateKbps: decoder.sourceBitrateKbps,
+                                        channelLayout: decoder.channelLayout,
+                                        durationMs: fileDurationEstimateMs,
+                                        pcm: pcmInfo,
+                                        sampleFormatName: decoder.sampleFormatName,
+                                        fileSizeBytes: decoder.fileSizeBytes,
+                                        startTimeSeconds: decoder.startTimeSeconds,
+                                        tags: currentTags,
+                                        replayGain: currentReplayGain)
     }
 
     func play() throws {
@@ -355,6 +587,7 @@ final class AudioEngine {
                 try checkStatus(AudioOutputUnitStop(unit), operation: "AudioOutputUnitStop")
             }
             playbackState = .paused
+            fflevelmeter_reset(levelMeter)
             releaseHogModeIfNeededLocked()
         }
     }
@@ -363,7 +596,55 @@ final class AudioEngine {
         try controlQueue.sync {
             try stopPlaybackLocked()
             pcmPlayer.reset()
+            positionBaseFrames = 0
             stopDecoderLocked()
+            clearChainedTracksLocked()
+        }
+    }
+
+    /// Gapless mode trims encoder delay/padding from newly loaded tracks and
+    /// allows queueNext(url:). Turning it off drops a queued track.
+    func setGapless(enabled: Bool) {
+        controlQueue.sync {
+            gaplessEnabled = enabled
+            guard !enabled else { return }
+            chainLock.lock()
+            let dropped = queuedTrack
+            queuedTrack = nil
+            chainLock.unlock()
+            dropped?.decoder.close()
+        }
+    }
+
+    /// Opens `url` now and splices it onto the end of the current track with
+    /// no gap. Throws when gapless mode is off or the PCM formats differ; the
+    /// caller should load the track when playback ends instead.
+    func queueNext(url: URL) throws {
+        try controlQueue.sync {
+            guard gaplessEnabled else {
+                throw AudioEngineError.decoderUnavailable("Gapless mode is off")
+            }
+            guard decoder != nil else {
+                throw AudioEngineError.decoderUnavailable("Call loadFile(url:) before queueNext(url:).")
+            }
+            guard let next = FFmpegDecoder(url: url, gapless: true) else {
+                throw AudioEngineError.decoderUnavailable(FFmpegDecoder.lastErrorMessage)
+            }
+            collectTrackChangeLocked()
+            guard Double(next.sampleRate) == currentFormat.sampleRate,
+                  UInt32(next.channels) == currentFormat.channels,
+                  UInt32(next.bitDepth) == currentFormat.bitDepth,
+                  next.sampleFormat.isFloat == currentFormat.isFloat else {
+                next.close()
+                throw AudioEngineError.decoderUnavailable("Next track's PCM format differs from the current track")
+            }
+            requestSeekIndexLocked(for: url, decoder: next)
+            chainLock.lock()
+            let replaced = queuedTrack
+            queuedTrack = ChainedTrack(url: url, decoder: next)
+            chainLock.unlock()
+            replaced?.decoder.close()
+            logger.info("Queued \(url.lastPathComponent, privacy: .public) for gapless playback")
         }
     }
 
@@ -380,9 +661,12 @@ final class AudioEngine {
         }
 
         try controlQueue.sync {
-            guard self.decoder != nil, let url = self.currentFileURL else {
+            // Seeking past a splice point lands in the track that is playing.
+            collectTrackChangeLocked()
+            guard let oldDecoder = self.decoder, let url = self.currentFileURL else {
                 throw AudioEngineError.decoderUnavailable("Cannot seek without an active file")
             }
+            let gapless = oldDecoder.gapless
 
             // Flush buffered audio before stopping the decoder to avoid blocking
             // when the output unit is paused and the ring buffer is full.
@@ -390,12 +674,13 @@ final class AudioEngine {
 
             // Stop the old decoder loop and close it to release all FFmpeg resources
             stopDecoderLocked()
+            requeueSplicedTrackLocked()
 
             // Reset the PCM buffer before starting the new decoder
             pcmPlayer.reset()
 
             // Re-open the decoder to get a fresh state
-            guard let newDecoder = FFmpegDecoder(url: url) else {
+            guard let newDecoder = FFmpegDecoder(url: url, gapless: gapless) else {
                 let message = FFmpegDecoder.lastErrorMessage
                 logger.error("Failed to re-create decoder for seek: \(url.lastPathComponent, privacy: .public)")
                 throw AudioEngineError.decoderUnavailable(message)
@@ -403,7 +688,9 @@ final class AudioEngine {
             self.decoder = newDecoder
             
             // Seek on the new decoder *before* starting the read loop
-            newDecoder.seek(toMs: position)
+            let target = Int(Double(position) / 1000.0 * currentFormat.sampleRate)
+            positionBaseFrames = newDecoder.seek(toMs: position) ?? target
+            logger.debug("Seek to \(position)ms landed at frame \(self.positionBaseFrames) (target \(target)) in \(newDecoder.lastSeekLatencyUs)us")
 
             // Start the decoder loop to begin filling the buffer from the new position
             startDecoderLoopLocked()
@@ -435,14 +722,18 @@ final class AudioEngine {
 
     var currentPositionMs: Int {
         controlQueue.sync {
+            collectTrackChangeLocked()
             guard currentFormat.bytesPerFrame > 0 else { return 0 }
-            let frames = pcmPlayer.renderedFrames
+            let frames = positionBaseFrames + pcmPlayer.renderedFrames
             return Int((Double(frames) / currentFormat.sampleRate) * 1000.0)
         }
     }
 
     var durationMs: Int {
-        controlQueue.sync { fileDurationEstimateMs }
+        controlQueue.sync {
+            collectTrackChangeLocked()
+            return fileDurationEstimateMs
+        }
     }
 
     var isPlaying: Bool {
@@ -450,26 +741,57 @@ final class AudioEngine {
     }
 
     func getPCMStatus() -> PCMStatus {
-        controlQueue.sync {
+        // The meter publishes through a sequence lock, so it is read outside
+        // controlQueue and never waits on a control operation.
+        let levels = meterLevels()
+        return controlQueue.sync {
             PCMStatus(sampleRate: currentFormat.sampleRate,
                       channels: currentFormat.channels,
                       bitDepth: currentFormat.bitDepth,
                       bytesPerFrame: currentFormat.bytesPerFrame,
                       renderedFrames: pcmPlayer.renderedFrames,
-                      underflows: pcmPlayer.underflows)
+                      underflows: pcmPlayer.underflows,
+                      levels: levels)
         }
     }
 
+    /// Latest meter readings; lock-free from any thread, for UIs polling at
+    /// frame rate.
+    func meterLevels() -> LevelMeterReading {
+        var reading = FFLevelReading()
+        fflevelmeter_read(levelMeter, &reading)
+        return LevelMeterReading(reading)
+    }
+
+    /// Ballistics of the meters; any thread, applied with the next render
+    /// callback.
+    func setMeterOptions(_ options: LevelMeterOptions) {
+        var value = FFLevelMeterOptions(hold_ms: options.holdMs,
+                                        decay_db_per_second: options.decayDbPerSecond,
+                                        rms_window_ms: options.rmsWindowMs,
+                                        true_peak: options.truePeak ? 1 : 0)
+        fflevelmeter_set_options(levelMeter, &value)
+    }
+
     func currentTrackInfo() -> TrackFormatInfo? {
-        controlQueue.sync { currentMetadata?.pcm }
+        controlQueue.sync {
+            collectTrackChangeLocked()
+            return currentMetadata?.pcm
+        }
     }
 
     func currentTrackURL() -> URL? {
-        controlQueue.sync { currentMetadata?.url }
+        controlQueue.sync {
+            collectTrackChangeLocked()
+            return currentMetadata?.url
+        }
     }
 
     func currentTrackMetadata() -> TrackMetadata? {
-        controlQueue.sync { currentMetadata }
+        controlQueue.sync {
+            collectTrackChangeLocked()
+            return currentMetadata
+        }
     }
 
     func setVolume(_ value: Double) throws {
@@ -486,6 +808,38 @@ final class AudioEngine {
         Double(volumePermille.load(ordering: .acquiring)) / 1000.0
     }
 
+    /// Loudness normalization from ReplayGain/R128 tags. The gain is resolved
+    /// when a track becomes current and applied in the volume multiply,
+    /// capped so the tagged peak stays under -1 dBFS. Bit-perfect mode
+    /// bypasses it along with the volume.
+    func setNormalization(mode: NormalizationMode, preampDb: Double) {
+        controlQueue.sync {
+            collectTrackChangeLocked()
+            normalizationMode = mode
+            normalizationPreampDb = preampDb
+            updateNormalizationGainLocked()
+        }
+    }
+
+    /// Dither for the volume and normalization gain on integer output.
+    /// F-weighted by default; bit-perfect output is never touched.
+    func setDither(mode: DitherMode) {
+        let value: FFDitherMode
+        switch mode {
+        case .off: value = FFDEC_DITHER_OFF
+        case .tpdf: value = FFDEC_DITHER_TPDF
+        case .highpass: value = FFDEC_DITHER_HIGHPASS
+        case .fWeighted: value = FFDEC_DITHER_FWEIGHTED
+        }
+        ffdecoder_requantizer_set_mode(requantizer, value)
+    }
+
+    private func updateNormalizationGainLocked() {
+        let gain = currentReplayGain.normalizationGain(mode: normalizationMode,
+                                                       preampDb: normalizationPreampDb)
+        normalizationGainBits.store(gain.bitPattern, ordering: .releasing)
+    }
+
     func setBitPerfectMode(enabled: Bool) throws {
         try controlQueue.sync {
             let wasPlaying = playbackState == .playing
@@ -552,11 +906,13 @@ final class AudioEngine {
         }
     }
 
-    private func startDecoderLoopLocked() {
+    /// `head` is PCM already decoded from the start of the track (see
+    /// preloadNext(url:)); it goes into the ring ahead of the decoder output.
+    private func startDecoderLoopLocked(head: [UInt8] = []) {
         decoderShouldStop = false
 
         let workItem = DispatchWorkItem { [weak self] in
-            self?.decoderLoop()
+            self?.decoderLoop(head: head)
         }
 
         decoderWorkItem = workItem
@@ -568,35 +924,68 @@ final class AudioEngine {
         decoderQueue.async(execute: workItem)
     }
 
-    private func decoderLoop() {
-        guard let decoder else { return }
+    private func decoderLoop(head: [UInt8]) {
+        guard var decoder else { return }
 
         // Use larger chunk size for better decoding efficiency
         // 16384 frames provides good balance between latency and throughput for high-res audio
         let chunkSize = max(Int(currentFormat.bytesPerFrame) * 16384, 65536)
-        var scratch = [UInt8](repeating: 0, count: chunkSize)
+        let minimumWrite = max(1, Int(currentFormat.bytesPerFrame))
+        let ring = pcmPlayer.ring
         var consecutiveEmptyReads = 0
         let maxConsecutiveEmptyReads = 5  // Reduced threshold for faster EOF detection
         var totalBytesDecoded: Int64 = 0
         let startTime = Date()
         var lastLogTime = startTime
-        var reachedEOF = false
+        // Rendered-frame count at which the last spliced track becomes audible.
+        var pendingBoundary: Int?
+
+        if !head.isEmpty {
+            // The ring was just reset and holds far more than a preloaded head.
+            let written = head.withUnsafeBufferPointer { buffer -> Int in
+                guard let base = buffer.baseAddress else { return 0 }
+                return ring.write(from: base, count: buffer.count)
+            }
+            totalBytesDecoded += Int64(written)
+        }
 
         logger.info("Decoder loop started. ChunkSize=\(chunkSize), Format=\(self.currentFormat.sampleRate)Hz/\(self.currentFormat.bitDepth)bit/\(self.currentFormat.channels)ch")
 
         while !decoderShouldStop {
-            let decodeStart = Date()
-            let bytesRead: Int = scratch.withUnsafeMutableBufferPointer { buffer in
-                guard let base = buffer.baseAddress else { return 0 }
-                return decoder.read(into: base, maxBytes: buffer.count)
+            notifyTrackChangeIfReached(&pendingBoundary)
+            // Decode straight into the ring's free space; wait while it is full.
+            let regions = ring.writableRegions(maxBytes: chunkSize)
+            if regions.count < minimumWrite {
+                Thread.sleep(forTimeInterval: 0.001)
+                continue
             }
+            let decodeStart = Date()
+            let bytesRead = decoder.read(into: regions)
             let decodeTime = Date().timeIntervalSince(decodeStart)
 
             if bytesRead <= 0 {
                 consecutiveEmptyReads += 1
                 if consecutiveEmptyReads >= maxConsecutiveEmptyReads {
+                    let framesWritten = Int(totalBytesDecoded) / minimumWrite
+                    switch spliceQueuedTrack(atFrame: framesWritten) {
+                    case .spliced(let next):
+                        logger.info("Spliced next track at frame \(framesWritten)")
+                        decoder = next
+                        pendingBoundary = framesWritten
+                        consecutiveEmptyReads = 0
+                        continue
+                    case .waiting:
+                        Thread.sleep(forTimeInterval: 0.005)
+                        continue
+                    case .nothingQueued:
+                        break
+                    }
                     logger.info("Decoder reached EOF. Total decoded: \(totalBytesDecoded) bytes")
-                    reachedEOF = true
+                    if !decoderShouldStop && waitForPlaybackCompletion(pendingBoundary: &pendingBoundary) {
+                        // Queued while the buffer drained; splice it on the next pass.
+                        consecutiveEmptyReads = maxConsecutiveEmptyReads - 1
+                        continue
+                    }
                     break
                 }
                 Thread.sleep(forTimeInterval: 0.005)
@@ -606,10 +995,7 @@ final class AudioEngine {
             consecutiveEmptyReads = 0
             totalBytesDecoded += Int64(bytesRead)
 
-            scratch.withUnsafeBufferPointer { ptr in
-                guard let base = ptr.baseAddress else { return }
-                pcmPlayer.pushBytes(base, count: bytesRead)
-            }
+            ring.commitWrite(bytesRead)
 
             let underflows = pcmPlayer.consumeUnderflows()
             if underflows > 0 {
@@ -630,17 +1016,22 @@ final class AudioEngine {
             }
         }
 
-        if reachedEOF && !decoderShouldStop {
-            waitForPlaybackCompletion()
-        }
-        
         logger.info("Decoder loop ended. Total decoded: \(totalBytesDecoded) bytes")
     }
 
-    private func waitForPlaybackCompletion() {
+    /// Returns true when a track was queued before the buffer ran dry; the
+    /// decoder loop then carries on into it.
+    private func waitForPlaybackCompletion(pendingBoundary: inout Int?) -> Bool {
         logger.info("Waiting for playback buffer to empty...")
         // Wait until buffer is empty or we are told to stop
         while !decoderShouldStop {
+            notifyTrackChangeIfReached(&pendingBoundary)
+            chainLock.lock()
+            let hasQueuedTrack = queuedTrack != nil
+            chainLock.unlock()
+            if hasQueuedTrack {
+                return true
+            }
             if pcmPlayer.bufferedBytes == 0 {
                 logger.info("Playback buffer empty. Triggering onPlaybackEnded.")
                 onPlaybackEnded?()
@@ -648,6 +1039,82 @@ final class AudioEngine {
             }
             Thread.sleep(forTimeInterval: 0.05)
         }
+        return false
+    }
+
+    /// Hands the decoder loop the queued track, recording where in the ring
+    /// it starts. Runs on the decoder thread.
+    private func spliceQueuedTrack(atFrame boundary: Int) -> SpliceResult {
+        chainLock.lock()
+        defer { chainLock.unlock() }
+        guard var next = queuedTrack else { return .nothingQueued }
+        // One splice point is tracked at a time; a short track must start
+        // playing before the one after it is attached.
+        guard splicedTrack == nil else { return .waiting }
+        queuedTrack = nil
+        next.boundaryFrames = boundary
+        splicedTrack = next
+        return .spliced(next.decoder)
+    }
+
+    private func notifyTrackChangeIfReached(_ pendingBoundary: inout Int?) {
+        guard let boundary = pendingBoundary, pcmPlayer.renderedFrames >= boundary else { return }
+        pendingBoundary = nil
+        controlQueue.async { [weak self] in
+            self?.collectTrackChangeLocked()
+        }
+        onTrackChanged?()
+    }
+
+    /// Switches the current-track state to the spliced track once playback
+    /// has reached it. Returns true on the switch.
+    @discardableResult
+    private func collectTrackChangeLocked() -> Bool {
+        chainLock.lock()
+        guard let spliced = splicedTrack, pcmPlayer.renderedFrames >= spliced.boundaryFrames else {
+            chainLock.unlock()
+            return false
+        }
+        splicedTrack = nil
+        chainLock.unlock()
+
+        let previous = decoder
+        applyDecoderLocked(spliced.decoder, url: spliced.url)
+        // Position restarts at zero on the new track's first rendered frame.
+        positionBaseFrames = -spliced.boundaryFrames
+        previous?.close()
+        logger.info("Now playing \(spliced.url.lastPathComponent, privacy: .public) (gapless)")
+        return true
+    }
+
+    /// After a seek back into the current track, the spliced track has to be
+    /// decoded again from its start. Call with the decoder loop stopped.
+    private func requeueSplicedTrackLocked() {
+        chainLock.lock()
+        let spliced = splicedTrack
+        splicedTrack = nil
+        chainLock.unlock()
+        guard let spliced else { return }
+
+        guard spliced.decoder.seek(toMs: 0) != nil else {
+            spliced.decoder.close()
+            return
+        }
+        // It comes next again; a track queued behind it is dropped.
+        chainLock.lock()
+        let dropped = queuedTrack
+        queuedTrack = ChainedTrack(url: spliced.url, decoder: spliced.decoder)
+        chainLock.unlock()
+        dropped?.decoder.close()
+    }
+
+    private func clearChainedTracksLocked() {
+        chainLock.lock()
+        let dropped = [queuedTrack, splicedTrack]
+        queuedTrack = nil
+        splicedTrack = nil
+        chainLock.unlock()
+        dropped.forEach { $0?.decoder.close() }
     }
 
     private func validateBitPerfectSupportLocked() throws {
@@ -675,6 +1142,72 @@ final class AudioEngine {
         }
     }
 
+    private static let seekIndexDirectory: URL? = {
+        guard let caches = FileManager.default.urls(for: .cachesDirectory, in: .userDomainMask).first else {
+            return nil
+        }
+        let directory = caches.appendingPathComponent("SeekIndex", isDirectory: true)
+        do {
+            try FileManager.default.createDirectory(at: directory, withIntermediateDirectories: true)
+        } catch {
+            return nil
+        }
+        return directory
+    }()
+
+    private static let waveformDirectory: URL? = {
+        guard let caches = FileManager.default.urls(for: .cachesDirectory, in: .userDomainMask).first else {
+            return nil
+        }
+        let directory = caches.appendingPathComponent("Waveforms", isDirectory: true)
+        do {
+            try FileManager.default.createDirectory(at: directory, withIntermediateDirectories: true)
+        } catch {
+            return nil
+        }
+        return directory
+    }()
+
+    /// Decodes `urls` in the background and caches a seekbar waveform for
+    /// each; files already cached are skipped without decoding. Runs at
+    /// utility QoS and never touches the decoder or control queue.
+    func generateWaveforms(for urls: [URL]) {
+        guard let directory = AudioEngine.waveformDirectory, !urls.isEmpty else { return }
+        let logger = self.logger
+        waveformQueue.async {
+            let workers = Swift.max(ProcessInfo.processInfo.activeProcessorCount - 1, 1)
+            DispatchQueue.concurrentPerform(iterations: workers) { worker in
+                for index in stride(from: worker, to: urls.count, by: workers) {
+                    if !TrackWaveform.build(for: urls[index], cacheDirectory: directory) {
+                        // The bridge's last-error string is shared, so it means
+                        // little with several builds running.
+                        logger.debug("Waveform unavailable for \(urls[index].lastPathComponent, privacy: .public)")
+                    }
+                }
+            }
+        }
+    }
+
+    /// Cached waveform for `url`, or nil until `generateWaveforms(for:)`
+    /// has produced it. Maps the cache file; cheap enough for the UI thread.
+    func waveform(for url: URL) -> TrackWaveform? {
+        guard let directory = AudioEngine.waveformDirectory else { return nil }
+        return TrackWaveform.open(for: url, cacheDirectory: directory)
+    }
+
+    /// Long MP3/FLAC/ADTS files get a frame-offset table built in the
+    /// background; seeks use it as soon as it is cached.
+    private func requestSeekIndexLocked(for url: URL, decoder: FFmpegDecoder) {
+        guard decoder.wantsSeekIndex, let directory = AudioEngine.seekIndexDirectory else { return }
+        decoder.attachSeekIndex(cacheDirectory: directory)
+        let logger = self.logger
+        seekIndexQueue.async {
+            if !FFmpegDecoder.buildSeekIndex(for: url, cacheDirectory: directory) {
+                logger.debug("Seek index unavailable for \(url.lastPathComponent, privacy: .public): \(FFmpegDecoder.lastErrorMessage, privacy: .public)")
+            }
+        }
+    }
+
     private func stopDecoderLocked() {
         decoderShouldStop = true
         decoderWorkItem?.wait()
@@ -902,6 +1435,8 @@ final class AudioEngine {
             try checkStatus(AudioOutputUnitStop(unit), operation: "AudioOutputUnitStop")
         }
         playbackState = .stopped
+        // Nothing decays without render callbacks.
+        fflevelmeter_reset(levelMeter)
         releaseHogModeIfNeededLocked()
     }
 
@@ -1048,12 +1583,15 @@ final class AudioEngine {
             let pulled = pcmPlayer.pullBytes(into: destination, count: bytesNeeded)
             let isBitPerfect = bitPerfectAtomic.load(ordering: .acquiring) == 1
             if pulled > 0 && !isBitPerfect {
-                let volumeValue = volumePermille.load(ordering: .acquiring)
-                if volumeValue < 1000 {
-                    let gain = Double(volumeValue) / 1000.0
+                let volume = Double(volumePermille.load(ordering: .acquiring)) / 1000.0
+                let normalization = Double(bitPattern: normalizationGainBits.load(ordering: .acquiring))
+                let gain = volume * normalization
+                if gain != 1.0 {
                     applyVolume(to: destination, byteCount: pulled, volume: gain)
                 }
             }
+            // The whole buffer, so an underrun's silence lets the meters fall.
+            fflevelmeter_process(levelMeter, destination, Int(frameCount))
             
             // Log if we're running low on buffer (less than 50% of needed)
             if pulled < bytesNeeded && bufferedBefore < bytesNeeded * 2 {
@@ -1079,43 +1617,34 @@ final class AudioEngine {
 
     private func applyVolume(to buffer: UnsafeMutablePointer<UInt8>, byteCount: Int, volume: Double) {
         guard byteCount > 0 else { return }
+        let bitDepth = Int(currentFormat.bitDepth)
+        let type: FFSampleType
+        let bytesPerSample: Int
         if currentFormat.isFloat {
-            if Int(currentFormat.bitDepth) > 32 {
-                let sampleCount = byteCount / MemoryLayout<Double>.size
-                let gain = volume
-                buffer.withMemoryRebound(to: Double.self, capacity: sampleCount) { ptr in
-                    for i in 0..<sampleCount { ptr[i] *= gain }
-                }
-            } else {
-                let sampleCount = byteCount / MemoryLayout<Float>.size
-                let gain = Float(volume)
-                buffer.withMemoryRebound(to: Float.self, capacity: sampleCount) { ptr in
-                    for i in 0..<sampleCount { ptr[i] *= gain }
+            (type, bytesPerSample) = bitDepth > 32 ? (FFDEC_SAMPLE_F64, 8) : (FFDEC_SAMPLE_F32, 4)
+        } else {
+            switch bitDepth {
+            case ..<9:
+                let sampleCount = byteCount / MemoryLayout<Int8>.size
+                buffer.withMemoryRebound(to: Int8.self, capacity: sampleCount) { ptr in
+                    applyVolume(toInt8: ptr, count: sampleCount, gain: volume)
                 }
+                return
+            case ..<17:
+                (type, bytesPerSample) = (FFDEC_SAMPLE_S16, 2)
+            case ..<25:
+                (type, bytesPerSample) = (FFDEC_SAMPLE_S24, 3)
+            default:
+                (type, bytesPerSample) = (FFDEC_SAMPLE_S32, 4)
             }
-            return
         }
-
-        let bitDepth = Int(currentFormat.bitDepth)
-        switch bitDepth {
-        case ..<9:
-            let sampleCount = byteCount / MemoryLayout<Int8>.size
-            buffer.withMemoryRebound(to: Int8.self, capacity: sampleCount) { ptr in
-                applyVolume(toInt8: ptr, count: sampleCount, gain: volume)
-            }
-        case ..<17:
-            let sampleCount = byteCount / MemoryLayout<Int16>.size
-            buffer.withMemoryRebound(to: Int16.self, capacity: sampleCount) { ptr in
-                applyVolume(toInt16: ptr, count: sampleCount, gain: volume)
-            }
-        case ..<25:
-            let sampleCount = byteCount / 3
-            applyVolumeTo24Bit(buffer: buffer, sampleCount: sampleCount, gain: volume)
-        default:
-            let sampleCount = byteCount / MemoryLayout<Int32>.size
-            buffer.withMemoryRebound(to: Int32.self, capacity: sampleCount) { ptr in
-                applyVolume(toInt32: ptr, count: sampleCount, gain: volume)
-            }
+        // Vector kernels in the C bridge (FFmpegSampleKernels.c); integers
+        // are dithered rather than rounded (FFmpegDither.c).
+        if ffdecoder_requantizer_is_configured(requantizer) != 0 {
+            let frames = byteCount / (bytesPerSample * Int(currentFormat.channels))
+            ffdecoder_requantizer_apply_gain(requantizer, buffer, frames, volume)
+        } else {
+            ffdecoder_scale_samples(type, buffer, byteCount / bytesPerSample, volume)
         }
     }
 
@@ -1128,43 +1657,4 @@ final class AudioEngine {
             buffer[index] = Int8(Int(clamped.rounded()))
         }
     }
-
-    private func applyVolume(toInt16 buffer: UnsafeMutablePointer<Int16>, count: Int, gain: Double) {
-        let minValue = Double(Int16.min)
-        let maxValue = Double(Int16.max)
-        for index in 0..<count {
-            let scaled = Double(buffer[index]) * gain
-            let clamped = min(maxValue, max(minValue, scaled))
-            buffer[index] = Int16(Int(clamped.rounded()))
-        }
-    }
-
-    private func applyVolume(toInt32 buffer: UnsafeMutablePointer<Int32>, count: Int, gain: Double) {
-        let minValue = Double(Int32.min)
-        let maxValue = Double(Int32.max)
-        for index in 0..<count {
-            let scaled = Double(buffer[index]) * gain
-            let clamped = min(maxValue, max(minValue, scaled))
-            buffer[index] = Int32(Int(clamped.rounded()))
-        }
-    }
-
-    private func applyVolumeTo24Bit(buffer: UnsafeMutablePointer<UInt8>, sampleCount: Int, gain: Double) {
-        let minValue = -8_388_608.0
-        let maxValue = 8_388_607.0
-        for sampleIndex in 0..<sampleCount {
-            let offset = sampleIndex * 3
-            var value = Int32(buffer[offset])
-            value |= Int32(buffer[offset + 1]) << 8
-            value |= Int32(buffer[offset + 2]) << 16
-            if (value & 0x0080_0000) != 0 {
-                value |= Int32(bitPattern: 0xFF00_0000)
-            }
-            let scaled = Double(value) * gain
-            let clamped = Int32(Int(min(maxValue, max(minValue, scaled)).rounded()))
-            buffer[offset] = UInt8(truncatingIfNeeded: clamped & 0xFF)
-            buffer[offset + 1] = UInt8(truncatingIfNeeded: (clamped >> 8) & 0xFF)
-            buffer[offset + 2] = UInt8(truncatingIfNeeded: (clamped >> 16) & 0xFF)
-        }
-    }
 }
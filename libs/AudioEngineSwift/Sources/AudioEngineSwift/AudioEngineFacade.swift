@@ -51,6 +51,14 @@ public final class AudioEngineFacade {
         engine.currentVolume()
     }
 
+    public func setNormalization(mode: NormalizationMode, preampDb: Double = 0) {
+        engine.setNormalization(mode: mode, preampDb: preampDb)
+    }
+
+    public func setDither(mode: DitherMode) {
+        engine.setDither(mode: mode)
+    }
+
     public func setBitPerfectMode(enabled: Bool) throws {
         try engine.setBitPerfectMode(enabled: enabled)
     }
@@ -59,11 +67,36 @@ public final class AudioEngineFacade {
         try engine.setAutoSampleRateSwitching(enabled: enabled)
     }
 
+    public func preloadNext(url: URL) {
+        engine.preloadNext(url: url)
+    }
+
+    public func setGapless(enabled: Bool) {
+        engine.setGapless(enabled: enabled)
+    }
+
+    public func queueNext(url: URL) throws {
+        try engine.queueNext(url: url)
+    }
+
+    public func generateWaveforms(for urls: [URL]) {
+        engine.generateWaveforms(for: urls)
+    }
+
+    public func waveform(for url: URL) -> TrackWaveform? {
+        engine.waveform(for: url)
+    }
+
     public var onPlaybackEnded: (() -> Void)? {
         get { engine.onPlaybackEnded }
         set { engine.onPlaybackEnded = newValue }
     }
 
+    public var onTrackChanged: (() -> Void)? {
+        get { engine.onTrackChanged }
+        set { engine.onTrackChanged = newValue }
+    }
+
     public var isPlaying: Bool {
         engine.isPlaying
     }
@@ -79,4 +112,14 @@ public final class AudioEngineFacade {
     public func pcmStatus() -> PCMStatus {
         engine.getPCMStatus()
     }
+
+    /// Output meters alone, without pcmStatus()'s trip through the control
+    /// queue; cheap enough to poll every display frame.
+    public func meterLevels() -> LevelMeterReading {
+        engine.meterLevels()
+    }
+
+    public func setMeterOptions(_ options: LevelMeterOptions) {
+        engine.setMeterOptions(options)
+    }
 }
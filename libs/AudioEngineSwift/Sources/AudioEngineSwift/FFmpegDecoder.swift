@@ -68,16 +68,68 @@ final class FFmpegDecoder {
     let r128TrackGain: Double?
     let r128AlbumGain: Double?
 
-    init?(url: URL) {
+    /// Per-phase wall-clock cost of opening the file.
+    struct OpenTimings {
+        let openInputMs: Double
+        let findStreamInfoMs: Double
+        let codecOpenMs: Double
+        let probeDecodeMs: Double
+        let metadataMs: Double
+        let totalMs: Double
+        /// True when container headers were trusted and the probe decode skipped.
+        let usedFastOpen: Bool
+
+        init(_ timings: FFDecoderOpenTimings) {
+            openInputMs = Double(timings.openInputUs) / 1000.0
+            findStreamInfoMs = Double(timings.findStreamInfoUs) / 1000.0
+            codecOpenMs = Double(timings.codecOpenUs) / 1000.0
+            probeDecodeMs = Double(timings.probeDecodeUs) / 1000.0
+            metadataMs = Double(timings.metadataUs) / 1000.0
+            totalMs = Double(timings.totalUs) / 1000.0
+            usedFastOpen = timings.fastOpen != 0
+        }
+    }
+
+    let openTimings: OpenTimings
+
+    /// Encoder delay/padding trimmed from the stream, in samples.
+    struct GaplessInfo {
+        let leadingFrames: Int
+        let trailingFrames: Int
+        /// Trimmed length, or 0 when the file does not say.
+        let validFrames: Int
+    }
+
+    /// True when opened with `gapless`, whether or not anything is trimmed.
+    let gapless: Bool
+    /// Set when delay/padding information was found and is being trimmed.
+    let gaplessInfo: GaplessInfo?
+
+    /// `fastOpen` trusts container headers for FLAC, WAV, ALAC and tagged MP3
+    /// and verifies them against the first decoded frame; other files fall
+    /// back to the full probe. `gapless` trims encoder delay and padding, so
+    /// reads, `durationMs` and seek positions cover only the original audio.
+    init?(url: URL, fastOpen: Bool = true, gapless: Bool = false) {
+        var options = FFDecoderOpenOptions(fastOpen: fastOpen ? 1 : 0, gapless: gapless ? 1 : 0)
         let cHandle = url.withUnsafeFileSystemRepresentation { fsPath -> UnsafeMutablePointer<FFDecoderHandle>? in
             guard let fsPath else { return nil }
-            return ffdecoder_open(fsPath)
-        } ?? url.path.withCString { ffdecoder_open($0) }
+            return ffdecoder_open_with_options(fsPath, &options)
+        } ?? url.path.withCString { ffdecoder_open_with_options($0, &options) }
 
         guard let cHandle else {
             return nil
         }
         self.handle = cHandle
+        self.openTimings = OpenTimings(ffdecoder_get_open_timings(cHandle))
+        self.gapless = gapless
+        let trim = ffdecoder_get_gapless_info(cHandle)
+        if trim.leadingFrames == 0 && trim.trailingFrames == 0 && trim.validFrames == 0 {
+            self.gaplessInfo = nil
+        } else {
+            self.gaplessInfo = GaplessInfo(leadingFrames: Int(trim.leadingFrames),
+                                           trailingFrames: Int(trim.trailingFrames),
+                                           validFrames: Int(trim.validFrames))
+        }
         self.sampleRate = Int(ffdecoder_get_sample_rate(cHandle))
         self.channels = Int(ffdecoder_get_channels(cHandle))
         self.bitDepth = Int(ffdecoder_get_bit_depth(cHandle))
@@ -117,9 +169,79 @@ final class FFmpegDecoder {
         return result
     }
 
-    func seek(toMs position: Int) {
-        guard let handle else { return }
-        _ = ffdecoder_seek_ms(handle, Int64(position))
+    /// Decodes directly into a ring's free regions, skipping the intermediate
+    /// copy `read(into:maxBytes:)` needs. Returns whole frames' worth of bytes.
+    func read(into regions: LockFreeRingBuffer.WritableRegions) -> Int {
+        guard let handle else { return 0 }
+        var spans = FFDecoderSpans(first: regions.first.baseAddress,
+                                   firstBytes: regions.first.count,
+                                   second: regions.second.baseAddress,
+                                   secondBytes: regions.second.count)
+        let result = ffdecoder_read_spans(handle, &spans)
+        if result < 0 {
+            return 0
+        }
+        return result
+    }
+
+    /// Number of times the bridge had to grow its decode buffer after open.
+    /// Stays at zero in steady state when the codec frame-size hint holds.
+    var bufferGrowthCount: UInt64 {
+        guard let handle else { return 0 }
+        return ffdecoder_get_buffer_growth_count(handle)
+    }
+
+    /// Seeks and returns the stream position (in frames) the next read starts
+    /// at, or nil on failure. Accurate seeks land on the exact frame; fast
+    /// seeks may land on an earlier sync point.
+    @discardableResult
+    func seek(toMs position: Int, accurate: Bool = true) -> Int? {
+        guard let handle else { return nil }
+        var landed: Int64 = 0
+        let mode = accurate ? FFDEC_SEEK_ACCURATE : FFDEC_SEEK_FAST
+        guard ffdecoder_seek_ms_with_mode(handle, Int64(position), mode, &landed) == 0 else {
+            return nil
+        }
+        return Int(landed)
+    }
+
+    /// Wall time of the last seek in microseconds, including pre-roll decode.
+    var lastSeekLatencyUs: Int64 {
+        guard let handle else { return 0 }
+        return ffdecoder_get_last_seek_us(handle)
+    }
+
+    /// True for long MP3/ADTS files and FLAC without a SEEKTABLE, whose own
+    /// seeks bisect the file or estimate from the bit rate.
+    var wantsSeekIndex: Bool {
+        guard let handle else { return false }
+        return ffdecoder_wants_seek_index(handle) != 0
+    }
+
+    /// Makes later seeks use the index cached in `directory` once
+    /// `buildSeekIndex(for:cacheDirectory:)` has produced it.
+    @discardableResult
+    func attachSeekIndex(cacheDirectory directory: URL) -> Bool {
+        guard let handle else { return false }
+        return directory.withUnsafeFileSystemRepresentation { dir in
+            guard let dir else { return false }
+            return ffdecoder_attach_seek_index(handle, dir) == 0
+        }
+    }
+
+    /// Demuxes `url` and caches its seek index in `directory`. Slow for long
+    /// files; never call on the playback or control path. Returns false on
+    /// failure; an index that is already cached counts as success.
+    @discardableResult
+    static func buildSeekIndex(for url: URL, cacheDirectory directory: URL) -> Bool {
+        let result = url.withUnsafeFileSystemRepresentation { path -> Int32 in
+            guard let path else { return -1 }
+            return directory.withUnsafeFileSystemRepresentation { dir -> Int32 in
+                guard let dir else { return -1 }
+                return ffdecoder_build_seek_index(path, dir)
+            }
+        }
+        return result >= 0
     }
 
     func close() {
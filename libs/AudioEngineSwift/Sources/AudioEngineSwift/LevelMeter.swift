@@ -0,0 +1,46 @@
+import Foundation
+import FFmpegBridge
+
+/// Ballistics of the output meters, as AudioEngineCore's LevelMeter.
+public struct LevelMeterOptions: Sendable {
+    /// How long the hold marker stays on the highest peak before falling.
+    public var holdMs: Double = 1500
+    /// Fall rate of the peak, hold and true-peak readings.
+    public var decayDbPerSecond: Double = 20
+    /// Exponential window of the RMS reading; a full-scale sine reads -3 dB.
+    public var rmsWindowMs: Double = 300
+    /// 4x oversampled inter-sample peaks; costs more than the rest together.
+    public var truePeak: Bool = true
+
+    public init() {}
+}
+
+/// Per-channel output levels in dBFS, one value per output channel, never
+/// below `LevelMeterReading.floorDb`.
+public struct LevelMeterReading: Sendable {
+    public static let floorDb: Float = -120  // FFMETER_FLOOR_DB
+
+    /// Render callbacks since the output was configured; unchanged means no
+    /// new audio.
+    public let sequence: UInt64
+    public let peakDb: [Float]
+    public let peakHoldDb: [Float]
+    public let rmsDb: [Float]
+    /// At the floor while true peak is off.
+    public let truePeakDb: [Float]
+    /// Highest true peak since playback last stopped.
+    public let maxTruePeakDb: [Float]
+
+    init(_ reading: FFLevelReading) {
+        let channels = Int(reading.channels)
+        func values<T>(_ tuple: T) -> [Float] {
+            withUnsafeBytes(of: tuple) { Array($0.bindMemory(to: Float.self).prefix(channels)) }
+        }
+        sequence = reading.sequence
+        peakDb = values(reading.peak_db)
+        peakHoldDb = values(reading.peak_hold_db)
+        rmsDb = values(reading.rms_db)
+        truePeakDb = values(reading.true_peak_db)
+        maxTruePeakDb = values(reading.max_true_peak_db)
+    }
+}
@@ -121,6 +121,54 @@ public struct TrackReplayGain: Sendable {
     public var hasAnyValue: Bool {
         return trackGainDb != nil || albumGainDb != nil || r128TrackGain != nil || r128AlbumGain != nil
     }
+
+    /// Linear playback gain for `mode`, mirroring ResolveNormalization() in
+    /// AudioEngineCore. R128 tags (Q7.8 dB against -23 LUFS) are moved onto
+    /// the ReplayGain reference, album mode falls back to track values and
+    /// untagged tracks play at unity. This path has no limiter, so the gain
+    /// is capped to keep the tagged peak (full scale if untagged) under
+    /// `ceilingDb`.
+    public func normalizationGain(mode: NormalizationMode,
+                                  preampDb: Double,
+                                  ceilingDb: Double = -1.0) -> Double {
+        let r128Offset = 5.0
+        let track = trackGainDb ?? r128TrackGain.map { $0 / 256.0 + r128Offset }
+        let album = albumGainDb ?? r128AlbumGain.map { $0 / 256.0 + r128Offset }
+        let gainDb: Double?
+        let peak: Double?
+        switch mode {
+        case .off:
+            return 1.0
+        case .track:
+            gainDb = track ?? album
+            peak = trackPeak ?? albumPeak
+        case .album:
+            gainDb = album ?? track
+            peak = albumPeak ?? trackPeak
+        }
+        guard let gainDb else { return 1.0 }
+        let gain = pow(10.0, (gainDb + preampDb) / 20.0)
+        let ceiling = pow(10.0, ceilingDb / 20.0)
+        let peakValue = peak.flatMap { $0 > 0 ? $0 : nil } ?? 1.0
+        return min(gain, ceiling / peakValue)
+    }
+}
+
+public enum NormalizationMode: Sendable {
+    case off
+    case track
+    case album
+}
+
+/// Requantization when the volume or normalization gain scales integer
+/// output. `.tpdf` adds flat triangular dither; `.highpass` and `.fWeighted`
+/// also shape its noise away from the midrange. `.off` rounds to the
+/// nearest step.
+public enum DitherMode: Sendable {
+    case off
+    case tpdf
+    case highpass
+    case fWeighted
 }
 
 /// Aggregated metadata describing the active track, combining container
@@ -0,0 +1,94 @@
+import Foundation
+import FFmpegBridge
+
+/// One seekbar point, in 1/32767 of full scale over the first two channels.
+public struct WaveformPoint: Sendable {
+    public let min: Int16
+    public let max: Int16
+    public let rms: Int16
+}
+
+/// One zoom level of a `TrackWaveform`. Reads the cache file in place; the
+/// level keeps its waveform (and so the mapping) alive.
+public struct WaveformLevel: @unchecked Sendable, RandomAccessCollection {
+    public let framesPerPoint: Int
+    private let points: UnsafePointer<FFWaveformPoint>?
+    private let count_: Int
+    private let owner: TrackWaveform
+
+    fileprivate init(_ level: FFWaveformLevel, owner: TrackWaveform) {
+        framesPerPoint = Int(level.framesPerPoint)
+        points = level.points
+        count_ = Int(level.count)
+        self.owner = owner
+    }
+
+    public var startIndex: Int { 0 }
+    public var endIndex: Int { count_ }
+
+    public subscript(position: Int) -> WaveformPoint {
+        precondition(position >= 0 && position < count_, "waveform point out of range")
+        let point = points![position]
+        return WaveformPoint(min: point.min, max: point.max, rms: point.rms)
+    }
+}
+
+/// Cached min/max/RMS overview of a file, memory-mapped from the waveform
+/// cache. Build it with `AudioEngine.generateWaveforms(for:)`; opening one
+/// never decodes.
+public final class TrackWaveform: @unchecked Sendable {
+    private let handle: OpaquePointer
+
+    fileprivate init(handle: OpaquePointer) {
+        self.handle = handle
+    }
+
+    /// Mapped waveform for the current version of `url`, or nil if it has
+    /// not been generated (or the file changed since).
+    static func open(for url: URL, cacheDirectory directory: URL) -> TrackWaveform? {
+        let handle = url.withUnsafeFileSystemRepresentation { path -> OpaquePointer? in
+            guard let path else { return nil }
+            return directory.withUnsafeFileSystemRepresentation { dir -> OpaquePointer? in
+                guard let dir else { return nil }
+                return ffwaveform_map(path, dir)
+            }
+        }
+        return handle.map(TrackWaveform.init(handle:))
+    }
+
+    /// Decodes `url` and caches its waveform in `directory`. Slow; never
+    /// call on the playback or control path. A waveform that is already
+    /// cached counts as success.
+    @discardableResult
+    static func build(for url: URL, cacheDirectory directory: URL) -> Bool {
+        let result = url.withUnsafeFileSystemRepresentation { path -> Int32 in
+            guard let path else { return -1 }
+            return directory.withUnsafeFileSystemRepresentation { dir -> Int32 in
+                guard let dir else { return -1 }
+                return ffwaveform_build(path, dir)
+            }
+        }
+        return result >= 0
+    }
+
+    public var sampleRate: Int { Int(ffwaveform_sample_rate(handle)) }
+    public var channels: Int { Int(ffwaveform_channels(handle)) }
+    public var frames: UInt64 { ffwaveform_frames(handle) }
+    public var levelCount: Int { ffwaveform_level_count(handle) }
+
+    /// Level 0 is the finest; each next one merges four points.
+    public func level(_ index: Int) -> WaveformLevel {
+        precondition(index >= 0 && index < levelCount, "waveform level out of range")
+        return WaveformLevel(ffwaveform_level(handle, index), owner: self)
+    }
+
+    /// Coarsest level with at least `points` points (e.g. the seekbar width
+    /// in pixels), else the finest.
+    public func level(forWidth points: Int) -> WaveformLevel {
+        WaveformLevel(ffwaveform_level_for(handle, Swift.max(points, 0)), owner: self)
+    }
+
+    deinit {
+        ffwaveform_close(handle)
+    }
+}
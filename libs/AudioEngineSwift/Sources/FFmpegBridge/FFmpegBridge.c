@@ -1,4 +1,7 @@
 #include "FFmpegBridge.h"
+#include "FFmpegGapless.h"
+#include "FFmpegInterleave.h"
+#include "FFmpegSeekIndex.h"
 
 #include <libavformat/avformat.h>
 #include <libavformat/avio.h>
@@ -8,6 +11,7 @@
 #include <libavutil/mem.h>
 #include <libavutil/error.h>
 #include <libavutil/channel_layout.h>
+#include <libavutil/time.h>
 #include <math.h>
 #include <stdlib.h>
 #include <libavutil/channel_layout.h>
@@ -41,6 +45,19 @@
 
 static char gFFDecoderLastError[512] = {0};
 
+/* Decode buffers are sized in power-of-two classes so a larger-than-hinted
+ * frame costs at most a few growths per track rather than one per frame. */
+#define FFDECODER_MIN_SIZE_CLASS 4096
+#define FFDECODER_DEFAULT_FRAME_HINT 4096
+
+static size_t ffdecoder_size_class(size_t bytes) {
+    size_t size = FFDECODER_MIN_SIZE_CLASS;
+    while (size < bytes && size <= SIZE_MAX / 2) {
+        size <<= 1;
+    }
+    return size < bytes ? bytes : size;
+}
+
 static void ffdecoder_copy_metadata_string(FFDecoderHandle *handle,
                                            const char *key,
                                            char *dest,
@@ -165,29 +182,143 @@ static int ffdecoder_open_input(FFDecoderHandle *handle, const char *path, const
     }
     int result = avformat_open_input(&handle->format, path, inputFormat, &opts);
     av_dict_free(&opts);
-    if (result < 0) {
-        return result;
+    return result < 0 ? result : 0;
+}
+
+/* Codecs whose demuxers fill rate, channels and duration from the container
+ * header and whose decoders settle the sample format in avcodec_open2(). */
+static int ffdecoder_headers_trusted(const AVStream *stream) {
+    const AVCodecParameters *codecpar = stream->codecpar;
+    if (codecpar->sample_rate <= 0 || codecpar->ch_layout.nb_channels <= 0 ||
+        stream->duration <= 0 || stream->duration == AV_NOPTS_VALUE) {
+        return 0;
     }
-    result = avformat_find_stream_info(handle->format, NULL);
-    if (result < 0) {
-        avformat_close_input(&handle->format);
-        return result;
+    switch (codecpar->codec_id) {
+        case AV_CODEC_ID_FLAC:
+            return 1;
+        case AV_CODEC_ID_ALAC:
+            return codecpar->extradata_size > 0;
+        case AV_CODEC_ID_MP3:
+            /* mp3dec only has a duration before find_stream_info when a
+             * Xing/LAME/VBRI header was present. */
+            return 1;
+        default:
+            return ffdecoder_is_pcm_codec(codecpar->codec_id);
+    }
+}
+
+/* Takes rate, channel count and sample format from handle->frame where they
+ * disagree with what the headers claimed. */
+static int ffdecoder_adopt_frame_format(FFDecoderHandle *handle) {
+    if (handle->frame->sample_rate > 0 &&
+        (handle->sampleRate <= 1 ||
+         abs(handle->frame->sample_rate - handle->sampleRate) > 1)) {
+        handle->sampleRate = handle->frame->sample_rate;
+    }
+    int frameChannels = handle->frame->channels;
+    if (frameChannels <= 0 && handle->frame->ch_layout.nb_channels > 0) {
+        frameChannels = handle->frame->ch_layout.nb_channels;
+    }
+    if (frameChannels > 0 &&
+        (handle->channels <= 0 || frameChannels != handle->channels)) {
+        handle->channels = frameChannels;
+    }
+    if (handle->frame->format != AV_SAMPLE_FMT_NONE) {
+        handle->sampleFormat = (enum AVSampleFormat)handle->frame->format;
+    }
+    handle->bytesPerSample = av_get_bytes_per_sample(handle->sampleFormat);
+    if (handle->bytesPerSample == 0) {
+        ffdecoder_set_error("Unsupported sample format");
+        return AVERROR(EINVAL);
+    }
+    if (handle->channels > 0) {
+        handle->bytesPerFrame = handle->bytesPerSample * handle->channels;
+    }
+    handle->bitDepth = (int)(handle->bytesPerSample * 8);
+    const char *sampleFmtName = av_get_sample_fmt_name(handle->sampleFormat);
+    if (sampleFmtName) {
+        snprintf(handle->sampleFormatName, sizeof(handle->sampleFormatName), "%s", sampleFmtName);
     }
     return 0;
 }
 
-static int ffdecoder_prepare_decoder(FFDecoderHandle *handle, const char *path) {
+static int ffdecoder_fill_buffer(struct FFDecoderHandle *handle);
+
+/* Enough of the file head to cover an ID3v2 tag with small artwork and the
+ * first MPEG frame behind it. */
+#define FFDECODER_LAME_PROBE_BYTES (64 * 1024)
+
+/* Encoder delay/padding for the selected stream: iTunSMPB first, then the
+ * LAME/Xing header for MP3, then the codec's own padding fields. */
+static FFDecoderGaplessInfo ffdecoder_detect_gapless(FFDecoderHandle *handle, const char *path) {
+    FFDecoderGaplessInfo info = {0};
+    const AVDictionaryEntry *smpb = av_dict_get(handle->stream->metadata, "iTunSMPB", NULL, 0);
+    if (!smpb) {
+        smpb = av_dict_get(handle->format->metadata, "iTunSMPB", NULL, 0);
+    }
+    if (smpb && ffdecoder_gapless_parse_itunsmpb(smpb->value, &info)) {
+        return info;
+    }
+    const AVCodecParameters *codecpar = handle->stream->codecpar;
+    if (codecpar->codec_id == AV_CODEC_ID_MP3) {
+        /* Read through a separate context so the demuxer's position is untouched. */
+        AVIOContext *io = NULL;
+        uint8_t *head = av_malloc(FFDECODER_LAME_PROBE_BYTES);
+        if (head && avio_open(&io, path, AVIO_FLAG_READ) >= 0) {
+            int got = avio_read(io, head, FFDECODER_LAME_PROBE_BYTES);
+            avio_closep(&io);
+            if (got > 0 && ffdecoder_gapless_parse_lame(head, (size_t)got, &info)) {
+                av_free(head);
+                return info;
+            }
+        }
+        av_free(head);
+        memset(&info, 0, sizeof(info));
+    }
+    if (codecpar->initial_padding > 0) {
+        info.leadingFrames = (uint64_t)codecpar->initial_padding;
+    }
+    if (codecpar->trailing_padding > 0) {
+        info.trailingFrames = (uint64_t)codecpar->trailing_padding;
+    }
+    return info;
+}
+
+static int ffdecoder_prepare_decoder(FFDecoderHandle *handle, const char *path, int fastOpen, int gapless) {
+    FFDecoderOpenTimings *timings = &handle->openTimings;
+    int64_t phaseStart = av_gettime_relative();
     int result = ffdecoder_open_input(handle, path, NULL);
+    timings->openInputUs = av_gettime_relative() - phaseStart;
     if (result < 0) {
         ffdecoder_set_error(av_err2str(result));
         return result;
     }
+    int trustHeaders = 0;
+    if (fastOpen) {
+        int candidate = av_find_best_stream(handle->format, AVMEDIA_TYPE_AUDIO, -1, -1, NULL, 0);
+        trustHeaders = candidate >= 0 && ffdecoder_headers_trusted(handle->format->streams[candidate]);
+    }
+    if (!trustHeaders) {
+        phaseStart = av_gettime_relative();
+        result = avformat_find_stream_info(handle->format, NULL);
+        timings->findStreamInfoUs = av_gettime_relative() - phaseStart;
+        if (result < 0) {
+            avformat_close_input(&handle->format);
+            ffdecoder_set_error(av_err2str(result));
+            return result;
+        }
+    }
+    timings->fastOpen = trustHeaders;
+    phaseStart = av_gettime_relative();
     int streamIndex = av_find_best_stream(handle->format, AVMEDIA_TYPE_AUDIO, -1, -1, NULL, 0);
     if (streamIndex < 0) {
         ffdecoder_set_error("No audio stream");
         return -1;
     }
     handle->stream = handle->format->streams[streamIndex];
+    handle->gaplessEnd = -1;
+    handle->gaplessNextFrame = 0;
+    handle->gaplessOriginTs = AV_NOPTS_VALUE;
     AVCodecParameters *codecpar = handle->stream->codecpar;
     const AVCodec *codec = avcodec_find_decoder(codecpar->codec_id);
     handle->packet = av_packet_alloc();
@@ -208,6 +339,16 @@ static int ffdecoder_prepare_decoder(FFDecoderHandle *handle, const char *path)
             ffdecoder_set_error(av_err2str(result));
             return result;
         }
+        if (gapless) {
+            handle->gaplessInfo = ffdecoder_detect_gapless(handle, path);
+            FFDecoderGaplessInfo *info = &handle->gaplessInfo;
+            if (info->leadingFrames || info->trailingFrames || info->validFrames) {
+                /* Keep the decoder from applying skip-samples side data
+                 * itself; trimming happens once, in ffdecoder_receive_frame. */
+                handle->codec->flags2 |= AV_CODEC_FLAG2_SKIP_MANUAL;
+                handle->gaplessActive = 1;
+            }
+        }
         result = avcodec_open2(handle->codec, codec, NULL);
         if (result < 0) {
             ffdecoder_set_error(av_err2str(result));
@@ -257,7 +398,9 @@ static int ffdecoder_prepare_decoder(FFDecoderHandle *handle, const char *path)
         ffdecoder_set_error("Decoder unavailable");
         return -1;
     }
-    if (handle->codec && handle->frame && handle->packet) {
+    timings->codecOpenUs = av_gettime_relative() - phaseStart;
+    phaseStart = av_gettime_relative();
+    if (!trustHeaders && handle->codec && handle->frame && handle->packet) {
         int gotFrame = 0;
         int probeResult = 0;
         for (int attempts = 0; attempts < 200; ++attempts) {
@@ -285,32 +428,11 @@ static int ffdecoder_prepare_decoder(FFDecoderHandle *handle, const char *path)
             break;
         }
         if (gotFrame) {
-            if (handle->frame->sample_rate > 0 &&
-                (handle->sampleRate <= 1 ||
-                 abs(handle->frame->sample_rate - handle->sampleRate) > 1)) {
-                handle->sampleRate = handle->frame->sample_rate;
-            }
-            int frameChannels = handle->frame->channels;
-            if (frameChannels <= 0 && handle->frame->ch_layout.nb_channels > 0) {
-                frameChannels = handle->frame->ch_layout.nb_channels;
-            }
-            if (frameChannels > 0 &&
-                (handle->channels <= 0 || frameChannels != handle->channels)) {
-                handle->channels = frameChannels;
-            }
-            if (handle->frame->format != AV_SAMPLE_FMT_NONE) {
-                handle->sampleFormat = (enum AVSampleFormat)handle->frame->format;
-            }
-            handle->bytesPerSample = av_get_bytes_per_sample(handle->sampleFormat);
-            if (handle->bytesPerSample == 0) {
-                ffdecoder_set_error("Unsupported sample format");
-                return AVERROR(EINVAL);
-            }
-            if (handle->channels > 0) {
-                handle->bytesPerFrame = handle->bytesPerSample * handle->channels;
-            }
-            handle->bitDepth = (int)(handle->bytesPerSample * 8);
+            result = ffdecoder_adopt_frame_format(handle);
             av_frame_unref(handle->frame);
+            if (result < 0) {
+                return result;
+            }
         }
         if (handle->codec) {
             avcodec_flush_buffers(handle->codec);
@@ -322,6 +444,8 @@ static int ffdecoder_prepare_decoder(FFDecoderHandle *handle, const char *path)
         handle->bufferedOffset = 0;
         handle->eofReached = 0;
     }
+    timings->probeDecodeUs = av_gettime_relative() - phaseStart;
+    phaseStart = av_gettime_relative();
     if (handle->sampleRate <= 1 && handle->stream) {
         AVRational timeBase = handle->stream->time_base;
         if (timeBase.num > 0 && timeBase.den > 0) {
@@ -347,6 +471,10 @@ static int ffdecoder_prepare_decoder(FFDecoderHandle *handle, const char *path)
     } else if (handle->format->duration > 0) {
         handle->durationMs = (int)(handle->format->duration / (AV_TIME_BASE / 1000));
     }
+    if (handle->gaplessActive && handle->gaplessInfo.validFrames > 0 && handle->sampleRate > 0) {
+        handle->gaplessEnd = (int64_t)(handle->gaplessInfo.leadingFrames + handle->gaplessInfo.validFrames);
+        handle->durationMs = (int)av_rescale((int64_t)handle->gaplessInfo.validFrames, 1000, handle->sampleRate);
+    }
     const char *codecLongName = codec && codec->long_name ? codec->long_name : NULL;
     const char *codecShortName = codec && codec->name ? codec->name : NULL;
     const char *codecLabel = codecLongName ? codecLongName : codecShortName;
@@ -389,6 +517,8 @@ static int ffdecoder_prepare_decoder(FFDecoderHandle *handle, const char *path)
     handle->startTimeSeconds = 0.0;
     if (handle->format && handle->format->start_time != AV_NOPTS_VALUE) {
         handle->startTimeSeconds = (double)handle->format->start_time / AV_TIME_BASE;
+    } else if (trustHeaders && handle->stream->start_time != AV_NOPTS_VALUE) {
+        handle->startTimeSeconds = handle->stream->start_time * av_q2d(handle->stream->time_base);
     }
 
     handle->fileSizeBytes = 0;
@@ -405,6 +535,10 @@ static int ffdecoder_prepare_decoder(FFDecoderHandle *handle, const char *path)
             handle->fileSizeBytes = (int64_t)bytes;
         }
     }
+    // The container bit rate is only derived by find_stream_info.
+    if (trustHeaders && handle->sourceBitRate == 0 && handle->fileSizeBytes > 0 && handle->durationMs > 0) {
+        handle->sourceBitRate = (int64_t)(handle->fileSizeBytes * 8000.0 / handle->durationMs);
+    }
 
     ffdecoder_copy_metadata_string(handle, "title", handle->title, sizeof(handle->title));
     ffdecoder_copy_metadata_string(handle, "artist", handle->artist, sizeof(handle->artist));
@@ -422,6 +556,7 @@ static int ffdecoder_prepare_decoder(FFDecoderHandle *handle, const char *path)
     handle->replayPeakAlbum = ffdecoder_metadata_double(handle, "REPLAYGAIN_ALBUM_PEAK");
     handle->r128TrackGain = ffdecoder_metadata_double(handle, "R128_TRACK_GAIN");
     handle->r128AlbumGain = ffdecoder_metadata_double(handle, "R128_ALBUM_GAIN");
+    timings->metadataUs = av_gettime_relative() - phaseStart;
 
     int safeChannels = handle->channels;
     if (safeChannels <= 0 && handle->codec && handle->codec->ch_layout.nb_channels > 0) {
@@ -447,12 +582,20 @@ static int ffdecoder_prepare_decoder(FFDecoderHandle *handle, const char *path)
         ffdecoder_set_error("Invalid channel count");
         return AVERROR(EINVAL);
     }
-    if (handle->bytesPerFrame > SIZE_MAX / 2048) {
+    int frameHint = FFDECODER_DEFAULT_FRAME_HINT;
+    if (handle->codec && handle->codec->frame_size > frameHint) {
+        frameHint = handle->codec->frame_size;
+    }
+    if (codecpar->frame_size > frameHint) {
+        frameHint = codecpar->frame_size;
+    }
+    if (handle->bytesPerFrame > SIZE_MAX / (size_t)frameHint) {
         ffdecoder_set_error("Decode buffer size overflow");
         return AVERROR(EINVAL);
     }
 
-    handle->interleavedSize = handle->bytesPerFrame * 2048;
+    handle->interleavedSize = ffdecoder_size_class(handle->bytesPerFrame * (size_t)frameHint);
+    handle->interleavedGrowths = 0;
     handle->interleavedBuffer = (uint8_t *)av_malloc(handle->interleavedSize);
     if (!handle->interleavedBuffer) {
         ffdecoder_set_error("Failed to allocate decode buffer");
@@ -461,10 +604,33 @@ static int ffdecoder_prepare_decoder(FFDecoderHandle *handle, const char *path)
     handle->bufferedBytes = 0;
     handle->bufferedOffset = 0;
     handle->eofReached = 0;
+
+    if (trustHeaders && handle->codec) {
+        // Decode the first frame now, keep it buffered for the first read and
+        // let it correct anything the headers got wrong before callers see
+        // the format.
+        phaseStart = av_gettime_relative();
+        handle->verifyOnFirstFrame = 1;
+        if (ffdecoder_fill_buffer(handle) < 0) {
+            avcodec_flush_buffers(handle->codec);
+            av_seek_frame(handle->format, handle->stream->index, 0, AVSEEK_FLAG_BACKWARD);
+            handle->bufferedBytes = 0;
+            handle->bufferedOffset = 0;
+            handle->eofReached = 0;
+            handle->gaplessNextFrame = 0;
+            handle->gaplessOriginTs = AV_NOPTS_VALUE;
+        }
+        timings->probeDecodeUs = av_gettime_relative() - phaseStart;
+    }
     return 0;
 }
 
 FFDecoderHandle *ffdecoder_open(const char *path) {
+    return ffdecoder_open_with_options(path, NULL);
+}
+
+FFDecoderHandle *ffdecoder_open_with_options(const char *path, const FFDecoderOpenOptions *options) {
+    int64_t openStart = av_gettime_relative();
     if (!path) {
         ffdecoder_set_error("Path is null");
         return NULL;
@@ -475,14 +641,20 @@ FFDecoderHandle *ffdecoder_open(const char *path) {
         ffdecoder_set_error("Allocation failure");
         return NULL;
     }
-    if (ffdecoder_prepare_decoder(handle, path) < 0) {
+    if (ffdecoder_prepare_decoder(handle, path, options && options->fastOpen, options && options->gapless) < 0) {
         ffdecoder_close(handle);
         return NULL;
     }
+    handle->openTimings.totalUs = av_gettime_relative() - openStart;
     ffdecoder_set_error(NULL);
     return handle;
 }
 
+FFDecoderOpenTimings ffdecoder_get_open_timings(FFDecoderHandle *handle) {
+    FFDecoderOpenTimings empty = {0};
+    return handle ? handle->openTimings : empty;
+}
+
 void ffdecoder_close(FFDecoderHandle *handle) {
     if (!handle) return;
     if (handle->packet) {
@@ -500,6 +672,9 @@ void ffdecoder_close(FFDecoderHandle *handle) {
     if (handle->interleavedBuffer) {
         av_free(handle->interleavedBuffer);
     }
+    ffdecoder_seekindex_free(handle->seekIndex);
+    av_free(handle->seekIndexDir);
+    av_free(handle->seekIndexPath);
     av_free(handle);
 }
 
@@ -645,71 +820,114 @@ double ffdecoder_get_r128_album_gain(FFDecoderHandle *handle) {
     return handle ? ffdecoder_return_double(handle->r128AlbumGain) : NAN;
 }
 
-static int ffdecoder_fill_buffer(struct FFDecoderHandle *handle) {
-    handle->bufferedBytes = 0;
-    handle->bufferedOffset = 0;
+static int ffdecoder_reserve_interleaved(struct FFDecoderHandle *handle, size_t required) {
+    if (required <= handle->interleavedSize) {
+        return 0;
+    }
+    /* Contents are about to be overwritten, so free + malloc instead of
+     * realloc to avoid copying stale data. */
+    size_t size = ffdecoder_size_class(required);
+    uint8_t *newBuffer = av_malloc(size);
+    if (!newBuffer) {
+        ffdecoder_set_error("Failed to grow buffer");
+        return AVERROR(ENOMEM);
+    }
+    av_free(handle->interleavedBuffer);
+    handle->interleavedBuffer = newBuffer;
+    handle->interleavedSize = size;
+    handle->interleavedGrowths++;
+    return 0;
+}
+
+/* Timestamp of stream position 0. With gapless trimming that is the first
+ * decoded sample, priming included, which is where the trim offsets count from. */
+static int64_t ffdecoder_ts_origin(const struct FFDecoderHandle *handle) {
+    if (handle->gaplessActive && handle->gaplessOriginTs != AV_NOPTS_VALUE) {
+        return handle->gaplessOriginTs;
+    }
+    return handle->stream->start_time != AV_NOPTS_VALUE ? handle->stream->start_time : 0;
+}
+
+/* Stream position, in samples, of a timestamp in the stream time base, or -1
+ * when there is no timestamp. */
+static int64_t ffdecoder_ts_to_frame(struct FFDecoderHandle *handle, int64_t ts) {
+    if (ts == AV_NOPTS_VALUE || handle->sampleRate <= 0) {
+        return -1;
+    }
+    int64_t origin = ffdecoder_ts_origin(handle);
+    int64_t frame = av_rescale_q(ts - origin, handle->stream->time_base, (AVRational){1, handle->sampleRate});
+    return frame < 0 ? 0 : frame;
+}
+
+static void ffdecoder_drop_pending_frame(struct FFDecoderHandle *handle) {
+    if (handle->framePending) {
+        av_frame_unref(handle->frame);
+    }
+    handle->framePending = 0;
+    handle->pendingFrameOffset = 0;
+    handle->pendingFrameEnd = 0;
+}
+
+/* Narrows the pending frame, which starts at untrimmed position
+ * handle->gaplessNextFrame, to the samples inside the trim window and advances
+ * the position past it. Returns 0 when nothing of the frame is left. */
+static int ffdecoder_gapless_clip(struct FFDecoderHandle *handle) {
+    int64_t start = handle->gaplessNextFrame;
+    int64_t samples = handle->frame->nb_samples;
+    handle->gaplessNextFrame = start + samples;
+    int64_t begin = (int64_t)handle->gaplessInfo.leadingFrames - start;
+    if (begin < handle->pendingFrameOffset) {
+        begin = handle->pendingFrameOffset;
+    }
+    int64_t end = samples;
+    if (handle->gaplessEnd >= 0 && handle->gaplessEnd - start < end) {
+        end = handle->gaplessEnd - start;
+    }
+    if (begin >= end) {
+        return 0;
+    }
+    handle->pendingFrameOffset = (int)begin;
+    handle->pendingFrameEnd = (int)end;
+    return 1;
+}
+
+/* Pulls the next decoded frame into handle->frame unless one is still
+ * pending. Returns 1 when a frame is pending, 0 at end of stream, <0 on error. */
+static int ffdecoder_receive_frame(struct FFDecoderHandle *handle) {
+    if (handle->framePending) {
+        return 1;
+    }
     int ret;
     while (1) {
-        if (handle->isPassthrough) {
-            while (1) {
-                ret = av_read_frame(handle->format, handle->packet);
-                if (ret == AVERROR_EOF) {
-                    handle->eofReached = 1;
-                    return 0;
-                }
-                if (ret < 0) {
-                    ffdecoder_set_error(av_err2str(ret));
-                    return ret;
-                }
-                if (handle->packet->stream_index != handle->stream->index) {
-                    av_packet_unref(handle->packet);
-                    continue;
-                }
-                size_t required = (size_t)handle->packet->size;
-                if (required > handle->interleavedSize) {
-                    uint8_t *newBuffer = av_realloc(handle->interleavedBuffer, required);
-                    if (!newBuffer) {
-                        ffdecoder_set_error("Failed to grow buffer");
-                        av_packet_unref(handle->packet);
-                        return AVERROR(ENOMEM);
-                    }
-                    handle->interleavedBuffer = newBuffer;
-                    handle->interleavedSize = required;
-                }
-                memcpy(handle->interleavedBuffer, handle->packet->data, required);
-                av_packet_unref(handle->packet);
-                handle->bufferedBytes = required;
-                return (int)required;
-            }
+        if (handle->gaplessActive && handle->gaplessEnd >= 0 && handle->gaplessNextFrame >= handle->gaplessEnd) {
+            /* Only end padding is left; don't decode it. */
+            return 0;
         }
         ret = avcodec_receive_frame(handle->codec, handle->frame);
         if (ret == 0) {
-            int planar = av_sample_fmt_is_planar(handle->sampleFormat);
-            int samples = handle->frame->nb_samples;
-            size_t required = (size_t)samples * handle->bytesPerFrame;
-            if (required > handle->interleavedSize) {
-                uint8_t *newBuffer = av_realloc(handle->interleavedBuffer, required);
-                if (!newBuffer) {
-                    ffdecoder_set_error("Failed to grow buffer");
-                    return AVERROR(ENOMEM);
+            if (handle->verifyOnFirstFrame) {
+                handle->verifyOnFirstFrame = 0;
+                ret = ffdecoder_adopt_frame_format(handle);
+                if (ret < 0) {
+                    av_frame_unref(handle->frame);
+                    return ret;
                 }
-                handle->interleavedBuffer = newBuffer;
-                handle->interleavedSize = required;
             }
-            if (!planar) {
-                memcpy(handle->interleavedBuffer, handle->frame->data[0], required);
-            } else {
-                for (int sample = 0; sample < samples; ++sample) {
-                    for (int ch = 0; ch < handle->channels; ++ch) {
-                        uint8_t *dst = handle->interleavedBuffer + (sample * handle->channels + ch) * handle->bytesPerSample;
-                        uint8_t *src = handle->frame->data[ch] + sample * handle->bytesPerSample;
-                        memcpy(dst, src, handle->bytesPerSample);
-                    }
+            handle->framePending = 1;
+            handle->pendingFrameOffset = 0;
+            handle->pendingFrameEnd = handle->frame->nb_samples;
+            if (handle->gaplessActive) {
+                if (handle->gaplessOriginTs == AV_NOPTS_VALUE) {
+                    handle->gaplessOriginTs = handle->frame->best_effort_timestamp;
+                }
+                /* Positions are unknown mid-seek; the seek clips the frame
+                 * it lands in once it has worked out where that is. */
+                if (handle->gaplessNextFrame >= 0 && !ffdecoder_gapless_clip(handle)) {
+                    ffdecoder_drop_pending_frame(handle);
+                    continue;
                 }
             }
-            handle->bufferedBytes = required;
-            av_frame_unref(handle->frame);
-            return (int)required;
+            return 1;
         } else if (ret == AVERROR(EAGAIN)) {
             while (1) {
                 ret = av_read_frame(handle->format, handle->packet);
@@ -744,6 +962,193 @@ static int ffdecoder_fill_buffer(struct FFDecoderHandle *handle) {
     }
 }
 
+static size_t ffdecoder_pending_frames(const struct FFDecoderHandle *handle) {
+    if (!handle->framePending || handle->pendingFrameEnd <= handle->pendingFrameOffset) {
+        return 0;
+    }
+    return (size_t)(handle->pendingFrameEnd - handle->pendingFrameOffset);
+}
+
+/* Writes the next `frames` samples of the pending frame to `dst` as
+ * interleaved PCM and releases the frame once it is used up. */
+static void ffdecoder_take_pending(struct FFDecoderHandle *handle, uint8_t *dst, size_t frames) {
+    size_t offset = (size_t)handle->pendingFrameOffset;
+    if (av_sample_fmt_is_planar(handle->sampleFormat)) {
+        ffdecoder_interleave(dst,
+                             (const uint8_t *const *)handle->frame->extended_data,
+                             offset,
+                             frames,
+                             handle->channels,
+                             (size_t)handle->bytesPerSample);
+    } else {
+        memcpy(dst, handle->frame->data[0] + offset * handle->bytesPerFrame, frames * handle->bytesPerFrame);
+    }
+    handle->pendingFrameOffset += (int)frames;
+    if (handle->pendingFrameOffset >= handle->pendingFrameEnd) {
+        ffdecoder_drop_pending_frame(handle);
+    }
+}
+
+static int ffdecoder_fill_buffer(struct FFDecoderHandle *handle) {
+    handle->bufferedBytes = 0;
+    handle->bufferedOffset = 0;
+    int ret;
+    while (1) {
+        if (handle->isPassthrough) {
+            while (1) {
+                ret = av_read_frame(handle->format, handle->packet);
+                if (ret == AVERROR_EOF) {
+                    handle->eofReached = 1;
+                    return 0;
+                }
+                if (ret < 0) {
+                    ffdecoder_set_error(av_err2str(ret));
+                    return ret;
+                }
+                if (handle->packet->stream_index != handle->stream->index) {
+                    av_packet_unref(handle->packet);
+                    continue;
+                }
+                size_t required = (size_t)handle->packet->size;
+                ret = ffdecoder_reserve_interleaved(handle, required);
+                if (ret < 0) {
+                    av_packet_unref(handle->packet);
+                    return ret;
+                }
+                memcpy(handle->interleavedBuffer, handle->packet->data, required);
+                handle->bufferedStartFrame = ffdecoder_ts_to_frame(handle, handle->packet->pts);
+                av_packet_unref(handle->packet);
+                handle->bufferedBytes = required;
+                return (int)required;
+            }
+        }
+        ret = ffdecoder_receive_frame(handle);
+        if (ret <= 0) {
+            return ret;
+        }
+        size_t samples = ffdecoder_pending_frames(handle);
+        if (samples == 0) {
+            ffdecoder_drop_pending_frame(handle);
+            continue;
+        }
+        size_t required = samples * handle->bytesPerFrame;
+        ret = ffdecoder_reserve_interleaved(handle, required);
+        if (ret < 0) {
+            ffdecoder_drop_pending_frame(handle);
+            return ret;
+        }
+        ffdecoder_take_pending(handle, handle->interleavedBuffer, samples);
+        handle->bufferedBytes = required;
+        return (int)required;
+    }
+}
+
+static void ffdecoder_spans_locate(const FFDecoderSpans *spans, size_t at, uint8_t **dst, size_t *room) {
+    if (at < spans->firstBytes) {
+        *dst = spans->first + at;
+        *room = spans->firstBytes - at;
+    } else {
+        *dst = spans->second + (at - spans->firstBytes);
+        *room = spans->secondBytes - (at - spans->firstBytes);
+    }
+}
+
+static void ffdecoder_spans_write(const FFDecoderSpans *spans, size_t at, const uint8_t *src, size_t bytes) {
+    while (bytes > 0) {
+        uint8_t *dst;
+        size_t room;
+        ffdecoder_spans_locate(spans, at, &dst, &room);
+        size_t n = room < bytes ? room : bytes;
+        memcpy(dst, src, n);
+        at += n;
+        src += n;
+        bytes -= n;
+    }
+}
+
+ssize_t ffdecoder_read_spans(FFDecoderHandle *handle, const FFDecoderSpans *spans) {
+    if (!handle || !spans) {
+        return 0;
+    }
+    FFDecoderSpans dst = *spans;
+    if (!dst.first) dst.firstBytes = 0;
+    if (!dst.second) dst.secondBytes = 0;
+    const size_t capacity = dst.firstBytes + dst.secondBytes;
+    size_t written = 0;
+    int ret = 0;
+    while (written < capacity) {
+        const size_t bytesPerFrame = handle->bytesPerFrame;
+        if (bytesPerFrame == 0) {
+            break;
+        }
+        size_t room = capacity - written;
+        room -= room % bytesPerFrame;
+        if (room == 0) {
+            break;
+        }
+        // Anything already staged (fast-open priming, passthrough packets, a
+        // partial ffdecoder_read) goes first.
+        if (handle->bufferedOffset < handle->bufferedBytes) {
+            size_t available = handle->bufferedBytes - handle->bufferedOffset;
+            size_t n = available < room ? available : room;
+            ffdecoder_spans_write(&dst, written, handle->interleavedBuffer + handle->bufferedOffset, n);
+            handle->bufferedOffset += n;
+            written += n;
+            continue;
+        }
+        if (handle->isPassthrough) {
+            ret = ffdecoder_fill_buffer(handle);
+            if (ret <= 0) {
+                break;
+            }
+            continue;
+        }
+        ret = ffdecoder_receive_frame(handle);
+        if (ret <= 0) {
+            break;
+        }
+        size_t frames = ffdecoder_pending_frames(handle);
+        if (frames == 0) {
+            ffdecoder_drop_pending_frame(handle);
+            continue;
+        }
+        size_t wanted = room / bytesPerFrame;
+        if (wanted > frames) {
+            wanted = frames;
+        }
+        while (wanted > 0) {
+            uint8_t *out;
+            size_t spanRoom;
+            ffdecoder_spans_locate(&dst, written, &out, &spanRoom);
+            size_t whole = spanRoom / bytesPerFrame;
+            if (whole == 0) {
+                // This frame straddles the wrap point: stage it and split.
+                ret = ffdecoder_reserve_interleaved(handle, bytesPerFrame);
+                if (ret < 0) {
+                    ffdecoder_drop_pending_frame(handle);
+                    break;
+                }
+                ffdecoder_take_pending(handle, handle->interleavedBuffer, 1);
+                ffdecoder_spans_write(&dst, written, handle->interleavedBuffer, bytesPerFrame);
+                written += bytesPerFrame;
+                wanted -= 1;
+                continue;
+            }
+            size_t n = whole < wanted ? whole : wanted;
+            ffdecoder_take_pending(handle, out, n);
+            written += n * bytesPerFrame;
+            wanted -= n;
+        }
+        if (ret < 0) {
+            break;
+        }
+    }
+    if (written == 0 && ret < 0) {
+        return ret;
+    }
+    return (ssize_t)written;
+}
+
 ssize_t ffdecoder_read(FFDecoderHandle *handle, uint8_t *buffer, size_t maxBytes) {
     if (!handle || !buffer || maxBytes == 0) {
         return 0;
@@ -766,22 +1171,280 @@ ssize_t ffdecoder_read(FFDecoderHandle *handle, uint8_t *buffer, size_t maxBytes
     return (ssize_t)written;
 }
 
+uint64_t ffdecoder_get_buffer_growth_count(FFDecoderHandle *handle) {
+    return handle ? handle->interleavedGrowths : 0;
+}
+
+/* Samples of history a codec needs before a seek target to decode it cleanly. */
+static int64_t ffdecoder_preroll_frames(struct FFDecoderHandle *handle) {
+    const AVCodecParameters *codecpar = handle->stream->codecpar;
+    if (codecpar->seek_preroll > 0) {
+        return codecpar->seek_preroll;
+    }
+    switch (codecpar->codec_id) {
+        case AV_CODEC_ID_MP1:
+        case AV_CODEC_ID_MP2:
+        case AV_CODEC_ID_MP3:
+            /* Main data may start up to 511 bytes back in the bit reservoir. */
+            return 2 * 1152;
+        case AV_CODEC_ID_AAC:
+        case AV_CODEC_ID_VORBIS:
+            /* The first block after a seek is missing its overlap half. */
+            return 2048;
+        default:
+            return 0;
+    }
+}
+
+/* Byte-seeks to the indexed packet at or before `frame` and returns that
+ * packet's stream position, or -1 when there is no usable index (yet). */
+static int64_t ffdecoder_seek_with_index(struct FFDecoderHandle *handle, int64_t frame) {
+    if (!handle->seekIndexDir) {
+        return -1;
+    }
+    if (!handle->seekIndex) {
+        handle->seekIndex = ffdecoder_seekindex_load(handle->seekIndexDir, &handle->seekIndexKey);
+        if (!handle->seekIndex) {
+            return -1;
+        }
+    }
+    uint64_t pointFrame = 0;
+    uint64_t byteOffset = 0;
+    if (ffdecoder_seekindex_sample_rate(handle->seekIndex) != (uint32_t)handle->sampleRate ||
+        !ffdecoder_seekindex_lookup(handle->seekIndex, (uint64_t)frame, &pointFrame, &byteOffset)) {
+        return -1;
+    }
+    if (av_seek_frame(handle->format, handle->stream->index, (int64_t)byteOffset, AVSEEK_FLAG_BYTE) < 0) {
+        return -1;
+    }
+    return (int64_t)pointFrame;
+}
+
 int ffdecoder_seek_ms(FFDecoderHandle *handle, int64_t positionMs) {
-    if (!handle || positionMs < 0) {
+    return ffdecoder_seek_ms_with_mode(handle, positionMs, FFDEC_SEEK_ACCURATE, NULL);
+}
+
+int ffdecoder_seek_ms_with_mode(FFDecoderHandle *handle, int64_t positionMs, FFDecSeekMode mode, int64_t *landedFrame) {
+    if (!handle || positionMs < 0 || handle->sampleRate <= 0) {
         return AVERROR(EINVAL);
     }
-    int64_t target = (int64_t)((positionMs / 1000.0) / av_q2d(handle->stream->time_base));
-    int flags = AVSEEK_FLAG_BACKWARD;
-    int result = av_seek_frame(handle->format, handle->stream->index, target, flags);
-    if (result < 0) {
-        ffdecoder_set_error(av_err2str(result));
-        return result;
+    int64_t seekStart = av_gettime_relative();
+    int accurate = mode == FFDEC_SEEK_ACCURATE;
+    /* Callers see trimmed time; everything below works in untrimmed frames. */
+    int64_t leading = handle->gaplessActive ? (int64_t)handle->gaplessInfo.leadingFrames : 0;
+    int64_t targetFrame = av_rescale(positionMs, handle->sampleRate, 1000) + leading;
+    int64_t preroll = accurate ? ffdecoder_preroll_frames(handle) : 0;
+    int64_t seekFrame = targetFrame > preroll ? targetFrame - preroll : 0;
+    /* After a byte seek the demuxer's timestamps are bit-rate estimates, so
+     * positions are counted on from the index point instead. */
+    int useTimestamps = 1;
+    int64_t indexFrame = ffdecoder_seek_with_index(handle, seekFrame);
+    if (indexFrame >= 0) {
+        seekFrame = indexFrame;
+        useTimestamps = 0;
+    } else {
+        int64_t target = av_rescale_q(seekFrame, (AVRational){1, handle->sampleRate}, handle->stream->time_base);
+        target += ffdecoder_ts_origin(handle);
+        int result = av_seek_frame(handle->format, handle->stream->index, target, AVSEEK_FLAG_BACKWARD);
+        if (result < 0) {
+            ffdecoder_set_error(av_err2str(result));
+            return result;
+        }
     }
+    ffdecoder_drop_pending_frame(handle);
     if (handle->codec) {
         avcodec_flush_buffers(handle->codec);
     }
     handle->bufferedBytes = 0;
     handle->bufferedOffset = 0;
     handle->eofReached = 0;
+    handle->gaplessNextFrame = -1;
+
+    /* Decode until the landing point is known. Accurate seeks keep going,
+     * discarding pre-roll, until the block that holds the target. */
+    int64_t landed = seekFrame;
+    while (1) {
+        int64_t start;
+        int64_t frames;
+        if (handle->isPassthrough) {
+            if (ffdecoder_fill_buffer(handle) <= 0) {
+                break;
+            }
+            start = useTimestamps ? handle->bufferedStartFrame : -1;
+            frames = (int64_t)(handle->bufferedBytes / handle->bytesPerFrame);
+        } else {
+            if (ffdecoder_receive_frame(handle) <= 0) {
+                break;
+            }
+            start = useTimestamps ? ffdecoder_ts_to_frame(handle, handle->frame->best_effort_timestamp) : -1;
+            frames = (int64_t)ffdecoder_pending_frames(handle);
+        }
+        if (start < 0) {
+            start = landed;
+        }
+        if (!accurate || start + frames > targetFrame) {
+            int64_t skip = accurate && targetFrame > start ? targetFrame - start : 0;
+            if (handle->isPassthrough) {
+                handle->bufferedOffset = (size_t)skip * handle->bytesPerFrame;
+            } else {
+                handle->pendingFrameOffset += (int)skip;
+            }
+            landed = start + skip;
+            break;
+        }
+        landed = start + frames;
+        if (handle->isPassthrough) {
+            handle->bufferedBytes = 0;
+            handle->bufferedOffset = 0;
+        } else {
+            ffdecoder_drop_pending_frame(handle);
+        }
+    }
+    if (handle->gaplessActive) {
+        /* Resume position counting from the landing frame and trim it like
+         * any other. */
+        if (handle->framePending) {
+            handle->gaplessNextFrame = landed - handle->pendingFrameOffset;
+            if (!ffdecoder_gapless_clip(handle)) {
+                ffdecoder_drop_pending_frame(handle);
+            }
+        } else {
+            handle->gaplessNextFrame = landed;
+        }
+        landed = landed > leading ? landed - leading : 0;
+    }
+    if (landedFrame) {
+        *landedFrame = landed;
+    }
+    handle->lastSeekUs = av_gettime_relative() - seekStart;
+    return 0;
+}
+
+int64_t ffdecoder_get_last_seek_us(FFDecoderHandle *handle) {
+    return handle ? handle->lastSeekUs : 0;
+}
+
+FFDecoderGaplessInfo ffdecoder_get_gapless_info(FFDecoderHandle *handle) {
+    FFDecoderGaplessInfo empty = {0};
+    return handle && handle->gaplessActive ? handle->gaplessInfo : empty;
+}
+
+/* Shorter files seek quickly enough by bisection. */
+#define FFDECODER_SEEK_INDEX_MIN_MS (10 * 60 * 1000)
+
+static int ffdecoder_stream_lacks_seek_table(const AVFormatContext *format, const AVStream *stream) {
+    const char *demuxer = format->iformat ? format->iformat->name : "";
+    switch (stream->codecpar->codec_id) {
+        case AV_CODEC_ID_MP3:
+            return strcmp(demuxer, "mp3") == 0;
+        case AV_CODEC_ID_AAC:
+            return strcmp(demuxer, "aac") == 0;
+        case AV_CODEC_ID_FLAC:
+            return strcmp(demuxer, "flac") == 0 && avformat_index_get_entries_count(stream) == 0;
+        default:
+            return 0;
+    }
+}
+
+int ffdecoder_wants_seek_index(FFDecoderHandle *handle) {
+    if (!handle || !handle->format || !handle->stream) {
+        return 0;
+    }
+    if (!ffdecoder_stream_lacks_seek_table(handle->format, handle->stream)) {
+        return 0;
+    }
+    /* Unknown length means the demuxer could not even estimate it. */
+    return handle->durationMs <= 0 || handle->durationMs >= FFDECODER_SEEK_INDEX_MIN_MS;
+}
+
+int ffdecoder_build_seek_index(const char *path, const char *cacheDir) {
+    FFDecoderSeekIndexKey key;
+    if (!path || !cacheDir || ffdecoder_seekindex_key_for_path(path, &key) != 0) {
+        return AVERROR(EINVAL);
+    }
+    FFDecoderSeekIndex *cached = ffdecoder_seekindex_load(cacheDir, &key);
+    if (cached) {
+        ffdecoder_seekindex_free(cached);
+        return 0;
+    }
+
+    AVFormatContext *format = NULL;
+    int ret = avformat_open_input(&format, path, NULL, NULL);
+    if (ret < 0) {
+        ffdecoder_set_error(av_err2str(ret));
+        return ret;
+    }
+    int streamIndex = av_find_best_stream(format, AVMEDIA_TYPE_AUDIO, -1, -1, NULL, 0);
+    if (streamIndex >= 0 && format->streams[streamIndex]->codecpar->sample_rate <= 0) {
+        /* ADTS only learns its rate from the first frames. */
+        avformat_find_stream_info(format, NULL);
+    }
+    AVStream *stream = streamIndex >= 0 ? format->streams[streamIndex] : NULL;
+    int sampleRate = stream ? stream->codecpar->sample_rate : 0;
+    AVPacket *packet = av_packet_alloc();
+    FFDecoderSeekIndex *index = sampleRate > 0
+        ? ffdecoder_seekindex_create((uint32_t)sampleRate, (uint32_t)(sampleRate > 1 ? sampleRate / 2 : 1))
+        : NULL;
+    if (!packet || !index) {
+        av_packet_free(&packet);
+        ffdecoder_seekindex_free(index);
+        avformat_close_input(&format);
+        return sampleRate > 0 ? AVERROR(ENOMEM) : AVERROR_STREAM_NOT_FOUND;
+    }
+
+    AVRational frameBase = (AVRational){1, sampleRate};
+    int64_t origin = stream->start_time != AV_NOPTS_VALUE ? stream->start_time : 0;
+    /* Parser-derived packet timestamps are exact for these demuxers; the
+     * running count covers packets without one. */
+    int64_t frame = 0;
+    ret = 0;
+    while (ret >= 0 && av_read_frame(format, packet) >= 0) {
+        if (packet->stream_index == streamIndex) {
+            if (packet->pts != AV_NOPTS_VALUE) {
+                frame = av_rescale_q(packet->pts - origin, stream->time_base, frameBase);
+                if (frame < 0) frame = 0;
+            }
+            if (packet->pos >= 0) {
+                ret = ffdecoder_seekindex_add(index, (uint64_t)frame, (uint64_t)packet->pos);
+            }
+            frame += packet->duration > 0
+                ? av_rescale_q(packet->duration, stream->time_base, frameBase)
+                : (stream->codecpar->frame_size > 0 ? stream->codecpar->frame_size : 0);
+        }
+        av_packet_unref(packet);
+    }
+    av_packet_free(&packet);
+    avformat_close_input(&format);
+
+    if (ret >= 0) {
+        ret = ffdecoder_seekindex_count(index) > 0 && ffdecoder_seekindex_save(index, cacheDir, &key) == 0
+            ? 1
+            : AVERROR(EIO);
+    } else {
+        ret = AVERROR(ENOMEM);
+    }
+    ffdecoder_seekindex_free(index);
+    return ret;
+}
+
+int ffdecoder_attach_seek_index(FFDecoderHandle *handle, const char *cacheDir) {
+    if (!handle || !handle->format || !handle->format->url || !cacheDir) {
+        return AVERROR(EINVAL);
+    }
+    char *path = av_strdup(handle->format->url);
+    char *dir = av_strdup(cacheDir);
+    FFDecoderSeekIndexKey key;
+    if (!path || !dir || ffdecoder_seekindex_key_for_path(path, &key) != 0) {
+        av_free(path);
+        av_free(dir);
+        return path && dir ? AVERROR(ENOENT) : AVERROR(ENOMEM);
+    }
+    ffdecoder_seekindex_free(handle->seekIndex);
+    av_free(handle->seekIndexDir);
+    av_free(handle->seekIndexPath);
+    handle->seekIndex = NULL;
+    handle->seekIndexDir = dir;
+    handle->seekIndexPath = path;
+    handle->seekIndexKey = key;
     return 0;
 }
@@ -0,0 +1,395 @@
+#include "FFmpegDither.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define FFD_HAVE_X86 1
+#include <emmintrin.h>
+#endif
+
+#if defined(__aarch64__)
+#define FFD_HAVE_NEON 1
+#include <arm_neon.h>
+#endif
+
+#define FFD_LANES FFDEC_DITHER_MAX_CHANNELS
+#define FFD_MAX_TAPS 9
+/* Frames converted per pass; bounds the float scratch. */
+#define FFD_BLOCK_FRAMES 512
+
+/* Error-feedback filters H(z); the noise transfer function is 1 - H(z). */
+static const float kHighpassTaps[2] = {2.0f, -1.0f};
+/* Wannamaker's 9-tap F-weighted design for 44.1 kHz. */
+static const float kFWeightedTaps[FFD_MAX_TAPS] = {2.412f, -3.370f, 3.937f, -4.174f, 3.353f,
+                                                   -2.205f, 1.281f, -0.569f, 0.0847f};
+/* Above this rate FFDEC_DITHER_FWEIGHTED falls back to the high-pass filter. */
+#define FFD_MAX_FWEIGHTED_RATE 50000u
+
+/* TPDF dither from the two 16-bit halves of one xorshift32 draw, in LSBs:
+ * (lo + hi) * step - offset spans (-1, 1), exact in float. */
+#define FFD_DITHER_STEP (1.0f / 65536.0f)
+#define FFD_DITHER_OFFSET (65535.0f / 65536.0f)
+
+struct FFRequantizer {
+    /* Past quantization errors per channel in LSBs, newest first. */
+    float error[FFD_MAX_TAPS][FFD_LANES];
+    /* One xorshift32 generator per channel. */
+    uint32_t rng[FFD_LANES];
+    float scratch[FFD_BLOCK_FRAMES * FFD_LANES];
+    float taps[FFD_MAX_TAPS];
+    uint32_t tap_count;
+    /* 2^(bits - 1) for the dithered word length. */
+    float scale;
+    FFSampleType type;
+    uint32_t sample_rate;
+    uint32_t channels;
+    /* Written by ffdecoder_requantizer_set_mode() on any thread. */
+    int mode;
+    /* Render side: the mode the taps were set up for; -1 forces a setup. */
+    int active_mode;
+};
+
+/* Dithers and rounds `frames` interleaved float frames in place, in units of
+ * 1 / scale. The input is clamped before the feedback is subtracted and the
+ * error taken before the output clamp, so the loop stays bounded on clipped
+ * material. The oldest error is summed first to keep the serial chain
+ * short. */
+typedef void (*ffd_kernel)(FFRequantizer *rq, float *samples, size_t frames);
+
+/* ---- Scalar ---------------------------------------------------------------- */
+
+static inline uint32_t ffd_xorshift(uint32_t r) {
+    r ^= r << 13;
+    r ^= r >> 17;
+    r ^= r << 5;
+    return r;
+}
+
+static inline float ffd_clampf(float x, float lo, float hi) {
+    return x < lo ? lo : (x > hi ? hi : x);
+}
+
+static void ffd_scalar(FFRequantizer *rq, float *samples, size_t frames) {
+    const uint32_t channels = rq->channels;
+    const uint32_t taps = rq->tap_count;
+    const float scale = rq->scale;
+    const float lo = -scale;
+    const float hi = scale - 1.0f;
+    const float inverse = 1.0f / scale;
+    for (uint32_t ch = 0; ch < channels; ++ch) {
+        float e[FFD_MAX_TAPS];
+        for (uint32_t k = 0; k < taps; ++k) e[k] = rq->error[k][ch];
+        uint32_t r = rq->rng[ch];
+        float *p = samples + ch;
+        for (size_t f = 0; f < frames; ++f, p += channels) {
+            float feedback = 0.0f;
+            for (uint32_t k = taps; k-- > 0;) feedback = feedback + rq->taps[k] * e[k];
+            const float shaped = ffd_clampf(*p * scale, lo, hi) - feedback;
+            r = ffd_xorshift(r);
+            const float dither =
+                (float)((r & 0xFFFFu) + (r >> 16)) * FFD_DITHER_STEP - FFD_DITHER_OFFSET;
+            const float q = nearbyintf(shaped + dither);
+            for (uint32_t k = taps; k-- > 1;) e[k] = e[k - 1];
+            if (taps > 0) e[0] = q - shaped;
+            *p = ffd_clampf(q, lo, hi) * inverse;
+        }
+        for (uint32_t k = 0; k < taps; ++k) rq->error[k][ch] = e[k];
+        rq->rng[ch] = r;
+    }
+}
+
+/* ---- SSE2 (also used for AVX2) ------------------------------------------- */
+
+#if FFD_HAVE_X86
+
+static inline __m128 ffd_load4(const float *p, uint32_t n) {
+    switch (n) {
+        case 4: return _mm_loadu_ps(p);
+        case 2: return _mm_loadl_pi(_mm_setzero_ps(), (const __m64 *)p);
+        case 1: return _mm_load_ss(p);
+        default: return _mm_setr_ps(p[0], p[1], p[2], 0.0f);
+    }
+}
+
+static inline void ffd_store4(float *p, __m128 v, uint32_t n) {
+    switch (n) {
+        case 4: _mm_storeu_ps(p, v); break;
+        case 2: _mm_storel_pi((__m64 *)p, v); break;
+        case 1: _mm_store_ss(p, v); break;
+        default:
+            _mm_storel_pi((__m64 *)p, v);
+            _mm_store_ss(p + 2, _mm_movehl_ps(v, v));
+            break;
+    }
+}
+
+/* Channels sit in the lanes; each group of four runs through the block with
+ * its error history in registers. */
+static void ffd_sse2(FFRequantizer *rq, float *samples, size_t frames) {
+    const uint32_t channels = rq->channels;
+    const uint32_t taps = rq->tap_count;
+    const __m128 scale = _mm_set1_ps(rq->scale);
+    const __m128 lo = _mm_set1_ps(-rq->scale);
+    const __m128 hi = _mm_set1_ps(rq->scale - 1.0f);
+    const __m128 inverse = _mm_set1_ps(1.0f / rq->scale);
+    const __m128 step = _mm_set1_ps(FFD_DITHER_STEP);
+    const __m128 offset = _mm_set1_ps(FFD_DITHER_OFFSET);
+    const __m128i low16 = _mm_set1_epi32(0xFFFF);
+    __m128 h[FFD_MAX_TAPS];
+    for (uint32_t k = 0; k < taps; ++k) h[k] = _mm_set1_ps(rq->taps[k]);
+    for (uint32_t group = 0; group < channels; group += 4) {
+        const uint32_t n = channels - group < 4 ? channels - group : 4;
+        __m128 e[FFD_MAX_TAPS];
+        for (uint32_t k = 0; k < taps; ++k) e[k] = _mm_loadu_ps(rq->error[k] + group);
+        __m128i r = _mm_loadu_si128((const __m128i *)(rq->rng + group));
+        float *p = samples + group;
+        for (size_t f = 0; f < frames; ++f, p += channels) {
+            __m128 feedback = _mm_setzero_ps();
+            for (uint32_t k = taps; k-- > 0;) {
+                feedback = _mm_add_ps(feedback, _mm_mul_ps(h[k], e[k]));
+            }
+            const __m128 shaped = _mm_sub_ps(
+                _mm_min_ps(_mm_max_ps(_mm_mul_ps(ffd_load4(p, n), scale), lo), hi), feedback);
+            r = _mm_xor_si128(r, _mm_slli_epi32(r, 13));
+            r = _mm_xor_si128(r, _mm_srli_epi32(r, 17));
+            r = _mm_xor_si128(r, _mm_slli_epi32(r, 5));
+            const __m128 dither = _mm_sub_ps(
+                _mm_mul_ps(_mm_cvtepi32_ps(_mm_add_epi32(_mm_and_si128(r, low16),
+                                                         _mm_srli_epi32(r, 16))),
+                           step),
+                offset);
+            const __m128 q = _mm_cvtepi32_ps(_mm_cvtps_epi32(_mm_add_ps(shaped, dither)));
+            for (uint32_t k = taps; k-- > 1;) e[k] = e[k - 1];
+            if (taps > 0) e[0] = _mm_sub_ps(q, shaped);
+            ffd_store4(p, _mm_mul_ps(_mm_min_ps(_mm_max_ps(q, lo), hi), inverse), n);
+        }
+        for (uint32_t k = 0; k < taps; ++k) _mm_storeu_ps(rq->error[k] + group, e[k]);
+        _mm_storeu_si128((__m128i *)(rq->rng + group), r);
+    }
+}
+
+#endif /* FFD_HAVE_X86 */
+
+/* ---- NEON ------------------------------------------------------------------ */
+
+#if FFD_HAVE_NEON
+
+static void ffd_neon(FFRequantizer *rq, float *samples, size_t frames) {
+    const uint32_t channels = rq->channels;
+    const uint32_t taps = rq->tap_count;
+    const float32x4_t scale = vdupq_n_f32(rq->scale);
+    const float32x4_t lo = vdupq_n_f32(-rq->scale);
+    const float32x4_t hi = vdupq_n_f32(rq->scale - 1.0f);
+    const float32x4_t inverse = vdupq_n_f32(1.0f / rq->scale);
+    const float32x4_t step = vdupq_n_f32(FFD_DITHER_STEP);
+    const float32x4_t offset = vdupq_n_f32(FFD_DITHER_OFFSET);
+    const uint32x4_t low16 = vdupq_n_u32(0xFFFF);
+    float32x4_t h[FFD_MAX_TAPS];
+    for (uint32_t k = 0; k < taps; ++k) h[k] = vdupq_n_f32(rq->taps[k]);
+    for (uint32_t group = 0; group < channels; group += 4) {
+        const uint32_t n = channels - group < 4 ? channels - group : 4;
+        float32x4_t e[FFD_MAX_TAPS];
+        for (uint32_t k = 0; k < taps; ++k) e[k] = vld1q_f32(rq->error[k] + group);
+        uint32x4_t r = vld1q_u32(rq->rng + group);
+        float *p = samples + group;
+        for (size_t f = 0; f < frames; ++f, p += channels) {
+            float32x4_t x;
+            if (n == 4) {
+                x = vld1q_f32(p);
+            } else {
+                const float padded[4] = {p[0], n > 1 ? p[1] : 0.0f, n > 2 ? p[2] : 0.0f, 0.0f};
+                x = vld1q_f32(padded);
+            }
+            float32x4_t feedback = vdupq_n_f32(0.0f);
+            for (uint32_t k = taps; k-- > 0;) {
+                feedback = vaddq_f32(feedback, vmulq_f32(h[k], e[k]));
+            }
+            const float32x4_t shaped =
+                vsubq_f32(vminq_f32(vmaxq_f32(vmulq_f32(x, scale), lo), hi), feedback);
+            r = veorq_u32(r, vshlq_n_u32(r, 13));
+            r = veorq_u32(r, vshrq_n_u32(r, 17));
+            r = veorq_u32(r, vshlq_n_u32(r, 5));
+            const float32x4_t dither = vsubq_f32(
+                vmulq_f32(vcvtq_f32_u32(vaddq_u32(vandq_u32(r, low16), vshrq_n_u32(r, 16))),
+                          step),
+                offset);
+            const float32x4_t q = vcvtq_f32_s32(vcvtnq_s32_f32(vaddq_f32(shaped, dither)));
+            for (uint32_t k = taps; k-- > 1;) e[k] = e[k - 1];
+            if (taps > 0) e[0] = vsubq_f32(q, shaped);
+            const float32x4_t out = vmulq_f32(vminq_f32(vmaxq_f32(q, lo), hi), inverse);
+            if (n == 4) {
+                vst1q_f32(p, out);
+            } else {
+                float padded[4];
+                vst1q_f32(padded, out);
+                for (uint32_t ch = 0; ch < n; ++ch) p[ch] = padded[ch];
+            }
+        }
+        for (uint32_t k = 0; k < taps; ++k) vst1q_f32(rq->error[k] + group, e[k]);
+        vst1q_u32(rq->rng + group, r);
+    }
+}
+
+#endif /* FFD_HAVE_NEON */
+
+/* ---- Conversion ------------------------------------------------------------ */
+
+/* Integer samples times gain to float, full scale 1.0. */
+static void ffd_to_float(FFSampleType type, const void *src, float *dst, size_t count,
+                         double gain) {
+    switch (type) {
+        case FFDEC_SAMPLE_S16: {
+            const int16_t *s = (const int16_t *)src;
+            const float g = (float)(gain / 32768.0);
+            for (size_t i = 0; i < count; ++i) dst[i] = s[i] * g;
+            return;
+        }
+        case FFDEC_SAMPLE_S24: {
+            const uint8_t *s = (const uint8_t *)src;
+            const float g = (float)(gain / 8388608.0);
+            for (size_t i = 0; i < count; ++i, s += 3) {
+                const int32_t value = (int32_t)(((uint32_t)s[0] << 8) | ((uint32_t)s[1] << 16) |
+                                                ((uint32_t)s[2] << 24)) >> 8;
+                dst[i] = value * g;
+            }
+            return;
+        }
+        case FFDEC_SAMPLE_S32: {
+            const int32_t *s = (const int32_t *)src;
+            const double g = gain / 2147483648.0;
+            for (size_t i = 0; i < count; ++i) dst[i] = (float)(s[i] * g);
+            return;
+        }
+        default:
+            return;
+    }
+}
+
+/* Dithered float back to integers. The values are exact multiples of one
+ * output step inside the range, so the products are exact. */
+static void ffd_from_float(FFSampleType type, const float *src, void *dst, size_t count) {
+    switch (type) {
+        case FFDEC_SAMPLE_S16: {
+            int16_t *d = (int16_t *)dst;
+            for (size_t i = 0; i < count; ++i) d[i] = (int16_t)(src[i] * 32768.0f);
+            return;
+        }
+        case FFDEC_SAMPLE_S24: {
+            uint8_t *d = (uint8_t *)dst;
+            for (size_t i = 0; i < count; ++i, d += 3) {
+                const int32_t value = (int32_t)(src[i] * 8388608.0f);
+                d[0] = (uint8_t)value;
+                d[1] = (uint8_t)(value >> 8);
+                d[2] = (uint8_t)(value >> 16);
+            }
+            return;
+        }
+        case FFDEC_SAMPLE_S32: {
+            int32_t *d = (int32_t *)dst;
+            for (size_t i = 0; i < count; ++i) d[i] = (int32_t)(src[i] * 2147483648.0f);
+            return;
+        }
+        default:
+            return;
+    }
+}
+
+/* ---- API ------------------------------------------------------------------- */
+
+static ffd_kernel ffd_select_kernel(FFInterleaveISA isa) {
+    switch (isa) {
+#if FFD_HAVE_X86
+        case FFDEC_INTERLEAVE_ISA_AVX2:
+        case FFDEC_INTERLEAVE_ISA_SSE2:
+            return ffd_sse2;
+#endif
+#if FFD_HAVE_NEON
+        case FFDEC_INTERLEAVE_ISA_NEON:
+            return ffd_neon;
+#endif
+        default:
+            return ffd_scalar;
+    }
+}
+
+static void ffd_update_mode(FFRequantizer *rq) {
+    const int mode = __atomic_load_n(&rq->mode, __ATOMIC_RELAXED);
+    if (mode == rq->active_mode) return;
+    rq->active_mode = mode;
+    memset(rq->taps, 0, sizeof(rq->taps));
+    rq->tap_count = 0;
+    if (mode == FFDEC_DITHER_FWEIGHTED && rq->sample_rate <= FFD_MAX_FWEIGHTED_RATE) {
+        memcpy(rq->taps, kFWeightedTaps, sizeof(kFWeightedTaps));
+        rq->tap_count = FFD_MAX_TAPS;
+    } else if (mode == FFDEC_DITHER_FWEIGHTED || mode == FFDEC_DITHER_HIGHPASS) {
+        memcpy(rq->taps, kHighpassTaps, sizeof(kHighpassTaps));
+        rq->tap_count = 2;
+    }
+    ffdecoder_requantizer_reset(rq);
+}
+
+FFRequantizer *ffdecoder_requantizer_create(void) {
+    FFRequantizer *rq = (FFRequantizer *)calloc(1, sizeof(FFRequantizer));
+    if (!rq) return NULL;
+    rq->mode = FFDEC_DITHER_FWEIGHTED;
+    rq->active_mode = -1;
+    ffdecoder_requantizer_reset(rq);
+    return rq;
+}
+
+void ffdecoder_requantizer_free(FFRequantizer *rq) { free(rq); }
+
+int ffdecoder_requantizer_configure(FFRequantizer *rq, FFSampleType type,
+                                    uint32_t sample_rate, uint32_t channels) {
+    if (!rq) return -1;
+    rq->channels = 0;
+    if ((type != FFDEC_SAMPLE_S16 && type != FFDEC_SAMPLE_S24 && type != FFDEC_SAMPLE_S32) ||
+        channels == 0 || channels > FFD_LANES) {
+        return -1;
+    }
+    rq->type = type;
+    rq->sample_rate = sample_rate;
+    rq->scale = type == FFDEC_SAMPLE_S16 ? 32768.0f : 8388608.0f;
+    rq->channels = channels;
+    rq->active_mode = -1;
+    ffd_update_mode(rq);
+    return 0;
+}
+
+int ffdecoder_requantizer_is_configured(const FFRequantizer *rq) {
+    return rq && rq->channels != 0;
+}
+
+void ffdecoder_requantizer_set_mode(FFRequantizer *rq, FFDitherMode mode) {
+    if (rq) __atomic_store_n(&rq->mode, (int)mode, __ATOMIC_RELAXED);
+}
+
+void ffdecoder_requantizer_apply_gain(FFRequantizer *rq, void *samples, size_t frames,
+                                      double gain) {
+    if (!rq || !samples || rq->channels == 0 || gain == 1.0) return;
+    ffd_update_mode(rq);
+    if (rq->active_mode == FFDEC_DITHER_OFF) {
+        ffdecoder_scale_samples(rq->type, samples, frames * rq->channels, gain);
+        return;
+    }
+    const ffd_kernel kernel = ffd_select_kernel(ffdecoder_sample_kernels_isa());
+    const size_t bytes_per_frame =
+        (rq->type == FFDEC_SAMPLE_S16 ? 2 : rq->type == FFDEC_SAMPLE_S24 ? 3 : 4) * rq->channels;
+    uint8_t *bytes = (uint8_t *)samples;
+    while (frames > 0) {
+        const size_t n = frames < FFD_BLOCK_FRAMES ? frames : FFD_BLOCK_FRAMES;
+        ffd_to_float(rq->type, bytes, rq->scratch, n * rq->channels, gain);
+        kernel(rq, rq->scratch, n);
+        ffd_from_float(rq->type, rq->scratch, bytes, n * rq->channels);
+        bytes += n * bytes_per_frame;
+        frames -= n;
+    }
+}
+
+void ffdecoder_requantizer_reset(FFRequantizer *rq) {
+    if (!rq) return;
+    memset(rq->error, 0, sizeof(rq->error));
+    for (uint32_t ch = 0; ch < FFD_LANES; ++ch) rq->rng[ch] = 0x9E3779B9u * (ch + 1);
+}
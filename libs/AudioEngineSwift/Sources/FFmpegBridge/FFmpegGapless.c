@@ -0,0 +1,134 @@
+#include "FFmpegGapless.h"
+
+#include <ctype.h>
+#include <string.h>
+
+static uint32_t gapless_read_be32(const uint8_t *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+/* Parses the next whitespace-separated hex token at `*cursor`. */
+static int gapless_next_hex(const char **cursor, uint64_t *value) {
+    const char *p = *cursor;
+    while (*p && isspace((unsigned char)*p)) {
+        p++;
+    }
+    uint64_t result = 0;
+    int digits = 0;
+    while (*p && !isspace((unsigned char)*p)) {
+        unsigned char c = (unsigned char)*p;
+        if (!isxdigit(c) || digits == 16) {
+            return 0;
+        }
+        int digit = isdigit(c) ? c - '0' : tolower(c) - 'a' + 10;
+        result = (result << 4) | (uint64_t)digit;
+        digits++;
+        p++;
+    }
+    if (digits == 0) {
+        return 0;
+    }
+    *cursor = p;
+    *value = result;
+    return 1;
+}
+
+/* Size of a leading ID3v2 tag, including header and footer, or 0. */
+static size_t gapless_id3v2_size(const uint8_t *data, size_t size) {
+    if (size < 10 || memcmp(data, "ID3", 3) != 0) {
+        return 0;
+    }
+    size_t body = ((size_t)(data[6] & 0x7f) << 21) |
+                  ((size_t)(data[7] & 0x7f) << 14) |
+                  ((size_t)(data[8] & 0x7f) << 7) |
+                  (size_t)(data[9] & 0x7f);
+    int hasFooter = (data[5] & 0x10) != 0;
+    return 10 + body + (hasFooter ? 10 : 0);
+}
+
+int ffdecoder_gapless_parse_itunsmpb(const char *value, FFDecoderGaplessInfo *info) {
+    if (!value || !info) {
+        return 0;
+    }
+    const char *cursor = value;
+    uint64_t reserved = 0;
+    uint64_t delay = 0;
+    uint64_t padding = 0;
+    uint64_t length = 0;
+    if (!gapless_next_hex(&cursor, &reserved) || !gapless_next_hex(&cursor, &delay) ||
+        !gapless_next_hex(&cursor, &padding) || !gapless_next_hex(&cursor, &length)) {
+        return 0;
+    }
+    if (delay == 0 && padding == 0 && length == 0) {
+        return 0;
+    }
+    info->leadingFrames = delay;
+    info->trailingFrames = padding;
+    info->validFrames = length;
+    return 1;
+}
+
+int ffdecoder_gapless_parse_lame(const uint8_t *data, size_t size, FFDecoderGaplessInfo *info) {
+    if (!data || !info) {
+        return 0;
+    }
+    size_t pos = gapless_id3v2_size(data, size);
+    if (pos + 4 > size) {
+        return 0;
+    }
+    const uint8_t *frame = data + pos;
+    /* Frame sync, layer III, valid bit rate and sample rate indices. */
+    if (frame[0] != 0xff || (frame[1] & 0xe0) != 0xe0) {
+        return 0;
+    }
+    int version = (frame[1] >> 3) & 0x03;  /* 3 = MPEG-1, 2 = MPEG-2, 0 = 2.5 */
+    int layer = (frame[1] >> 1) & 0x03;    /* 1 = layer III */
+    if (version == 1 || layer != 1) {
+        return 0;
+    }
+    if ((frame[2] >> 4) == 0x0f || ((frame[2] >> 2) & 0x03) == 0x03) {
+        return 0;
+    }
+    int mpeg1 = version == 3;
+    int mono = (frame[3] >> 6) == 0x03;
+    size_t sideInfo = mpeg1 ? (mono ? 17 : 32) : (mono ? 9 : 17);
+    uint64_t samplesPerFrame = mpeg1 ? 1152 : 576;
+
+    size_t tag = pos + 4 + sideInfo;
+    if (tag + 8 > size) {
+        return 0;
+    }
+    if (memcmp(data + tag, "Xing", 4) != 0 && memcmp(data + tag, "Info", 4) != 0) {
+        return 0;
+    }
+    uint32_t flags = gapless_read_be32(data + tag + 4);
+    size_t cursor = tag + 8;
+    uint64_t frames = 0;
+    if (flags & 0x1) {
+        if (cursor + 4 > size) {
+            return 0;
+        }
+        frames = gapless_read_be32(data + cursor);
+        cursor += 4;
+    }
+    if (flags & 0x2) cursor += 4;    /* byte count */
+    if (flags & 0x4) cursor += 100;  /* seek TOC */
+    if (flags & 0x8) cursor += 4;    /* quality */
+
+    /* LAME extension: 9-byte encoder string, then delay/padding 21 bytes in. */
+    if (cursor + 24 > size) {
+        return 0;
+    }
+    const uint8_t *lame = data + cursor;
+    if (memcmp(lame, "LAME", 4) != 0 && memcmp(lame, "Lavc", 4) != 0 && memcmp(lame, "Lavf", 4) != 0) {
+        return 0;
+    }
+    uint64_t encoderDelay = ((uint64_t)lame[21] << 4) | (lame[22] >> 4);
+    uint64_t encoderPadding = ((uint64_t)(lame[22] & 0x0f) << 8) | lame[23];
+
+    info->leadingFrames = encoderDelay + FFDEC_MP3_DECODER_DELAY;
+    info->trailingFrames = encoderPadding > FFDEC_MP3_DECODER_DELAY ? encoderPadding - FFDEC_MP3_DECODER_DELAY : 0;
+    uint64_t decoded = frames * samplesPerFrame;
+    info->validFrames = decoded > encoderDelay + encoderPadding ? decoded - encoderDelay - encoderPadding : 0;
+    return 1;
+}
@@ -0,0 +1,527 @@
+#include "FFmpegInterleave.h"
+
+#include <pthread.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define FFI_HAVE_X86 1
+#include <emmintrin.h>
+#include <immintrin.h>
+#endif
+
+#if defined(__aarch64__)
+#define FFI_HAVE_NEON 1
+#include <arm_neon.h>
+#endif
+
+/* Vector kernels process whole blocks and return how many frames they wrote;
+ * the remainder goes through the fixed-size scalar path. `src` is already
+ * advanced to the first frame. */
+typedef size_t (*ffi_kernel)(uint8_t *dst, const uint8_t *const *src, size_t frames);
+
+#define FFI_MAX_KERNEL_CHANNELS 8
+
+/* ---- Scalar ---------------------------------------------------------------- */
+
+void ffdecoder_interleave_scalar(uint8_t *dst, const uint8_t *const *planes,
+                                 size_t srcFrameOffset, size_t frames,
+                                 int channels, size_t bytesPerSample) {
+    for (size_t frame = 0; frame < frames; ++frame) {
+        for (int ch = 0; ch < channels; ++ch) {
+            memcpy(dst + (frame * (size_t)channels + (size_t)ch) * bytesPerSample,
+                   planes[ch] + (srcFrameOffset + frame) * bytesPerSample,
+                   bytesPerSample);
+        }
+    }
+}
+
+/* Constant-size memcpy compiles to a single load/store; walking one plane at
+ * a time keeps the reads sequential. */
+#define FFI_DEFINE_GENERIC(NAME, BYTES)                                              \
+    static void NAME(uint8_t *dst, const uint8_t *const *planes, size_t offset,     \
+                     size_t begin, size_t end, int channels) {                      \
+        const size_t stride = (size_t)channels * (BYTES);                           \
+        for (int ch = 0; ch < channels; ++ch) {                                     \
+            const uint8_t *src = planes[ch] + (offset + begin) * (BYTES);           \
+            uint8_t *out = dst + begin * stride + (size_t)ch * (BYTES);             \
+            for (size_t frame = begin; frame < end; ++frame) {                      \
+                memcpy(out, src, (BYTES));                                          \
+                src += (BYTES);                                                     \
+                out += stride;                                                      \
+            }                                                                       \
+        }                                                                           \
+    }
+
+FFI_DEFINE_GENERIC(ffi_generic_1, 1)
+FFI_DEFINE_GENERIC(ffi_generic_2, 2)
+FFI_DEFINE_GENERIC(ffi_generic_3, 3)
+FFI_DEFINE_GENERIC(ffi_generic_4, 4)
+FFI_DEFINE_GENERIC(ffi_generic_8, 8)
+
+static void ffi_generic(uint8_t *dst, const uint8_t *const *planes, size_t offset,
+                        size_t begin, size_t end, int channels, size_t bytesPerSample) {
+    switch (bytesPerSample) {
+        case 1: ffi_generic_1(dst, planes, offset, begin, end, channels); return;
+        case 2: ffi_generic_2(dst, planes, offset, begin, end, channels); return;
+        case 3: ffi_generic_3(dst, planes, offset, begin, end, channels); return;
+        case 4: ffi_generic_4(dst, planes, offset, begin, end, channels); return;
+        case 8: ffi_generic_8(dst, planes, offset, begin, end, channels); return;
+        default: {
+            const size_t stride = (size_t)channels * bytesPerSample;
+            ffdecoder_interleave_scalar(dst + begin * stride, planes, offset + begin,
+                                        end - begin, channels, bytesPerSample);
+            return;
+        }
+    }
+}
+
+/* ---- SSE2 / AVX2 ----------------------------------------------------------- */
+
+#if FFI_HAVE_X86
+
+#define FFI_LOAD(p, i) _mm_loadu_si128((const __m128i *)((p) + (i)))
+#define FFI_STORE(p, v) _mm_storeu_si128((__m128i *)(p), (v))
+
+static size_t ffi_sse2_2ch_16(uint8_t *dst, const uint8_t *const *src, size_t frames) {
+    size_t frame = 0;
+    for (; frame + 8 <= frames; frame += 8) {
+        __m128i l = FFI_LOAD(src[0], frame * 2);
+        __m128i r = FFI_LOAD(src[1], frame * 2);
+        FFI_STORE(dst + frame * 4, _mm_unpacklo_epi16(l, r));
+        FFI_STORE(dst + frame * 4 + 16, _mm_unpackhi_epi16(l, r));
+    }
+    return frame;
+}
+
+static size_t ffi_sse2_2ch_32(uint8_t *dst, const uint8_t *const *src, size_t frames) {
+    size_t frame = 0;
+    for (; frame + 4 <= frames; frame += 4) {
+        __m128i l = FFI_LOAD(src[0], frame * 4);
+        __m128i r = FFI_LOAD(src[1], frame * 4);
+        FFI_STORE(dst + frame * 8, _mm_unpacklo_epi32(l, r));
+        FFI_STORE(dst + frame * 8 + 16, _mm_unpackhi_epi32(l, r));
+    }
+    return frame;
+}
+
+static size_t ffi_sse2_2ch_64(uint8_t *dst, const uint8_t *const *src, size_t frames) {
+    size_t frame = 0;
+    for (; frame + 2 <= frames; frame += 2) {
+        __m128i l = FFI_LOAD(src[0], frame * 8);
+        __m128i r = FFI_LOAD(src[1], frame * 8);
+        FFI_STORE(dst + frame * 16, _mm_unpacklo_epi64(l, r));
+        FFI_STORE(dst + frame * 16 + 16, _mm_unpackhi_epi64(l, r));
+    }
+    return frame;
+}
+
+/* 32-bit multichannel: zip channel pairs into 64-bit lanes, then stitch the
+ * pairs of one frame together with 64-bit unpacks. */
+static size_t ffi_sse2_8ch_32(uint8_t *dst, const uint8_t *const *src, size_t frames) {
+    size_t frame = 0;
+    for (; frame + 4 <= frames; frame += 4) {
+        const size_t at = frame * 4;
+        __m128i c0 = FFI_LOAD(src[0], at), c1 = FFI_LOAD(src[1], at);
+        __m128i c2 = FFI_LOAD(src[2], at), c3 = FFI_LOAD(src[3], at);
+        __m128i c4 = FFI_LOAD(src[4], at), c5 = FFI_LOAD(src[5], at);
+        __m128i c6 = FFI_LOAD(src[6], at), c7 = FFI_LOAD(src[7], at);
+        __m128i p01l = _mm_unpacklo_epi32(c0, c1), p01h = _mm_unpackhi_epi32(c0, c1);
+        __m128i p23l = _mm_unpacklo_epi32(c2, c3), p23h = _mm_unpackhi_epi32(c2, c3);
+        __m128i p45l = _mm_unpacklo_epi32(c4, c5), p45h = _mm_unpackhi_epi32(c4, c5);
+        __m128i p67l = _mm_unpacklo_epi32(c6, c7), p67h = _mm_unpackhi_epi32(c6, c7);
+        uint8_t *out = dst + frame * 32;
+        FFI_STORE(out + 0, _mm_unpacklo_epi64(p01l, p23l));
+        FFI_STORE(out + 16, _mm_unpacklo_epi64(p45l, p67l));
+        FFI_STORE(out + 32, _mm_unpackhi_epi64(p01l, p23l));
+        FFI_STORE(out + 48, _mm_unpackhi_epi64(p45l, p67l));
+        FFI_STORE(out + 64, _mm_unpacklo_epi64(p01h, p23h));
+        FFI_STORE(out + 80, _mm_unpacklo_epi64(p45h, p67h));
+        FFI_STORE(out + 96, _mm_unpackhi_epi64(p01h, p23h));
+        FFI_STORE(out + 112, _mm_unpackhi_epi64(p45h, p67h));
+    }
+    return frame;
+}
+
+static size_t ffi_sse2_6ch_32(uint8_t *dst, const uint8_t *const *src, size_t frames) {
+    size_t frame = 0;
+    for (; frame + 4 <= frames; frame += 4) {
+        const size_t at = frame * 4;
+        __m128i c0 = FFI_LOAD(src[0], at), c1 = FFI_LOAD(src[1], at);
+        __m128i c2 = FFI_LOAD(src[2], at), c3 = FFI_LOAD(src[3], at);
+        __m128i c4 = FFI_LOAD(src[4], at), c5 = FFI_LOAD(src[5], at);
+        __m128i p01l = _mm_unpacklo_epi32(c0, c1), p01h = _mm_unpackhi_epi32(c0, c1);
+        __m128i p23l = _mm_unpacklo_epi32(c2, c3), p23h = _mm_unpackhi_epi32(c2, c3);
+        __m128i p45l = _mm_unpacklo_epi32(c4, c5), p45h = _mm_unpackhi_epi32(c4, c5);
+        uint8_t *out = dst + frame * 24;
+        FFI_STORE(out + 0, _mm_unpacklo_epi64(p01l, p23l));
+        _mm_storel_epi64((__m128i *)(out + 16), p45l);
+        FFI_STORE(out + 24, _mm_unpackhi_epi64(p01l, p23l));
+        _mm_storel_epi64((__m128i *)(out + 40), _mm_unpackhi_epi64(p45l, p45l));
+        FFI_STORE(out + 48, _mm_unpacklo_epi64(p01h, p23h));
+        _mm_storel_epi64((__m128i *)(out + 64), p45h);
+        FFI_STORE(out + 72, _mm_unpackhi_epi64(p01h, p23h));
+        _mm_storel_epi64((__m128i *)(out + 88), _mm_unpackhi_epi64(p45h, p45h));
+    }
+    return frame;
+}
+
+/* 16-bit multichannel: 8x8 transpose (16 -> 32 -> 64-bit zips). Produces one
+ * vector of c0..c7 per frame; 5.1 stores the first 12 bytes of each. */
+static inline void ffi_sse2_transpose_8x16(__m128i c[8], __m128i rows[8]) {
+    __m128i q01l = _mm_unpacklo_epi16(c[0], c[1]), q01h = _mm_unpackhi_epi16(c[0], c[1]);
+    __m128i q23l = _mm_unpacklo_epi16(c[2], c[3]), q23h = _mm_unpackhi_epi16(c[2], c[3]);
+    __m128i q45l = _mm_unpacklo_epi16(c[4], c[5]), q45h = _mm_unpackhi_epi16(c[4], c[5]);
+    __m128i q67l = _mm_unpacklo_epi16(c[6], c[7]), q67h = _mm_unpackhi_epi16(c[6], c[7]);
+    __m128i r0 = _mm_unpacklo_epi32(q01l, q23l), r1 = _mm_unpackhi_epi32(q01l, q23l);
+    __m128i r2 = _mm_unpacklo_epi32(q01h, q23h), r3 = _mm_unpackhi_epi32(q01h, q23h);
+    __m128i s0 = _mm_unpacklo_epi32(q45l, q67l), s1 = _mm_unpackhi_epi32(q45l, q67l);
+    __m128i s2 = _mm_unpacklo_epi32(q45h, q67h), s3 = _mm_unpackhi_epi32(q45h, q67h);
+    rows[0] = _mm_unpacklo_epi64(r0, s0);
+    rows[1] = _mm_unpackhi_epi64(r0, s0);
+    rows[2] = _mm_unpacklo_epi64(r1, s1);
+    rows[3] = _mm_unpackhi_epi64(r1, s1);
+    rows[4] = _mm_unpacklo_epi64(r2, s2);
+    rows[5] = _mm_unpackhi_epi64(r2, s2);
+    rows[6] = _mm_unpacklo_epi64(r3, s3);
+    rows[7] = _mm_unpackhi_epi64(r3, s3);
+}
+
+static size_t ffi_sse2_8ch_16(uint8_t *dst, const uint8_t *const *src, size_t frames) {
+    size_t frame = 0;
+    for (; frame + 8 <= frames; frame += 8) {
+        __m128i c[8], rows[8];
+        for (int ch = 0; ch < 8; ++ch) {
+            c[ch] = FFI_LOAD(src[ch], frame * 2);
+        }
+        ffi_sse2_transpose_8x16(c, rows);
+        uint8_t *out = dst + frame * 16;
+        for (int i = 0; i < 8; ++i) {
+            FFI_STORE(out + i * 16, rows[i]);
+        }
+    }
+    return frame;
+}
+
+static size_t ffi_sse2_6ch_16(uint8_t *dst, const uint8_t *const *src, size_t frames) {
+    size_t frame = 0;
+    for (; frame + 8 <= frames; frame += 8) {
+        __m128i c[8], rows[8];
+        for (int ch = 0; ch < 6; ++ch) {
+            c[ch] = FFI_LOAD(src[ch], frame * 2);
+        }
+        c[6] = c[7] = _mm_setzero_si128();
+        ffi_sse2_transpose_8x16(c, rows);
+        uint8_t *out = dst + frame * 12;
+        for (int i = 0; i < 8; ++i) {
+            int32_t tail = _mm_cvtsi128_si32(_mm_srli_si128(rows[i], 8));
+            _mm_storel_epi64((__m128i *)(out + i * 12), rows[i]);
+            memcpy(out + i * 12 + 8, &tail, 4);
+        }
+    }
+    return frame;
+}
+
+#if defined(__GNUC__) || defined(__clang__)
+#define FFI_HAVE_AVX2 1
+#define FFI_AVX2 __attribute__((target("avx2")))
+#define FFI_LOAD256(p, i) _mm256_loadu_si256((const __m256i *)((p) + (i)))
+#define FFI_STORE256(p, v) _mm256_storeu_si256((__m256i *)(p), (v))
+
+/* AVX2 unpacks work per 128-bit lane; permute2x128 restores frame order. */
+#define FFI_DEFINE_AVX2_2CH(NAME, BYTES, UNPACKLO, UNPACKHI)                      \
+    FFI_AVX2 static size_t NAME(uint8_t *dst, const uint8_t *const *src,          \
+                                size_t frames) {                                  \
+        const size_t block = 32 / (BYTES);                                        \
+        size_t frame = 0;                                                         \
+        for (; frame + block <= frames; frame += block) {                         \
+            __m256i l = FFI_LOAD256(src[0], frame * (BYTES));                     \
+            __m256i r = FFI_LOAD256(src[1], frame * (BYTES));                     \
+            __m256i lo = UNPACKLO(l, r);                                          \
+            __m256i hi = UNPACKHI(l, r);                                          \
+            uint8_t *out = dst + frame * 2 * (BYTES);                             \
+            FFI_STORE256(out, _mm256_permute2x128_si256(lo, hi, 0x20));           \
+            FFI_STORE256(out + 32, _mm256_permute2x128_si256(lo, hi, 0x31));      \
+        }                                                                         \
+        return frame;                                                             \
+    }
+
+FFI_DEFINE_AVX2_2CH(ffi_avx2_2ch_16, 2, _mm256_unpacklo_epi16, _mm256_unpackhi_epi16)
+FFI_DEFINE_AVX2_2CH(ffi_avx2_2ch_32, 4, _mm256_unpacklo_epi32, _mm256_unpackhi_epi32)
+FFI_DEFINE_AVX2_2CH(ffi_avx2_2ch_64, 8, _mm256_unpacklo_epi64, _mm256_unpackhi_epi64)
+
+FFI_AVX2 static size_t ffi_avx2_8ch_32(uint8_t *dst, const uint8_t *const *src,
+                                       size_t frames) {
+    size_t frame = 0;
+    for (; frame + 8 <= frames; frame += 8) {
+        const size_t at = frame * 4;
+        __m256i c0 = FFI_LOAD256(src[0], at), c1 = FFI_LOAD256(src[1], at);
+        __m256i c2 = FFI_LOAD256(src[2], at), c3 = FFI_LOAD256(src[3], at);
+        __m256i c4 = FFI_LOAD256(src[4], at), c5 = FFI_LOAD256(src[5], at);
+        __m256i c6 = FFI_LOAD256(src[6], at), c7 = FFI_LOAD256(src[7], at);
+        __m256i p01l = _mm256_unpacklo_epi32(c0, c1), p01h = _mm256_unpackhi_epi32(c0, c1);
+        __m256i p23l = _mm256_unpacklo_epi32(c2, c3), p23h = _mm256_unpackhi_epi32(c2, c3);
+        __m256i p45l = _mm256_unpacklo_epi32(c4, c5), p45h = _mm256_unpackhi_epi32(c4, c5);
+        __m256i p67l = _mm256_unpacklo_epi32(c6, c7), p67h = _mm256_unpackhi_epi32(c6, c7);
+        /* Lane 0 holds frames 0-3, lane 1 frames 4-7. */
+        __m256i a0 = _mm256_unpacklo_epi64(p01l, p23l), b0 = _mm256_unpacklo_epi64(p45l, p67l);
+        __m256i a1 = _mm256_unpackhi_epi64(p01l, p23l), b1 = _mm256_unpackhi_epi64(p45l, p67l);
+        __m256i a2 = _mm256_unpacklo_epi64(p01h, p23h), b2 = _mm256_unpacklo_epi64(p45h, p67h);
+        __m256i a3 = _mm256_unpackhi_epi64(p01h, p23h), b3 = _mm256_unpackhi_epi64(p45h, p67h);
+        uint8_t *out = dst + frame * 32;
+        FFI_STORE256(out + 0, _mm256_permute2x128_si256(a0, b0, 0x20));
+        FFI_STORE256(out + 32, _mm256_permute2x128_si256(a1, b1, 0x20));
+        FFI_STORE256(out + 64, _mm256_permute2x128_si256(a2, b2, 0x20));
+        FFI_STORE256(out + 96, _mm256_permute2x128_si256(a3, b3, 0x20));
+        FFI_STORE256(out + 128, _mm256_permute2x128_si256(a0, b0, 0x31));
+        FFI_STORE256(out + 160, _mm256_permute2x128_si256(a1, b1, 0x31));
+        FFI_STORE256(out + 192, _mm256_permute2x128_si256(a2, b2, 0x31));
+        FFI_STORE256(out + 224, _mm256_permute2x128_si256(a3, b3, 0x31));
+    }
+    return frame;
+}
+#endif /* __GNUC__ || __clang__ */
+
+#endif /* FFI_HAVE_X86 */
+
+/* ---- NEON ------------------------------------------------------------------ */
+
+#if FFI_HAVE_NEON
+
+static size_t ffi_neon_2ch_16(uint8_t *dst, const uint8_t *const *src, size_t frames) {
+    size_t frame = 0;
+    for (; frame + 8 <= frames; frame += 8) {
+        uint16x8x2_t v = {{vld1q_u16((const uint16_t *)src[0] + frame),
+                           vld1q_u16((const uint16_t *)src[1] + frame)}};
+        vst2q_u16((uint16_t *)dst + frame * 2, v);
+    }
+    return frame;
+}
+
+static size_t ffi_neon_2ch_32(uint8_t *dst, const uint8_t *const *src, size_t frames) {
+    size_t frame = 0;
+    for (; frame + 4 <= frames; frame += 4) {
+        uint32x4x2_t v = {{vld1q_u32((const uint32_t *)src[0] + frame),
+                           vld1q_u32((const uint32_t *)src[1] + frame)}};
+        vst2q_u32((uint32_t *)dst + frame * 2, v);
+    }
+    return frame;
+}
+
+static size_t ffi_neon_2ch_64(uint8_t *dst, const uint8_t *const *src, size_t frames) {
+    size_t frame = 0;
+    for (; frame + 2 <= frames; frame += 2) {
+        uint64x2x2_t v = {{vld1q_u64((const uint64_t *)src[0] + frame),
+                           vld1q_u64((const uint64_t *)src[1] + frame)}};
+        vst2q_u64((uint64_t *)dst + frame * 2, v);
+    }
+    return frame;
+}
+
+/* Multichannel: zip channel pairs into double-width lanes, then let the
+ * structured vst3/vst4 store interleave the pairs. */
+static size_t ffi_neon_8ch_32(uint8_t *dst, const uint8_t *const *src, size_t frames) {
+    size_t frame = 0;
+    for (; frame + 4 <= frames; frame += 4) {
+        uint32x4_t c[8];
+        for (int ch = 0; ch < 8; ++ch) {
+            c[ch] = vld1q_u32((const uint32_t *)src[ch] + frame);
+        }
+        uint64x2x4_t lo = {{vreinterpretq_u64_u32(vzip1q_u32(c[0], c[1])),
+                            vreinterpretq_u64_u32(vzip1q_u32(c[2], c[3])),
+                            vreinterpretq_u64_u32(vzip1q_u32(c[4], c[5])),
+                            vreinterpretq_u64_u32(vzip1q_u32(c[6], c[7]))}};
+        uint64x2x4_t hi = {{vreinterpretq_u64_u32(vzip2q_u32(c[0], c[1])),
+                            vreinterpretq_u64_u32(vzip2q_u32(c[2], c[3])),
+                            vreinterpretq_u64_u32(vzip2q_u32(c[4], c[5])),
+                            vreinterpretq_u64_u32(vzip2q_u32(c[6], c[7]))}};
+        vst4q_u64((uint64_t *)(dst + frame * 32), lo);
+        vst4q_u64((uint64_t *)(dst + frame * 32 + 64), hi);
+    }
+    return frame;
+}
+
+static size_t ffi_neon_6ch_32(uint8_t *dst, const uint8_t *const *src, size_t frames) {
+    size_t frame = 0;
+    for (; frame + 4 <= frames; frame += 4) {
+        uint32x4_t c[6];
+        for (int ch = 0; ch < 6; ++ch) {
+            c[ch] = vld1q_u32((const uint32_t *)src[ch] + frame);
+        }
+        uint64x2x3_t lo = {{vreinterpretq_u64_u32(vzip1q_u32(c[0], c[1])),
+                            vreinterpretq_u64_u32(vzip1q_u32(c[2], c[3])),
+                            vreinterpretq_u64_u32(vzip1q_u32(c[4], c[5]))}};
+        uint64x2x3_t hi = {{vreinterpretq_u64_u32(vzip2q_u32(c[0], c[1])),
+                            vreinterpretq_u64_u32(vzip2q_u32(c[2], c[3])),
+                            vreinterpretq_u64_u32(vzip2q_u32(c[4], c[5]))}};
+        vst3q_u64((uint64_t *)(dst + frame * 24), lo);
+        vst3q_u64((uint64_t *)(dst + frame * 24 + 48), hi);
+    }
+    return frame;
+}
+
+static size_t ffi_neon_8ch_16(uint8_t *dst, const uint8_t *const *src, size_t frames) {
+    size_t frame = 0;
+    for (; frame + 8 <= frames; frame += 8) {
+        uint16x8_t c[8];
+        for (int ch = 0; ch < 8; ++ch) {
+            c[ch] = vld1q_u16((const uint16_t *)src[ch] + frame);
+        }
+        uint32x4x4_t lo = {{vreinterpretq_u32_u16(vzip1q_u16(c[0], c[1])),
+                            vreinterpretq_u32_u16(vzip1q_u16(c[2], c[3])),
+                            vreinterpretq_u32_u16(vzip1q_u16(c[4], c[5])),
+                            vreinterpretq_u32_u16(vzip1q_u16(c[6], c[7]))}};
+        uint32x4x4_t hi = {{vreinterpretq_u32_u16(vzip2q_u16(c[0], c[1])),
+                            vreinterpretq_u32_u16(vzip2q_u16(c[2], c[3])),
+                            vreinterpretq_u32_u16(vzip2q_u16(c[4], c[5])),
+                            vreinterpretq_u32_u16(vzip2q_u16(c[6], c[7]))}};
+        vst4q_u32((uint32_t *)(dst + frame * 16), lo);
+        vst4q_u32((uint32_t *)(dst + frame * 16 + 64), hi);
+    }
+    return frame;
+}
+
+static size_t ffi_neon_6ch_16(uint8_t *dst, const uint8_t *const *src, size_t frames) {
+    size_t frame = 0;
+    for (; frame + 8 <= frames; frame += 8) {
+        uint16x8_t c[6];
+        for (int ch = 0; ch < 6; ++ch) {
+            c[ch] = vld1q_u16((const uint16_t *)src[ch] + frame);
+        }
+        uint32x4x3_t lo = {{vreinterpretq_u32_u16(vzip1q_u16(c[0], c[1])),
+                            vreinterpretq_u32_u16(vzip1q_u16(c[2], c[3])),
+                            vreinterpretq_u32_u16(vzip1q_u16(c[4], c[5]))}};
+        uint32x4x3_t hi = {{vreinterpretq_u32_u16(vzip2q_u16(c[0], c[1])),
+                            vreinterpretq_u32_u16(vzip2q_u16(c[2], c[3])),
+                            vreinterpretq_u32_u16(vzip2q_u16(c[4], c[5]))}};
+        vst3q_u32((uint32_t *)(dst + frame * 12), lo);
+        vst3q_u32((uint32_t *)(dst + frame * 12 + 48), hi);
+    }
+    return frame;
+}
+
+#endif /* FFI_HAVE_NEON */
+
+/* ---- Dispatch -------------------------------------------------------------- */
+
+static FFInterleaveISA gActiveIsa = FFDEC_INTERLEAVE_ISA_SCALAR;
+static pthread_once_t gIsaOnce = PTHREAD_ONCE_INIT;
+
+static int ffi_isa_supported(FFInterleaveISA isa) {
+    switch (isa) {
+        case FFDEC_INTERLEAVE_ISA_SCALAR:
+            return 1;
+#if FFI_HAVE_X86
+        case FFDEC_INTERLEAVE_ISA_SSE2:
+#if defined(__x86_64__) || defined(__SSE2__)
+            return 1;
+#else
+            return __builtin_cpu_supports("sse2");
+#endif
+#if FFI_HAVE_AVX2
+        case FFDEC_INTERLEAVE_ISA_AVX2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2");
+#endif
+#endif
+#if FFI_HAVE_NEON
+        case FFDEC_INTERLEAVE_ISA_NEON:
+            return 1;
+#endif
+        default:
+            return 0;
+    }
+}
+
+static void ffi_detect_isa(void) {
+    static const FFInterleaveISA preference[] = {
+        FFDEC_INTERLEAVE_ISA_AVX2,
+        FFDEC_INTERLEAVE_ISA_NEON,
+        FFDEC_INTERLEAVE_ISA_SSE2,
+    };
+    for (size_t i = 0; i < sizeof(preference) / sizeof(preference[0]); ++i) {
+        if (ffi_isa_supported(preference[i])) {
+            gActiveIsa = preference[i];
+            return;
+        }
+    }
+    gActiveIsa = FFDEC_INTERLEAVE_ISA_SCALAR;
+}
+
+FFInterleaveISA ffdecoder_interleave_isa(void) {
+    pthread_once(&gIsaOnce, ffi_detect_isa);
+    return gActiveIsa;
+}
+
+int ffdecoder_interleave_set_isa(FFInterleaveISA isa) {
+    pthread_once(&gIsaOnce, ffi_detect_isa);
+    if (!ffi_isa_supported(isa)) {
+        return -1;
+    }
+    gActiveIsa = isa;
+    return 0;
+}
+
+static ffi_kernel ffi_select_kernel(FFInterleaveISA isa, size_t bytesPerSample, int channels) {
+    switch (isa) {
+#if FFI_HAVE_X86
+#if FFI_HAVE_AVX2
+        case FFDEC_INTERLEAVE_ISA_AVX2:
+            if (channels == 2 && bytesPerSample == 2) return ffi_avx2_2ch_16;
+            if (channels == 2 && bytesPerSample == 4) return ffi_avx2_2ch_32;
+            if (channels == 2 && bytesPerSample == 8) return ffi_avx2_2ch_64;
+            if (channels == 8 && bytesPerSample == 4) return ffi_avx2_8ch_32;
+            /* Remaining layouts gain nothing from 256-bit registers. */
+            return ffi_select_kernel(FFDEC_INTERLEAVE_ISA_SSE2, bytesPerSample, channels);
+#endif
+        case FFDEC_INTERLEAVE_ISA_SSE2:
+            if (channels == 2 && bytesPerSample == 2) return ffi_sse2_2ch_16;
+            if (channels == 2 && bytesPerSample == 4) return ffi_sse2_2ch_32;
+            if (channels == 2 && bytesPerSample == 8) return ffi_sse2_2ch_64;
+            if (channels == 6 && bytesPerSample == 2) return ffi_sse2_6ch_16;
+            if (channels == 6 && bytesPerSample == 4) return ffi_sse2_6ch_32;
+            if (channels == 8 && bytesPerSample == 2) return ffi_sse2_8ch_16;
+            if (channels == 8 && bytesPerSample == 4) return ffi_sse2_8ch_32;
+            return NULL;
+#endif
+#if FFI_HAVE_NEON
+        case FFDEC_INTERLEAVE_ISA_NEON:
+            if (channels == 2 && bytesPerSample == 2) return ffi_neon_2ch_16;
+            if (channels == 2 && bytesPerSample == 4) return ffi_neon_2ch_32;
+            if (channels == 2 && bytesPerSample == 8) return ffi_neon_2ch_64;
+            if (channels == 6 && bytesPerSample == 2) return ffi_neon_6ch_16;
+            if (channels == 6 && bytesPerSample == 4) return ffi_neon_6ch_32;
+            if (channels == 8 && bytesPerSample == 2) return ffi_neon_8ch_16;
+            if (channels == 8 && bytesPerSample == 4) return ffi_neon_8ch_32;
+            return NULL;
+#endif
+        default:
+            return NULL;
+    }
+}
+
+void ffdecoder_interleave(uint8_t *dst, const uint8_t *const *planes,
+                          size_t srcFrameOffset, size_t frames,
+                          int channels, size_t bytesPerSample) {
+    if (!dst || !planes || frames == 0 || channels <= 0 || bytesPerSample == 0) {
+        return;
+    }
+    if (channels == 1) {
+        memcpy(dst, planes[0] + srcFrameOffset * bytesPerSample, frames * bytesPerSample);
+        return;
+    }
+    size_t done = 0;
+    if (channels <= FFI_MAX_KERNEL_CHANNELS) {
+        ffi_kernel kernel =
+            ffi_select_kernel(ffdecoder_interleave_isa(), bytesPerSample, channels);
+        if (kernel) {
+            const uint8_t *src[FFI_MAX_KERNEL_CHANNELS];
+            for (int ch = 0; ch < channels; ++ch) {
+                src[ch] = planes[ch] + srcFrameOffset * bytesPerSample;
+            }
+            done = kernel(dst, src, frames);
+        }
+    }
+    if (done < frames) {
+        ffi_generic(dst, planes, srcFrameOffset, done, frames, channels, bytesPerSample);
+    }
+}
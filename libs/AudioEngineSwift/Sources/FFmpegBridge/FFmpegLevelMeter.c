@@ -0,0 +1,435 @@
+#include "FFmpegLevelMeter.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define FFM_HAVE_X86 1
+#include <emmintrin.h>
+#endif
+
+#if defined(__aarch64__)
+#define FFM_HAVE_NEON 1
+#include <arm_neon.h>
+#endif
+
+#define FFM_LANES FFMETER_MAX_CHANNELS
+/* Frames converted and reduced per pass; also the ballistics step. */
+#define FFM_CHUNK_FRAMES 256
+/* Levels under -120 dB snap to silence, so the decay ends and does not run
+ * on denormals. */
+#define FFM_SILENCE 1e-6f
+#define FFM_LN10 2.302585092994046
+#define FFM_PI 3.14159265358979323846
+
+/* True-peak interpolator, as AudioEngineCore's TruePeakDetector. */
+#define FFM_TAPS 12
+#define FFM_OVERSAMPLE 4
+#define FFM_LATENCY_FRAMES 6
+#define FFM_CENTRE (FFM_TAPS - 1 - FFM_LATENCY_FRAMES)
+
+/* Linear levels as published; fflevelmeter_read() converts to dB. */
+typedef struct {
+    uint64_t sequence;
+    uint32_t channels;
+    float peak[FFM_LANES];
+    float hold[FFM_LANES];
+    float mean_square[FFM_LANES];
+    float true_peak[FFM_LANES];
+    float max_true_peak[FFM_LANES];
+} FFMLevels;
+
+#define FFM_WORDS ((sizeof(FFMLevels) + 7) / 8)
+
+struct FFLevelMeter {
+    /* Written by fflevelmeter_set_options() on any thread. */
+    double hold_ms;
+    double decay_db_per_second;
+    double rms_window_ms;
+    int true_peak;
+
+    FFSampleType type;
+    uint32_t sample_rate;
+    uint32_t channels;
+
+    /* Render side. */
+    float scratch[FFM_CHUNK_FRAMES * FFM_LANES];
+    float coeffs[FFM_OVERSAMPLE - 1][FFM_TAPS];
+    /* Each sample is stored twice, FFM_TAPS apart, so the last FFM_TAPS
+     * samples are always contiguous. */
+    float history[FFM_LANES][2 * FFM_TAPS];
+    uint32_t history_pos;
+    int detector_primed;
+    FFMLevels levels;
+    double hold_age[FFM_LANES];
+
+    /* Sequence lock: odd while a store is in progress. */
+    uint32_t published_sequence;
+    uint64_t published[FFM_WORDS];
+};
+
+/* Reduces `frames` interleaved frames to per-channel peak and sum of
+ * squares. `peaks` and `sums` hold FFM_LANES values. */
+typedef void (*ffm_kernel)(const float *samples, size_t frames, uint32_t channels, float *peaks,
+                           float *sums);
+
+/* ---- Scalar ---------------------------------------------------------------- */
+
+static void ffm_scalar(const float *samples, size_t frames, uint32_t channels, float *peaks,
+                       float *sums) {
+    for (size_t f = 0; f < frames; ++f, samples += channels) {
+        for (uint32_t ch = 0; ch < channels; ++ch) {
+            const float v = samples[ch];
+            const float a = fabsf(v);
+            peaks[ch] = a > peaks[ch] ? a : peaks[ch];
+            sums[ch] += v * v;
+        }
+    }
+}
+
+/* ---- SSE2 (also used for AVX2) ------------------------------------------- */
+
+#if FFM_HAVE_X86
+
+static inline __m128 ffm_load4(const float *p, uint32_t n) {
+    switch (n) {
+        case 4: return _mm_loadu_ps(p);
+        case 2: return _mm_loadl_pi(_mm_setzero_ps(), (const __m64 *)p);
+        case 1: return _mm_load_ss(p);
+        default: return _mm_setr_ps(p[0], p[1], p[2], 0.0f);
+    }
+}
+
+/* Channels sit in the lanes, as in the requantizer; each group of four runs
+ * through the block with its accumulators in registers. */
+static void ffm_sse2(const float *samples, size_t frames, uint32_t channels, float *peaks,
+                     float *sums) {
+    const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    for (uint32_t group = 0; group < channels; group += 4) {
+        const uint32_t n = channels - group < 4 ? channels - group : 4;
+        __m128 peak = _mm_loadu_ps(peaks + group);
+        __m128 sum = _mm_loadu_ps(sums + group);
+        const float *p = samples + group;
+        for (size_t f = 0; f < frames; ++f, p += channels) {
+            const __m128 x = ffm_load4(p, n);
+            peak = _mm_max_ps(peak, _mm_and_ps(x, abs_mask));
+            sum = _mm_add_ps(sum, _mm_mul_ps(x, x));
+        }
+        _mm_storeu_ps(peaks + group, peak);
+        _mm_storeu_ps(sums + group, sum);
+    }
+}
+
+#endif /* FFM_HAVE_X86 */
+
+/* ---- NEON ------------------------------------------------------------------ */
+
+#if FFM_HAVE_NEON
+
+static void ffm_neon(const float *samples, size_t frames, uint32_t channels, float *peaks,
+                     float *sums) {
+    for (uint32_t group = 0; group < channels; group += 4) {
+        const uint32_t n = channels - group < 4 ? channels - group : 4;
+        float32x4_t peak = vld1q_f32(peaks + group);
+        float32x4_t sum = vld1q_f32(sums + group);
+        const float *p = samples + group;
+        for (size_t f = 0; f < frames; ++f, p += channels) {
+            float32x4_t x;
+            if (n == 4) {
+                x = vld1q_f32(p);
+            } else {
+                const float padded[4] = {p[0], n > 1 ? p[1] : 0.0f, n > 2 ? p[2] : 0.0f, 0.0f};
+                x = vld1q_f32(padded);
+            }
+            peak = vmaxq_f32(peak, vabsq_f32(x));
+            sum = vfmaq_f32(sum, x, x);
+        }
+        vst1q_f32(peaks + group, peak);
+        vst1q_f32(sums + group, sum);
+    }
+}
+
+#endif /* FFM_HAVE_NEON */
+
+static ffm_kernel ffm_select_kernel(FFInterleaveISA isa) {
+    switch (isa) {
+#if FFM_HAVE_X86
+        case FFDEC_INTERLEAVE_ISA_AVX2:
+        case FFDEC_INTERLEAVE_ISA_SSE2:
+            return ffm_sse2;
+#endif
+#if FFM_HAVE_NEON
+        case FFDEC_INTERLEAVE_ISA_NEON:
+            return ffm_neon;
+#endif
+        default:
+            return ffm_scalar;
+    }
+}
+
+/* ---- True peak ------------------------------------------------------------- */
+
+/* Hann-windowed sinc for the sub-sample offset `phase / FFM_OVERSAMPLE`,
+ * each phase normalized to unity DC gain. */
+static void ffm_design_interpolator(float coeffs[FFM_OVERSAMPLE - 1][FFM_TAPS]) {
+    const double half_width = FFM_TAPS / 2.0 + 0.5;
+    for (uint32_t phase = 1; phase < FFM_OVERSAMPLE; ++phase) {
+        double taps[FFM_TAPS];
+        double sum = 0.0;
+        for (uint32_t k = 0; k < FFM_TAPS; ++k) {
+            const double t = (double)k - FFM_CENTRE - (double)phase / FFM_OVERSAMPLE;
+            const double sinc = sin(FFM_PI * t) / (FFM_PI * t);
+            const double window = 0.5 + 0.5 * cos(FFM_PI * t / half_width);
+            taps[k] = sinc * window;
+            sum += taps[k];
+        }
+        for (uint32_t k = 0; k < FFM_TAPS; ++k) coeffs[phase - 1][k] = (float)(taps[k] / sum);
+    }
+}
+
+/* Pushes one frame and raises peaks[ch] to the largest absolute value of
+ * the frame FFM_LATENCY_FRAMES back and the points interpolated after it. */
+static void ffm_true_peak(FFLevelMeter *m, const float *frame, float *peaks) {
+    for (uint32_t ch = 0; ch < m->channels; ++ch) {
+        float *h = m->history[ch];
+        h[m->history_pos] = frame[ch];
+        h[m->history_pos + FFM_TAPS] = frame[ch];
+        const float *window = h + m->history_pos + 1;
+        float peak = fabsf(window[FFM_CENTRE]);
+        for (uint32_t phase = 0; phase < FFM_OVERSAMPLE - 1; ++phase) {
+            float acc = 0.0f;
+            for (uint32_t k = 0; k < FFM_TAPS; ++k) acc += m->coeffs[phase][k] * window[k];
+            peak = fmaxf(peak, fabsf(acc));
+        }
+        peaks[ch] = fmaxf(peaks[ch], peak);
+    }
+    m->history_pos = m->history_pos + 1 == FFM_TAPS ? 0 : m->history_pos + 1;
+}
+
+/* ---- Conversion ------------------------------------------------------------ */
+
+static size_t ffm_bytes(FFSampleType type) {
+    switch (type) {
+        case FFDEC_SAMPLE_S16: return 2;
+        case FFDEC_SAMPLE_S24: return 3;
+        case FFDEC_SAMPLE_S32:
+        case FFDEC_SAMPLE_F32: return 4;
+        case FFDEC_SAMPLE_F64: return 8;
+    }
+    return 0;
+}
+
+/* Anything but float to float, full scale 1.0. */
+static void ffm_to_float(FFSampleType type, const void *src, float *dst, size_t count) {
+    switch (type) {
+        case FFDEC_SAMPLE_S16: {
+            const int16_t *s = (const int16_t *)src;
+            for (size_t i = 0; i < count; ++i) dst[i] = s[i] * (1.0f / 32768.0f);
+            return;
+        }
+        case FFDEC_SAMPLE_S24: {
+            const uint8_t *s = (const uint8_t *)src;
+            for (size_t i = 0; i < count; ++i, s += 3) {
+                const int32_t value = (int32_t)(((uint32_t)s[0] << 8) | ((uint32_t)s[1] << 16) |
+                                                ((uint32_t)s[2] << 24)) >> 8;
+                dst[i] = value * (1.0f / 8388608.0f);
+            }
+            return;
+        }
+        case FFDEC_SAMPLE_S32: {
+            const int32_t *s = (const int32_t *)src;
+            for (size_t i = 0; i < count; ++i) dst[i] = (float)(s[i] * (1.0 / 2147483648.0));
+            return;
+        }
+        case FFDEC_SAMPLE_F64: {
+            const double *s = (const double *)src;
+            for (size_t i = 0; i < count; ++i) dst[i] = (float)s[i];
+            return;
+        }
+        default:
+            return;
+    }
+}
+
+/* ---- Publishing ------------------------------------------------------------ */
+
+static void ffm_publish(FFLevelMeter *m) {
+    uint64_t words[FFM_WORDS] = {0};
+    memcpy(words, &m->levels, sizeof(FFMLevels));
+    const uint32_t sequence = __atomic_load_n(&m->published_sequence, __ATOMIC_RELAXED);
+    __atomic_store_n(&m->published_sequence, sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    for (size_t i = 0; i < FFM_WORDS; ++i) {
+        __atomic_store_n(&m->published[i], words[i], __ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&m->published_sequence, sequence + 2, __ATOMIC_RELEASE);
+}
+
+static float ffm_power_db(float power) {
+    if (power <= FFM_SILENCE * FFM_SILENCE) return FFMETER_FLOOR_DB;
+    const float db = 10.0f * log10f(power);
+    return db > FFMETER_FLOOR_DB ? db : FFMETER_FLOOR_DB;
+}
+
+static float ffm_amplitude_db(float amplitude) { return ffm_power_db(amplitude * amplitude); }
+
+/* ---- Ballistics ------------------------------------------------------------ */
+
+/* Applies one chunk's measurements over `seconds`. */
+static void ffm_update(FFLevelMeter *m, const float *chunk_peak, const float *chunk_sums,
+                       const float *chunk_true_peak, size_t frames, double seconds,
+                       double hold_ms, double decay_db_per_second, double rms_window_ms) {
+    const float decay = (float)exp(-decay_db_per_second * FFM_LN10 / 20.0 * seconds);
+    const float keep = (float)exp(-seconds * 1000.0 / rms_window_ms);
+    const double hold_seconds = hold_ms / 1000.0;
+    FFMLevels *l = &m->levels;
+    for (uint32_t ch = 0; ch < m->channels; ++ch) {
+        l->peak[ch] = fmaxf(chunk_peak[ch], l->peak[ch] * decay);
+        if (chunk_peak[ch] >= l->hold[ch]) {
+            l->hold[ch] = chunk_peak[ch];
+            m->hold_age[ch] = 0.0;
+        } else {
+            m->hold_age[ch] += seconds;
+            if (m->hold_age[ch] > hold_seconds) {
+                l->hold[ch] = fmaxf(l->hold[ch] * decay, l->peak[ch]);
+            }
+        }
+
+        const float mean_square = chunk_sums[ch] / (float)frames;
+        l->mean_square[ch] = mean_square + keep * (l->mean_square[ch] - mean_square);
+
+        l->true_peak[ch] = fmaxf(chunk_true_peak[ch], l->true_peak[ch] * decay);
+        l->max_true_peak[ch] = fmaxf(l->max_true_peak[ch], chunk_true_peak[ch]);
+
+        if (l->peak[ch] < FFM_SILENCE) l->peak[ch] = 0.0f;
+        if (l->hold[ch] < FFM_SILENCE) l->hold[ch] = 0.0f;
+        if (l->mean_square[ch] < FFM_SILENCE * FFM_SILENCE) l->mean_square[ch] = 0.0f;
+        if (l->true_peak[ch] < FFM_SILENCE) l->true_peak[ch] = 0.0f;
+    }
+}
+
+/* ---- API ------------------------------------------------------------------- */
+
+FFLevelMeter *fflevelmeter_create(void) {
+    FFLevelMeter *m = (FFLevelMeter *)calloc(1, sizeof(FFLevelMeter));
+    if (!m) return NULL;
+    m->hold_ms = 1500.0;
+    m->decay_db_per_second = 20.0;
+    m->rms_window_ms = 300.0;
+    m->true_peak = 1;
+    ffm_design_interpolator(m->coeffs);
+    fflevelmeter_reset(m);
+    return m;
+}
+
+void fflevelmeter_free(FFLevelMeter *meter) { free(meter); }
+
+int fflevelmeter_configure(FFLevelMeter *meter, FFSampleType type, uint32_t sample_rate,
+                           uint32_t channels) {
+    if (!meter) return -1;
+    meter->levels.sequence = 0;
+    if (sample_rate == 0 || channels == 0 || channels > FFM_LANES) {
+        meter->channels = 0;
+        fflevelmeter_reset(meter);
+        return -1;
+    }
+    meter->type = type;
+    meter->sample_rate = sample_rate;
+    meter->channels = channels;
+    fflevelmeter_reset(meter);
+    return 0;
+}
+
+void fflevelmeter_set_options(FFLevelMeter *meter, const FFLevelMeterOptions *options) {
+    if (!meter || !options) return;
+    const double hold_ms = options->hold_ms > 0.0 ? options->hold_ms : 0.0;
+    const double decay = options->decay_db_per_second > 0.0 ? options->decay_db_per_second : 0.0;
+    const double window = options->rms_window_ms > 1.0 ? options->rms_window_ms : 1.0;
+    __atomic_store(&meter->hold_ms, &hold_ms, __ATOMIC_RELAXED);
+    __atomic_store(&meter->decay_db_per_second, &decay, __ATOMIC_RELAXED);
+    __atomic_store(&meter->rms_window_ms, &window, __ATOMIC_RELAXED);
+    __atomic_store_n(&meter->true_peak, options->true_peak != 0, __ATOMIC_RELAXED);
+}
+
+void fflevelmeter_process(FFLevelMeter *meter, const void *samples, size_t frames) {
+    if (!meter || !samples || meter->channels == 0 || frames == 0) return;
+    double hold_ms, decay, window;
+    __atomic_load(&meter->hold_ms, &hold_ms, __ATOMIC_RELAXED);
+    __atomic_load(&meter->decay_db_per_second, &decay, __ATOMIC_RELAXED);
+    __atomic_load(&meter->rms_window_ms, &window, __ATOMIC_RELAXED);
+    const int true_peak = __atomic_load_n(&meter->true_peak, __ATOMIC_RELAXED);
+    if (!true_peak) {
+        meter->detector_primed = 0;
+    } else if (!meter->detector_primed) {
+        /* Stale history would smear the last block before true peak went
+         * off into the first one after. */
+        memset(meter->history, 0, sizeof(meter->history));
+        meter->history_pos = 0;
+        meter->detector_primed = 1;
+    }
+
+    const uint32_t channels = meter->channels;
+    const ffm_kernel kernel = ffm_select_kernel(ffdecoder_sample_kernels_isa());
+    const size_t bytes_per_frame = ffm_bytes(meter->type) * channels;
+    const uint8_t *in = (const uint8_t *)samples;
+    while (frames > 0) {
+        const size_t n = frames < FFM_CHUNK_FRAMES ? frames : FFM_CHUNK_FRAMES;
+        const float *chunk = (const float *)in;
+        if (meter->type != FFDEC_SAMPLE_F32) {
+            ffm_to_float(meter->type, in, meter->scratch, n * channels);
+            chunk = meter->scratch;
+        }
+        float peaks[FFM_LANES] = {0};
+        float sums[FFM_LANES] = {0};
+        kernel(chunk, n, channels, peaks, sums);
+        float true_peaks[FFM_LANES] = {0};
+        if (true_peak) {
+            for (size_t f = 0; f < n; ++f) ffm_true_peak(meter, chunk + f * channels, true_peaks);
+        }
+        ffm_update(meter, peaks, sums, true_peaks, n, (double)n / meter->sample_rate, hold_ms,
+                   decay, window);
+        in += n * bytes_per_frame;
+        frames -= n;
+    }
+    ++meter->levels.sequence;
+    ffm_publish(meter);
+}
+
+void fflevelmeter_reset(FFLevelMeter *meter) {
+    if (!meter) return;
+    const uint64_t sequence = meter->levels.sequence;
+    memset(&meter->levels, 0, sizeof(meter->levels));
+    meter->levels.sequence = sequence;
+    meter->levels.channels = meter->channels;
+    memset(meter->hold_age, 0, sizeof(meter->hold_age));
+    meter->detector_primed = 0;
+    ffm_publish(meter);
+}
+
+void fflevelmeter_read(const FFLevelMeter *meter, FFLevelReading *reading) {
+    if (!reading) return;
+    memset(reading, 0, sizeof(*reading));
+    if (!meter) return;
+    uint64_t words[FFM_WORDS];
+    for (;;) {
+        const uint32_t before = __atomic_load_n(&meter->published_sequence, __ATOMIC_ACQUIRE);
+        if (before & 1) continue;
+        for (size_t i = 0; i < FFM_WORDS; ++i) {
+            words[i] = __atomic_load_n(&meter->published[i], __ATOMIC_RELAXED);
+        }
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&meter->published_sequence, __ATOMIC_RELAXED) == before) break;
+    }
+    FFMLevels levels;
+    memcpy(&levels, words, sizeof(levels));
+    reading->sequence = levels.sequence;
+    reading->channels = levels.channels;
+    for (uint32_t ch = 0; ch < FFM_LANES; ++ch) {
+        reading->peak_db[ch] = ffm_amplitude_db(levels.peak[ch]);
+        reading->peak_hold_db[ch] = ffm_amplitude_db(levels.hold[ch]);
+        reading->rms_db[ch] = ffm_power_db(levels.mean_square[ch]);
+        reading->true_peak_db[ch] = ffm_amplitude_db(levels.true_peak[ch]);
+        reading->max_true_peak_db[ch] = ffm_amplitude_db(levels.max_true_peak[ch]);
+    }
+}
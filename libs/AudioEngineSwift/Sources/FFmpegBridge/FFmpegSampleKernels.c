@@ -0,0 +1,374 @@
+#include "FFmpegSampleKernels.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define FFK_HAVE_X86 1
+#include <emmintrin.h>
+#include <immintrin.h>
+#endif
+
+#if defined(__aarch64__)
+#define FFK_HAVE_NEON 1
+#include <arm_neon.h>
+#endif
+
+/* Vector kernels scale whole blocks and return how many samples they did;
+ * the scalar loop finishes the tail. */
+typedef size_t (*ffk_kernel)(void *samples, size_t count, double gain);
+
+/* ---- Scalar ---------------------------------------------------------------- */
+
+static inline double ffk_clamp(double x, double lo, double hi) {
+    return x < lo ? lo : (x > hi ? hi : x);
+}
+
+static void ffk_scalar_s16(int16_t *s, size_t count, double gain) {
+    for (size_t i = 0; i < count; ++i) {
+        s[i] = (int16_t)ffk_clamp(nearbyint(s[i] * gain), -32768.0, 32767.0);
+    }
+}
+
+static void ffk_scalar_s24(uint8_t *s, size_t count, double gain) {
+    for (size_t i = 0; i < count; ++i, s += 3) {
+        const int32_t value =
+            (int32_t)(((uint32_t)s[0] << 8) | ((uint32_t)s[1] << 16) | ((uint32_t)s[2] << 24)) >> 8;
+        const int32_t scaled =
+            (int32_t)ffk_clamp(nearbyint(value * gain), -8388608.0, 8388607.0);
+        s[0] = (uint8_t)scaled;
+        s[1] = (uint8_t)(scaled >> 8);
+        s[2] = (uint8_t)(scaled >> 16);
+    }
+}
+
+static void ffk_scalar_s32(int32_t *s, size_t count, double gain) {
+    for (size_t i = 0; i < count; ++i) {
+        s[i] = (int32_t)ffk_clamp(nearbyint(s[i] * gain), -2147483648.0, 2147483647.0);
+    }
+}
+
+static void ffk_scalar_f32(float *s, size_t count, double gain) {
+    const float g = (float)gain;
+    for (size_t i = 0; i < count; ++i) s[i] *= g;
+}
+
+static void ffk_scalar_f64(double *s, size_t count, double gain) {
+    for (size_t i = 0; i < count; ++i) s[i] *= gain;
+}
+
+static size_t ffk_bytes(FFSampleType type) {
+    switch (type) {
+        case FFDEC_SAMPLE_S16: return 2;
+        case FFDEC_SAMPLE_S24: return 3;
+        case FFDEC_SAMPLE_S32:
+        case FFDEC_SAMPLE_F32: return 4;
+        case FFDEC_SAMPLE_F64: return 8;
+    }
+    return 0;
+}
+
+void ffdecoder_scale_samples_scalar(FFSampleType type, void *samples, size_t count,
+                                    double gain) {
+    switch (type) {
+        case FFDEC_SAMPLE_S16: ffk_scalar_s16((int16_t *)samples, count, gain); return;
+        case FFDEC_SAMPLE_S24: ffk_scalar_s24((uint8_t *)samples, count, gain); return;
+        case FFDEC_SAMPLE_S32: ffk_scalar_s32((int32_t *)samples, count, gain); return;
+        case FFDEC_SAMPLE_F32: ffk_scalar_f32((float *)samples, count, gain); return;
+        case FFDEC_SAMPLE_F64: ffk_scalar_f64((double *)samples, count, gain); return;
+    }
+}
+
+/* ---- SSE2 / AVX2 ----------------------------------------------------------- */
+
+#if FFK_HAVE_X86
+
+static size_t ffk_sse2_f32(void *samples, size_t count, double gain) {
+    float *s = (float *)samples;
+    const __m128 g = _mm_set1_ps((float)gain);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        _mm_storeu_ps(s + i, _mm_mul_ps(_mm_loadu_ps(s + i), g));
+        _mm_storeu_ps(s + i + 4, _mm_mul_ps(_mm_loadu_ps(s + i + 4), g));
+    }
+    return i;
+}
+
+static size_t ffk_sse2_f64(void *samples, size_t count, double gain) {
+    double *s = (double *)samples;
+    const __m128d g = _mm_set1_pd(gain);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_pd(s + i, _mm_mul_pd(_mm_loadu_pd(s + i), g));
+        _mm_storeu_pd(s + i + 2, _mm_mul_pd(_mm_loadu_pd(s + i + 2), g));
+    }
+    return i;
+}
+
+/* 16-bit gain runs in float: exact for the samples, one rounding for the
+ * product. Clamping before cvtps keeps huge products out of its overflow
+ * value. */
+static size_t ffk_sse2_s16(void *samples, size_t count, double gain) {
+    int16_t *s = (int16_t *)samples;
+    const __m128 g = _mm_set1_ps((float)gain);
+    const __m128 lo = _mm_set1_ps(-32768.0f);
+    const __m128 hi = _mm_set1_ps(32767.0f);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m128i x = _mm_loadu_si128((const __m128i *)(s + i));
+        __m128 a = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16));
+        __m128 b = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16));
+        a = _mm_max_ps(_mm_min_ps(_mm_mul_ps(a, g), hi), lo);
+        b = _mm_max_ps(_mm_min_ps(_mm_mul_ps(b, g), hi), lo);
+        _mm_storeu_si128((__m128i *)(s + i),
+                         _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b)));
+    }
+    return i;
+}
+
+/* 32-bit gain runs in double so it matches the scalar path exactly. */
+static size_t ffk_sse2_s32(void *samples, size_t count, double gain) {
+    int32_t *s = (int32_t *)samples;
+    const __m128d g = _mm_set1_pd(gain);
+    const __m128d lo = _mm_set1_pd(-2147483648.0);
+    const __m128d hi = _mm_set1_pd(2147483647.0);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128i x = _mm_loadu_si128((const __m128i *)(s + i));
+        __m128d a = _mm_mul_pd(_mm_cvtepi32_pd(x), g);
+        __m128d b = _mm_mul_pd(_mm_cvtepi32_pd(_mm_srli_si128(x, 8)), g);
+        a = _mm_max_pd(_mm_min_pd(a, hi), lo);
+        b = _mm_max_pd(_mm_min_pd(b, hi), lo);
+        _mm_storeu_si128((__m128i *)(s + i),
+                         _mm_unpacklo_epi64(_mm_cvtpd_epi32(a), _mm_cvtpd_epi32(b)));
+    }
+    return i;
+}
+
+#if defined(__GNUC__) || defined(__clang__)
+#define FFK_HAVE_AVX2 1
+#define FFK_AVX2 __attribute__((target("avx2")))
+
+FFK_AVX2 static size_t ffk_avx2_f32(void *samples, size_t count, double gain) {
+    float *s = (float *)samples;
+    const __m256 g = _mm256_set1_ps((float)gain);
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        _mm256_storeu_ps(s + i, _mm256_mul_ps(_mm256_loadu_ps(s + i), g));
+        _mm256_storeu_ps(s + i + 8, _mm256_mul_ps(_mm256_loadu_ps(s + i + 8), g));
+    }
+    return i;
+}
+
+FFK_AVX2 static size_t ffk_avx2_f64(void *samples, size_t count, double gain) {
+    double *s = (double *)samples;
+    const __m256d g = _mm256_set1_pd(gain);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        _mm256_storeu_pd(s + i, _mm256_mul_pd(_mm256_loadu_pd(s + i), g));
+        _mm256_storeu_pd(s + i + 4, _mm256_mul_pd(_mm256_loadu_pd(s + i + 4), g));
+    }
+    return i;
+}
+
+/* packs works per 128-bit lane; permute4x64 restores sample order. */
+FFK_AVX2 static size_t ffk_avx2_s16(void *samples, size_t count, double gain) {
+    int16_t *s = (int16_t *)samples;
+    const __m256 g = _mm256_set1_ps((float)gain);
+    const __m256 lo = _mm256_set1_ps(-32768.0f);
+    const __m256 hi = _mm256_set1_ps(32767.0f);
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        const __m128i x0 = _mm_loadu_si128((const __m128i *)(s + i));
+        const __m128i x1 = _mm_loadu_si128((const __m128i *)(s + i + 8));
+        __m256 a = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(x0));
+        __m256 b = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(x1));
+        a = _mm256_max_ps(_mm256_min_ps(_mm256_mul_ps(a, g), hi), lo);
+        b = _mm256_max_ps(_mm256_min_ps(_mm256_mul_ps(b, g), hi), lo);
+        const __m256i packed =
+            _mm256_packs_epi32(_mm256_cvtps_epi32(a), _mm256_cvtps_epi32(b));
+        _mm256_storeu_si256((__m256i *)(s + i), _mm256_permute4x64_epi64(packed, 0xD8));
+    }
+    return i;
+}
+
+FFK_AVX2 static size_t ffk_avx2_s32(void *samples, size_t count, double gain) {
+    int32_t *s = (int32_t *)samples;
+    const __m256d g = _mm256_set1_pd(gain);
+    const __m256d lo = _mm256_set1_pd(-2147483648.0);
+    const __m256d hi = _mm256_set1_pd(2147483647.0);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128i x = _mm_loadu_si128((const __m128i *)(s + i));
+        __m256d a = _mm256_mul_pd(_mm256_cvtepi32_pd(x), g);
+        a = _mm256_max_pd(_mm256_min_pd(a, hi), lo);
+        _mm_storeu_si128((__m128i *)(s + i), _mm256_cvtpd_epi32(a));
+    }
+    return i;
+}
+
+#endif /* __GNUC__ || __clang__ */
+
+#endif /* FFK_HAVE_X86 */
+
+/* ---- NEON ------------------------------------------------------------------ */
+
+#if FFK_HAVE_NEON
+
+static size_t ffk_neon_f32(void *samples, size_t count, double gain) {
+    float *s = (float *)samples;
+    const float g = (float)gain;
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        vst1q_f32(s + i, vmulq_n_f32(vld1q_f32(s + i), g));
+        vst1q_f32(s + i + 4, vmulq_n_f32(vld1q_f32(s + i + 4), g));
+    }
+    return i;
+}
+
+static size_t ffk_neon_f64(void *samples, size_t count, double gain) {
+    double *s = (double *)samples;
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        vst1q_f64(s + i, vmulq_n_f64(vld1q_f64(s + i), gain));
+        vst1q_f64(s + i + 2, vmulq_n_f64(vld1q_f64(s + i + 2), gain));
+    }
+    return i;
+}
+
+/* vcvtn rounds to nearest even and saturates; vqmovn saturates the narrowing. */
+static size_t ffk_neon_s16(void *samples, size_t count, double gain) {
+    int16_t *s = (int16_t *)samples;
+    const float g = (float)gain;
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const int16x8_t x = vld1q_s16(s + i);
+        const float32x4_t a = vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(x))), g);
+        const float32x4_t b = vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(x))), g);
+        vst1q_s16(s + i, vcombine_s16(vqmovn_s32(vcvtnq_s32_f32(a)),
+                                      vqmovn_s32(vcvtnq_s32_f32(b))));
+    }
+    return i;
+}
+
+static size_t ffk_neon_s32(void *samples, size_t count, double gain) {
+    int32_t *s = (int32_t *)samples;
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const int32x4_t x = vld1q_s32(s + i);
+        const float64x2_t a = vmulq_n_f64(vcvtq_f64_s64(vmovl_s32(vget_low_s32(x))), gain);
+        const float64x2_t b = vmulq_n_f64(vcvtq_f64_s64(vmovl_s32(vget_high_s32(x))), gain);
+        vst1q_s32(s + i, vcombine_s32(vqmovn_s64(vcvtnq_s64_f64(a)),
+                                      vqmovn_s64(vcvtnq_s64_f64(b))));
+    }
+    return i;
+}
+
+#endif /* FFK_HAVE_NEON */
+
+/* ---- Dispatch -------------------------------------------------------------- */
+
+static FFInterleaveISA gActiveIsa = FFDEC_INTERLEAVE_ISA_SCALAR;
+static pthread_once_t gIsaOnce = PTHREAD_ONCE_INIT;
+
+static int ffk_isa_supported(FFInterleaveISA isa) {
+    switch (isa) {
+        case FFDEC_INTERLEAVE_ISA_SCALAR:
+            return 1;
+#if FFK_HAVE_X86
+        case FFDEC_INTERLEAVE_ISA_SSE2:
+#if defined(__x86_64__) || defined(__SSE2__)
+            return 1;
+#else
+            return __builtin_cpu_supports("sse2");
+#endif
+#if FFK_HAVE_AVX2
+        case FFDEC_INTERLEAVE_ISA_AVX2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2");
+#endif
+#endif
+#if FFK_HAVE_NEON
+        case FFDEC_INTERLEAVE_ISA_NEON:
+            return 1;
+#endif
+        default:
+            return 0;
+    }
+}
+
+static void ffk_detect_isa(void) {
+    static const FFInterleaveISA preference[] = {
+        FFDEC_INTERLEAVE_ISA_AVX2,
+        FFDEC_INTERLEAVE_ISA_NEON,
+        FFDEC_INTERLEAVE_ISA_SSE2,
+    };
+    for (size_t i = 0; i < sizeof(preference) / sizeof(preference[0]); ++i) {
+        if (ffk_isa_supported(preference[i])) {
+            gActiveIsa = preference[i];
+            return;
+        }
+    }
+    gActiveIsa = FFDEC_INTERLEAVE_ISA_SCALAR;
+}
+
+FFInterleaveISA ffdecoder_sample_kernels_isa(void) {
+    pthread_once(&gIsaOnce, ffk_detect_isa);
+    return gActiveIsa;
+}
+
+int ffdecoder_sample_kernels_set_isa(FFInterleaveISA isa) {
+    pthread_once(&gIsaOnce, ffk_detect_isa);
+    if (!ffk_isa_supported(isa)) {
+        return -1;
+    }
+    gActiveIsa = isa;
+    return 0;
+}
+
+static ffk_kernel ffk_select_kernel(FFInterleaveISA isa, FFSampleType type) {
+    switch (isa) {
+#if FFK_HAVE_X86
+#if FFK_HAVE_AVX2
+        case FFDEC_INTERLEAVE_ISA_AVX2:
+            if (type == FFDEC_SAMPLE_S16) return ffk_avx2_s16;
+            if (type == FFDEC_SAMPLE_S32) return ffk_avx2_s32;
+            if (type == FFDEC_SAMPLE_F32) return ffk_avx2_f32;
+            if (type == FFDEC_SAMPLE_F64) return ffk_avx2_f64;
+            return NULL;
+#endif
+        case FFDEC_INTERLEAVE_ISA_SSE2:
+            if (type == FFDEC_SAMPLE_S16) return ffk_sse2_s16;
+            if (type == FFDEC_SAMPLE_S32) return ffk_sse2_s32;
+            if (type == FFDEC_SAMPLE_F32) return ffk_sse2_f32;
+            if (type == FFDEC_SAMPLE_F64) return ffk_sse2_f64;
+            return NULL;
+#endif
+#if FFK_HAVE_NEON
+        case FFDEC_INTERLEAVE_ISA_NEON:
+            if (type == FFDEC_SAMPLE_S16) return ffk_neon_s16;
+            if (type == FFDEC_SAMPLE_S32) return ffk_neon_s32;
+            if (type == FFDEC_SAMPLE_F32) return ffk_neon_f32;
+            if (type == FFDEC_SAMPLE_F64) return ffk_neon_f64;
+            return NULL;
+#endif
+        default:
+            return NULL;
+    }
+}
+
+void ffdecoder_scale_samples(FFSampleType type, void *samples, size_t count, double gain) {
+    if (!samples || count == 0 || gain == 1.0) {
+        return;
+    }
+    size_t done = 0;
+    ffk_kernel kernel = ffk_select_kernel(ffdecoder_sample_kernels_isa(), type);
+    if (kernel) {
+        done = kernel(samples, count, gain);
+    }
+    if (done < count) {
+        ffdecoder_scale_samples_scalar(type, (uint8_t *)samples + done * ffk_bytes(type),
+                                       count - done, gain);
+    }
+}
@@ -0,0 +1,332 @@
+#include "FFmpegSeekIndex.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define SEEK_INDEX_VERSION 1
+#define SEEK_INDEX_HEADER_BYTES 40
+#define SEEK_INDEX_TRAILER_BYTES 4
+
+typedef struct {
+    uint64_t frame;
+    uint64_t byteOffset;
+} FFDecoderSeekPoint;
+
+struct FFDecoderSeekIndex {
+    uint32_t sampleRate;
+    uint32_t intervalFrames;
+    FFDecoderSeekPoint *points;
+    size_t count;
+    size_t capacity;
+};
+
+static const uint8_t kSeekIndexMagic[4] = {'T', 'N', 'S', 'X'};
+
+static uint32_t seekindex_fnv1a32(const uint8_t *data, size_t size) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= data[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static uint64_t seekindex_fnv1a64(uint64_t hash, const uint8_t *data, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        hash ^= data[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+static uint32_t seekindex_path_hash(const char *path) {
+    return seekindex_fnv1a32((const uint8_t *)path, strlen(path));
+}
+
+static uint8_t *seekindex_put_le(uint8_t *out, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        *out++ = (uint8_t)(value >> (8 * i));
+    }
+    return out;
+}
+
+static uint64_t seekindex_get_le(const uint8_t *in, int bytes) {
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; i++) {
+        value |= (uint64_t)in[i] << (8 * i);
+    }
+    return value;
+}
+
+static uint8_t *seekindex_put_varint(uint8_t *out, uint64_t value) {
+    while (value >= 0x80) {
+        *out++ = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    *out++ = (uint8_t)value;
+    return out;
+}
+
+static int seekindex_get_varint(const uint8_t **in, const uint8_t *end, uint64_t *value) {
+    uint64_t result = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (*in == end) {
+            return 0;
+        }
+        uint8_t byte = *(*in)++;
+        result |= (uint64_t)(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            *value = result;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* `<cacheDir>/<name>` plus room for a ".tmp" suffix, or NULL. */
+static char *seekindex_cache_path(const char *cacheDir, const FFDecoderSeekIndexKey *key) {
+    char name[FFDEC_SEEK_INDEX_NAME_SIZE];
+    ffdecoder_seekindex_cache_name(key, name);
+    size_t dirLength = strlen(cacheDir);
+    size_t size = dirLength + 1 + strlen(name) + sizeof(".tmp");
+    char *path = malloc(size);
+    if (!path) {
+        return NULL;
+    }
+    int needsSlash = dirLength > 0 && cacheDir[dirLength - 1] != '/';
+    snprintf(path, size, "%s%s%s", cacheDir, needsSlash ? "/" : "", name);
+    return path;
+}
+
+FFDecoderSeekIndex *ffdecoder_seekindex_create(uint32_t sampleRate, uint32_t intervalFrames) {
+    FFDecoderSeekIndex *index = calloc(1, sizeof(FFDecoderSeekIndex));
+    if (!index) {
+        return NULL;
+    }
+    index->sampleRate = sampleRate;
+    index->intervalFrames = intervalFrames > 0 ? intervalFrames : 1;
+    return index;
+}
+
+void ffdecoder_seekindex_free(FFDecoderSeekIndex *index) {
+    if (!index) return;
+    free(index->points);
+    free(index);
+}
+
+int ffdecoder_seekindex_add(FFDecoderSeekIndex *index, uint64_t frame, uint64_t byteOffset) {
+    if (!index) {
+        return -1;
+    }
+    if (index->count > 0) {
+        const FFDecoderSeekPoint *last = &index->points[index->count - 1];
+        if (frame <= last->frame || byteOffset <= last->byteOffset) {
+            return 0;
+        }
+        if (frame / index->intervalFrames == last->frame / index->intervalFrames) {
+            return 0;
+        }
+    }
+    if (index->count == index->capacity) {
+        size_t capacity = index->capacity ? index->capacity * 2 : 256;
+        FFDecoderSeekPoint *points = realloc(index->points, capacity * sizeof(FFDecoderSeekPoint));
+        if (!points) {
+            return -1;
+        }
+        index->points = points;
+        index->capacity = capacity;
+    }
+    index->points[index->count].frame = frame;
+    index->points[index->count].byteOffset = byteOffset;
+    index->count++;
+    return 0;
+}
+
+int ffdecoder_seekindex_lookup(const FFDecoderSeekIndex *index, uint64_t frame,
+                               uint64_t *pointFrame, uint64_t *byteOffset) {
+    if (!index || index->count == 0 || frame < index->points[0].frame) {
+        return 0;
+    }
+    /* Points occupy strictly increasing buckets, so the target's bucket bounds
+     * the answer's position; the walk back only crosses empty buckets. */
+    uint64_t bucket = frame / index->intervalFrames;
+    size_t i = bucket < index->count ? (size_t)bucket : index->count - 1;
+    while (index->points[i].frame > frame) {
+        i--;
+    }
+    if (pointFrame) *pointFrame = index->points[i].frame;
+    if (byteOffset) *byteOffset = index->points[i].byteOffset;
+    return 1;
+}
+
+size_t ffdecoder_seekindex_count(const FFDecoderSeekIndex *index) {
+    return index ? index->count : 0;
+}
+
+uint32_t ffdecoder_seekindex_sample_rate(const FFDecoderSeekIndex *index) {
+    return index ? index->sampleRate : 0;
+}
+
+int ffdecoder_seekindex_key_for_path(const char *path, FFDecoderSeekIndexKey *key) {
+    struct stat st;
+    if (!path || !key || stat(path, &st) != 0) {
+        return -1;
+    }
+    key->path = path;
+    key->fileSize = (uint64_t)st.st_size;
+    key->mtimeSeconds = (int64_t)st.st_mtime;
+    return 0;
+}
+
+void ffdecoder_seekindex_cache_name(const FFDecoderSeekIndexKey *key, char *name) {
+    uint8_t sizeAndTime[16];
+    for (int i = 0; i < 8; i++) {
+        sizeAndTime[i] = (uint8_t)(key->fileSize >> (8 * i));
+        sizeAndTime[8 + i] = (uint8_t)((uint64_t)key->mtimeSeconds >> (8 * i));
+    }
+    uint64_t hash = seekindex_fnv1a64(14695981039346656037ull, (const uint8_t *)key->path, strlen(key->path));
+    hash = seekindex_fnv1a64(hash, sizeAndTime, sizeof(sizeAndTime));
+    snprintf(name, FFDEC_SEEK_INDEX_NAME_SIZE, "%016llx.seekidx", (unsigned long long)hash);
+}
+
+int ffdecoder_seekindex_save(const FFDecoderSeekIndex *index, const char *cacheDir,
+                             const FFDecoderSeekIndexKey *key) {
+    if (!index || !cacheDir || !key || !key->path || index->count > UINT32_MAX) {
+        return -1;
+    }
+    /* Two 10-byte varints per point at most. */
+    size_t capacity = SEEK_INDEX_HEADER_BYTES + index->count * 20 + SEEK_INDEX_TRAILER_BYTES;
+    uint8_t *bytes = malloc(capacity);
+    if (!bytes) {
+        return -1;
+    }
+    uint8_t *out = bytes;
+    memcpy(out, kSeekIndexMagic, sizeof(kSeekIndexMagic));
+    out += sizeof(kSeekIndexMagic);
+    out = seekindex_put_le(out, SEEK_INDEX_VERSION, 2);
+    out = seekindex_put_le(out, 0, 2);
+    out = seekindex_put_le(out, key->fileSize, 8);
+    out = seekindex_put_le(out, (uint64_t)key->mtimeSeconds, 8);
+    out = seekindex_put_le(out, index->sampleRate, 4);
+    out = seekindex_put_le(out, index->intervalFrames, 4);
+    out = seekindex_put_le(out, index->count, 4);
+    out = seekindex_put_le(out, seekindex_path_hash(key->path), 4);
+    FFDecoderSeekPoint prev = {0, 0};
+    for (size_t i = 0; i < index->count; i++) {
+        out = seekindex_put_varint(out, index->points[i].frame - prev.frame);
+        out = seekindex_put_varint(out, index->points[i].byteOffset - prev.byteOffset);
+        prev = index->points[i];
+    }
+    out = seekindex_put_le(out, seekindex_fnv1a32(bytes, (size_t)(out - bytes)), 4);
+    size_t size = (size_t)(out - bytes);
+
+    char *target = seekindex_cache_path(cacheDir, key);
+    if (!target) {
+        free(bytes);
+        return -1;
+    }
+    size_t tempSize = strlen(target) + sizeof(".tmp");
+    char *temp = malloc(tempSize);
+    int result = -1;
+    if (temp) {
+        snprintf(temp, tempSize, "%s.tmp", target);
+        FILE *file = fopen(temp, "wb");
+        if (file) {
+            int written = fwrite(bytes, 1, size, file) == size;
+            if (fclose(file) == 0 && written && rename(temp, target) == 0) {
+                result = 0;
+            } else {
+                remove(temp);
+            }
+        }
+        free(temp);
+    }
+    free(target);
+    free(bytes);
+    return result;
+}
+
+FFDecoderSeekIndex *ffdecoder_seekindex_load(const char *cacheDir, const FFDecoderSeekIndexKey *key) {
+    if (!cacheDir || !key || !key->path) {
+        return NULL;
+    }
+    char *path = seekindex_cache_path(cacheDir, key);
+    if (!path) {
+        return NULL;
+    }
+    FILE *file = fopen(path, "rb");
+    free(path);
+    if (!file) {
+        return NULL;
+    }
+    uint8_t *bytes = NULL;
+    size_t size = 0;
+    size_t capacity = 0;
+    while (1) {
+        if (size == capacity) {
+            size_t grown = capacity ? capacity * 2 : 4096;
+            uint8_t *next = realloc(bytes, grown);
+            if (!next) {
+                free(bytes);
+                fclose(file);
+                return NULL;
+            }
+            bytes = next;
+            capacity = grown;
+        }
+        size_t got = fread(bytes + size, 1, capacity - size, file);
+        if (got == 0) {
+            break;
+        }
+        size += got;
+    }
+    fclose(file);
+
+    FFDecoderSeekIndex *index = NULL;
+    if (size >= SEEK_INDEX_HEADER_BYTES + SEEK_INDEX_TRAILER_BYTES) {
+        size_t bodyEnd = size - SEEK_INDEX_TRAILER_BYTES;
+        uint32_t count = (uint32_t)seekindex_get_le(bytes + 32, 4);
+        uint32_t interval = (uint32_t)seekindex_get_le(bytes + 28, 4);
+        int valid = seekindex_get_le(bytes + bodyEnd, 4) == seekindex_fnv1a32(bytes, bodyEnd) &&
+                    memcmp(bytes, kSeekIndexMagic, sizeof(kSeekIndexMagic)) == 0 &&
+                    seekindex_get_le(bytes + 4, 2) == SEEK_INDEX_VERSION &&
+                    seekindex_get_le(bytes + 8, 8) == key->fileSize &&
+                    (int64_t)seekindex_get_le(bytes + 16, 8) == key->mtimeSeconds &&
+                    seekindex_get_le(bytes + 36, 4) == seekindex_path_hash(key->path) &&
+                    interval > 0 &&
+                    count <= (bodyEnd - SEEK_INDEX_HEADER_BYTES) / 2;
+        if (valid) {
+            index = ffdecoder_seekindex_create((uint32_t)seekindex_get_le(bytes + 24, 4), interval);
+        }
+        if (index && count > 0) {
+            index->points = malloc(count * sizeof(FFDecoderSeekPoint));
+            index->capacity = index->points ? count : 0;
+        }
+        const uint8_t *in = bytes + SEEK_INDEX_HEADER_BYTES;
+        const uint8_t *end = bytes + bodyEnd;
+        FFDecoderSeekPoint point = {0, 0};
+        for (uint32_t i = 0; index && i < count; i++) {
+            uint64_t frameDelta = 0;
+            uint64_t offsetDelta = 0;
+            if (!index->points ||
+                !seekindex_get_varint(&in, end, &frameDelta) ||
+                !seekindex_get_varint(&in, end, &offsetDelta) ||
+                (i > 0 && (frameDelta == 0 || offsetDelta == 0))) {
+                ffdecoder_seekindex_free(index);
+                index = NULL;
+                break;
+            }
+            point.frame += frameDelta;
+            point.byteOffset += offsetDelta;
+            index->points[index->count++] = point;
+        }
+        if (index && in != end) {
+            ffdecoder_seekindex_free(index);
+            index = NULL;
+        }
+    }
+    free(bytes);
+    return index;
+}
@@ -0,0 +1,493 @@
+#include "FFmpegWaveform.h"
+#include "FFmpegBridge.h"
+#include "FFmpegSeekIndex.h"
+
+#include <libavutil/error.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define WAVEFORM_VERSION 1
+#define WAVEFORM_HEADER_BYTES 48
+#define WAVEFORM_CHECKSUM_OFFSET 44
+#define WAVEFORM_LEVEL_ENTRY_BYTES 8
+#define WAVEFORM_POINT_BYTES 6
+#define WAVEFORM_LEVEL_FACTOR 4
+#define WAVEFORM_MIN_TOP_POINTS 256
+#define WAVEFORM_MAX_CHANNELS 2
+#define WAVEFORM_FULL_SCALE 32767.0f
+#define WAVEFORM_CHUNK_FRAMES 4096
+
+_Static_assert(sizeof(FFWaveformPoint) == WAVEFORM_POINT_BYTES, "points are mapped in place");
+
+struct FFWaveform {
+    uint8_t *data;
+    size_t size;
+    uint32_t sampleRate;
+    uint32_t channels;
+    uint64_t frames;
+    size_t levelCount;
+    FFWaveformLevel levels[FFWAVEFORM_MAX_LEVELS];
+};
+
+typedef struct {
+    float min;
+    float max;
+    double sumSquares;
+    uint64_t samples;
+} WaveformAccumulator;
+
+static const uint8_t kWaveformMagic[4] = {'T', 'N', 'W', 'F'};
+
+static uint32_t waveform_fnv1a32(uint32_t hash, const uint8_t *data, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        hash ^= data[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static uint64_t waveform_fnv1a64(uint64_t hash, const uint8_t *data, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        hash ^= data[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+static uint32_t waveform_path_hash(const char *path) {
+    return waveform_fnv1a32(2166136261u, (const uint8_t *)path, strlen(path));
+}
+
+/* Header (minus its checksum) and level table. */
+static uint32_t waveform_header_checksum(const uint8_t *data, size_t levels) {
+    uint32_t hash = waveform_fnv1a32(2166136261u, data, WAVEFORM_CHECKSUM_OFFSET);
+    return waveform_fnv1a32(hash, data + WAVEFORM_HEADER_BYTES, levels * WAVEFORM_LEVEL_ENTRY_BYTES);
+}
+
+static uint8_t *waveform_put_le(uint8_t *out, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        *out++ = (uint8_t)(value >> (8 * i));
+    }
+    return out;
+}
+
+static uint64_t waveform_get_le(const uint8_t *in, int bytes) {
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; i++) {
+        value |= (uint64_t)in[i] << (8 * i);
+    }
+    return value;
+}
+
+/* `<cacheDir>/<16 hex digits>.waveform` plus room for a ".tmp" suffix, or
+ * NULL. Named like the seek index, so both caches agree on a file's key. */
+static char *waveform_cache_path(const char *cacheDir, const FFDecoderSeekIndexKey *key) {
+    uint8_t sizeAndTime[16];
+    for (int i = 0; i < 8; i++) {
+        sizeAndTime[i] = (uint8_t)(key->fileSize >> (8 * i));
+        sizeAndTime[8 + i] = (uint8_t)((uint64_t)key->mtimeSeconds >> (8 * i));
+    }
+    uint64_t hash = waveform_fnv1a64(14695981039346656037ull, (const uint8_t *)key->path, strlen(key->path));
+    hash = waveform_fnv1a64(hash, sizeAndTime, sizeof(sizeAndTime));
+    size_t dirLength = strlen(cacheDir);
+    size_t size = dirLength + 1 + 16 + sizeof(".waveform") + sizeof(".tmp");
+    char *path = malloc(size);
+    if (!path) {
+        return NULL;
+    }
+    int needsSlash = dirLength > 0 && cacheDir[dirLength - 1] != '/';
+    snprintf(path, size, "%s%s%016llx.waveform", cacheDir, needsSlash ? "/" : "",
+             (unsigned long long)hash);
+    return path;
+}
+
+static uint32_t waveform_base_frames_per_point(uint32_t sampleRate) {
+    uint32_t frames = 1;
+    while (frames < sampleRate / 64) {
+        frames <<= 1;
+    }
+    return frames;
+}
+
+static void waveform_reset(WaveformAccumulator *point) {
+    point->min = INFINITY;
+    point->max = -INFINITY;
+    point->sumSquares = 0.0;
+    point->samples = 0;
+}
+
+static int16_t waveform_quantize(float value) {
+    float scaled = roundf(value * WAVEFORM_FULL_SCALE);
+    if (scaled < -32768.0f) return -32768;
+    if (scaled > 32767.0f) return 32767;
+    return (int16_t)scaled;
+}
+
+static float waveform_sample(const uint8_t *in, FFDecSampleFormat format) {
+    switch (format) {
+        case FFDEC_SAMPLE_FMT_S16: {
+            int16_t v;
+            memcpy(&v, in, sizeof(v));
+            return (float)v / 32768.0f;
+        }
+        case FFDEC_SAMPLE_FMT_S32: {
+            int32_t v;
+            memcpy(&v, in, sizeof(v));
+            return (float)v / 2147483648.0f;
+        }
+        case FFDEC_SAMPLE_FMT_FLOAT: {
+            float v;
+            memcpy(&v, in, sizeof(v));
+            return v;
+        }
+        case FFDEC_SAMPLE_FMT_DOUBLE: {
+            double v;
+            memcpy(&v, in, sizeof(v));
+            return (float)v;
+        }
+        default:
+            return 0.0f;
+    }
+}
+
+/* Serializes `levels` (finest first) exactly as AudioEngineCore's
+ * Waveform::Serialize() does. Returns a malloc'd buffer, or NULL. */
+static uint8_t *waveform_serialize(const FFDecoderSeekIndexKey *key, uint32_t sampleRate,
+                                   uint32_t channels, uint64_t frames, uint32_t baseFramesPerPoint,
+                                   WaveformAccumulator *const *levels, const size_t *counts,
+                                   size_t levelCount, size_t *size) {
+    size_t points = 0;
+    for (size_t l = 0; l < levelCount; l++) {
+        points += counts[l];
+    }
+    *size = WAVEFORM_HEADER_BYTES + levelCount * WAVEFORM_LEVEL_ENTRY_BYTES + points * WAVEFORM_POINT_BYTES;
+    uint8_t *bytes = malloc(*size);
+    if (!bytes) {
+        return NULL;
+    }
+    uint8_t *out = bytes;
+    memcpy(out, kWaveformMagic, sizeof(kWaveformMagic));
+    out += sizeof(kWaveformMagic);
+    out = waveform_put_le(out, WAVEFORM_VERSION, 2);
+    out = waveform_put_le(out, levelCount, 2);
+    out = waveform_put_le(out, key->fileSize, 8);
+    out = waveform_put_le(out, (uint64_t)key->mtimeSeconds, 8);
+    out = waveform_put_le(out, sampleRate, 4);
+    out = waveform_put_le(out, waveform_path_hash(key->path), 4);
+    out = waveform_put_le(out, frames, 8);
+    out = waveform_put_le(out, channels, 4);
+    out = waveform_put_le(out, 0, 4);  /* checksum, below */
+    uint32_t framesPerPoint = baseFramesPerPoint;
+    for (size_t l = 0; l < levelCount; l++) {
+        out = waveform_put_le(out, framesPerPoint, 4);
+        out = waveform_put_le(out, counts[l], 4);
+        framesPerPoint *= WAVEFORM_LEVEL_FACTOR;
+    }
+    waveform_put_le(bytes + WAVEFORM_CHECKSUM_OFFSET, waveform_header_checksum(bytes, levelCount), 4);
+    for (size_t l = 0; l < levelCount; l++) {
+        for (size_t i = 0; i < counts[l]; i++) {
+            const WaveformAccumulator *point = &levels[l][i];
+            float rms = (float)sqrt(point->sumSquares / (double)point->samples);
+            out = waveform_put_le(out, (uint16_t)waveform_quantize(point->min), 2);
+            out = waveform_put_le(out, (uint16_t)waveform_quantize(point->max), 2);
+            out = waveform_put_le(out, (uint16_t)waveform_quantize(rms), 2);
+        }
+    }
+    return bytes;
+}
+
+static int waveform_write(const char *target, const uint8_t *bytes, size_t size) {
+    size_t tempSize = strlen(target) + sizeof(".tmp");
+    char *temp = malloc(tempSize);
+    if (!temp) {
+        return -1;
+    }
+    snprintf(temp, tempSize, "%s.tmp", target);
+    int result = -1;
+    FILE *file = fopen(temp, "wb");
+    if (file) {
+        int written = fwrite(bytes, 1, size, file) == size;
+        if (fclose(file) == 0 && written && rename(temp, target) == 0) {
+            result = 0;
+        } else {
+            remove(temp);
+        }
+    }
+    free(temp);
+    return result;
+}
+
+/* Merges points into coarser levels and saves them. Takes ownership of
+ * `points`. Returns 0 on success. */
+static int waveform_finish(const FFDecoderSeekIndexKey *key, const char *cacheDir,
+                           uint32_t sampleRate, uint32_t channels, uint64_t frames,
+                           uint32_t baseFramesPerPoint, WaveformAccumulator *points, size_t count) {
+    WaveformAccumulator *levels[FFWAVEFORM_MAX_LEVELS] = {points};
+    size_t counts[FFWAVEFORM_MAX_LEVELS] = {count};
+    size_t levelCount = 1;
+    int result = 0;
+    while (counts[levelCount - 1] > WAVEFORM_MIN_TOP_POINTS && levelCount < FFWAVEFORM_MAX_LEVELS) {
+        const WaveformAccumulator *finer = levels[levelCount - 1];
+        size_t finerCount = counts[levelCount - 1];
+        size_t coarserCount = (finerCount + WAVEFORM_LEVEL_FACTOR - 1) / WAVEFORM_LEVEL_FACTOR;
+        WaveformAccumulator *coarser = malloc(coarserCount * sizeof(WaveformAccumulator));
+        if (!coarser) {
+            result = -1;
+            break;
+        }
+        /* A partial last point weighs by its sample count. */
+        for (size_t i = 0; i < coarserCount; i++) {
+            WaveformAccumulator merged = finer[i * WAVEFORM_LEVEL_FACTOR];
+            size_t end = (i + 1) * WAVEFORM_LEVEL_FACTOR;
+            if (end > finerCount) end = finerCount;
+            for (size_t j = i * WAVEFORM_LEVEL_FACTOR + 1; j < end; j++) {
+                merged.min = fminf(merged.min, finer[j].min);
+                merged.max = fmaxf(merged.max, finer[j].max);
+                merged.sumSquares += finer[j].sumSquares;
+                merged.samples += finer[j].samples;
+            }
+            coarser[i] = merged;
+        }
+        levels[levelCount] = coarser;
+        counts[levelCount] = coarserCount;
+        levelCount++;
+    }
+
+    if (result == 0) {
+        size_t size = 0;
+        uint8_t *bytes = waveform_serialize(key, sampleRate, channels, frames, baseFramesPerPoint,
+                                            levels, counts, levelCount, &size);
+        char *target = waveform_cache_path(cacheDir, key);
+        result = bytes && target ? waveform_write(target, bytes, size) : -1;
+        free(target);
+        free(bytes);
+    }
+    for (size_t l = 0; l < levelCount; l++) {
+        free(levels[l]);
+    }
+    return result;
+}
+
+int ffwaveform_build(const char *path, const char *cacheDir) {
+    FFDecoderSeekIndexKey key;
+    if (!path || !cacheDir || ffdecoder_seekindex_key_for_path(path, &key) != 0) {
+        return AVERROR(EINVAL);
+    }
+    FFWaveform *cached = ffwaveform_map(path, cacheDir);
+    if (cached) {
+        ffwaveform_close(cached);
+        return 0;
+    }
+
+    /* Only the samples matter, so skip the full stream probe. */
+    FFDecoderOpenOptions options = {.fastOpen = 1, .gapless = 0};
+    FFDecoderHandle *decoder = ffdecoder_open_with_options(path, &options);
+    if (!decoder) {
+        return AVERROR_INVALIDDATA;
+    }
+    int sampleRate = ffdecoder_get_sample_rate(decoder);
+    int channels = ffdecoder_get_channels(decoder);
+    int bytesPerFrame = ffdecoder_get_bytes_per_frame(decoder);
+    FFDecSampleFormat format = ffdecoder_get_sample_format(decoder);
+    if (sampleRate <= 0 || channels <= 0 || bytesPerFrame <= 0 || format == FFDEC_SAMPLE_FMT_UNKNOWN) {
+        ffdecoder_close(decoder);
+        return AVERROR_INVALIDDATA;
+    }
+    int bytesPerSample = bytesPerFrame / channels;
+    int measured = channels < WAVEFORM_MAX_CHANNELS ? channels : WAVEFORM_MAX_CHANNELS;
+    uint32_t framesPerPoint = waveform_base_frames_per_point((uint32_t)sampleRate);
+
+    uint8_t *chunk = malloc((size_t)WAVEFORM_CHUNK_FRAMES * (size_t)bytesPerFrame);
+    WaveformAccumulator *points = NULL;
+    size_t count = 0;
+    size_t capacity = 0;
+    WaveformAccumulator current;
+    waveform_reset(&current);
+    uint32_t currentFrames = 0;
+    uint64_t frames = 0;
+    size_t pending = 0;  /* bytes of a partial frame carried to the next read */
+    int ret = chunk ? 0 : AVERROR(ENOMEM);
+    while (ret == 0) {
+        ssize_t got = ffdecoder_read(decoder, chunk + pending,
+                                     (size_t)WAVEFORM_CHUNK_FRAMES * (size_t)bytesPerFrame - pending);
+        if (got <= 0) {
+            break;
+        }
+        size_t available = pending + (size_t)got;
+        size_t whole = available / (size_t)bytesPerFrame;
+        for (size_t f = 0; f < whole; f++) {
+            const uint8_t *frame = chunk + f * (size_t)bytesPerFrame;
+            for (int ch = 0; ch < measured; ch++) {
+                float v = waveform_sample(frame + ch * bytesPerSample, format);
+                current.min = v < current.min ? v : current.min;
+                current.max = v > current.max ? v : current.max;
+                current.sumSquares += (double)v * v;
+            }
+            current.samples += (uint64_t)measured;
+            if (++currentFrames == framesPerPoint) {
+                if (count == capacity) {
+                    size_t grown = capacity ? capacity * 2 : 1024;
+                    WaveformAccumulator *resized = realloc(points, grown * sizeof(WaveformAccumulator));
+                    if (!resized) {
+                        ret = AVERROR(ENOMEM);
+                        break;
+                    }
+                    points = resized;
+                    capacity = grown;
+                }
+                points[count++] = current;
+                waveform_reset(&current);
+                currentFrames = 0;
+            }
+        }
+        frames += whole;
+        pending = available - whole * (size_t)bytesPerFrame;
+        memmove(chunk, chunk + whole * (size_t)bytesPerFrame, pending);
+    }
+    free(chunk);
+    ffdecoder_close(decoder);
+
+    if (ret == 0 && currentFrames > 0) {
+        WaveformAccumulator *resized = realloc(points, (count + 1) * sizeof(WaveformAccumulator));
+        if (resized) {
+            points = resized;
+            points[count++] = current;
+        } else {
+            ret = AVERROR(ENOMEM);
+        }
+    }
+    if (ret == 0 && count == 0) {
+        ret = AVERROR_INVALIDDATA;
+    }
+    if (ret < 0) {
+        free(points);
+        return ret;
+    }
+    if (waveform_finish(&key, cacheDir, (uint32_t)sampleRate, (uint32_t)channels, frames,
+                        framesPerPoint, points, count) != 0) {
+        return AVERROR(EIO);
+    }
+    return 1;
+}
+
+FFWaveform *ffwaveform_map(const char *path, const char *cacheDir) {
+    FFDecoderSeekIndexKey key;
+    if (!path || !cacheDir || ffdecoder_seekindex_key_for_path(path, &key) != 0) {
+        return NULL;
+    }
+    char *target = waveform_cache_path(cacheDir, &key);
+    if (!target) {
+        return NULL;
+    }
+    int fd = open(target, O_RDONLY);
+    free(target);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < WAVEFORM_HEADER_BYTES) {
+        close(fd);
+        return NULL;
+    }
+    size_t size = (size_t)st.st_size;
+    void *mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        return NULL;
+    }
+    const uint8_t *data = mapping;
+
+    /* Only the header and level table are checked, so serving a waveform
+     * costs the same for any track length. */
+    FFWaveform *waveform = NULL;
+    size_t levels = (size_t)waveform_get_le(data + 6, 2);
+    size_t tableEnd = WAVEFORM_HEADER_BYTES + levels * WAVEFORM_LEVEL_ENTRY_BYTES;
+    if (memcmp(data, kWaveformMagic, sizeof(kWaveformMagic)) != 0 ||
+        waveform_get_le(data + 4, 2) != WAVEFORM_VERSION ||
+        levels == 0 || levels > FFWAVEFORM_MAX_LEVELS || size < tableEnd ||
+        waveform_get_le(data + WAVEFORM_CHECKSUM_OFFSET, 4) != waveform_header_checksum(data, levels) ||
+        waveform_get_le(data + 8, 8) != key.fileSize ||
+        (int64_t)waveform_get_le(data + 16, 8) != key.mtimeSeconds ||
+        waveform_get_le(data + 28, 4) != waveform_path_hash(path) ||
+        waveform_get_le(data + 24, 4) == 0 ||
+        !(waveform = calloc(1, sizeof(FFWaveform)))) {
+        munmap(mapping, size);
+        return NULL;
+    }
+    waveform->data = mapping;
+    waveform->size = size;
+    waveform->sampleRate = (uint32_t)waveform_get_le(data + 24, 4);
+    waveform->frames = waveform_get_le(data + 32, 8);
+    waveform->channels = (uint32_t)waveform_get_le(data + 40, 4);
+    size_t offset = tableEnd;
+    for (size_t i = 0; i < levels; i++) {
+        const uint8_t *entry = data + WAVEFORM_HEADER_BYTES + i * WAVEFORM_LEVEL_ENTRY_BYTES;
+        FFWaveformLevel *level = &waveform->levels[i];
+        level->framesPerPoint = (uint32_t)waveform_get_le(entry, 4);
+        level->count = (size_t)waveform_get_le(entry + 4, 4);
+        if (level->framesPerPoint == 0 || level->count == 0 ||
+            level->count > (size - offset) / WAVEFORM_POINT_BYTES) {
+            ffwaveform_close(waveform);
+            return NULL;
+        }
+        /* Offsets stay even, and the mapping is page-aligned. */
+        level->points = (const FFWaveformPoint *)(data + offset);
+        offset += level->count * WAVEFORM_POINT_BYTES;
+        waveform->levelCount++;
+    }
+    if (offset != size) {
+        ffwaveform_close(waveform);
+        return NULL;
+    }
+    return waveform;
+}
+
+uint32_t ffwaveform_sample_rate(const FFWaveform *waveform) {
+    return waveform ? waveform->sampleRate : 0;
+}
+
+uint32_t ffwaveform_channels(const FFWaveform *waveform) {
+    return waveform ? waveform->channels : 0;
+}
+
+uint64_t ffwaveform_frames(const FFWaveform *waveform) {
+    return waveform ? waveform->frames : 0;
+}
+
+size_t ffwaveform_level_count(const FFWaveform *waveform) {
+    return waveform ? waveform->levelCount : 0;
+}
+
+FFWaveformLevel ffwaveform_level(const FFWaveform *waveform, size_t level) {
+    if (!waveform || level >= waveform->levelCount) {
+        return (FFWaveformLevel){0, 0, NULL};
+    }
+    return waveform->levels[level];
+}
+
+FFWaveformLevel ffwaveform_level_for(const FFWaveform *waveform, size_t points) {
+    if (!waveform || waveform->levelCount == 0) {
+        return (FFWaveformLevel){0, 0, NULL};
+    }
+    for (size_t i = waveform->levelCount; i-- > 1;) {
+        if (waveform->levels[i].count >= points) {
+            return waveform->levels[i];
+        }
+    }
+    return waveform->levels[0];
+}
+
+void ffwaveform_close(FFWaveform *waveform) {
+    if (!waveform) {
+        return;
+    }
+    munmap(waveform->data, waveform->size);
+    free(waveform);
+}
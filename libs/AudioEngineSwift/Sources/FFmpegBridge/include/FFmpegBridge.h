@@ -18,6 +18,9 @@
 #include <stdio.h>
 #include <errno.h>
 
+#include "FFmpegGapless.h"
+#include "FFmpegSeekIndex.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -30,6 +33,46 @@ typedef enum {
     FFDEC_SAMPLE_FMT_DOUBLE
 } FFDecSampleFormat;
 
+typedef struct {
+    /* Trust container headers for FLAC, WAV/AIFF PCM, ALAC and MP3 with a
+     * Xing/LAME/VBRI header: skip avformat_find_stream_info() and the probe
+     * decode, and verify the format against the first decoded frame instead.
+     * Other files silently take the full probe. */
+    int fastOpen;
+    /* Trim encoder delay/padding (iTunSMPB, LAME/Xing header, or codec
+     * padding) so reads, durations and seek positions cover only the
+     * original samples. */
+    int gapless;
+} FFDecoderOpenOptions;
+
+typedef enum {
+    /* Resume from the sync point at or before the target. */
+    FFDEC_SEEK_FAST = 0,
+    /* Decode from before the target, past codec pre-roll, and discard up to
+     * the exact sample. */
+    FFDEC_SEEK_ACCURATE
+} FFDecSeekMode;
+
+/* Destination for ffdecoder_read_spans: the (possibly wrapped) free region of
+ * a caller-owned ring. `second` may be NULL/0 when the region is contiguous. */
+typedef struct {
+    uint8_t *first;
+    size_t firstBytes;
+    uint8_t *second;
+    size_t secondBytes;
+} FFDecoderSpans;
+
+/* Wall-clock time spent in each phase of ffdecoder_open, in microseconds. */
+typedef struct {
+    int64_t openInputUs;
+    int64_t findStreamInfoUs;
+    int64_t codecOpenUs;
+    int64_t probeDecodeUs;  /* 200-packet probe + seek back, or first-frame priming */
+    int64_t metadataUs;
+    int64_t totalUs;
+    int fastOpen;           /* 1 if the header-trusting path was taken */
+} FFDecoderOpenTimings;
+
 struct FFDecoderHandle {
     AVFormatContext *format;
     AVCodecContext *codec;
@@ -38,6 +81,7 @@ struct FFDecoderHandle {
     AVFrame *frame;
     uint8_t *interleavedBuffer;
     size_t interleavedSize;
+    uint64_t interleavedGrowths;
     size_t bufferedBytes;
     size_t bufferedOffset;
     int sampleRate;
@@ -49,6 +93,28 @@ struct FFDecoderHandle {
     enum AVSampleFormat sampleFormat;
     int eofReached;
     int isPassthrough;
+    int verifyOnFirstFrame;
+    int framePending;      /* handle->frame holds samples not yet handed out */
+    int pendingFrameOffset;
+    int pendingFrameEnd;   /* samples of handle->frame that may be handed out */
+    int64_t bufferedStartFrame;  /* stream position of interleavedBuffer[0], -1 if unknown */
+    int64_t lastSeekUs;
+    /* Gapless trimming. Bridge-internal positions stay untrimmed; decoded
+     * samples outside [gaplessInfo.leadingFrames, gaplessEnd) are dropped as
+     * they are received, and the public seek API is shifted by the leading
+     * frames. */
+    int gaplessActive;
+    FFDecoderGaplessInfo gaplessInfo;
+    int64_t gaplessEnd;        /* untrimmed end, -1 when the length is unknown */
+    int64_t gaplessNextFrame;  /* untrimmed position of the next decoded sample, -1 while seeking */
+    int64_t gaplessOriginTs;   /* timestamp of untrimmed sample 0 */
+    /* Seek table for long unindexed files, loaded from seekIndexDir on the
+     * first seek after the background build has finished. */
+    FFDecoderSeekIndex *seekIndex;
+    char *seekIndexDir;
+    char *seekIndexPath;
+    FFDecoderSeekIndexKey seekIndexKey;
+    FFDecoderOpenTimings openTimings;
     char codecName[128];
     char containerName[128];
     int64_t sourceBitRate;
@@ -78,6 +144,9 @@ struct FFDecoderHandle {
 typedef struct FFDecoderHandle FFDecoderHandle;
 
 FFDecoderHandle *ffdecoder_open(const char *path);
+/* `options` may be NULL, which behaves like ffdecoder_open(). */
+FFDecoderHandle *ffdecoder_open_with_options(const char *path, const FFDecoderOpenOptions *options);
+FFDecoderOpenTimings ffdecoder_get_open_timings(FFDecoderHandle *h);
 const char *ffdecoder_last_error(void);
 int ffdecoder_get_sample_rate(FFDecoderHandle *h);
 int ffdecoder_get_channels(FFDecoderHandle *h);
@@ -108,7 +177,33 @@ double ffdecoder_get_replaygain_album_peak(FFDecoderHandle *h);
 double ffdecoder_get_r128_track_gain(FFDecoderHandle *h);
 double ffdecoder_get_r128_album_gain(FFDecoderHandle *h);
 ssize_t ffdecoder_read(FFDecoderHandle *h, uint8_t *buffer, size_t maxBytes);
+/* Decodes straight into `spans`, interleaving from the codec frame without an
+ * intermediate copy. Writes whole frames only and returns the byte count
+ * (first span, then second), 0 at end of stream or <0 on error. */
+ssize_t ffdecoder_read_spans(FFDecoderHandle *h, const FFDecoderSpans *spans);
+/* Times the decode buffer had to grow after open. Zero in steady state when
+ * the codec frame-size hint was accurate. */
+uint64_t ffdecoder_get_buffer_growth_count(FFDecoderHandle *h);
+/* Accurate seek; see ffdecoder_seek_ms_with_mode. */
 int ffdecoder_seek_ms(FFDecoderHandle *h, int64_t);
+/* On success `landedFrame` (optional) receives the stream position, in
+ * samples, that the next read starts at. */
+int ffdecoder_seek_ms_with_mode(FFDecoderHandle *h, int64_t positionMs, FFDecSeekMode mode, int64_t *landedFrame);
+/* Wall time of the last seek, including the pre-roll decode. */
+int64_t ffdecoder_get_last_seek_us(FFDecoderHandle *h);
+/* Delay/padding being trimmed; all zero unless opened with `gapless` and the
+ * file carries the information. */
+FFDecoderGaplessInfo ffdecoder_get_gapless_info(FFDecoderHandle *h);
+/* 1 for long MP3/ADTS files and FLAC without a SEEKTABLE, whose own seeks
+ * bisect or estimate from the bit rate. */
+int ffdecoder_wants_seek_index(FFDecoderHandle *h);
+/* Demuxes `path` (no decoding) and caches its seek index in `cacheDir`.
+ * Slow for long files; call off the playback path. Returns 1 when built, 0
+ * when already cached, <0 on error. */
+int ffdecoder_build_seek_index(const char *path, const char *cacheDir);
+/* Makes later seeks on `h` use the index cached in `cacheDir` for its file,
+ * once ffdecoder_build_seek_index() has produced it. Returns 0 on success. */
+int ffdecoder_attach_seek_index(FFDecoderHandle *h, const char *cacheDir);
 void ffdecoder_close(FFDecoderHandle *h);
 
 #ifdef __cplusplus
@@ -0,0 +1,55 @@
+#ifndef FFMPEG_DITHER_H
+#define FFMPEG_DITHER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "FFmpegSampleKernels.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* TPDF dither and noise-shaped requantization for gain on integer output.
+ * Port of AudioEngineCore's Requantizer (see Dither.h there); keep the
+ * filters, the dither generator and its seeds in sync, so both engines
+ * produce the same samples. */
+typedef enum {
+    FFDEC_DITHER_OFF = 0,   /* round to nearest, as ffdecoder_scale_samples() */
+    FFDEC_DITHER_TPDF,      /* triangular dither, flat noise */
+    FFDEC_DITHER_HIGHPASS,  /* TPDF, second-order high-pass shaping */
+    FFDEC_DITHER_FWEIGHTED  /* TPDF, 9-tap F-weighted shaping; high-pass above 50 kHz */
+} FFDitherMode;
+
+#define FFDEC_DITHER_MAX_CHANNELS 8
+
+typedef struct FFRequantizer FFRequantizer;
+
+/* Starts unconfigured, in FFDEC_DITHER_FWEIGHTED. NULL on allocation failure. */
+FFRequantizer *ffdecoder_requantizer_create(void);
+void ffdecoder_requantizer_free(FFRequantizer *rq);
+
+/* While no render call is running. Returns 0, or -1 (and leaves it
+ * unconfigured) for float types and more than FFDEC_DITHER_MAX_CHANNELS
+ * channels. 32-bit integers are dithered at 24 bits. */
+int ffdecoder_requantizer_configure(FFRequantizer *rq, FFSampleType type,
+                                    uint32_t sample_rate, uint32_t channels);
+int ffdecoder_requantizer_is_configured(const FFRequantizer *rq);
+
+/* Any thread; takes effect with the next render call. */
+void ffdecoder_requantizer_set_mode(FFRequantizer *rq, FFDitherMode mode);
+
+/* Render side. samples *= gain for `frames` interleaved frames of the
+ * configured type, dithered. A gain of exactly 1 is a no-op. Never
+ * allocates or locks. */
+void ffdecoder_requantizer_apply_gain(FFRequantizer *rq, void *samples, size_t frames,
+                                      double gain);
+
+/* Clears the error feedback and reseeds the dither. */
+void ffdecoder_requantizer_reset(FFRequantizer *rq);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FFMPEG_DITHER_H */
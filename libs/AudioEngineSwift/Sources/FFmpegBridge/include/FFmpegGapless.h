@@ -0,0 +1,34 @@
+#ifndef FFMPEG_GAPLESS_H
+#define FFMPEG_GAPLESS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Encoder delay/padding in decoded samples. Mirrors AudioEngineCore's
+ * GaplessInfo (see Gapless.h there); keep the parsers in sync. */
+typedef struct {
+    uint64_t leadingFrames;   /* dropped at the start */
+    uint64_t trailingFrames;  /* dropped at the end */
+    uint64_t validFrames;     /* length after trimming, 0 if unknown */
+} FFDecoderGaplessInfo;
+
+/* Decoder delay of the reference MP3 decoder (and of FFmpeg's), added to the
+ * encoder delay stored in LAME headers. */
+#define FFDEC_MP3_DECODER_DELAY 529
+
+/* Parses an iTunes "iTunSMPB" comment. Returns 1 on success. */
+int ffdecoder_gapless_parse_itunsmpb(const char *value, FFDecoderGaplessInfo *info);
+/* Parses the Xing/Info + LAME tag of the first MPEG audio frame; `data` is
+ * the start of the file and a leading ID3v2 tag is skipped. Returns 1 on
+ * success. */
+int ffdecoder_gapless_parse_lame(const uint8_t *data, size_t size, FFDecoderGaplessInfo *info);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FFMPEG_GAPLESS_H */
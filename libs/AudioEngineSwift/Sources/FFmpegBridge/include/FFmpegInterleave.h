@@ -0,0 +1,43 @@
+#ifndef FFMPEG_INTERLEAVE_H
+#define FFMPEG_INTERLEAVE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    FFDEC_INTERLEAVE_ISA_SCALAR = 0,
+    FFDEC_INTERLEAVE_ISA_SSE2,
+    FFDEC_INTERLEAVE_ISA_AVX2,
+    FFDEC_INTERLEAVE_ISA_NEON
+} FFInterleaveISA;
+
+/* Interleaves `frames` samples from each of `channels` planes into `dst`,
+ * starting `srcFrameOffset` samples into every plane. `bytesPerSample` may be
+ * 1, 2, 3, 4 or 8 (any other size takes the reference path). Stereo, 5.1 and
+ * 7.1 at 16/32/64-bit use vector kernels picked at runtime for the CPU. */
+void ffdecoder_interleave(uint8_t *dst, const uint8_t *const *planes,
+                          size_t srcFrameOffset, size_t frames,
+                          int channels, size_t bytesPerSample);
+
+/* Straightforward per-sample copy. Reference for tests; output of
+ * ffdecoder_interleave() must match it bit for bit. */
+void ffdecoder_interleave_scalar(uint8_t *dst, const uint8_t *const *planes,
+                                 size_t srcFrameOffset, size_t frames,
+                                 int channels, size_t bytesPerSample);
+
+/* Instruction set currently used by ffdecoder_interleave(). */
+FFInterleaveISA ffdecoder_interleave_isa(void);
+
+/* Overrides runtime detection (testing/benchmarking). Returns 0 on success,
+ * -1 if the CPU or build does not support `isa`. */
+int ffdecoder_interleave_set_isa(FFInterleaveISA isa);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FFMPEG_INTERLEAVE_H */
@@ -0,0 +1,72 @@
+#ifndef FFMPEG_LEVEL_METER_H
+#define FFMPEG_LEVEL_METER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "FFmpegSampleKernels.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Per-channel peak with peak hold, RMS and true peak of the render output.
+ * Port of AudioEngineCore's LevelMeter (see LevelMeter.h there); keep the
+ * ballistics, the true-peak interpolator and the floor in sync, so both
+ * engines show the same readings. Readings are published through a
+ * sequence lock after every render call, so reading them never waits on
+ * or holds up the render thread. */
+
+#define FFMETER_MAX_CHANNELS 8
+#define FFMETER_FLOOR_DB (-120.0f)
+
+typedef struct {
+    /* Render calls since configure; unchanged means no new audio. */
+    uint64_t sequence;
+    uint32_t channels;
+    /* dBFS per channel, never below FFMETER_FLOOR_DB. */
+    float peak_db[FFMETER_MAX_CHANNELS];
+    float peak_hold_db[FFMETER_MAX_CHANNELS];
+    float rms_db[FFMETER_MAX_CHANNELS];
+    /* At the floor while true peak is off. */
+    float true_peak_db[FFMETER_MAX_CHANNELS];
+    float max_true_peak_db[FFMETER_MAX_CHANNELS];
+} FFLevelReading;
+
+typedef struct {
+    double hold_ms;             /* default 1500 */
+    double decay_db_per_second; /* default 20 */
+    double rms_window_ms;       /* default 300 */
+    int true_peak;              /* default on */
+} FFLevelMeterOptions;
+
+typedef struct FFLevelMeter FFLevelMeter;
+
+/* Starts unconfigured with the default options. NULL on allocation failure. */
+FFLevelMeter *fflevelmeter_create(void);
+void fflevelmeter_free(FFLevelMeter *meter);
+
+/* While no render call is running. Clears the readings. Returns 0, or -1
+ * (and leaves it unconfigured) for more than FFMETER_MAX_CHANNELS channels. */
+int fflevelmeter_configure(FFLevelMeter *meter, FFSampleType type, uint32_t sample_rate,
+                           uint32_t channels);
+
+/* Any thread; takes effect with the next render call. */
+void fflevelmeter_set_options(FFLevelMeter *meter, const FFLevelMeterOptions *options);
+
+/* Render side. Measures `frames` interleaved frames of the configured type.
+ * Never allocates or locks. */
+void fflevelmeter_process(FFLevelMeter *meter, const void *samples, size_t frames);
+
+/* Drops every level to the floor. Render side, or while no render call is
+ * running; nothing decays without render calls, so call it on stop. */
+void fflevelmeter_reset(FFLevelMeter *meter);
+
+/* Any thread, lock-free. */
+void fflevelmeter_read(const FFLevelMeter *meter, FFLevelReading *reading);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FFMPEG_LEVEL_METER_H */
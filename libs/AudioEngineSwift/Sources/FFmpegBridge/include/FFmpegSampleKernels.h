@@ -0,0 +1,45 @@
+#ifndef FFMPEG_SAMPLE_KERNELS_H
+#define FFMPEG_SAMPLE_KERNELS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "FFmpegInterleave.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* In-place gain for the render path. Port of AudioEngineCore's ScaleSamples()
+ * (see SampleKernels.h there); keep the rounding rules in sync: integers round
+ * to nearest, ties to even, and saturate. */
+typedef enum {
+    FFDEC_SAMPLE_S16 = 0,
+    FFDEC_SAMPLE_S24, /* packed, little-endian */
+    FFDEC_SAMPLE_S32,
+    FFDEC_SAMPLE_F32,
+    FFDEC_SAMPLE_F64
+} FFSampleType;
+
+/* samples *= gain for `count` samples. A gain of exactly 1 is a no-op.
+ * 16/32-bit integer and float buffers use vector kernels picked at runtime
+ * for the CPU; packed 24-bit is scalar. */
+void ffdecoder_scale_samples(FFSampleType type, void *samples, size_t count, double gain);
+
+/* Per-sample reference for tests; vector results must be within one integer
+ * step (or one float rounding) of it. */
+void ffdecoder_scale_samples_scalar(FFSampleType type, void *samples, size_t count,
+                                    double gain);
+
+/* Instruction set currently used by ffdecoder_scale_samples(). */
+FFInterleaveISA ffdecoder_sample_kernels_isa(void);
+
+/* Overrides runtime detection (testing/benchmarking). Returns 0 on success,
+ * -1 if the CPU or build does not support `isa`. */
+int ffdecoder_sample_kernels_set_isa(FFInterleaveISA isa);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FFMPEG_SAMPLE_KERNELS_H */
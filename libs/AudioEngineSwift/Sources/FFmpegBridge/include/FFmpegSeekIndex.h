@@ -0,0 +1,54 @@
+#ifndef FFMPEG_SEEK_INDEX_H
+#define FFMPEG_SEEK_INDEX_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Frame -> byte-offset table for files without a usable container seek index
+ * (VBR MP3, FLAC without SEEKTABLE, ADTS AAC), one point per interval. The
+ * on-disk format is shared with AudioEngineCore's SeekIndex (see
+ * SeekIndex.h there for the layout); keep the two in sync. */
+typedef struct FFDecoderSeekIndex FFDecoderSeekIndex;
+
+/* Identifies one version of a file; a new size or mtime misses the cache. */
+typedef struct {
+    const char *path;  /* UTF-8 */
+    uint64_t fileSize;
+    int64_t mtimeSeconds;
+} FFDecoderSeekIndexKey;
+
+#define FFDEC_SEEK_INDEX_NAME_SIZE 32
+
+FFDecoderSeekIndex *ffdecoder_seekindex_create(uint32_t sampleRate, uint32_t intervalFrames);
+void ffdecoder_seekindex_free(FFDecoderSeekIndex *index);
+/* Records a packet in stream order; only the first one per interval is kept.
+ * Returns <0 on allocation failure. */
+int ffdecoder_seekindex_add(FFDecoderSeekIndex *index, uint64_t frame, uint64_t byteOffset);
+/* Point with the greatest frame <= `frame`. Returns 1 when found, 0 if the
+ * index is empty or starts later. */
+int ffdecoder_seekindex_lookup(const FFDecoderSeekIndex *index, uint64_t frame,
+                               uint64_t *pointFrame, uint64_t *byteOffset);
+size_t ffdecoder_seekindex_count(const FFDecoderSeekIndex *index);
+uint32_t ffdecoder_seekindex_sample_rate(const FFDecoderSeekIndex *index);
+
+/* Fills `key` from stat(2); `key->path` aliases `path`. Returns 0 on success. */
+int ffdecoder_seekindex_key_for_path(const char *path, FFDecoderSeekIndexKey *key);
+/* "<16 hex digits>.seekidx" for `key`, into a FFDEC_SEEK_INDEX_NAME_SIZE buffer. */
+void ffdecoder_seekindex_cache_name(const FFDecoderSeekIndexKey *key, char *name);
+/* Writes the index to `cacheDir` (which must exist) via a temporary file and
+ * rename. Returns 0 on success. */
+int ffdecoder_seekindex_save(const FFDecoderSeekIndex *index, const char *cacheDir,
+                             const FFDecoderSeekIndexKey *key);
+/* Cached index for `key`, or NULL if missing, corrupt or for another version
+ * of the file. */
+FFDecoderSeekIndex *ffdecoder_seekindex_load(const char *cacheDir, const FFDecoderSeekIndexKey *key);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FFMPEG_SEEK_INDEX_H */
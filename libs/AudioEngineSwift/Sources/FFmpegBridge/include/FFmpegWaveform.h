@@ -0,0 +1,53 @@
+#ifndef FFMPEG_WAVEFORM_H
+#define FFMPEG_WAVEFORM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Seekbar waveform of one file: min/max/RMS points at several zoom levels,
+ * built once off the playback path and served from a memory-mapped cache
+ * file. The on-disk format is shared with AudioEngineCore's Waveform (see
+ * Waveform.h there for the layout); keep the two in sync. */
+typedef struct FFWaveform FFWaveform;
+
+/* One point, in 1/32767 of full scale over the first two channels. */
+typedef struct {
+    int16_t min;
+    int16_t max;
+    int16_t rms;
+} FFWaveformPoint;
+
+typedef struct {
+    uint32_t framesPerPoint;
+    size_t count;
+    const FFWaveformPoint *points;  /* valid until ffwaveform_close() */
+} FFWaveformLevel;
+
+#define FFWAVEFORM_MAX_LEVELS 8
+
+/* Decodes `path` and caches its waveform in `cacheDir` (which must exist).
+ * Decodes the whole file; call off the playback path. Returns 1 when
+ * built, 0 when already cached, <0 on error. */
+int ffwaveform_build(const char *path, const char *cacheDir);
+/* Cached waveform for the current version of `path`, or NULL if it is
+ * missing, corrupt or stale. Maps the file; no decoding. */
+FFWaveform *ffwaveform_map(const char *path, const char *cacheDir);
+uint32_t ffwaveform_sample_rate(const FFWaveform *waveform);
+uint32_t ffwaveform_channels(const FFWaveform *waveform);
+uint64_t ffwaveform_frames(const FFWaveform *waveform);
+/* Level 0 is the finest; each next one merges four points. */
+size_t ffwaveform_level_count(const FFWaveform *waveform);
+FFWaveformLevel ffwaveform_level(const FFWaveform *waveform, size_t level);
+/* Coarsest level with at least `points` points, else the finest. */
+FFWaveformLevel ffwaveform_level_for(const FFWaveform *waveform, size_t points);
+void ffwaveform_close(FFWaveform *waveform);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FFMPEG_WAVEFORM_H */
@@ -1,5 +1,6 @@
 import Foundation
 import Testing
+import FFmpegBridge
 @testable import AudioEngineSwift
 
 @Test
@@ -39,6 +40,37 @@ func ringBufferMaintainsFIFOAcrossWraps() throws {
     #expect(finalDrain == expected)
 }
 
+@Test
+func ringBufferWritableRegionsSplitAtWrap() throws {
+    let ring = LockFreeRingBuffer(capacity: 1024)
+
+    var drain = [UInt8](repeating: 0, count: 1024)
+    let prefix = [UInt8](repeating: 7, count: 1000)
+    prefix.withUnsafeBufferPointer { _ = ring.write(from: $0.baseAddress!, count: $0.count) }
+    drain.withUnsafeMutableBufferPointer { _ = ring.read(into: $0.baseAddress!, count: 1000) }
+
+    // Head sits 24 bytes before the end: a 100-byte request must wrap.
+    let regions = ring.writableRegions(maxBytes: 100)
+    #expect(regions.first.count == 24)
+    #expect(regions.second.count == 76)
+    for i in 0..<regions.count {
+        let value = UInt8(i)
+        if i < regions.first.count {
+            regions.first[i] = value
+        } else {
+            regions.second[i - regions.first.count] = value
+        }
+    }
+    #expect(ring.availableBytes == 0)
+    ring.commitWrite(regions.count)
+    #expect(ring.availableBytes == 100)
+
+    var out = [UInt8](repeating: 0, count: 100)
+    out.withUnsafeMutableBufferPointer { _ = ring.read(into: $0.baseAddress!, count: $0.count) }
+    #expect(out == (0..<100).map { UInt8($0) })
+    #expect(ring.writableRegions().count == 1024)
+}
+
 @Test
 func pcmPlayerTracksFramesAndUnderflows() throws {
     let player = PCMPlayer(bufferSize: 1024)
@@ -126,3 +158,204 @@ func trackMetadataProducesReadableSummary() throws {
     #expect(meta.displayTitle == "My Song")
     #expect(meta.replayGain.hasAnyValue)
 }
+
+@Test
+func interleaveKernelsMatchScalarReference() throws {
+    let isas: [FFInterleaveISA] = [
+        FFDEC_INTERLEAVE_ISA_SCALAR,
+        FFDEC_INTERLEAVE_ISA_SSE2,
+        FFDEC_INTERLEAVE_ISA_AVX2,
+        FFDEC_INTERLEAVE_ISA_NEON
+    ]
+    let detected = ffdecoder_interleave_isa()
+    defer { _ = ffdecoder_interleave_set_isa(detected) }
+
+    var generator = SystemRandomNumberGenerator()
+    for isa in isas where ffdecoder_interleave_set_isa(isa) == 0 {
+        for channels in [1, 2, 3, 6, 8] {
+            for bytesPerSample in [2, 3, 4, 8] {
+                for (frames, offset) in [(1, 0), (7, 3), (33, 1), (1031, 5)] {
+                    let planeBytes = (frames + offset) * bytesPerSample
+                    let planes: [[UInt8]] = (0..<channels).map { _ in
+                        (0..<planeBytes).map { _ in UInt8.random(in: 0...255, using: &generator) }
+                    }
+                    let outBytes = frames * channels * bytesPerSample
+                    var vector = [UInt8](repeating: 0xAA, count: outBytes)
+                    var scalar = [UInt8](repeating: 0x55, count: outBytes)
+
+                    let pointers = planes.map { plane -> UnsafeMutablePointer<UInt8> in
+                        let copy = UnsafeMutablePointer<UInt8>.allocate(capacity: plane.count)
+                        copy.initialize(from: plane, count: plane.count)
+                        return copy
+                    }
+                    defer { pointers.forEach { $0.deallocate() } }
+                    let planeTable = pointers.map { Optional(UnsafePointer($0)) }
+
+                    planeTable.withUnsafeBufferPointer { table in
+                        vector.withUnsafeMutableBufferPointer { out in
+                            ffdecoder_interleave(out.baseAddress, table.baseAddress, offset,
+                                                 frames, Int32(channels), bytesPerSample)
+                        }
+                        scalar.withUnsafeMutableBufferPointer { out in
+                            ffdecoder_interleave_scalar(out.baseAddress, table.baseAddress, offset,
+                                                        frames, Int32(channels), bytesPerSample)
+                        }
+                    }
+                    #expect(vector == scalar,
+                            "isa \(isa.rawValue) channels \(channels) bps \(bytesPerSample) frames \(frames)")
+                }
+            }
+        }
+    }
+}
+
+@Test
+func sampleGainKernelsMatchScalarReference() throws {
+    let isas: [FFInterleaveISA] = [
+        FFDEC_INTERLEAVE_ISA_SCALAR,
+        FFDEC_INTERLEAVE_ISA_SSE2,
+        FFDEC_INTERLEAVE_ISA_AVX2,
+        FFDEC_INTERLEAVE_ISA_NEON
+    ]
+    let types: [(FFSampleType, Int)] = [
+        (FFDEC_SAMPLE_S16, 2), (FFDEC_SAMPLE_S24, 3), (FFDEC_SAMPLE_S32, 4)
+    ]
+    let detected = ffdecoder_sample_kernels_isa()
+    defer { _ = ffdecoder_sample_kernels_set_isa(detected) }
+
+    var generator = SystemRandomNumberGenerator()
+    for isa in isas where ffdecoder_sample_kernels_set_isa(isa) == 0 {
+        for (type, bytesPerSample) in types {
+            for gain in [0.5, 0.7071, 1.9] {
+                let count = 1031
+                let input = (0..<count * bytesPerSample).map { _ in
+                    UInt8.random(in: 0...255, using: &generator)
+                }
+                var vector = input
+                var scalar = input
+                vector.withUnsafeMutableBytes { ffdecoder_scale_samples(type, $0.baseAddress, count, gain) }
+                scalar.withUnsafeMutableBytes {
+                    ffdecoder_scale_samples_scalar(type, $0.baseAddress, count, gain)
+                }
+                // 16-bit vector gain runs in float and may land one step off.
+                if type == FFDEC_SAMPLE_S16 {
+                    let a = vector.withUnsafeBytes { Array($0.bindMemory(to: Int16.self)) }
+                    let b = scalar.withUnsafeBytes { Array($0.bindMemory(to: Int16.self)) }
+                    #expect(zip(a, b).allSatisfy { abs(Int($0) - Int($1)) <= 1 },
+                            "isa \(isa.rawValue) s16 gain \(gain)")
+                } else {
+                    #expect(vector == scalar, "isa \(isa.rawValue) type \(type.rawValue) gain \(gain)")
+                }
+            }
+        }
+
+        var floats: [Float] = (0..<1031).map { sin(Float($0) * 0.1) }
+        var expected = floats
+        floats.withUnsafeMutableBytes { ffdecoder_scale_samples(FFDEC_SAMPLE_F32, $0.baseAddress, 1031, 0.25) }
+        expected.withUnsafeMutableBytes {
+            ffdecoder_scale_samples_scalar(FFDEC_SAMPLE_F32, $0.baseAddress, 1031, 0.25)
+        }
+        #expect(floats == expected, "isa \(isa.rawValue) f32")
+    }
+}
+
+@Test
+func requantizerIsBitPerfectAtUnityAndMatchesAcrossIsas() throws {
+    let isas: [FFInterleaveISA] = [
+        FFDEC_INTERLEAVE_ISA_SSE2,
+        FFDEC_INTERLEAVE_ISA_AVX2,
+        FFDEC_INTERLEAVE_ISA_NEON
+    ]
+    let modes: [FFDitherMode] = [FFDEC_DITHER_TPDF, FFDEC_DITHER_HIGHPASS, FFDEC_DITHER_FWEIGHTED]
+    let detected = ffdecoder_sample_kernels_isa()
+    defer { _ = ffdecoder_sample_kernels_set_isa(detected) }
+
+    let frames = 4800
+    for channels in [1, 2, 3, 6, 8] {
+        var seed: UInt32 = UInt32(channels)
+        let input: [Int16] = (0..<frames * channels).map { _ in
+            seed = seed &* 1664525 &+ 1013904223
+            return Int16(truncatingIfNeeded: Int32(seed >> 16) - 32768) / 2
+        }
+        for mode in modes {
+            let run = { () -> [Int16] in
+                let rq = ffdecoder_requantizer_create()
+                defer { ffdecoder_requantizer_free(rq) }
+                ffdecoder_requantizer_set_mode(rq, mode)
+                #expect(ffdecoder_requantizer_configure(rq, FFDEC_SAMPLE_S16, 44_100,
+                                                        UInt32(channels)) == 0)
+                var samples = input
+                samples.withUnsafeMutableBufferPointer { buffer in
+                    ffdecoder_requantizer_apply_gain(rq, buffer.baseAddress, frames, 1.0)
+                }
+                #expect(samples == input, "unity gain, \(channels) channels")
+                samples.withUnsafeMutableBufferPointer { buffer in
+                    var at = 0
+                    while at < frames {
+                        let n = min(333, frames - at)
+                        ffdecoder_requantizer_apply_gain(rq, buffer.baseAddress! + at * channels,
+                                                         n, 0.7)
+                        at += n
+                    }
+                }
+                return samples
+            }
+            _ = ffdecoder_sample_kernels_set_isa(FFDEC_INTERLEAVE_ISA_SCALAR)
+            let reference = run()
+            // TPDF keeps every sample within its +-1.5 step reach of the exact product.
+            if mode == FFDEC_DITHER_TPDF {
+                #expect(zip(reference, input).allSatisfy { abs(Double($0) - Double($1) * 0.7) <= 2 })
+            }
+            for isa in isas where ffdecoder_sample_kernels_set_isa(isa) == 0 {
+                #expect(run() == reference,
+                        "isa \(isa.rawValue) mode \(mode.rawValue) channels \(channels)")
+            }
+        }
+    }
+}
+
+@Test
+func levelMeterReadsSineLevelsOnEveryIsa() throws {
+    let isas: [FFInterleaveISA] = [
+        FFDEC_INTERLEAVE_ISA_SCALAR,
+        FFDEC_INTERLEAVE_ISA_SSE2,
+        FFDEC_INTERLEAVE_ISA_AVX2,
+        FFDEC_INTERLEAVE_ISA_NEON
+    ]
+    let detected = ffdecoder_sample_kernels_isa()
+    defer { _ = ffdecoder_sample_kernels_set_isa(detected) }
+
+    // Two seconds at -6 and -20 dBFS, long enough for the RMS window to settle.
+    let frames = 96_000
+    var samples = [Float](repeating: 0, count: frames * 3)
+    for f in 0..<frames {
+        let x = Float(sin(2.0 * Double.pi * 997.0 * Double(f) / 48_000.0))
+        samples[f * 3] = 0.5 * x
+        samples[f * 3 + 1] = 0.1 * x
+    }
+    for isa in isas where ffdecoder_sample_kernels_set_isa(isa) == 0 {
+        let meter = fflevelmeter_create()
+        defer { fflevelmeter_free(meter) }
+        #expect(fflevelmeter_configure(meter, FFDEC_SAMPLE_F32, 48_000, 3) == 0)
+        samples.withUnsafeBufferPointer { buffer in
+            for at in stride(from: 0, to: frames, by: 480) {
+                fflevelmeter_process(meter, buffer.baseAddress! + at * 3, 480)
+            }
+        }
+        var raw = FFLevelReading()
+        fflevelmeter_read(meter, &raw)
+        let reading = LevelMeterReading(raw)
+        #expect(reading.sequence == 200)
+        #expect(reading.peakDb.count == 3)
+        #expect(abs(reading.peakDb[0] + 6.02) < 0.05, "isa \(isa.rawValue)")
+        #expect(abs(reading.rmsDb[0] + 9.03) < 0.05, "isa \(isa.rawValue)")
+        #expect(abs(reading.rmsDb[1] + 23.01) < 0.05, "isa \(isa.rawValue)")
+        #expect(abs(reading.truePeakDb[1] + 20.0) < 0.05, "isa \(isa.rawValue)")
+        #expect(reading.peakDb[2] == LevelMeterReading.floorDb)
+
+        fflevelmeter_reset(meter)
+        fflevelmeter_read(meter, &raw)
+        #expect(LevelMeterReading(raw).peakHoldDb[0] == LevelMeterReading.floorDb)
+    }
+    #expect(fflevelmeter_configure(nil, FFDEC_SAMPLE_F32, 48_000, 2) == -1)
+}
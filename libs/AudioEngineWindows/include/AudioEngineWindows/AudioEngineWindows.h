@@ -1,9 +1,12 @@
 // Lightweight Windows audio engine with WASAPI shared/exclusive playback.
 #pragma once
 
+#include <atomic>
 #include <functional>
+#include <memory>
 #include <mutex>
 #include <string>
+#include <utility>
 #include <vector>
 #include <thread>
 
@@ -13,18 +16,28 @@
 #include <mfidl.h>
 #include <wrl/client.h>
 
-namespace audioengine {
-
-struct PcmFormat {
-  uint32_t sampleRate = 0;
-  uint32_t channels = 0;
-  uint32_t bitsPerSample = 0;
-  bool isFloat = false;
+#include "AudioEngineCore/AudioFeatures.h"
+#include "AudioEngineCore/Crossfader.h"
+#include "AudioEngineCore/Crossfeed.h"
+#include "AudioEngineCore/FeatureScanner.h"
+#include "AudioEngineCore/LevelMeter.h"
+#include "AudioEngineCore/LoudnessScanner.h"
+#include "AudioEngineCore/ParametricEq.h"
+#include "AudioEngineCore/Convolver.h"
+#include "AudioEngineCore/PcmFormat.h"
+#include "AudioEngineCore/PcmSource.h"
+#include "AudioEngineCore/ReplayGain.h"
+#include "AudioEngineCore/Resampler.h"
+#include "AudioEngineCore/SeekIndexer.h"
+#include "AudioEngineCore/SeqLock.h"
+#include "AudioEngineCore/Spectrum.h"
+#include "AudioEngineCore/TimeStretch.h"
+#include "AudioEngineCore/TrackPreloader.h"
+#include "AudioEngineCore/TruePeakLimiter.h"
+#include "AudioEngineCore/Waveform.h"
+#include "AudioEngineCore/WaveformScanner.h"
 
-  uint32_t BytesPerFrame() const {
-    return (bitsPerSample / 8) * channels;
-  }
-};
+namespace audioengine {
 
 struct PcmStatus {
   double sampleRate = 0;
@@ -33,6 +46,18 @@ struct PcmStatus {
   uint32_t bytesPerFrame = 0;
   int renderedFrames = 0;
   int underflows = 0;
+  // Normalization limiter: whether it is in the render path, its CPU cost
+  // as a fraction of real time, and its deepest gain reduction.
+  bool limiterActive = false;
+  double limiterCpuLoad = 0;
+  float limiterMaxReductionDb = 0;
+  // Headphone crossfeed is on and in the render path.
+  bool crossfeedActive = false;
+  // Playback rate in effect; 1 in bit-perfect mode.
+  double playbackRate = 1.0;
+  // Per-channel peak, peak hold, RMS and true peak of what the device gets,
+  // after the EQ, crossfeed and limiter; at the floor while stopped.
+  LevelMeterReading levels;
 };
 
 struct TrackTags {
@@ -76,26 +101,193 @@ class AudioEngineWindows {
   HRESULT SeekMs(uint64_t positionMs);
   HRESULT SetVolume(double value);
   double GetVolume();
+  // Loudness normalization from ReplayGain/R128 tags, resolved when a track
+  // is opened and applied as the render thread copies it out. While it is
+  // on, a look-ahead true-peak limiter keeps the output under -1 dBTP; its
+  // cost shows up in Status(). Not applied in bit-perfect mode. Changes the
+  // current track's gain at once; a queued track keeps the gain it was
+  // queued with.
+  void SetNormalization(NormalizationMode mode, double preampDb);
+  // Measures EBU R128 loudness, range and true peak of library files on a
+  // below-normal-priority worker pool. Each track is a (path, album) pair;
+  // tracks with the same non-empty album id get an album value. Results are
+  // cached next to the seek indexes, so a scan interrupted by a restart
+  // resumes where it stopped. Untagged tracks then normalize from their
+  // measurement as if they carried ReplayGain 2.0 tags.
+  void ScanLoudness(const std::vector<std::pair<std::wstring, std::wstring>>& tracks);
+  void CancelLoudnessScan();
+  bool TrackLoudnessFor(const std::wstring& path, TrackLoudness* result) const;
+  // Progress and throughput (tracks per second per core) of the scan.
+  LoudnessScanner::Stats LoudnessScanStats() const;
+  // Builds seekbar waveforms (min/max/RMS at several zoom levels) for
+  // library files on a below-normal-priority worker pool, decoding at the
+  // source rate and at most two channels. Cached next to the seek indexes;
+  // files already cached are skipped.
+  void GenerateWaveforms(const std::vector<std::wstring>& paths);
+  void CancelWaveforms();
+  // Cached waveform of `path`, mapped from disk without decoding; null until
+  // it has been generated. Any thread; does not take the engine lock.
+  std::shared_ptr<const Waveform> WaveformFor(const std::wstring& path) const;
+  WaveformScanner::Stats WaveformStats() const;
+  // Analyses tempo, key, energy, danceability and spectral shape of library
+  // files for the mood engine on a below-normal-priority worker pool,
+  // decoding at the source rate. Cached next to the seek indexes; files
+  // already cached are read back instead of decoded.
+  void ScanFeatures(const std::vector<std::wstring>& paths);
+  void CancelFeatureScan();
+  // From this session's scan or the cache; never decodes. Any thread.
+  bool TrackFeaturesFor(const std::wstring& path, TrackFeatures* result) const;
+  // Progress and throughput (tracks per second per core) of the scan.
+  FeatureScanner::Stats FeatureScanStats() const;
 
   void SetBitPerfect(bool enabled);
   void SetAutoSampleRateSwitch(bool enabled);
+  // Outside bit-perfect mode tracks are converted to the shared-mode mix
+  // rate on the decode thread, so the client always opens at the mixer's
+  // rate and tracks of different rates queue gaplessly. Applies from the
+  // next LoadFile() or QueueNext(); medium by default.
+  void SetResampleQuality(ResamplerQuality quality);
+  // Loads a room or headphone correction filter (a WAV/FLAC impulse
+  // response, one channel or one per output channel, any rate) and
+  // convolves every track with it on the decode thread. Not applied in
+  // bit-perfect mode. An empty path removes it. Applies from the next
+  // LoadFile() or QueueNext().
+  HRESULT SetConvolutionFilter(const std::wstring& path);
+  // Parametric or graphic EQ (see GraphicEqBands()) on the shared-mode
+  // float output, ahead of the limiter; not applied in bit-perfect mode.
+  // Safe to call from the UI thread while dragging a slider: the render
+  // thread picks the new bands up and glides to them. An empty list
+  // bypasses it.
+  HRESULT SetEqualizer(const std::vector<EqBand>& bands);
+  // Headphone crossfeed on stereo shared-mode float output, after the EQ
+  // and ahead of the limiter; not applied in bit-perfect mode. kHeadphones,
+  // the default, turns it on while the output endpoint's form factor is
+  // headphones or a headset. It is read when an endpoint is opened and again
+  // when the default endpoint changes, which takes effect mid-track; the
+  // stream moves to the new endpoint at the next LoadFile().
+  // Switches and level changes glide in without a restart.
+  void SetCrossfeed(CrossfeedMode mode, const CrossfeedLevel& level = kCrossfeedDefault);
+  // Overrides the endpoint's form factor for kHeadphones, e.g. with
+  // MoodSignals::headphonesConnected; holds until the default endpoint
+  // changes or another endpoint is opened.
+  void SetHeadphonesConnected(bool connected);
+  // Playback speed from 0.5x to 3x without a pitch change, on shared-mode
+  // float output; bit-perfect output always plays at 1x. Safe to call from
+  // any thread; applied within one hop (12 ms) of rendering, and
+  // CurrentPositionMs() keeps tracking the track position.
+  void SetPlaybackRate(double rate);
+  // Spectrum for visualizers, taken from the output after the EQ,
+  // crossfeed and limiter (bit-perfect output included). Off by default;
+  // when off the render thread does not touch it. None of these take the
+  // engine lock, so a UI polling LatestSpectrum() at frame rate never waits
+  // on the render thread. LatestSpectrum() is for one UI thread at a time,
+  // and is false when nothing new was published.
+  void SetSpectrumEnabled(bool enabled);
+  void SetSpectrumOptions(const SpectrumAnalyzer::Options& options);
+  bool LatestSpectrum(SpectrumFrame* frame);
+  std::vector<double> SpectrumBandCentersHz() const;
+  // Ballistics of the meters in Status().levels. Any thread; takes effect
+  // with the next render pass.
+  void SetMeterOptions(const LevelMeter::Options& options);
+  // Accurate (default) seeks decode past codec pre-roll to the exact frame;
+  // fast seeks resume from the preceding sync point.
+  void SetAccurateSeek(bool enabled);
+  // Gapless mode trims encoder delay/padding from newly opened tracks and
+  // allows QueueNext(). Turning it off drops a queued track.
+  void SetGapless(bool enabled);
+  // Equal-power crossfade length between queued tracks; 0 turns it off.
+  // Takes effect for the next QueueNext().
+  void SetCrossfadeMs(uint32_t ms);
+  // Dither and noise shaping wherever gain is applied to integer samples:
+  // in bit-perfect mode that is the crossfade, since volume goes to the
+  // session and normalization is off. F-weighted by default; kOff rounds to
+  // the nearest step as before.
+  void SetDither(DitherMode mode);
+  // Opens `path` now and splices it onto the end of the current track with
+  // no gap, or fades it in over the end of the current track when a
+  // crossfade is set. Fails (and the caller should LoadFile() at the end
+  // instead) when neither gapless mode nor a crossfade is on, or the PCM
+  // formats differ. The open runs on the calling thread without blocking
+  // rendering.
+  HRESULT QueueNext(const std::wstring& path);
+  // Opens and pre-decodes `path` in the background so a following LoadFile()
+  // or QueueNext() of the same path skips the open and probe. The output
+  // client is kept across LoadFile() when the PCM format does not change.
+  HRESULT PreloadNext(const std::wstring& path);
+  // Wall time of the last SeekMs(), including refilling the decode buffer.
+  uint64_t LastSeekLatencyUs() const;
   bool IsPlaying() const;
   uint64_t DurationMs() const;
   uint64_t CurrentPositionMs() const;
 
   TrackMetadata Metadata() const;
+  // Does not take the engine lock: the render thread publishes the status
+  // after every pass, so polling it at frame rate never waits on rendering.
   PcmStatus Status() const;
 
   void SetOnPlaybackEnded(std::function<void()> callback);
+  // Called on the render thread when a queued track becomes audible.
+  void SetOnTrackChanged(std::function<void()> callback);
 
  private:
   HRESULT EnsureDevice();
   HRESULT EnsureAudioClient();
+  void ReleaseAudioClient();
   HRESULT PrimeAndStart();
   void RenderLoop();
   void StopRenderThread();
   void ResetPlaybackState();
-  HRESULT DecodeFile(const std::wstring& path);
+  // Hands status_ and the render path's state to Status(). Caller holds
+  // mutex_, which also keeps this the only writer.
+  void PublishStatus();
+
+  // A decoded track ready to start or splice, with its metadata.
+  struct PreparedTrack {
+    std::wstring path;
+    std::unique_ptr<PcmSource> source;
+    // What `source` produces and the client is opened with; metadata.pcm
+    // describes the file.
+    PcmFormat outputFormat;
+    TrackMetadata metadata;
+    uint64_t durationMs = 0;
+    uint64_t totalFrames = 0;
+    ReplayGainTags replayGain;
+  };
+
+  HRESULT OpenStream(const std::wstring& path);
+  // Opens and probes `path`. Only reads the settings passed in and the
+  // thread-safe seekIndexer_ and loudnessScanner_, so the preloader thread
+  // can call it too. Float output is resampled to `outputRate` unless it
+  // is 0, then convolved with `convolution` if set.
+  HRESULT PrepareTrack(const std::wstring& path, bool bitPerfect, bool gapless,
+                       uint32_t outputRate, ResamplerQuality quality,
+                       std::shared_ptr<const ConvolutionFilter> convolution,
+                       PreparedTrack* track);
+  // Decodes the head of a prepared track into memory. No lock needed.
+  void Prebuffer(PreparedTrack* track);
+  // Rate PrepareTrack() should convert to: the shared-mode mix rate, or 0
+  // in bit-perfect mode or when the device cannot be queried.
+  uint32_t ResampleRate();
+  void ApplyTrack(const PreparedTrack& track);
+  // Linear gain for a track under the current normalization settings.
+  float TrackGain(const ReplayGainTags& tags) const;
+  bool LimiterActive() const;
+  bool EqualizerActive() const;
+  bool CrossfeedActive() const;
+  bool StretcherActive() const;
+  // Fills `data` from streamer_, through stretcher_ when it is active.
+  // Caller holds mutex_.
+  size_t ReadOutput(BYTE* data, size_t frames);
+  // Applies crossfeedMode_ and headphones_ to crossfeed_. Caller holds
+  // mutex_.
+  void UpdateCrossfeed();
+  // Applies a form factor posted by the endpoint listener. Render thread,
+  // under mutex_.
+  void CollectHeadphoneChange();
+  // Switches bookkeeping to the queued track once the render side has
+  // reached it. Returns true on the switch.
+  bool CollectTrackChange();
+  void ClearQueuedTrack();
 
   mutable std::mutex mutex_;
 
@@ -103,19 +295,84 @@ class AudioEngineWindows {
   bool isPlaying_ = false;
   bool bitPerfect_ = false;
   bool autoSampleRateSwitching_ = true;
+  bool accurateSeek_ = true;
+  bool gapless_ = false;
+  ResamplerQuality resampleQuality_ = ResamplerQuality::kMedium;
+  // From IAudioClient::GetMixFormat() on first use.
+  uint32_t mixSampleRate_ = 0;
+  // Transformed for the mix rate; PrepareTrack() redoes it for tracks at
+  // other rates. Null when no filter is loaded.
+  std::shared_ptr<const ConvolutionFilter> convolution_;
   double volume_ = 1.0;
+  NormalizationMode normalization_ = NormalizationMode::kOff;
+  double preampDb_ = 0.0;
+  CrossfeedMode crossfeedMode_ = CrossfeedMode::kHeadphones;
+  // The output is headphones or a headset, from the endpoint or the app.
+  bool headphones_ = false;
 
   std::wstring currentPath_;
   uint64_t durationMs_ = 0;
   uint64_t totalFrames_ = 0;
-  uint64_t currentFrame_ = 0;
 
   PcmFormat pcmFormat_{};
   TrackMetadata metadata_{};
   PcmStatus status_{};
+  ReplayGainTags currentReplayGain_;
+  // Configured with the audio client; run on the render thread under
+  // mutex_ like the rest of the render path. The equalizer's bands are set
+  // without mutex_.
+  ParametricEq equalizer_;
+  Crossfeed crossfeed_;
+  TruePeakLimiter limiter_;
+  // Between streamer_ and the rest of the render path; the rate is set
+  // without mutex_.
+  TimeStretcher stretcher_;
+  // Tapped at the end of the render path; configured with the audio client,
+  // everything else is done without mutex_.
+  SpectrumAnalyzer spectrum_;
+  // Measures the same output as spectrum_. Configured and reset under
+  // mutex_ while the render thread is stopped; read without it.
+  LevelMeter meter_;
+
+  // What Status() reads instead of status_, with the parts of the *Active()
+  // checks that are not atomics themselves.
+  struct PublishedStatus {
+    PcmStatus status;
+    bool stretcherActive;
+    uint32_t limiterSampleRate;
+  };
+  SeqLock<PublishedStatus> publishedStatus_;
+
+  // Builds seek tables for long unindexed files in the background, cached
+  // under %TEMP%. Declared before streamer_ so sources never outlive it.
+  std::unique_ptr<SeekIndexer> seekIndexer_;
+  // Library loudness scan; shares the seek index cache directory. Used by
+  // PrepareTrack() for untagged files, so also declared before preloader_.
+  std::unique_ptr<LoudnessScanner> loudnessScanner_;
+  // Seekbar waveforms; shares the seek index cache directory.
+  std::unique_ptr<WaveformScanner> waveformScanner_;
+  // Mood features; shares the seek index cache directory.
+  std::unique_ptr<FeatureScanner> featureScanner_;
 
-  std::vector<uint8_t> pcmBuffer_;
+  // Decoded PCM is produced on a background thread into a bounded ring;
+  // the render thread only copies out of it, or mixes two rings during a
+  // crossfade.
+  Crossfader streamer_;
+  // Track handed to streamer_.QueueNext(); its source is owned by streamer_.
+  // For a crossfade it becomes current when the fade starts.
+  PreparedTrack queuedTrack_;
+  bool hasQueuedTrack_ = false;
+  // Declared after seekIndexer_ so its thread is joined before the indexer
+  // its jobs use goes away.
+  TrackPreloader<PreparedTrack, std::wstring> preloader_;
 
+  Microsoft::WRL::ComPtr<IMMDeviceEnumerator> enumerator_;
+  // Sets defaultDeviceChanged_ and defaultHeadphones_; registered on
+  // enumerator_ until destruction.
+  Microsoft::WRL::ComPtr<IMMNotificationClient> deviceListener_;
+  std::atomic<bool> defaultDeviceChanged_{false};
+  // Headphone state of a new default endpoint, -1 once collected.
+  std::atomic<int> defaultHeadphones_{-1};
   Microsoft::WRL::ComPtr<IMMDevice> device_;
   Microsoft::WRL::ComPtr<IAudioClient> audioClient_;
   Microsoft::WRL::ComPtr<IAudioRenderClient> renderClient_;
@@ -126,6 +383,7 @@ class AudioEngineWindows {
   HANDLE stopEvent_ = nullptr;
   std::thread renderThread_;
   std::function<void()> onPlaybackEnded_;
+  std::function<void()> onTrackChanged_;
 };
 
 }  // namespace audioengine
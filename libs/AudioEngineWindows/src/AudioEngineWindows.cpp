@@ -1,26 +1,33 @@
 #include "AudioEngineWindows/AudioEngineWindows.h"
 
 #include <avrt.h>
+#include <propidl.h>
+#include <sys/stat.h>
 #include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <filesystem>
 #include <cstring>
+#include <memory>
 #include <utility>
 #include <string>
 
+#include "AudioEngineCore/PrebufferedSource.h"
+#include "FFmpegPcmSource.h"
+
 extern "C" {
-#include <libavformat/avformat.h>
-#include <libavcodec/avcodec.h>
 #include <libavutil/avutil.h>
-#include <libavutil/channel_layout.h>
-#include <libavutil/samplefmt.h>
-#include <libswresample/swresample.h>
 }
 
 namespace audioengine {
 
 namespace {
 
+// Decoded ahead by PreloadNext() and QueueNext(): about one decode ring's
+// worth, so the streamer runs from memory for the first seconds of the next
+// track.
+constexpr double kPreloadSeconds = 2.0;
+
 std::wstring ExtensionLower(const std::wstring& path) {
   std::wstring ext = std::filesystem::path(path).extension().wstring();
   std::transform(ext.begin(), ext.end(), ext.begin(), ::towlower);
@@ -54,25 +61,80 @@ void BuildWaveFormat(const PcmFormat& pcm, WAVEFORMATEXTENSIBLE* wfex) {
       pcm.channels == 1 ? SPEAKER_FRONT_CENTER : SPEAKER_FRONT_LEFT | SPEAKER_FRONT_RIGHT;
 }
 
-uint64_t HnsToMs(REFERENCE_TIME value) {
-  return static_cast<uint64_t>(value / 10'000);
+// PKEY_AudioEndpoint_FormFactor, defined here so no SDK lib symbol is needed.
+constexpr PROPERTYKEY kEndpointFormFactor = {
+    {0x1da5d803, 0xd492, 0x4edd, {0x8c, 0x23, 0xe0, 0xc0, 0xff, 0xee, 0x7f, 0x0e}},
+    0};
+
+// Whether the endpoint says it is headphones or a headset; the same test as
+// the mood engine's headphonesConnected signal.
+bool IsHeadphoneEndpoint(IMMDevice* device) {
+  Microsoft::WRL::ComPtr<IPropertyStore> props;
+  if (FAILED(device->OpenPropertyStore(STGM_READ, &props))) return false;
+  PROPVARIANT var;
+  PropVariantInit(&var);
+  bool headphones = false;
+  if (SUCCEEDED(props->GetValue(kEndpointFormFactor, &var)) && var.vt == VT_UI4) {
+    const auto form = static_cast<EndpointFormFactor>(var.ulVal);
+    headphones = form == Headphones || form == Headset || form == Handset;
+  }
+  PropVariantClear(&var);
+  return headphones;
 }
 
-int FFErrToHResult(int err) {
-  if (err >= 0) return S_OK;
-  return HRESULT_FROM_WIN32(ERROR_GEN_FAILURE);
-}
+// Flags default render endpoint changes for the engine and posts whether
+// the new endpoint is headphones (1) or not (0). Callbacks arrive on a
+// system thread and must not block, so this only reads the endpoint's
+// properties and stores the results.
+class DefaultDeviceListener : public IMMNotificationClient {
+ public:
+  DefaultDeviceListener(IMMDeviceEnumerator* enumerator, std::atomic<bool>* changed,
+                        std::atomic<int>* headphones)
+      : enumerator_(enumerator), changed_(changed), headphones_(headphones) {}
+
+  ULONG STDMETHODCALLTYPE AddRef() override { return ++refs_; }
+  ULONG STDMETHODCALLTYPE Release() override {
+    const ULONG refs = --refs_;
+    if (refs == 0) delete this;
+    return refs;
+  }
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void** object) override {
+    if (iid == __uuidof(IUnknown) || iid == __uuidof(IMMNotificationClient)) {
+      *object = static_cast<IMMNotificationClient*>(this);
+      AddRef();
+      return S_OK;
+    }
+    *object = nullptr;
+    return E_NOINTERFACE;
+  }
 
-bool IsFloatFormat(AVSampleFormat fmt) {
-  switch (fmt) {
-    case AV_SAMPLE_FMT_FLT:
-    case AV_SAMPLE_FMT_FLTP:
-    case AV_SAMPLE_FMT_DBL:
-    case AV_SAMPLE_FMT_DBLP:
-      return true;
-    default:
-      return false;
+  HRESULT STDMETHODCALLTYPE OnDefaultDeviceChanged(EDataFlow flow, ERole role,
+                                                   LPCWSTR id) override {
+    if (flow != eRender || role != eConsole) return S_OK;
+    changed_->store(true);
+    Microsoft::WRL::ComPtr<IMMDevice> device;
+    if (id && SUCCEEDED(enumerator_->GetDevice(id, &device))) {
+      headphones_->store(IsHeadphoneEndpoint(device.Get()) ? 1 : 0);
+    }
+    return S_OK;
+  }
+  HRESULT STDMETHODCALLTYPE OnDeviceAdded(LPCWSTR) override { return S_OK; }
+  HRESULT STDMETHODCALLTYPE OnDeviceRemoved(LPCWSTR) override { return S_OK; }
+  HRESULT STDMETHODCALLTYPE OnDeviceStateChanged(LPCWSTR, DWORD) override { return S_OK; }
+  HRESULT STDMETHODCALLTYPE OnPropertyValueChanged(LPCWSTR, const PROPERTYKEY) override {
+    return S_OK;
   }
+
+ private:
+  std::atomic<ULONG> refs_{1};
+  // Held until the engine unregisters this listener, which breaks the cycle.
+  Microsoft::WRL::ComPtr<IMMDeviceEnumerator> enumerator_;
+  std::atomic<bool>* changed_;
+  std::atomic<int>* headphones_;
+};
+
+uint64_t HnsToMs(REFERENCE_TIME value) {
+  return static_cast<uint64_t>(value / 10'000);
 }
 
 std::string WideToUtf8(const std::wstring& wide) {
@@ -99,16 +161,77 @@ std::wstring Utf8ToWide(const std::string& utf8) {
   return out;
 }
 
+std::wstring SeekIndexCacheDir() {
+  wchar_t temp[MAX_PATH + 1] = {};
+  const DWORD len = GetTempPathW(MAX_PATH + 1, temp);
+  if (len == 0 || len > MAX_PATH) return {};
+  std::wstring dir = std::wstring(temp, len) + L"ToneyMusic\\SeekIndex";
+  std::error_code ec;
+  std::filesystem::create_directories(dir, ec);
+  return ec ? std::wstring() : dir;
+}
+
+bool SeekIndexKey(const std::wstring& path, SeekIndex::Key* key) {
+  struct _stat64 st;
+  if (_wstat64(path.c_str(), &st) != 0) return false;
+  key->path = WideToUtf8(path);
+  key->fileSize = static_cast<uint64_t>(st.st_size);
+  key->mtimeSeconds = static_cast<int64_t>(st.st_mtime);
+  return true;
+}
+
 }  // namespace
 
 AudioEngineWindows::AudioEngineWindows() {
   CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+  const std::wstring cacheDir = SeekIndexCacheDir();
+  if (!cacheDir.empty()) {
+    seekIndexer_ = std::make_unique<SeekIndexer>(
+        WideToUtf8(cacheDir), &FFmpegPcmSource::BuildSeekIndex);
+  }
+  // Measured from the same float decode the shared-mode render path plays.
+  loudnessScanner_ = std::make_unique<LoudnessScanner>(
+      WideToUtf8(cacheDir), [](const std::string& path) -> std::unique_ptr<PcmSource> {
+        auto decoder = std::make_unique<FFmpegPcmSource>();
+        if (FAILED(decoder->Open(path, false, false))) return nullptr;
+        return decoder;
+      });
+  // Overviews only look at the front pair, so wider files are downmixed in
+  // the converter; the rate is the file's own.
+  waveformScanner_ = std::make_unique<WaveformScanner>(
+      WideToUtf8(cacheDir), [](const std::string& path) -> std::unique_ptr<PcmSource> {
+        auto decoder = std::make_unique<FFmpegPcmSource>();
+        if (FAILED(decoder->Open(path, false, false, WaveformBuilder::kMaxChannels))) {
+          return nullptr;
+        }
+        return decoder;
+      });
+  // Features are taken from a mono downmix, so the same front pair is enough.
+  featureScanner_ = std::make_unique<FeatureScanner>(
+      WideToUtf8(cacheDir), [](const std::string& path) -> std::unique_ptr<PcmSource> {
+        auto decoder = std::make_unique<FFmpegPcmSource>();
+        if (FAILED(decoder->Open(path, false, false, WaveformBuilder::kMaxChannels))) {
+          return nullptr;
+        }
+        return decoder;
+      });
   stopEvent_ = CreateEventW(nullptr, TRUE, FALSE, nullptr);
   audioEvent_ = CreateEventW(nullptr, FALSE, FALSE, nullptr);
 }
 
 AudioEngineWindows::~AudioEngineWindows() {
-  Stop();
+  // Not under mutex_: unregistering waits for a callback in progress.
+  if (enumerator_ && deviceListener_) {
+    enumerator_->UnregisterEndpointNotificationCallback(deviceListener_.Get());
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (audioClient_) {
+      audioClient_->Stop();
+    }
+    StopRenderThread();
+    streamer_.Stop();
+  }
   if (audioEvent_) CloseHandle(audioEvent_);
   if (stopEvent_) CloseHandle(stopEvent_);
   CoUninitialize();
@@ -116,255 +239,372 @@ AudioEngineWindows::~AudioEngineWindows() {
 
 HRESULT AudioEngineWindows::LoadFile(const std::wstring& path) {
   std::lock_guard<std::mutex> lock(mutex_);
+  // The client survives the switch; stop it and drop what it still holds of
+  // the old track.
+  if (audioClient_) {
+    audioClient_->Stop();
+    audioClient_->Reset();
+  }
   StopRenderThread();
+  // A new default endpoint is followed between tracks; its mix rate and
+  // form factor are read again when it is opened.
+  if (defaultDeviceChanged_.exchange(false)) {
+    ReleaseAudioClient();
+    device_.Reset();
+    mixSampleRate_ = 0;
+    preloader_.Clear();
+  }
   ResetPlaybackState();
+  stretcher_.Reset();
+  equalizer_.Reset();
+  crossfeed_.Reset();
+  limiter_.Reset();
 
-  HRESULT hr = DecodeFile(path);
+  const PcmFormat previousFormat = pcmFormat_;
+  HRESULT hr = OpenStream(path);
   if (FAILED(hr)) {
     return hr;
   }
-  currentPath_ = path;
+  // The client was initialized for the previous track's wave format.
+  if (pcmFormat_ != previousFormat) {
+    ReleaseAudioClient();
+  }
   isLoaded_ = true;
   return S_OK;
 }
 
-HRESULT AudioEngineWindows::DecodeFile(const std::wstring& path) {
-  pcmBuffer_.clear();
+HRESULT AudioEngineWindows::OpenStream(const std::wstring& path) {
+  streamer_.Stop();
+  ClearQueuedTrack();
   totalFrames_ = 0;
   durationMs_ = 0;
   metadata_ = {};
   status_ = {};
+  PublishStatus();
 
-  AVFormatContext* fmtCtx = nullptr;
-  const std::string pathUtf8 = WideToUtf8(path);
-  int ffErr = avformat_open_input(&fmtCtx, pathUtf8.c_str(), nullptr, nullptr);
-  if (ffErr < 0) return FFErrToHResult(ffErr);
-
-  auto fmtDeleter = [](AVFormatContext* ctx) {
-    if (ctx) avformat_close_input(&ctx);
-  };
-  std::unique_ptr<AVFormatContext, decltype(fmtDeleter)> fmtHolder(
-      fmtCtx, fmtDeleter);
-  ffErr = avformat_find_stream_info(fmtCtx, nullptr);
-  if (ffErr < 0) return FFErrToHResult(ffErr);
-
-  int audioStream = av_find_best_stream(fmtCtx, AVMEDIA_TYPE_AUDIO, -1, -1, nullptr, 0);
-  if (audioStream < 0) return E_FAIL;
-
-  AVStream* stream = fmtCtx->streams[audioStream];
-  AVCodecParameters* params = stream->codecpar;
-  const AVCodec* codec = avcodec_find_decoder(params->codec_id);
-  if (!codec) return E_FAIL;
-
-  AVCodecContext* codecCtx = avcodec_alloc_context3(codec);
-  if (!codecCtx) return E_OUTOFMEMORY;
-  auto codecDeleter = [](AVCodecContext* ctx) {
-    if (ctx) avcodec_free_context(&ctx);
-  };
-  std::unique_ptr<AVCodecContext, decltype(codecDeleter)> codecHolder(
-      codecCtx, codecDeleter);
-
-  if (avcodec_parameters_to_context(codecCtx, params) < 0) {
-    return E_FAIL;
+  PreparedTrack track;
+  if (!preloader_.Take(path, &track)) {
+    HRESULT hr = PrepareTrack(path, bitPerfect_, gapless_, ResampleRate(),
+                              resampleQuality_, convolution_, &track);
+    if (FAILED(hr)) return hr;
   }
-  if (avcodec_open2(codecCtx, codec, nullptr) < 0) {
+  std::unique_ptr<PcmSource> source = std::move(track.source);
+  ApplyTrack(track);
+
+  // Only the prefill is decoded here; the rest streams in while playing.
+  if (!streamer_.Start(std::move(source), TrackGain(track.replayGain))) {
     return E_FAIL;
   }
+  return S_OK;
+}
 
-  // Decide output format: keep source rate/channels; use packed PCM; float only if not bit-perfect.
-  AVSampleFormat srcFmt = codecCtx->sample_fmt;
-  AVSampleFormat packedSrcFmt = av_get_packed_sample_fmt(srcFmt);
-  bool srcIsFloat = IsFloatFormat(packedSrcFmt);
-  int outSampleRate = codecCtx->sample_rate;
-  AVSampleFormat outFmt = packedSrcFmt;
-  bool outFloat = srcIsFloat;
-  int outBits = av_get_bytes_per_sample(outFmt) * 8;
+HRESULT AudioEngineWindows::PrepareTrack(const std::wstring& path,
+                                         bool bitPerfect, bool gapless,
+                                         uint32_t outputRate,
+                                         ResamplerQuality quality,
+                                         std::shared_ptr<const ConvolutionFilter> convolution,
+                                         PreparedTrack* track) {
+  auto decoder = std::make_unique<FFmpegPcmSource>();
+  HRESULT hr = decoder->Open(WideToUtf8(path), bitPerfect, gapless);
+  if (FAILED(hr)) return hr;
 
-  if (bitPerfect_) {
-    // Limit to formats WASAPI usually supports; fallback to s32 if exotic.
-    if (outFmt == AV_SAMPLE_FMT_S16 || outFmt == AV_SAMPLE_FMT_S32 ||
-        outFmt == AV_SAMPLE_FMT_FLT) {
-      // ok
-    } else {
-      outFmt = AV_SAMPLE_FMT_S32;
-      outBits = 32;
-      outFloat = false;
-    }
-  } else {
-    outFmt = AV_SAMPLE_FMT_FLT;
-    outFloat = true;
-    outBits = 32;
+  SeekIndex::Key seekKey;
+  if (seekIndexer_ && decoder->WantsSeekIndex() && SeekIndexKey(path, &seekKey)) {
+    seekIndexer_->Request(seekKey);
+    decoder->EnableSeekIndex(seekIndexer_.get(), std::move(seekKey));
   }
 
-  SwrContext* swr = nullptr;
-  auto swrDeleter = [](SwrContext* ctx) {
-    if (ctx) swr_free(&ctx);
-  };
-  std::unique_ptr<SwrContext, decltype(swrDeleter)> swrHolder(nullptr, swrDeleter);
-
-  const int channelCount = codecCtx->ch_layout.nb_channels > 0
-                               ? codecCtx->ch_layout.nb_channels
-                               : (params->ch_layout.nb_channels > 0 ? params->ch_layout.nb_channels : 2);
-
-  AVChannelLayout outLayout;
-  if (codecCtx->ch_layout.nb_channels > 0) {
-    av_channel_layout_copy(&outLayout, &codecCtx->ch_layout);
-  } else {
-    av_channel_layout_default(&outLayout, channelCount);
+  // The decoder stays alive inside the source chain, so these stay valid.
+  const FFmpegPcmSource& info = *decoder;
+  const AVFormatContext* fmtCtx = info.FormatContext();
+  const AVStream* stream = info.Stream();
+  const AVCodec* codec = info.Codec();
+  const AVChannelLayout& outLayout = info.OutputLayout();
+  const bool trimmed = !info.Gapless().Empty();
+  track->replayGain = ReadReplayGainTags([&](const char* key) -> const char* {
+    // Ogg keeps Vorbis comments on the stream, other containers on the file.
+    const AVDictionaryEntry* entry = av_dict_get(fmtCtx->metadata, key, nullptr, 0);
+    if (!entry) entry = av_dict_get(stream->metadata, key, nullptr, 0);
+    return entry ? entry->value : nullptr;
+  });
+  if (track->replayGain.Empty() && loudnessScanner_) {
+    TrackLoudness measured;
+    SeekIndex::Key key;
+    const std::string utf8Path = WideToUtf8(path);
+    if (loudnessScanner_->Track(utf8Path, &measured) ||
+        (SeekIndexKey(path, &key) && loudnessScanner_->LoadCached(key, &measured))) {
+      AlbumLoudness album;
+      track->replayGain = ReplayGainFromLoudness(
+          measured, loudnessScanner_->AlbumOf(utf8Path, &album) ? &album : nullptr);
+    }
   }
-
-  AVChannelLayout inLayout;
-  if (codecCtx->ch_layout.nb_channels > 0) {
-    av_channel_layout_copy(&inLayout, &codecCtx->ch_layout);
-  } else {
-    av_channel_layout_default(&inLayout, channelCount);
-  }
-
-  int swrErr = swr_alloc_set_opts2(&swr,
-                            &outLayout,
-                            outFmt,
-                            outSampleRate,
-                            &inLayout,
-                            codecCtx->sample_fmt,
-                            codecCtx->sample_rate,
-                            0,
-                            nullptr);
-  swrHolder.reset(swr);
-  if (swrErr < 0 || !swr || swr_init(swr) < 0) {
-    return E_FAIL;
+  track->source = std::move(decoder);
+  if (trimmed) {
+    track->source = std::make_unique<TrimmingSource>(std::move(track->source),
+                                                     info.Gapless());
   }
-
-  pcmFormat_.sampleRate = outSampleRate;
-  pcmFormat_.channels = outLayout.nb_channels;
-  pcmFormat_.bitsPerSample = outBits;
-  pcmFormat_.isFloat = outFloat;
-  status_.sampleRate = pcmFormat_.sampleRate;
-  status_.channels = pcmFormat_.channels;
-  status_.bitDepth = pcmFormat_.bitsPerSample;
-  status_.bytesPerFrame = pcmFormat_.BytesPerFrame();
-
-  AVPacket* pkt = av_packet_alloc();
-  AVFrame* frame = av_frame_alloc();
-  if (!pkt || !frame) {
-    if (pkt) av_packet_free(&pkt);
-    if (frame) av_frame_free(&frame);
-    return E_OUTOFMEMORY;
-  }
-  auto pktDeleter = [](AVPacket* p) {
-    if (p) av_packet_free(&p);
-  };
-  auto frameDeleter = [](AVFrame* f) {
-    if (f) av_frame_free(&f);
-  };
-  std::unique_ptr<AVPacket, decltype(pktDeleter)> pktHolder(pkt, pktDeleter);
-  std::unique_ptr<AVFrame, decltype(frameDeleter)> frameHolder(frame, frameDeleter);
-
-  int64_t totalSamples = 0;
-  const int outBytesPerSample = av_get_bytes_per_sample(outFmt);
-
-  while (av_read_frame(fmtCtx, pkt) >= 0) {
-    if (pkt->stream_index != audioStream) {
-      av_packet_unref(pkt);
-      continue;
-    }
-    if (avcodec_send_packet(codecCtx, pkt) < 0) {
-      av_packet_unref(pkt);
-      continue;
+  const PcmFormat pcmFormat = track->source->Format();
+  // After trimming, so the trim points stay in source frames.
+  if (!bitPerfect && outputRate != 0 &&
+      ResamplingSource::CanResample(pcmFormat, outputRate)) {
+    track->source = std::make_unique<ResamplingSource>(std::move(track->source),
+                                                       outputRate, quality);
+  }
+  if (!bitPerfect && convolution) {
+    const PcmFormat format = track->source->Format();
+    if (convolution->SampleRate() != format.sampleRate) {
+      convolution = ConvolutionFilter::Create(convolution->Fir(), format.sampleRate);
     }
-    av_packet_unref(pkt);
-
-    while (true) {
-      int r = avcodec_receive_frame(codecCtx, frame);
-      if (r == AVERROR(EAGAIN) || r == AVERROR_EOF) break;
-      if (r < 0) break;
-
-      const int outSamples =
-          swr_get_out_samples(swr, frame->nb_samples);
-      if (outSamples <= 0) continue;
-
-      uint8_t** outData = nullptr;
-      int outLineSize = 0;
-      if (av_samples_alloc_array_and_samples(&outData,
-                                             &outLineSize,
-                                             outLayout.nb_channels,
-                                             outSamples,
-                                             outFmt,
-                                             0) < 0) {
-        continue;
-      }
-
-      int converted = swr_convert(swr,
-                                  outData,
-                                  outSamples,
-                                  const_cast<const uint8_t**>(frame->extended_data),
-                                  frame->nb_samples);
-      if (converted > 0) {
-        const int64_t bytes = static_cast<int64_t>(converted) * outLayout.nb_channels * outBytesPerSample;
-        pcmBuffer_.insert(pcmBuffer_.end(), outData[0], outData[0] + bytes);
-        totalSamples += converted;
-      }
-
-      av_freep(&outData[0]);
-      av_freep(&outData);
+    if (convolution && ConvolvingSource::CanConvolve(format, *convolution)) {
+      track->source = std::make_unique<ConvolvingSource>(std::move(track->source),
+                                                         std::move(convolution));
     }
   }
 
-  totalFrames_ = static_cast<uint64_t>(totalSamples);
-  currentFrame_ = 0;
-
-  if (stream->duration > 0 && stream->time_base.num > 0) {
-    durationMs_ = static_cast<uint64_t>(
+  const PcmFormat outputFormat = track->source->Format();
+  track->path = path;
+  track->outputFormat = outputFormat;
+  track->totalFrames = track->source->TotalFrames();
+  track->durationMs = 0;
+  if (trimmed && outputFormat.sampleRate > 0 && track->totalFrames > 0) {
+    // Container durations still include the trimmed delay and padding.
+    track->durationMs = track->totalFrames * 1000 / outputFormat.sampleRate;
+  } else if (stream->duration > 0 && stream->time_base.num > 0) {
+    track->durationMs = static_cast<uint64_t>(
         av_rescale_q(stream->duration, stream->time_base, AVRational{1, 1000}));
   } else if (fmtCtx->duration > 0) {
-    durationMs_ = static_cast<uint64_t>(fmtCtx->duration / 1000);
-  } else if (pcmFormat_.sampleRate > 0 && totalFrames_ > 0) {
-    durationMs_ = static_cast<uint64_t>(
-        (static_cast<double>(totalFrames_) / pcmFormat_.sampleRate) * 1000.0);
+    track->durationMs = static_cast<uint64_t>(fmtCtx->duration / 1000);
+  } else if (outputFormat.sampleRate > 0 && track->totalFrames > 0) {
+    track->durationMs = static_cast<uint64_t>(
+        (static_cast<double>(track->totalFrames) / outputFormat.sampleRate) * 1000.0);
   }
 
-  metadata_.url = path;
+  TrackMetadata& metadata = track->metadata;
+  metadata = {};
+  metadata.url = path;
   if (fmtCtx->iformat && fmtCtx->iformat->long_name) {
-    metadata_.containerName = Utf8ToWide(fmtCtx->iformat->long_name);
+    metadata.containerName = Utf8ToWide(fmtCtx->iformat->long_name);
   } else {
-    metadata_.containerName = GuessContainer(path);
+    metadata.containerName = GuessContainer(path);
   }
   if (codec && codec->long_name) {
-    metadata_.codecName = Utf8ToWide(codec->long_name);
+    metadata.codecName = Utf8ToWide(codec->long_name);
   } else {
-    metadata_.codecName = L"Unknown Codec";
+    metadata.codecName = L"Unknown Codec";
   }
-  metadata_.sourceBitrateKbps = params->bit_rate > 0 ? params->bit_rate / 1000.0 : 0.0;
+  const int64_t bitRate = stream->codecpar->bit_rate;
+  metadata.sourceBitrateKbps = bitRate > 0 ? bitRate / 1000.0 : 0.0;
   if (outLayout.u.mask != 0) {
-    metadata_.channelLayout = outLayout.u.mask;
+    metadata.channelLayout = outLayout.u.mask;
   } else {
-    metadata_.channelLayout = outLayout.nb_channels;
+    metadata.channelLayout = outLayout.nb_channels;
   }
-  metadata_.durationMs = static_cast<int>(durationMs_);
-  metadata_.pcm = pcmFormat_;
-  const char* fmtName = av_get_sample_fmt_name(outFmt);
+  metadata.durationMs = static_cast<int>(track->durationMs);
+  metadata.pcm = pcmFormat;
+  const char* fmtName = av_get_sample_fmt_name(info.OutputSampleFormat());
   if (fmtName) {
-    metadata_.sampleFormatName = Utf8ToWide(fmtName);
+    metadata.sampleFormatName = Utf8ToWide(fmtName);
   }
-  metadata_.startTimeSeconds = 0;
-  metadata_.tags = {};
+  metadata.startTimeSeconds = 0;
+  metadata.tags = {};
 
   std::error_code ec;
   const auto fileSize = std::filesystem::file_size(path, ec);
   if (!ec) {
-    metadata_.fileSizeBytes = static_cast<int64_t>(fileSize);
+    metadata.fileSizeBytes = static_cast<int64_t>(fileSize);
+  }
+  return S_OK;
+}
+
+void AudioEngineWindows::ApplyTrack(const PreparedTrack& track) {
+  currentPath_ = track.path;
+  pcmFormat_ = track.outputFormat;
+  totalFrames_ = track.totalFrames;
+  durationMs_ = track.durationMs;
+  metadata_ = track.metadata;
+  status_.sampleRate = pcmFormat_.sampleRate;
+  status_.channels = pcmFormat_.channels;
+  status_.bitDepth = pcmFormat_.bitsPerSample;
+  status_.bytesPerFrame = pcmFormat_.BytesPerFrame();
+  currentReplayGain_ = track.replayGain;
+  PublishStatus();
+}
+
+float AudioEngineWindows::TrackGain(const ReplayGainTags& tags) const {
+  if (bitPerfect_) return 1.0f;
+  return ResolveNormalization(normalization_, tags, preampDb_).gain;
+}
+
+bool AudioEngineWindows::LimiterActive() const {
+  return normalization_ != NormalizationMode::kOff && !bitPerfect_ &&
+         pcmFormat_.isFloat && limiter_.IsConfigured();
+}
+
+bool AudioEngineWindows::EqualizerActive() const {
+  return !bitPerfect_ && pcmFormat_.isFloat && equalizer_.IsConfigured();
+}
+
+bool AudioEngineWindows::CrossfeedActive() const {
+  return !bitPerfect_ && pcmFormat_.isFloat && crossfeed_.IsConfigured();
+}
+
+bool AudioEngineWindows::StretcherActive() const {
+  return !bitPerfect_ && pcmFormat_.isFloat && stretcher_.IsConfigured();
+}
+
+size_t AudioEngineWindows::ReadOutput(BYTE* data, size_t frames) {
+  if (!StretcherActive()) return streamer_.Read(data, frames);
+  // The ring only reports the end once it is drained, so what the
+  // stretcher holds then plays out.
+  return stretcher_.Read(
+      reinterpret_cast<float*>(data), frames,
+      [this](float* dst, size_t n) {
+        return streamer_.Read(reinterpret_cast<uint8_t*>(dst), n);
+      },
+      streamer_.IsFinished());
+}
+
+void AudioEngineWindows::UpdateCrossfeed() {
+  crossfeed_.SetEnabled(crossfeedMode_ == CrossfeedMode::kOn ||
+                        (crossfeedMode_ == CrossfeedMode::kHeadphones && headphones_));
+}
+
+void AudioEngineWindows::CollectHeadphoneChange() {
+  const int headphones = defaultHeadphones_.exchange(-1);
+  if (headphones < 0) return;
+  // Plugging headphones in mid-track switches kHeadphones crossfeed at once;
+  // the stream itself moves to the new endpoint at the next LoadFile().
+  headphones_ = headphones != 0;
+  UpdateCrossfeed();
+}
+
+HRESULT AudioEngineWindows::QueueNext(const std::wstring& path) {
+  bool bitPerfect = false;
+  bool gapless = false;
+  uint32_t outputRate = 0;
+  ResamplerQuality quality = ResamplerQuality::kMedium;
+  std::shared_ptr<const ConvolutionFilter> convolution;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!gapless_ && streamer_.OverlapMs() == 0) return E_FAIL;
+    if (!isLoaded_ || !streamer_.IsActive()) return E_FAIL;
+    bitPerfect = bitPerfect_;
+    gapless = gapless_;
+    outputRate = ResampleRate();
+    quality = resampleQuality_;
+    convolution = convolution_;
+  }
+
+  // The open, probe and head decode run unlocked: the render thread takes
+  // mutex_ every period and would underflow behind them. With the head in
+  // memory the streamer's prefill below is a copy, as for a preloaded track.
+  PreparedTrack track;
+  if (!preloader_.Take(path, &track)) {
+    HRESULT hr = PrepareTrack(path, bitPerfect, gapless, outputRate, quality,
+                              convolution, &track);
+    if (FAILED(hr)) return hr;
+    Prebuffer(&track);
   }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  // The track or the settings it was prepared with may have changed.
+  if (!gapless_ && streamer_.OverlapMs() == 0) return E_FAIL;
+  if (!isLoaded_ || !streamer_.IsActive()) return E_FAIL;
+  if (bitPerfect != bitPerfect_ || gapless != gapless_ ||
+      quality != resampleQuality_ || convolution != convolution_) {
+    return E_FAIL;
+  }
+  // A format change needs a new device stream; the caller loads it instead.
+  if (track.outputFormat != pcmFormat_) return E_FAIL;
+  if (!streamer_.QueueNext(std::move(track.source),
+                           TrackGain(track.replayGain))) {
+    return E_FAIL;
+  }
+  queuedTrack_ = std::move(track);
+  hasQueuedTrack_ = true;
+  return S_OK;
+}
+
+HRESULT AudioEngineWindows::PreloadNext(const std::wstring& path) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const bool bitPerfect = bitPerfect_;
+  const bool gapless = gapless_;
+  const uint32_t outputRate = ResampleRate();
+  const ResamplerQuality quality = resampleQuality_;
+  std::shared_ptr<const ConvolutionFilter> convolution = convolution_;
+  preloader_.Preload(path, [this, path, bitPerfect, gapless, outputRate, quality,
+                            convolution](PreparedTrack* track) {
+    if (FAILED(PrepareTrack(path, bitPerfect, gapless, outputRate, quality,
+                            convolution, track))) {
+      return false;
+    }
+    Prebuffer(track);
+    return true;
+  });
   return S_OK;
 }
 
+void AudioEngineWindows::Prebuffer(PreparedTrack* track) {
+  auto prebuffered = std::make_unique<PrebufferedSource>(std::move(track->source));
+  prebuffered->Fill(static_cast<uint64_t>(
+      kPreloadSeconds * track->outputFormat.sampleRate));
+  track->source = std::move(prebuffered);
+}
+
+bool AudioEngineWindows::CollectTrackChange() {
+  if (!hasQueuedTrack_ || !streamer_.TakeTrackChange()) return false;
+  // The queued track is audible now; position and metadata follow it.
+  ApplyTrack(queuedTrack_);
+  queuedTrack_ = {};
+  hasQueuedTrack_ = false;
+  return true;
+}
+
+void AudioEngineWindows::ClearQueuedTrack() {
+  streamer_.QueueNext(nullptr);
+  queuedTrack_ = {};
+  hasQueuedTrack_ = false;
+}
+
 HRESULT AudioEngineWindows::EnsureDevice() {
   if (device_) return S_OK;
-  Microsoft::WRL::ComPtr<IMMDeviceEnumerator> enumerator;
-  HRESULT hr = CoCreateInstance(__uuidof(MMDeviceEnumerator), nullptr, CLSCTX_ALL,
-                                IID_PPV_ARGS(&enumerator));
+  HRESULT hr = S_OK;
+  if (!enumerator_) {
+    hr = CoCreateInstance(__uuidof(MMDeviceEnumerator), nullptr, CLSCTX_ALL,
+                          IID_PPV_ARGS(&enumerator_));
+    if (FAILED(hr)) return hr;
+    deviceListener_.Attach(new DefaultDeviceListener(
+        enumerator_.Get(), &defaultDeviceChanged_, &defaultHeadphones_));
+    if (FAILED(enumerator_->RegisterEndpointNotificationCallback(deviceListener_.Get()))) {
+      deviceListener_.Reset();
+    }
+  }
+
+  hr = enumerator_->GetDefaultAudioEndpoint(eRender, eConsole, &device_);
   if (FAILED(hr)) return hr;
+  // Read for every endpoint the engine moves to. Default endpoint changes
+  // in between reach the render thread through defaultHeadphones_.
+  headphones_ = IsHeadphoneEndpoint(device_.Get());
+  defaultHeadphones_.store(-1);
+  UpdateCrossfeed();
+  return S_OK;
+}
 
-  hr = enumerator->GetDefaultAudioEndpoint(eRender, eConsole, &device_);
-  return hr;
+uint32_t AudioEngineWindows::ResampleRate() {
+  if (bitPerfect_) return 0;
+  if (mixSampleRate_ != 0) return mixSampleRate_;
+  if (FAILED(EnsureDevice())) return 0;
+  Microsoft::WRL::ComPtr<IAudioClient> client;
+  if (FAILED(device_->Activate(__uuidof(IAudioClient), CLSCTX_ALL, nullptr,
+                               &client))) {
+    return 0;
+  }
+  WAVEFORMATEX* mix = nullptr;
+  if (SUCCEEDED(client->GetMixFormat(&mix)) && mix) {
+    mixSampleRate_ = mix->nSamplesPerSec;
+    CoTaskMemFree(mix);
+  }
+  return mixSampleRate_;
 }
 
 HRESULT AudioEngineWindows::EnsureAudioClient() {
@@ -377,10 +617,7 @@ HRESULT AudioEngineWindows::EnsureAudioClient() {
   HRESULT hr = EnsureDevice();
   if (FAILED(hr)) return hr;
 
-  audioClient_.Reset();
-  renderClient_.Reset();
-  sessionVolume_.Reset();
-  bufferFrameCount_ = 0;
+  ReleaseAudioClient();
 
   hr = device_->Activate(__uuidof(IAudioClient), CLSCTX_ALL, nullptr,
                          &audioClient_);
@@ -401,6 +638,7 @@ HRESULT AudioEngineWindows::EnsureAudioClient() {
       // Fallback to shared if exclusive is not supported.
       shareMode = AUDCLNT_SHAREMODE_SHARED;
       bitPerfect_ = false;
+      preloader_.Clear();
     }
   }
 
@@ -429,6 +667,14 @@ HRESULT AudioEngineWindows::EnsureAudioClient() {
   hr = audioClient_->GetBufferSize(&bufferFrameCount_);
   if (FAILED(hr)) return hr;
 
+  equalizer_.Configure(pcmFormat_.sampleRate, pcmFormat_.channels);
+  crossfeed_.Configure(pcmFormat_.sampleRate, pcmFormat_.channels);
+  stretcher_.Configure(pcmFormat_.sampleRate, pcmFormat_.channels);
+  limiter_.Configure(pcmFormat_.sampleRate, pcmFormat_.channels);
+  spectrum_.Configure(pcmFormat_);
+  meter_.Configure(pcmFormat_);
+  PublishStatus();
+
   if (!audioEvent_) {
     audioEvent_ = CreateEventW(nullptr, FALSE, FALSE, nullptr);
   }
@@ -436,24 +682,41 @@ HRESULT AudioEngineWindows::EnsureAudioClient() {
   return hr;
 }
 
+void AudioEngineWindows::ReleaseAudioClient() {
+  audioClient_.Reset();
+  renderClient_.Reset();
+  sessionVolume_.Reset();
+  bufferFrameCount_ = 0;
+}
+
 HRESULT AudioEngineWindows::PrimeAndStart() {
   HRESULT hr = EnsureAudioClient();
   if (FAILED(hr)) return hr;
 
-  UINT32 framesToWrite = std::min(bufferFrameCount_,
-                                  static_cast<UINT32>(totalFrames_ - currentFrame_));
+  const UINT32 framesToWrite = bufferFrameCount_;
   BYTE* data = nullptr;
   hr = renderClient_->GetBuffer(framesToWrite, &data);
   if (FAILED(hr)) return hr;
 
-  const size_t bytesToCopy =
-      static_cast<size_t>(framesToWrite) * pcmFormat_.BytesPerFrame();
-  if (bytesToCopy > 0 && currentFrame_ < totalFrames_) {
-    const uint8_t* src = pcmBuffer_.data() + currentFrame_ * pcmFormat_.BytesPerFrame();
-    memcpy(data, src, bytesToCopy);
-    currentFrame_ += framesToWrite;
-    status_.renderedFrames += static_cast<int>(framesToWrite);
+  const size_t copied = ReadOutput(data, framesToWrite);
+  if (copied < framesToWrite) {
+    const size_t bytesPerFrame = pcmFormat_.BytesPerFrame();
+    memset(data + copied * bytesPerFrame, 0,
+           (framesToWrite - copied) * bytesPerFrame);
+  }
+  if (EqualizerActive()) {
+    equalizer_.Process(reinterpret_cast<float*>(data), framesToWrite);
+  }
+  if (CrossfeedActive()) {
+    crossfeed_.Process(reinterpret_cast<float*>(data), framesToWrite);
   }
+  if (LimiterActive()) {
+    limiter_.Process(reinterpret_cast<float*>(data), framesToWrite);
+  }
+  spectrum_.Tap(data, framesToWrite);
+  meter_.Process(data, framesToWrite);
+  status_.renderedFrames += static_cast<int>(copied);
+  PublishStatus();
 
   hr = renderClient_->ReleaseBuffer(framesToWrite, 0);
   if (FAILED(hr)) return hr;
@@ -486,6 +749,7 @@ HRESULT AudioEngineWindows::Pause() {
   audioClient_->Stop();
   StopRenderThread();
   isPlaying_ = false;
+  meter_.Reset();
   return S_OK;
 }
 
@@ -496,13 +760,31 @@ void AudioEngineWindows::Stop() {
   }
   StopRenderThread();
   ResetPlaybackState();
+  CollectTrackChange();
+  if (streamer_.IsActive()) {
+    // Keep the track loaded; the next Play() starts from the top.
+    streamer_.Seek(0);
+  }
+  stretcher_.Reset();
 }
 
 void AudioEngineWindows::ResetPlaybackState() {
-  currentFrame_ = 0;
   isPlaying_ = false;
   status_.renderedFrames = 0;
   status_.underflows = 0;
+  // Only called with the render thread stopped.
+  meter_.Reset();
+  PublishStatus();
+}
+
+void AudioEngineWindows::PublishStatus() {
+  PublishedStatus published;
+  published.status = status_;
+  published.status.limiterActive = LimiterActive();
+  published.status.crossfeedActive = CrossfeedActive();
+  published.stretcherActive = StretcherActive();
+  published.limiterSampleRate = limiter_.SampleRate();
+  publishedStatus_.Store(published);
 }
 
 void AudioEngineWindows::StopRenderThread() {
@@ -518,13 +800,25 @@ void AudioEngineWindows::StopRenderThread() {
 HRESULT AudioEngineWindows::SeekMs(uint64_t positionMs) {
   std::lock_guard<std::mutex> lock(mutex_);
   if (!isLoaded_ || pcmFormat_.sampleRate == 0) return E_FAIL;
-  const uint64_t targetFrame =
+  CollectTrackChange();
+  uint64_t targetFrame =
       static_cast<uint64_t>((positionMs / 1000.0) * pcmFormat_.sampleRate);
-  currentFrame_ = std::min(targetFrame, totalFrames_);
-  if (isPlaying_) {
-    // Restart playback from new position.
+  if (totalFrames_ > 0) targetFrame = std::min(targetFrame, totalFrames_);
+  const bool wasPlaying = isPlaying_;
+  if (wasPlaying) {
     audioClient_->Stop();
     StopRenderThread();
+  }
+  if (!streamer_.Seek(targetFrame, accurateSeek_ ? SeekMode::kAccurate
+                                                 : SeekMode::kFast)) {
+    return E_FAIL;
+  }
+  stretcher_.Reset();
+  equalizer_.Reset();
+  crossfeed_.Reset();
+  limiter_.Reset();
+  if (wasPlaying) {
+    // Restart playback from new position.
     return PrimeAndStart();
   }
   return S_OK;
@@ -540,6 +834,92 @@ HRESULT AudioEngineWindows::SetVolume(double value) {
   return S_OK;
 }
 
+void AudioEngineWindows::SetNormalization(NormalizationMode mode,
+                                          double preampDb) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  CollectTrackChange();
+  // The render loop holds mutex_ while it runs the limiter, so a reset here
+  // cannot tear a block.
+  if (normalization_ == NormalizationMode::kOff) limiter_.Reset();
+  normalization_ = mode;
+  preampDb_ = preampDb;
+  if (streamer_.IsActive()) streamer_.SetTrackGain(TrackGain(currentReplayGain_));
+  PublishStatus();
+}
+
+void AudioEngineWindows::ScanLoudness(
+    const std::vector<std::pair<std::wstring, std::wstring>>& tracks) {
+  std::vector<LoudnessScanner::Item> items;
+  items.reserve(tracks.size());
+  for (const auto& [path, album] : tracks) {
+    LoudnessScanner::Item item;
+    if (!SeekIndexKey(path, &item.key)) continue;
+    item.album = WideToUtf8(album);
+    items.push_back(std::move(item));
+  }
+  loudnessScanner_->Enqueue(items);
+}
+
+void AudioEngineWindows::CancelLoudnessScan() { loudnessScanner_->Cancel(); }
+
+bool AudioEngineWindows::TrackLoudnessFor(const std::wstring& path,
+                                          TrackLoudness* result) const {
+  const std::string utf8Path = WideToUtf8(path);
+  if (loudnessScanner_->Track(utf8Path, result)) return true;
+  SeekIndex::Key key;
+  return SeekIndexKey(path, &key) && loudnessScanner_->LoadCached(key, result);
+}
+
+LoudnessScanner::Stats AudioEngineWindows::LoudnessScanStats() const {
+  return loudnessScanner_->GetStats();
+}
+
+void AudioEngineWindows::GenerateWaveforms(const std::vector<std::wstring>& paths) {
+  std::vector<SeekIndex::Key> keys;
+  keys.reserve(paths.size());
+  for (const std::wstring& path : paths) {
+    SeekIndex::Key key;
+    if (SeekIndexKey(path, &key)) keys.push_back(std::move(key));
+  }
+  waveformScanner_->Enqueue(keys);
+}
+
+void AudioEngineWindows::CancelWaveforms() { waveformScanner_->Cancel(); }
+
+std::shared_ptr<const Waveform> AudioEngineWindows::WaveformFor(
+    const std::wstring& path) const {
+  SeekIndex::Key key;
+  if (!SeekIndexKey(path, &key)) return nullptr;
+  return waveformScanner_->Load(key);
+}
+
+WaveformScanner::Stats AudioEngineWindows::WaveformStats() const {
+  return waveformScanner_->GetStats();
+}
+
+void AudioEngineWindows::ScanFeatures(const std::vector<std::wstring>& paths) {
+  std::vector<SeekIndex::Key> keys;
+  keys.reserve(paths.size());
+  for (const std::wstring& path : paths) {
+    SeekIndex::Key key;
+    if (SeekIndexKey(path, &key)) keys.push_back(std::move(key));
+  }
+  featureScanner_->Enqueue(keys);
+}
+
+void AudioEngineWindows::CancelFeatureScan() { featureScanner_->Cancel(); }
+
+bool AudioEngineWindows::TrackFeaturesFor(const std::wstring& path,
+                                          TrackFeatures* result) const {
+  if (featureScanner_->Track(WideToUtf8(path), result)) return true;
+  SeekIndex::Key key;
+  return SeekIndexKey(path, &key) && featureScanner_->LoadCached(key, result);
+}
+
+FeatureScanner::Stats AudioEngineWindows::FeatureScanStats() const {
+  return featureScanner_->GetStats();
+}
+
 double AudioEngineWindows::GetVolume() {
   std::lock_guard<std::mutex> lock(mutex_);
   if (!sessionVolume_) return volume_;
@@ -558,8 +938,10 @@ void AudioEngineWindows::SetBitPerfect(bool enabled) {
     audioClient_->Stop();
   }
   StopRenderThread();
-  audioClient_.Reset();
-  renderClient_.Reset();
+  ReleaseAudioClient();
+  preloader_.Clear();
+  if (streamer_.IsActive()) streamer_.SetTrackGain(TrackGain(currentReplayGain_));
+  PublishStatus();
 }
 
 void AudioEngineWindows::SetAutoSampleRateSwitch(bool enabled) {
@@ -567,6 +949,114 @@ void AudioEngineWindows::SetAutoSampleRateSwitch(bool enabled) {
   autoSampleRateSwitching_ = enabled;
 }
 
+void AudioEngineWindows::SetResampleQuality(ResamplerQuality quality) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (resampleQuality_ == quality) return;
+  resampleQuality_ = quality;
+  // Preloaded tracks were converted at the old quality.
+  preloader_.Clear();
+}
+
+HRESULT AudioEngineWindows::SetConvolutionFilter(const std::wstring& path) {
+  std::shared_ptr<const ConvolutionFilter> convolution;
+  if (!path.empty()) {
+    // Decoded outside the lock; a long response takes a moment.
+    FFmpegPcmSource decoder;
+    HRESULT hr = decoder.Open(WideToUtf8(path), false);
+    if (FAILED(hr)) return hr;
+    auto fir = std::make_shared<FirFilter>();
+    if (!ReadFirFilter(decoder, fir.get())) return E_INVALIDARG;
+    uint32_t rate = fir->sampleRate;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (const uint32_t mixRate = ResampleRate()) rate = mixRate;
+    }
+    convolution = ConvolutionFilter::Create(std::move(fir), rate);
+    if (!convolution) return E_INVALIDARG;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  convolution_ = std::move(convolution);
+  // Preloaded tracks were built with the old filter.
+  preloader_.Clear();
+  return S_OK;
+}
+
+HRESULT AudioEngineWindows::SetEqualizer(const std::vector<EqBand>& bands) {
+  // No mutex_: the equalizer hands the bands to the render thread itself.
+  return equalizer_.SetBands(bands) ? S_OK : E_INVALIDARG;
+}
+
+void AudioEngineWindows::SetCrossfeed(CrossfeedMode mode, const CrossfeedLevel& level) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  crossfeedMode_ = mode;
+  crossfeed_.SetLevel(level);
+  UpdateCrossfeed();
+}
+
+void AudioEngineWindows::SetHeadphonesConnected(bool connected) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  headphones_ = connected;
+  // Newer than any endpoint change the render thread has not collected.
+  defaultHeadphones_.store(-1);
+  UpdateCrossfeed();
+}
+
+void AudioEngineWindows::SetPlaybackRate(double rate) {
+  // No mutex_: the stretcher picks the rate up at its next hop.
+  stretcher_.SetRate(rate);
+}
+
+void AudioEngineWindows::SetSpectrumEnabled(bool enabled) {
+  // No mutex_ in any of these: the analyzer has its own worker and hands
+  // frames to the reader through a triple buffer.
+  spectrum_.SetEnabled(enabled);
+}
+
+void AudioEngineWindows::SetSpectrumOptions(const SpectrumAnalyzer::Options& options) {
+  spectrum_.SetOptions(options);
+}
+
+bool AudioEngineWindows::LatestSpectrum(SpectrumFrame* frame) {
+  return spectrum_.Latest(frame);
+}
+
+std::vector<double> AudioEngineWindows::SpectrumBandCentersHz() const {
+  return spectrum_.BandCentersHz();
+}
+
+void AudioEngineWindows::SetMeterOptions(const LevelMeter::Options& options) {
+  // No mutex_: the meter reads its options from atomics.
+  meter_.SetOptions(options);
+}
+
+void AudioEngineWindows::SetGapless(bool enabled) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  gapless_ = enabled;
+  if (!enabled && streamer_.OverlapMs() == 0) ClearQueuedTrack();
+  // Preloaded tracks were opened with the old trimming setting.
+  preloader_.Clear();
+}
+
+void AudioEngineWindows::SetCrossfadeMs(uint32_t ms) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  streamer_.SetOverlapMs(ms);
+}
+
+void AudioEngineWindows::SetDither(DitherMode mode) {
+  // No mutex_: the crossfader hands the mode to the render thread itself.
+  streamer_.SetDither(mode);
+}
+
+void AudioEngineWindows::SetAccurateSeek(bool enabled) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  accurateSeek_ = enabled;
+}
+
+uint64_t AudioEngineWindows::LastSeekLatencyUs() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return static_cast<uint64_t>(streamer_.LastSeekDuration().count());
+}
+
 bool AudioEngineWindows::IsPlaying() const {
   std::lock_guard<std::mutex> lock(mutex_);
   return isPlaying_;
@@ -580,7 +1070,10 @@ uint64_t AudioEngineWindows::DurationMs() const {
 uint64_t AudioEngineWindows::CurrentPositionMs() const {
   std::lock_guard<std::mutex> lock(mutex_);
   if (pcmFormat_.sampleRate == 0) return 0;
-  const double seconds = static_cast<double>(currentFrame_) / pcmFormat_.sampleRate;
+  // The ring counts what the stretcher has taken, not what has played.
+  uint64_t frames = streamer_.PositionFrames();
+  if (StretcherActive()) frames -= std::min(frames, stretcher_.HeldFrames());
+  const double seconds = static_cast<double>(frames) / pcmFormat_.sampleRate;
   return static_cast<uint64_t>(seconds * 1000.0);
 }
 
@@ -590,8 +1083,17 @@ TrackMetadata AudioEngineWindows::Metadata() const {
 }
 
 PcmStatus AudioEngineWindows::Status() const {
-  std::lock_guard<std::mutex> lock(mutex_);
-  return status_;
+  // No mutex_: everything here is published by whoever last held it, or is
+  // safe to read from any thread.
+  const PublishedStatus published = publishedStatus_.Load();
+  PcmStatus status = published.status;
+  const TruePeakLimiter::Stats stats = limiter_.GetStats();
+  status.limiterCpuLoad = stats.CpuLoad(published.limiterSampleRate);
+  status.limiterMaxReductionDb = stats.maxReductionDb;
+  status.crossfeedActive = status.crossfeedActive && crossfeed_.Enabled();
+  status.playbackRate = published.stretcherActive ? stretcher_.Rate() : 1.0;
+  status.levels = meter_.Read();
+  return status;
 }
 
 void AudioEngineWindows::SetOnPlaybackEnded(std::function<void()> callback) {
@@ -599,6 +1101,11 @@ void AudioEngineWindows::SetOnPlaybackEnded(std::function<void()> callback) {
   onPlaybackEnded_ = std::move(callback);
 }
 
+void AudioEngineWindows::SetOnTrackChanged(std::function<void()> callback) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  onTrackChanged_ = std::move(callback);
+}
+
 void AudioEngineWindows::RenderLoop() {
   HANDLE handles[2] = {audioEvent_, stopEvent_};
   bool ended = false;
@@ -608,9 +1115,9 @@ void AudioEngineWindows::RenderLoop() {
     if (wait == WAIT_OBJECT_0 + 1) break;  // stop signal
     if (wait != WAIT_OBJECT_0) continue;
 
-    std::lock_guard<std::mutex> lock(mutex_);
+    std::unique_lock<std::mutex> lock(mutex_);
     if (!audioClient_ || !renderClient_) break;
-    if (currentFrame_ >= totalFrames_) {
+    if (streamer_.IsFinished() && stretcher_.HeldFrames() == 0) {
       ended = true;
       break;
     }
@@ -618,33 +1125,60 @@ void AudioEngineWindows::RenderLoop() {
     UINT32 padding = 0;
     if (FAILED(audioClient_->GetCurrentPadding(&padding))) {
       status_.underflows++;
+      PublishStatus();
       continue;
     }
     const UINT32 framesAvailable =
         bufferFrameCount_ > padding ? bufferFrameCount_ - padding : 0;
     if (framesAvailable == 0) continue;
 
-    UINT32 framesToWrite =
-        std::min<uint32_t>(framesAvailable,
-                           static_cast<UINT32>(totalFrames_ - currentFrame_));
     BYTE* data = nullptr;
-    HRESULT hr = renderClient_->GetBuffer(framesToWrite, &data);
+    HRESULT hr = renderClient_->GetBuffer(framesAvailable, &data);
     if (FAILED(hr)) {
       status_.underflows++;
+      PublishStatus();
       continue;
     }
 
-    const size_t bytesToCopy =
-        static_cast<size_t>(framesToWrite) * pcmFormat_.BytesPerFrame();
-    const uint8_t* src = pcmBuffer_.data() + currentFrame_ * pcmFormat_.BytesPerFrame();
-    memcpy(data, src, bytesToCopy);
-    currentFrame_ += framesToWrite;
+    // The ring never blocks; a short read means either end of stream (hand
+    // back only what was copied) or a decoder stall (pad with silence).
+    UINT32 framesToWrite =
+        static_cast<UINT32>(ReadOutput(data, framesAvailable));
     status_.renderedFrames += framesToWrite;
+    const bool trackChanged = CollectTrackChange();
+    CollectHeadphoneChange();
+    const bool limiting = LimiterActive();
+    // With the limiter in the path, the end of stream is padded too, so the
+    // audio still in its look-ahead delay comes out.
+    if (framesToWrite < framesAvailable && (limiting || !streamer_.IsFinished())) {
+      const size_t bytesPerFrame = pcmFormat_.BytesPerFrame();
+      memset(data + static_cast<size_t>(framesToWrite) * bytesPerFrame, 0,
+             static_cast<size_t>(framesAvailable - framesToWrite) * bytesPerFrame);
+      if (!streamer_.IsFinished()) status_.underflows++;
+      framesToWrite = framesAvailable;
+    }
+    if (EqualizerActive()) {
+      equalizer_.Process(reinterpret_cast<float*>(data), framesToWrite);
+    }
+    if (CrossfeedActive()) {
+      crossfeed_.Process(reinterpret_cast<float*>(data), framesToWrite);
+    }
+    if (limiting) {
+      limiter_.Process(reinterpret_cast<float*>(data), framesToWrite);
+    }
+    spectrum_.Tap(data, framesToWrite);
+    meter_.Process(data, framesToWrite);
 
     hr = renderClient_->ReleaseBuffer(framesToWrite, 0);
     if (FAILED(hr)) {
       status_.underflows++;
     }
+    PublishStatus();
+    if (trackChanged && onTrackChanged_) {
+      std::function<void()> callback = onTrackChanged_;
+      lock.unlock();
+      callback();
+    }
   }
 
   std::function<void()> callback;
@@ -652,7 +1186,6 @@ void AudioEngineWindows::RenderLoop() {
     std::lock_guard<std::mutex> lock(mutex_);
     isPlaying_ = false;
     if (ended) {
-      currentFrame_ = totalFrames_;
       callback = onPlaybackEnded_;
     }
   }
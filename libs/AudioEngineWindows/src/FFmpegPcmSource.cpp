@@ -0,0 +1,432 @@
+#include "FFmpegPcmSource.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+extern "C" {
+#include <libavutil/avutil.h>
+#include <libavutil/dict.h>
+#include <libavutil/mathematics.h>
+}
+
+namespace audioengine {
+
+namespace {
+
+HRESULT FFErrToHResult(int err) {
+  if (err >= 0) return S_OK;
+  if (err == AVERROR(ENOMEM)) return E_OUTOFMEMORY;
+  return HRESULT_FROM_WIN32(ERROR_GEN_FAILURE);
+}
+
+bool IsFloatFormat(AVSampleFormat fmt) {
+  switch (fmt) {
+    case AV_SAMPLE_FMT_FLT:
+    case AV_SAMPLE_FMT_FLTP:
+    case AV_SAMPLE_FMT_DBL:
+    case AV_SAMPLE_FMT_DBLP:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Enough of the file head to reach the LAME tag behind a typical ID3v2 tag
+// with cover art stripped; larger tags simply miss the header.
+constexpr int kLameProbeBytes = 64 * 1024;
+
+// Files shorter than this seek fast enough by bisection.
+constexpr int64_t kSeekIndexMinDurationSeconds = 10 * 60;
+
+int64_t StreamOrigin(const AVStream* stream) {
+  return stream->start_time != AV_NOPTS_VALUE ? stream->start_time : 0;
+}
+
+}  // namespace
+
+FFmpegPcmSource::~FFmpegPcmSource() { Close(); }
+
+void FFmpegPcmSource::Close() {
+  if (frame_) av_frame_free(&frame_);
+  if (packet_) av_packet_free(&packet_);
+  if (swr_) swr_free(&swr_);
+  if (codecCtx_) avcodec_free_context(&codecCtx_);
+  if (fmtCtx_) avformat_close_input(&fmtCtx_);
+  av_channel_layout_uninit(&outLayout_);
+  codec_ = nullptr;
+  stream_ = nullptr;
+  streamIndex_ = -1;
+  inputDrained_ = false;
+  stagedFrames_ = 0;
+  stagedOffset_ = 0;
+  stagedStart_ = 0;
+  nextFrame_ = 0;
+  useTimestamps_ = true;
+  gapless_ = GaplessInfo();
+  originFromFirstFrame_ = false;
+  firstFramePts_ = AV_NOPTS_VALUE;
+  seekIndexer_ = nullptr;
+  seekIndex_ = SeekIndex();
+  staging_.Release();
+}
+
+HRESULT FFmpegPcmSource::Open(const std::string& utf8Path, bool bitPerfect,
+                              bool gapless, uint32_t maxChannels) {
+  Close();
+
+  int ffErr = avformat_open_input(&fmtCtx_, utf8Path.c_str(), nullptr, nullptr);
+  if (ffErr < 0) return FFErrToHResult(ffErr);
+  ffErr = avformat_find_stream_info(fmtCtx_, nullptr);
+  if (ffErr < 0) return FFErrToHResult(ffErr);
+
+  streamIndex_ =
+      av_find_best_stream(fmtCtx_, AVMEDIA_TYPE_AUDIO, -1, -1, nullptr, 0);
+  if (streamIndex_ < 0) return E_FAIL;
+  stream_ = fmtCtx_->streams[streamIndex_];
+  AVCodecParameters* params = stream_->codecpar;
+
+  codec_ = avcodec_find_decoder(params->codec_id);
+  if (!codec_) return E_FAIL;
+  codecCtx_ = avcodec_alloc_context3(codec_);
+  if (!codecCtx_) return E_OUTOFMEMORY;
+  if (avcodec_parameters_to_context(codecCtx_, params) < 0) return E_FAIL;
+  if (gapless) {
+    gapless_ = DetectGapless(utf8Path);
+    if (!gapless_.Empty()) {
+      codecCtx_->flags2 |= AV_CODEC_FLAG2_SKIP_MANUAL;
+      originFromFirstFrame_ = true;
+    }
+  }
+  if (avcodec_open2(codecCtx_, codec_, nullptr) < 0) return E_FAIL;
+
+  // Decide output format: keep source rate/channels; use packed PCM; float
+  // only if not bit-perfect.
+  const AVSampleFormat packedSrcFmt =
+      av_get_packed_sample_fmt(codecCtx_->sample_fmt);
+  outFmt_ = packedSrcFmt;
+  bool outFloat = IsFloatFormat(packedSrcFmt);
+  int outBits = av_get_bytes_per_sample(outFmt_) * 8;
+  if (bitPerfect) {
+    // Limit to formats WASAPI usually supports; fallback to s32 if exotic.
+    if (outFmt_ != AV_SAMPLE_FMT_S16 && outFmt_ != AV_SAMPLE_FMT_S32 &&
+        outFmt_ != AV_SAMPLE_FMT_FLT) {
+      outFmt_ = AV_SAMPLE_FMT_S32;
+      outBits = 32;
+      outFloat = false;
+    }
+  } else {
+    outFmt_ = AV_SAMPLE_FMT_FLT;
+    outFloat = true;
+    outBits = 32;
+  }
+
+  const int channelCount =
+      codecCtx_->ch_layout.nb_channels > 0
+          ? codecCtx_->ch_layout.nb_channels
+          : (params->ch_layout.nb_channels > 0 ? params->ch_layout.nb_channels
+                                               : 2);
+  AVChannelLayout inLayout;
+  if (codecCtx_->ch_layout.nb_channels > 0) {
+    av_channel_layout_copy(&outLayout_, &codecCtx_->ch_layout);
+    av_channel_layout_copy(&inLayout, &codecCtx_->ch_layout);
+  } else {
+    av_channel_layout_default(&outLayout_, channelCount);
+    av_channel_layout_default(&inLayout, channelCount);
+  }
+  if (maxChannels > 0 && channelCount > static_cast<int>(maxChannels)) {
+    av_channel_layout_uninit(&outLayout_);
+    av_channel_layout_default(&outLayout_, static_cast<int>(maxChannels));
+  }
+
+  const int swrErr = swr_alloc_set_opts2(&swr_, &outLayout_, outFmt_,
+                                         codecCtx_->sample_rate, &inLayout,
+                                         codecCtx_->sample_fmt,
+                                         codecCtx_->sample_rate, 0, nullptr);
+  av_channel_layout_uninit(&inLayout);
+  if (swrErr < 0 || !swr_ || swr_init(swr_) < 0) return E_FAIL;
+
+  packet_ = av_packet_alloc();
+  frame_ = av_frame_alloc();
+  if (!packet_ || !frame_) return E_OUTOFMEMORY;
+
+  format_.sampleRate = static_cast<uint32_t>(codecCtx_->sample_rate);
+  format_.channels = static_cast<uint32_t>(outLayout_.nb_channels);
+  format_.bitsPerSample = static_cast<uint32_t>(outBits);
+  format_.isFloat = outFloat;
+
+  totalFrames_ = 0;
+  if (stream_->duration > 0 && stream_->time_base.num > 0) {
+    totalFrames_ = static_cast<uint64_t>(av_rescale_q(
+        stream_->duration, stream_->time_base, AVRational{1, codecCtx_->sample_rate}));
+  } else if (fmtCtx_->duration > 0) {
+    totalFrames_ = static_cast<uint64_t>(av_rescale(
+        fmtCtx_->duration, codecCtx_->sample_rate, AV_TIME_BASE));
+  }
+
+  // Typical frame size is known for most codecs; reserve once (including
+  // resampler delay) so steady-state decoding does not allocate.
+  const int hintFrames = codecCtx_->frame_size > 0 ? codecCtx_->frame_size
+                         : params->frame_size > 0  ? params->frame_size
+                                                   : 4096;
+  staging_.Reserve(static_cast<size_t>(swr_get_out_samples(swr_, hintFrames)) *
+                   format_.BytesPerFrame());
+  return S_OK;
+}
+
+size_t FFmpegPcmSource::ReadFrames(uint8_t* dst, size_t maxFrames) {
+  if (!codecCtx_) return 0;
+  const size_t bytesPerFrame = format_.BytesPerFrame();
+  size_t written = 0;
+  while (written < maxFrames) {
+    if (stagedOffset_ >= stagedFrames_ && !DecodeNextFrame()) break;
+    const size_t n = std::min(maxFrames - written, stagedFrames_ - stagedOffset_);
+    memcpy(dst + written * bytesPerFrame,
+           staging_.Data() + stagedOffset_ * bytesPerFrame, n * bytesPerFrame);
+    stagedOffset_ += n;
+    written += n;
+  }
+  return written;
+}
+
+bool FFmpegPcmSource::DecodeNextFrame() {
+  stagedFrames_ = 0;
+  stagedOffset_ = 0;
+  const size_t bytesPerFrame = format_.BytesPerFrame();
+
+  while (true) {
+    int r = avcodec_receive_frame(codecCtx_, frame_);
+    if (r == AVERROR_EOF) return false;
+    if (r == AVERROR(EAGAIN)) {
+      if (inputDrained_) return false;
+      r = av_read_frame(fmtCtx_, packet_);
+      if (r < 0) {
+        // Flush the decoder so buffered frames are still delivered.
+        inputDrained_ = true;
+        avcodec_send_packet(codecCtx_, nullptr);
+        continue;
+      }
+      if (packet_->stream_index == streamIndex_) {
+        avcodec_send_packet(codecCtx_, packet_);
+      }
+      av_packet_unref(packet_);
+      continue;
+    }
+    if (r < 0) return false;
+
+    const int outSamples = swr_get_out_samples(swr_, frame_->nb_samples);
+    if (outSamples <= 0) {
+      av_frame_unref(frame_);
+      continue;
+    }
+    uint64_t blockStart = nextFrame_;
+    const int64_t pts = frame_->best_effort_timestamp;
+    if (originFromFirstFrame_ && firstFramePts_ == AV_NOPTS_VALUE) {
+      firstFramePts_ = pts;
+    }
+    if (useTimestamps_ && pts != AV_NOPTS_VALUE) {
+      const int64_t start = av_rescale_q(
+          pts - Origin(), stream_->time_base,
+          AVRational{1, static_cast<int>(format_.sampleRate)});
+      blockStart = start > 0 ? static_cast<uint64_t>(start) : 0;
+    }
+    uint8_t* out[1] = {
+        staging_.Acquire(static_cast<size_t>(outSamples) * bytesPerFrame)};
+    const int converted =
+        swr_convert(swr_, out, outSamples,
+                    const_cast<const uint8_t**>(frame_->extended_data),
+                    frame_->nb_samples);
+    av_frame_unref(frame_);
+    if (converted > 0) {
+      stagedFrames_ = static_cast<size_t>(converted);
+      stagedStart_ = blockStart;
+      nextFrame_ = blockStart + stagedFrames_;
+      return true;
+    }
+  }
+}
+
+GaplessInfo FFmpegPcmSource::DetectGapless(const std::string& utf8Path) const {
+  GaplessInfo info;
+  const AVDictionaryEntry* smpb = av_dict_get(stream_->metadata, "iTunSMPB", nullptr, 0);
+  if (!smpb) smpb = av_dict_get(fmtCtx_->metadata, "iTunSMPB", nullptr, 0);
+  if (smpb && ParseITunSMPB(smpb->value, &info)) return info;
+
+  const AVCodecParameters* params = stream_->codecpar;
+  if (params->codec_id == AV_CODEC_ID_MP3) {
+    // Read through a separate context so the demuxer's position is untouched.
+    AVIOContext* io = nullptr;
+    if (avio_open(&io, utf8Path.c_str(), AVIO_FLAG_READ) >= 0) {
+      std::vector<uint8_t> head(kLameProbeBytes);
+      const int got = avio_read(io, head.data(), kLameProbeBytes);
+      avio_closep(&io);
+      if (got > 0 && ParseLameHeader(head.data(), static_cast<size_t>(got), &info)) {
+        return info;
+      }
+    }
+    info = GaplessInfo();
+  }
+
+  if (params->initial_padding > 0) {
+    info.leadingFrames = static_cast<uint64_t>(params->initial_padding);
+  }
+  if (params->trailing_padding > 0) {
+    info.trailingFrames = static_cast<uint64_t>(params->trailing_padding);
+  }
+  return info;
+}
+
+int64_t FFmpegPcmSource::Origin() const {
+  if (originFromFirstFrame_ && firstFramePts_ != AV_NOPTS_VALUE) {
+    return firstFramePts_;
+  }
+  return StreamOrigin(stream_);
+}
+
+uint64_t FFmpegPcmSource::PrerollFrames() const {
+  const AVCodecParameters* params = stream_->codecpar;
+  if (params->seek_preroll > 0) return static_cast<uint64_t>(params->seek_preroll);
+  switch (params->codec_id) {
+    case AV_CODEC_ID_MP1:
+    case AV_CODEC_ID_MP2:
+    case AV_CODEC_ID_MP3:
+      // Main data may start up to 511 bytes back in the bit reservoir.
+      return 2 * 1152;
+    case AV_CODEC_ID_AAC:
+    case AV_CODEC_ID_VORBIS:
+      // The first block after a seek is missing its overlap half.
+      return 2048;
+    default:
+      return 0;
+  }
+}
+
+bool FFmpegPcmSource::WantsSeekIndex() const {
+  if (!fmtCtx_ || !stream_) return false;
+  const AVCodecID codecId = stream_->codecpar->codec_id;
+  const char* demuxer = fmtCtx_->iformat->name;
+  const bool unindexed =
+      (codecId == AV_CODEC_ID_MP3 && strcmp(demuxer, "mp3") == 0) ||
+      (codecId == AV_CODEC_ID_AAC && strcmp(demuxer, "aac") == 0) ||
+      (codecId == AV_CODEC_ID_FLAC && strcmp(demuxer, "flac") == 0 &&
+       avformat_index_get_entries_count(stream_) == 0);
+  if (!unindexed) return false;
+  // Unknown length means the demuxer could not even estimate it.
+  return fmtCtx_->duration <= 0 ||
+         fmtCtx_->duration >= kSeekIndexMinDurationSeconds * AV_TIME_BASE;
+}
+
+void FFmpegPcmSource::EnableSeekIndex(const SeekIndexer* indexer,
+                                      SeekIndex::Key key) {
+  seekIndexer_ = indexer;
+  seekKey_ = std::move(key);
+  seekIndex_ = SeekIndex();
+}
+
+bool FFmpegPcmSource::BuildSeekIndex(const SeekIndex::Key& key,
+                                     SeekIndex* index) {
+  AVFormatContext* fmtCtx = nullptr;
+  if (avformat_open_input(&fmtCtx, key.path.c_str(), nullptr, nullptr) < 0) {
+    return false;
+  }
+  const int streamIndex =
+      av_find_best_stream(fmtCtx, AVMEDIA_TYPE_AUDIO, -1, -1, nullptr, 0);
+  if (streamIndex >= 0 &&
+      fmtCtx->streams[streamIndex]->codecpar->sample_rate <= 0) {
+    avformat_find_stream_info(fmtCtx, nullptr);
+  }
+  AVPacket* packet = av_packet_alloc();
+  const AVStream* stream =
+      streamIndex >= 0 ? fmtCtx->streams[streamIndex] : nullptr;
+  const int sampleRate = stream ? stream->codecpar->sample_rate : 0;
+  if (!packet || sampleRate <= 0) {
+    av_packet_free(&packet);
+    avformat_close_input(&fmtCtx);
+    return false;
+  }
+
+  *index = SeekIndex(static_cast<uint32_t>(sampleRate),
+                     SeekIndex::DefaultInterval(static_cast<uint32_t>(sampleRate)));
+  const AVRational frameBase{1, sampleRate};
+  const int64_t origin = StreamOrigin(stream);
+  // Packet timestamps of these demuxers come from the parser and are exact;
+  // the running count covers packets without one.
+  uint64_t frame = 0;
+  while (av_read_frame(fmtCtx, packet) >= 0) {
+    if (packet->stream_index == streamIndex) {
+      if (packet->pts != AV_NOPTS_VALUE) {
+        const int64_t start =
+            av_rescale_q(packet->pts - origin, stream->time_base, frameBase);
+        frame = start > 0 ? static_cast<uint64_t>(start) : 0;
+      }
+      if (packet->pos >= 0) index->Add(frame, static_cast<uint64_t>(packet->pos));
+      frame += packet->duration > 0
+                   ? static_cast<uint64_t>(av_rescale_q(
+                         packet->duration, stream->time_base, frameBase))
+                   : static_cast<uint64_t>(std::max(stream->codecpar->frame_size, 0));
+    }
+    av_packet_unref(packet);
+  }
+  av_packet_free(&packet);
+  avformat_close_input(&fmtCtx);
+  return !index->Empty();
+}
+
+bool FFmpegPcmSource::SeekWithIndex(uint64_t frame) {
+  if (!seekIndexer_) return false;
+  if (seekIndex_.Empty() && !seekIndexer_->Load(seekKey_, &seekIndex_)) {
+    return false;  // still being built
+  }
+  if (seekIndex_.SampleRate() != format_.sampleRate) return false;
+  SeekPoint point;
+  if (!seekIndex_.Lookup(frame, &point)) return false;
+  if (av_seek_frame(fmtCtx_, streamIndex_, static_cast<int64_t>(point.byteOffset),
+                    AVSEEK_FLAG_BYTE) < 0) {
+    return false;
+  }
+  nextFrame_ = point.frame;
+  useTimestamps_ = false;
+  return true;
+}
+
+bool FFmpegPcmSource::SeekToFrame(uint64_t frame, SeekMode mode,
+                                  uint64_t* landedFrame) {
+  if (!codecCtx_ || format_.sampleRate == 0) return false;
+  const uint64_t preroll = mode == SeekMode::kAccurate ? PrerollFrames() : 0;
+  const uint64_t seekFrame = frame > preroll ? frame - preroll : 0;
+  int r = 0;
+  if (!SeekWithIndex(seekFrame)) {
+    int64_t ts = av_rescale_q(static_cast<int64_t>(seekFrame),
+                              AVRational{1, static_cast<int>(format_.sampleRate)},
+                              stream_->time_base);
+    ts += Origin();
+    r = av_seek_frame(fmtCtx_, streamIndex_, ts, AVSEEK_FLAG_BACKWARD);
+    nextFrame_ = seekFrame;
+    useTimestamps_ = true;
+  }
+  avcodec_flush_buffers(codecCtx_);
+  // Drop resampler history so no pre-seek samples leak into the new position.
+  swr_init(swr_);
+  inputDrained_ = false;
+  stagedFrames_ = 0;
+  stagedOffset_ = 0;
+  if (r < 0) return false;
+
+  // Decode until the landing point is known. Accurate seeks keep going,
+  // discarding pre-roll, until the block that holds `frame`.
+  while (DecodeNextFrame()) {
+    const uint64_t blockEnd = stagedStart_ + stagedFrames_;
+    if (mode == SeekMode::kFast || blockEnd > frame) {
+      if (mode == SeekMode::kAccurate && frame > stagedStart_) {
+        stagedOffset_ = static_cast<size_t>(frame - stagedStart_);
+      }
+      if (landedFrame) *landedFrame = stagedStart_ + stagedOffset_;
+      return true;
+    }
+  }
+  if (landedFrame) *landedFrame = nextFrame_;
+  return true;
+}
+
+}  // namespace audioengine
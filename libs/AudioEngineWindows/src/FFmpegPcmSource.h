@@ -0,0 +1,121 @@
+// FFmpeg demux/decode/convert pipeline exposed as a pull-based PcmSource.
+#pragma once
+
+#include <Windows.h>
+
+#include <cstdint>
+#include <string>
+
+#include "AudioEngineCore/Gapless.h"
+#include "AudioEngineCore/PcmSource.h"
+#include "AudioEngineCore/ScratchArena.h"
+#include "AudioEngineCore/SeekIndex.h"
+#include "AudioEngineCore/SeekIndexer.h"
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+#include <libavutil/channel_layout.h>
+#include <libavutil/samplefmt.h>
+#include <libswresample/swresample.h>
+}
+
+namespace audioengine {
+
+class FFmpegPcmSource : public PcmSource {
+ public:
+  FFmpegPcmSource() = default;
+  ~FFmpegPcmSource() override;
+
+  FFmpegPcmSource(const FFmpegPcmSource&) = delete;
+  FFmpegPcmSource& operator=(const FFmpegPcmSource&) = delete;
+
+  // Opens `utf8Path` and prepares conversion to packed PCM. With
+  // `bitPerfect` the source sample format is kept when WASAPI can take it;
+  // otherwise output is 32-bit float. With `gapless` the encoder delay and
+  // padding are looked up (see Gapless()) and, when found, FFmpeg's own
+  // trimming is turned off so the caller can trim exactly once. A non-zero
+  // `maxChannels` downmixes wider sources to that many channels in the
+  // converter, for overview work that does not need them all.
+  HRESULT Open(const std::string& utf8Path, bool bitPerfect, bool gapless = false,
+               uint32_t maxChannels = 0);
+
+  PcmFormat Format() const override { return format_; }
+  size_t ReadFrames(uint8_t* dst, size_t maxFrames) override;
+  bool SeekToFrame(uint64_t frame, SeekMode mode, uint64_t* landedFrame) override;
+  uint64_t TotalFrames() const override { return totalFrames_; }
+
+  // True for long files whose container offers no exact seek table (MP3,
+  // FLAC without SEEKTABLE, ADTS): their seeks bisect or estimate from the
+  // bit rate, so a prebuilt index pays off.
+  bool WantsSeekIndex() const;
+  // Seeks use the index cached by `indexer` for `key` once it exists. The
+  // indexer must outlive this source.
+  void EnableSeekIndex(const SeekIndexer* indexer, SeekIndex::Key key);
+  // SeekIndexer::BuildFn: demuxes `key.path` (no decoding) and records the
+  // byte position of the first packet of every interval.
+  static bool BuildSeekIndex(const SeekIndex::Key& key, SeekIndex* index);
+
+  // Delay/padding in decoded frames, from the iTunSMPB tag, else the LAME
+  // header, else the codec parameters. Empty unless opened with `gapless`;
+  // a non-empty result must be applied with a TrimmingSource.
+  const GaplessInfo& Gapless() const { return gapless_; }
+
+  const AVFormatContext* FormatContext() const { return fmtCtx_; }
+  const AVCodec* Codec() const { return codec_; }
+  const AVStream* Stream() const { return stream_; }
+  AVSampleFormat OutputSampleFormat() const { return outFmt_; }
+  const AVChannelLayout& OutputLayout() const { return outLayout_; }
+
+ private:
+  bool DecodeNextFrame();
+  // Frames of history the codec needs before a seek target to decode it
+  // cleanly (bit reservoir, overlapped transforms, Opus pre-skip).
+  uint64_t PrerollFrames() const;
+  // Byte-seeks to the indexed packet at or before `frame`. False when there
+  // is no index (yet) or it has no point that early.
+  bool SeekWithIndex(uint64_t frame);
+  GaplessInfo DetectGapless(const std::string& utf8Path) const;
+  int64_t Origin() const;
+  void Close();
+
+  AVFormatContext* fmtCtx_ = nullptr;
+  AVCodecContext* codecCtx_ = nullptr;
+  const AVCodec* codec_ = nullptr;
+  AVStream* stream_ = nullptr;
+  SwrContext* swr_ = nullptr;
+  AVPacket* packet_ = nullptr;
+  AVFrame* frame_ = nullptr;
+  int streamIndex_ = -1;
+  bool inputDrained_ = false;
+
+  AVSampleFormat outFmt_ = AV_SAMPLE_FMT_NONE;
+  AVChannelLayout outLayout_{};
+  PcmFormat format_{};
+  uint64_t totalFrames_ = 0;
+
+  // Converted PCM of the most recent decoded frame, handed out across
+  // ReadFrames() calls. Reserved at Open() from the codec frame size.
+  ScratchArena staging_;
+  size_t stagedFrames_ = 0;
+  size_t stagedOffset_ = 0;
+  // Stream position of the first staged frame, from the frame timestamp when
+  // there is one. nextFrame_ continues the count when there is not.
+  uint64_t stagedStart_ = 0;
+  uint64_t nextFrame_ = 0;
+  // Cleared after a byte seek: packet timestamps there are derived from the
+  // bit rate, so frames are counted from the index point instead.
+  bool useTimestamps_ = true;
+
+  GaplessInfo gapless_;
+  // With manual trimming the first decoded frame, priming included, is frame
+  // 0; its timestamp replaces the stream start time as the origin.
+  bool originFromFirstFrame_ = false;
+  int64_t firstFramePts_ = AV_NOPTS_VALUE;
+
+  const SeekIndexer* seekIndexer_ = nullptr;
+  SeekIndex::Key seekKey_;
+  SeekIndex seekIndex_;
+};
+
+}  // namespace audioengine
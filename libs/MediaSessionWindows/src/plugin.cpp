@@ -109,6 +109,17 @@ class MediaSessionWindows {
           }
         });
 
+    // Speed changes from the system flyout go to Dart, which applies them
+    // to the engine and reports the rate back through SetPlaybackState.
+    rate_token_ = smtc_.PlaybackRateChangeRequested(
+        [this](winrt::Windows::Media::SystemMediaTransportControls const&,
+               winrt::Windows::Media::PlaybackRateChangeRequestedEventArgs const& args) {
+          flutter::EncodableMap map;
+          map[flutter::EncodableValue("rate")] =
+              flutter::EncodableValue(args.RequestedPlaybackRate());
+          InvokeFlutter("onPlaybackRate", flutter::EncodableValue(std::move(map)));
+        });
+
     initialized_ = true;
     UpdatePlayPauseButton();
     return S_OK;
@@ -218,6 +229,7 @@ class MediaSessionWindows {
     if (smtc_) {
       try {
         smtc_.ButtonPressed(button_token_);
+        smtc_.PlaybackRateChangeRequested(rate_token_);
       } catch (...) {
       }
       smtc_.PlaybackStatus(winrt::Windows::Media::MediaPlaybackStatus::Closed);
@@ -380,10 +392,10 @@ class MediaSessionWindows {
     smtc_.UpdateTimelineProperties(timeline);
   }
 
-  void InvokeFlutter(const char* method) {
+  void InvokeFlutter(const char* method, flutter::EncodableValue args = {}) {
     if (!channel_) return;
-    auto args = std::make_unique<flutter::EncodableValue>();
-    channel_->InvokeMethod(method, std::move(args));
+    channel_->InvokeMethod(method,
+                           std::make_unique<flutter::EncodableValue>(std::move(args)));
   }
 
   std::shared_ptr<flutter::MethodChannel<flutter::EncodableValue>> channel_;
@@ -395,6 +407,7 @@ class MediaSessionWindows {
   HICON icon_pause_{nullptr};
   winrt::Windows::Media::SystemMediaTransportControls smtc_{nullptr};
   winrt::event_token button_token_{};
+  winrt::event_token rate_token_{};
   bool is_playing_{false};
   bool initialized_{false};
   int64_t duration_ms_{0};
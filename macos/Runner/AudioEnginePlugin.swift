@@ -20,6 +20,12 @@ public class AudioEnginePlugin: NSObject, FlutterPlugin {
                 channel.invokeMethod("onPlaybackEnded", arguments: nil)
             }
         }
+        // A track queued with queueNext has become audible.
+        AudioEngineFacade.shared.onTrackChanged = {
+            DispatchQueue.main.async {
+                channel.invokeMethod("onTrackChanged", arguments: nil)
+            }
+        }
     }
 
     public func handle(_ call: FlutterMethodCall,
@@ -52,6 +58,33 @@ public class AudioEnginePlugin: NSObject, FlutterPlugin {
                 try AudioEngineFacade.shared.loadFile(url: url)
             }
 
+        case "preloadNext":
+            guard let args = call.arguments as? [String: Any],
+                  let path = args["path"] as? String else {
+                return result(FlutterError(code: "INVALID", message: nil, details: nil))
+            }
+            performAsync {
+                AudioEngineFacade.shared.preloadNext(url: URL(fileURLWithPath: path))
+            }
+
+        case "setGapless":
+            guard let args = call.arguments as? [String: Any],
+                  let enabled = args["enabled"] as? Bool else {
+                return result(FlutterError(code: "INVALID", message: nil, details: nil))
+            }
+            performAsync {
+                AudioEngineFacade.shared.setGapless(enabled: enabled)
+            }
+
+        case "queueNext":
+            guard let args = call.arguments as? [String: Any],
+                  let path = args["path"] as? String else {
+                return result(FlutterError(code: "INVALID", message: nil, details: nil))
+            }
+            performAsync {
+                try AudioEngineFacade.shared.queueNext(url: URL(fileURLWithPath: path))
+            }
+
         case "play":
             performAsync {
                 try AudioEngineFacade.shared.play()
@@ -264,6 +297,19 @@ private extension PCMStatus {
             "bytesPerFrame": bytesPerFrame,
             "renderedFrames": renderedFrames,
             "underflows": underflows,
+            "levels": levels.toDictionary(),
+        ]
+    }
+}
+
+private extension LevelMeterReading {
+    func toDictionary() -> [String: Any] {
+        [
+            "peakDb": peakDb.map(Double.init),
+            "peakHoldDb": peakHoldDb.map(Double.init),
+            "rmsDb": rmsDb.map(Double.init),
+            "truePeakDb": truePeakDb.map(Double.init),
+            "maxTruePeakDb": maxTruePeakDb.map(Double.init),
         ]
     }
 }
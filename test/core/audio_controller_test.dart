@@ -61,6 +61,22 @@ void main() {
       expect(controller.state.value.queue.length, 1);
     });
 
+    test('playAt preloads the next queue item', () async {
+      final metadata = SongMetadata.unknown('Test Song');
+      controller.setQueue([
+        PlaybackTrack(path: '/tmp/first.flac', metadata: metadata),
+        PlaybackTrack(path: '/tmp/second.flac', metadata: metadata),
+      ]);
+
+      await controller.playAt(0);
+      await Future<void>.delayed(const Duration(milliseconds: 10));
+
+      final preload = recordedCalls.where((c) => c.method == 'preloadNext');
+      expect(preload.map((c) => c.arguments), [
+        {'path': '/tmp/second.flac'},
+      ]);
+    });
+
     test('setVolume emits to stream and invokes channel', () async {
       expectLater(controller.volumeStream, emitsInOrder([0.5, 0.8]));
 
@@ -11,12 +11,15 @@
 
 #include <memory>
 #include <string>
+#include <utility>
 #include <variant>
+#include <vector>
 
 #include "AudioEngineWindows/AudioEngineWindows.h"
 
 namespace {
 
+using flutter::EncodableList;
 using flutter::EncodableMap;
 using flutter::EncodableValue;
 
@@ -92,6 +95,75 @@ EncodableMap MetadataToMap(const audioengine::TrackMetadata& meta) {
   return map;
 }
 
+std::string MapString(const EncodableMap& map, const char* key) {
+  auto it = map.find(EncodableValue(key));
+  if (it == map.end()) return {};
+  const auto* val = std::get_if<std::string>(&it->second);
+  return val ? *val : std::string();
+}
+
+EncodableMap LoudnessToMap(const audioengine::TrackLoudness& loudness) {
+  return {
+      {EncodableValue("integratedLufs"), EncodableValue(loudness.integratedLufs)},
+      {EncodableValue("loudnessRangeLu"), EncodableValue(loudness.loudnessRangeLu)},
+      {EncodableValue("truePeak"), EncodableValue(loudness.truePeak)},
+  };
+}
+
+EncodableMap LoudnessStatsToMap(const audioengine::LoudnessScanner::Stats& stats) {
+  return {
+      {EncodableValue("tracksScanned"), EncodableValue(static_cast<int64_t>(stats.tracksScanned))},
+      {EncodableValue("tracksCached"), EncodableValue(static_cast<int64_t>(stats.tracksCached))},
+      {EncodableValue("tracksFailed"), EncodableValue(static_cast<int64_t>(stats.tracksFailed))},
+      {EncodableValue("tracksPending"), EncodableValue(static_cast<int64_t>(stats.tracksPending))},
+      {EncodableValue("tracksPerSecondPerCore"), EncodableValue(stats.TracksPerSecondPerCore())},
+      {EncodableValue("realtimeFactor"), EncodableValue(stats.RealtimeFactor())},
+  };
+}
+
+EncodableMap FeaturesToMap(const audioengine::TrackFeatures& features) {
+  return {
+      {EncodableValue("bpm"), EncodableValue(features.bpm)},
+      {EncodableValue("tempoConfidence"), EncodableValue(features.tempoConfidence)},
+      {EncodableValue("key"), EncodableValue(features.key)},
+      {EncodableValue("minor"), EncodableValue(features.minor)},
+      {EncodableValue("keyConfidence"), EncodableValue(features.keyConfidence)},
+      {EncodableValue("energy"), EncodableValue(features.energy)},
+      {EncodableValue("danceability"), EncodableValue(features.danceability)},
+      {EncodableValue("rmsDb"), EncodableValue(features.rmsDb)},
+      {EncodableValue("onsetRate"), EncodableValue(features.onsetRate)},
+      {EncodableValue("spectralCentroidHz"), EncodableValue(features.spectralCentroidHz)},
+      {EncodableValue("spectralSpreadHz"), EncodableValue(features.spectralSpreadHz)},
+      {EncodableValue("spectralRolloffHz"), EncodableValue(features.spectralRolloffHz)},
+      {EncodableValue("spectralFlatness"), EncodableValue(features.spectralFlatness)},
+  };
+}
+
+EncodableMap FeatureStatsToMap(const audioengine::FeatureScanner::Stats& stats) {
+  return {
+      {EncodableValue("tracksAnalyzed"), EncodableValue(static_cast<int64_t>(stats.tracksAnalyzed))},
+      {EncodableValue("tracksCached"), EncodableValue(static_cast<int64_t>(stats.tracksCached))},
+      {EncodableValue("tracksFailed"), EncodableValue(static_cast<int64_t>(stats.tracksFailed))},
+      {EncodableValue("tracksPending"), EncodableValue(static_cast<int64_t>(stats.tracksPending))},
+      {EncodableValue("tracksPerSecondPerCore"), EncodableValue(stats.TracksPerSecondPerCore())},
+      {EncodableValue("realtimeFactor"), EncodableValue(stats.RealtimeFactor())},
+  };
+}
+
+// One list per reading, one value per output channel.
+EncodableMap LevelsToMap(const audioengine::LevelMeterReading& levels) {
+  auto channels = [&levels](const float* values) {
+    return EncodableValue(std::vector<float>(values, values + levels.channels));
+  };
+  return {
+      {EncodableValue("peakDb"), channels(levels.peakDb)},
+      {EncodableValue("peakHoldDb"), channels(levels.peakHoldDb)},
+      {EncodableValue("rmsDb"), channels(levels.rmsDb)},
+      {EncodableValue("truePeakDb"), channels(levels.truePeakDb)},
+      {EncodableValue("maxTruePeakDb"), channels(levels.maxTruePeakDb)},
+  };
+}
+
 int ProbeDurationMs(const std::wstring& path) {
   Microsoft::WRL::ComPtr<IMFSourceReader> reader;
   if (FAILED(MFCreateSourceReaderFromURL(path.c_str(), nullptr, &reader))) {
@@ -126,6 +198,11 @@ void RegisterAudioEngineChannel(flutter::FlutterEngine* engine) {
     auto args = std::make_unique<EncodableValue>();
     channel->InvokeMethod("onPlaybackEnded", std::move(args));
   });
+  // A track queued with queueNext has become audible.
+  audioEngine->SetOnTrackChanged([channel]() {
+    auto args = std::make_unique<EncodableValue>();
+    channel->InvokeMethod("onTrackChanged", std::move(args));
+  });
 
   channel->SetMethodCallHandler(
       [channel](const flutter::MethodCall<EncodableValue>& call,
@@ -165,6 +242,12 @@ void RegisterAudioEngineChannel(flutter::FlutterEngine* engine) {
           if (auto pi64 = std::get_if<int64_t>(&it->second)) return static_cast<double>(*pi64);
           return 0.0;
         };
+        auto getListArg = [&](const char* key) -> const EncodableList* {
+          if (!arguments) return nullptr;
+          auto it = arguments->find(EncodableValue(key));
+          if (it == arguments->end()) return nullptr;
+          return std::get_if<EncodableList>(&it->second);
+        };
 
         const std::string& method = call.method_name();
         if (method == "load") {
@@ -179,6 +262,31 @@ void RegisterAudioEngineChannel(flutter::FlutterEngine* engine) {
           } else {
             result->Success();
           }
+        } else if (method == "preloadNext") {
+          const auto path = getStringArg("path");
+          if (path.empty()) {
+            result->Error("invalid_args", "Missing path");
+            return;
+          }
+          engineRef.PreloadNext(Utf8ToWide(path));
+          result->Success();
+        } else if (method == "setGapless") {
+          engineRef.SetGapless(getBoolArg("enabled"));
+          result->Success();
+        } else if (method == "queueNext") {
+          const auto path = getStringArg("path");
+          if (path.empty()) {
+            result->Error("invalid_args", "Missing path");
+            return;
+          }
+          // Refused when gapless is off or the formats differ; the caller
+          // then loads the track when playback ends.
+          HRESULT hr = engineRef.QueueNext(Utf8ToWide(path));
+          if (FAILED(hr)) {
+            result->Error("queue_failed", "Cannot queue track", EncodableValue(static_cast<int>(hr)));
+          } else {
+            result->Success();
+          }
         } else if (method == "play") {
           HRESULT hr = engineRef.Play();
           if (FAILED(hr)) {
@@ -212,6 +320,15 @@ void RegisterAudioEngineChannel(flutter::FlutterEngine* engine) {
           const double value = getDoubleArg("value");
           engineRef.SetVolume(value);
           result->Success();
+        } else if (method == "setPlaybackRate") {
+          const double rate = getDoubleArg("rate");
+          if (rate <= 0.0) {
+            result->Error("invalid_args", "Missing rate");
+            return;
+          }
+          // Clamped to 0.5x-3x by the engine.
+          engineRef.SetPlaybackRate(rate);
+          result->Success();
         } else if (method == "getVolume") {
           result->Success(EncodableValue(engineRef.GetVolume()));
         } else if (method == "trackMetadata") {
@@ -226,6 +343,7 @@ void RegisterAudioEngineChannel(flutter::FlutterEngine* engine) {
               {EncodableValue("bytesPerFrame"), EncodableValue(static_cast<int>(status.bytesPerFrame))},
               {EncodableValue("renderedFrames"), EncodableValue(status.renderedFrames)},
               {EncodableValue("underflows"), EncodableValue(status.underflows)},
+              {EncodableValue("levels"), EncodableValue(LevelsToMap(status.levels))},
           };
           result->Success(EncodableValue(payload));
         } else if (method == "trackInfo") {
@@ -233,6 +351,72 @@ void RegisterAudioEngineChannel(flutter::FlutterEngine* engine) {
           result->Success(EncodableValue(PcmToMap(meta.pcm)));
         } else if (method == "trackUrl") {
           result->Success(EncodableValue(WideToUtf8(engineRef.Metadata().url)));
+        } else if (method == "scanLoudness") {
+          // [{path, album}]; tracks sharing an album id get album gain.
+          std::vector<std::pair<std::wstring, std::wstring>> tracks;
+          if (const auto* list = getListArg("tracks")) {
+            for (const auto& item : *list) {
+              const auto* track = std::get_if<EncodableMap>(&item);
+              if (!track) continue;
+              const auto path = MapString(*track, "path");
+              if (path.empty()) continue;
+              tracks.emplace_back(Utf8ToWide(path), Utf8ToWide(MapString(*track, "album")));
+            }
+          }
+          engineRef.ScanLoudness(tracks);
+          result->Success();
+        } else if (method == "cancelLoudnessScan") {
+          engineRef.CancelLoudnessScan();
+          result->Success();
+        } else if (method == "trackLoudness") {
+          audioengine::TrackLoudness loudness;
+          if (engineRef.TrackLoudnessFor(Utf8ToWide(getStringArg("path")), &loudness)) {
+            result->Success(EncodableValue(LoudnessToMap(loudness)));
+          } else {
+            result->Success();
+          }
+        } else if (method == "setSpectrumEnabled") {
+          engineRef.SetSpectrumEnabled(getBoolArg("enabled"));
+          result->Success();
+        } else if (method == "spectrum") {
+          // Polled by the visualizer; null when no frame was published since
+          // the last call.
+          audioengine::SpectrumFrame frame;
+          if (engineRef.LatestSpectrum(&frame)) {
+            EncodableMap payload{
+                {EncodableValue("levelsDb"),
+                 EncodableValue(std::vector<float>(frame.levelsDb, frame.levelsDb + frame.bands))},
+            };
+            result->Success(EncodableValue(payload));
+          } else {
+            result->Success();
+          }
+        } else if (method == "spectrumBands") {
+          result->Success(EncodableValue(engineRef.SpectrumBandCentersHz()));
+        } else if (method == "loudnessScanStats") {
+          result->Success(EncodableValue(LoudnessStatsToMap(engineRef.LoudnessScanStats())));
+        } else if (method == "scanFeatures") {
+          std::vector<std::wstring> paths;
+          if (const auto* list = getListArg("paths")) {
+            for (const auto& item : *list) {
+              const auto* path = std::get_if<std::string>(&item);
+              if (path && !path->empty()) paths.push_back(Utf8ToWide(*path));
+            }
+          }
+          engineRef.ScanFeatures(paths);
+          result->Success();
+        } else if (method == "cancelFeatureScan") {
+          engineRef.CancelFeatureScan();
+          result->Success();
+        } else if (method == "trackFeatures") {
+          audioengine::TrackFeatures features;
+          if (engineRef.TrackFeaturesFor(Utf8ToWide(getStringArg("path")), &features)) {
+            result->Success(EncodableValue(FeaturesToMap(features)));
+          } else {
+            result->Success();
+          }
+        } else if (method == "featureScanStats") {
+          result->Success(EncodableValue(FeatureStatsToMap(engineRef.FeatureScanStats())));
         } else if (method == "extractMetadata") {
           const auto path = getStringArg("path");
           const auto duration = ProbeDurationMs(Utf8ToWide(path));